@@ -0,0 +1,58 @@
+//--------------------------------------------------------------------------------------
+// File: AdaptiveTessellation.hlsl
+//
+// Helper functions for the adaptive tessellation of DetailTessellation11.hlsl.
+// PatchTessellation.cpp and the reference of Tests/TestPatchTessellation.cpp port them to
+// the CPU, keep the three in step.
+//
+// Copyright (c) Microsoft Corporation. All rights reserved.
+//--------------------------------------------------------------------------------------
+
+//--------------------------------------------------------------------------------------
+// Returns the screen space position of a world space position, in pixels
+//--------------------------------------------------------------------------------------
+float2 GetScreenSpacePosition( float3 f3Position, float4x4 f4x4ViewProjection, float fScreenWidth, float fScreenHeight )
+{
+    float4 f4ProjectedPosition = mul( float4( f3Position, 1.0f ), f4x4ViewProjection );
+    float2 f2ScreenPosition = f4ProjectedPosition.xy / f4ProjectedPosition.ww;
+    f2ScreenPosition = ( f2ScreenPosition + 1.0f ) * 0.5f * float2( fScreenWidth, -fScreenHeight );
+
+    return f2ScreenPosition;
+}
+
+//--------------------------------------------------------------------------------------
+// Returns the distance of a given point from a given plane
+//--------------------------------------------------------------------------------------
+float DistanceFromPlane( float3 f3Position, float4 f4PlaneEquation )
+{
+    return dot( float4( f3Position, 1.0f ), f4PlaneEquation );
+}
+
+//--------------------------------------------------------------------------------------
+// Returns true if the triangle is behind one of the four view frustum planes
+//--------------------------------------------------------------------------------------
+bool ViewFrustumCull( float3 f3EdgePosition0, float3 f3EdgePosition1, float3 f3EdgePosition2,
+                      float4 f4ViewFrustumPlanes[4], float fCullEpsilon )
+{
+    float4 f4PlaneTest;
+
+    // Left clip plane
+    f4PlaneTest.x = ( ( DistanceFromPlane( f3EdgePosition0, f4ViewFrustumPlanes[0] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition1, f4ViewFrustumPlanes[0] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition2, f4ViewFrustumPlanes[0] ) > -fCullEpsilon ) ? 1.0f : 0.0f );
+    // Right clip plane
+    f4PlaneTest.y = ( ( DistanceFromPlane( f3EdgePosition0, f4ViewFrustumPlanes[1] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition1, f4ViewFrustumPlanes[1] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition2, f4ViewFrustumPlanes[1] ) > -fCullEpsilon ) ? 1.0f : 0.0f );
+    // Top clip plane
+    f4PlaneTest.z = ( ( DistanceFromPlane( f3EdgePosition0, f4ViewFrustumPlanes[2] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition1, f4ViewFrustumPlanes[2] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition2, f4ViewFrustumPlanes[2] ) > -fCullEpsilon ) ? 1.0f : 0.0f );
+    // Bottom clip plane
+    f4PlaneTest.w = ( ( DistanceFromPlane( f3EdgePosition0, f4ViewFrustumPlanes[3] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition1, f4ViewFrustumPlanes[3] ) > -fCullEpsilon ) ? 1.0f : 0.0f ) +
+                    ( ( DistanceFromPlane( f3EdgePosition2, f4ViewFrustumPlanes[3] ) > -fCullEpsilon ) ? 1.0f : 0.0f );
+
+    // Triangle has to pass all 4 plane tests to be visible
+    return !all( f4PlaneTest );
+}
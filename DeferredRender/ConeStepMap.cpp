@@ -0,0 +1,507 @@
+#include "DXUT.h"
+#include "SDKmisc.h"
+#include "strsafe.h"
+#include "ConeStepMap.h"
+#include <ppl.h>
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	const uint32_t CACHE_MAGIC = 0x4D505343;    // "CSPM"
+
+	struct CacheHeader
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t sourceSize;
+		uint64_t sourceWriteTime;
+		ConeStepMapSettings settings;
+		uint32_t width;
+		uint32_t height;
+	};
+
+	UINT Wrap(int i, UINT size)
+	{
+		int m = i % (int)size;
+		return (UINT)(m < 0 ? m + (int)size : m);
+	}
+
+	// Nearest texel, like the point sampler
+	UINT TexelIndex(const ConeStepMap& map, float u, float v)
+	{
+		return Wrap((int)floorf(u * map.width), map.width) + (size_t)Wrap((int)floorf(v * map.height), map.height) * map.width;
+	}
+
+	// Bilinear with texel centers at half coordinates, like the linear sampler
+	float SampleDepth(const ConeStepMap& map, float u, float v)
+	{
+		float x = u * map.width - 0.5f, y = v * map.height - 0.5f;
+		float fx = floorf(x), fy = floorf(y);
+		UINT x0 = Wrap((int)fx, map.width), x1 = Wrap((int)fx + 1, map.width);
+		UINT y0 = Wrap((int)fy, map.height), y1 = Wrap((int)fy + 1, map.height);
+		float tx = x - fx, ty = y - fy;
+		const float* row0 = &map.depths[(size_t)y0 * map.width];
+		const float* row1 = &map.depths[(size_t)y1 * map.width];
+		float d0 = row0[x0] + (row0[x1] - row0[x0]) * tx;
+		float d1 = row1[x0] + (row1[x1] - row1[x0]) * tx;
+		return d0 + (d1 - d0) * ty;
+	}
+
+	// Reduces the height field by an integer factor, keeping the highest sample of each block
+	void ReduceHeights(const float* heights, UINT width, UINT height, UINT factor, std::vector<float>& reduced,
+		UINT* reducedWidth, UINT* reducedHeight)
+	{
+		*reducedWidth = (width + factor - 1) / factor;
+		*reducedHeight = (height + factor - 1) / factor;
+		reduced.assign((size_t)*reducedWidth * *reducedHeight, 0.0f);
+		for (UINT y = 0; y < height; ++y)
+		{
+			for (UINT x = 0; x < width; ++x)
+			{
+				float& h = reduced[(size_t)(y / factor) * *reducedWidth + x / factor];
+				h = max(h, heights[(size_t)y * width + x]);
+			}
+		}
+	}
+
+	//---------------------------------------------------------------------------------
+	// Rays start at depth 0 above the texel and are marched a texel at a time.  Once a
+	// ray has gone under the surface, the point where it comes out again bounds the
+	// cone: stepping to the edge of a wider cone could pass through the surface without
+	// seeing it.  A ray stops as soon as it can no longer narrow the cone, which is what
+	// keeps the search short for all but the flattest areas.
+	//---------------------------------------------------------------------------------
+	float RelaxedConeRatio(const ConeStepMap& map, UINT x, UINT y, const std::vector<XMFLOAT2>& directions,
+		const std::vector<float>& reaches)
+	{
+		float apexDepth = map.depths[(size_t)y * map.width + x];
+		float ratio = 1.0f;
+
+		for (size_t d = 0; d < directions.size(); ++d)
+		{
+			const XMFLOAT2& direction = directions[d];
+			float texelLength = sqrtf(direction.x * direction.x / ((float)map.width * map.width) +
+				direction.y * direction.y / ((float)map.height * map.height));
+
+			for (size_t s = 0; s < reaches.size(); ++s)
+			{
+				float depthPerTexel = 1.0f / reaches[s];
+				bool under = false;
+				for (UINT r = 1;; ++r)
+				{
+					float depth = r * depthPerTexel;
+					float distance = r * texelLength;
+					if (depth >= apexDepth || distance >= ratio * (apexDepth - depth))
+						break;
+
+					UINT tx = Wrap((int)floorf(x + 0.5f + r * direction.x), map.width);
+					UINT ty = Wrap((int)floorf(y + 0.5f + r * direction.y), map.height);
+					bool inside = depth >= map.depths[(size_t)ty * map.width + tx];
+					if (inside)
+						under = true;
+					else if (under)
+					{
+						ratio = distance / (apexDepth - depth);
+						break;
+					}
+				}
+			}
+		}
+		return ratio;
+	}
+
+	HRESULT ReadCache(const WCHAR* path, const CacheHeader& expected, ConeStepMap& map)
+	{
+		HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return E_FAIL;
+
+		HRESULT hr = E_FAIL;
+		CacheHeader header;
+		DWORD read = 0;
+		if (ReadFile(file, &header, sizeof(header), &read, nullptr) && read == sizeof(header) &&
+			header.magic == expected.magic && header.version == expected.version &&
+			header.sourceSize == expected.sourceSize && header.sourceWriteTime == expected.sourceWriteTime &&
+			memcmp(&header.settings, &expected.settings, sizeof(header.settings)) == 0 &&
+			header.width > 0 && header.height > 0 && header.width <= 16384 && header.height <= 16384)
+		{
+			size_t count = (size_t)header.width * header.height;
+			map.width = header.width;
+			map.height = header.height;
+			std::vector<float>* arrays[] = { &map.depths, &map.coneRatios };
+			DWORD bytes = (DWORD)(count * sizeof(float));
+			hr = S_OK;
+			for (int i = 0; i < 2 && SUCCEEDED(hr); ++i)
+			{
+				arrays[i]->resize(count);
+				if (!ReadFile(file, arrays[i]->data(), bytes, &read, nullptr) || read != bytes)
+					hr = E_FAIL;
+			}
+		}
+		CloseHandle(file);
+		return hr;
+	}
+
+	HRESULT WriteCache(const WCHAR* path, const CacheHeader& header, const ConeStepMap& map)
+	{
+		HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return E_FAIL;
+
+		const std::vector<float>* arrays[] = { &map.depths, &map.coneRatios };
+		DWORD bytes = (DWORD)(map.depths.size() * sizeof(float));
+		DWORD written = 0;
+		bool ok = WriteFile(file, &header, sizeof(header), &written, nullptr) && written == sizeof(header);
+		for (int i = 0; i < 2 && ok; ++i)
+			ok = WriteFile(file, arrays[i]->data(), bytes, &written, nullptr) && written == bytes;
+		CloseHandle(file);
+
+		if (!ok)
+		{
+			// A partial cache would only fail its size check, but do not leave it around
+			DeleteFile(path);
+			return E_FAIL;
+		}
+		return S_OK;
+	}
+
+	// Length of the quarter texel search for the reference hit
+	UINT ReferenceSteps(const ConeStepMap& map, const XMFLOAT2& parallaxOffset)
+	{
+		float texels = max(fabsf(parallaxOffset.x) * map.width, fabsf(parallaxOffset.y) * map.height);
+		return max((UINT)ceilf(texels * 4.0f), 64u);
+	}
+}
+
+//---------------------------------------------------------------------------------
+ConeStepMapSettings ConeStepMapSettings::Default()
+{
+	ConeStepMapSettings settings;
+	settings.directionCount = 16;
+	settings.slopesPerOctave = 2;
+	settings.maxResolution = 512;
+	return settings;
+}
+
+//---------------------------------------------------------------------------------
+// The rays of a texel cover directionCount azimuths and slopes whose horizontal
+// reach at depth 1 goes from one texel to the size of the map in slopesPerOctave
+// steps per doubling.  Rows are shared out between tasks.
+//---------------------------------------------------------------------------------
+void BuildRelaxedConeStepMap(const float* heights, UINT width, UINT height, const ConeStepMapSettings& settings,
+	ConeStepMap& map, ConeStepMapStats* stats)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	UINT factor = 1;
+	while (max(width, height) > settings.maxResolution * factor)
+		factor++;
+
+	std::vector<float> reduced;
+	if (factor > 1)
+	{
+		ReduceHeights(heights, width, height, factor, reduced, &map.width, &map.height);
+		heights = reduced.data();
+	}
+	else
+	{
+		map.width = width;
+		map.height = height;
+	}
+
+	size_t count = (size_t)map.width * map.height;
+	map.depths.resize(count);
+	map.coneRatios.assign(count, 1.0f);
+	for (size_t i = 0; i < count; ++i)
+		map.depths[i] = 1.0f - min(max(heights[i], 0.0f), 1.0f);
+
+	std::vector<XMFLOAT2> directions(max(settings.directionCount, 1u));
+	for (size_t d = 0; d < directions.size(); ++d)
+	{
+		float angle = XM_2PI * d / directions.size();
+		directions[d] = XMFLOAT2(cosf(angle), sinf(angle));
+	}
+
+	std::vector<float> reaches;
+	float step = powf(2.0f, 1.0f / max(settings.slopesPerOctave, 1u));
+	for (float reach = 1.0f; reach < 2.0f * max(map.width, map.height); reach *= step)
+		reaches.push_back(reach);
+
+	UINT taskCount = (map.height + CONE_STEP_MAP_ROWS_PER_TASK - 1) / CONE_STEP_MAP_ROWS_PER_TASK;
+	concurrency::parallel_for(0u, taskCount, [&](UINT task)
+	{
+		UINT lastRow = min((task + 1) * CONE_STEP_MAP_ROWS_PER_TASK, map.height);
+		for (UINT y = task * CONE_STEP_MAP_ROWS_PER_TASK; y < lastRow; ++y)
+		{
+			for (UINT x = 0; x < map.width; ++x)
+				map.coneRatios[(size_t)y * map.width + x] = RelaxedConeRatio(map, x, y, directions, reaches);
+		}
+	});
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	if (stats)
+	{
+		double sum = 0.0;
+		for (size_t i = 0; i < count; ++i)
+			sum += map.coneRatios[i];
+		stats->seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+		stats->fromCache = false;
+		stats->averageConeRatio = count ? (float)(sum / count) : 0.0f;
+	}
+}
+
+//---------------------------------------------------------------------------------
+// Loaded into a staging texture in R8G8B8A8 and read back through a map
+//---------------------------------------------------------------------------------
+HRESULT LoadHeightMapFromTexture(ID3D11Device* device, ID3D11DeviceContext* context, const WCHAR* fileName,
+	std::vector<float>& heights, UINT* width, UINT* height)
+{
+	HRESULT hr;
+
+	D3DX11_IMAGE_LOAD_INFO loadInfo;
+	loadInfo.Width = D3DX11_DEFAULT;
+	loadInfo.Height = D3DX11_DEFAULT;
+	loadInfo.Depth = D3DX11_DEFAULT;
+	loadInfo.FirstMipLevel = 0;
+	loadInfo.MipLevels = 1;
+	loadInfo.Usage = D3D11_USAGE_STAGING;
+	loadInfo.BindFlags = 0;
+	loadInfo.CpuAccessFlags = D3D11_CPU_ACCESS_READ;
+	loadInfo.MiscFlags = 0;
+	loadInfo.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	loadInfo.Filter = D3DX11_FILTER_NONE;
+	loadInfo.MipFilter = D3DX11_FILTER_NONE;
+	loadInfo.pSrcInfo = nullptr;
+
+	Microsoft::WRL::ComPtr<ID3D11Resource> resource;
+	V_RETURN(D3DX11CreateTextureFromFile(device, fileName, &loadInfo, nullptr, resource.GetAddressOf(), nullptr));
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	V_RETURN(resource.As(&texture));
+
+	D3D11_TEXTURE2D_DESC desc;
+	texture->GetDesc(&desc);
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	V_RETURN(context->Map(texture.Get(), 0, D3D11_MAP_READ, 0, &mapped));
+	heights.resize((size_t)desc.Width * desc.Height);
+	for (UINT y = 0; y < desc.Height; ++y)
+	{
+		const BYTE* row = (const BYTE*)mapped.pData + (size_t)y * mapped.RowPitch;
+		for (UINT x = 0; x < desc.Width; ++x)
+			heights[(size_t)y * desc.Width + x] = row[x * 4 + 3] / 255.0f;
+	}
+	context->Unmap(texture.Get(), 0);
+
+	*width = desc.Width;
+	*height = desc.Height;
+	return S_OK;
+}
+
+HRESULT LoadOrBuildConeStepMap(ID3D11Device* device, ID3D11DeviceContext* context, const WCHAR* mediaFileName,
+	const ConeStepMapSettings& settings, ConeStepMap& map, ConeStepMapStats* stats)
+{
+	HRESULT hr;
+
+	WCHAR path[MAX_PATH];
+	V_RETURN(DXUTFindDXSDKMediaFileCch(path, MAX_PATH, mediaFileName));
+
+	WIN32_FILE_ATTRIBUTE_DATA attributes;
+	if (!GetFileAttributesEx(path, GetFileExInfoStandard, &attributes))
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	CacheHeader header;
+	ZeroMemory(&header, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.version = CONE_STEP_MAP_CACHE_VERSION;
+	header.sourceSize = ((uint64_t)attributes.nFileSizeHigh << 32) | attributes.nFileSizeLow;
+	header.sourceWriteTime = ((uint64_t)attributes.ftLastWriteTime.dwHighDateTime << 32) | attributes.ftLastWriteTime.dwLowDateTime;
+	header.settings = settings;
+
+	WCHAR cachePath[MAX_PATH];
+	V_RETURN(StringCchPrintf(cachePath, MAX_PATH, L"%s.cone", path));
+
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+	if (SUCCEEDED(ReadCache(cachePath, header, map)))
+	{
+		QueryPerformanceCounter(&end);
+		QueryPerformanceFrequency(&frequency);
+		if (stats)
+		{
+			double sum = 0.0;
+			for (size_t i = 0; i < map.coneRatios.size(); ++i)
+				sum += map.coneRatios[i];
+			stats->seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+			stats->fromCache = true;
+			stats->averageConeRatio = map.coneRatios.empty() ? 0.0f : (float)(sum / map.coneRatios.size());
+		}
+		return S_OK;
+	}
+
+	std::vector<float> heights;
+	UINT width, height;
+	V_RETURN(LoadHeightMapFromTexture(device, context, path, heights, &width, &height));
+	BuildRelaxedConeStepMap(heights.data(), width, height, settings, map, stats);
+
+	// A read-only media directory only costs the cache
+	header.width = map.width;
+	header.height = map.height;
+	WriteCache(cachePath, header, map);
+	return S_OK;
+}
+
+HRESULT CreateConeStepTexture(ID3D11Device* device, const ConeStepMap& map, ID3D11ShaderResourceView** srv)
+{
+	HRESULT hr;
+
+	std::vector<uint16_t> texels((size_t)map.width * map.height * 2);
+	for (size_t i = 0; i < map.depths.size(); ++i)
+	{
+		// Truncated: a higher surface and a narrower cone only shorten the steps
+		texels[i * 2 + 0] = (uint16_t)(min(max(map.depths[i], 0.0f), 1.0f) * 65535.0f);
+		texels[i * 2 + 1] = (uint16_t)(sqrtf(min(max(map.coneRatios[i], 0.0f), 1.0f)) * 65535.0f);
+	}
+
+	CD3D11_TEXTURE2D_DESC desc(DXGI_FORMAT_R16G16_UNORM, map.width, map.height, 1, 1, D3D11_BIND_SHADER_RESOURCE,
+		D3D11_USAGE_IMMUTABLE);
+	D3D11_SUBRESOURCE_DATA initData = { texels.data(), map.width * 2 * sizeof(uint16_t), 0 };
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	V_RETURN(device->CreateTexture2D(&desc, &initData, texture.GetAddressOf()));
+	DXUT_SetDebugName(texture.Get(), "Cone step map");
+	return device->CreateShaderResourceView(texture.Get(), nullptr, srv);
+}
+
+//---------------------------------------------------------------------------------
+ParallaxRayHit MarchParallaxOcclusion(const ConeStepMap& map, const XMFLOAT2& texCoord,
+	const XMFLOAT2& parallaxOffset, UINT numSteps)
+{
+	ParallaxRayHit hit;
+	hit.fetches = 0;
+
+	float stepSize = 1.0f / numSteps;
+	float currentBound = 1.0f;
+	float previousHeight = 1.0f;
+	XMFLOAT2 offset = texCoord;
+	XMFLOAT2 pt1(0.0f, 0.0f), pt2(0.0f, 0.0f);
+
+	for (UINT step = 0; step < numSteps; ++step)
+	{
+		offset.x -= stepSize * parallaxOffset.x;
+		offset.y -= stepSize * parallaxOffset.y;
+		float currentHeight = 1.0f - SampleDepth(map, offset.x, offset.y);
+		hit.fetches++;
+		currentBound -= stepSize;
+
+		if (currentHeight > currentBound)
+		{
+			pt1 = XMFLOAT2(currentBound, currentHeight);
+			pt2 = XMFLOAT2(currentBound + stepSize, previousHeight);
+			break;
+		}
+		previousHeight = currentHeight;
+	}
+
+	float delta2 = pt2.x - pt2.y;
+	float delta1 = pt1.x - pt1.y;
+	float denominator = delta2 - delta1;
+	float parallaxAmount = denominator == 0.0f ? 0.0f : (pt1.x * delta2 - pt2.x * delta1) / denominator;
+
+	hit.depth = 1.0f - parallaxAmount;
+	hit.texCoord = XMFLOAT2(texCoord.x - parallaxOffset.x * hit.depth, texCoord.y - parallaxOffset.y * hit.depth);
+	return hit;
+}
+
+ParallaxRayHit MarchRelaxedConeSteps(const ConeStepMap& map, const XMFLOAT2& texCoord,
+	const XMFLOAT2& parallaxOffset, UINT coneSteps, UINT binarySteps)
+{
+	ParallaxRayHit hit;
+	hit.fetches = 0;
+
+	float distanceFactor = sqrtf(parallaxOffset.x * parallaxOffset.x + parallaxOffset.y * parallaxOffset.y);
+	float depth = 0.0f;
+	for (UINT step = 0; step < coneSteps; ++step)
+	{
+		size_t texel = TexelIndex(map, texCoord.x - parallaxOffset.x * depth, texCoord.y - parallaxOffset.y * depth);
+		hit.fetches++;
+		float ratio = map.coneRatios[texel];
+		float above = min(max(map.depths[texel] - depth, 0.0f), 1.0f);
+		if (above <= 0.0f)
+			break;
+		depth += ratio * above / (distanceFactor + ratio);
+	}
+
+	// The ray crossed the surface at most once on [0, depth].  The range reaches two texels
+	// further, for rays that stalled just short of a steep wall.
+	depth = min(depth + 2.0f / (distanceFactor * max(map.width, map.height) + FLT_EPSILON), 1.0f);
+	float range = 0.5f * depth;
+	float position = range;
+	for (UINT step = 0; step < binarySteps; ++step)
+	{
+		float surface = SampleDepth(map, texCoord.x - parallaxOffset.x * position, texCoord.y - parallaxOffset.y * position);
+		hit.fetches++;
+		range *= 0.5f;
+		position += position < surface ? range : -range;
+	}
+
+	hit.depth = position;
+	hit.texCoord = XMFLOAT2(texCoord.x - parallaxOffset.x * position, texCoord.y - parallaxOffset.y * position);
+	return hit;
+}
+
+//---------------------------------------------------------------------------------
+// RenderScenePS picks its step count from the angle to the normal; the reference
+// is a quarter texel linear search refined like the shader's last segment
+//---------------------------------------------------------------------------------
+ParallaxMarchComparison CompareParallaxMarching(const ConeStepMap& map, float heightScale, UINT minSamples,
+	UINT maxSamples, UINT coneSteps, UINT binarySteps, UINT rayCount, UINT seed)
+{
+	ParallaxMarchComparison result;
+	ZeroMemory(&result, sizeof(result));
+	result.rays = rayCount;
+	if (rayCount == 0 || map.depths.empty())
+		return result;
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	float minCos = cosf(XMConvertToRadians(85.0f));
+
+	double linearFetches = 0.0, coneFetches = 0.0, linearError = 0.0, coneError = 0.0;
+	for (UINT ray = 0; ray < rayCount; ++ray)
+	{
+		XMFLOAT2 texCoord(unit(generator), unit(generator));
+		float cosTheta = minCos + (1.0f - minCos) * unit(generator);
+		float azimuth = XM_2PI * unit(generator);
+		float parallaxLength = sqrtf(1.0f - cosTheta * cosTheta) / cosTheta * heightScale;
+		XMFLOAT2 parallaxOffset(cosf(azimuth) * parallaxLength, sinf(azimuth) * parallaxLength);
+
+		UINT numSteps = (UINT)(maxSamples + (float)((int)minSamples - (int)maxSamples) * cosTheta);
+		ParallaxRayHit reference = MarchParallaxOcclusion(map, texCoord, parallaxOffset, ReferenceSteps(map, parallaxOffset));
+		ParallaxRayHit linear = MarchParallaxOcclusion(map, texCoord, parallaxOffset, max(numSteps, 1u));
+		ParallaxRayHit cone = MarchRelaxedConeSteps(map, texCoord, parallaxOffset, coneSteps, binarySteps);
+
+		float linearTexels = sqrtf(powf((linear.texCoord.x - reference.texCoord.x) * map.width, 2.0f) +
+			powf((linear.texCoord.y - reference.texCoord.y) * map.height, 2.0f));
+		float coneTexels = sqrtf(powf((cone.texCoord.x - reference.texCoord.x) * map.width, 2.0f) +
+			powf((cone.texCoord.y - reference.texCoord.y) * map.height, 2.0f));
+
+		linearFetches += linear.fetches;
+		coneFetches += cone.fetches;
+		result.linearMaxFetches = max(result.linearMaxFetches, linear.fetches);
+		result.coneMaxFetches = max(result.coneMaxFetches, cone.fetches);
+		linearError += linearTexels;
+		coneError += coneTexels;
+		result.linearMaxError = max(result.linearMaxError, linearTexels);
+		result.coneMaxError = max(result.coneMaxError, coneTexels);
+	}
+
+	result.linearAverageFetches = linearFetches / rayCount;
+	result.coneAverageFetches = coneFetches / rayCount;
+	result.linearMeanError = (float)(linearError / rayCount);
+	result.coneMeanError = (float)(coneError / rayCount);
+	return result;
+}
@@ -0,0 +1,102 @@
+//--------------------------------------------------------------------------------------
+// File: ConeStepMap.h
+//
+// Relaxed cone step maps for the parallax occlusion mapping of POM.hlsl.  Every texel
+// of a height map gets the widest cone, apex on the surface and opening upwards, in
+// which a view ray starting above the texel crosses the surface at most once.  The
+// RELAXED_CONE_STEP_MAPPING pixel shader then jumps from cone to cone and finishes with
+// a binary search, a handful of fetches where the linear search of RenderScenePS needs
+// up to g_nMaxSamples.  The maps are built on the CPU and cached next to the texture.
+//--------------------------------------------------------------------------------------
+#ifndef CONE_STEP_MAP_H
+#define CONE_STEP_MAP_H
+
+#include <vector>
+#include <stdint.h>
+#include <DirectXMath.h>
+
+#define CONE_STEP_MAP_SLOT          3       // g_coneStepTexture in POM.hlsl
+#define CONE_STEP_MAP_ROWS_PER_TASK 8       // Rows of the map per parallel task
+#define CONE_STEP_MAP_CACHE_VERSION 1
+#define CONE_STEP_MAP_CONE_STEPS    12      // CONE_STEPS in POM.hlsl and DeferredRenderFirstPass.hlsl
+#define CONE_STEP_MAP_BINARY_STEPS  6       // BINARY_SEARCH_STEPS in POM.hlsl and DeferredRenderFirstPass.hlsl
+
+struct ConeStepMapSettings
+{
+	UINT directionCount;                // Azimuths of the rays cast from every texel
+	UINT slopesPerOctave;               // Ray slopes per doubling of the horizontal reach
+	UINT maxResolution;                 // Larger height maps are reduced to this, keeping the highest sample
+
+	static ConeStepMapSettings Default();
+};
+
+struct ConeStepMap
+{
+	UINT width;
+	UINT height;
+	std::vector<float> depths;          // 1 - height, row major
+	std::vector<float> coneRatios;      // Texture coordinate units per unit of depth, at most 1
+};
+
+struct ConeStepMapStats
+{
+	double seconds;                     // Build or cache load
+	bool fromCache;
+	float averageConeRatio;
+};
+
+// Builds the map of a width x height field of heights in [0, 1], which tiles
+void BuildRelaxedConeStepMap(const float* heights, UINT width, UINT height, const ConeStepMapSettings& settings,
+	ConeStepMap& map, ConeStepMapStats* stats = nullptr);
+
+// Reads the height (alpha) of a normal and height map
+HRESULT LoadHeightMapFromTexture(ID3D11Device* device, ID3D11DeviceContext* context, const WCHAR* fileName,
+	std::vector<float>& heights, UINT* width, UINT* height);
+
+// Loads the map of a media file from <file>.cone, or builds it and writes the cache.  The
+// cache is rebuilt when the texture's size or write time or the settings change.
+HRESULT LoadOrBuildConeStepMap(ID3D11Device* device, ID3D11DeviceContext* context, const WCHAR* mediaFileName,
+	const ConeStepMapSettings& settings, ConeStepMap& map, ConeStepMapStats* stats = nullptr);
+
+// R16G16_UNORM texture of the depths and the square roots of the cone ratios
+HRESULT CreateConeStepTexture(ID3D11Device* device, const ConeStepMap& map, ID3D11ShaderResourceView** srv);
+
+//--------------------------------------------------------------------------------------
+// CPU reference of the POM.hlsl searches, to measure them without a GPU.  A ray enters the
+// height field at texCoord at depth 0 and moves by -parallaxOffset (vParallaxOffsetTS) down
+// to depth 1.  Heights are sampled bilinearly and wrapped; the cone steps read the map's
+// texels like the point sampler.
+//--------------------------------------------------------------------------------------
+struct ParallaxRayHit
+{
+	DirectX::XMFLOAT2 texCoord;
+	float depth;
+	UINT fetches;                       // Texture samples taken
+};
+
+// RenderScenePS: numSteps linear steps, then the intersection of the last segment
+ParallaxRayHit MarchParallaxOcclusion(const ConeStepMap& map, const DirectX::XMFLOAT2& texCoord,
+	const DirectX::XMFLOAT2& parallaxOffset, UINT numSteps);
+
+// RenderScenePS with RELAXED_CONE_STEP_MAPPING
+ParallaxRayHit MarchRelaxedConeSteps(const ConeStepMap& map, const DirectX::XMFLOAT2& texCoord,
+	const DirectX::XMFLOAT2& parallaxOffset, UINT coneSteps, UINT binarySteps);
+
+struct ParallaxMarchComparison
+{
+	UINT rays;
+	double linearAverageFetches;
+	double coneAverageFetches;
+	UINT linearMaxFetches;              // What a diverging warp waits for
+	UINT coneMaxFetches;
+	float linearMeanError;              // Texels from a quarter texel linear search
+	float linearMaxError;
+	float coneMeanError;
+	float coneMaxError;
+};
+
+// Traces random rays, from straight down to 85 degrees off the normal, with both searches
+ParallaxMarchComparison CompareParallaxMarching(const ConeStepMap& map, float heightScale, UINT minSamples,
+	UINT maxSamples, UINT coneSteps, UINT binarySteps, UINT rayCount, UINT seed);
+
+#endif
@@ -726,6 +726,9 @@ void DXUTGetCallbackD3D11DeviceAcceptable( LPDXUTCALLBACKISD3D11DEVICEACCEPTABLE
 //          -starty:#               forces app to use # for the y coord of the window position for windowed mode
 //          -constantframetime:#    forces app to use constant frame time, where # is the time/frame in seconds
 //          -quitafterframe:x       forces app to quit after # frames
+//          -maxfps:#               limits the frame rate to # frames per second (see DXUTSetFrameRateLimit)
+//          -lowlatency             with -maxfps, waits before input is handled instead of after Present
+//          -framestatsdump:path    rewrites path with the frame time percentiles as JSON every second
 //          -noerrormsgboxes        prevents the display of message boxes generated by the framework so the application can be run without user interaction
 //          -nostats                prevents the display of the stats
 //          -relaunchmce            re-launches the MCE UI after the app exits
@@ -943,6 +946,30 @@ void DXUTParseCommandLine(__inout WCHAR* strCommandLine,
                 continue;
             }
 
+            if( DXUTIsNextArg( strCmdLine, L"maxfps" ) )
+            {
+                if( DXUTGetCmdParam( strCmdLine, strFlag ) )
+                {
+                    DXUTGetFramePacer()->SetTargetFPS( ( float )wcstod( strFlag, NULL ) );
+                    continue;
+                }
+            }
+
+            if( DXUTIsNextArg( strCmdLine, L"framestatsdump" ) )
+            {
+                if( DXUTGetCmdParam( strCmdLine, strFlag ) )
+                {
+                    DXUTFrameStatsStartJSONDump( strFlag, 1000 );
+                    continue;
+                }
+            }
+
+            if( DXUTIsNextArg( strCmdLine, L"lowlatency" ) )
+            {
+                DXUTGetFramePacer()->SetLowLatency( true );
+                continue;
+            }
+
             if( DXUTIsNextArg( strCmdLine, L"quitafterframe" ) )
             {
                 if( DXUTGetCmdParam( strCmdLine, strFlag ) )
@@ -1770,6 +1797,7 @@ HRESULT WINAPI DXUTMainLoop( HACCEL hAccel )
 
     // Now we're ready to receive and process Windows messages.
     bool bGotMsg;
+    bool bFrameWaited = false;
     MSG msg;
     msg.message = WM_NULL;
     PeekMessage( &msg, NULL, 0U, 0U, PM_NOREMOVE );
@@ -1791,8 +1819,21 @@ HRESULT WINAPI DXUTMainLoop( HACCEL hAccel )
         }
         else
         {
+            // In low latency mode wait for the frame's deadline first, then go around the
+            // loop again so the input that arrived during the wait is handled before the
+            // frame.  Messages are only dispatched here, between frames, so handlers such
+            // as Alt+Enter or WM_CLOSE never run in the middle of one.
+            CDXUTFramePacer* pFramePacer = DXUTGetFramePacer();
+            if( pFramePacer->IsLowLatency() && !bFrameWaited )
+            {
+                pFramePacer->WaitForNextFrame();
+                bFrameWaited = true;
+                continue;
+            }
+
             // Render a frame during idle time (no messages are waiting)
             DXUTRender3DEnvironment();
+            bFrameWaited = false;
         }
     }
 
@@ -3817,6 +3858,9 @@ void DXUTRender3DEnvironment11()
 {
     HRESULT hr;
 
+    // In low latency mode DXUTMainLoop has already waited for this frame
+    CDXUTFramePacer* pFramePacer = DXUTGetFramePacer();
+
     ID3D11Device* pd3dDevice = DXUTGetD3D11Device();
     if( NULL == pd3dDevice )
         return;
@@ -3829,6 +3873,10 @@ void DXUTRender3DEnvironment11()
     if( NULL == pSwapChain )
         return;
 
+    bool bRecordStats = !GetDXUTState().GetNoStats();
+    if( bRecordStats )
+        DXUTFrameStatsBeginFrame();
+
     if( DXUTIsRenderingPaused() || !DXUTIsActive() || GetDXUTState().GetRenderingOccluded() )
     {
         // Window is minimized/paused/occluded/or not exclusive so yield CPU time to other processes
@@ -3845,6 +3893,11 @@ void DXUTRender3DEnvironment11()
         fElapsedTime = GetDXUTState().GetTimePerFrame();
         fTime = DXUTGetTime() + fElapsedTime;
     }
+    else if( pFramePacer->GetSmoothElapsedTime() && pFramePacer->GetSmoothedFrameTime() > 0.0f )
+    {
+        // Hide the scheduling jitter of single frames from the app's animation
+        fElapsedTime = pFramePacer->GetSmoothedFrameTime();
+    }
 
     GetDXUTState().SetTime( fTime );
     GetDXUTState().SetAbsoluteTime( fAbsTime );
@@ -3911,8 +3964,16 @@ void DXUTRender3DEnvironment11()
         dwFlags = GetDXUTState().GetCurrentDeviceSettings()->d3d11.PresentFlags;
     UINT SyncInterval = GetDXUTState().GetCurrentDeviceSettings()->d3d11.SyncInterval;
 
+    if( bRecordStats )
+        DXUTFrameStatsEndFrame();
+
     // Show the frame on the primary surface.
     hr = pSwapChain->Present( SyncInterval, dwFlags );
+
+    // Limit the frame rate; the frame time statistics measure from Present to Present
+    pFramePacer->EndFrame();
+    if( !pFramePacer->IsLowLatency() )
+        pFramePacer->WaitForNextFrame();
     if( DXGI_STATUS_OCCLUDED == hr )
     {
         // There is a window covering our entire rendering area.
@@ -4319,6 +4380,12 @@ void WINAPI DXUTPause( bool bPauseTime, bool bPauseRendering )
         DXUTGetGlobalTimer()->Start();
     }
 
+    // The frames around a pause are not paced, so don't let the pacer count them as
+    // missed deadlines or feed the pause into the smoothed frame time
+    if( ( nPauseRenderingCount > 0 ) != GetDXUTState().GetRenderingPaused() ||
+        ( nPauseTimeCount > 0 ) != GetDXUTState().GetTimePaused() )
+        DXUTGetFramePacer()->Reset();
+
     GetDXUTState().SetRenderingPaused( nPauseRenderingCount > 0 );
     GetDXUTState().SetTimePaused( nPauseTimeCount > 0 );
 }
@@ -5329,21 +5396,24 @@ void DXUTUpdateFrameStats()
         GetDXUTState().SetFPS( fFPS );
         GetDXUTState().SetLastStatsUpdateTime( fAbsTime );
         GetDXUTState().SetLastStatsUpdateFrames( 0 );
-
-        WCHAR* pstrFPS = GetDXUTState().GetFPSStats();
-        swprintf_s( pstrFPS, 64, L"%0.2f fps ", fFPS );
     }
 }
 
 //--------------------------------------------------------------------------------------
 // Returns a string describing the current device.  If bShowFPS is true, then
 // the string contains the frames/sec.  If "-nostats" was used in 
-// the command line, the string will be blank
+// the command line, the string will be blank.  The string is only formatted here, so
+// frames that don't show it don't pay for it.
 //--------------------------------------------------------------------------------------
 LPCWSTR WINAPI DXUTGetFrameStats( bool bShowFPS )
 {
     WCHAR* pstrFrameStats = GetDXUTState().GetFrameStats();
-    WCHAR* pstrFPS = ( bShowFPS ) ? GetDXUTState().GetFPSStats() : L"";
+    WCHAR* pstrFPS = L"";
+    if( bShowFPS )
+    {
+        pstrFPS = GetDXUTState().GetFPSStats();
+        swprintf_s( pstrFPS, 64, L"%0.2f fps ", GetDXUTState().GetFPS() );
+    }
     swprintf_s( pstrFrameStats, 256, GetDXUTState().GetStaticFrameStats(), pstrFPS );
     return pstrFrameStats;
 }
@@ -5553,6 +5623,14 @@ void WINAPI DXUTSetWindowSettings( bool bCallDefWindowProc )
     GetDXUTState().SetCallDefWindowProc( bCallDefWindowProc );
 }
 
+void WINAPI DXUTSetFrameRateLimit( float fMaxFPS, bool bLowLatency, bool bSmoothElapsedTime )
+{
+    CDXUTFramePacer* pFramePacer = DXUTGetFramePacer();
+    pFramePacer->SetTargetFPS( fMaxFPS );
+    pFramePacer->SetLowLatency( bLowLatency );
+    pFramePacer->SetSmoothElapsedTime( bSmoothElapsedTime );
+}
+
 void WINAPI DXUTSetConstantFrameTime( bool bEnabled, float fTimePerFrame )
 {
     if( GetDXUTState().GetOverrideConstantFrameTime() )
@@ -5588,6 +5666,8 @@ void WINAPI DXUTShutdown( int nExitCode )
 
     DXUTCleanup3DEnvironment( true );
 
+    DXUTFrameStatsStopJSONDump();
+
     // Restore shortcut keys (Windows key, accessibility shortcuts) to original state
     // This is important to call here if the shortcuts are disabled, 
     // because accessibility setting changes are permanent.
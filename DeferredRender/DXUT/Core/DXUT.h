@@ -72,6 +72,8 @@
 #include <math.h>
 #include <limits.h>
 #include <stdio.h>
+#include <type_traits> // for CGrowableArray
+#include <utility>
 
 // CRT's memory leak detection
 #if defined(DEBUG) || defined(_DEBUG)
@@ -272,6 +274,7 @@ HRESULT WINAPI DXUTToggleREF();
 HRESULT WINAPI DXUTToggleWARP();
 void    WINAPI DXUTPause( bool bPauseTime, bool bPauseRendering );
 void    WINAPI DXUTSetConstantFrameTime( bool bConstantFrameTime, float fTimePerFrame = 0.0333f );
+void    WINAPI DXUTSetFrameRateLimit( float fMaxFPS, bool bLowLatency = false, bool bSmoothElapsedTime = false ); // 0 removes the limit
 void    WINAPI DXUTSetCursorSettings( bool bShowCursorWhenFullScreen = false, bool bClipCursorWhenFullScreen = false );
 void    WINAPI DXUTSetD3DVersionSupport( bool bAppCanUseD3D9 = true, bool bAppCanUseD3D11 = true );
 void    WINAPI DXUTSetHotkeyHandling( bool bAltEnterToToggleFullscreen = true, bool bEscapeToQuit = true, bool bPauseToToggleTimePause = true );
@@ -352,7 +355,10 @@ void      WINAPI DXUTDestroyState(); // Optional method to destroy DXUT's memory
 //--------------------------------------------------------------------------------------
 // DXUT core layer includes
 //--------------------------------------------------------------------------------------
+#include "DXUTarray.h"
+#include "DXUTframepacer.h"
 #include "DXUTmisc.h"
+#include "DXUTframestats.h"
 #include "DXUTDevice9.h"
 #include "DXUTDevice11.h"
 
@@ -0,0 +1,532 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTarray.h
+//
+// CGrowableArray, the growable array of the DXUT and the sample.  It only needs the
+// Windows types and the C runtime, so it is kept apart from DXUTmisc.h.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef DXUT_ARRAY_H
+#define DXUT_ARRAY_H
+
+//--------------------------------------------------------------------------------------
+// A growable array
+//
+// Capacity grows geometrically and is kept by Reset, so arrays that are refilled every
+// frame stop allocating once they reach their steady-state size.  Trivially copyable
+// elements are relocated and copied with memcpy/realloc, other elements are moved.
+// nInlineSize elements are stored inside the array itself before the first heap
+// allocation (small buffer optimisation); the default of 0 keeps the array pointer sized.
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> struct CGrowableArrayInlineStorage
+{
+    TYPE* InlineData() { return ( TYPE* )&m_InlineBuffer; }
+    const TYPE* InlineData() const { return ( const TYPE* )&m_InlineBuffer; }
+
+    typename std::aligned_storage<nInlineSize * sizeof( TYPE ), std::alignment_of<TYPE>::value>::type m_InlineBuffer;
+};
+
+template<typename TYPE> struct CGrowableArrayInlineStorage<TYPE, 0>
+{
+    TYPE* InlineData() { return NULL; }
+    const TYPE* InlineData() const { return NULL; }
+};
+
+template<typename TYPE, int nInlineSize = 0> class CGrowableArray : protected CGrowableArrayInlineStorage<TYPE, nInlineSize>
+{
+public:
+    CGrowableArray()  { Init(); }
+    CGrowableArray( const CGrowableArray& a ) { Init(); AddRange( a.m_pData, a.m_nSize ); }
+    CGrowableArray( CGrowableArray&& a ) { Init(); MoveFrom( a ); }
+    ~CGrowableArray() { RemoveAll(); }
+
+    const TYPE& operator[]( int nIndex ) const { return GetAt( nIndex ); }
+    TYPE& operator[]( int nIndex ) { return GetAt( nIndex ); }
+   
+    CGrowableArray& operator=( const CGrowableArray& a ) { if( this == &a ) return *this; Reset(); AddRange( a.m_pData, a.m_nSize ); return *this; }
+    CGrowableArray& operator=( CGrowableArray&& a ) { if( this == &a ) return *this; RemoveAll(); MoveFrom( a ); return *this; }
+
+    HRESULT SetSize( int nNewMaxSize );
+    HRESULT Add( const TYPE& value );
+    HRESULT Add( TYPE&& value );
+    HRESULT AddRange( const TYPE* pValues, int nCount );
+    HRESULT Insert( int nIndex, const TYPE& value );
+    HRESULT SetAt( int nIndex, const TYPE& value );
+    TYPE&   GetAt( int nIndex ) const { assert( nIndex >= 0 && nIndex < m_nSize ); return m_pData[nIndex]; }
+    int     GetSize() const { return m_nSize; }
+    int     GetCapacity() const { return m_nMaxSize; }
+    TYPE*   GetData() { return m_pData; }
+    const TYPE* GetData() const { return m_pData; }
+    bool    Contains( const TYPE& value ){ return ( -1 != IndexOf( value ) ); }
+
+    int     IndexOf( const TYPE& value ) { return ( m_nSize > 0 ) ? IndexOf( value, 0, m_nSize ) : -1; }
+    int     IndexOf( const TYPE& value, int iStart ) { return IndexOf( value, iStart, m_nSize - iStart ); }
+    int     IndexOf( const TYPE& value, int nIndex, int nNumElements );
+
+    int     LastIndexOf( const TYPE& value ) { return ( m_nSize > 0 ) ? LastIndexOf( value, m_nSize-1, m_nSize ) : -1; }
+    int     LastIndexOf( const TYPE& value, int nIndex ) { return LastIndexOf( value, nIndex, nIndex+1 ); }
+    int     LastIndexOf( const TYPE& value, int nIndex, int nNumElements );
+
+    HRESULT Remove( int nIndex );
+    HRESULT Reserve( int nCapacity ) { return SetSizeInternal( nCapacity ); }
+    void    RemoveAll() { SetSize(0); }
+    void	Reset() { DestroyRange( 0, m_nSize ); m_nSize = 0; }    // Keeps the memory
+    void    Swap( CGrowableArray& a );
+
+protected:
+    typedef typename std::is_trivially_copyable<TYPE>::type IsTrivial;
+
+    TYPE* m_pData;      // the actual array of data
+    int m_nSize;        // # of elements (upperBound - 1)
+    int m_nMaxSize;     // max allocated
+
+    void    Init() { m_pData = this->InlineData(); m_nSize = 0; m_nMaxSize = nInlineSize; }
+    bool    IsInline() const { return nInlineSize > 0 && m_pData == this->InlineData(); }
+    void    MoveFrom( CGrowableArray& a );
+    void    DestroyRange( int iStart, int iEnd ) { DestroyRange( iStart, iEnd, IsTrivial() ); }
+    void    DestroyRange( int, int, std::true_type ) {}
+    void    DestroyRange( int iStart, int iEnd, std::false_type ) { for( int i = iStart; i < iEnd; ++i ) m_pData[i].~TYPE(); }
+
+    static void Relocate( TYPE* pDest, TYPE* pSrc, int nCount, std::true_type );
+    static void Relocate( TYPE* pDest, TYPE* pSrc, int nCount, std::false_type );
+    static void CopyConstruct( TYPE* pDest, const TYPE* pSrc, int nCount, std::true_type );
+    static void CopyConstruct( TYPE* pDest, const TYPE* pSrc, int nCount, std::false_type );
+    TYPE*   Reallocate( int nNewMaxSize, std::true_type );
+    TYPE*   Reallocate( int nNewMaxSize, std::false_type );
+    void    InsertGap( int nIndex, TYPE&& value, std::true_type );
+    void    InsertGap( int nIndex, TYPE&& value, std::false_type );
+    void    RemoveGap( int nIndex, std::true_type );
+    void    RemoveGap( int nIndex, std::false_type );
+
+    HRESULT SetSizeInternal( int nNewMaxSize );  // This version doesn't call ctor or dtor.
+};
+
+
+
+//--------------------------------------------------------------------------------------
+// Implementation of CGrowableArray
+//--------------------------------------------------------------------------------------
+
+// Moves nCount elements to uninitialized memory that does not overlap the source; the
+// source elements are left destroyed
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::Relocate( TYPE* pDest, TYPE* pSrc, int nCount, std::true_type )
+{
+    memcpy( pDest, pSrc, sizeof( TYPE ) * nCount );
+}
+
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::Relocate( TYPE* pDest, TYPE* pSrc, int nCount, std::false_type )
+{
+    for( int i = 0; i < nCount; ++i )
+    {
+        ::new ( &pDest[i] ) TYPE( std::move( pSrc[i] ) );
+        pSrc[i].~TYPE();
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::CopyConstruct( TYPE* pDest, const TYPE* pSrc, int nCount, std::true_type )
+{
+    memcpy( pDest, pSrc, sizeof( TYPE ) * nCount );
+}
+
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::CopyConstruct( TYPE* pDest, const TYPE* pSrc, int nCount, std::false_type )
+{
+    for( int i = 0; i < nCount; ++i )
+        ::new ( &pDest[i] ) TYPE( pSrc[i] );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Returns a buffer of nNewMaxSize elements holding the current elements; the old buffer
+// is released.  Returns NULL and leaves the array untouched if out of memory.
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> TYPE* CGrowableArray <TYPE, nInlineSize>::Reallocate( int nNewMaxSize, std::true_type )
+{
+    // realloc can often extend the block in place
+    if( m_pData != NULL && !IsInline() )
+        return ( TYPE* )realloc( m_pData, nNewMaxSize * sizeof( TYPE ) );
+
+    return Reallocate( nNewMaxSize, std::false_type() );
+}
+
+template<typename TYPE, int nInlineSize> TYPE* CGrowableArray <TYPE, nInlineSize>::Reallocate( int nNewMaxSize, std::false_type )
+{
+    TYPE* pDataNew = ( TYPE* )malloc( nNewMaxSize * sizeof( TYPE ) );
+    if( pDataNew == NULL )
+        return NULL;
+
+    if( m_pData )
+    {
+        Relocate( pDataNew, m_pData, m_nSize, IsTrivial() );
+        if( !IsInline() )
+            free( m_pData );
+    }
+
+    return pDataNew;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Shifts the elements from nIndex up by one and constructs value at nIndex; the buffer
+// must have room for one more element
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::InsertGap( int nIndex, TYPE&& value, std::true_type )
+{
+    MoveMemory( &m_pData[nIndex + 1], &m_pData[nIndex], sizeof( TYPE ) * ( m_nSize - nIndex ) );
+    ::new ( &m_pData[nIndex] ) TYPE( std::move( value ) );
+}
+
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::InsertGap( int nIndex, TYPE&& value, std::false_type )
+{
+    ::new ( &m_pData[m_nSize] ) TYPE( std::move( m_pData[m_nSize - 1] ) );
+    for( int i = m_nSize - 1; i > nIndex; --i )
+        m_pData[i] = std::move( m_pData[i - 1] );
+    m_pData[nIndex] = std::move( value );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Destroys the element at nIndex and shifts the following elements down by one
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::RemoveGap( int nIndex, std::true_type )
+{
+    MoveMemory( &m_pData[nIndex], &m_pData[nIndex + 1], sizeof( TYPE ) * ( m_nSize - ( nIndex + 1 ) ) );
+}
+
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::RemoveGap( int nIndex, std::false_type )
+{
+    for( int i = nIndex; i < m_nSize - 1; ++i )
+        m_pData[i] = std::move( m_pData[i + 1] );
+    m_pData[m_nSize - 1].~TYPE();
+}
+
+
+//--------------------------------------------------------------------------------------
+// This version doesn't call ctor or dtor.
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::SetSizeInternal( int nNewMaxSize )
+{
+    if( nNewMaxSize < 0 || ( ( size_t )nNewMaxSize > INT_MAX / sizeof( TYPE ) ) )
+    {
+        assert( false );
+        return E_INVALIDARG;
+    }
+
+    if( nNewMaxSize == 0 )
+    {
+        // Shrink to 0 size & cleanup
+        if( m_pData && !IsInline() )
+            free( m_pData );
+
+        m_pData = this->InlineData();
+        m_nMaxSize = nInlineSize;
+        m_nSize = 0;
+    }
+    else if( m_pData == NULL || nNewMaxSize > m_nMaxSize )
+    {
+        // Grow array
+        int nGrowBy = ( m_nMaxSize == 0 ) ? 16 : m_nMaxSize;
+
+        // Limit nGrowBy to keep m_nMaxSize less than INT_MAX
+        if( ( UINT )m_nMaxSize + ( UINT )nGrowBy > ( UINT )INT_MAX )
+            nGrowBy = INT_MAX - m_nMaxSize;
+
+        nNewMaxSize = __max( nNewMaxSize, m_nMaxSize + nGrowBy );
+
+        // Verify that (nNewMaxSize * sizeof(TYPE)) is not greater than UINT_MAX or the realloc will overrun
+        if( sizeof( TYPE ) > UINT_MAX / ( UINT )nNewMaxSize )
+            return E_INVALIDARG;
+
+        TYPE* pDataNew = Reallocate( nNewMaxSize, IsTrivial() );
+        if( pDataNew == NULL )
+            return E_OUTOFMEMORY;
+
+        m_pData = pDataNew;
+        m_nMaxSize = nNewMaxSize;
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::SetSize( int nNewMaxSize )
+{
+    int nOldSize = m_nSize;
+
+    if( nOldSize > nNewMaxSize )
+    {
+        assert( m_pData );
+        if( m_pData )
+        {
+            // Removing elements. Call dtor.
+            DestroyRange( nNewMaxSize, nOldSize );
+        }
+    }
+
+    // Adjust buffer.  Shrinking can't fail; if growing fails the array keeps its old size.
+    HRESULT hr = SetSizeInternal( nNewMaxSize );
+    if( FAILED( hr ) )
+        return hr;
+
+    if( nOldSize < nNewMaxSize )
+    {
+        assert( m_pData );
+        if( m_pData )
+        {
+            // Adding elements. Call ctor.
+
+            for( int i = nOldSize; i < nNewMaxSize; ++i )
+                ::new ( &m_pData[i] ) TYPE;
+        }
+    }
+
+    m_nSize = nNewMaxSize;
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::Add( const TYPE& value )
+{
+    HRESULT hr;
+
+    if( m_nSize < m_nMaxSize )
+    {
+        ::new ( &m_pData[m_nSize] ) TYPE( value );
+        ++m_nSize;
+        return S_OK;
+    }
+
+    // value may be an element of this array, so copy it before the buffer moves
+    TYPE copy( value );
+    if( FAILED( hr = SetSizeInternal( m_nSize + 1 ) ) )
+        return hr;
+
+    assert( m_pData != NULL );
+
+    ::new ( &m_pData[m_nSize] ) TYPE( std::move( copy ) );
+    ++m_nSize;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::Add( TYPE&& value )
+{
+    HRESULT hr;
+
+    if( m_nSize < m_nMaxSize )
+    {
+        ::new ( &m_pData[m_nSize] ) TYPE( std::move( value ) );
+        ++m_nSize;
+        return S_OK;
+    }
+
+    TYPE moved( std::move( value ) );
+    if( FAILED( hr = SetSizeInternal( m_nSize + 1 ) ) )
+        return hr;
+
+    assert( m_pData != NULL );
+
+    ::new ( &m_pData[m_nSize] ) TYPE( std::move( moved ) );
+    ++m_nSize;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Appends nCount elements with a single capacity check; the source must not be part of
+// this array
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::AddRange( const TYPE* pValues, int nCount )
+{
+    HRESULT hr;
+
+    if( nCount <= 0 )
+        return S_OK;
+
+    assert( pValues < m_pData || pValues >= m_pData + m_nMaxSize );
+
+    if( nCount > INT_MAX - m_nSize )
+        return E_INVALIDARG;
+
+    if( FAILED( hr = SetSizeInternal( m_nSize + nCount ) ) )
+        return hr;
+
+    CopyConstruct( m_pData + m_nSize, pValues, nCount, IsTrivial() );
+    m_nSize += nCount;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::Insert( int nIndex, const TYPE& value )
+{
+    HRESULT hr;
+
+    // Validate index
+    if( nIndex < 0 ||
+        nIndex > m_nSize )
+    {
+        assert( false );
+        return E_INVALIDARG;
+    }
+
+    if( nIndex == m_nSize )
+        return Add( value );
+
+    // Prepare the buffer
+    TYPE copy( value );
+    if( FAILED( hr = SetSizeInternal( m_nSize + 1 ) ) )
+        return hr;
+
+    // Shift the array
+    InsertGap( nIndex, std::move( copy ), IsTrivial() );
+
+    // Increase the size
+    ++m_nSize;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::SetAt( int nIndex, const TYPE& value )
+{
+    // Validate arguments
+    if( nIndex < 0 ||
+        nIndex >= m_nSize )
+    {
+        assert( false );
+        return E_INVALIDARG;
+    }
+
+    m_pData[nIndex] = value;
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Searches for the specified value and returns the index of the first occurrence
+// within the section of the data array that extends from iStart and contains the 
+// specified number of elements. Returns -1 if value is not found within the given 
+// section.
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> int CGrowableArray <TYPE, nInlineSize>::IndexOf( const TYPE& value, int iStart, int nNumElements )
+{
+    // Validate arguments
+    if( iStart < 0 ||
+        iStart >= m_nSize ||
+        nNumElements < 0 ||
+        iStart + nNumElements > m_nSize )
+    {
+        assert( false );
+        return -1;
+    }
+
+    // Search
+    for( int i = iStart; i < ( iStart + nNumElements ); i++ )
+    {
+        if( value == m_pData[i] )
+            return i;
+    }
+
+    // Not found
+    return -1;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Searches for the specified value and returns the index of the last occurrence
+// within the section of the data array that contains the specified number of elements
+// and ends at iEnd. Returns -1 if value is not found within the given section.
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> int CGrowableArray <TYPE, nInlineSize>::LastIndexOf( const TYPE& value, int iEnd, int nNumElements )
+{
+    // Validate arguments
+    if( iEnd < 0 ||
+        iEnd >= m_nSize ||
+        nNumElements < 0 ||
+        iEnd - nNumElements < 0 )
+    {
+        assert( false );
+        return -1;
+    }
+
+    // Search
+    for( int i = iEnd; i > ( iEnd - nNumElements ); i-- )
+    {
+        if( value == m_pData[i] )
+            return i;
+    }
+
+    // Not found
+    return -1;
+}
+
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> HRESULT CGrowableArray <TYPE, nInlineSize>::Remove( int nIndex )
+{
+    if( nIndex < 0 ||
+        nIndex >= m_nSize )
+    {
+        assert( false );
+        return E_INVALIDARG;
+    }
+
+    // Compact the array and decrease the size
+    RemoveGap( nIndex, IsTrivial() );
+    --m_nSize;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::Swap( CGrowableArray& a )
+{
+    if( !IsInline() && !a.IsInline() )
+    {
+        std::swap( m_pData, a.m_pData );
+        std::swap( m_nSize, a.m_nSize );
+        std::swap( m_nMaxSize, a.m_nMaxSize );
+        return;
+    }
+
+    // Inline elements cannot change owner, so go through a temporary
+    CGrowableArray temp;
+    temp.MoveFrom( *this );
+    MoveFrom( a );
+    a.MoveFrom( temp );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Takes the elements of a, which is left empty and inline.  This array must hold no
+// elements and no heap buffer, as after Init or RemoveAll.  A heap buffer changes owner;
+// inline elements are relocated into this array's inline buffer, where they fit.
+//--------------------------------------------------------------------------------------
+template<typename TYPE, int nInlineSize> void CGrowableArray <TYPE, nInlineSize>::MoveFrom( CGrowableArray& a )
+{
+    assert( m_nSize == 0 && ( m_pData == NULL || IsInline() ) );
+
+    if( a.IsInline() )
+    {
+        Relocate( m_pData, a.m_pData, a.m_nSize, IsTrivial() );
+        m_nSize = a.m_nSize;
+        a.m_nSize = 0;
+        return;
+    }
+
+    m_pData = a.m_pData;
+    m_nSize = a.m_nSize;
+    m_nMaxSize = a.m_nMaxSize;
+    a.Init();
+}
+
+#endif
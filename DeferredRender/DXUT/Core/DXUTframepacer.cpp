@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTframepacer.cpp
+//
+// Frame pacing
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DXUTframepacer.h"
+
+//--------------------------------------------------------------------------------------
+CDXUTFramePacer::CDXUTFramePacer( IDXUTFrameClock* pClock )
+{
+    m_pClock = pClock;
+
+    m_fTargetFPS = 0.0f;
+    m_bLowLatency = false;
+    m_bSmoothElapsedTime = false;
+    m_fSmoothingFactor = 0.1;
+    m_llPeriod = 0;
+
+    // Start by spinning the last millisecond; Sleep measures how much more is needed
+    m_llSpinThreshold = m_pClock->GetTicksPerSecond() / 1000;
+
+    Reset();
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTFramePacer::Reset()
+{
+    m_llNextDeadline = 0;
+    m_bScheduled = false;
+    m_llLastWait = 0;
+    m_nMissedDeadlines = 0;
+    m_llLastFrameEnd = 0;
+    m_bHasLastFrameEnd = false;
+    m_fSmoothedFrameTime = 0.0;
+    m_nFrameTimes = 0;
+    m_iNextFrameTime = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTFramePacer::SetTargetFPS( float fFPS )
+{
+    m_fTargetFPS = max( fFPS, 0.0f );
+    m_llPeriod = ( m_fTargetFPS > 0.0f ) ? ( LONGLONG )( m_pClock->GetTicksPerSecond() / ( double )m_fTargetFPS ) : 0;
+    m_bScheduled = false;
+    m_nMissedDeadlines = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTFramePacer::WaitForNextFrame()
+{
+    m_llLastWait = 0;
+    if( m_llPeriod == 0 )
+        return;
+
+    LONGLONG llStart = m_pClock->GetTicks();
+
+    if( !m_bScheduled )
+    {
+        // First frame of the schedule
+        m_llNextDeadline = llStart;
+        m_bScheduled = true;
+    }
+    else if( llStart - m_llNextDeadline > m_llPeriod )
+    {
+        // More than a frame late; restart the schedule rather than catching up
+        m_nMissedDeadlines++;
+        m_llNextDeadline = llStart;
+    }
+
+    LONGLONG llRemaining = m_llNextDeadline - llStart;
+    if( llRemaining > m_llSpinThreshold )
+    {
+        LONGLONG llSleep = llRemaining - m_llSpinThreshold;
+        LONGLONG llBeforeSleep = m_pClock->GetTicks();
+        m_pClock->Sleep( llSleep );
+        LONGLONG llOversleep = m_pClock->GetTicks() - llBeforeSleep - llSleep;
+
+        // Spin for twice the recent oversleep, between 0.25ms and 4ms
+        LONGLONG llTicksPerSec = m_pClock->GetTicksPerSecond();
+        LONGLONG llTarget = max( llOversleep, 0 ) * 2;
+        m_llSpinThreshold = ( m_llSpinThreshold * 7 + llTarget ) / 8;
+        m_llSpinThreshold = max( m_llSpinThreshold, llTicksPerSec / 4000 );
+        m_llSpinThreshold = min( m_llSpinThreshold, llTicksPerSec / 250 );
+    }
+
+    while( m_pClock->GetTicks() < m_llNextDeadline )
+        m_pClock->Spin();
+
+    m_llLastWait = m_pClock->GetTicks() - llStart;
+    m_llNextDeadline += m_llPeriod;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTFramePacer::EndFrame()
+{
+    LONGLONG llNow = m_pClock->GetTicks();
+    if( m_bHasLastFrameEnd )
+    {
+        double fFrameTime = ( double )( llNow - m_llLastFrameEnd ) / ( double )m_pClock->GetTicksPerSecond();
+
+        m_FrameTimes[m_iNextFrameTime] = fFrameTime;
+        m_iNextFrameTime = ( m_iNextFrameTime + 1 ) % DXUT_FRAME_PACING_HISTORY;
+        m_nFrameTimes = min( m_nFrameTimes + 1, ( UINT )DXUT_FRAME_PACING_HISTORY );
+
+        if( m_fSmoothedFrameTime == 0.0 )
+            m_fSmoothedFrameTime = fFrameTime;
+        else
+            m_fSmoothedFrameTime += ( fFrameTime - m_fSmoothedFrameTime ) * m_fSmoothingFactor;
+    }
+    m_llLastFrameEnd = llNow;
+    m_bHasLastFrameEnd = true;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTFramePacer::GetStats( DXUT_FRAME_PACING_STATS* pStats ) const
+{
+    ZeroMemory( pStats, sizeof( DXUT_FRAME_PACING_STATS ) );
+
+    double fTicksPerSec = ( double )m_pClock->GetTicksPerSecond();
+    pStats->fSmoothedFrameTime = m_fSmoothedFrameTime;
+    pStats->fLastWaitTime = m_llLastWait / fTicksPerSec;
+    pStats->fSpinThreshold = m_llSpinThreshold / fTicksPerSec;
+    pStats->nMissedDeadlines = m_nMissedDeadlines;
+    pStats->nFrames = m_nFrameTimes;
+    if( m_nFrameTimes == 0 )
+        return;
+
+    double fSum = 0.0;
+    pStats->fMinFrameTime = m_FrameTimes[0];
+    pStats->fMaxFrameTime = m_FrameTimes[0];
+    for( UINT i = 0; i < m_nFrameTimes; i++ )
+    {
+        fSum += m_FrameTimes[i];
+        pStats->fMinFrameTime = min( pStats->fMinFrameTime, m_FrameTimes[i] );
+        pStats->fMaxFrameTime = max( pStats->fMaxFrameTime, m_FrameTimes[i] );
+    }
+    pStats->fMeanFrameTime = fSum / m_nFrameTimes;
+
+    double fSumSq = 0.0;
+    for( UINT i = 0; i < m_nFrameTimes; i++ )
+        fSumSq += ( m_FrameTimes[i] - pStats->fMeanFrameTime ) * ( m_FrameTimes[i] - pStats->fMeanFrameTime );
+    pStats->fFrameTimeVariance = fSumSq / m_nFrameTimes;
+    pStats->fFrameTimeStdDev = sqrt( pStats->fFrameTimeVariance );
+}
@@ -0,0 +1,120 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTframepacer.h
+//
+// Frame pacing: an FPS cap that sleeps and spins to each frame's deadline, and the
+// frame time statistics of the pacer.  The pacer only reads the time through
+// IDXUTFrameClock, so it runs without Windows against a fake clock.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef DXUT_FRAMEPACER_H
+#define DXUT_FRAMEPACER_H
+
+//--------------------------------------------------------------------------------------
+// Clock used by CDXUTFramePacer.  DXUT uses CDXUTHighResolutionClock of DXUTmisc.h;
+// CDXUTFakeFrameClock makes the pacer deterministic for tests.
+//--------------------------------------------------------------------------------------
+class IDXUTFrameClock
+{
+public:
+    virtual         ~IDXUTFrameClock() {}
+
+    virtual LONGLONG GetTicksPerSecond() = 0;
+    virtual LONGLONG GetTicks() = 0;
+    virtual void    Sleep( LONGLONG llTicks ) = 0;     // May oversleep
+    virtual void    Spin() = 0;                        // One iteration of a busy wait
+};
+
+// Time only moves when the pacer sleeps or spins, or when the caller advances it
+class CDXUTFakeFrameClock : public IDXUTFrameClock
+{
+public:
+                    CDXUTFakeFrameClock( LONGLONG llTicksPerSecond = 1000000, LONGLONG llOversleep = 0,
+                                         LONGLONG llSpinTicks = 1 )
+                    { m_llTicksPerSec = llTicksPerSecond; m_llNow = 0; m_llOversleep = llOversleep; m_llSpinTicks = llSpinTicks; }
+
+    virtual LONGLONG GetTicksPerSecond() { return m_llTicksPerSec; }
+    virtual LONGLONG GetTicks() { return m_llNow; }
+    virtual void    Sleep( LONGLONG llTicks ) { m_llNow += llTicks + m_llOversleep; }
+    virtual void    Spin() { m_llNow += m_llSpinTicks; }
+
+    void            Advance( LONGLONG llTicks ) { m_llNow += llTicks; }     // Simulated frame work
+
+protected:
+    LONGLONG m_llTicksPerSec;
+    LONGLONG m_llNow;
+    LONGLONG m_llOversleep;
+    LONGLONG m_llSpinTicks;
+};
+
+
+//--------------------------------------------------------------------------------------
+// Frame pacing.  With a target frame rate, WaitForNextFrame blocks until the frame's
+// deadline: it sleeps until the spin threshold before the deadline and busy waits the
+// rest.  The threshold adapts to how much the clock oversleeps.  A frame that starts more
+// than one period late is counted as missed and the schedule restarts from it, instead of
+// rendering a burst of frames to catch up.
+//
+// In low latency mode DXUT waits before sampling input and calling the frame move
+// callback instead of after Present, so input is as fresh as possible when it is used.
+// Use DXUTGetFramePacer() to get the instance used by DXUT.
+//--------------------------------------------------------------------------------------
+#define DXUT_FRAME_PACING_HISTORY 128
+
+struct DXUT_FRAME_PACING_STATS
+{
+    UINT   nFrames;                 // Frames in the history (up to DXUT_FRAME_PACING_HISTORY)
+    double fMeanFrameTime;          // Seconds between the ends of consecutive frames
+    double fFrameTimeVariance;      // Seconds^2
+    double fFrameTimeStdDev;
+    double fMinFrameTime;
+    double fMaxFrameTime;
+    double fSmoothedFrameTime;      // Exponential moving average
+    double fLastWaitTime;           // Seconds the last WaitForNextFrame blocked
+    double fSpinThreshold;
+    UINT   nMissedDeadlines;        // Since SetTargetFPS
+};
+
+class CDXUTFramePacer
+{
+public:
+                    CDXUTFramePacer( IDXUTFrameClock* pClock );          // Not owned
+
+    void            SetTargetFPS( float fFPS );     // 0 renders as fast as possible
+    float           GetTargetFPS() const { return m_fTargetFPS; }
+    void            SetLowLatency( bool bLowLatency ) { m_bLowLatency = bLowLatency; }
+    bool            IsLowLatency() const { return m_bLowLatency; }
+    void            SetSmoothElapsedTime( bool bSmooth ) { m_bSmoothElapsedTime = bSmooth; }   // Feed the smoothed frame time to the app
+    bool            GetSmoothElapsedTime() const { return m_bSmoothElapsedTime; }
+    void            SetSmoothingFactor( double fFactor ) { m_fSmoothingFactor = fFactor; }      // Weight of the newest frame, (0,1]
+
+    void            WaitForNextFrame();
+    void            EndFrame();     // Call once per frame after Present
+    void            Reset();        // Forget the schedule and history, e.g. after a pause
+
+    float           GetSmoothedFrameTime() const { return ( float )m_fSmoothedFrameTime; }
+    void            GetStats( DXUT_FRAME_PACING_STATS* pStats ) const;
+
+protected:
+    IDXUTFrameClock* m_pClock;
+
+    float m_fTargetFPS;
+    bool m_bLowLatency;
+    bool m_bSmoothElapsedTime;
+    double m_fSmoothingFactor;
+
+    LONGLONG m_llPeriod;            // Ticks per frame, 0 if uncapped
+    LONGLONG m_llNextDeadline;
+    bool m_bScheduled;              // false if the schedule has to restart
+    LONGLONG m_llSpinThreshold;
+    LONGLONG m_llLastWait;
+    UINT m_nMissedDeadlines;
+
+    LONGLONG m_llLastFrameEnd;
+    bool m_bHasLastFrameEnd;
+    double m_fSmoothedFrameTime;
+    double m_FrameTimes[DXUT_FRAME_PACING_HISTORY];
+    UINT m_nFrameTimes;
+    UINT m_iNextFrameTime;
+};
+
+#endif
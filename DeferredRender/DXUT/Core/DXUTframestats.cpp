@@ -0,0 +1,408 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTframestats.cpp
+//
+// Per-frame timing statistics
+//
+// The ring is written by the render thread only.  Each slot carries a sequence number
+// that is odd while the slot is written (a per-slot seqlock), so readers copy a slot and
+// retry if the sequence changed under them; neither side ever waits on the other.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include <process.h>
+
+#define DXUT_FRAME_STATS_MASK           ( DXUT_FRAME_STATS_HISTORY - 1 )
+#define DXUT_FRAME_STATS_READ_RETRIES   4
+
+struct DXUTFrameStatsSlot
+{
+    volatile LONG nSequence;
+    DXUT_FRAME_STATS_SAMPLE Sample;
+};
+
+struct DXUTFrameStatsState
+{
+    DXUTFrameStatsSlot m_Slots[DXUT_FRAME_STATS_HISTORY];
+    volatile LONG64 m_nPublishedFrames;     // Read by other threads
+
+    // Render thread only
+    UINT64 m_nFrames;
+    DXUT_FRAME_STATS_SAMPLE m_Pending;
+    double m_fMillisecondsPerTick;
+    LONGLONG m_llFrameStart;
+    LONGLONG m_llLastFrameEnd;
+    LONGLONG m_llPassStart[DXUT_FRAME_STATS_MAX_PASSES];
+
+    // Names are written before m_nPasses is raised and never change afterwards
+    WCHAR m_strPassNames[DXUT_FRAME_STATS_MAX_PASSES][DXUT_FRAME_STATS_MAX_PASS_NAME];
+    volatile LONG m_nPasses;
+
+    // JSON dump thread
+    HANDLE m_hDumpThread;
+    HANDLE m_hDumpStopEvent;
+    DWORD m_dwDumpIntervalMS;
+    WCHAR m_strDumpPath[MAX_PATH];
+
+    DXUTFrameStatsState()
+    {
+        ZeroMemory( this, sizeof( DXUTFrameStatsState ) );
+
+        LARGE_INTEGER qwTicksPerSec = { 0 };
+        QueryPerformanceFrequency( &qwTicksPerSec );
+        m_fMillisecondsPerTick = 1000.0 / ( double )qwTicksPerSec.QuadPart;
+    }
+};
+
+static DXUTFrameStatsState& GetDXUTFrameStatsState()
+{
+    // Using an accessor function gives control of the construction order
+    static DXUTFrameStatsState state;
+    return state;
+}
+
+static LONGLONG DXUTFrameStatsGetTicks()
+{
+    LARGE_INTEGER qwTime = { 0 };
+    QueryPerformanceCounter( &qwTime );
+    return qwTime.QuadPart;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Recording, render thread
+//--------------------------------------------------------------------------------------
+void WINAPI DXUTFrameStatsBeginFrame()
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    state.m_llFrameStart = DXUTFrameStatsGetTicks();
+}
+
+void WINAPI DXUTFrameStatsEndFrame()
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    LONGLONG llNow = DXUTFrameStatsGetTicks();
+
+    DXUT_FRAME_STATS_SAMPLE& pending = state.m_Pending;
+    pending.nFrameIndex = state.m_nFrames;
+    pending.fCPUTime = ( float )( ( llNow - state.m_llFrameStart ) * state.m_fMillisecondsPerTick );
+    pending.fPresentInterval = ( state.m_llLastFrameEnd != 0 ) ?
+        ( float )( ( llNow - state.m_llLastFrameEnd ) * state.m_fMillisecondsPerTick ) : pending.fCPUTime;
+    state.m_llLastFrameEnd = llNow;
+
+    // The interlocked increments are full barriers: the slot is odd before the sample is
+    // touched, and even again only after all of it is written
+    DXUTFrameStatsSlot& slot = state.m_Slots[state.m_nFrames & DXUT_FRAME_STATS_MASK];
+    InterlockedIncrement( &slot.nSequence );
+    slot.Sample = pending;
+    InterlockedIncrement( &slot.nSequence );
+
+    state.m_nFrames++;
+    InterlockedExchange64( &state.m_nPublishedFrames, ( LONG64 )state.m_nFrames );
+
+    ZeroMemory( pending.fPassTime, sizeof( pending.fPassTime ) );
+}
+
+UINT WINAPI DXUTFrameStatsRegisterPass( LPCWSTR strName )
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( strName == NULL )
+        return UINT_MAX;
+
+    UINT nPasses = ( UINT )state.m_nPasses;
+    for( UINT i = 0; i < nPasses; i++ )
+    {
+        if( wcsncmp( state.m_strPassNames[i], strName, DXUT_FRAME_STATS_MAX_PASS_NAME - 1 ) == 0 )
+            return i;
+    }
+
+    if( nPasses >= DXUT_FRAME_STATS_MAX_PASSES )
+        return UINT_MAX;
+
+    wcsncpy_s( state.m_strPassNames[nPasses], DXUT_FRAME_STATS_MAX_PASS_NAME, strName, _TRUNCATE );
+    InterlockedExchange( &state.m_nPasses, ( LONG )( nPasses + 1 ) );
+    return nPasses;
+}
+
+void WINAPI DXUTFrameStatsBeginPass( UINT nPass )
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( nPass < ( UINT )state.m_nPasses )
+        state.m_llPassStart[nPass] = DXUTFrameStatsGetTicks();
+}
+
+void WINAPI DXUTFrameStatsEndPass( UINT nPass )
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( nPass < ( UINT )state.m_nPasses )
+        state.m_Pending.fPassTime[nPass] += ( float )( ( DXUTFrameStatsGetTicks() - state.m_llPassStart[nPass] ) *
+                                                       state.m_fMillisecondsPerTick );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Reading, any thread
+//--------------------------------------------------------------------------------------
+UINT64 WINAPI DXUTFrameStatsGetFrameIndex()
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+
+    // A compare exchange that never succeeds is an atomic 64 bit read on 32 bit targets too
+    return ( UINT64 )InterlockedCompareExchange64( &state.m_nPublishedFrames, 0, 0 );
+}
+
+UINT WINAPI DXUTFrameStatsGetNumPasses()
+{
+    return ( UINT )GetDXUTFrameStatsState().m_nPasses;
+}
+
+LPCWSTR WINAPI DXUTFrameStatsGetPassName( UINT nPass )
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( nPass >= ( UINT )state.m_nPasses )
+        return L"";
+    return state.m_strPassNames[nPass];
+}
+
+UINT WINAPI DXUTFrameStatsGetHistory( DXUT_FRAME_STATS_SAMPLE* pSamples, UINT nMaxSamples )
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( pSamples == NULL )
+        return 0;
+
+    UINT64 nPublished = DXUTFrameStatsGetFrameIndex();
+    UINT nCopied = 0;
+    for( UINT64 nFrame = nPublished; nFrame > 0 && nCopied < nMaxSamples &&
+         nPublished - nFrame < DXUT_FRAME_STATS_HISTORY; nFrame-- )
+    {
+        const DXUTFrameStatsSlot& slot = state.m_Slots[( nFrame - 1 ) & DXUT_FRAME_STATS_MASK];
+
+        bool bCopied = false;
+        for( int nTry = 0; nTry < DXUT_FRAME_STATS_READ_RETRIES && !bCopied; nTry++ )
+        {
+            LONG nSequence = slot.nSequence;
+            if( nSequence & 1 )
+            {
+                YieldProcessor();
+                continue;
+            }
+            MemoryBarrier();
+            pSamples[nCopied] = slot.Sample;
+            MemoryBarrier();
+            bCopied = ( slot.nSequence == nSequence );
+        }
+
+        // Stop at the first slot the render thread has already reused or keeps writing;
+        // everything older is gone as well
+        if( !bCopied || pSamples[nCopied].nFrameIndex != nFrame - 1 )
+            break;
+        nCopied++;
+    }
+
+    return nCopied;
+}
+
+static int __cdecl DXUTFrameStatsCompareFloats( const void* pA, const void* pB )
+{
+    float fA = *( const float* )pA;
+    float fB = *( const float* )pB;
+    return ( fA < fB ) ? -1 : ( fA > fB ) ? 1 : 0;
+}
+
+// Nearest rank percentiles; sorts pValues in place
+static void DXUTFrameStatsComputePercentiles( float* pValues, UINT nValues, DXUT_FRAME_STATS_PERCENTILES* pResult )
+{
+    ZeroMemory( pResult, sizeof( DXUT_FRAME_STATS_PERCENTILES ) );
+    if( nValues == 0 )
+        return;
+
+    qsort( pValues, nValues, sizeof( float ), DXUTFrameStatsCompareFloats );
+
+    // Rank ceil( p * n ), one based
+    pResult->fP50 = pValues[( nValues * 50 + 99 ) / 100 - 1];
+    pResult->fP95 = pValues[( nValues * 95 + 99 ) / 100 - 1];
+    pResult->fP99 = pValues[( nValues * 99 + 99 ) / 100 - 1];
+    pResult->fMax = pValues[nValues - 1];
+}
+
+void WINAPI DXUTFrameStatsGetSummary( DXUT_FRAME_STATS_SUMMARY* pSummary )
+{
+    if( pSummary == NULL )
+        return;
+    ZeroMemory( pSummary, sizeof( DXUT_FRAME_STATS_SUMMARY ) );
+
+    // The snapshot and the scratch values live on the stack, so readers on any thread
+    // never allocate and never share state
+    DXUT_FRAME_STATS_SAMPLE Samples[DXUT_FRAME_STATS_HISTORY];
+    float fValues[DXUT_FRAME_STATS_HISTORY];
+
+    pSummary->nPasses = DXUTFrameStatsGetNumPasses();
+    pSummary->nFrameIndex = DXUTFrameStatsGetFrameIndex();
+    UINT nSamples = DXUTFrameStatsGetHistory( Samples, DXUT_FRAME_STATS_HISTORY );
+    pSummary->nFrames = nSamples;
+
+    for( UINT i = 0; i < nSamples; i++ )
+        fValues[i] = Samples[i].fCPUTime;
+    DXUTFrameStatsComputePercentiles( fValues, nSamples, &pSummary->CPUTime );
+
+    for( UINT i = 0; i < nSamples; i++ )
+        fValues[i] = Samples[i].fPresentInterval;
+    DXUTFrameStatsComputePercentiles( fValues, nSamples, &pSummary->PresentInterval );
+
+    for( UINT nPass = 0; nPass < pSummary->nPasses; nPass++ )
+    {
+        for( UINT i = 0; i < nSamples; i++ )
+            fValues[i] = Samples[i].fPassTime[nPass];
+        DXUTFrameStatsComputePercentiles( fValues, nSamples, &pSummary->PassTime[nPass] );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// JSON
+//--------------------------------------------------------------------------------------
+static bool DXUTFrameStatsAppend( char*& pCursor, char* pEnd, const char* strFormat, ... )
+{
+    if( pCursor == NULL )
+        return false;
+
+    va_list args;
+    va_start( args, strFormat );
+    int nWritten = _vsnprintf_s( pCursor, pEnd - pCursor, _TRUNCATE, strFormat, args );
+    va_end( args );
+
+    if( nWritten < 0 )
+    {
+        pCursor = NULL;
+        return false;
+    }
+    pCursor += nWritten;
+    return true;
+}
+
+static void DXUTFrameStatsAppendPercentiles( char*& pCursor, char* pEnd, const char* strName,
+                                             const DXUT_FRAME_STATS_PERCENTILES& percentiles )
+{
+    DXUTFrameStatsAppend( pCursor, pEnd, "\"%s\":{\"p50\":%.3f,\"p95\":%.3f,\"p99\":%.3f,\"max\":%.3f}",
+                          strName, percentiles.fP50, percentiles.fP95, percentiles.fP99, percentiles.fMax );
+}
+
+int WINAPI DXUTFrameStatsFormatJSON( char* strBuffer, UINT cchBuffer )
+{
+    if( strBuffer == NULL || cchBuffer == 0 )
+        return -1;
+
+    DXUT_FRAME_STATS_SUMMARY summary;
+    DXUTFrameStatsGetSummary( &summary );
+
+    char* pCursor = strBuffer;
+    char* pEnd = strBuffer + cchBuffer;
+    DXUTFrameStatsAppend( pCursor, pEnd, "{\"frame\":%I64u,\"frames\":%u,", summary.nFrameIndex, summary.nFrames );
+    DXUTFrameStatsAppendPercentiles( pCursor, pEnd, "cpu_ms", summary.CPUTime );
+    DXUTFrameStatsAppend( pCursor, pEnd, "," );
+    DXUTFrameStatsAppendPercentiles( pCursor, pEnd, "present_ms", summary.PresentInterval );
+    DXUTFrameStatsAppend( pCursor, pEnd, ",\"passes_ms\":{" );
+    for( UINT nPass = 0; nPass < summary.nPasses; nPass++ )
+    {
+        // Pass names are UTF-8 in the output, with the characters JSON reserves escaped
+        char strUTF8[DXUT_FRAME_STATS_MAX_PASS_NAME * 3];
+        char strEscaped[DXUT_FRAME_STATS_MAX_PASS_NAME * 6];
+        if( WideCharToMultiByte( CP_UTF8, 0, DXUTFrameStatsGetPassName( nPass ), -1, strUTF8, sizeof( strUTF8 ),
+                                 NULL, NULL ) == 0 )
+            strUTF8[0] = 0;
+        char* pOut = strEscaped;
+        for( const char* pIn = strUTF8; *pIn != 0; pIn++ )
+        {
+            if( *pIn == '"' || *pIn == '\\' )
+                *pOut++ = '\\';
+            *pOut++ = ( ( unsigned char )*pIn < 0x20 ) ? ' ' : *pIn;
+        }
+        *pOut = 0;
+
+        if( nPass > 0 )
+            DXUTFrameStatsAppend( pCursor, pEnd, "," );
+        DXUTFrameStatsAppendPercentiles( pCursor, pEnd, strEscaped, summary.PassTime[nPass] );
+    }
+    DXUTFrameStatsAppend( pCursor, pEnd, "}}\n" );
+
+    if( pCursor == NULL )
+    {
+        strBuffer[0] = 0;
+        return -1;
+    }
+    return ( int )( pCursor - strBuffer );
+}
+
+static void DXUTFrameStatsWriteJSONFile( const WCHAR* strPath )
+{
+    char strJSON[4096];
+    int nLength = DXUTFrameStatsFormatJSON( strJSON, sizeof( strJSON ) );
+    if( nLength < 0 )
+        return;
+
+    WCHAR strTempPath[MAX_PATH];
+    if( swprintf_s( strTempPath, MAX_PATH, L"%s.tmp", strPath ) < 0 )
+        return;
+
+    HANDLE hFile = CreateFileW( strTempPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    if( hFile == INVALID_HANDLE_VALUE )
+        return;
+    DWORD dwWritten = 0;
+    BOOL bWritten = WriteFile( hFile, strJSON, ( DWORD )nLength, &dwWritten, NULL );
+    CloseHandle( hFile );
+
+    if( bWritten && dwWritten == ( DWORD )nLength )
+        MoveFileExW( strTempPath, strPath, MOVEFILE_REPLACE_EXISTING );
+    else
+        DeleteFileW( strTempPath );
+}
+
+static unsigned __stdcall DXUTFrameStatsDumpThread( void* pParam )
+{
+    DXUTFrameStatsState& state = *( DXUTFrameStatsState* )pParam;
+    while( WaitForSingleObject( state.m_hDumpStopEvent, state.m_dwDumpIntervalMS ) == WAIT_TIMEOUT )
+        DXUTFrameStatsWriteJSONFile( state.m_strDumpPath );
+
+    // Leave the final numbers behind
+    DXUTFrameStatsWriteJSONFile( state.m_strDumpPath );
+    return 0;
+}
+
+HRESULT WINAPI DXUTFrameStatsStartJSONDump( LPCWSTR strPath, DWORD dwIntervalMS )
+{
+    if( strPath == NULL || strPath[0] == 0 || dwIntervalMS == 0 )
+        return E_INVALIDARG;
+
+    DXUTFrameStatsStopJSONDump();
+
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( wcscpy_s( state.m_strDumpPath, MAX_PATH, strPath ) != 0 )
+        return E_INVALIDARG;
+    state.m_dwDumpIntervalMS = dwIntervalMS;
+
+    state.m_hDumpStopEvent = CreateEvent( NULL, TRUE, FALSE, NULL );
+    if( state.m_hDumpStopEvent == NULL )
+        return DXUT_ERR_MSGBOX( L"CreateEvent", HRESULT_FROM_WIN32( GetLastError() ) );
+
+    state.m_hDumpThread = ( HANDLE )_beginthreadex( NULL, 0, DXUTFrameStatsDumpThread, &state, 0, NULL );
+    if( state.m_hDumpThread == NULL )
+    {
+        CloseHandle( state.m_hDumpStopEvent );
+        state.m_hDumpStopEvent = NULL;
+        return DXUT_ERR_MSGBOX( L"_beginthreadex", E_FAIL );
+    }
+
+    return S_OK;
+}
+
+void WINAPI DXUTFrameStatsStopJSONDump()
+{
+    DXUTFrameStatsState& state = GetDXUTFrameStatsState();
+    if( state.m_hDumpThread == NULL )
+        return;
+
+    SetEvent( state.m_hDumpStopEvent );
+    WaitForSingleObject( state.m_hDumpThread, INFINITE );
+    CloseHandle( state.m_hDumpThread );
+    CloseHandle( state.m_hDumpStopEvent );
+    state.m_hDumpThread = NULL;
+    state.m_hDumpStopEvent = NULL;
+}
@@ -0,0 +1,79 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTframestats.h
+//
+// Per-frame timing statistics.  The render thread records one sample per frame (CPU
+// time, present interval and the CPU time of each registered pass) into a fixed ring;
+// any thread can read the ring without locking and get rolling percentiles, and a
+// background thread can dump them as JSON for monitoring.  Nothing is allocated or
+// formatted per frame.
+//
+// All times are in milliseconds.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef DXUT_FRAMESTATS_H
+#define DXUT_FRAMESTATS_H
+
+#define DXUT_FRAME_STATS_HISTORY        256     // Frames in the ring, a power of two
+#define DXUT_FRAME_STATS_MAX_PASSES     8
+#define DXUT_FRAME_STATS_MAX_PASS_NAME  32
+
+struct DXUT_FRAME_STATS_SAMPLE
+{
+    UINT64 nFrameIndex;
+    float  fCPUTime;                                    // From DXUTFrameStatsBeginFrame to DXUTFrameStatsEndFrame
+    float  fPresentInterval;                            // Between the ends of consecutive frames
+    float  fPassTime[DXUT_FRAME_STATS_MAX_PASSES];      // Summed over the pass's begin/end pairs of the frame
+};
+
+struct DXUT_FRAME_STATS_PERCENTILES
+{
+    float fP50;
+    float fP95;
+    float fP99;
+    float fMax;
+};
+
+struct DXUT_FRAME_STATS_SUMMARY
+{
+    UINT64 nFrameIndex;             // Frames recorded since startup
+    UINT   nFrames;                 // Frames the percentiles are computed over
+    DXUT_FRAME_STATS_PERCENTILES CPUTime;
+    DXUT_FRAME_STATS_PERCENTILES PresentInterval;
+    UINT   nPasses;
+    DXUT_FRAME_STATS_PERCENTILES PassTime[DXUT_FRAME_STATS_MAX_PASSES];
+};
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Render thread.  DXUT calls BeginFrame/EndFrame around the frame (EndFrame right before Present).
+void    WINAPI DXUTFrameStatsBeginFrame();
+void    WINAPI DXUTFrameStatsEndFrame();
+// Returns the index of the pass with this name, registering it if needed, or UINT_MAX when all
+// DXUT_FRAME_STATS_MAX_PASSES are in use.  Begin/EndPass with an invalid index do nothing.
+UINT    WINAPI DXUTFrameStatsRegisterPass( LPCWSTR strName );
+void    WINAPI DXUTFrameStatsBeginPass( UINT nPass );
+void    WINAPI DXUTFrameStatsEndPass( UINT nPass );
+
+// Any thread
+UINT64  WINAPI DXUTFrameStatsGetFrameIndex();
+UINT    WINAPI DXUTFrameStatsGetNumPasses();
+LPCWSTR WINAPI DXUTFrameStatsGetPassName( UINT nPass );
+// Copies up to nMaxSamples of the most recent samples, newest first, and returns how many were copied
+UINT    WINAPI DXUTFrameStatsGetHistory( DXUT_FRAME_STATS_SAMPLE* pSamples, UINT nMaxSamples );
+void    WINAPI DXUTFrameStatsGetSummary( DXUT_FRAME_STATS_SUMMARY* pSummary );
+// Writes the summary as a null terminated UTF-8 JSON object.  Returns the length without the
+// terminator, or -1 if the buffer is too small.
+int     WINAPI DXUTFrameStatsFormatJSON( char* strBuffer, UINT cchBuffer );
+
+// Rewrites strPath with the JSON summary every dwIntervalMS from a background thread.  The file
+// is written next to strPath and moved over it, so readers never see a partial file.
+HRESULT WINAPI DXUTFrameStatsStartJSONDump( LPCWSTR strPath, DWORD dwIntervalMS );
+void    WINAPI DXUTFrameStatsStopJSONDump();
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
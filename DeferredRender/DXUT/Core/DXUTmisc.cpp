@@ -201,6 +201,77 @@ void CDXUTTimer::LimitThreadAffinityToCurrentProc()
 }
 
 
+//--------------------------------------------------------------------------------------
+// CDXUTHighResolutionClock
+//--------------------------------------------------------------------------------------
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+
+CDXUTHighResolutionClock::CDXUTHighResolutionClock()
+{
+    LARGE_INTEGER qwTicksPerSec = { 0 };
+    QueryPerformanceFrequency( &qwTicksPerSec );
+    m_llQPFTicksPerSec = qwTicksPerSec.QuadPart;
+
+    // Older versions of Windows reject the high resolution flag
+    m_hTimer = CreateWaitableTimerExW( NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS );
+    m_bHighResolution = ( m_hTimer != NULL );
+    if( m_hTimer == NULL )
+        m_hTimer = CreateWaitableTimerExW( NULL, NULL, 0, TIMER_ALL_ACCESS );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTHighResolutionClock::~CDXUTHighResolutionClock()
+{
+    if( m_hTimer )
+        CloseHandle( m_hTimer );
+}
+
+
+//--------------------------------------------------------------------------------------
+LONGLONG CDXUTHighResolutionClock::GetTicks()
+{
+    LARGE_INTEGER qwTime = { 0 };
+    QueryPerformanceCounter( &qwTime );
+    return qwTime.QuadPart;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTHighResolutionClock::Sleep( LONGLONG llTicks )
+{
+    if( llTicks <= 0 )
+        return;
+
+    if( m_hTimer == NULL )
+    {
+        ::Sleep( ( DWORD )( llTicks * 1000 / m_llQPFTicksPerSec ) );
+        return;
+    }
+
+    // Relative due time in 100ns units
+    LARGE_INTEGER liDueTime;
+    liDueTime.QuadPart = -( llTicks * 10000000 / m_llQPFTicksPerSec );
+    if( liDueTime.QuadPart == 0 )
+        return;
+
+    if( SetWaitableTimer( m_hTimer, &liDueTime, 0, NULL, NULL, FALSE ) )
+        WaitForSingleObject( m_hTimer, INFINITE );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTFramePacer* WINAPI DXUTGetFramePacer()
+{
+    // Using an accessor function gives control of the construction order
+    static CDXUTHighResolutionClock clock;
+    static CDXUTFramePacer pacer( &clock );
+    return &pacer;
+}
+
+
 //--------------------------------------------------------------------------------------
 // Returns the string for the given D3DFORMAT.
 //--------------------------------------------------------------------------------------
@@ -38,6 +38,14 @@
 
 #define DXUT_MAX_GUI_SPRITES 500
 
+// Color blends that had not reached their target when last updated, see DXUTBlendColor::Blend
+static UINT g_nBlendsInProgress = 0;
+
+// Dialogs with fewer controls are hit-tested linearly
+#define DXUT_HITGRID_MIN_CONTROLS 16
+#define DXUT_HITGRID_MIN_CELL_SIZE 16
+#define DXUT_HITGRID_MAX_CELLS_PER_AXIS 64
+
 D3DCOLORVALUE D3DCOLOR_TO_D3DCOLORVALUE( D3DCOLOR c )
 {
     D3DCOLORVALUE cv =
@@ -198,13 +206,6 @@ struct DXUT_SCREEN_VERTEX_UNTEX
 DWORD                   DXUT_SCREEN_VERTEX_UNTEX::FVF = D3DFVF_XYZRHW | D3DFVF_DIFFUSE;
 
 
-struct DXUT_SCREEN_VERTEX_10
-{
-    float x, y, z;
-    D3DCOLORVALUE color;
-    float tu, tv;
-};
-
 
 inline int RectWidth( RECT& rc )
 {
@@ -216,7 +217,8 @@ inline int RectHeight( RECT& rc )
 }
 
 
-HRESULT InitFont11( ID3D11Device* pd3d11Device, ID3D11InputLayout* pInputLayout );
+HRESULT InitFont11( ID3D11Device* pd3d11Device, ID3D11InputLayout* pInputLayout, CDXUTUIBatch* pBatch );
+void EndFrameText11();
 void EndFont11();
 
 //--------------------------------------------------------------------------------------
@@ -258,6 +260,13 @@ CDXUTDialog::CDXUTDialog()
     m_bNonUserEvents = false;
     m_bKeyboardInput = false;
     m_bMouseInput = true;
+
+    m_bHitGridEnabled = true;
+    m_bHitGridDirty = true;
+
+    m_bRetained = true;
+    m_bRetainedDirty = true;
+    m_nRetainedGeneration = 0;
 }
 
 
@@ -352,6 +361,8 @@ void CDXUTDialog::RemoveControl( int ID )
 
             SAFE_DELETE( pControl );
             m_Controls.Remove( i );
+            m_bHitGridDirty = true;
+            Invalidate();
 
             return;
         }
@@ -375,6 +386,8 @@ void CDXUTDialog::RemoveAllControls()
     }
 
     m_Controls.RemoveAll();
+    m_bHitGridDirty = true;
+    Invalidate();
 }
 
 
@@ -403,8 +416,10 @@ CDXUTDialogResourceManager::CDXUTDialogResourceManager()
     m_pSamplerStateStored11 = NULL;
 
     m_pInputLayout11 = NULL;
-    m_pVBScreenQuad11 = NULL;
-    m_pSpriteBuffer11 = NULL;
+
+    m_nRetainedGeneration11 = 1;
+    ZeroMemory( &m_GUIStats11, sizeof( m_GUIStats11 ) );
+    ZeroMemory( &m_LastGUIStats11, sizeof( m_LastGUIStats11 ) );
 }
 
 
@@ -536,6 +551,7 @@ HRESULT CDXUTDialogResourceManager::OnD3D11CreateDevice( ID3D11Device* pd3dDevic
 {
     m_pd3d11Device = pd3dDevice;
     m_pd3d11DeviceContext = pd3d11DeviceContext;
+    m_nRetainedGeneration11++;
 
     HRESULT hr = S_OK;
 
@@ -648,18 +664,11 @@ HRESULT CDXUTDialogResourceManager::OnD3D11CreateDevice( ID3D11Device* pd3dDevic
     SAFE_RELEASE( pPSBlob );
     SAFE_RELEASE( pPSUntexBlob );
 
-    // Create a vertex buffer quad for rendering later
-    D3D11_BUFFER_DESC BufDesc;
-    BufDesc.ByteWidth = sizeof( DXUT_SCREEN_VERTEX_10 ) * 4;
-    BufDesc.Usage = D3D11_USAGE_DYNAMIC;
-    BufDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-    BufDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-    BufDesc.MiscFlags = 0;
-    V_RETURN( pd3dDevice->CreateBuffer( &BufDesc, NULL, &m_pVBScreenQuad11 ) );
-    DXUT_SetDebugName( m_pVBScreenQuad11, "CDXUTDialogResourceManager" );
+    // The UI batch creates its ring buffer on the first flush
+    m_UIBatchContext11.Init( this );
 
     // Init the D3D11 font
-    InitFont11( pd3dDevice, m_pInputLayout11 );
+    InitFont11( pd3dDevice, m_pInputLayout11, &m_UIBatch11 );
 
     return S_OK;
 }
@@ -673,6 +682,7 @@ HRESULT CDXUTDialogResourceManager::OnD3D11ResizedSwapChain( ID3D11Device* pd3dD
 
     m_nBackBufferWidth = pBackBufferSurfaceDesc->Width;
     m_nBackBufferHeight = pBackBufferSurfaceDesc->Height;
+    m_nRetainedGeneration11++;
 
     return hr;
 }
@@ -700,9 +710,9 @@ void CDXUTDialogResourceManager::OnD3D11DestroyDevice()
     }
 
     // D3D11
-    SAFE_RELEASE( m_pVBScreenQuad11 );
-    SAFE_RELEASE( m_pSpriteBuffer11 );
-    m_SpriteBufferBytes11 = 0;
+    m_UIBatch11.Reset();
+    m_UIBatchContext11.Destroy();
+    m_nRetainedGeneration11++;
     SAFE_RELEASE( m_pInputLayout11 );
 
     // Shaders
@@ -784,56 +794,20 @@ void CDXUTDialogResourceManager::ApplyRenderUIUntex11( ID3D11DeviceContext* pd3d
 }
 
 //--------------------------------------------------------------------------------------
-void CDXUTDialogResourceManager::BeginSprites11( )
+void CDXUTDialogResourceManager::EndFrame11()
 {
-    m_SpriteVertices.Reset();
-}
-
-//--------------------------------------------------------------------------------------
-void CDXUTDialogResourceManager::EndSprites11( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext )
-{
-
-    // ensure our buffer size can hold our sprites
-    UINT SpriteDataBytes = m_SpriteVertices.GetSize() * sizeof( DXUTSpriteVertex );
-    if( m_SpriteBufferBytes11 < SpriteDataBytes )
+    if( m_UIBatch11.GetNumQueuedVertices() > 0 && m_pd3d11DeviceContext )
     {
-        SAFE_RELEASE( m_pSpriteBuffer11 );
-        m_SpriteBufferBytes11 = SpriteDataBytes;
-
-        D3D11_BUFFER_DESC BufferDesc;
-        BufferDesc.ByteWidth = m_SpriteBufferBytes11;
-        BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-        BufferDesc.MiscFlags = 0;
-
-        pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pSpriteBuffer11 );
-        DXUT_SetDebugName( m_pSpriteBuffer11, "CDXUTDialogResourceManager" );
+        StoreD3D11State( m_pd3d11DeviceContext );
+        ApplyRenderUI11( m_pd3d11DeviceContext );
+        m_UIBatch11.Flush( &m_UIBatchContext11 );
+        RestoreD3D11State( m_pd3d11DeviceContext );
     }
 
-    // Copy the sprites over
-    D3D11_BOX destRegion;
-    destRegion.left = 0;
-    destRegion.right = SpriteDataBytes;
-    destRegion.top = 0;
-    destRegion.bottom = 1;
-    destRegion.front = 0;
-    destRegion.back = 1;
-    D3D11_MAPPED_SUBRESOURCE MappedResource;
-    if ( S_OK == pd3dImmediateContext->Map( m_pSpriteBuffer11, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) ) { 
-        CopyMemory( MappedResource.pData, (void*)m_SpriteVertices.GetData(), SpriteDataBytes );
-        pd3dImmediateContext->Unmap(m_pSpriteBuffer11, 0);
-    }
+    EndFrameText11();
 
-    // Draw
-    UINT Stride = sizeof( DXUTSpriteVertex );
-    UINT Offset = 0;
-    pd3dImmediateContext->IASetVertexBuffers( 0, 1, &m_pSpriteBuffer11, &Stride, &Offset );
-    pd3dImmediateContext->IASetInputLayout( m_pInputLayout11 );
-    pd3dImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-    pd3dImmediateContext->Draw( m_SpriteVertices.GetSize(), 0 );
-
-    m_SpriteVertices.Reset();
+    m_LastGUIStats11 = m_GUIStats11;
+    ZeroMemory( &m_GUIStats11, sizeof( m_GUIStats11 ) );
 }
 
 //--------------------------------------------------------------------------------------
@@ -916,6 +890,8 @@ void CDXUTDialog::Refresh()
 
     if( m_bKeyboardInput )
         FocusDefaultControl();
+
+    Invalidate();
 }
 
 
@@ -1082,12 +1058,71 @@ HRESULT CDXUTDialog::OnRender11( float fElapsedTime )
         ( m_bMinimized && !m_bCaption ) )
         return S_OK;
 
+    LARGE_INTEGER qwStart, qwEnd, qwFrequency;
+    QueryPerformanceCounter( &qwStart );
+
+    DXUTGUIRenderStats11& stats = m_pManager->m_GUIStats11;
+    CDXUTUIBatch* pBatch = &m_pManager->m_UIBatch11;
+    HRESULT hr = S_OK;
+
+    stats.nDialogs++;
+    if( m_bRetained && !m_bRetainedDirty && m_nRetainedGeneration == m_pManager->m_nRetainedGeneration11 )
+    {
+        // Nothing changed since the vertices were recorded
+        m_Retained11.Submit( pBatch );
+        stats.nDialogsReplayed++;
+        stats.nVerticesReplayed += m_Retained11.GetNumVertices();
+    }
+    else if( m_bRetained )
+    {
+        m_bRetainedDirty = false;
+        g_nBlendsInProgress = 0;
+
+        pBatch->BeginRecording( &m_Retained11 );
+        hr = RenderUI11( fElapsedTime );
+        pBatch->EndRecording();
+        m_nRetainedGeneration = m_pManager->m_nRetainedGeneration11;
+
+        // Colors still blending or controls animating by themselves must be rendered again
+        if( g_nBlendsInProgress > 0 )
+            m_bRetainedDirty = true;
+        for( int i = 0; i < m_Controls.GetSize() && !m_bRetainedDirty; i++ )
+        {
+            CDXUTControl* pControl = m_Controls.GetAt( i );
+            if( pControl->GetVisible() && pControl->IsAnimating() )
+                m_bRetainedDirty = true;
+        }
+
+        stats.nDialogsRegenerated++;
+        stats.nVerticesRegenerated += m_Retained11.GetNumVertices();
+    }
+    else
+    {
+        UINT nQueuedVertices = pBatch->GetNumQueuedVertices();
+        hr = RenderUI11( fElapsedTime );
+        stats.nDialogsRegenerated++;
+        stats.nVerticesRegenerated += pBatch->GetNumQueuedVertices() - nQueuedVertices;
+    }
+
+    QueryPerformanceCounter( &qwEnd );
+    QueryPerformanceFrequency( &qwFrequency );
+    stats.fCPUMilliseconds += ( float )( ( double )( qwEnd.QuadPart - qwStart.QuadPart ) * 1000.0 /
+                                         ( double )qwFrequency.QuadPart );
+
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Queue the background, caption and controls of the dialog into the UI batch of the
+// resource manager, drawn by CDXUTDialogResourceManager::EndFrame11 together with the
+// other dialogs
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTDialog::RenderUI11( float fElapsedTime )
+{
     ID3D11Device* pd3dDevice = m_pManager->GetD3D11Device();
     ID3D11DeviceContext* pd3dDeviceContext = m_pManager->GetD3D11DeviceContext();
 
-    // Set up a state block here and restore it when finished drawing all the controls
-    m_pManager->StoreD3D11State( pd3dDeviceContext );
-
     BOOL bBackgroundIsVisible = ( m_colorTopLeft | m_colorTopRight | m_colorBottomRight | m_colorBottomLeft ) &
         0xff000000;
     if( !m_bMinimized && bBackgroundIsVisible )
@@ -1099,44 +1134,11 @@ HRESULT CDXUTDialog::OnRender11( float fElapsedTime )
         Top = 1.0f - m_y * 2.0f / m_pManager->m_nBackBufferHeight;
         Bottom = 1.0f - ( m_y + m_height ) * 2.0f / m_pManager->m_nBackBufferHeight;
 
-        DXUT_SCREEN_VERTEX_10 vertices[4] =
-        {
-            Left,  Top,    0.5f, D3DCOLOR_TO_D3DCOLORVALUE( m_colorTopLeft ), 0.0f, 0.0f,
-            Right, Top,    0.5f, D3DCOLOR_TO_D3DCOLORVALUE( m_colorTopRight ), 1.0f, 0.0f,
-            Left,  Bottom, 0.5f, D3DCOLOR_TO_D3DCOLORVALUE( m_colorBottomLeft ), 0.0f, 1.0f,
-            Right, Bottom, 0.5f, D3DCOLOR_TO_D3DCOLORVALUE( m_colorBottomRight ), 1.0f, 1.0f,
-        };
-
-        //DXUT_SCREEN_VERTEX_10 *pVB;
-        D3D11_MAPPED_SUBRESOURCE MappedData;
-        if( SUCCEEDED( pd3dDeviceContext->Map( m_pManager->m_pVBScreenQuad11, 0, D3D11_MAP_WRITE_DISCARD,
-                                               0, &MappedData ) ) )
-        {
-            CopyMemory( MappedData.pData, vertices, sizeof( vertices ) );
-            pd3dDeviceContext->Unmap( m_pManager->m_pVBScreenQuad11, 0 );
-        }
-
-        // Set the quad VB as current
-        UINT stride = sizeof( DXUT_SCREEN_VERTEX_10 );
-        UINT offset = 0;
-        pd3dDeviceContext->IASetVertexBuffers( 0, 1, &m_pManager->m_pVBScreenQuad11, &stride, &offset );
-        pd3dDeviceContext->IASetInputLayout( m_pManager->m_pInputLayout11 );
-        pd3dDeviceContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP );
-
-        // Setup for rendering
-        m_pManager->ApplyRenderUIUntex11( pd3dDeviceContext );
-        pd3dDeviceContext->Draw( 4, 0 );
+        m_pManager->m_UIBatch11.AddUntexturedQuad( Left, Top, Right, Bottom, 0.5f,
+                                                   D3DXCOLOR( m_colorTopLeft ), D3DXCOLOR( m_colorTopRight ),
+                                                   D3DXCOLOR( m_colorBottomLeft ), D3DXCOLOR( m_colorBottomRight ) );
     }
 
-    DXUTTextureNode* pTextureNode = GetTexture( 0 );
-    pd3dDeviceContext->PSSetShaderResources( 0, 1, &pTextureNode->pTexResView11 );
-
-    // Sort depth back to front
-    m_pManager->BeginSprites11();
-    BeginText11();
-
-    m_pManager->ApplyRenderUI11( pd3dDeviceContext );
-
     // Render the caption if it's enabled.
     if( m_bCaption )
     {
@@ -1172,14 +1174,6 @@ HRESULT CDXUTDialog::OnRender11( float fElapsedTime )
             s_pControlFocus->Render( fElapsedTime );
     }
 
-    // End sprites
-    if( m_bCaption )
-    {
-        m_pManager->EndSprites11( pd3dDevice, pd3dDeviceContext );
-        EndText11( pd3dDevice, pd3dDeviceContext );
-    }
-    m_pManager->RestoreD3D11State( pd3dDeviceContext );
-
     return S_OK;
 }
 
@@ -1255,6 +1249,7 @@ HRESULT CDXUTDialog::SetFont( UINT index, LPCWSTR strFaceName, LONG height, LONG
 
     int iFont = m_pManager->AddFont( strFaceName, height, weight );
     m_Fonts.SetAt( index, iFont );
+    Invalidate();
 
     return S_OK;
 }
@@ -1380,6 +1375,7 @@ HRESULT CDXUTDialog::SetTexture( UINT index, LPCWSTR strFilename )
     int iTexture = m_pManager->AddTexture( strFilename );
 
     m_Textures.SetAt( index, iTexture );
+    Invalidate();
     return S_OK;
 }
 
@@ -1402,6 +1398,7 @@ HRESULT CDXUTDialog::SetTexture( UINT index, LPCWSTR strResourceName, HMODULE hR
     int iTexture = m_pManager->AddTexture( strResourceName, hResourceModule );
 
     m_Textures.SetAt( index, iTexture );
+    Invalidate();
     return S_OK;
 }
 
@@ -1416,6 +1413,49 @@ DXUTTextureNode* CDXUTDialog::GetTexture( UINT index )
 
 
 
+//--------------------------------------------------------------------------------------
+// Input that can change how the dialog looks.  Hovering is left to OnMouseEnter and
+// OnMouseLeave, so moving the mouse only invalidates while something of this dialog is
+// being dragged or has focus (e.g. an open combo box highlighting the item under the mouse).
+//--------------------------------------------------------------------------------------
+bool CDXUTDialog::InvalidatesOnMessage( UINT uMsg )
+{
+    if( uMsg >= WM_KEYFIRST && uMsg <= WM_KEYLAST )
+        return true;
+
+    switch( uMsg )
+    {
+        case WM_MOUSEMOVE:
+            return m_bDrag ||
+                ( s_pControlPressed && s_pControlPressed->m_pDialog == this ) ||
+                ( s_pControlFocus && s_pControlFocus->m_pDialog == this );
+
+        case WM_LBUTTONDOWN:
+        case WM_LBUTTONUP:
+        case WM_MBUTTONDOWN:
+        case WM_MBUTTONUP:
+        case WM_RBUTTONDOWN:
+        case WM_RBUTTONUP:
+        case WM_XBUTTONDOWN:
+        case WM_XBUTTONUP:
+        case WM_LBUTTONDBLCLK:
+        case WM_MBUTTONDBLCLK:
+        case WM_RBUTTONDBLCLK:
+        case WM_XBUTTONDBLCLK:
+        case WM_MOUSEWHEEL:
+        case WM_CAPTURECHANGED:
+        case WM_IME_STARTCOMPOSITION:
+        case WM_IME_ENDCOMPOSITION:
+        case WM_IME_COMPOSITION:
+        case WM_IME_NOTIFY:
+        case WM_INPUTLANGCHANGE:
+            return true;
+    }
+
+    return false;
+}
+
+
 //--------------------------------------------------------------------------------------
 bool CDXUTDialog::MsgProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam )
 {
@@ -1425,6 +1465,9 @@ bool CDXUTDialog::MsgProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam )
     if( !m_bVisible )
         return false;
 
+    if( InvalidatesOnMessage( uMsg ) )
+        Invalidate();
+
     // If automation command-line switch is on, enable this dialog's keyboard input
     // upon any key press or mouse click.
     if( DXUTGetAutomation() &&
@@ -1679,6 +1722,17 @@ bool CDXUTDialog::MsgProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam )
 //--------------------------------------------------------------------------------------
 CDXUTControl* CDXUTDialog::GetControlAtPoint( POINT pt )
 {
+    // Large dialogs look the point up in the hit grid
+    if( m_bHitGridEnabled && m_Controls.GetSize() >= DXUT_HITGRID_MIN_CONTROLS )
+    {
+        if( m_bHitGridDirty )
+        {
+            m_HitGrid.Build( m_Controls );
+            m_bHitGridDirty = false;
+        }
+        return m_HitGrid.GetControlAtPoint( pt );
+    }
+
     // Search through all child controls for the first one which
     // contains the mouse point
     for( int i = 0; i < m_Controls.GetSize(); i++ )
@@ -1703,6 +1757,142 @@ CDXUTControl* CDXUTDialog::GetControlAtPoint( POINT pt )
 }
 
 
+//--------------------------------------------------------------------------------------
+CDXUTHitGrid::CDXUTHitGrid()
+{
+    m_nOriginX = 0;
+    m_nOriginY = 0;
+    m_nCellSize = 1;
+    m_nCellsX = 0;
+    m_nCellsY = 0;
+    m_nCandidatesTested = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTHitGrid::Build( CGrowableArray <CDXUTControl*>& Controls )
+{
+    m_CellStart.Reset();
+    m_Entries.Reset();
+    m_CellRanges.Reset();
+    m_nCellsX = 0;
+    m_nCellsY = 0;
+
+    int nControls = Controls.GetSize();
+    if( FAILED( m_CellRanges.SetSize( nControls ) ) )
+        return;
+
+    // Gather the hit bounds and their union
+    RECT rcAll;
+    SetRectEmpty( &rcAll );
+    int nIndexed = 0;
+    for( int i = 0; i < nControls; i++ )
+    {
+        RECT& rc = m_CellRanges[i];
+        CDXUTControl* pControl = Controls.GetAt( i );
+        if( pControl != NULL )
+            pControl->GetHitBounds( &rc );
+        else
+            SetRectEmpty( &rc );
+
+        if( !IsRectEmpty( &rc ) )
+        {
+            UnionRect( &rcAll, &rcAll, &rc );
+            nIndexed++;
+        }
+    }
+    if( nIndexed == 0 )
+        return;
+
+    // Square cells sized for about one control per cell
+    int nWidth = RectWidth( rcAll );
+    int nHeight = RectHeight( rcAll );
+    int nCellSize = ( int )sqrtf( ( float )nWidth * ( float )nHeight / ( float )nIndexed );
+    nCellSize = max( nCellSize, DXUT_HITGRID_MIN_CELL_SIZE );
+    nCellSize = max( nCellSize, ( max( nWidth, nHeight ) + DXUT_HITGRID_MAX_CELLS_PER_AXIS - 1 ) /
+                                DXUT_HITGRID_MAX_CELLS_PER_AXIS );
+
+    m_nOriginX = rcAll.left;
+    m_nOriginY = rcAll.top;
+    m_nCellSize = nCellSize;
+    int nCellsX = ( nWidth + nCellSize - 1 ) / nCellSize;
+    int nCellsY = ( nHeight + nCellSize - 1 ) / nCellSize;
+    int nCells = nCellsX * nCellsY;
+    if( FAILED( m_CellStart.SetSize( nCells + 1 ) ) )
+        return;
+    ZeroMemory( m_CellStart.GetData(), ( nCells + 1 ) * sizeof( int ) );
+
+    // Turn the bounds into inclusive cell ranges and count the entries of every cell
+    for( int i = 0; i < nControls; i++ )
+    {
+        RECT& rc = m_CellRanges[i];
+        if( IsRectEmpty( &rc ) )
+        {
+            SetRect( &rc, 1, 1, 0, 0 );
+            continue;
+        }
+        SetRect( &rc, ( rc.left - m_nOriginX ) / nCellSize, ( rc.top - m_nOriginY ) / nCellSize,
+                 ( rc.right - 1 - m_nOriginX ) / nCellSize, ( rc.bottom - 1 - m_nOriginY ) / nCellSize );
+
+        for( int y = rc.top; y <= rc.bottom; y++ )
+            for( int x = rc.left; x <= rc.right; x++ )
+                m_CellStart[y * nCellsX + x + 1]++;
+    }
+
+    for( int c = 0; c < nCells; c++ )
+        m_CellStart[c + 1] += m_CellStart[c];
+    if( FAILED( m_Entries.SetSize( m_CellStart[nCells] ) ) )
+    {
+        m_CellStart.Reset();
+        return;
+    }
+
+    // Fill the cells in dialog order, using m_CellStart[c] as the write cursor of cell c;
+    // afterwards every cursor sits at the start of the next cell, so shift them back
+    for( int i = 0; i < nControls; i++ )
+    {
+        const RECT& rc = m_CellRanges[i];
+        for( int y = rc.top; y <= rc.bottom; y++ )
+            for( int x = rc.left; x <= rc.right; x++ )
+                m_Entries[m_CellStart[y * nCellsX + x]++] = Controls.GetAt( i );
+    }
+    for( int c = nCells; c > 0; c-- )
+        m_CellStart[c] = m_CellStart[c - 1];
+    m_CellStart[0] = 0;
+
+    m_nCellsX = nCellsX;
+    m_nCellsY = nCellsY;
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTControl* CDXUTHitGrid::GetControlAtPoint( POINT pt ) const
+{
+    // Everything that can be hit lies inside the grid
+    int x = pt.x - m_nOriginX;
+    int y = pt.y - m_nOriginY;
+    if( m_nCellsX == 0 || x < 0 || y < 0 )
+        return NULL;
+    x /= m_nCellSize;
+    y /= m_nCellSize;
+    if( x >= m_nCellsX || y >= m_nCellsY )
+        return NULL;
+
+    int nCell = y * m_nCellsX + x;
+    for( int i = m_CellStart[nCell]; i < m_CellStart[nCell + 1]; i++ )
+    {
+        CDXUTControl* pControl = m_Entries[i];
+        m_nCandidatesTested++;
+
+        // Same filtering as the linear search in CDXUTDialog::GetControlAtPoint
+        if( pControl->ContainsPoint( pt ) && pControl->GetEnabled() && pControl->GetVisible() )
+            return pControl;
+    }
+
+    return NULL;
+}
+
+
 //--------------------------------------------------------------------------------------
 bool CDXUTDialog::GetControlEnabled( int ID )
 {
@@ -2095,6 +2285,8 @@ HRESULT CDXUTDialog::AddControl( CDXUTControl* pControl )
     {
         return DXTRACE_ERR( L"CGrowableArray::Add", hr );
     }
+    m_bHitGridDirty = true;
+    Invalidate();
 
     return S_OK;
 }
@@ -2419,43 +2611,31 @@ HRESULT CDXUTDialog::DrawSprite11( CDXUTElement* pElement, RECT* prcDest, float
     float fTexBottom = rcTexture.bottom / fTexHeight;
 
     // Add 6 sprite vertices
-    DXUTSpriteVertex SpriteVertex;
+    DXUTSpriteVertex SpriteVertices[6];
+    D3DXCOLOR vColor = pElement->TextureColor.Current;
 
     // tri1
-    SpriteVertex.vPos = D3DXVECTOR3( fRectLeft, fRectTop, fDepth );
-    SpriteVertex.vTex = D3DXVECTOR2( fTexLeft, fTexTop );
-    SpriteVertex.vColor = pElement->TextureColor.Current;
-    m_pManager->m_SpriteVertices.Add( SpriteVertex );
-
-    SpriteVertex.vPos = D3DXVECTOR3( fRectRight, fRectTop, fDepth );
-    SpriteVertex.vTex = D3DXVECTOR2( fTexRight, fTexTop );
-    SpriteVertex.vColor = pElement->TextureColor.Current;
-    m_pManager->m_SpriteVertices.Add( SpriteVertex );
-
-    SpriteVertex.vPos = D3DXVECTOR3( fRectLeft, fRectBottom, fDepth );
-    SpriteVertex.vTex = D3DXVECTOR2( fTexLeft, fTexBottom );
-    SpriteVertex.vColor = pElement->TextureColor.Current;
-    m_pManager->m_SpriteVertices.Add( SpriteVertex );
+    SpriteVertices[0].vPos = D3DXVECTOR3( fRectLeft, fRectTop, fDepth );
+    SpriteVertices[0].vTex = D3DXVECTOR2( fTexLeft, fTexTop );
+    SpriteVertices[1].vPos = D3DXVECTOR3( fRectRight, fRectTop, fDepth );
+    SpriteVertices[1].vTex = D3DXVECTOR2( fTexRight, fTexTop );
+    SpriteVertices[2].vPos = D3DXVECTOR3( fRectLeft, fRectBottom, fDepth );
+    SpriteVertices[2].vTex = D3DXVECTOR2( fTexLeft, fTexBottom );
 
     // tri2
-    SpriteVertex.vPos = D3DXVECTOR3( fRectRight, fRectTop, fDepth );
-    SpriteVertex.vTex = D3DXVECTOR2( fTexRight, fTexTop );
-    SpriteVertex.vColor = pElement->TextureColor.Current;
-    m_pManager->m_SpriteVertices.Add( SpriteVertex );
-
-    SpriteVertex.vPos = D3DXVECTOR3( fRectRight, fRectBottom, fDepth );
-    SpriteVertex.vTex = D3DXVECTOR2( fTexRight, fTexBottom );
-    SpriteVertex.vColor = pElement->TextureColor.Current;
-    m_pManager->m_SpriteVertices.Add( SpriteVertex );
+    SpriteVertices[3].vPos = D3DXVECTOR3( fRectRight, fRectTop, fDepth );
+    SpriteVertices[3].vTex = D3DXVECTOR2( fTexRight, fTexTop );
+    SpriteVertices[4].vPos = D3DXVECTOR3( fRectRight, fRectBottom, fDepth );
+    SpriteVertices[4].vTex = D3DXVECTOR2( fTexRight, fTexBottom );
+    SpriteVertices[5].vPos = D3DXVECTOR3( fRectLeft, fRectBottom, fDepth );
+    SpriteVertices[5].vTex = D3DXVECTOR2( fTexLeft, fTexBottom );
 
-    SpriteVertex.vPos = D3DXVECTOR3( fRectLeft, fRectBottom, fDepth );
-    SpriteVertex.vTex = D3DXVECTOR2( fTexLeft, fTexBottom );
-    SpriteVertex.vColor = pElement->TextureColor.Current;
-    m_pManager->m_SpriteVertices.Add( SpriteVertex );
+    for( int i = 0; i < 6; i++ )
+        SpriteVertices[i].vColor = vColor;
 
-    // Why are we drawing the sprite every time?  This is very inefficient, but the sprite workaround doesn't have support for sorting now, so we have to
-    // draw a sprite every time to keep the order correct between sprites and text.
-    m_pManager->EndSprites11( DXUTGetD3D11Device(), DXUTGetD3D11DeviceContext() );
+    // The batch keeps the order between sprites and text where they overlap, so sprites
+    // no longer have to be drawn one at a time
+    m_pManager->m_UIBatch11.AddVertices( pTextureNode->pTexResView11, SpriteVertices, 6 );
 
     return S_OK;
 }
@@ -2533,12 +2713,35 @@ HRESULT CDXUTDialog::DrawText9( LPCWSTR strText, CDXUTElement* pElement, RECT* p
     return S_OK;
 }
 
-ID3D11Buffer* g_pFontBuffer11 = NULL;
-UINT g_FontBufferBytes11 = 0;
-CGrowableArray<DXUTSpriteVertex> g_FontVertices;
 ID3D11ShaderResourceView* g_pFont11 = NULL;
 ID3D11InputLayout* g_pInputLayout11 = NULL;
-HRESULT InitFont11( ID3D11Device* pd3d11Device, ID3D11InputLayout* pInputLayout )
+CDXUTUIBatch* g_pTextBatch11 = NULL;
+
+//--------------------------------------------------------------------------------------
+// Retained text: the glyph quads of every string are cached, keyed on the string and
+// everything that affects its geometry.  DrawText11DXUT only queues the cached quads in
+// the UI batch of the resource manager.  Entries that were not drawn during a frame are
+// evicted by EndFrameText11.
+//--------------------------------------------------------------------------------------
+struct DXUTTextCacheEntry
+{
+    UINT nHash;
+    WCHAR* strText;
+    RECT rcScreen;
+    D3DXCOLOR vFontColor;
+    float fBBWidth;
+    float fBBHeight;
+    bool bCenter;
+    UINT nLastUsedFrame;
+    CGrowableArray<DXUTSpriteVertex> Vertices;
+};
+
+CGrowableArray<DXUTTextCacheEntry*> g_TextCache;
+UINT g_nTextFrame = 0;
+DXUTTextStats11 g_TextStats11 = { 0 };          // Frame in progress
+DXUTTextStats11 g_LastTextStats11 = { 0 };      // Last completed frame
+
+HRESULT InitFont11( ID3D11Device* pd3d11Device, ID3D11InputLayout* pInputLayout, CDXUTUIBatch* pBatch )
 {
     HRESULT hr = S_OK;
     WCHAR str[MAX_PATH];
@@ -2584,25 +2787,58 @@ HRESULT InitFont11( ID3D11Device* pd3d11Device, ID3D11InputLayout* pInputLayout
 #endif
 
     g_pInputLayout11 = pInputLayout;
+    g_pTextBatch11 = pBatch;
     return hr;
 }
 
+void ClearTextCache11()
+{
+    for( int i = 0; i < g_TextCache.GetSize(); i++ )
+    {
+        SAFE_DELETE_ARRAY( g_TextCache[i]->strText );
+        delete g_TextCache[i];
+    }
+    g_TextCache.RemoveAll();
+}
+
 void EndFont11()
 {
-    SAFE_RELEASE( g_pFontBuffer11 );
-    g_FontBufferBytes11 = 0;
     SAFE_RELEASE( g_pFont11 );
+    g_pTextBatch11 = NULL;
+    ClearTextCache11();
 }
 
-void BeginText11()
+//--------------------------------------------------------------------------------------
+static UINT HashText11( LPCWSTR strText, const RECT& rcScreen, const D3DXCOLOR& vFontColor,
+                        float fBBWidth, float fBBHeight, bool bCenter )
 {
-    g_FontVertices.Reset();
+    // FNV-1a
+    UINT nHash = 2166136261u;
+    for( LPCWSTR pch = strText; *pch; pch++ )
+        nHash = ( nHash ^ ( UINT )*pch ) * 16777619u;
+
+    const BYTE* pBytes[] = { ( const BYTE* )&rcScreen, ( const BYTE* )&vFontColor,
+                             ( const BYTE* )&fBBWidth, ( const BYTE* )&fBBHeight };
+    const UINT nBytes[] = { sizeof( rcScreen ), sizeof( vFontColor ), sizeof( fBBWidth ), sizeof( fBBHeight ) };
+    for( int i = 0; i < 4; i++ )
+    {
+        for( UINT b = 0; b < nBytes[i]; b++ )
+            nHash = ( nHash ^ pBytes[i][b] ) * 16777619u;
+    }
+
+    return ( nHash ^ ( bCenter ? 1u : 0u ) ) * 16777619u;
 }
 
-void DrawText11DXUT( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceContext,
-                 LPCWSTR strText, RECT rcScreen, D3DXCOLOR vFontColor,
-                 float fBBWidth, float fBBHeight, bool bCenter )
+//--------------------------------------------------------------------------------------
+static void TessellateText11( DXUTTextCacheEntry* pEntry )
 {
+    LPCWSTR strText = pEntry->strText;
+    RECT rcScreen = pEntry->rcScreen;
+    D3DXCOLOR vFontColor = pEntry->vFontColor;
+    float fBBWidth = pEntry->fBBWidth;
+    float fBBHeight = pEntry->fBBHeight;
+    bool bCenter = pEntry->bCenter;
+
     float fCharTexSizeX = 0.010526315f;
     //float fGlyphSizeX = 14.0f / fBBWidth;
     //float fGlyphSizeY = 32.0f / fBBHeight;
@@ -2657,93 +2893,123 @@ void DrawText11DXUT( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11Device
         SpriteVertex.vPos = D3DXVECTOR3( fRectLeft, fRectTop, fDepth );
         SpriteVertex.vTex = D3DXVECTOR2( fTexLeft, fTexTop );
         SpriteVertex.vColor = vFontColor;
-        g_FontVertices.Add( SpriteVertex );
+        pEntry->Vertices.Add( SpriteVertex );
 
         SpriteVertex.vPos = D3DXVECTOR3( fRectRight, fRectTop, fDepth );
         SpriteVertex.vTex = D3DXVECTOR2( fTexRight, fTexTop );
         SpriteVertex.vColor = vFontColor;
-        g_FontVertices.Add( SpriteVertex );
+        pEntry->Vertices.Add( SpriteVertex );
 
         SpriteVertex.vPos = D3DXVECTOR3( fRectLeft, fRectBottom, fDepth );
         SpriteVertex.vTex = D3DXVECTOR2( fTexLeft, fTexBottom );
         SpriteVertex.vColor = vFontColor;
-        g_FontVertices.Add( SpriteVertex );
+        pEntry->Vertices.Add( SpriteVertex );
 
         // tri2
         SpriteVertex.vPos = D3DXVECTOR3( fRectRight, fRectTop, fDepth );
         SpriteVertex.vTex = D3DXVECTOR2( fTexRight, fTexTop );
         SpriteVertex.vColor = vFontColor;
-        g_FontVertices.Add( SpriteVertex );
+        pEntry->Vertices.Add( SpriteVertex );
 
         SpriteVertex.vPos = D3DXVECTOR3( fRectRight, fRectBottom, fDepth );
         SpriteVertex.vTex = D3DXVECTOR2( fTexRight, fTexBottom );
         SpriteVertex.vColor = vFontColor;
-        g_FontVertices.Add( SpriteVertex );
+        pEntry->Vertices.Add( SpriteVertex );
 
         SpriteVertex.vPos = D3DXVECTOR3( fRectLeft, fRectBottom, fDepth );
         SpriteVertex.vTex = D3DXVECTOR2( fTexLeft, fTexBottom );
         SpriteVertex.vColor = vFontColor;
-        g_FontVertices.Add( SpriteVertex );
+        pEntry->Vertices.Add( SpriteVertex );
 
         fRectLeft += fGlyphSizeX;
 
     }
-
-    // We have to end text after every line so that rendering order between sprites and fonts is preserved
-    EndText11( pd3dDevice, pd3d11DeviceContext );
 }
 
-void EndText11( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceContext )
+//--------------------------------------------------------------------------------------
+void DrawText11DXUT( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceContext,
+                 LPCWSTR strText, RECT rcScreen, D3DXCOLOR vFontColor,
+                 float fBBWidth, float fBBHeight, bool bCenter )
 {
+    UINT nHash = HashText11( strText, rcScreen, vFontColor, fBBWidth, fBBHeight, bCenter );
 
-    // ensure our buffer size can hold our sprites
-    UINT FontDataBytes = g_FontVertices.GetSize() * sizeof( DXUTSpriteVertex );
-    if( g_FontBufferBytes11 < FontDataBytes )
+    // The UI holds a few dozen strings at most, so a linear search over the hashes is enough
+    DXUTTextCacheEntry* pEntry = NULL;
+    for( int i = 0; i < g_TextCache.GetSize(); i++ )
     {
-        SAFE_RELEASE( g_pFontBuffer11 );
-        g_FontBufferBytes11 = FontDataBytes;
-
-        D3D11_BUFFER_DESC BufferDesc;
-        BufferDesc.ByteWidth = g_FontBufferBytes11;
-        BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
-        BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-        BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
-        BufferDesc.MiscFlags = 0;
+        DXUTTextCacheEntry* pCandidate = g_TextCache[i];
+        if( pCandidate->nHash == nHash && pCandidate->bCenter == bCenter &&
+            pCandidate->fBBWidth == fBBWidth && pCandidate->fBBHeight == fBBHeight &&
+            pCandidate->vFontColor == vFontColor && EqualRect( &pCandidate->rcScreen, &rcScreen ) &&
+            wcscmp( pCandidate->strText, strText ) == 0 )
+        {
+            pEntry = pCandidate;
+            break;
+        }
+    }
 
-        pd3dDevice->CreateBuffer( &BufferDesc, NULL, &g_pFontBuffer11 );
-        DXUT_SetDebugName( g_pFontBuffer11, "DXUT Text11" );
+    if( pEntry )
+    {
+        g_TextStats11.nCacheHits++;
     }
+    else
+    {
+        pEntry = new DXUTTextCacheEntry;
+        if( pEntry == NULL )
+            return;
 
-    // Copy the sprites over
-    D3D11_BOX destRegion;
-    destRegion.left = 0;
-    destRegion.right = FontDataBytes;
-    destRegion.top = 0;
-    destRegion.bottom = 1;
-    destRegion.front = 0;
-    destRegion.back = 1;
-    D3D11_MAPPED_SUBRESOURCE MappedResource;
-    if ( S_OK == pd3d11DeviceContext->Map( g_pFontBuffer11, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) ) { 
-        CopyMemory( MappedResource.pData, (void*)g_FontVertices.GetData(), FontDataBytes );
-        pd3d11DeviceContext->Unmap(g_pFontBuffer11, 0);
+        size_t nLength = wcslen( strText ) + 1;
+        pEntry->strText = new WCHAR[ nLength ];
+        if( pEntry->strText == NULL )
+        {
+            delete pEntry;
+            return;
+        }
+        wcscpy_s( pEntry->strText, nLength, strText );
+        pEntry->nHash = nHash;
+        pEntry->rcScreen = rcScreen;
+        pEntry->vFontColor = vFontColor;
+        pEntry->fBBWidth = fBBWidth;
+        pEntry->fBBHeight = fBBHeight;
+        pEntry->bCenter = bCenter;
+        TessellateText11( pEntry );
+
+        g_TextCache.Add( pEntry );
+        g_TextStats11.nCacheMisses++;
     }
+    pEntry->nLastUsedFrame = g_nTextFrame;
 
-    ID3D11ShaderResourceView* pOldTexture = NULL;
-    pd3d11DeviceContext->PSGetShaderResources( 0, 1, &pOldTexture );
-    pd3d11DeviceContext->PSSetShaderResources( 0, 1, &g_pFont11 );
+    if( g_pTextBatch11 )
+        g_pTextBatch11->AddVertices( g_pFont11, pEntry->Vertices.GetData(), pEntry->Vertices.GetSize() );
+    g_TextStats11.nVerticesQueued += pEntry->Vertices.GetSize();
+}
 
-    // Draw
-    UINT Stride = sizeof( DXUTSpriteVertex );
-    UINT Offset = 0;
-    pd3d11DeviceContext->IASetVertexBuffers( 0, 1, &g_pFontBuffer11, &Stride, &Offset );
-    pd3d11DeviceContext->IASetInputLayout( g_pInputLayout11 );
-    pd3d11DeviceContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
-    pd3d11DeviceContext->Draw( g_FontVertices.GetSize(), 0 );
+//--------------------------------------------------------------------------------------
+// Evict the strings that were not drawn this frame; called by
+// CDXUTDialogResourceManager::EndFrame11 once the frame's text has been drawn.
+//--------------------------------------------------------------------------------------
+void EndFrameText11()
+{
+    for( int i = g_TextCache.GetSize() - 1; i >= 0; i-- )
+    {
+        if( g_TextCache[i]->nLastUsedFrame != g_nTextFrame )
+        {
+            SAFE_DELETE_ARRAY( g_TextCache[i]->strText );
+            delete g_TextCache[i];
+            g_TextCache.Remove( i );
+        }
+    }
 
-    pd3d11DeviceContext->PSSetShaderResources( 0, 1, &pOldTexture );
-    SAFE_RELEASE( pOldTexture );
+    g_TextStats11.nCachedStrings = g_TextCache.GetSize();
+    g_LastTextStats11 = g_TextStats11;
+    ZeroMemory( &g_TextStats11, sizeof( g_TextStats11 ) );
+    g_nTextFrame++;
+}
 
-    g_FontVertices.Reset();
+//--------------------------------------------------------------------------------------
+const DXUTTextStats11* DXUTGetTextStats11()
+{
+    return &g_LastTextStats11;
 }
 
 //--------------------------------------------------------------------------------------
@@ -2795,6 +3061,7 @@ void CDXUTDialog::SetBackgroundColors( D3DCOLOR colorTopLeft, D3DCOLOR colorTopR
     m_colorTopRight = colorTopRight;
     m_colorBottomLeft = colorBottomLeft;
     m_colorBottomRight = colorBottomRight;
+    Invalidate();
 }
 
 
@@ -3494,6 +3761,8 @@ void CDXUTControl::SetTextColor( D3DCOLOR Color )
 
     if( pElement )
         pElement->FontColor.States[DXUT_STATE_NORMAL] = Color;
+
+    Invalidate();
 }
 
 
@@ -3523,6 +3792,7 @@ HRESULT CDXUTControl::SetElement( UINT iElement, CDXUTElement* pElement )
     // Update the data
     CDXUTElement* pCurElement = m_Elements.GetAt( iElement );
     *pCurElement = *pElement;
+    Invalidate();
 
     return S_OK;
 }
@@ -3533,6 +3803,7 @@ void CDXUTControl::Refresh()
 {
     m_bMouseOver = false;
     m_bHasFocus = false;
+    Invalidate();
 
     for( int i = 0; i < m_Elements.GetSize(); i++ )
     {
@@ -3546,6 +3817,12 @@ void CDXUTControl::Refresh()
 void CDXUTControl::UpdateRects()
 {
     SetRect( &m_rcBoundingBox, m_x, m_y, m_x + m_width, m_y + m_height );
+
+    if( m_pDialog )
+    {
+        m_pDialog->InvalidateHitGrid();
+        m_pDialog->Invalidate();
+    }
 }
 
 
@@ -3611,12 +3888,14 @@ HRESULT CDXUTStatic::GetTextCopy( __out_ecount(bufferCount) LPWSTR strDest,
 HRESULT CDXUTStatic::SetText( LPCWSTR strText )
 {
     if( strText == NULL )
-    {
-        m_strText[0] = 0;
+        strText = L"";
+
+    // Apps often set the same text every frame, which must not invalidate the dialog
+    if( wcsncmp( m_strText, strText, MAX_PATH - 1 ) == 0 )
         return S_OK;
-    }
 
     wcscpy_s( m_strText, MAX_PATH, strText );
+    Invalidate();
     return S_OK;
 }
 
@@ -3890,6 +4169,7 @@ bool CDXUTCheckBox::HandleMouse( UINT uMsg, POINT pt, WPARAM wParam, LPARAM lPar
 void CDXUTCheckBox::SetCheckedInternal( bool bChecked, bool bFromInput )
 {
     m_bChecked = bChecked;
+    Invalidate();
 
     m_pDialog->SendEvent( EVENT_CHECKBOX_CHANGED, bFromInput, this );
 }
@@ -4070,6 +4350,7 @@ void CDXUTRadioButton::SetCheckedInternal( bool bChecked, bool bClearGroup, bool
         m_pDialog->ClearRadioButtonGroup( m_nButtonGroup );
 
     m_bChecked = bChecked;
+    Invalidate();
     m_pDialog->SendEvent( EVENT_RADIOBUTTON_CHANGED, bFromInput, this );
 }
 
@@ -4114,6 +4395,8 @@ void CDXUTComboBox::SetTextColor( D3DCOLOR Color )
 
     if( pElement )
         pElement->FontColor.States[DXUT_STATE_NORMAL] = Color;
+
+    Invalidate();
 }
 
 
@@ -4601,6 +4884,7 @@ HRESULT CDXUTComboBox::AddItem( const WCHAR* strText, void* pData )
     pItem->pData = pData;
 
     m_Items.Add( pItem );
+    Invalidate();
 
     // Update the scroll bar with new range
     m_ScrollBar.SetTrackRange( 0, m_Items.GetSize() );
@@ -4626,6 +4910,7 @@ void CDXUTComboBox::RemoveItem( UINT index )
     m_ScrollBar.SetTrackRange( 0, m_Items.GetSize() );
     if( m_iSelected >= m_Items.GetSize() )
         m_iSelected = m_Items.GetSize() - 1;
+    Invalidate();
 }
 
 
@@ -4641,6 +4926,7 @@ void CDXUTComboBox::RemoveAllItems()
     m_Items.RemoveAll();
     m_ScrollBar.SetTrackRange( 0, 1 );
     m_iFocused = m_iSelected = -1;
+    Invalidate();
 }
 
 
@@ -4730,6 +5016,7 @@ HRESULT CDXUTComboBox::SetSelectedByIndex( UINT index )
         return E_INVALIDARG;
 
     m_iFocused = m_iSelected = index;
+    Invalidate();
     m_pDialog->SendEvent( EVENT_COMBOBOX_SELECTION_CHANGED, false, this );
 
     return S_OK;
@@ -4748,6 +5035,7 @@ HRESULT CDXUTComboBox::SetSelectedByText( const WCHAR* strText )
         return E_FAIL;
 
     m_iFocused = m_iSelected = index;
+    Invalidate();
     m_pDialog->SendEvent( EVENT_COMBOBOX_SELECTION_CHANGED, false, this );
 
     return S_OK;
@@ -4765,6 +5053,7 @@ HRESULT CDXUTComboBox::SetSelectedByData( void* pData )
         if( pItem->pData == pData )
         {
             m_iFocused = m_iSelected = i;
+            Invalidate();
             m_pDialog->SendEvent( EVENT_COMBOBOX_SELECTION_CHANGED, false, this );
             return S_OK;
         }
@@ -4797,6 +5086,16 @@ BOOL CDXUTSlider::ContainsPoint( POINT pt )
 }
 
 
+//--------------------------------------------------------------------------------------
+void CDXUTSlider::GetHitBounds( RECT* prcBounds )
+{
+    // The button is centered on the value and can stick out by half its width on
+    // either end, wherever the value moves it
+    *prcBounds = m_rcBoundingBox;
+    InflateRect( prcBounds, RectHeight( m_rcBoundingBox ) / 2 + 1, 0 );
+}
+
+
 //--------------------------------------------------------------------------------------
 void CDXUTSlider::UpdateRects()
 {
@@ -4961,6 +5260,7 @@ void CDXUTSlider::SetRange( int nMin, int nMax )
 {
     m_nMin = nMin;
     m_nMax = nMax;
+    Invalidate();
 
     SetValueInternal( m_nValue, false );
 }
@@ -5110,6 +5410,8 @@ void CDXUTScrollBar::UpdateThumbRect()
         m_rcThumb.bottom = m_rcThumb.top;
         m_bShowThumb = false;
     }
+
+    Invalidate();
 }
 
 
@@ -5480,6 +5782,7 @@ HRESULT CDXUTListBox::AddItem( const WCHAR* wszText, void* pData )
     else
     {
         m_ScrollBar.SetTrackRange( 0, m_Items.GetSize() );
+        Invalidate();
     }
 
     return hr;
@@ -5500,7 +5803,10 @@ HRESULT CDXUTListBox::InsertItem( int nIndex, const WCHAR* wszText, void* pData
 
     HRESULT hr = m_Items.Insert( nIndex, pNewItem );
     if( SUCCEEDED( hr ) )
+    {
         m_ScrollBar.SetTrackRange( 0, m_Items.GetSize() );
+        Invalidate();
+    }
     else
         SAFE_DELETE( pNewItem );
 
@@ -5521,6 +5827,7 @@ void CDXUTListBox::RemoveItem( int nIndex )
     m_ScrollBar.SetTrackRange( 0, m_Items.GetSize() );
     if( m_nSelected >= ( int )m_Items.GetSize() )
         m_nSelected = m_Items.GetSize() - 1;
+    Invalidate();
 
     m_pDialog->SendEvent( EVENT_LISTBOX_SELECTION, true, this );
 }
@@ -5540,6 +5847,7 @@ void CDXUTListBox::RemoveAllItems()
 
     m_Items.RemoveAll();
     m_ScrollBar.SetTrackRange( 0, 1 );
+    Invalidate();
 }
 
 
@@ -5616,6 +5924,7 @@ void CDXUTListBox::SelectItem( int nNewIndex )
 
         // Adjust scroll bar
         m_ScrollBar.ShowItem( m_nSelected );
+        Invalidate();
     }
 
     m_pDialog->SendEvent( EVENT_LISTBOX_SELECTION, true, this );
@@ -6113,6 +6422,7 @@ void CDXUTEditBox::PlaceCaret( int nCP )
 {
     assert( nCP >= 0 && nCP <= m_Buffer.GetTextSize() );
     m_nCaret = nCP;
+    Invalidate();
 
     // Obtain the X offset of the character.
     int nX1st, nX, nX2;
@@ -7205,6 +7515,7 @@ void CDXUTEditBox::ResetCaretBlink()
 {
     m_bCaretOn = true;
     m_dfLastBlink = DXUTGetGlobalTimer()->GetAbsoluteTime();
+    Invalidate();
 }
 
 
@@ -7227,6 +7538,15 @@ void DXUTBlendColor::Blend( UINT iState, float fElapsedTime, float fRate )
 {
     D3DXCOLOR destColor = States[ iState ];
     D3DXColorLerp( &Current, &Current, &destColor, 1.0f - powf( fRate, 30 * fElapsedTime ) );
+
+    // The lerp only approaches the target, so snap once the difference is below what an
+    // 8 bit channel can show; until then the dialog can't replay its retained vertices.
+    const float fEpsilon = 0.5f / 255.0f;
+    if( fabsf( Current.r - destColor.r ) < fEpsilon && fabsf( Current.g - destColor.g ) < fEpsilon &&
+        fabsf( Current.b - destColor.b ) < fEpsilon && fabsf( Current.a - destColor.a ) < fEpsilon )
+        Current = destColor;
+    else
+        g_nBlendsInProgress++;
 }
 
 
@@ -7263,3 +7583,143 @@ void CDXUTElement::Refresh()
 }
 
 
+//--------------------------------------------------------------------------------------
+HRESULT DXUTBenchmarkDialogHitTest( CDXUTDialogResourceManager* pManager, UINT nControls, UINT nMouseMoves,
+                                    DXUTHITTEST_BENCHMARK* pResult )
+{
+    HRESULT hr;
+
+    if( pManager == NULL || pResult == NULL || nControls == 0 || nMouseMoves == 0 )
+        return E_INVALIDARG;
+    ZeroMemory( pResult, sizeof( DXUTHITTEST_BENCHMARK ) );
+    pResult->nControls = nControls;
+    pResult->nMouseMoves = nMouseMoves;
+
+    // The dialog is not registered with the manager, so it is never rendered.  Its controls
+    // share the manager's default texture.
+    CDXUTDialog Dialog;
+    Dialog.Init( pManager, false );
+
+    // Rows of controls like the settings dialog: a label, then a button, a check box or a
+    // slider.  Every 16th control is disabled or hidden.
+    const int nColumns = 20;
+    const int nCellWidth = 160, nCellHeight = 26;
+    for( UINT i = 0; i < nControls; i++ )
+    {
+        int x = ( int )( i % nColumns ) * nCellWidth;
+        int y = ( int )( i / nColumns ) * nCellHeight;
+        CDXUTControl* pControl = NULL;
+        switch( i % 4 )
+        {
+            case 0:
+            {
+                CDXUTStatic* pStatic;
+                V_RETURN( Dialog.AddStatic( i, L"Label", x, y, nCellWidth - 8, 22, false, &pStatic ) );
+                pControl = pStatic;
+                break;
+            }
+            case 1:
+            {
+                CDXUTButton* pButton;
+                V_RETURN( Dialog.AddButton( i, L"Button", x, y, nCellWidth - 8, 22, 0, false, &pButton ) );
+                pControl = pButton;
+                break;
+            }
+            case 2:
+            {
+                CDXUTCheckBox* pCheckBox;
+                V_RETURN( Dialog.AddCheckBox( i, L"Check", x, y, nCellWidth - 8, 22, false, 0, false, &pCheckBox ) );
+                pControl = pCheckBox;
+                break;
+            }
+            default:
+            {
+                CDXUTSlider* pSlider;
+                V_RETURN( Dialog.AddSlider( i, x + 12, y, nCellWidth - 32, 22, 0, 100, ( i * 37 ) % 101, false,
+                                            &pSlider ) );
+                pControl = pSlider;
+                break;
+            }
+        }
+        if( i % 16 == 5 )
+            pControl->SetEnabled( false );
+        else if( i % 16 == 11 )
+            pControl->SetVisible( false );
+    }
+    int nRows = ( int )( nControls + nColumns - 1 ) / nColumns;
+    int nDialogWidth = nColumns * nCellWidth;
+    int nDialogHeight = nRows * nCellHeight;
+    Dialog.SetLocation( 0, 0 );
+    Dialog.SetSize( nDialogWidth, nDialogHeight );
+
+    // Mostly small steps, sometimes a jump across the dialog, sometimes just outside it
+    CGrowableArray <POINT> Moves;
+    V_RETURN( Moves.SetSize( ( int )nMouseMoves ) );
+    UINT nSeed = 0x2545F491;
+    POINT pt = { nDialogWidth / 2, nDialogHeight / 2 };
+    for( UINT i = 0; i < nMouseMoves; i++ )
+    {
+        nSeed = nSeed * 1664525 + 1013904223;
+        if( ( nSeed >> 24 ) < 4 )
+        {
+            pt.x = ( int )( ( nSeed >> 4 ) % ( UINT )( nDialogWidth + 64 ) ) - 32;
+            pt.y = ( int )( ( nSeed >> 12 ) % ( UINT )( nDialogHeight + 64 ) ) - 32;
+        }
+        else
+        {
+            pt.x += ( int )( ( nSeed >> 8 ) % 17 ) - 8;
+            pt.y += ( int )( ( nSeed >> 16 ) % 9 ) - 4;
+            pt.x = max( -32, min( pt.x, nDialogWidth + 32 ) );
+            pt.y = max( -32, min( pt.y, nDialogHeight + 32 ) );
+        }
+        Moves[i] = pt;
+    }
+
+    LARGE_INTEGER Frequency, Start, End;
+    QueryPerformanceFrequency( &Frequency );
+    double fNanosecondsPerTick = 1.0e9 / ( double )Frequency.QuadPart;
+
+    // Both passes dispatch through MsgProc, so mouse enter/leave is part of the cost
+    for( int nPass = 0; nPass < 2; nPass++ )
+    {
+        bool bGrid = ( nPass == 1 );
+        Dialog.EnableHitGrid( bGrid );
+        if( bGrid )
+        {
+            QueryPerformanceCounter( &Start );
+            Dialog.InvalidateHitGrid();
+            POINT ptOutside = { -1000, -1000 };
+            Dialog.GetControlAtPoint( ptOutside );
+            QueryPerformanceCounter( &End );
+            pResult->fGridBuildMilliseconds = ( End.QuadPart - Start.QuadPart ) * fNanosecondsPerTick * 1.0e-6;
+        }
+
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 0; i < nMouseMoves; i++ )
+            Dialog.MsgProc( NULL, WM_MOUSEMOVE, 0, MAKELPARAM( Moves[i].x, Moves[i].y ) );
+        QueryPerformanceCounter( &End );
+
+        double fNanoseconds = ( End.QuadPart - Start.QuadPart ) * fNanosecondsPerTick / nMouseMoves;
+        if( bGrid )
+            pResult->fGridNanosecondsPerMove = fNanoseconds;
+        else
+            pResult->fLinearNanosecondsPerMove = fNanoseconds;
+    }
+
+    // Compare every point against the linear search
+    const CDXUTHitGrid& Grid = Dialog.GetHitGrid();
+    Dialog.EnableHitGrid( true );
+    Dialog.GetControlAtPoint( Moves[0] );
+    Grid.ResetCounters();
+    for( UINT i = 0; i < nMouseMoves; i++ )
+    {
+        Dialog.EnableHitGrid( true );
+        CDXUTControl* pFromGrid = Dialog.GetControlAtPoint( Moves[i] );
+        Dialog.EnableHitGrid( false );
+        if( pFromGrid != Dialog.GetControlAtPoint( Moves[i] ) )
+            pResult->nMismatches++;
+    }
+    pResult->fCandidatesPerHitTest = ( float )Grid.GetNumCandidatesTested() / ( float )nMouseMoves;
+
+    return S_OK;
+}
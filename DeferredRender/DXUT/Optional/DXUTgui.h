@@ -9,6 +9,7 @@
 
 #include <usp10.h>
 #include <dimm.h>
+#include "DXUTuibatch.h"
 
 
 //--------------------------------------------------------------------------------------
@@ -119,6 +120,42 @@ public:
 };
 
 
+//-----------------------------------------------------------------------------
+// Uniform grid over the hit bounds of a dialog's controls (CDXUTControl::GetHitBounds).
+// A point is only tested against the controls listed in its cell, and every cell
+// lists its controls in dialog order, so the first match is the same control the
+// linear search over the dialog would find.
+//-----------------------------------------------------------------------------
+class CDXUTHitGrid
+{
+public:
+                    CDXUTHitGrid();
+
+    // Rebuilds the grid; keeps its arrays between builds
+    void            Build( CGrowableArray <CDXUTControl*>& Controls );
+    // First visible, enabled control in dialog order that contains pt
+    CDXUTControl*   GetControlAtPoint( POINT pt ) const;
+
+    int             GetNumCells() const { return m_nCellsX * m_nCellsY; }
+    int             GetNumEntries() const { return m_Entries.GetSize(); }
+    UINT            GetNumCandidatesTested() const { return m_nCandidatesTested; }
+    void            ResetCounters() const { m_nCandidatesTested = 0; }
+
+protected:
+    int m_nOriginX;
+    int m_nOriginY;
+    int m_nCellSize;
+    int m_nCellsX;
+    int m_nCellsY;
+
+    CGrowableArray <int> m_CellStart;           // GetNumCells() + 1 offsets into m_Entries
+    CGrowableArray <CDXUTControl*> m_Entries;   // Controls of each cell, in dialog order
+    CGrowableArray <RECT> m_CellRanges;         // Per control, the cells it covers (scratch)
+
+    mutable UINT m_nCandidatesTested;
+};
+
+
 //-----------------------------------------------------------------------------
 // All controls must be assigned to a dialog, which handles
 // input and rendering for the controls.
@@ -238,7 +275,7 @@ public:
     }
     void                SetVisible( bool bVisible )
     {
-        m_bVisible = bVisible;
+        m_bVisible = bVisible; Invalidate();
     }
     bool                GetMinimized()
     {
@@ -246,7 +283,7 @@ public:
     }
     void                SetMinimized( bool bMinimized )
     {
-        m_bMinimized = bMinimized;
+        m_bMinimized = bMinimized; Invalidate();
     }
     void                SetBackgroundColors( D3DCOLOR colorAllCorners )
     {
@@ -256,7 +293,7 @@ public:
                                              D3DCOLOR colorBottomRight );
     void                EnableCaption( bool bEnable )
     {
-        m_bCaption = bEnable;
+        m_bCaption = bEnable; Invalidate();
     }
     int                 GetCaptionHeight() const
     {
@@ -264,11 +301,12 @@ public:
     }
     void                SetCaptionHeight( int nHeight )
     {
-        m_nCaptionHeight = nHeight;
+        m_nCaptionHeight = nHeight; Invalidate();
     }
     void                SetCaptionText( const WCHAR* pwszText )
     {
         wcscpy_s( m_wszCaption, sizeof( m_wszCaption ) / sizeof( m_wszCaption[0] ), pwszText );
+        Invalidate();
     }
     void                GetLocation( POINT& Pt ) const
     {
@@ -276,11 +314,11 @@ public:
     }
     void                SetLocation( int x, int y )
     {
-        m_x = x; m_y = y;
+        m_x = x; m_y = y; Invalidate();
     }
     void                SetSize( int width, int height )
     {
-        m_width = width; m_height = height;
+        m_width = width; m_height = height; Invalidate();
     }
     int                 GetWidth()
     {
@@ -302,6 +340,39 @@ public:
     void                RemoveControl( int ID );
     void                RemoveAllControls();
 
+    // Hit-testing goes through a CDXUTHitGrid once the dialog has enough controls.  The
+    // grid is rebuilt lazily after controls are added, removed, moved or resized.
+    void                EnableHitGrid( bool bEnable )
+    {
+        m_bHitGridEnabled = bEnable;
+    }
+    void                InvalidateHitGrid()
+    {
+        m_bHitGridDirty = true;
+    }
+    const CDXUTHitGrid& GetHitGrid() const
+    {
+        return m_HitGrid;
+    }
+
+    // With retained rendering (D3D11 only) the vertices a dialog queues are recorded and
+    // replayed in later frames until the dialog is invalidated: by input it handles, by a
+    // change through the dialog and control setters, by a color blend or animation that is
+    // still running, or by the resource manager recreating its resources.  Code that edits
+    // a control's elements directly must call Invalidate.
+    void                EnableRetainedRendering( bool bEnable )
+    {
+        m_bRetained = bEnable; Invalidate();
+    }
+    bool                IsRetainedRenderingEnabled() const
+    {
+        return m_bRetained;
+    }
+    void                Invalidate()
+    {
+        m_bRetainedDirty = true;
+    }
+
     // Sets the callback used to notify the app of control events
     void                SetCallback( PCALLBACKDXUTGUIEVENT pCallback, void* pUserContext = NULL );
     void                EnableNonUserEvents( bool bEnable )
@@ -352,6 +423,8 @@ private:
     HRESULT             OnRender9( float fElapsedTime );
     HRESULT             OnRender10( float fElapsedTime );
     HRESULT             OnRender11( float fElapsedTime );
+    HRESULT             RenderUI11( float fElapsedTime );
+    bool                InvalidatesOnMessage( UINT uMsg );
 
     static double s_fTimeRefresh;
     double m_fTimeLastRefresh;
@@ -400,6 +473,15 @@ private:
     CGrowableArray <CDXUTControl*> m_Controls;
     CGrowableArray <DXUTElementHolder*> m_DefaultElements;
 
+    CDXUTHitGrid m_HitGrid;
+    bool m_bHitGridEnabled;
+    bool m_bHitGridDirty;
+
+    CDXUTUIBatchRecording m_Retained11;
+    bool m_bRetained;
+    bool m_bRetainedDirty;
+    UINT m_nRetainedGeneration;     // CDXUTDialogResourceManager::m_nRetainedGeneration11 when recorded
+
     CDXUTElement m_CapElement;  // Element for the caption
 
     CDXUTDialog* m_pNextDialog;
@@ -431,11 +513,15 @@ struct DXUTFontNode
     ID3DXFont* pFont9;
 };
 
-struct DXUTSpriteVertex
+// Per-frame counters of the D3D11 dialogs
+struct DXUTGUIRenderStats11
 {
-    D3DXVECTOR3 vPos;
-    D3DXCOLOR vColor;
-    D3DXVECTOR2 vTex;
+    UINT  nDialogs;                 // Visible dialogs rendered
+    UINT  nDialogsRegenerated;      // Dialogs whose controls were rendered
+    UINT  nDialogsReplayed;         // Dialogs whose recorded vertices were queued again
+    UINT  nVerticesRegenerated;
+    UINT  nVerticesReplayed;
+    float fCPUMilliseconds;         // Spent in CDXUTDialog::OnRender
 };
 
 //-----------------------------------------------------------------------------
@@ -468,8 +554,12 @@ public:
     void    RestoreD3D11State( ID3D11DeviceContext* pd3dImmediateContext );
     void    ApplyRenderUI11( ID3D11DeviceContext* pd3dImmediateContext );
     void	ApplyRenderUIUntex11( ID3D11DeviceContext* pd3dImmediateContext );
-    void	BeginSprites11( );
-    void	EndSprites11( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext );
+    // Draw the UI queued by all dialogs and text helpers this frame; call once per frame
+    void    EndFrame11();
+    const DXUTGUIRenderStats11& GetGUIRenderStats11() const
+    {
+        return m_LastGUIStats11;
+    }
     ID3D11Device* GetD3D11Device()
     {
         return m_pd3d11Device;
@@ -524,12 +614,14 @@ public:
     ID3D11SamplerState* m_pSamplerStateStored11;
 
     ID3D11InputLayout* m_pInputLayout11;
-    ID3D11Buffer* m_pVBScreenQuad11;
 
-    // Sprite workaround
-    ID3D11Buffer* m_pSpriteBuffer11;
-    UINT m_SpriteBufferBytes11;
-    CGrowableArray<DXUTSpriteVertex> m_SpriteVertices;
+    // Sprites, text and dialog backgrounds of the frame, drawn by EndFrame11
+    CDXUTUIBatch m_UIBatch11;
+    CDXUTUIBatchContext11 m_UIBatchContext11;
+
+    // Bumped whenever recorded dialog vertices may be stale (textures, font or back buffer size)
+    UINT m_nRetainedGeneration11;
+    DXUTGUIRenderStats11 m_GUIStats11;          // Accumulated by the dialogs during the frame
 
     UINT m_nBackBufferWidth;
     UINT m_nBackBufferHeight;
@@ -550,13 +642,23 @@ protected:
 
     CGrowableArray <DXUTTextureNode*> m_TextureCache;   // Shared textures
     CGrowableArray <DXUTFontNode*> m_FontCache;         // Shared fonts
+
+    DXUTGUIRenderStats11 m_LastGUIStats11;
+};
+
+// Per-frame counters of the retained text layer; the text is drawn by the UI batch
+struct DXUTTextStats11
+{
+    UINT nVerticesQueued;
+    UINT nCacheHits;            // Strings whose cached glyph quads were reused
+    UINT nCacheMisses;          // Strings that had to be tessellated
+    UINT nCachedStrings;
 };
 
-void BeginText11();
 void DrawText11DXUT( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceContext,
                  LPCWSTR strText, RECT rcScreen, D3DXCOLOR vFontColor,
                  float fBBWidth, float fBBHeight, bool bCenter );
-void EndText11( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3d11DeviceContext );
+const DXUTTextStats11* DXUTGetTextStats11();
 
 //-----------------------------------------------------------------------------
 // Base class for controls
@@ -597,19 +699,19 @@ public:
     }
     virtual void    OnFocusIn()
     {
-        m_bHasFocus = true;
+        m_bHasFocus = true; Invalidate();
     }
     virtual void    OnFocusOut()
     {
-        m_bHasFocus = false;
+        m_bHasFocus = false; Invalidate();
     }
     virtual void    OnMouseEnter()
     {
-        m_bMouseOver = true;
+        m_bMouseOver = true; Invalidate();
     }
     virtual void    OnMouseLeave()
     {
-        m_bMouseOver = false;
+        m_bMouseOver = false; Invalidate();
     }
     virtual void    OnHotkey()
     {
@@ -619,10 +721,16 @@ public:
     {
         return PtInRect( &m_rcBoundingBox, pt );
     }
+    // Rect that holds every point ContainsPoint can accept, used to index the control for
+    // hit-testing.  Controls that override this must call UpdateRects when it changes.
+    virtual void    GetHitBounds( RECT* prcBounds )
+    {
+        *prcBounds = m_rcBoundingBox;
+    }
 
     virtual void    SetEnabled( bool bEnabled )
     {
-        m_bEnabled = bEnabled;
+        m_bEnabled = bEnabled; Invalidate();
     }
     virtual bool    GetEnabled()
     {
@@ -630,13 +738,25 @@ public:
     }
     virtual void    SetVisible( bool bVisible )
     {
-        m_bVisible = bVisible;
+        m_bVisible = bVisible; Invalidate();
     }
     virtual bool    GetVisible()
     {
         return m_bVisible;
     }
 
+    // Marks the dialog's retained vertices stale, see CDXUTDialog::EnableRetainedRendering
+    void            Invalidate()
+    {
+        if( m_pDialog )
+            m_pDialog->Invalidate();
+    }
+    // True while the control changes how it looks without input, e.g. a blinking caret
+    virtual bool    IsAnimating()
+    {
+        return false;
+    }
+
     UINT            GetType() const
     {
         return m_Type;
@@ -739,6 +859,10 @@ public:
     {
         return false;
     }
+    virtual void    GetHitBounds( RECT* prcBounds )
+    {
+        SetRectEmpty( prcBounds );
+    }
 
     HRESULT         GetTextCopy( __out_ecount(bufferCount) LPWSTR strDest, 
                                  UINT bufferCount );
@@ -875,6 +999,11 @@ public:
 
     virtual void    Render( float fElapsedTime );
     virtual void    UpdateRects();
+    // Held arrows scroll on a timer
+    virtual bool    IsAnimating()
+    {
+        return m_Arrow != CLEAR;
+    }
 
     void            SetTrackRange( int nStart, int nEnd );
     int             GetTrackPos()
@@ -964,6 +1093,10 @@ public:
 
     virtual void    Render( float fElapsedTime );
     virtual void    UpdateRects();
+    virtual bool    IsAnimating()
+    {
+        return m_ScrollBar.IsAnimating();
+    }
 
     DWORD           GetStyle() const
     {
@@ -1059,6 +1192,10 @@ public:
     }
     virtual void    OnFocusOut();
     virtual void    Render( float fElapsedTime );
+    virtual bool    IsAnimating()
+    {
+        return m_ScrollBar.IsAnimating();
+    }
 
     virtual void    UpdateRects();
 
@@ -1130,6 +1267,7 @@ public:
                     CDXUTSlider( CDXUTDialog* pDialog = NULL );
 
     virtual BOOL    ContainsPoint( POINT pt );
+    virtual void    GetHitBounds( RECT* prcBounds );
     virtual bool    CanHaveFocus()
     {
         return ( m_bVisible && m_bEnabled );
@@ -1306,6 +1444,11 @@ public:
     }
     virtual void    Render( float fElapsedTime );
     virtual void    OnFocusIn();
+    // The caret blinks while the edit box has focus
+    virtual bool    IsAnimating()
+    {
+        return m_bHasFocus;
+    }
 
     void            SetText( LPCWSTR wszText, bool bSelected = false );
     LPCWSTR         GetText()
@@ -1321,19 +1464,19 @@ public:
     void            ClearText();
     virtual void    SetTextColor( D3DCOLOR Color )
     {
-        m_TextColor = Color;
+        m_TextColor = Color; Invalidate();
     }  // Text color
     void            SetSelectedTextColor( D3DCOLOR Color )
     {
-        m_SelTextColor = Color;
+        m_SelTextColor = Color; Invalidate();
     }  // Selected text color
     void            SetSelectedBackColor( D3DCOLOR Color )
     {
-        m_SelBkColor = Color;
+        m_SelBkColor = Color; Invalidate();
     }  // Selected background color
     void            SetCaretColor( D3DCOLOR Color )
     {
-        m_CaretColor = Color;
+        m_CaretColor = Color; Invalidate();
     }  // Caret color
     void            SetBorderWidth( int nBorder )
     {
@@ -1378,6 +1521,22 @@ protected:
 };
 
 
+struct DXUTHITTEST_BENCHMARK
+{
+    UINT   nControls;
+    UINT   nMouseMoves;
+    double fLinearNanosecondsPerMove;   // WM_MOUSEMOVE through CDXUTDialog::MsgProc, linear search
+    double fGridNanosecondsPerMove;     // The same with the hit grid
+    double fGridBuildMilliseconds;
+    float  fCandidatesPerHitTest;       // Controls tested per grid lookup
+    UINT   nMismatches;                 // Points where the grid and the linear search disagree
+};
+
+// Sends nMouseMoves synthetic WM_MOUSEMOVE messages (a random walk with occasional jumps)
+// to an unregistered dialog of nControls labels, buttons, check boxes and sliders, without
+// and with the hit grid
+HRESULT DXUTBenchmarkDialogHitTest( CDXUTDialogResourceManager* pManager, UINT nControls, UINT nMouseMoves,
+                                    DXUTHITTEST_BENCHMARK* pResult );
 
 
 #endif // DXUT_GUI_H
@@ -0,0 +1,650 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTuibatch.cpp
+//
+// Frame-scoped batching of the D3D11 UI
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DXUTgui.h"
+
+// Smallest ring buffer, in vertices (enough for ~340 quads)
+#define DXUT_UIBATCH_MIN_RING_VERTICES 2048
+
+
+//--------------------------------------------------------------------------------------
+// CDXUTUIBatchContext11
+//--------------------------------------------------------------------------------------
+CDXUTUIBatchContext11::CDXUTUIBatchContext11()
+{
+    m_pManager = NULL;
+    m_pVB = NULL;
+    m_pBoundTexture = NULL;
+    m_bBoundUntex = false;
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTUIBatchContext11::~CDXUTUIBatchContext11()
+{
+    Destroy();
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchContext11::Init( CDXUTDialogResourceManager* pManager )
+{
+    m_pManager = pManager;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchContext11::Destroy()
+{
+    SAFE_RELEASE( m_pVB );
+    m_pBoundTexture = NULL;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTUIBatchContext11::CreateVertexBuffer( UINT nVertices )
+{
+    SAFE_RELEASE( m_pVB );
+
+    D3D11_BUFFER_DESC BufferDesc;
+    BufferDesc.ByteWidth = nVertices * sizeof( DXUTSpriteVertex );
+    BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    BufferDesc.MiscFlags = 0;
+    BufferDesc.StructureByteStride = 0;
+
+    HRESULT hr = m_pManager->GetD3D11Device()->CreateBuffer( &BufferDesc, NULL, &m_pVB );
+    if( FAILED( hr ) )
+        return DXUT_ERR( L"CreateBuffer", hr );
+    DXUT_SetDebugName( m_pVB, "CDXUTUIBatchContext11" );
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTUIBatchContext11::Map( bool bDiscard, DXUTSpriteVertex** ppVertices )
+{
+    // Vertices behind the ring position may still be read by the GPU, but the batcher
+    // only writes ahead of it, so the rest of the frame can be appended without a stall
+    D3D11_MAPPED_SUBRESOURCE MappedResource;
+    HRESULT hr = m_pManager->GetD3D11DeviceContext()->Map( m_pVB, 0,
+                                                           bDiscard ? D3D11_MAP_WRITE_DISCARD : D3D11_MAP_WRITE_NO_OVERWRITE,
+                                                           0, &MappedResource );
+    if( FAILED( hr ) )
+        return hr;
+
+    *ppVertices = ( DXUTSpriteVertex* )MappedResource.pData;
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchContext11::Unmap()
+{
+    ID3D11DeviceContext* pd3dImmediateContext = m_pManager->GetD3D11DeviceContext();
+    pd3dImmediateContext->Unmap( m_pVB, 0 );
+
+    UINT Stride = sizeof( DXUTSpriteVertex );
+    UINT Offset = 0;
+    pd3dImmediateContext->IASetVertexBuffers( 0, 1, &m_pVB, &Stride, &Offset );
+    pd3dImmediateContext->IASetInputLayout( m_pManager->m_pInputLayout11 );
+    pd3dImmediateContext->IASetPrimitiveTopology( D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST );
+
+    // The pixel shader and texture are unknown until the first draw of the flush
+    m_pBoundTexture = NULL;
+    m_bBoundUntex = false;
+    pd3dImmediateContext->PSSetShader( m_pManager->m_pPSRenderUI11, NULL, 0 );
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchContext11::Draw( ID3D11ShaderResourceView* pTexture, UINT nVertexCount, UINT nStartVertex )
+{
+    ID3D11DeviceContext* pd3dImmediateContext = m_pManager->GetD3D11DeviceContext();
+
+    if( pTexture == NULL && !m_bBoundUntex )
+    {
+        pd3dImmediateContext->PSSetShader( m_pManager->m_pPSRenderUIUntex11, NULL, 0 );
+        m_bBoundUntex = true;
+    }
+    else if( pTexture != NULL )
+    {
+        if( m_bBoundUntex )
+        {
+            pd3dImmediateContext->PSSetShader( m_pManager->m_pPSRenderUI11, NULL, 0 );
+            m_bBoundUntex = false;
+        }
+        if( pTexture != m_pBoundTexture )
+        {
+            pd3dImmediateContext->PSSetShaderResources( 0, 1, &pTexture );
+            m_pBoundTexture = pTexture;
+        }
+    }
+
+    pd3dImmediateContext->Draw( nVertexCount, nStartVertex );
+}
+
+
+//--------------------------------------------------------------------------------------
+// CDXUTUIBatchNullContext
+//--------------------------------------------------------------------------------------
+CDXUTUIBatchNullContext::CDXUTUIBatchNullContext()
+{
+    ResetCounters();
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTUIBatchNullContext::~CDXUTUIBatchNullContext()
+{
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTUIBatchNullContext::CreateVertexBuffer( UINT nVertices )
+{
+    m_VB.RemoveAll();
+    return m_VB.SetSize( ( int )nVertices );
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTUIBatchNullContext::Map( bool bDiscard, DXUTSpriteVertex** ppVertices )
+{
+    m_nMaps++;
+    if( bDiscard )
+        m_nDiscards++;
+
+    *ppVertices = m_VB.GetData();
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchNullContext::Unmap()
+{
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchNullContext::Draw( ID3D11ShaderResourceView* pTexture, UINT nVertexCount, UINT nStartVertex )
+{
+    assert( nStartVertex + nVertexCount <= ( UINT )m_VB.GetSize() );
+    m_nDraws++;
+    m_nVerticesDrawn += nVertexCount;
+}
+
+
+//--------------------------------------------------------------------------------------
+// CDXUTUIBatchRecording
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchRecording::Add( ID3D11ShaderResourceView* pTexture, const DXUTSpriteVertex* pVertices,
+                                 UINT nVertices )
+{
+    UINT nFirstVertex = m_Vertices.GetSize();
+    if( FAILED( m_Vertices.AddRange( pVertices, ( int )nVertices ) ) )
+        return;
+
+    if( m_Runs.GetSize() > 0 && m_Runs[m_Runs.GetSize() - 1].pTexture == pTexture )
+    {
+        m_Runs[m_Runs.GetSize() - 1].nVertexCount += nVertices;
+        return;
+    }
+
+    Run run;
+    run.pTexture = pTexture;
+    run.nFirstVertex = nFirstVertex;
+    run.nVertexCount = nVertices;
+    m_Runs.Add( run );
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchRecording::Submit( CDXUTUIBatch* pBatch ) const
+{
+    for( int i = 0; i < m_Runs.GetSize(); i++ )
+    {
+        const Run& run = m_Runs[i];
+        pBatch->AddVertices( run.pTexture, m_Vertices.GetData() + run.nFirstVertex, run.nVertexCount );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatchRecording::Reset()
+{
+    m_Vertices.Reset();
+    m_Runs.Reset();
+}
+
+
+//--------------------------------------------------------------------------------------
+// CDXUTUIBatch
+//--------------------------------------------------------------------------------------
+CDXUTUIBatch::CDXUTUIBatch()
+{
+    m_pRecording = NULL;
+    m_nRingVertices = 0;
+    m_nRingPosition = 0;
+    ZeroMemory( &m_LastStats, sizeof( m_LastStats ) );
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTUIBatch::~CDXUTUIBatch()
+{
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatch::AddVertices( ID3D11ShaderResourceView* pTexture, const DXUTSpriteVertex* pVertices,
+                                UINT nVertices )
+{
+    if( nVertices == 0 )
+        return;
+
+    if( m_pRecording )
+        m_pRecording->Add( pTexture, pVertices, nVertices );
+
+    if( FAILED( m_Vertices.AddRange( pVertices, ( int )nVertices ) ) )
+        return;
+
+    float fMinX = pVertices[0].vPos.x, fMaxX = pVertices[0].vPos.x;
+    float fMinY = pVertices[0].vPos.y, fMaxY = pVertices[0].vPos.y;
+    for( UINT i = 1; i < nVertices; i++ )
+    {
+        fMinX = min( fMinX, pVertices[i].vPos.x );
+        fMaxX = max( fMaxX, pVertices[i].vPos.x );
+        fMinY = min( fMinY, pVertices[i].vPos.y );
+        fMaxY = max( fMaxY, pVertices[i].vPos.y );
+    }
+
+    // Extend the current run if the texture did not change
+    if( m_Runs.GetSize() > 0 && m_Runs[m_Runs.GetSize() - 1].pTexture == pTexture )
+    {
+        Run& run = m_Runs[m_Runs.GetSize() - 1];
+        run.nVertexCount += nVertices;
+        run.fMinX = min( run.fMinX, fMinX );
+        run.fMaxX = max( run.fMaxX, fMaxX );
+        run.fMinY = min( run.fMinY, fMinY );
+        run.fMaxY = max( run.fMaxY, fMaxY );
+        return;
+    }
+
+    Run run;
+    run.pTexture = pTexture;
+    run.nFirstVertex = m_Vertices.GetSize() - nVertices;
+    run.nVertexCount = nVertices;
+    run.fMinX = fMinX;
+    run.fMaxX = fMaxX;
+    run.fMinY = fMinY;
+    run.fMaxY = fMaxY;
+    run.nLevel = 0;
+    run.nSequence = m_Runs.GetSize();
+    m_Runs.Add( run );
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatch::BeginRecording( CDXUTUIBatchRecording* pRecording )
+{
+    assert( m_pRecording == NULL );
+    m_pRecording = pRecording;
+    if( m_pRecording )
+        m_pRecording->Reset();
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatch::EndRecording()
+{
+    m_pRecording = NULL;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatch::AddUntexturedQuad( float fLeft, float fTop, float fRight, float fBottom, float fDepth,
+                                      const D3DXCOLOR& TopLeft, const D3DXCOLOR& TopRight,
+                                      const D3DXCOLOR& BottomLeft, const D3DXCOLOR& BottomRight )
+{
+    DXUTSpriteVertex Vertices[6];
+    Vertices[0].vPos = D3DXVECTOR3( fLeft, fTop, fDepth );
+    Vertices[0].vColor = TopLeft;
+    Vertices[1].vPos = D3DXVECTOR3( fRight, fTop, fDepth );
+    Vertices[1].vColor = TopRight;
+    Vertices[2].vPos = D3DXVECTOR3( fLeft, fBottom, fDepth );
+    Vertices[2].vColor = BottomLeft;
+    Vertices[3] = Vertices[1];
+    Vertices[4].vPos = D3DXVECTOR3( fRight, fBottom, fDepth );
+    Vertices[4].vColor = BottomRight;
+    Vertices[5] = Vertices[2];
+
+    for( int i = 0; i < 6; i++ )
+        Vertices[i].vTex = D3DXVECTOR2( 0.0f, 0.0f );
+
+    AddVertices( NULL, Vertices, 6 );
+}
+
+
+//--------------------------------------------------------------------------------------
+int __cdecl CDXUTUIBatch::CompareRuns( const void* pA, const void* pB )
+{
+    const Run* pRunA = *( const Run** )pA;
+    const Run* pRunB = *( const Run** )pB;
+
+    if( pRunA->nLevel != pRunB->nLevel )
+        return pRunA->nLevel < pRunB->nLevel ? -1 : 1;
+    if( pRunA->pTexture != pRunB->pTexture )
+        return pRunA->pTexture < pRunB->pTexture ? -1 : 1;
+    return pRunA->nSequence < pRunB->nSequence ? -1 : ( pRunA->nSequence > pRunB->nSequence ? 1 : 0 );
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTUIBatch::Flush( IDXUTUIBatchContext* pContext )
+{
+    HRESULT hr;
+
+    DXUTUIBatchStats Stats;
+    ZeroMemory( &Stats, sizeof( Stats ) );
+
+    UINT nVertices = m_Vertices.GetSize();
+    if( nVertices == 0 )
+    {
+        m_LastStats = Stats;
+        return S_OK;
+    }
+
+    // Resolve the draw order.  A UI frame holds a few hundred runs at most, so the
+    // quadratic overlap test is cheaper than any spatial structure
+    m_SortedRuns.Reset();
+    for( int i = 0; i < m_Runs.GetSize(); i++ )
+    {
+        Run& run = m_Runs[i];
+        run.nLevel = 0;
+        for( int j = 0; j < i; j++ )
+        {
+            const Run& below = m_Runs[j];
+            if( below.fMaxX <= run.fMinX || run.fMaxX <= below.fMinX ||
+                below.fMaxY <= run.fMinY || run.fMaxY <= below.fMinY )
+                continue;
+
+            run.nLevel = max( run.nLevel, below.pTexture == run.pTexture ? below.nLevel : below.nLevel + 1 );
+        }
+        Stats.nLevels = max( Stats.nLevels, run.nLevel + 1 );
+        m_SortedRuns.Add( &run );
+    }
+    qsort( m_SortedRuns.GetData(), m_SortedRuns.GetSize(), sizeof( Run* ), CompareRuns );
+
+    // Find room in the ring; the whole frame is uploaded with a single Map
+    bool bDiscard = false;
+    if( nVertices > m_nRingVertices )
+    {
+        UINT nRingVertices = max( max( nVertices, m_nRingVertices * 2 ), ( UINT )DXUT_UIBATCH_MIN_RING_VERTICES );
+        if( FAILED( hr = pContext->CreateVertexBuffer( nRingVertices ) ) )
+        {
+            m_nRingVertices = 0;
+            Reset();
+            return hr;
+        }
+        m_nRingVertices = nRingVertices;
+        m_nRingPosition = 0;
+        bDiscard = true;
+        Stats.nRingGrows++;
+    }
+    else if( m_nRingPosition + nVertices > m_nRingVertices )
+    {
+        m_nRingPosition = 0;
+        bDiscard = true;
+        Stats.nRingWraps++;
+    }
+
+    DXUTSpriteVertex* pDest = NULL;
+    if( FAILED( hr = pContext->Map( bDiscard, &pDest ) ) )
+    {
+        Reset();
+        return hr;
+    }
+    Stats.nMaps++;
+
+    DXUTSpriteVertex* pWrite = pDest + m_nRingPosition;
+    for( int i = 0; i < m_SortedRuns.GetSize(); i++ )
+    {
+        const Run* pRun = m_SortedRuns[i];
+        CopyMemory( pWrite, m_Vertices.GetData() + pRun->nFirstVertex, pRun->nVertexCount * sizeof( DXUTSpriteVertex ) );
+        pWrite += pRun->nVertexCount;
+    }
+    pContext->Unmap();
+
+    // Consecutive runs with the same texture are contiguous in the ring, so they merge
+    UINT nStart = m_nRingPosition;
+    for( int i = 0; i < m_SortedRuns.GetSize(); )
+    {
+        ID3D11ShaderResourceView* pTexture = m_SortedRuns[i]->pTexture;
+        UINT nCount = 0;
+        while( i < m_SortedRuns.GetSize() && m_SortedRuns[i]->pTexture == pTexture )
+            nCount += m_SortedRuns[i++]->nVertexCount;
+
+        pContext->Draw( pTexture, nCount, nStart );
+        nStart += nCount;
+        Stats.nDraws++;
+    }
+
+    m_nRingPosition += nVertices;
+
+    Stats.nQuads = nVertices / 6;
+    Stats.nVerticesUploaded = nVertices;
+    m_LastStats = Stats;
+
+    m_Vertices.Reset();
+    m_Runs.Reset();
+    m_SortedRuns.Reset();
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTUIBatch::Reset()
+{
+    m_Vertices.RemoveAll();
+    m_Runs.RemoveAll();
+    m_SortedRuns.RemoveAll();
+    m_nRingVertices = 0;
+    m_nRingPosition = 0;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DXUTBenchmarkUIBatch( UINT nQuadsPerFrame, UINT nFrames, DXUTUIBATCH_BENCHMARK* pResult )
+{
+    HRESULT hr;
+
+    if( pResult == NULL || nFrames == 0 )
+        return E_INVALIDARG;
+
+    // Two fake textures, one for the control sprites and one for the font; the batch
+    // only compares the pointers
+    ID3D11ShaderResourceView* pSpriteTexture = ( ID3D11ShaderResourceView* )( UINT_PTR )0x10;
+    ID3D11ShaderResourceView* pFontTexture = ( ID3D11ShaderResourceView* )( UINT_PTR )0x20;
+
+    // Half of the quads are sprites, the other half glyphs of 8 character strings, laid
+    // out on a grid like the controls of a dialog
+    const UINT nGlyphsPerRun = 8;
+    CGrowableArray<DXUTSpriteVertex> Quads;
+    V_RETURN( Quads.SetSize( ( int )max( nQuadsPerFrame, nGlyphsPerRun ) * 6 ) );
+    for( int q = 0; q < Quads.GetSize() / 6; q++ )
+    {
+        float fLeft = -1.0f + 0.02f * ( q % 100 );
+        float fTop = 1.0f - 0.04f * ( ( q / 100 ) % 50 );
+        float fRight = fLeft + 0.015f;
+        float fBottom = fTop - 0.03f;
+        DXUTSpriteVertex* pQuad = &Quads[q * 6];
+        pQuad[0].vPos = D3DXVECTOR3( fLeft, fTop, 0.5f );
+        pQuad[1].vPos = D3DXVECTOR3( fRight, fTop, 0.5f );
+        pQuad[2].vPos = D3DXVECTOR3( fLeft, fBottom, 0.5f );
+        pQuad[3] = pQuad[1];
+        pQuad[4].vPos = D3DXVECTOR3( fRight, fBottom, 0.5f );
+        pQuad[5] = pQuad[2];
+        for( int v = 0; v < 6; v++ )
+        {
+            pQuad[v].vColor = D3DXCOLOR( 1.0f, 1.0f, 1.0f, 1.0f );
+            pQuad[v].vTex = D3DXVECTOR2( 0.0f, 0.0f );
+        }
+    }
+
+    CDXUTUIBatch Batch;
+    CDXUTUIBatchNullContext Context;
+
+    LARGE_INTEGER Frequency, Start, Appended, End;
+    LONGLONG llAppend = 0, llFlush = 0;
+    QueryPerformanceFrequency( &Frequency );
+
+    for( UINT iFrame = 0; iFrame < nFrames; iFrame++ )
+    {
+        Context.ResetCounters();
+        QueryPerformanceCounter( &Start );
+
+        UINT q = 0;
+        while( q < nQuadsPerFrame )
+        {
+            // One control: a sprite followed by its caption
+            Batch.AddVertices( pSpriteTexture, &Quads[q * 6], 6 );
+            q++;
+
+            UINT nGlyphs = min( nGlyphsPerRun, nQuadsPerFrame - q );
+            if( nGlyphs > 0 )
+                Batch.AddVertices( pFontTexture, &Quads[q * 6], nGlyphs * 6 );
+            q += nGlyphs;
+        }
+
+        QueryPerformanceCounter( &Appended );
+        V_RETURN( Batch.Flush( &Context ) );
+        QueryPerformanceCounter( &End );
+
+        llAppend += Appended.QuadPart - Start.QuadPart;
+        llFlush += End.QuadPart - Appended.QuadPart;
+    }
+
+    pResult->nFrames = nFrames;
+    pResult->nQuadsPerFrame = nQuadsPerFrame;
+    pResult->fAppendSecondsPerFrame = ( double )llAppend / ( double )Frequency.QuadPart / nFrames;
+    pResult->fFlushSecondsPerFrame = ( double )llFlush / ( double )Frequency.QuadPart / nFrames;
+    pResult->fNanosecondsPerQuad = nQuadsPerFrame ?
+        ( pResult->fAppendSecondsPerFrame + pResult->fFlushSecondsPerFrame ) * 1e9 / nQuadsPerFrame : 0.0;
+    pResult->nMapsPerFrame = Context.GetNumMaps();
+    pResult->nDrawsPerFrame = Context.GetNumDraws();
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// DXUTTestUIBatch helpers
+//--------------------------------------------------------------------------------------
+static void AddTestQuad( CDXUTUIBatch* pBatch, ID3D11ShaderResourceView* pTexture,
+                         float fLeft, float fTop, float fWidth, float fHeight )
+{
+    DXUTSpriteVertex Quad[6];
+    Quad[0].vPos = D3DXVECTOR3( fLeft, fTop, 0.5f );
+    Quad[1].vPos = D3DXVECTOR3( fLeft + fWidth, fTop, 0.5f );
+    Quad[2].vPos = D3DXVECTOR3( fLeft, fTop - fHeight, 0.5f );
+    Quad[3] = Quad[1];
+    Quad[4].vPos = D3DXVECTOR3( fLeft + fWidth, fTop - fHeight, 0.5f );
+    Quad[5] = Quad[2];
+    for( int v = 0; v < 6; v++ )
+    {
+        Quad[v].vColor = D3DXCOLOR( 1.0f, 1.0f, 1.0f, 1.0f );
+        Quad[v].vTex = D3DXVECTOR2( 0.0f, 0.0f );
+    }
+    pBatch->AddVertices( pTexture, Quad, 6 );
+}
+
+static bool CheckUIBatchCount( LPCWSTR strCase, LPCWSTR strCounter, UINT nActual, UINT nExpected )
+{
+    if( nActual == nExpected )
+        return true;
+
+    WCHAR strMsg[256];
+    swprintf_s( strMsg, 256, L"DXUTTestUIBatch: %s: %u %s, expected %u\n", strCase, nActual, strCounter, nExpected );
+    OutputDebugString( strMsg );
+    return false;
+}
+
+// Flushes pBatch into pContext and compares the calls it made with the expected ones
+static bool CheckUIBatchFlush( LPCWSTR strCase, CDXUTUIBatch* pBatch, CDXUTUIBatchNullContext* pContext,
+                               UINT nExpectedDraws, UINT nExpectedMaps, UINT nExpectedDiscards )
+{
+    UINT nQueued = pBatch->GetNumQueuedVertices();
+    pContext->ResetCounters();
+    if( FAILED( pBatch->Flush( pContext ) ) )
+        return CheckUIBatchCount( strCase, L"successful flushes", 0, 1 );
+
+    bool bPassed = CheckUIBatchCount( strCase, L"draws", pContext->GetNumDraws(), nExpectedDraws );
+    bPassed &= CheckUIBatchCount( strCase, L"maps", pContext->GetNumMaps(), nExpectedMaps );
+    bPassed &= CheckUIBatchCount( strCase, L"discards", pContext->GetNumDiscards(), nExpectedDiscards );
+    bPassed &= CheckUIBatchCount( strCase, L"vertices drawn", pContext->GetNumVerticesDrawn(), nQueued );
+    bPassed &= CheckUIBatchCount( strCase, L"reported draws", pBatch->GetStats().nDraws, pContext->GetNumDraws() );
+    return bPassed;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT DXUTTestUIBatch()
+{
+    ID3D11ShaderResourceView* pSpriteTexture = ( ID3D11ShaderResourceView* )( UINT_PTR )0x10;
+    ID3D11ShaderResourceView* pFontTexture = ( ID3D11ShaderResourceView* )( UINT_PTR )0x20;
+
+    CDXUTUIBatch Batch;
+    CDXUTUIBatchNullContext Context;
+    bool bPassed = true;
+
+    // Nothing queued: no upload, no draw
+    bPassed &= CheckUIBatchFlush( L"empty frame", &Batch, &Context, 0, 0, 0 );
+
+    // Controls whose captions sit beside their sprites: nothing overlaps, one draw per
+    // texture.  The first flush creates the ring, so its only Map discards.
+    for( int i = 0; i < 50; i++ )
+    {
+        AddTestQuad( &Batch, pSpriteTexture, -1.0f + 0.04f * i, 0.9f, 0.01f, 0.01f );
+        AddTestQuad( &Batch, pFontTexture, -0.98f + 0.04f * i, 0.9f, 0.01f, 0.01f );
+    }
+    bPassed &= CheckUIBatchFlush( L"side by side", &Batch, &Context, 2, 1, 1 );
+
+    // Captions over their sprites: sprites on level 0, captions on level 1.  The ring has
+    // room left, so this frame is appended without a discard.
+    for( int i = 0; i < 50; i++ )
+    {
+        AddTestQuad( &Batch, pSpriteTexture, -1.0f + 0.04f * i, 0.5f, 0.03f, 0.03f );
+        AddTestQuad( &Batch, pFontTexture, -0.995f + 0.04f * i, 0.495f, 0.01f, 0.01f );
+    }
+    bPassed &= CheckUIBatchFlush( L"caption over sprite", &Batch, &Context, 2, 1, 0 );
+
+    // A dialog background under the controls adds the untextured level below them
+    Batch.AddUntexturedQuad( -1.0f, 1.0f, 1.0f, -1.0f, 0.5f, D3DXCOLOR( 0, 0, 0, 1 ), D3DXCOLOR( 0, 0, 0, 1 ),
+                             D3DXCOLOR( 0, 0, 0, 1 ), D3DXCOLOR( 0, 0, 0, 1 ) );
+    for( int i = 0; i < 10; i++ )
+    {
+        AddTestQuad( &Batch, pSpriteTexture, -1.0f + 0.1f * i, 0.0f, 0.05f, 0.05f );
+        AddTestQuad( &Batch, pFontTexture, -0.99f + 0.1f * i, -0.01f, 0.02f, 0.02f );
+    }
+    bPassed &= CheckUIBatchFlush( L"dialog background", &Batch, &Context, 3, 1, 0 );
+
+    // Alternating textures stacked on one spot keep their order: no draw can merge
+    for( int i = 0; i < 4; i++ )
+        AddTestQuad( &Batch, ( i & 1 ) ? pFontTexture : pSpriteTexture, 0.0f, 0.0f, 0.1f, 0.1f );
+    bPassed &= CheckUIBatchFlush( L"stacked", &Batch, &Context, 4, 1, 0 );
+
+    // A frame larger than the ring grows it, which discards
+    for( int i = 0; i < DXUT_UIBATCH_MIN_RING_VERTICES / 6 + 1; i++ )
+        AddTestQuad( &Batch, pFontTexture, -1.0f + 0.001f * i, -0.5f, 0.001f, 0.01f );
+    bPassed &= CheckUIBatchFlush( L"ring growth", &Batch, &Context, 1, 1, 1 );
+    bPassed &= CheckUIBatchCount( L"ring growth", L"ring grows", Batch.GetStats().nRingGrows, 1 );
+
+    return bPassed ? S_OK : E_FAIL;
+}
@@ -0,0 +1,214 @@
+//--------------------------------------------------------------------------------------
+// File: DXUTuibatch.h
+//
+// Frame-scoped batching of the D3D11 UI.  Dialogs and text helpers queue textured quads
+// (sprites, glyphs) and untextured quads (dialog backgrounds) during the frame; Flush
+// orders them back to front, uploads the whole frame with one Map into a ring buffer
+// that persists across frames, and draws one sub-batch per run of equal textures.
+//
+// The batcher only talks to the GPU through IDXUTUIBatchContext, so it can be driven by
+// a mock context that counts the Map and Draw calls it would issue.
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef DXUT_UIBATCH_H
+#define DXUT_UIBATCH_H
+
+class CDXUTDialogResourceManager;
+
+struct DXUTSpriteVertex
+{
+    D3DXVECTOR3 vPos;
+    D3DXCOLOR vColor;
+    D3DXVECTOR2 vTex;
+};
+
+//--------------------------------------------------------------------------------------
+// Where the batcher uploads and draws.  The vertex buffer holds DXUTSpriteVertex and is
+// drawn as a triangle list; a NULL texture selects the untextured pixel shader.
+//--------------------------------------------------------------------------------------
+class IDXUTUIBatchContext
+{
+public:
+    virtual         ~IDXUTUIBatchContext() {}
+
+    // Replace the vertex buffer by one that holds nVertices vertices
+    virtual HRESULT CreateVertexBuffer( UINT nVertices ) = 0;
+    virtual HRESULT Map( bool bDiscard, DXUTSpriteVertex** ppVertices ) = 0;
+    virtual void    Unmap() = 0;
+    virtual void    Draw( ID3D11ShaderResourceView* pTexture, UINT nVertexCount, UINT nStartVertex ) = 0;
+};
+
+//--------------------------------------------------------------------------------------
+// D3D11 implementation, draws with the UI shaders and states of a dialog resource manager.
+// Expects the UI render state to be applied (CDXUTDialogResourceManager::ApplyRenderUI11).
+//--------------------------------------------------------------------------------------
+class CDXUTUIBatchContext11 : public IDXUTUIBatchContext
+{
+public:
+                    CDXUTUIBatchContext11();
+                    ~CDXUTUIBatchContext11();
+
+    void            Init( CDXUTDialogResourceManager* pManager );
+    void            Destroy();
+
+    virtual HRESULT CreateVertexBuffer( UINT nVertices );
+    virtual HRESULT Map( bool bDiscard, DXUTSpriteVertex** ppVertices );
+    virtual void    Unmap();
+    virtual void    Draw( ID3D11ShaderResourceView* pTexture, UINT nVertexCount, UINT nStartVertex );
+
+protected:
+    CDXUTDialogResourceManager* m_pManager;
+    ID3D11Buffer* m_pVB;
+    ID3D11ShaderResourceView* m_pBoundTexture;
+    bool m_bBoundUntex;
+};
+
+//--------------------------------------------------------------------------------------
+// Context that draws nothing: the vertex buffer lives in system memory and the Map and
+// Draw calls are only counted.  Used by DXUTBenchmarkUIBatch, and as a mock context.
+//--------------------------------------------------------------------------------------
+class CDXUTUIBatchNullContext : public IDXUTUIBatchContext
+{
+public:
+                    CDXUTUIBatchNullContext();
+                    ~CDXUTUIBatchNullContext();
+
+    virtual HRESULT CreateVertexBuffer( UINT nVertices );
+    virtual HRESULT Map( bool bDiscard, DXUTSpriteVertex** ppVertices );
+    virtual void    Unmap();
+    virtual void    Draw( ID3D11ShaderResourceView* pTexture, UINT nVertexCount, UINT nStartVertex );
+
+    UINT            GetNumMaps() const { return m_nMaps; }
+    UINT            GetNumDiscards() const { return m_nDiscards; }
+    UINT            GetNumDraws() const { return m_nDraws; }
+    UINT            GetNumVerticesDrawn() const { return m_nVerticesDrawn; }
+    void            ResetCounters() { m_nMaps = m_nDiscards = m_nDraws = m_nVerticesDrawn = 0; }
+
+protected:
+    CGrowableArray<DXUTSpriteVertex> m_VB;
+    UINT m_nMaps;
+    UINT m_nDiscards;
+    UINT m_nDraws;
+    UINT m_nVerticesDrawn;
+};
+
+struct DXUTUIBatchStats
+{
+    UINT nQuads;
+    UINT nVerticesUploaded;
+    UINT nMaps;
+    UINT nDraws;
+    UINT nLevels;               // Back to front layers after resolving overlaps
+    UINT nRingWraps;            // Flushes that had to discard the ring buffer
+    UINT nRingGrows;            // Flushes that had to recreate the ring buffer
+};
+
+class CDXUTUIBatch;
+
+//--------------------------------------------------------------------------------------
+// Vertices queued into a CDXUTUIBatch between BeginRecording and EndRecording, kept so
+// that they can be queued again in later frames without generating them again
+//--------------------------------------------------------------------------------------
+class CDXUTUIBatchRecording
+{
+public:
+    void            Add( ID3D11ShaderResourceView* pTexture, const DXUTSpriteVertex* pVertices, UINT nVertices );
+    // Queue the recorded vertices into pBatch, in the order they were recorded
+    void            Submit( CDXUTUIBatch* pBatch ) const;
+    // Forget the vertices, keep the memory
+    void            Reset();
+
+    UINT            GetNumVertices() const { return m_Vertices.GetSize(); }
+
+protected:
+    struct Run
+    {
+        ID3D11ShaderResourceView* pTexture;
+        UINT nFirstVertex;
+        UINT nVertexCount;
+    };
+
+    CGrowableArray<DXUTSpriteVertex> m_Vertices;
+    CGrowableArray<Run> m_Runs;
+};
+
+//--------------------------------------------------------------------------------------
+// CDXUTUIBatch
+//
+// Consecutive quads with the same texture form a run.  At Flush every run is assigned a
+// level: one above every earlier overlapping run with a different texture, and at least
+// the level of every earlier overlapping run with the same texture.  Drawing the runs by
+// level, then by texture, keeps the submission order wherever two runs overlap, so the
+// runs of a level can be merged into one draw per texture.
+//--------------------------------------------------------------------------------------
+class CDXUTUIBatch
+{
+public:
+                    CDXUTUIBatch();
+                    ~CDXUTUIBatch();
+
+    // Queue nVertices triangle list vertices in clip space
+    void            AddVertices( ID3D11ShaderResourceView* pTexture, const DXUTSpriteVertex* pVertices,
+                                 UINT nVertices );
+    // Queue a quad with one color per corner, without texture
+    void            AddUntexturedQuad( float fLeft, float fTop, float fRight, float fBottom, float fDepth,
+                                       const D3DXCOLOR& TopLeft, const D3DXCOLOR& TopRight,
+                                       const D3DXCOLOR& BottomLeft, const D3DXCOLOR& BottomRight );
+
+    // Until EndRecording, everything queued is also appended to pRecording (after resetting it)
+    void            BeginRecording( CDXUTUIBatchRecording* pRecording );
+    void            EndRecording();
+
+    // Upload and draw everything queued since the last flush
+    HRESULT         Flush( IDXUTUIBatchContext* pContext );
+    // Drop the queue and the ring buffer (the context's buffer is released by its owner)
+    void            Reset();
+
+    UINT            GetNumQueuedVertices() const { return m_Vertices.GetSize(); }
+    const DXUTUIBatchStats& GetStats() const { return m_LastStats; }
+
+protected:
+    struct Run
+    {
+        ID3D11ShaderResourceView* pTexture;
+        UINT nFirstVertex;
+        UINT nVertexCount;
+        float fMinX, fMinY, fMaxX, fMaxY;       // Clip space bounds
+        UINT nLevel;
+        UINT nSequence;
+    };
+
+    static int __cdecl CompareRuns( const void* pA, const void* pB );
+
+    CGrowableArray<DXUTSpriteVertex> m_Vertices;
+    CGrowableArray<Run> m_Runs;
+    CGrowableArray<Run*> m_SortedRuns;
+
+    CDXUTUIBatchRecording* m_pRecording;
+
+    UINT m_nRingVertices;           // Capacity of the context's vertex buffer
+    UINT m_nRingPosition;           // First free vertex
+
+    DXUTUIBatchStats m_LastStats;
+};
+
+struct DXUTUIBATCH_BENCHMARK
+{
+    UINT   nFrames;
+    UINT   nQuadsPerFrame;
+    double fAppendSecondsPerFrame;      // Queuing sprites and glyph runs
+    double fFlushSecondsPerFrame;       // Ordering and copying into the ring (null context)
+    double fNanosecondsPerQuad;         // Append and flush
+    UINT   nMapsPerFrame;
+    UINT   nDrawsPerFrame;
+};
+
+// Times the per-frame append paths of the UI: nQuadsPerFrame quads are queued every frame,
+// as single sprites and as 8 glyph runs, and flushed to a CDXUTUIBatchNullContext
+HRESULT DXUTBenchmarkUIBatch( UINT nQuadsPerFrame, UINT nFrames, DXUTUIBATCH_BENCHMARK* pResult );
+
+// Drives a CDXUTUIBatch with a CDXUTUIBatchNullContext through known frames and checks the
+// Map and Draw calls it issues.  Mismatches go to the debug output; E_FAIL if any.
+HRESULT DXUTTestUIBatch();
+
+#endif
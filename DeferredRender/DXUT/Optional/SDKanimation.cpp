@@ -0,0 +1,546 @@
+//--------------------------------------------------------------------------------------
+// File: SDKAnimation.cpp
+//
+// Offline compression and runtime sampling of SDKANIMATION tracks
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+#include "SDKAnimation.h"
+
+using namespace DirectX;
+
+#define QUANTIZE_VECTOR_MAX    65535.0f
+#define QUANTIZE_QUAT_MAX      32767.0f
+#define QUANTIZE_QUAT_RANGE    0.70710678f     // Components other than the largest lie in [-1/sqrt(2), 1/sqrt(2)]
+
+//--------------------------------------------------------------------------------------
+// Helpers for reading raw SDKANIMATION_DATA
+//--------------------------------------------------------------------------------------
+static XMVECTOR LoadRawOrientation( const SDKANIMATION_DATA* pData )
+{
+    XMVECTOR vQuat = XMLoadFloat4( ( const XMFLOAT4* )&pData->Orientation );
+    if( XMVector4Equal( vQuat, XMVectorZero() ) )
+        return XMQuaternionIdentity();
+    return XMQuaternionNormalize( vQuat );
+}
+
+//--------------------------------------------------------------------------------------
+// Angle between two rotations, independent of the quaternion sign
+//--------------------------------------------------------------------------------------
+static float QuaternionAngle( FXMVECTOR q0, FXMVECTOR q1 )
+{
+    float fDot = fabsf( XMVectorGetX( XMQuaternionDot( q0, q1 ) ) );
+    return 2.0f * acosf( min( fDot, 1.0f ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Error-bounded key removal.  Starting from the last kept key, the segment is extended
+// as long as every skipped key is reproduced by interpolating the segment end points.
+// IsWithinError( iStart, iEnd, iKey ) tests one skipped key.
+//--------------------------------------------------------------------------------------
+template<typename ERRORFUNC> static void ReduceKeys( UINT NumKeys, const ERRORFUNC& IsWithinError,
+                                                     CGrowableArray<USHORT>& KeptKeys )
+{
+    KeptKeys.RemoveAll();
+    if( NumKeys == 0 )
+        return;
+
+    KeptKeys.Add( 0 );
+
+    UINT iStart = 0;
+    for( UINT iEnd = 2; iEnd < NumKeys; iEnd++ )
+    {
+        bool bFits = true;
+        for( UINT iKey = iStart + 1; iKey < iEnd && bFits; iKey++ )
+            bFits = IsWithinError( iStart, iEnd, iKey );
+
+        if( !bFits )
+        {
+            iStart = iEnd - 1;
+            KeptKeys.Add( ( USHORT )iStart );
+        }
+    }
+
+    if( NumKeys > 1 )
+        KeptKeys.Add( ( USHORT )( NumKeys - 1 ) );
+}
+
+//--------------------------------------------------------------------------------------
+static SDKANIMATION_QUANTIZED_VECTOR3 QuantizeVector( FXMVECTOR v, const D3DXVECTOR3& Min, const D3DXVECTOR3& Range )
+{
+    XMFLOAT3 f;
+    XMStoreFloat3( &f, v );
+
+    SDKANIMATION_QUANTIZED_VECTOR3 q;
+    q.v[0] = ( USHORT )( Range.x > 0.0f ? ( ( f.x - Min.x ) / Range.x ) * QUANTIZE_VECTOR_MAX + 0.5f : 0.0f );
+    q.v[1] = ( USHORT )( Range.y > 0.0f ? ( ( f.y - Min.y ) / Range.y ) * QUANTIZE_VECTOR_MAX + 0.5f : 0.0f );
+    q.v[2] = ( USHORT )( Range.z > 0.0f ? ( ( f.z - Min.z ) / Range.z ) * QUANTIZE_VECTOR_MAX + 0.5f : 0.0f );
+    return q;
+}
+
+//--------------------------------------------------------------------------------------
+static XMVECTOR DequantizeVector( const SDKANIMATION_QUANTIZED_VECTOR3& q, const D3DXVECTOR3& Min,
+                                  const D3DXVECTOR3& Range )
+{
+    return XMVectorSet( Min.x + Range.x * ( q.v[0] / QUANTIZE_VECTOR_MAX ),
+                        Min.y + Range.y * ( q.v[1] / QUANTIZE_VECTOR_MAX ),
+                        Min.z + Range.z * ( q.v[2] / QUANTIZE_VECTOR_MAX ),
+                        0.0f );
+}
+
+//--------------------------------------------------------------------------------------
+// Smallest-three encoding: drop the largest component (made positive by flipping the
+// quaternion) and store the other three with 15 bits each
+//--------------------------------------------------------------------------------------
+static SDKANIMATION_QUANTIZED_QUATERNION QuantizeQuaternion( FXMVECTOR vQuat )
+{
+    XMFLOAT4 f;
+    XMStoreFloat4( &f, vQuat );
+    float c[4] = { f.x, f.y, f.z, f.w };
+
+    UINT iLargest = 0;
+    for( UINT i = 1; i < 4; i++ )
+    {
+        if( fabsf( c[i] ) > fabsf( c[iLargest] ) )
+            iLargest = i;
+    }
+    float fSign = c[iLargest] < 0.0f ? -1.0f : 1.0f;
+
+    SDKANIMATION_QUANTIZED_QUATERNION q;
+    for( UINT i = 0, j = 0; i < 4; i++ )
+    {
+        if( i == iLargest )
+            continue;
+
+        float fNormalized = ( fSign * c[i] ) / ( 2.0f * QUANTIZE_QUAT_RANGE ) + 0.5f;
+        fNormalized = max( 0.0f, min( 1.0f, fNormalized ) );
+        q.v[j++] = ( USHORT )( fNormalized * QUANTIZE_QUAT_MAX + 0.5f );
+    }
+    q.v[0] |= ( USHORT )( ( iLargest & 1 ) << 15 );
+    q.v[1] |= ( USHORT )( ( iLargest >> 1 ) << 15 );
+    return q;
+}
+
+//--------------------------------------------------------------------------------------
+static XMVECTOR DequantizeQuaternion( const SDKANIMATION_QUANTIZED_QUATERNION& q )
+{
+    UINT iLargest = ( ( q.v[0] >> 15 ) & 1 ) | ( ( ( q.v[1] >> 15 ) & 1 ) << 1 );
+
+    float c[4];
+    float fSumSq = 0.0f;
+    for( UINT i = 0, j = 0; i < 4; i++ )
+    {
+        if( i == iLargest )
+            continue;
+
+        float fNormalized = ( q.v[j++] & 0x7fff ) / QUANTIZE_QUAT_MAX;
+        c[i] = ( fNormalized - 0.5f ) * ( 2.0f * QUANTIZE_QUAT_RANGE );
+        fSumSq += c[i] * c[i];
+    }
+    c[iLargest] = sqrtf( max( 0.0f, 1.0f - fSumSq ) );
+
+    return XMQuaternionNormalize( XMVectorSet( c[0], c[1], c[2], c[3] ) );
+}
+
+//--------------------------------------------------------------------------------------
+CDXUTCompressedAnimation::CDXUTCompressedAnimation() : m_pTracks( NULL ),
+                                                       m_pTranslationTicks( NULL ),
+                                                       m_pTranslations( NULL ),
+                                                       m_pOrientationTicks( NULL ),
+                                                       m_pOrientations( NULL ),
+                                                       m_pScalingTicks( NULL ),
+                                                       m_pScalings( NULL )
+{
+    ZeroMemory( &m_Header, sizeof( m_Header ) );
+}
+
+//--------------------------------------------------------------------------------------
+CDXUTCompressedAnimation::~CDXUTCompressedAnimation()
+{
+    Destroy();
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTCompressedAnimation::Destroy()
+{
+    SAFE_DELETE_ARRAY( m_pTracks );
+    SAFE_DELETE_ARRAY( m_pTranslationTicks );
+    SAFE_DELETE_ARRAY( m_pTranslations );
+    SAFE_DELETE_ARRAY( m_pOrientationTicks );
+    SAFE_DELETE_ARRAY( m_pOrientations );
+    SAFE_DELETE_ARRAY( m_pScalingTicks );
+    SAFE_DELETE_ARRAY( m_pScalings );
+    ZeroMemory( &m_Header, sizeof( m_Header ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Allocate the track and key arrays for the counts in m_Header
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTCompressedAnimation::Allocate()
+{
+    m_pTracks = new SDKANIMATION_COMPRESSED_TRACK[ m_Header.NumTracks ];
+    m_pTranslationTicks = new USHORT[ m_Header.NumTranslationKeys ];
+    m_pTranslations = new SDKANIMATION_QUANTIZED_VECTOR3[ m_Header.NumTranslationKeys ];
+    m_pOrientationTicks = new USHORT[ m_Header.NumOrientationKeys ];
+    m_pOrientations = new SDKANIMATION_QUANTIZED_QUATERNION[ m_Header.NumOrientationKeys ];
+    m_pScalingTicks = new USHORT[ m_Header.NumScalingKeys ];
+    m_pScalings = new SDKANIMATION_QUANTIZED_VECTOR3[ m_Header.NumScalingKeys ];
+
+    if( !m_pTracks || !m_pTranslationTicks || !m_pTranslations || !m_pOrientationTicks || !m_pOrientations ||
+        !m_pScalingTicks || !m_pScalings )
+    {
+        Destroy();
+        return E_OUTOFMEMORY;
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Build compressed tracks from a loaded (pointer fixed-up) SDKANIMATION file
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTCompressedAnimation::Compress( const SDKANIMATION_FILE_HEADER* pHeader,
+                                            const SDKANIMATION_FRAME_DATA* pFrameData,
+                                            const SDKANIMATION_COMPRESSION_SETTINGS* pSettings,
+                                            SDKANIMATION_COMPRESSION_REPORT* pReport )
+{
+    HRESULT hr;
+
+    Destroy();
+
+    if( !pHeader || !pFrameData || !pSettings )
+        return E_INVALIDARG;
+
+    // Ticks are stored in 16 bits
+    UINT NumKeys = pHeader->NumAnimationKeys;
+    if( NumKeys == 0 || NumKeys > 65536 )
+        return E_INVALIDARG;
+
+    UINT NumTracks = pHeader->NumFrames;
+    CGrowableArray<USHORT>* pKept = new CGrowableArray<USHORT>[ NumTracks * 3 ];
+    if( !pKept )
+        return E_OUTOFMEMORY;
+
+    // Reduce every channel independently
+    UINT NumTranslationKeys = 0, NumOrientationKeys = 0, NumScalingKeys = 0;
+    for( UINT t = 0; t < NumTracks; t++ )
+    {
+        const SDKANIMATION_DATA* pData = pFrameData[t].pAnimationData;
+
+        ReduceKeys( NumKeys, [&]( UINT iStart, UINT iEnd, UINT iKey ) -> bool
+        {
+            float fLerp = ( float )( iKey - iStart ) / ( float )( iEnd - iStart );
+            XMVECTOR v = XMVectorLerp( XMLoadFloat3( ( const XMFLOAT3* )&pData[iStart].Translation ),
+                                       XMLoadFloat3( ( const XMFLOAT3* )&pData[iEnd].Translation ), fLerp );
+            v -= XMLoadFloat3( ( const XMFLOAT3* )&pData[iKey].Translation );
+            return XMVectorGetX( XMVector3Length( v ) ) <= pSettings->MaxTranslationError;
+        }, pKept[t * 3 + 0] );
+
+        ReduceKeys( NumKeys, [&]( UINT iStart, UINT iEnd, UINT iKey ) -> bool
+        {
+            float fLerp = ( float )( iKey - iStart ) / ( float )( iEnd - iStart );
+            XMVECTOR q = XMQuaternionSlerp( LoadRawOrientation( &pData[iStart] ), LoadRawOrientation( &pData[iEnd] ),
+                                            fLerp );
+            return QuaternionAngle( q, LoadRawOrientation( &pData[iKey] ) ) <= pSettings->MaxOrientationError;
+        }, pKept[t * 3 + 1] );
+
+        ReduceKeys( NumKeys, [&]( UINT iStart, UINT iEnd, UINT iKey ) -> bool
+        {
+            float fLerp = ( float )( iKey - iStart ) / ( float )( iEnd - iStart );
+            XMVECTOR v = XMVectorLerp( XMLoadFloat3( ( const XMFLOAT3* )&pData[iStart].Scaling ),
+                                       XMLoadFloat3( ( const XMFLOAT3* )&pData[iEnd].Scaling ), fLerp );
+            v -= XMLoadFloat3( ( const XMFLOAT3* )&pData[iKey].Scaling );
+            return XMVectorGetX( XMVector3Length( v ) ) <= pSettings->MaxScalingError;
+        }, pKept[t * 3 + 2] );
+
+        NumTranslationKeys += pKept[t * 3 + 0].GetSize();
+        NumOrientationKeys += pKept[t * 3 + 1].GetSize();
+        NumScalingKeys += pKept[t * 3 + 2].GetSize();
+    }
+
+    m_Header.Version = SDKANIMATION_COMPRESSED_FILE_VERSION;
+    m_Header.NumTracks = NumTracks;
+    m_Header.NumAnimationKeys = NumKeys;
+    m_Header.AnimationFPS = pHeader->AnimationFPS;
+    m_Header.NumTranslationKeys = NumTranslationKeys;
+    m_Header.NumOrientationKeys = NumOrientationKeys;
+    m_Header.NumScalingKeys = NumScalingKeys;
+
+    hr = Allocate();
+    if( FAILED( hr ) )
+    {
+        delete[] pKept;
+        return hr;
+    }
+
+    // Quantize the kept keys
+    UINT iTranslation = 0, iOrientation = 0, iScaling = 0;
+    for( UINT t = 0; t < NumTracks; t++ )
+    {
+        const SDKANIMATION_DATA* pData = pFrameData[t].pAnimationData;
+        SDKANIMATION_COMPRESSED_TRACK& Track = m_pTracks[t];
+        ZeroMemory( &Track, sizeof( Track ) );
+        strcpy_s( Track.FrameName, MAX_FRAME_NAME, pFrameData[t].FrameName );
+
+        // Vector channels are quantized relative to the bounds of their kept keys
+        auto QuantizeChannel = [&]( CGrowableArray<USHORT>& Kept, size_t Offset, UINT& iNext,
+                                    SDKANIMATION_COMPRESSED_CHANNEL& Channel, USHORT* pTicks,
+                                    SDKANIMATION_QUANTIZED_VECTOR3* pValues )
+        {
+            XMVECTOR vMin = g_XMFltMax;
+            XMVECTOR vMax = XMVectorNegate( g_XMFltMax );
+            for( int k = 0; k < Kept.GetSize(); k++ )
+            {
+                XMVECTOR v = XMLoadFloat3( ( const XMFLOAT3* )( ( const BYTE* )&pData[ Kept[k] ] + Offset ) );
+                vMin = XMVectorMin( vMin, v );
+                vMax = XMVectorMax( vMax, v );
+            }
+            XMStoreFloat3( ( XMFLOAT3* )&Channel.Min, vMin );
+            XMStoreFloat3( ( XMFLOAT3* )&Channel.Range, vMax - vMin );
+
+            Channel.FirstKey = iNext;
+            Channel.NumKeys = Kept.GetSize();
+            for( int k = 0; k < Kept.GetSize(); k++, iNext++ )
+            {
+                XMVECTOR v = XMLoadFloat3( ( const XMFLOAT3* )( ( const BYTE* )&pData[ Kept[k] ] + Offset ) );
+                pTicks[iNext] = Kept[k];
+                pValues[iNext] = QuantizeVector( v, Channel.Min, Channel.Range );
+            }
+        };
+
+        QuantizeChannel( pKept[t * 3 + 0], offsetof( SDKANIMATION_DATA, Translation ), iTranslation,
+                         Track.Translation, m_pTranslationTicks, m_pTranslations );
+        QuantizeChannel( pKept[t * 3 + 2], offsetof( SDKANIMATION_DATA, Scaling ), iScaling,
+                         Track.Scaling, m_pScalingTicks, m_pScalings );
+
+        CGrowableArray<USHORT>& KeptOrientations = pKept[t * 3 + 1];
+        Track.Orientation.FirstKey = iOrientation;
+        Track.Orientation.NumKeys = KeptOrientations.GetSize();
+        for( int k = 0; k < KeptOrientations.GetSize(); k++, iOrientation++ )
+        {
+            m_pOrientationTicks[iOrientation] = KeptOrientations[k];
+            m_pOrientations[iOrientation] = QuantizeQuaternion( LoadRawOrientation( &pData[ KeptOrientations[k] ] ) );
+        }
+    }
+
+    delete[] pKept;
+
+    // Measure the result against the raw tracks at every tick
+    if( pReport )
+    {
+        ZeroMemory( pReport, sizeof( SDKANIMATION_COMPRESSION_REPORT ) );
+        pReport->NumTracks = NumTracks;
+        pReport->NumRawKeys = NumTracks * NumKeys * 3;
+        pReport->NumKeptKeys = NumTranslationKeys + NumOrientationKeys + NumScalingKeys;
+        pReport->RawBytes = ( UINT64 )NumTracks * NumKeys * sizeof( SDKANIMATION_DATA );
+        pReport->CompressedBytes = ( UINT64 )NumTracks * sizeof( SDKANIMATION_COMPRESSED_TRACK ) +
+                                   ( UINT64 )NumTranslationKeys * ( sizeof( USHORT ) + sizeof( SDKANIMATION_QUANTIZED_VECTOR3 ) ) +
+                                   ( UINT64 )NumOrientationKeys * ( sizeof( USHORT ) + sizeof( SDKANIMATION_QUANTIZED_QUATERNION ) ) +
+                                   ( UINT64 )NumScalingKeys * ( sizeof( USHORT ) + sizeof( SDKANIMATION_QUANTIZED_VECTOR3 ) );
+
+        double fSumTranslation = 0.0, fSumOrientation = 0.0, fSumScaling = 0.0;
+        for( UINT t = 0; t < NumTracks; t++ )
+        {
+            const SDKANIMATION_DATA* pData = pFrameData[t].pAnimationData;
+            for( UINT k = 0; k < NumKeys; k++ )
+            {
+                XMVECTOR vTranslation, vOrientation, vScaling;
+                GetPose( t, k, &vTranslation, &vOrientation, &vScaling );
+
+                float fTranslationError = XMVectorGetX( XMVector3Length(
+                    vTranslation - XMLoadFloat3( ( const XMFLOAT3* )&pData[k].Translation ) ) );
+                float fOrientationError = QuaternionAngle( vOrientation, LoadRawOrientation( &pData[k] ) );
+                float fScalingError = XMVectorGetX( XMVector3Length(
+                    vScaling - XMLoadFloat3( ( const XMFLOAT3* )&pData[k].Scaling ) ) );
+
+                pReport->MaxTranslationError = max( pReport->MaxTranslationError, fTranslationError );
+                pReport->MaxOrientationError = max( pReport->MaxOrientationError, fOrientationError );
+                pReport->MaxScalingError = max( pReport->MaxScalingError, fScalingError );
+                fSumTranslation += fTranslationError * fTranslationError;
+                fSumOrientation += fOrientationError * fOrientationError;
+                fSumScaling += fScalingError * fScalingError;
+            }
+        }
+
+        double fNumSamples = max( 1.0, ( double )NumTracks * NumKeys );
+        pReport->RmsTranslationError = ( FLOAT )sqrt( fSumTranslation / fNumSamples );
+        pReport->RmsOrientationError = ( FLOAT )sqrt( fSumOrientation / fNumSamples );
+        pReport->RmsScalingError = ( FLOAT )sqrt( fSumScaling / fNumSamples );
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTCompressedAnimation::SaveToFile( LPCWSTR szFileName )
+{
+    if( !m_pTracks )
+        return E_FAIL;
+
+    HANDLE hFile = CreateFile( szFileName, FILE_WRITE_DATA, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return DXUT_ERR( L"CreateFile", HRESULT_FROM_WIN32( GetLastError() ) );
+
+    struct { const void* pData; DWORD Size; } Chunks[] =
+    {
+        { &m_Header,           sizeof( m_Header ) },
+        { m_pTracks,           m_Header.NumTracks * sizeof( SDKANIMATION_COMPRESSED_TRACK ) },
+        { m_pTranslationTicks, m_Header.NumTranslationKeys * sizeof( USHORT ) },
+        { m_pTranslations,     m_Header.NumTranslationKeys * sizeof( SDKANIMATION_QUANTIZED_VECTOR3 ) },
+        { m_pOrientationTicks, m_Header.NumOrientationKeys * sizeof( USHORT ) },
+        { m_pOrientations,     m_Header.NumOrientationKeys * sizeof( SDKANIMATION_QUANTIZED_QUATERNION ) },
+        { m_pScalingTicks,     m_Header.NumScalingKeys * sizeof( USHORT ) },
+        { m_pScalings,         m_Header.NumScalingKeys * sizeof( SDKANIMATION_QUANTIZED_VECTOR3 ) },
+    };
+
+    HRESULT hr = S_OK;
+    for( UINT i = 0; i < ARRAYSIZE( Chunks ) && SUCCEEDED( hr ); i++ )
+    {
+        DWORD dwBytesWritten = 0;
+        if( !WriteFile( hFile, Chunks[i].pData, Chunks[i].Size, &dwBytesWritten, NULL ) ||
+            dwBytesWritten != Chunks[i].Size )
+            hr = E_FAIL;
+    }
+
+    CloseHandle( hFile );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTCompressedAnimation::LoadFromFile( LPCWSTR szFileName )
+{
+    HRESULT hr;
+    WCHAR strPath[MAX_PATH];
+
+    Destroy();
+
+    // Find the path for the file
+    V_RETURN( DXUTFindDXSDKMediaFileCch( strPath, MAX_PATH, szFileName ) );
+
+    HANDLE hFile = CreateFile( strPath, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                               FILE_FLAG_SEQUENTIAL_SCAN, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return DXUTERR_MEDIANOTFOUND;
+
+    DWORD dwBytesRead = 0;
+    if( !ReadFile( hFile, &m_Header, sizeof( m_Header ), &dwBytesRead, NULL ) || dwBytesRead != sizeof( m_Header ) ||
+        m_Header.Version != SDKANIMATION_COMPRESSED_FILE_VERSION )
+    {
+        ZeroMemory( &m_Header, sizeof( m_Header ) );
+        CloseHandle( hFile );
+        return E_FAIL;
+    }
+
+    hr = Allocate();
+    if( FAILED( hr ) )
+    {
+        CloseHandle( hFile );
+        return hr;
+    }
+
+    struct { void* pData; DWORD Size; } Chunks[] =
+    {
+        { m_pTracks,           m_Header.NumTracks * sizeof( SDKANIMATION_COMPRESSED_TRACK ) },
+        { m_pTranslationTicks, m_Header.NumTranslationKeys * sizeof( USHORT ) },
+        { m_pTranslations,     m_Header.NumTranslationKeys * sizeof( SDKANIMATION_QUANTIZED_VECTOR3 ) },
+        { m_pOrientationTicks, m_Header.NumOrientationKeys * sizeof( USHORT ) },
+        { m_pOrientations,     m_Header.NumOrientationKeys * sizeof( SDKANIMATION_QUANTIZED_QUATERNION ) },
+        { m_pScalingTicks,     m_Header.NumScalingKeys * sizeof( USHORT ) },
+        { m_pScalings,         m_Header.NumScalingKeys * sizeof( SDKANIMATION_QUANTIZED_VECTOR3 ) },
+    };
+
+    for( UINT i = 0; i < ARRAYSIZE( Chunks ) && SUCCEEDED( hr ); i++ )
+    {
+        if( !ReadFile( hFile, Chunks[i].pData, Chunks[i].Size, &dwBytesRead, NULL ) || dwBytesRead != Chunks[i].Size )
+            hr = E_FAIL;
+    }
+
+    CloseHandle( hFile );
+
+    if( FAILED( hr ) )
+        Destroy();
+
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+UINT CDXUTCompressedAnimation::FindTrack( const char* pszName ) const
+{
+    for( UINT i = 0; i < m_Header.NumTracks; i++ )
+    {
+        if( _stricmp( m_pTracks[i].FrameName, pszName ) == 0 )
+            return i;
+    }
+    return INVALID_ANIMATION_DATA;
+}
+
+//--------------------------------------------------------------------------------------
+// Index of the last key of the channel at or before iTick
+//--------------------------------------------------------------------------------------
+UINT CDXUTCompressedAnimation::FindKey( const SDKANIMATION_COMPRESSED_CHANNEL& Channel, const USHORT* pTicks,
+                                        UINT iTick ) const
+{
+    UINT iLow = Channel.FirstKey;
+    UINT iHigh = Channel.FirstKey + Channel.NumKeys - 1;
+    while( iLow < iHigh )
+    {
+        UINT iMid = ( iLow + iHigh + 1 ) / 2;
+        if( pTicks[iMid] <= iTick )
+            iLow = iMid;
+        else
+            iHigh = iMid - 1;
+    }
+    return iLow;
+}
+
+//--------------------------------------------------------------------------------------
+XMVECTOR CDXUTCompressedAnimation::SampleVector( const SDKANIMATION_COMPRESSED_CHANNEL& Channel, const USHORT* pTicks,
+                                                 const SDKANIMATION_QUANTIZED_VECTOR3* pValues, UINT iTick ) const
+{
+    UINT iKey = FindKey( Channel, pTicks, iTick );
+    XMVECTOR v0 = DequantizeVector( pValues[iKey], Channel.Min, Channel.Range );
+    if( iKey + 1 >= Channel.FirstKey + Channel.NumKeys || pTicks[iKey] >= iTick )
+        return v0;
+
+    XMVECTOR v1 = DequantizeVector( pValues[iKey + 1], Channel.Min, Channel.Range );
+    float fLerp = ( float )( iTick - pTicks[iKey] ) / ( float )( pTicks[iKey + 1] - pTicks[iKey] );
+    return XMVectorLerp( v0, v1, fLerp );
+}
+
+//--------------------------------------------------------------------------------------
+XMVECTOR CDXUTCompressedAnimation::SampleQuaternion( const SDKANIMATION_COMPRESSED_CHANNEL& Channel, UINT iTick ) const
+{
+    UINT iKey = FindKey( Channel, m_pOrientationTicks, iTick );
+    XMVECTOR q0 = DequantizeQuaternion( m_pOrientations[iKey] );
+    if( iKey + 1 >= Channel.FirstKey + Channel.NumKeys || m_pOrientationTicks[iKey] >= iTick )
+        return q0;
+
+    XMVECTOR q1 = DequantizeQuaternion( m_pOrientations[iKey + 1] );
+    float fLerp = ( float )( iTick - m_pOrientationTicks[iKey] ) /
+                  ( float )( m_pOrientationTicks[iKey + 1] - m_pOrientationTicks[iKey] );
+    return XMQuaternionSlerp( q0, q1, fLerp );
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTCompressedAnimation::GetPose( UINT iTrack, UINT iTick, XMVECTOR* pTranslation, XMVECTOR* pOrientation,
+                                        XMVECTOR* pScaling ) const
+{
+    const SDKANIMATION_COMPRESSED_TRACK& Track = m_pTracks[iTrack];
+
+    if( pTranslation )
+    {
+        *pTranslation = Track.Translation.NumKeys ?
+                        SampleVector( Track.Translation, m_pTranslationTicks, m_pTranslations, iTick ) :
+                        XMVectorZero();
+    }
+    if( pOrientation )
+    {
+        *pOrientation = Track.Orientation.NumKeys ? SampleQuaternion( Track.Orientation, iTick ) :
+                                                    XMQuaternionIdentity();
+    }
+    if( pScaling )
+    {
+        *pScaling = Track.Scaling.NumKeys ? SampleVector( Track.Scaling, m_pScalingTicks, m_pScalings, iTick ) :
+                                            XMVectorSplatOne();
+    }
+}
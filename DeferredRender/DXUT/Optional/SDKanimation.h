@@ -0,0 +1,150 @@
+//--------------------------------------------------------------------------------------
+// File: SDKAnimation.h
+//
+// Compressed animation tracks for SDKANIMATION data.  Each frame track is split into
+// translation, orientation and scaling channels; every channel keeps only the keys
+// needed to reproduce the raw data within a given tolerance (linear interpolation
+// between kept keys) and stores them quantized:
+//   - translation / scaling: 16 bits per component, relative to the channel bounds
+//   - orientation: "smallest three" quaternion, 3 x 15 bits plus a 2 bit index
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SDKANIMATION_
+#define _SDKANIMATION_
+
+#include <DirectXMath.h>
+
+#define SDKANIMATION_COMPRESSED_FILE_VERSION 1
+
+//--------------------------------------------------------------------------------------
+// Structures
+//--------------------------------------------------------------------------------------
+struct SDKANIMATION_COMPRESSION_SETTINGS
+{
+    FLOAT MaxTranslationError;      // Object-space units
+    FLOAT MaxOrientationError;      // Radians
+    FLOAT MaxScalingError;          // Absolute scale
+};
+
+struct SDKANIMATION_COMPRESSION_REPORT
+{
+    UINT   NumTracks;
+    UINT   NumRawKeys;              // Keys per channel before reduction, summed over all channels
+    UINT   NumKeptKeys;             // Keys per channel after reduction, summed over all channels
+    UINT64 RawBytes;                // Size of the SDKANIMATION_DATA arrays
+    UINT64 CompressedBytes;         // Size of the compressed channel, key and value arrays
+
+    // Measured against the raw tracks at every tick
+    FLOAT  MaxTranslationError;
+    FLOAT  RmsTranslationError;
+    FLOAT  MaxOrientationError;     // Radians
+    FLOAT  RmsOrientationError;     // Radians
+    FLOAT  MaxScalingError;
+    FLOAT  RmsScalingError;
+};
+
+struct SDKANIMATION_COMPRESSED_CHANNEL
+{
+    UINT FirstKey;                  // Index of the first key in the key/value arrays of this channel type
+    UINT NumKeys;
+    D3DXVECTOR3 Min;                // Dequantization bounds (unused for orientation)
+    D3DXVECTOR3 Range;
+};
+
+struct SDKANIMATION_COMPRESSED_TRACK
+{
+    char FrameName[MAX_FRAME_NAME];
+    SDKANIMATION_COMPRESSED_CHANNEL Translation;
+    SDKANIMATION_COMPRESSED_CHANNEL Orientation;
+    SDKANIMATION_COMPRESSED_CHANNEL Scaling;
+};
+
+struct SDKANIMATION_QUANTIZED_VECTOR3
+{
+    USHORT v[3];
+};
+
+struct SDKANIMATION_QUANTIZED_QUATERNION
+{
+    USHORT v[3];                    // 15 bits each; the top bits of v[0] and v[1] hold the dropped component index
+};
+
+struct SDKANIMATION_COMPRESSED_FILE_HEADER
+{
+    UINT Version;
+    UINT NumTracks;
+    UINT NumAnimationKeys;
+    UINT AnimationFPS;
+    UINT NumTranslationKeys;
+    UINT NumOrientationKeys;
+    UINT NumScalingKeys;
+};
+
+//--------------------------------------------------------------------------------------
+// CDXUTCompressedAnimation class.  Built offline from an SDKANIMATION file, sampled at
+// runtime in place of the raw SDKANIMATION_DATA arrays
+//--------------------------------------------------------------------------------------
+class CDXUTCompressedAnimation
+{
+public:
+                                    CDXUTCompressedAnimation();
+                                    ~CDXUTCompressedAnimation();
+
+    HRESULT                         Compress( const SDKANIMATION_FILE_HEADER* pHeader,
+                                              const SDKANIMATION_FRAME_DATA* pFrameData,
+                                              const SDKANIMATION_COMPRESSION_SETTINGS* pSettings,
+                                              SDKANIMATION_COMPRESSION_REPORT* pReport = NULL );
+    HRESULT                         SaveToFile( LPCWSTR szFileName );
+    HRESULT                         LoadFromFile( LPCWSTR szFileName );
+    void                            Destroy();
+
+    // Pose of a track at an integer tick; orientation is a normalized quaternion.  Any
+    // output may be NULL
+    void                            GetPose( UINT iTrack, UINT iTick, DirectX::XMVECTOR* pTranslation,
+                                             DirectX::XMVECTOR* pOrientation, DirectX::XMVECTOR* pScaling ) const;
+
+    UINT                            GetNumTracks() const { return m_Header.NumTracks; }
+    UINT                            GetNumAnimationKeys() const { return m_Header.NumAnimationKeys; }
+    UINT                            GetAnimationFPS() const { return m_Header.AnimationFPS; }
+    const char*                     GetTrackName( UINT iTrack ) const { return m_pTracks[iTrack].FrameName; }
+    UINT                            FindTrack( const char* pszName ) const;
+
+protected:
+    HRESULT                         Allocate();
+    UINT                            FindKey( const SDKANIMATION_COMPRESSED_CHANNEL& Channel, const USHORT* pTicks,
+                                             UINT iTick ) const;
+    DirectX::XMVECTOR               SampleVector( const SDKANIMATION_COMPRESSED_CHANNEL& Channel,
+                                                  const USHORT* pTicks, const SDKANIMATION_QUANTIZED_VECTOR3* pValues,
+                                                  UINT iTick ) const;
+    DirectX::XMVECTOR               SampleQuaternion( const SDKANIMATION_COMPRESSED_CHANNEL& Channel, UINT iTick ) const;
+
+    SDKANIMATION_COMPRESSED_FILE_HEADER m_Header;
+    SDKANIMATION_COMPRESSED_TRACK* m_pTracks;
+
+    USHORT* m_pTranslationTicks;
+    SDKANIMATION_QUANTIZED_VECTOR3* m_pTranslations;
+    USHORT* m_pOrientationTicks;
+    SDKANIMATION_QUANTIZED_QUATERNION* m_pOrientations;
+    USHORT* m_pScalingTicks;
+    SDKANIMATION_QUANTIZED_VECTOR3* m_pScalings;
+};
+
+//--------------------------------------------------------------------------------------
+// Benchmarks
+//--------------------------------------------------------------------------------------
+struct SDKMESH_COMPRESSION_BENCHMARK
+{
+    UINT   NumFrames;
+    UINT   NumKeys;
+    SDKANIMATION_COMPRESSION_REPORT Report;
+    double fCompressSeconds;
+    FLOAT  fMaxPositionError;           // World space frame positions, compressed against raw
+};
+
+// Compresses the animation of the synthetic NumFrames frame skeleton of DXUTBenchmarkSDKMeshTransform,
+// NumKeys keys long, then releases the raw data and animates the mesh from the compressed tracks
+HRESULT DXUTBenchmarkSDKMeshAnimationCompression( UINT NumFrames, UINT NumKeys,
+                                                  const SDKANIMATION_COMPRESSION_SETTINGS* pSettings,
+                                                  SDKMESH_COMPRESSION_BENCHMARK* pResult );
+
+#endif
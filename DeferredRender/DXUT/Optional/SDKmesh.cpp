@@ -11,6 +11,33 @@
 #include "DXUT.h"
 #include "SDKMesh.h"
 #include "SDKMisc.h"
+#include "SDKAnimation.h"
+#include <DirectXMath.h>
+#include <ppl.h>
+#include <psapi.h>
+
+#pragma comment( lib, "psapi.lib" )
+
+using namespace DirectX;
+
+// Frame levels (and the local-transform pass) narrower than this are evaluated serially
+#define FRAME_PARALLEL_THRESHOLD 256
+
+//--------------------------------------------------------------------------------------
+// Runs func(i) for i in [Begin, End), splitting across worker threads for wide ranges
+//--------------------------------------------------------------------------------------
+template<typename FUNC> static void ForEachFrameInRange( UINT Begin, UINT End, const FUNC& func )
+{
+    if( End - Begin >= FRAME_PARALLEL_THRESHOLD )
+    {
+        concurrency::parallel_for( Begin, End, func );
+    }
+    else
+    {
+        for( UINT i = Begin; i < End; i++ )
+            func( i );
+    }
+}
 
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::LoadMaterials( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pMaterials, UINT numMaterials,
@@ -377,6 +404,94 @@ HRESULT CDXUTSDKMesh::CreateFromFile( ID3D11Device* pDev11,
     return hr;
 }
 
+//--------------------------------------------------------------------------------------
+// Maps the file as a private copy-on-write view instead of reading it into the heap.
+// Pointer fixup in CreateFromMemory only dirties the pages holding the headers; the
+// vertex and index pages stay shared with the file cache and are passed directly as
+// initial data to buffer creation.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateFromMappedFile( ID3D11Device* pDev11,
+                                            IDirect3DDevice9* pDev9,
+                                            LPCTSTR szFileName,
+                                            bool bCreateAdjacencyIndices,
+                                            SDKMESH_CALLBACKS11* pLoaderCallbacks11,
+                                            SDKMESH_CALLBACKS9* pLoaderCallbacks9 )
+{
+    HRESULT hr = S_OK;
+
+    // Find the path for the file
+    V_RETURN( DXUTFindDXSDKMediaFileCch( m_strPathW, sizeof( m_strPathW ) / sizeof( WCHAR ), szFileName ) );
+
+    // Open the file
+    m_hFile = CreateFile( m_strPathW, FILE_READ_DATA, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_RANDOM_ACCESS,
+                          NULL );
+    if( INVALID_HANDLE_VALUE == m_hFile )
+        return DXUTERR_MEDIANOTFOUND;
+
+    // Change the path to just the directory
+    WCHAR* pLastBSlash = wcsrchr( m_strPathW, L'\\' );
+    if( pLastBSlash )
+        *( pLastBSlash + 1 ) = L'\0';
+    else
+        *m_strPathW = L'\0';
+
+    WideCharToMultiByte( CP_ACP, 0, m_strPathW, -1, m_strPath, MAX_PATH, NULL, FALSE );
+
+    // Get the file size
+    LARGE_INTEGER FileSize;
+    GetFileSizeEx( m_hFile, &FileSize );
+    UINT cBytes = FileSize.LowPart;
+    if( FileSize.HighPart != 0 || cBytes < sizeof( SDKMESH_HEADER ) )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = 0;
+        return E_FAIL;
+    }
+
+    // Create a copy-on-write mapping of the whole file
+    m_hFileMappingObject = CreateFileMapping( m_hFile, NULL, PAGE_WRITECOPY, 0, 0, NULL );
+    if( !m_hFileMappingObject )
+    {
+        CloseHandle( m_hFile );
+        m_hFile = 0;
+        return DXUT_ERR( L"CreateFileMapping", HRESULT_FROM_WIN32( GetLastError() ) );
+    }
+
+    BYTE* pView = ( BYTE* )MapViewOfFile( m_hFileMappingObject, FILE_MAP_COPY, 0, 0, 0 );
+
+    // The view keeps the mapping and the file alive on its own
+    CloseHandle( m_hFileMappingObject );
+    CloseHandle( m_hFile );
+    m_hFileMappingObject = 0;
+    m_hFile = 0;
+
+    if( !pView )
+        return DXUT_ERR( L"MapViewOfFile", HRESULT_FROM_WIN32( GetLastError() ) );
+
+    m_MappedPointers.Add( pView );
+
+    hr = CreateFromMemory( pDev11,
+                           pDev9,
+                           pView,
+                           cBytes,
+                           bCreateAdjacencyIndices,
+                           false,
+                           pLoaderCallbacks11,
+                           pLoaderCallbacks9 );
+
+    // The view is owned through m_MappedPointers, never through the heap pointer
+    m_pHeapData = NULL;
+
+    if( FAILED( hr ) )
+    {
+        m_MappedPointers.RemoveAll();
+        UnmapViewOfFile( pView );
+        m_pStaticMeshData = NULL;
+    }
+
+    return hr;
+}
+
 HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
                                         IDirect3DDevice9* pDev9,
                                         BYTE* pData,
@@ -495,6 +610,10 @@ HRESULT CDXUTSDKMesh::CreateFromMemory( ID3D11Device* pDev11,
     if( !m_pWorldPoseFrameMatrices )
         goto Error;
 
+    // Flatten the frame hierarchy for the iterative transform passes
+    if( FAILED( BuildFrameOrder() ) )
+        goto Error;
+
     SDKMESH_SUBSET* pSubset = NULL;
     D3D11_PRIMITIVE_TOPOLOGY PrimType;
 
@@ -598,76 +717,143 @@ Error:
 }
 
 //--------------------------------------------------------------------------------------
-// transform bind pose frame using a recursive traversal
+// Flatten the frame hierarchy into a breadth-first order so that transforms can be
+// evaluated without recursion, one level at a time
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformBindPoseFrame( UINT iFrame, D3DXMATRIX* pParentWorld )
+HRESULT CDXUTSDKMesh::BuildFrameOrder()
 {
-    if( !m_pBindPoseFrameMatrices )
-        return;
+    UINT NumFrames = m_pMeshHeader->NumFrames;
 
-    // Transform ourselves
-    D3DXMATRIX LocalWorld;
-    D3DXMatrixMultiply( &LocalWorld, &m_pFrameArray[iFrame].Matrix, pParentWorld );
-    m_pBindPoseFrameMatrices[iFrame] = LocalWorld;
+    m_NumOrderedFrames = 0;
+    m_NumFrameLevels = 0;
+    if( NumFrames == 0 )
+        return S_OK;
 
-    // Transform our siblings
-    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
-        TransformBindPoseFrame( m_pFrameArray[iFrame].SiblingFrame, pParentWorld );
+    m_pFrameOrder = new UINT[ NumFrames ];
+    m_pFrameOrderParent = new UINT[ NumFrames ];
+    m_pFrameLevelStart = new UINT[ NumFrames + 1 ];
+    bool* pVisited = new bool[ NumFrames ];
+    if( !m_pFrameOrder || !m_pFrameOrderParent || !m_pFrameLevelStart || !pVisited )
+    {
+        SAFE_DELETE_ARRAY( pVisited );
+        return E_OUTOFMEMORY;
+    }
+    ZeroMemory( pVisited, NumFrames * sizeof( bool ) );
 
-    // Transform our children
-    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
-        TransformBindPoseFrame( m_pFrameArray[iFrame].ChildFrame, &LocalWorld );
+    // Append a frame and its whole sibling chain; the visited flags guard against malformed links
+    auto AddSiblingChain = [&]( UINT iFirst, UINT iParent )
+    {
+        for( UINT iFrame = iFirst; iFrame < NumFrames && !pVisited[iFrame]; iFrame = m_pFrameArray[iFrame].SiblingFrame )
+        {
+            pVisited[iFrame] = true;
+            m_pFrameOrder[ m_NumOrderedFrames ] = iFrame;
+            m_pFrameOrderParent[ m_NumOrderedFrames ] = iParent;
+            m_NumOrderedFrames++;
+        }
+    };
+
+    // Level 0 is the root frame and its siblings, they all hang off the mesh world matrix
+    AddSiblingChain( 0, INVALID_FRAME );
+
+    UINT LevelBegin = 0;
+    while( LevelBegin < m_NumOrderedFrames )
+    {
+        UINT LevelEnd = m_NumOrderedFrames;
+        m_pFrameLevelStart[ m_NumFrameLevels++ ] = LevelBegin;
+
+        for( UINT i = LevelBegin; i < LevelEnd; i++ )
+            AddSiblingChain( m_pFrameArray[ m_pFrameOrder[i] ].ChildFrame, m_pFrameOrder[i] );
+
+        LevelBegin = LevelEnd;
+    }
+    m_pFrameLevelStart[ m_NumFrameLevels ] = m_NumOrderedFrames;
+
+    SAFE_DELETE_ARRAY( pVisited );
+    return S_OK;
 }
 
 //--------------------------------------------------------------------------------------
-// transform frame using a recursive traversal
+// Translation and normalized orientation of an animation track at an integer key, read
+// from the compressed tracks when attached and from the raw SDKANIMATION data otherwise
 //--------------------------------------------------------------------------------------
-void CDXUTSDKMesh::TransformFrame( UINT iFrame, D3DXMATRIX* pParentWorld, double fTime )
+void CDXUTSDKMesh::GetFramePose( UINT iAnimationData, UINT iKey, XMVECTOR* pTranslation, XMVECTOR* pOrientation )
 {
-    // Get the tick data
-    D3DXMATRIX LocalTransform;
-    UINT iTick = GetAnimationKeyFromTime( fTime );
-
-    if( INVALID_ANIMATION_DATA != m_pFrameArray[iFrame].AnimationDataIndex )
+    if( m_pCompressedAnimation )
     {
-        SDKANIMATION_FRAME_DATA* pFrameData = &m_pAnimationFrameData[ m_pFrameArray[iFrame].AnimationDataIndex ];
-        SDKANIMATION_DATA* pData = &pFrameData->pAnimationData[ iTick ];
-
-        // turn it into a matrix (Ignore scaling for now)
-        D3DXVECTOR3 parentPos = pData->Translation;
-        D3DXMATRIX mTranslate;
-        D3DXMatrixTranslation( &mTranslate, parentPos.x, parentPos.y, parentPos.z );
-
-        D3DXQUATERNION quat;
-        D3DXMATRIX mQuat;
-        quat.w = pData->Orientation.w;
-        quat.x = pData->Orientation.x;
-        quat.y = pData->Orientation.y;
-        quat.z = pData->Orientation.z;
-        if( quat.w == 0 && quat.x == 0 && quat.y == 0 && quat.z == 0 )
-            D3DXQuaternionIdentity( &quat );
-        D3DXQuaternionNormalize( &quat, &quat );
-        D3DXMatrixRotationQuaternion( &mQuat, &quat );
-        LocalTransform = ( mQuat * mTranslate );
+        m_pCompressedAnimation->GetPose( iAnimationData, iKey, pTranslation, pOrientation, NULL );
+        return;
     }
-    else
+
+    SDKANIMATION_DATA* pData = &m_pAnimationFrameData[ iAnimationData ].pAnimationData[ iKey ];
+
+    XMVECTOR vQuat = XMLoadFloat4( ( const XMFLOAT4* )&pData->Orientation );
+    if( XMVector4Equal( vQuat, XMVectorZero() ) )
+        vQuat = XMQuaternionIdentity();
+    *pOrientation = XMQuaternionNormalize( vQuat );
+    *pTranslation = XMLoadFloat3( ( const XMFLOAT3* )&pData->Translation );
+}
+
+//--------------------------------------------------------------------------------------
+// Compute the parent-relative transform of a frame at time fTime
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetFrameLocalTransform( UINT iFrame, double fTime, D3DXMATRIX* pLocal )
+{
+    if( INVALID_ANIMATION_DATA == m_pFrameArray[iFrame].AnimationDataIndex )
     {
-        LocalTransform = m_pFrameArray[iFrame].Matrix;
+        *pLocal = m_pFrameArray[iFrame].Matrix;
+        return;
     }
 
-    // Transform ourselves
-    D3DXMATRIX LocalWorld;
-    D3DXMatrixMultiply( &LocalWorld, &LocalTransform, pParentWorld );
-    m_pTransformedFrameMatrices[iFrame] = LocalWorld;
-    m_pWorldPoseFrameMatrices[iFrame] = LocalWorld;
+    // Interpolate between the two keys surrounding fTime
+    UINT iKey0, iKey1;
+    FLOAT fLerp;
+    GetAnimationKeysFromTime( fTime, &iKey0, &iKey1, &fLerp );
 
-    // Transform our siblings
-    if( m_pFrameArray[iFrame].SiblingFrame != INVALID_FRAME )
-        TransformFrame( m_pFrameArray[iFrame].SiblingFrame, pParentWorld, fTime );
+    XMVECTOR vTranslation0, vQuat0, vTranslation1, vQuat1;
+    GetFramePose( m_pFrameArray[iFrame].AnimationDataIndex, iKey0, &vTranslation0, &vQuat0 );
+    GetFramePose( m_pFrameArray[iFrame].AnimationDataIndex, iKey1, &vTranslation1, &vQuat1 );
 
-    // Transform our children
-    if( m_pFrameArray[iFrame].ChildFrame != INVALID_FRAME )
-        TransformFrame( m_pFrameArray[iFrame].ChildFrame, &LocalWorld, fTime );
+    // turn it into a matrix (Ignore scaling for now)
+    XMVECTOR vQuat = XMQuaternionSlerp( vQuat0, vQuat1, fLerp );
+    XMVECTOR vTranslation = XMVectorLerp( vTranslation0, vTranslation1, fLerp );
+
+    XMMATRIX mLocal = XMMatrixRotationQuaternion( vQuat );
+    mLocal.r[3] = XMVectorSetW( vTranslation, 1.0f );
+    XMStoreFloat4x4( ( XMFLOAT4X4* )pLocal, mLocal );
+}
+
+//--------------------------------------------------------------------------------------
+// transform all frames of the flattened hierarchy: a data-parallel local pass followed by
+// a level-by-level world pass (every frame of a level only depends on the previous one)
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformFrames( const D3DXMATRIX* pWorld, double fTime, bool bBindPose, D3DXMATRIX* pWorldOut )
+{
+    if( !m_pFrameOrder || !pWorldOut )
+        return;
+
+    // Local transforms are written in place and turned into world transforms below
+    ForEachFrameInRange( 0, m_NumOrderedFrames, [&]( UINT i )
+    {
+        UINT iFrame = m_pFrameOrder[i];
+        if( bBindPose )
+            pWorldOut[iFrame] = m_pFrameArray[iFrame].Matrix;
+        else
+            GetFrameLocalTransform( iFrame, fTime, &pWorldOut[iFrame] );
+    } );
+
+    const XMFLOAT4X4* pMeshWorld = ( const XMFLOAT4X4* )pWorld;
+    for( UINT iLevel = 0; iLevel < m_NumFrameLevels; iLevel++ )
+    {
+        ForEachFrameInRange( m_pFrameLevelStart[iLevel], m_pFrameLevelStart[iLevel + 1], [&]( UINT i )
+        {
+            UINT iFrame = m_pFrameOrder[i];
+            UINT iParent = m_pFrameOrderParent[i];
+            XMMATRIX mParent = XMLoadFloat4x4( INVALID_FRAME == iParent ? pMeshWorld
+                                                                       : ( const XMFLOAT4X4* )&pWorldOut[iParent] );
+            XMMATRIX mLocal = XMLoadFloat4x4( ( const XMFLOAT4X4* )&pWorldOut[iFrame] );
+            XMStoreFloat4x4( ( XMFLOAT4X4* )&pWorldOut[iFrame], XMMatrixMultiply( mLocal, mParent ) );
+        } );
+    }
 }
 
 //--------------------------------------------------------------------------------------
@@ -980,11 +1166,17 @@ CDXUTSDKMesh::CDXUTSDKMesh() : m_NumOutstandingResources( 0 ),
                                m_pAdjacencyIndexBufferArray( NULL ),
                                m_pAnimationData( NULL ),
                                m_pAnimationHeader( NULL ),
+                               m_pCompressedAnimation( NULL ),
                                m_ppVertices( NULL ),
                                m_ppIndices( NULL ),
                                m_pBindPoseFrameMatrices( NULL ),
                                m_pTransformedFrameMatrices( NULL ),
                                m_pWorldPoseFrameMatrices( NULL ),
+                               m_pFrameOrder( NULL ),
+                               m_pFrameOrderParent( NULL ),
+                               m_pFrameLevelStart( NULL ),
+                               m_NumOrderedFrames( 0 ),
+                               m_NumFrameLevels( 0 ),
                                m_pDev9( NULL ),
 							   m_pDev11( NULL )
 {
@@ -1028,6 +1220,20 @@ HRESULT CDXUTSDKMesh::Create( IDirect3DDevice9* pDev9, BYTE* pData, UINT DataByt
                              pLoaderCallbacks );
 }
 
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateMapped( ID3D11Device* pDev11, LPCTSTR szFileName, bool bCreateAdjacencyIndices,
+                                    SDKMESH_CALLBACKS11* pLoaderCallbacks )
+{
+    return CreateFromMappedFile( pDev11, NULL, szFileName, bCreateAdjacencyIndices, pLoaderCallbacks, NULL );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::CreateMapped( IDirect3DDevice9* pDev9, LPCTSTR szFileName, bool bCreateAdjacencyIndices,
+                                    SDKMESH_CALLBACKS9* pLoaderCallbacks )
+{
+    return CreateFromMappedFile( NULL, pDev9, szFileName, bCreateAdjacencyIndices, NULL, pLoaderCallbacks );
+}
+
 //--------------------------------------------------------------------------------------
 HRESULT CDXUTSDKMesh::LoadAnimation( WCHAR* szFileName )
 {
@@ -1139,16 +1345,20 @@ void CDXUTSDKMesh::Destroy()
             }
         }
 
-        for( UINT64 i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+        // Without a device the buffer headers still hold file offsets, not interfaces
+        if( m_pDev9 || m_pDev11 )
         {
-            if( !IsErrorResource( m_pVertexBufferArray[i].pVB9 ) )
-                SAFE_RELEASE( m_pVertexBufferArray[i].pVB9 );
-        }
+            for( UINT64 i = 0; i < m_pMeshHeader->NumVertexBuffers; i++ )
+            {
+                if( !IsErrorResource( m_pVertexBufferArray[i].pVB9 ) )
+                    SAFE_RELEASE( m_pVertexBufferArray[i].pVB9 );
+            }
 
-        for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
-        {
-            if( !IsErrorResource( m_pIndexBufferArray[i].pIB9 ) )
-                SAFE_RELEASE( m_pIndexBufferArray[i].pIB9 );
+            for( UINT64 i = 0; i < m_pMeshHeader->NumIndexBuffers; i++ )
+            {
+                if( !IsErrorResource( m_pIndexBufferArray[i].pIB9 ) )
+                    SAFE_RELEASE( m_pIndexBufferArray[i].pIB9 );
+            }
         }
     }
 
@@ -1162,11 +1372,19 @@ void CDXUTSDKMesh::Destroy()
     SAFE_DELETE_ARRAY( m_pAdjacencyIndexBufferArray );
 
     SAFE_DELETE_ARRAY( m_pHeapData );
+    for( int i = 0; i < m_MappedPointers.GetSize(); i++ )
+        UnmapViewOfFile( m_MappedPointers[i] );
+    m_MappedPointers.RemoveAll();
     m_pStaticMeshData = NULL;
     SAFE_DELETE_ARRAY( m_pAnimationData );
     SAFE_DELETE_ARRAY( m_pBindPoseFrameMatrices );
     SAFE_DELETE_ARRAY( m_pTransformedFrameMatrices );
     SAFE_DELETE_ARRAY( m_pWorldPoseFrameMatrices );
+    SAFE_DELETE_ARRAY( m_pFrameOrder );
+    SAFE_DELETE_ARRAY( m_pFrameOrderParent );
+    SAFE_DELETE_ARRAY( m_pFrameLevelStart );
+    m_NumOrderedFrames = 0;
+    m_NumFrameLevels = 0;
 
     SAFE_DELETE_ARRAY( m_ppVertices );
     SAFE_DELETE_ARRAY( m_ppIndices );
@@ -1181,6 +1399,7 @@ void CDXUTSDKMesh::Destroy()
 
     m_pAnimationHeader = NULL;
     m_pAnimationFrameData = NULL;
+    m_pCompressedAnimation = NULL;
 
 }
 
@@ -1189,7 +1408,7 @@ void CDXUTSDKMesh::Destroy()
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::TransformBindPose( D3DXMATRIX* pWorld )
 {
-    TransformBindPoseFrame( 0, pWorld );
+    TransformFrames( pWorld, 0.0, true, m_pBindPoseFrameMatrices );
 }
 
 //--------------------------------------------------------------------------------------
@@ -1199,18 +1418,7 @@ void CDXUTSDKMesh::TransformMesh( D3DXMATRIX* pWorld, double fTime )
 {
     if( m_pAnimationHeader == NULL || FTT_RELATIVE == m_pAnimationHeader->FrameTransformType )
     {
-        TransformFrame( 0, pWorld, fTime );
-
-        // For each frame, move the transform to the bind pose, then
-        // move it to the final position
-        D3DXMATRIX mInvBindPose;
-        D3DXMATRIX mFinal;
-        for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
-        {
-            D3DXMatrixInverse( &mInvBindPose, NULL, &m_pBindPoseFrameMatrices[i] );
-            mFinal = mInvBindPose * m_pTransformedFrameMatrices[i];
-            m_pTransformedFrameMatrices[i] = mFinal;
-        }
+        TransformMeshInstance( pWorld, fTime, m_pWorldPoseFrameMatrices, m_pTransformedFrameMatrices );
     }
     else if( FTT_ABSOLUTE == m_pAnimationHeader->FrameTransformType )
     {
@@ -1220,6 +1428,30 @@ void CDXUTSDKMesh::TransformMesh( D3DXMATRIX* pWorld, double fTime )
 }
 
 
+//--------------------------------------------------------------------------------------
+// transform the frames of one instance of the mesh (relative frame transforms only) into
+// caller-owned arrays of GetNumFrames() matrices, leaving the mesh's own matrices untouched.
+// pInfluenceOut receives the bind-pose-relative matrices used for skinning and may be NULL.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::TransformMeshInstance( const D3DXMATRIX* pWorld, double fTime,
+                                          D3DXMATRIX* pWorldPoseOut, D3DXMATRIX* pInfluenceOut )
+{
+    TransformFrames( pWorld, fTime, false, pWorldPoseOut );
+
+    if( !pInfluenceOut )
+        return;
+
+    // For each frame, move the transform to the bind pose, then
+    // move it to the final position
+    ForEachFrameInRange( 0, m_NumOrderedFrames, [&]( UINT i )
+    {
+        UINT iFrame = m_pFrameOrder[i];
+        XMMATRIX mInvBindPose = XMMatrixInverse( NULL, XMLoadFloat4x4( ( const XMFLOAT4X4* )&m_pBindPoseFrameMatrices[iFrame] ) );
+        XMMATRIX mFinal = XMMatrixMultiply( mInvBindPose, XMLoadFloat4x4( ( const XMFLOAT4X4* )&pWorldPoseOut[iFrame] ) );
+        XMStoreFloat4x4( ( XMFLOAT4X4* )&pInfluenceOut[iFrame], mFinal );
+    } );
+}
+
 //--------------------------------------------------------------------------------------
 void CDXUTSDKMesh::Render( ID3D11DeviceContext* pd3dDeviceContext,
                            UINT iDiffuseSlot,
@@ -1449,6 +1681,12 @@ BYTE* CDXUTSDKMesh::GetRawVerticesAt( UINT iVB )
     return m_ppVertices[iVB];
 }
 
+//--------------------------------------------------------------------------------------
+const SDKMESH_VERTEX_BUFFER_HEADER* CDXUTSDKMesh::GetVBHeaderAt( UINT iVB )
+{
+    return &m_pVertexBufferArray[ iVB ];
+}
+
 //--------------------------------------------------------------------------------------
 BYTE* CDXUTSDKMesh::GetRawIndicesAt( UINT iIB )
 {
@@ -1640,6 +1878,12 @@ bool CDXUTSDKMesh::IsLoaded()
     return false;
 }
 
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::IsMapped()
+{
+    return m_MappedPointers.GetSize() > 0;
+}
+
 //--------------------------------------------------------------------------------------
 bool CDXUTSDKMesh::IsLoading()
 {
@@ -1697,34 +1941,615 @@ const D3DXMATRIX* CDXUTSDKMesh::GetInfluenceMatrix( UINT iFrameIndex )
 }
 
 //--------------------------------------------------------------------------------------
-UINT CDXUTSDKMesh::GetAnimationKeyFromTime( double fTime )
+// Key count and rate of the active animation (compressed tracks take precedence)
+//--------------------------------------------------------------------------------------
+bool CDXUTSDKMesh::GetAnimationTiming( UINT* pNumKeys, UINT* pFPS )
 {
+    if( m_pCompressedAnimation )
+    {
+        *pNumKeys = m_pCompressedAnimation->GetNumAnimationKeys();
+        *pFPS = m_pCompressedAnimation->GetAnimationFPS();
+        return true;
+    }
+
     if( m_pAnimationHeader == NULL )
+    {
+        return false;
+    }
+
+    *pNumKeys = m_pAnimationHeader->NumAnimationKeys;
+    *pFPS = m_pAnimationHeader->AnimationFPS;
+    return true;
+}
+
+//--------------------------------------------------------------------------------------
+UINT CDXUTSDKMesh::GetAnimationKeyFromTime( double fTime )
+{
+    UINT NumKeys, FPS;
+    if( !GetAnimationTiming( &NumKeys, &FPS ) || NumKeys < 2 )
     {
         return 0;
     }
 
-    UINT iTick = ( UINT )( m_pAnimationHeader->AnimationFPS * fTime );
+    UINT iTick = ( UINT )( FPS * fTime );
 
-    iTick = iTick % ( m_pAnimationHeader->NumAnimationKeys - 1 );
+    iTick = iTick % ( NumKeys - 1 );
     iTick ++;
 
     return iTick;
 }
 
+//--------------------------------------------------------------------------------------
+// Keys on either side of fTime and the blend factor between them.  Key 0 is not part of
+// the loop (see GetAnimationKeyFromTime), so the last key wraps around to key 1.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::GetAnimationKeysFromTime( double fTime, UINT* pKey0, UINT* pKey1, FLOAT* pLerp )
+{
+    UINT NumKeys, FPS;
+    if( !GetAnimationTiming( &NumKeys, &FPS ) || NumKeys < 2 )
+    {
+        *pKey0 = *pKey1 = 0;
+        *pLerp = 0.0f;
+        return;
+    }
+
+    double fTick = FPS * fTime;
+    double fWholeTick = floor( fTick );
+    UINT NumLoopKeys = NumKeys - 1;
+
+    UINT iTick = ( UINT )( ( UINT64 )fWholeTick % NumLoopKeys );
+    *pKey0 = iTick + 1;
+    *pKey1 = ( iTick + 1 ) % NumLoopKeys + 1;
+    *pLerp = ( FLOAT )( fTick - fWholeTick );
+}
+
+//--------------------------------------------------------------------------------------
+// Sample frame animation from compressed tracks instead of the raw SDKANIMATION data.
+// The mesh does not take ownership; pass NULL to go back to the raw data (if loaded).
+// Tracks are bound to frames by name, so the mesh has to be loaded first.
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMesh::SetCompressedAnimation( const CDXUTCompressedAnimation* pAnimation )
+{
+    if( m_pMeshHeader == NULL )
+        return E_FAIL;
+
+    m_pCompressedAnimation = pAnimation;
+
+    for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+        m_pFrameArray[i].AnimationDataIndex = INVALID_ANIMATION_DATA;
+
+    if( m_pCompressedAnimation )
+    {
+        for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+            m_pFrameArray[i].AnimationDataIndex = m_pCompressedAnimation->FindTrack( m_pFrameArray[i].Name );
+    }
+    else if( m_pAnimationHeader )
+    {
+        for( UINT i = 0; i < m_pAnimationHeader->NumFrames; i++ )
+        {
+            SDKMESH_FRAME* pFrame = FindFrame( m_pAnimationFrameData[i].FrameName );
+            if( pFrame )
+            {
+                pFrame->AnimationDataIndex = i;
+            }
+        }
+    }
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Free the raw SDKANIMATION data loaded by LoadAnimation, typically once it has been
+// compressed and the tracks attached with SetCompressedAnimation.  Frames that still
+// sample the raw data fall back to their bind pose.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMesh::ReleaseAnimationData()
+{
+    if( !m_pCompressedAnimation && m_pFrameArray )
+    {
+        for( UINT i = 0; i < m_pMeshHeader->NumFrames; i++ )
+            m_pFrameArray[i].AnimationDataIndex = INVALID_ANIMATION_DATA;
+    }
+
+    SAFE_DELETE_ARRAY( m_pAnimationData );
+    m_pAnimationHeader = NULL;
+    m_pAnimationFrameData = NULL;
+}
+
 bool CDXUTSDKMesh::GetAnimationProperties( UINT* pNumKeys, FLOAT* pFrameTime )
 {
-    if( m_pAnimationHeader == NULL )
+    UINT FPS;
+    if( !GetAnimationTiming( pNumKeys, &FPS ) )
     {
         return false;
     }
 
-    *pNumKeys = m_pAnimationHeader->NumAnimationKeys;
-    *pFrameTime = 1.0f / (FLOAT)m_pAnimationHeader->AnimationFPS;
+    *pFrameTime = 1.0f / (FLOAT)FPS;
 
     return true;
 }
 
+//--------------------------------------------------------------------------------------
+// Writes a single mesh, single subset .sdkmesh: a grid of NumVertices position / normal /
+// texcoord vertices indexed as a 32 bit triangle list.  Buffers are written a row at a time.
+//--------------------------------------------------------------------------------------
+static HRESULT WriteBenchmarkMesh( LPCWSTR szFileName, UINT NumVertices, UINT64* pFileBytes )
+{
+    const UINT Width = 1024;
+    const UINT Height = max( NumVertices / Width, 2u );
+    const UINT Stride = 8 * sizeof( FLOAT );
+    const UINT64 NumIndices = ( UINT64 )( Width - 1 ) * ( Height - 1 ) * 6;
+
+    // Static section: header, buffer headers, mesh, subset, subset index and frame
+    BYTE Static[ sizeof( SDKMESH_HEADER ) + sizeof( SDKMESH_VERTEX_BUFFER_HEADER ) +
+                 sizeof( SDKMESH_INDEX_BUFFER_HEADER ) + sizeof( SDKMESH_MESH ) + sizeof( SDKMESH_SUBSET ) +
+                 sizeof( UINT ) + sizeof( SDKMESH_FRAME ) ];
+    ZeroMemory( Static, sizeof( Static ) );
+
+    SDKMESH_HEADER* pHeader = ( SDKMESH_HEADER* )Static;
+    pHeader->Version = SDKMESH_FILE_VERSION;
+    pHeader->HeaderSize = sizeof( SDKMESH_HEADER );
+    pHeader->NonBufferDataSize = sizeof( Static ) - sizeof( SDKMESH_HEADER );
+    pHeader->BufferDataSize = ( UINT64 )Width * Height * Stride + NumIndices * sizeof( UINT );
+    pHeader->NumVertexBuffers = 1;
+    pHeader->NumIndexBuffers = 1;
+    pHeader->NumMeshes = 1;
+    pHeader->NumTotalSubsets = 1;
+    pHeader->NumFrames = 1;
+    pHeader->NumMaterials = 0;
+    pHeader->VertexStreamHeadersOffset = sizeof( SDKMESH_HEADER );
+    pHeader->IndexStreamHeadersOffset = pHeader->VertexStreamHeadersOffset + sizeof( SDKMESH_VERTEX_BUFFER_HEADER );
+    pHeader->MeshDataOffset = pHeader->IndexStreamHeadersOffset + sizeof( SDKMESH_INDEX_BUFFER_HEADER );
+    pHeader->SubsetDataOffset = pHeader->MeshDataOffset + sizeof( SDKMESH_MESH );
+    UINT64 SubsetIndexOffset = pHeader->SubsetDataOffset + sizeof( SDKMESH_SUBSET );
+    pHeader->FrameDataOffset = SubsetIndexOffset + sizeof( UINT );
+    pHeader->MaterialDataOffset = sizeof( Static );
+
+    UINT64 BufferDataStart = pHeader->HeaderSize + pHeader->NonBufferDataSize;
+
+    SDKMESH_VERTEX_BUFFER_HEADER* pVBHeader = ( SDKMESH_VERTEX_BUFFER_HEADER* )( Static + pHeader->VertexStreamHeadersOffset );
+    pVBHeader->NumVertices = ( UINT64 )Width * Height;
+    pVBHeader->SizeBytes = pVBHeader->NumVertices * Stride;
+    pVBHeader->StrideBytes = Stride;
+    D3DVERTEXELEMENT9 Decl[] =
+    {
+        { 0, 0,  D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION, 0 },
+        { 0, 12, D3DDECLTYPE_FLOAT3, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL,   0 },
+        { 0, 24, D3DDECLTYPE_FLOAT2, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD, 0 },
+        D3DDECL_END()
+    };
+    CopyMemory( pVBHeader->Decl, Decl, sizeof( Decl ) );
+    pVBHeader->DataOffset = BufferDataStart;
+
+    SDKMESH_INDEX_BUFFER_HEADER* pIBHeader = ( SDKMESH_INDEX_BUFFER_HEADER* )( Static + pHeader->IndexStreamHeadersOffset );
+    pIBHeader->NumIndices = NumIndices;
+    pIBHeader->SizeBytes = NumIndices * sizeof( UINT );
+    pIBHeader->IndexType = IT_32BIT;
+    pIBHeader->DataOffset = BufferDataStart + pVBHeader->SizeBytes;
+
+    SDKMESH_MESH* pMesh = ( SDKMESH_MESH* )( Static + pHeader->MeshDataOffset );
+    strcpy_s( pMesh->Name, MAX_MESH_NAME, "grid" );
+    pMesh->NumVertexBuffers = 1;
+    pMesh->NumSubsets = 1;
+    pMesh->SubsetOffset = SubsetIndexOffset;
+    pMesh->FrameInfluenceOffset = pHeader->FrameDataOffset;
+
+    SDKMESH_SUBSET* pSubset = ( SDKMESH_SUBSET* )( Static + pHeader->SubsetDataOffset );
+    strcpy_s( pSubset->Name, MAX_SUBSET_NAME, "grid" );
+    pSubset->PrimitiveType = PT_TRIANGLE_LIST;
+    pSubset->IndexCount = NumIndices;
+    pSubset->VertexCount = pVBHeader->NumVertices;
+
+    SDKMESH_FRAME* pFrame = ( SDKMESH_FRAME* )( Static + pHeader->FrameDataOffset );
+    strcpy_s( pFrame->Name, MAX_FRAME_NAME, "root" );
+    pFrame->ParentFrame = INVALID_FRAME;
+    pFrame->ChildFrame = INVALID_FRAME;
+    pFrame->SiblingFrame = INVALID_FRAME;
+    D3DXMatrixIdentity( &pFrame->Matrix );
+    pFrame->AnimationDataIndex = INVALID_ANIMATION_DATA;
+
+    HANDLE hFile = CreateFile( szFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+        return DXUT_ERR( L"CreateFile", HRESULT_FROM_WIN32( GetLastError() ) );
+
+    // One row of vertices or the indices of one row of quads, whichever is larger
+    BYTE* pRow = new BYTE[ Width * max( Stride, 6 * ( UINT )sizeof( UINT ) ) ];
+    if( !pRow )
+    {
+        CloseHandle( hFile );
+        return E_OUTOFMEMORY;
+    }
+
+    DWORD dwBytesWritten;
+    bool bOk = WriteFile( hFile, Static, sizeof( Static ), &dwBytesWritten, NULL ) != FALSE;
+
+    for( UINT y = 0; bOk && y < Height; y++ )
+    {
+        FLOAT* pVertex = ( FLOAT* )pRow;
+        for( UINT x = 0; x < Width; x++, pVertex += 8 )
+        {
+            pVertex[0] = ( FLOAT )x;
+            pVertex[1] = 0.0f;
+            pVertex[2] = ( FLOAT )y;
+            pVertex[3] = 0.0f;
+            pVertex[4] = 1.0f;
+            pVertex[5] = 0.0f;
+            pVertex[6] = ( FLOAT )x / ( Width - 1 );
+            pVertex[7] = ( FLOAT )y / ( Height - 1 );
+        }
+        bOk = WriteFile( hFile, pRow, Width * Stride, &dwBytesWritten, NULL ) != FALSE;
+    }
+
+    for( UINT y = 0; bOk && y + 1 < Height; y++ )
+    {
+        UINT* pIndex = ( UINT* )pRow;
+        for( UINT x = 0; x + 1 < Width; x++, pIndex += 6 )
+        {
+            UINT i = y * Width + x;
+            pIndex[0] = i;
+            pIndex[1] = i + Width;
+            pIndex[2] = i + 1;
+            pIndex[3] = i + 1;
+            pIndex[4] = i + Width;
+            pIndex[5] = i + Width + 1;
+        }
+        bOk = WriteFile( hFile, pRow, ( Width - 1 ) * 6 * sizeof( UINT ), &dwBytesWritten, NULL ) != FALSE;
+    }
+
+    delete []pRow;
+    CloseHandle( hFile );
+
+    if( !bOk )
+    {
+        DeleteFile( szFileName );
+        return DXUT_ERR( L"WriteFile", E_FAIL );
+    }
+
+    *pFileBytes = BufferDataStart + pHeader->BufferDataSize;
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+static void GetProcessMemory( UINT64* pWorkingSet, UINT64* pPrivate )
+{
+    PROCESS_MEMORY_COUNTERS_EX Counters;
+    ZeroMemory( &Counters, sizeof( Counters ) );
+    GetProcessMemoryInfo( GetCurrentProcess(), ( PROCESS_MEMORY_COUNTERS* )&Counters, sizeof( Counters ) );
+    *pWorkingSet = Counters.WorkingSetSize;
+    *pPrivate = Counters.PrivateUsage;
+}
+
+//--------------------------------------------------------------------------------------
+// Loads without a device return with everything still allocated, so the memory growth
+// measured right after Create is the peak of the load
+//--------------------------------------------------------------------------------------
+HRESULT DXUTBenchmarkSDKMeshLoad( UINT NumVertices, UINT NumLoads, SDKMESH_LOAD_BENCHMARK* pResult )
+{
+    HRESULT hr;
+
+    if( pResult == NULL || NumLoads == 0 || NumVertices == 0 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResult, sizeof( SDKMESH_LOAD_BENCHMARK ) );
+
+    WCHAR strFileName[MAX_PATH];
+    if( !GetTempPath( MAX_PATH, strFileName ) )
+        return DXUT_ERR( L"GetTempPath", HRESULT_FROM_WIN32( GetLastError() ) );
+    if( wcscat_s( strFileName, MAX_PATH, L"DXUTBenchmark.sdkmesh" ) != 0 )
+        return E_FAIL;
+    V_RETURN( WriteBenchmarkMesh( strFileName, NumVertices, &pResult->FileBytes ) );
+
+    LARGE_INTEGER Frequency, Start, End;
+    LONGLONG llHeap = 0, llMapped = 0;
+    QueryPerformanceFrequency( &Frequency );
+
+    hr = S_OK;
+    for( UINT iLoad = 0; SUCCEEDED( hr ) && iLoad < NumLoads * 2; iLoad++ )
+    {
+        // Alternate the two paths so that both see the same file cache state
+        bool bMapped = ( iLoad & 1 ) != 0;
+
+        UINT64 WorkingSetBefore, PrivateBefore, WorkingSet, Private;
+        GetProcessMemory( &WorkingSetBefore, &PrivateBefore );
+
+        CDXUTSDKMesh Mesh;
+        QueryPerformanceCounter( &Start );
+        if( bMapped )
+            hr = Mesh.CreateMapped( ( ID3D11Device* )NULL, strFileName );
+        else
+            hr = Mesh.Create( ( ID3D11Device* )NULL, strFileName );
+        QueryPerformanceCounter( &End );
+
+        GetProcessMemory( &WorkingSet, &Private );
+        UINT64 WorkingSetGrowth = WorkingSet > WorkingSetBefore ? WorkingSet - WorkingSetBefore : 0;
+        UINT64 PrivateGrowth = Private > PrivateBefore ? Private - PrivateBefore : 0;
+
+        if( bMapped )
+        {
+            llMapped += End.QuadPart - Start.QuadPart;
+            pResult->MappedWorkingSetBytes = max( pResult->MappedWorkingSetBytes, WorkingSetGrowth );
+            pResult->MappedPrivateBytes = max( pResult->MappedPrivateBytes, PrivateGrowth );
+        }
+        else
+        {
+            llHeap += End.QuadPart - Start.QuadPart;
+            pResult->HeapWorkingSetBytes = max( pResult->HeapWorkingSetBytes, WorkingSetGrowth );
+            pResult->HeapPrivateBytes = max( pResult->HeapPrivateBytes, PrivateGrowth );
+        }
+
+        Mesh.Destroy();
+    }
+
+    DeleteFile( strFileName );
+    if( FAILED( hr ) )
+        return hr;
+
+    pResult->NumVertices = NumVertices;
+    pResult->NumLoads = NumLoads;
+    pResult->fHeapSeconds = ( double )llHeap / ( double )Frequency.QuadPart / NumLoads;
+    pResult->fMappedSeconds = ( double )llMapped / ( double )Frequency.QuadPart / NumLoads;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// Writes an animation of NumKeys keys for the frames of the transform benchmark mesh:
+// every frame swings about its own axis, a little out of phase with its parent
+//--------------------------------------------------------------------------------------
+static HRESULT WriteBenchmarkAnimation( LPCWSTR szFileName, UINT NumFrames, UINT NumKeys )
+{
+    UINT64 FrameDataBytes = ( UINT64 )NumFrames * sizeof( SDKANIMATION_FRAME_DATA );
+    UINT64 DataBytes = FrameDataBytes + ( UINT64 )NumFrames * NumKeys * sizeof( SDKANIMATION_DATA );
+    BYTE* pFile = new BYTE[ ( size_t )( sizeof( SDKANIMATION_FILE_HEADER ) + DataBytes ) ];
+    if( !pFile )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pFile, ( size_t )( sizeof( SDKANIMATION_FILE_HEADER ) + DataBytes ) );
+
+    SDKANIMATION_FILE_HEADER* pHeader = ( SDKANIMATION_FILE_HEADER* )pFile;
+    pHeader->Version = SDKMESH_FILE_VERSION;
+    pHeader->FrameTransformType = FTT_RELATIVE;
+    pHeader->NumFrames = NumFrames;
+    pHeader->NumAnimationKeys = NumKeys;
+    pHeader->AnimationFPS = 30;
+    pHeader->AnimationDataSize = DataBytes;
+    pHeader->AnimationDataOffset = sizeof( SDKANIMATION_FILE_HEADER );
+
+    // Data offsets are relative to the end of the header
+    SDKANIMATION_FRAME_DATA* pFrameData = ( SDKANIMATION_FRAME_DATA* )( pFile + sizeof( SDKANIMATION_FILE_HEADER ) );
+    SDKANIMATION_DATA* pData = ( SDKANIMATION_DATA* )( pFile + sizeof( SDKANIMATION_FILE_HEADER ) + FrameDataBytes );
+    for( UINT i = 0; i < NumFrames; i++ )
+    {
+        sprintf_s( pFrameData[i].FrameName, MAX_FRAME_NAME, "frame%u", i );
+        pFrameData[i].DataOffset = FrameDataBytes + ( UINT64 )i * NumKeys * sizeof( SDKANIMATION_DATA );
+
+        D3DXVECTOR3 vAxis( ( FLOAT )( i % 3 == 0 ), ( FLOAT )( i % 3 == 1 ), ( FLOAT )( i % 3 == 2 ) );
+        for( UINT k = 0; k < NumKeys; k++ )
+        {
+            SDKANIMATION_DATA* pKey = &pData[ ( UINT64 )i * NumKeys + k ];
+            D3DXQUATERNION qRotation;
+            D3DXQuaternionRotationAxis( &qRotation, &vAxis, 0.5f * sinf( D3DX_PI * 2.0f * k / NumKeys + 0.1f * i ) );
+            pKey->Translation = D3DXVECTOR3( 0.0f, 1.0f, 0.0f );
+            pKey->Orientation = D3DXVECTOR4( qRotation.x, qRotation.y, qRotation.z, qRotation.w );
+            pKey->Scaling = D3DXVECTOR3( 1.0f, 1.0f, 1.0f );
+        }
+    }
+
+    HRESULT hr = S_OK;
+    HANDLE hFile = CreateFile( szFileName, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY, NULL );
+    if( INVALID_HANDLE_VALUE == hFile )
+    {
+        hr = DXUT_ERR( L"CreateFile", HRESULT_FROM_WIN32( GetLastError() ) );
+    }
+    else
+    {
+        DWORD dwBytesWritten;
+        if( !WriteFile( hFile, pFile, ( DWORD )( sizeof( SDKANIMATION_FILE_HEADER ) + DataBytes ), &dwBytesWritten, NULL ) )
+            hr = DXUT_ERR( L"WriteFile", HRESULT_FROM_WIN32( GetLastError() ) );
+        CloseHandle( hFile );
+    }
+
+    delete []pFile;
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// The skeleton is a binary tree of NumFrames frames (frame i hangs off frame (i - 1) / 2)
+// in a mesh without buffers, loaded from memory without a device, with an animation of
+// NumKeys keys
+//--------------------------------------------------------------------------------------
+static HRESULT CreateBenchmarkSkeleton( CDXUTSDKMesh* pMesh, UINT NumFrames, UINT NumKeys )
+{
+    HRESULT hr;
+
+    // Header, the mesh and subset arrays are empty
+    UINT DataBytes = sizeof( SDKMESH_HEADER ) + NumFrames * sizeof( SDKMESH_FRAME );
+    BYTE* pData = new BYTE[ DataBytes ];
+    if( !pData )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pData, DataBytes );
+
+    SDKMESH_HEADER* pHeader = ( SDKMESH_HEADER* )pData;
+    pHeader->Version = SDKMESH_FILE_VERSION;
+    pHeader->HeaderSize = sizeof( SDKMESH_HEADER );
+    pHeader->NonBufferDataSize = DataBytes - sizeof( SDKMESH_HEADER );
+    pHeader->NumFrames = NumFrames;
+    pHeader->VertexStreamHeadersOffset = sizeof( SDKMESH_HEADER );
+    pHeader->IndexStreamHeadersOffset = sizeof( SDKMESH_HEADER );
+    pHeader->MeshDataOffset = sizeof( SDKMESH_HEADER );
+    pHeader->SubsetDataOffset = sizeof( SDKMESH_HEADER );
+    pHeader->FrameDataOffset = sizeof( SDKMESH_HEADER );
+    pHeader->MaterialDataOffset = DataBytes;
+
+    SDKMESH_FRAME* pFrames = ( SDKMESH_FRAME* )( pData + pHeader->FrameDataOffset );
+    for( UINT i = 0; i < NumFrames; i++ )
+    {
+        sprintf_s( pFrames[i].Name, MAX_FRAME_NAME, "frame%u", i );
+        pFrames[i].Mesh = INVALID_MESH;
+        pFrames[i].ParentFrame = i > 0 ? ( i - 1 ) / 2 : INVALID_FRAME;
+        pFrames[i].ChildFrame = 2 * i + 1 < NumFrames ? 2 * i + 1 : INVALID_FRAME;
+        pFrames[i].SiblingFrame = ( i & 1 ) && i + 1 < NumFrames ? i + 1 : INVALID_FRAME;
+        D3DXMatrixTranslation( &pFrames[i].Matrix, 0.0f, 1.0f, 0.0f );
+        pFrames[i].AnimationDataIndex = INVALID_ANIMATION_DATA;
+    }
+
+    WCHAR strFileName[MAX_PATH];
+    if( !GetTempPath( MAX_PATH, strFileName ) )
+    {
+        delete []pData;
+        return DXUT_ERR( L"GetTempPath", HRESULT_FROM_WIN32( GetLastError() ) );
+    }
+    if( wcscat_s( strFileName, MAX_PATH, L"DXUTBenchmark.sdkanim" ) != 0 )
+    {
+        delete []pData;
+        return E_FAIL;
+    }
+
+    // Without a copy of the static data the mesh owns pData from here on
+    V_RETURN( pMesh->Create( ( ID3D11Device* )NULL, pData, DataBytes, false, false ) );
+
+    V_RETURN( WriteBenchmarkAnimation( strFileName, NumFrames, NumKeys ) );
+    hr = pMesh->LoadAnimation( strFileName );
+    DeleteFile( strFileName );
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+// One pair of output arrays is reused by all instances, as when each instance is
+// uploaded right away
+//--------------------------------------------------------------------------------------
+HRESULT DXUTBenchmarkSDKMeshTransform( UINT NumFrames, UINT NumInstances, UINT NumIterations,
+                                       SDKMESH_TRANSFORM_BENCHMARK* pResult )
+{
+    HRESULT hr;
+
+    if( pResult == NULL || NumFrames == 0 || NumInstances == 0 || NumIterations == 0 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResult, sizeof( SDKMESH_TRANSFORM_BENCHMARK ) );
+
+    CDXUTSDKMesh Mesh;
+    V_RETURN( CreateBenchmarkSkeleton( &Mesh, NumFrames, 30 ) );
+
+    D3DXMATRIX mIdentity;
+    D3DXMatrixIdentity( &mIdentity );
+    Mesh.TransformBindPose( &mIdentity );
+
+    D3DXMATRIX* pWorldPose = new D3DXMATRIX[ NumFrames ];
+    D3DXMATRIX* pInfluence = new D3DXMATRIX[ NumFrames ];
+    if( !pWorldPose || !pInfluence )
+    {
+        SAFE_DELETE_ARRAY( pWorldPose );
+        SAFE_DELETE_ARRAY( pInfluence );
+        return E_OUTOFMEMORY;
+    }
+
+    LARGE_INTEGER Frequency, Start, End;
+    QueryPerformanceFrequency( &Frequency );
+    QueryPerformanceCounter( &Start );
+
+    for( UINT iIteration = 0; iIteration < NumIterations; iIteration++ )
+    {
+        for( UINT iInstance = 0; iInstance < NumInstances; iInstance++ )
+        {
+            // Instances are spread out and play the animation at different times
+            D3DXMATRIX mWorld;
+            D3DXMatrixTranslation( &mWorld, ( FLOAT )( iInstance % 32 ), 0.0f, ( FLOAT )( iInstance / 32 ) );
+            double fTime = iIteration / 60.0 + iInstance * 0.1;
+            Mesh.TransformMeshInstance( &mWorld, fTime, pWorldPose, pInfluence );
+        }
+    }
+
+    QueryPerformanceCounter( &End );
+
+    delete []pWorldPose;
+    delete []pInfluence;
+
+    double fSeconds = ( double )( End.QuadPart - Start.QuadPart ) / ( double )Frequency.QuadPart;
+    pResult->NumFrames = NumFrames;
+    pResult->NumInstances = NumInstances;
+    pResult->NumIterations = NumIterations;
+    pResult->fSecondsPerIteration = fSeconds / NumIterations;
+    pResult->fNanosecondsPerFrame = fSeconds * 1e9 / ( ( double )NumIterations * NumInstances * NumFrames );
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// The world pose is compared at every key and halfway between keys, before and after
+// the raw data is released
+//--------------------------------------------------------------------------------------
+HRESULT DXUTBenchmarkSDKMeshAnimationCompression( UINT NumFrames, UINT NumKeys,
+                                                  const SDKANIMATION_COMPRESSION_SETTINGS* pSettings,
+                                                  SDKMESH_COMPRESSION_BENCHMARK* pResult )
+{
+    HRESULT hr;
+
+    if( pResult == NULL || pSettings == NULL || NumFrames == 0 || NumKeys < 2 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResult, sizeof( SDKMESH_COMPRESSION_BENCHMARK ) );
+
+    // The mesh only points at the tracks, so they have to outlive it
+    CDXUTCompressedAnimation Animation;
+    CDXUTSDKMesh Mesh;
+    V_RETURN( CreateBenchmarkSkeleton( &Mesh, NumFrames, NumKeys ) );
+
+    UINT NumSamples = 2 * NumKeys;
+    D3DXVECTOR3* pRawPositions = new D3DXVECTOR3[ ( size_t )NumSamples * NumFrames ];
+    if( !pRawPositions )
+        return E_OUTOFMEMORY;
+
+    D3DXMATRIX mIdentity;
+    D3DXMatrixIdentity( &mIdentity );
+    Mesh.TransformBindPose( &mIdentity );
+
+    UINT FPS = Mesh.GetAnimationHeader()->AnimationFPS;
+    for( UINT iSample = 0; iSample < NumSamples; iSample++ )
+    {
+        Mesh.TransformMesh( &mIdentity, iSample * 0.5 / FPS );
+        for( UINT i = 0; i < NumFrames; i++ )
+        {
+            const D3DXMATRIX* pWorld = Mesh.GetWorldMatrix( i );
+            pRawPositions[ ( size_t )iSample * NumFrames + i ] = D3DXVECTOR3( pWorld->_41, pWorld->_42, pWorld->_43 );
+        }
+    }
+
+    LARGE_INTEGER Frequency, Start, End;
+    QueryPerformanceFrequency( &Frequency );
+    QueryPerformanceCounter( &Start );
+    hr = Animation.Compress( Mesh.GetAnimationHeader(), Mesh.GetAnimationFrameData(), pSettings, &pResult->Report );
+    QueryPerformanceCounter( &End );
+
+    // From here on the mesh animates from the compressed tracks alone
+    if( SUCCEEDED( hr ) )
+        hr = Mesh.SetCompressedAnimation( &Animation );
+    if( FAILED( hr ) )
+    {
+        delete []pRawPositions;
+        return hr;
+    }
+    Mesh.ReleaseAnimationData();
+
+    for( UINT iSample = 0; iSample < NumSamples; iSample++ )
+    {
+        Mesh.TransformMesh( &mIdentity, iSample * 0.5 / FPS );
+        for( UINT i = 0; i < NumFrames; i++ )
+        {
+            const D3DXMATRIX* pWorld = Mesh.GetWorldMatrix( i );
+            D3DXVECTOR3 vError = D3DXVECTOR3( pWorld->_41, pWorld->_42, pWorld->_43 ) -
+                                 pRawPositions[ ( size_t )iSample * NumFrames + i ];
+            pResult->fMaxPositionError = max( pResult->fMaxPositionError, D3DXVec3Length( &vError ) );
+        }
+    }
+
+    delete []pRawPositions;
+
+    pResult->NumFrames = NumFrames;
+    pResult->NumKeys = NumKeys;
+    pResult->fCompressSeconds = ( double )( End.QuadPart - Start.QuadPart ) / ( double )Frequency.QuadPart;
+
+    return S_OK;
+}
 
 //-------------------------------------------------------------------------------------
 // CDXUTXFileMesh implementation.
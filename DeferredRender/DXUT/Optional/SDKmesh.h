@@ -13,6 +13,8 @@
 #ifndef _SDKMESH_
 #define _SDKMESH_
 
+#include <DirectXMath.h>
+
 //--------------------------------------------------------------------------------------
 // Hard Defines for the various structures
 //--------------------------------------------------------------------------------------
@@ -291,6 +293,8 @@ struct SDKMESH_CALLBACKS11
     void* pContext;
 };
 
+class CDXUTCompressedAnimation;
+
 //--------------------------------------------------------------------------------------
 // CDXUTSDKMesh class.  This class reads the sdkmesh file format for use by the samples
 //--------------------------------------------------------------------------------------
@@ -334,10 +338,19 @@ protected:
     //Animation (TODO: Add ability to load/track multiple animation sets)
     SDKANIMATION_FILE_HEADER* m_pAnimationHeader;
     SDKANIMATION_FRAME_DATA* m_pAnimationFrameData;
+    const CDXUTCompressedAnimation* m_pCompressedAnimation;
     D3DXMATRIX* m_pBindPoseFrameMatrices;
     D3DXMATRIX* m_pTransformedFrameMatrices;
     D3DXMATRIX* m_pWorldPoseFrameMatrices;
 
+    //Flattened frame hierarchy, built once at load. Frames are stored level by level so
+    //every parent precedes its children; level L occupies [m_pFrameLevelStart[L], m_pFrameLevelStart[L+1]).
+    UINT* m_pFrameOrder;
+    UINT* m_pFrameOrderParent;
+    UINT* m_pFrameLevelStart;
+    UINT m_NumOrderedFrames;
+    UINT m_NumFrameLevels;
+
 protected:
     void                            LoadMaterials( ID3D11Device* pd3dDevice, SDKMESH_MATERIAL* pMaterials,
                                                    UINT NumMaterials, SDKMESH_CALLBACKS11* pLoaderCallbacks=NULL );
@@ -365,6 +378,13 @@ protected:
                                                     SDKMESH_CALLBACKS11* pLoaderCallbacks11 = NULL,
                                                     SDKMESH_CALLBACKS9* pLoaderCallbacks9 = NULL );
 
+    virtual HRESULT                 CreateFromMappedFile( ID3D11Device* pDev11,
+                                                          IDirect3DDevice9* pDev9,
+                                                          LPCTSTR szFileName,
+                                                          bool bCreateAdjacencyIndices,
+                                                          SDKMESH_CALLBACKS11* pLoaderCallbacks11 = NULL,
+                                                          SDKMESH_CALLBACKS9* pLoaderCallbacks9 = NULL );
+
     virtual HRESULT                 CreateFromMemory( ID3D11Device* pDev11,
                                                       IDirect3DDevice9* pDev9,
                                                       BYTE* pData,
@@ -375,8 +395,12 @@ protected:
                                                       SDKMESH_CALLBACKS9* pLoaderCallbacks9 = NULL );
 
     //frame manipulation
-    void                            TransformBindPoseFrame( UINT iFrame, D3DXMATRIX* pParentWorld );
-    void                            TransformFrame( UINT iFrame, D3DXMATRIX* pParentWorld, double fTime );
+    HRESULT                         BuildFrameOrder();
+    void                            GetFramePose( UINT iAnimationData, UINT iKey, DirectX::XMVECTOR* pTranslation,
+                                                  DirectX::XMVECTOR* pOrientation );
+    void                            GetFrameLocalTransform( UINT iFrame, double fTime, D3DXMATRIX* pLocal );
+    void                            TransformFrames( const D3DXMATRIX* pWorld, double fTime, bool bBindPose,
+                                                     D3DXMATRIX* pWorldOut );
     void                            TransformFrameAbsolute( UINT iFrame, double fTime );
 
     //Direct3D 11 rendering helpers
@@ -424,12 +448,24 @@ public:
     virtual HRESULT                 Create( IDirect3DDevice9* pDev9, BYTE* pData, UINT DataBytes,
                                             bool bCreateAdjacencyIndices=false, bool bCopyStatic=false,
                                             SDKMESH_CALLBACKS9* pLoaderCallbacks=NULL );
+    // Memory-mapped variants: the file is mapped copy-on-write and vertex/index data is handed to
+    // buffer creation straight from the view, so no heap copy of the mesh is ever made.
+    // Passing a typed NULL device, e.g. ( ID3D11Device* )NULL, only parses the file (useful for
+    // measuring load cost without D3D).
+    virtual HRESULT                 CreateMapped( ID3D11Device* pDev11, LPCTSTR szFileName,
+                                                  bool bCreateAdjacencyIndices=false,
+                                                  SDKMESH_CALLBACKS11* pLoaderCallbacks=NULL );
+    virtual HRESULT                 CreateMapped( IDirect3DDevice9* pDev9, LPCTSTR szFileName,
+                                                  bool bCreateAdjacencyIndices=false,
+                                                  SDKMESH_CALLBACKS9* pLoaderCallbacks=NULL );
     virtual HRESULT                 LoadAnimation( WCHAR* szFileName );
     virtual void                    Destroy();
 
     //Frame manipulation
     void                            TransformBindPose( D3DXMATRIX* pWorld );
     void                            TransformMesh( D3DXMATRIX* pWorld, double fTime );
+    void                            TransformMeshInstance( const D3DXMATRIX* pWorld, double fTime,
+                                                           D3DXMATRIX* pWorldPoseOut, D3DXMATRIX* pInfluenceOut );
 
 
     //Direct3D 11 Rendering
@@ -480,6 +516,7 @@ public:
     IDirect3DIndexBuffer9* GetIB9At( UINT iIB );
 
     BYTE* GetRawVerticesAt( UINT iVB );
+    const SDKMESH_VERTEX_BUFFER_HEADER* GetVBHeaderAt( UINT iVB );
     BYTE* GetRawIndicesAt( UINT iIB );
     SDKMESH_MATERIAL* GetMaterial( UINT iMaterial );
     SDKMESH_MESH* GetMesh( UINT iMesh );
@@ -497,6 +534,7 @@ public:
     UINT                            GetOutstandingBufferResources();
     bool                            CheckLoadDone();
     bool                            IsLoaded();
+    bool                            IsMapped();
     bool                            IsLoading();
     void                            SetLoading( bool bLoading );
     BOOL                            HadLoadingError();
@@ -505,11 +543,54 @@ public:
     UINT                            GetNumInfluences( UINT iMesh );
     const D3DXMATRIX*               GetMeshInfluenceMatrix( UINT iMesh, UINT iInfluence );
     UINT                            GetAnimationKeyFromTime( double fTime );
+    void                            GetAnimationKeysFromTime( double fTime, UINT* pKey0, UINT* pKey1, FLOAT* pLerp );
+    // Raw data loaded by LoadAnimation, the input of CDXUTCompressedAnimation::Compress; NULL
+    // when not loaded or released
+    const SDKANIMATION_FILE_HEADER* GetAnimationHeader() { return m_pAnimationHeader; }
+    const SDKANIMATION_FRAME_DATA*  GetAnimationFrameData() { return m_pAnimationFrameData; }
+    HRESULT                         SetCompressedAnimation( const CDXUTCompressedAnimation* pAnimation );
+    void                            ReleaseAnimationData();
     const D3DXMATRIX*               GetWorldMatrix( UINT iFrameIndex );
     const D3DXMATRIX*               GetInfluenceMatrix( UINT iFrameIndex );
     bool                            GetAnimationProperties( UINT* pNumKeys, FLOAT* pFrameTime );
+    bool                            GetAnimationTiming( UINT* pNumKeys, UINT* pFPS );
+};
+
+//--------------------------------------------------------------------------------------
+// Benchmarks
+//--------------------------------------------------------------------------------------
+struct SDKMESH_LOAD_BENCHMARK
+{
+    UINT   NumVertices;
+    UINT   NumLoads;
+    UINT64 FileBytes;
+    double fHeapSeconds;                // Create: the file is read into the heap, per load
+    double fMappedSeconds;              // CreateMapped: copy-on-write view, per load
+    UINT64 HeapWorkingSetBytes;         // Peak working set growth while a mesh is loaded
+    UINT64 MappedWorkingSetBytes;
+    UINT64 HeapPrivateBytes;            // Peak commit charge growth while a mesh is loaded; a copy-on-write
+                                        // view is charged in full although only written pages become private
+    UINT64 MappedPrivateBytes;
 };
 
+// Writes a synthetic mesh of NumVertices vertices (32 bit indices) to the temp directory and
+// loads it NumLoads times with Create and with CreateMapped, without a device
+HRESULT DXUTBenchmarkSDKMeshLoad( UINT NumVertices, UINT NumLoads, SDKMESH_LOAD_BENCHMARK* pResult );
+
+struct SDKMESH_TRANSFORM_BENCHMARK
+{
+    UINT   NumFrames;
+    UINT   NumInstances;
+    UINT   NumIterations;
+    double fSecondsPerIteration;        // World pose and influence matrices of all instances
+    double fNanosecondsPerFrame;        // Per frame of one instance
+};
+
+// Animates NumInstances instances of a synthetic NumFrames frame skeleton NumIterations times
+// with TransformMeshInstance
+HRESULT DXUTBenchmarkSDKMeshTransform( UINT NumFrames, UINT NumInstances, UINT NumIterations,
+                                       SDKMESH_TRANSFORM_BENCHMARK* pResult );
+
 //-----------------------------------------------------------------------------
 // Name: class CDXUTXFileMesh
 // Desc: Class for loading and rendering file-based meshes
@@ -37,6 +37,13 @@ bool DXUTFindMediaSearchParentDirs( __out_ecount(cchSearch) WCHAR* strSearchPath
                                     __in WCHAR* strStartAt, 
                                     __in WCHAR* strLeafName );
 INT_PTR CALLBACK DisplaySwitchToREFWarningProc( HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam );
+static HRESULT DXUTFindDXSDKMediaFileUncached( __out_ecount(cchDest) WCHAR* strDestPath, 
+                                               __in int cchDest, 
+                                               __in LPCWSTR strFilename );
+
+// Limits of the directory scan of DXUTBuildMediaManifest
+#define DXUT_MEDIA_MANIFEST_MAX_FILES 16384
+#define DXUT_MEDIA_MANIFEST_MAX_DEPTH 16
 
 
 //--------------------------------------------------------------------------------------
@@ -215,10 +222,317 @@ HRESULT WINAPI DXUTSetMediaSearchPath( LPCWSTR strPath )
         }
     }
 
+    // Cached paths may resolve differently with the new search path
+    DXUTClearMediaPathCache();
+
     return hr;
 }
 
 
+//--------------------------------------------------------------------------------------
+// Hash map from normalized file names (see DXUTMediaPathKey) to paths, used for the
+// resolved path cache and the manifest.  A NULL path records a file that was not found.
+//--------------------------------------------------------------------------------------
+struct DXUTMediaPathEntry
+{
+    UINT nHash;
+    WCHAR* strKey;
+    WCHAR* strPath;                 // Points into the allocation of strKey, or NULL
+    int nNext;                      // Next entry of the bucket, -1 at the end
+};
+
+class CDXUTMediaPathMap
+{
+public:
+                    CDXUTMediaPathMap();
+                    ~CDXUTMediaPathMap();
+
+    const DXUTMediaPathEntry* Find( LPCWSTR strKey, UINT nHash ) const;
+    HRESULT         Add( LPCWSTR strKey, UINT nHash, LPCWSTR strPath );
+    void            RemoveAll();
+    int             GetSize() const { return m_Entries.GetSize(); }
+
+protected:
+    HRESULT         Rehash( int nBuckets );
+
+    CGrowableArray <DXUTMediaPathEntry> m_Entries;
+    CGrowableArray <int> m_Buckets;     // First entry of each bucket or -1, a power of two
+};
+
+
+//--------------------------------------------------------------------------------------
+CDXUTMediaPathMap::CDXUTMediaPathMap()
+{
+}
+
+
+//--------------------------------------------------------------------------------------
+CDXUTMediaPathMap::~CDXUTMediaPathMap()
+{
+    RemoveAll();
+}
+
+
+//--------------------------------------------------------------------------------------
+const DXUTMediaPathEntry* CDXUTMediaPathMap::Find( LPCWSTR strKey, UINT nHash ) const
+{
+    if( m_Buckets.GetSize() == 0 )
+        return NULL;
+
+    for( int i = m_Buckets[( int )( nHash & ( m_Buckets.GetSize() - 1 ) )]; i != -1; i = m_Entries[i].nNext )
+    {
+        const DXUTMediaPathEntry& entry = m_Entries[i];
+        if( entry.nHash == nHash && wcscmp( entry.strKey, strKey ) == 0 )
+            return &entry;
+    }
+
+    return NULL;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTMediaPathMap::Add( LPCWSTR strKey, UINT nHash, LPCWSTR strPath )
+{
+    HRESULT hr;
+
+    if( m_Entries.GetSize() >= m_Buckets.GetSize() )
+        V_RETURN( Rehash( __max( 64, m_Buckets.GetSize() * 2 ) ) );
+
+    size_t cchKey = wcslen( strKey ) + 1;
+    size_t cchPath = strPath ? wcslen( strPath ) + 1 : 0;
+    WCHAR* pStrings = new WCHAR[ cchKey + cchPath ];
+    if( pStrings == NULL )
+        return E_OUTOFMEMORY;
+
+    DXUTMediaPathEntry entry;
+    entry.nHash = nHash;
+    entry.strKey = pStrings;
+    entry.strPath = strPath ? pStrings + cchKey : NULL;
+    wcscpy_s( entry.strKey, cchKey, strKey );
+    if( strPath )
+        wcscpy_s( entry.strPath, cchPath, strPath );
+
+    int iBucket = ( int )( nHash & ( m_Buckets.GetSize() - 1 ) );
+    entry.nNext = m_Buckets[iBucket];
+    if( FAILED( hr = m_Entries.Add( entry ) ) )
+    {
+        delete[] pStrings;
+        return hr;
+    }
+    m_Buckets[iBucket] = m_Entries.GetSize() - 1;
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTMediaPathMap::Rehash( int nBuckets )
+{
+    HRESULT hr;
+
+    V_RETURN( m_Buckets.SetSize( nBuckets ) );
+    for( int i = 0; i < nBuckets; i++ )
+        m_Buckets[i] = -1;
+
+    for( int i = 0; i < m_Entries.GetSize(); i++ )
+    {
+        int iBucket = ( int )( m_Entries[i].nHash & ( nBuckets - 1 ) );
+        m_Entries[i].nNext = m_Buckets[iBucket];
+        m_Buckets[iBucket] = i;
+    }
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+void CDXUTMediaPathMap::RemoveAll()
+{
+    for( int i = 0; i < m_Entries.GetSize(); i++ )
+        delete[] m_Entries[i].strKey;
+
+    m_Entries.Reset();
+    for( int i = 0; i < m_Buckets.GetSize(); i++ )
+        m_Buckets[i] = -1;
+}
+
+
+//--------------------------------------------------------------------------------------
+// State of the media search, not thread safe (like the media search path)
+//--------------------------------------------------------------------------------------
+struct DXUTMediaSearchState
+{
+    DXUTMediaSearchState()
+    {
+        bCacheEnabled = true;
+        ZeroMemory( &Stats, sizeof( Stats ) );
+    }
+
+    CDXUTMediaPathMap Resolved;
+    CDXUTMediaPathMap Manifest;
+    bool bCacheEnabled;
+    DXUT_MEDIA_SEARCH_STATS Stats;
+};
+
+static DXUTMediaSearchState& DXUTGetMediaSearchState()
+{
+    // Using an accessor function gives control of the construction order
+    static DXUTMediaSearchState state;
+    return state;
+}
+
+
+//--------------------------------------------------------------------------------------
+// File system probes of the media search, counted in DXUT_MEDIA_SEARCH_STATS
+//--------------------------------------------------------------------------------------
+static bool DXUTMediaFileExists( LPCWSTR strPath )
+{
+    DXUTGetMediaSearchState().Stats.nFileSystemCalls++;
+    return GetFileAttributes( strPath ) != 0xFFFFFFFF;
+}
+
+static DWORD DXUTMediaGetFullPathName( LPCWSTR strPath, DWORD cchBuffer, WCHAR* strBuffer, WCHAR** pstrFilePart )
+{
+    DXUTGetMediaSearchState().Stats.nFileSystemCalls++;
+    return GetFullPathName( strPath, cchBuffer, strBuffer, pstrFilePart );
+}
+
+
+//--------------------------------------------------------------------------------------
+// Lower case, with forward slashes turned into backslashes, so that names that refer to
+// the same file share a key.  Returns false if the name does not fit in cchKey.
+//--------------------------------------------------------------------------------------
+static bool DXUTMediaPathKey( LPCWSTR strFilename, WCHAR* strKey, int cchKey, UINT* pnHash )
+{
+    UINT nHash = 2166136261u;
+    int i;
+    for( i = 0; strFilename[i] != 0; i++ )
+    {
+        if( i >= cchKey - 1 )
+            return false;
+
+        WCHAR ch = ( strFilename[i] == L'/' ) ? L'\\' : towlower( strFilename[i] );
+        strKey[i] = ch;
+        nHash = ( nHash ^ ( UINT )ch ) * 16777619u;
+    }
+    strKey[i] = 0;
+
+    *pnHash = nHash;
+    return true;
+}
+
+
+//--------------------------------------------------------------------------------------
+void WINAPI DXUTEnableMediaPathCache( bool bEnable )
+{
+    DXUTGetMediaSearchState().bCacheEnabled = bEnable;
+}
+
+
+//--------------------------------------------------------------------------------------
+void WINAPI DXUTClearMediaPathCache()
+{
+    DXUTGetMediaSearchState().Resolved.RemoveAll();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Adds the files of strRoot\strRelative and its subdirectories to the manifest
+//--------------------------------------------------------------------------------------
+static void DXUTScanMediaDir( CDXUTMediaPathMap& manifest, LPCWSTR strRoot, LPCWSTR strRelative, int nDepth )
+{
+    DXUTMediaSearchState& state = DXUTGetMediaSearchState();
+    if( manifest.GetSize() >= DXUT_MEDIA_MANIFEST_MAX_FILES )
+        return;
+
+    // Names that don't fit in MAX_PATH are skipped
+    WCHAR strPattern[MAX_PATH];
+    if( _snwprintf_s( strPattern, MAX_PATH, _TRUNCATE, L"%s\\%s*", strRoot, strRelative ) < 0 )
+        return;
+
+    WIN32_FIND_DATA findData;
+    state.Stats.nFileSystemCalls++;
+    HANDLE hFind = FindFirstFile( strPattern, &findData );
+    if( hFind == INVALID_HANDLE_VALUE )
+        return;
+
+    BOOL bMore = TRUE;
+    for( ; bMore; state.Stats.nFileSystemCalls++, bMore = FindNextFile( hFind, &findData ) )
+    {
+        if( wcscmp( findData.cFileName, L"." ) == 0 || wcscmp( findData.cFileName, L".." ) == 0 )
+            continue;
+
+        WCHAR strName[MAX_PATH];
+        if( _snwprintf_s( strName, MAX_PATH, _TRUNCATE, L"%s%s", strRelative, findData.cFileName ) < 0 )
+            continue;
+
+        if( findData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY )
+        {
+            // Reparse points can form cycles
+            if( nDepth < DXUT_MEDIA_MANIFEST_MAX_DEPTH &&
+                !( findData.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT ) &&
+                wcslen( strName ) < MAX_PATH - 1 )
+            {
+                wcscat_s( strName, MAX_PATH, L"\\" );
+                DXUTScanMediaDir( manifest, strRoot, strName, nDepth + 1 );
+            }
+            continue;
+        }
+
+        if( manifest.GetSize() >= DXUT_MEDIA_MANIFEST_MAX_FILES )
+            break;
+
+        WCHAR strKey[MAX_PATH];
+        WCHAR strPath[MAX_PATH];
+        UINT nHash;
+        if( DXUTMediaPathKey( strName, strKey, MAX_PATH, &nHash ) &&
+            _snwprintf_s( strPath, MAX_PATH, _TRUNCATE, L"%s\\%s", strRoot, strName ) >= 0 )
+            manifest.Add( strKey, nHash, strPath );
+    }
+
+    FindClose( hFind );
+}
+
+
+//--------------------------------------------------------------------------------------
+HRESULT WINAPI DXUTBuildMediaManifest( LPCWSTR strMediaDir )
+{
+    DXUTMediaSearchState& state = DXUTGetMediaSearchState();
+
+    // Names cached as missing may be in the manifest
+    state.Manifest.RemoveAll();
+    state.Resolved.RemoveAll();
+
+    if( strMediaDir == NULL )
+        return E_INVALIDARG;
+
+    WCHAR strRoot[MAX_PATH];
+    DWORD cchRoot = DXUTMediaGetFullPathName( strMediaDir, MAX_PATH, strRoot, NULL );
+    if( cchRoot == 0 || cchRoot >= MAX_PATH )
+        return DXUTERR_MEDIANOTFOUND;
+    if( strRoot[cchRoot - 1] == L'\\' )
+        strRoot[cchRoot - 1] = 0;
+
+    if( !DXUTMediaFileExists( strRoot ) )
+        return DXUTERR_MEDIANOTFOUND;
+
+    DXUTScanMediaDir( state.Manifest, strRoot, L"", 0 );
+
+    return S_OK;
+}
+
+
+//--------------------------------------------------------------------------------------
+void WINAPI DXUTGetMediaSearchStats( DXUT_MEDIA_SEARCH_STATS* pStats )
+{
+    DXUTMediaSearchState& state = DXUTGetMediaSearchState();
+
+    *pStats = state.Stats;
+    pStats->nCachedPaths = ( UINT )state.Resolved.GetSize();
+    pStats->nManifestFiles = ( UINT )state.Manifest.GetSize();
+}
+
+
 //--------------------------------------------------------------------------------------
 // Tries to find the location of a SDK media file
 //       cchDest is the size in WCHARs of strDestPath.  Be careful not to 
@@ -227,12 +541,57 @@ HRESULT WINAPI DXUTSetMediaSearchPath( LPCWSTR strPath )
 HRESULT WINAPI DXUTFindDXSDKMediaFileCch( WCHAR* strDestPath, int cchDest, 
                                           LPCWSTR strFilename )
 {
-    bool bFound;
-    WCHAR strSearchFor[MAX_PATH];
-
     if( NULL == strFilename || strFilename[0] == 0 || NULL == strDestPath || cchDest < 10 )
         return E_INVALIDARG;
 
+    DXUTMediaSearchState& state = DXUTGetMediaSearchState();
+    state.Stats.nLookups++;
+
+    WCHAR strKey[MAX_PATH];
+    UINT nHash = 0;
+    bool bCache = state.bCacheEnabled && DXUTMediaPathKey( strFilename, strKey, MAX_PATH, &nHash );
+    if( bCache )
+    {
+        const DXUTMediaPathEntry* pEntry = state.Resolved.Find( strKey, nHash );
+        if( pEntry && pEntry->strPath == NULL )
+        {
+            state.Stats.nCacheHits++;
+            state.Stats.nNegativeCacheHits++;
+            wcscpy_s( strDestPath, cchDest, strFilename );
+            return DXUTERR_MEDIANOTFOUND;
+        }
+        if( pEntry && wcslen( pEntry->strPath ) < ( size_t )cchDest )
+        {
+            state.Stats.nCacheHits++;
+            wcscpy_s( strDestPath, cchDest, pEntry->strPath );
+            return S_OK;
+        }
+
+        pEntry = state.Manifest.Find( strKey, nHash );
+        if( pEntry && wcslen( pEntry->strPath ) < ( size_t )cchDest )
+        {
+            state.Stats.nManifestHits++;
+            wcscpy_s( strDestPath, cchDest, pEntry->strPath );
+            return S_OK;
+        }
+    }
+
+    HRESULT hr = DXUTFindDXSDKMediaFileUncached( strDestPath, cchDest, strFilename );
+    if( bCache && state.Resolved.Find( strKey, nHash ) == NULL )
+        state.Resolved.Add( strKey, nHash, SUCCEEDED( hr ) ? strDestPath : NULL );
+
+    return hr;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Probes the typical directories and the parent directories for the file
+//--------------------------------------------------------------------------------------
+static HRESULT DXUTFindDXSDKMediaFileUncached( WCHAR* strDestPath, int cchDest, LPCWSTR strFilename )
+{
+    bool bFound;
+    WCHAR strSearchFor[MAX_PATH];
+
     // Get the exe name, and exe path
     WCHAR strExePath[MAX_PATH] =
     {
@@ -333,47 +692,47 @@ bool DXUTFindMediaSearchTypicalDirs( WCHAR* strSearchPath, int cchSearch, LPCWST
 
     // Search in .\  
     wcscpy_s( strSearchPath, cchSearch, strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in ..\  
     swprintf_s( strSearchPath, cchSearch, L"..\\%s", strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in ..\..\ 
     swprintf_s( strSearchPath, cchSearch, L"..\\..\\%s", strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in ..\..\ 
     swprintf_s( strSearchPath, cchSearch, L"..\\..\\%s", strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in the %EXE_DIR%\ 
     swprintf_s( strSearchPath, cchSearch, L"%s\\%s", strExePath, strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in the %EXE_DIR%\..\ 
     swprintf_s( strSearchPath, cchSearch, L"%s\\..\\%s", strExePath, strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in the %EXE_DIR%\..\..\ 
     swprintf_s( strSearchPath, cchSearch, L"%s\\..\\..\\%s", strExePath, strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in "%EXE_DIR%\..\%EXE_NAME%\".  This matches the DirectX SDK layout
     swprintf_s( strSearchPath, cchSearch, L"%s\\..\\%s\\%s", strExePath, strExeName, strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in "%EXE_DIR%\..\..\%EXE_NAME%\".  This matches the DirectX SDK layout
     swprintf_s( strSearchPath, cchSearch, L"%s\\..\\..\\%s\\%s", strExePath, strExeName, strLeaf );
-    if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+    if( DXUTMediaFileExists( strSearchPath ) )
         return true;
 
     // Search in media search dir 
@@ -381,7 +740,7 @@ bool DXUTFindMediaSearchTypicalDirs( WCHAR* strSearchPath, int cchSearch, LPCWST
     if( s_strSearchPath[0] != 0 )
     {
         swprintf_s( strSearchPath, cchSearch, L"%s%s", s_strSearchPath, strLeaf );
-        if( GetFileAttributes( strSearchPath ) != 0xFFFFFFFF )
+        if( DXUTMediaFileExists( strSearchPath ) )
             return true;
     }
 
@@ -411,21 +770,21 @@ bool DXUTFindMediaSearchParentDirs( WCHAR* strSearchPath, int cchSearch, WCHAR*
     };
     WCHAR* strFilePart = NULL;
 
-    GetFullPathName( strStartAt, MAX_PATH, strFullPath, &strFilePart );
+    DXUTMediaGetFullPathName( strStartAt, MAX_PATH, strFullPath, &strFilePart );
     if( strFilePart == NULL )
         return false;
 
     while( strFilePart != NULL && *strFilePart != '\0' )
     {
         swprintf_s( strFullFileName, MAX_PATH, L"%s\\%s", strFullPath, strLeafName );
-        if( GetFileAttributes( strFullFileName ) != 0xFFFFFFFF )
+        if( DXUTMediaFileExists( strFullFileName ) )
         {
             wcscpy_s( strSearchPath, cchSearch, strFullFileName );
             return true;
         }
 
         swprintf_s( strSearch, MAX_PATH, L"%s\\..", strFullPath );
-        GetFullPathName( strSearch, MAX_PATH, strFullPath, &strFilePart );
+        DXUTMediaGetFullPathName( strSearch, MAX_PATH, strFullPath, &strFilePart );
     }
 
     return false;
@@ -1693,21 +2052,11 @@ void CDXUTTextHelper::Begin()
     if( m_pSprite9 )
         m_pSprite9->Begin( D3DXSPRITE_ALPHABLEND | D3DXSPRITE_SORT_TEXTURE );
 
-    if( m_pd3d11DeviceContext )
-    {
-        m_pManager->StoreD3D11State( m_pd3d11DeviceContext );
-        m_pManager->ApplyRenderUI11( m_pd3d11DeviceContext );
-    }
-
-
+    // D3D11 text is queued in the UI batch of m_pManager and drawn by
+    // CDXUTDialogResourceManager::EndFrame11, so there is no state to set up here
 }
 void CDXUTTextHelper::End()
 {
     if( m_pSprite9 )
         m_pSprite9->End();
-
-    if( m_pd3d11DeviceContext )
-    {
-        m_pManager->RestoreD3D11State( m_pd3d11DeviceContext );
-    }
 }
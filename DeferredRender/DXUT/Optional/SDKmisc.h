@@ -273,6 +273,32 @@ HRESULT WINAPI DXUTFindDXSDKMediaFileCch( __out_ecount(cchDest) WCHAR* strDestPa
 HRESULT WINAPI DXUTSetMediaSearchPath( LPCWSTR strPath );
 LPCWSTR WINAPI DXUTGetMediaSearchPath();
 
+//--------------------------------------------------------------------------------------
+// DXUTFindDXSDKMediaFileCch remembers the path each file name resolved to, and the names
+// that were not found, so only the first lookup of a name probes the file system.  The
+// cache is cleared by DXUTSetMediaSearchPath; call DXUTClearMediaPathCache when files
+// are created or the current directory changes.
+//
+// DXUTBuildMediaManifest scans a media directory tree once and answers lookups of the
+// files in it (relative to that directory) without probing; it is searched before the
+// typical directories.  Names not in the manifest are searched as usual.
+//--------------------------------------------------------------------------------------
+struct DXUT_MEDIA_SEARCH_STATS
+{
+    UINT nLookups;                  // Calls to DXUTFindDXSDKMediaFileCch
+    UINT nCacheHits;                // Answered by the cache, including names cached as missing
+    UINT nNegativeCacheHits;
+    UINT nManifestHits;
+    UINT nFileSystemCalls;          // GetFileAttributes, GetFullPathName and FindFirst/NextFile calls
+    UINT nCachedPaths;
+    UINT nManifestFiles;
+};
+
+void WINAPI    DXUTEnableMediaPathCache( bool bEnable );
+void WINAPI    DXUTClearMediaPathCache();
+HRESULT WINAPI DXUTBuildMediaManifest( LPCWSTR strMediaDir );
+void WINAPI    DXUTGetMediaSearchStats( DXUT_MEDIA_SEARCH_STATS* pStats );
+
 
 //--------------------------------------------------------------------------------------
 // Returns a view matrix for rendering to a face of a cubemap.
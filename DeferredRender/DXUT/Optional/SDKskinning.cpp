@@ -0,0 +1,594 @@
+//--------------------------------------------------------------------------------------
+// File: SDKSkinning.cpp
+//
+// CPU and GPU skinning of CDXUTSDKMesh meshes
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SDKMesh.h"
+#include "SDKSkinning.h"
+#include <DirectXPackedVector.h>
+#include <ppl.h>
+
+using namespace DirectX;
+
+// Vertices skinned per parallel work item
+#define SKINNING_BATCH_SIZE 1024
+
+//--------------------------------------------------------------------------------------
+static double GetSeconds( const LARGE_INTEGER& Start, const LARGE_INTEGER& End )
+{
+    LARGE_INTEGER Frequency;
+    QueryPerformanceFrequency( &Frequency );
+    return ( double )( End.QuadPart - Start.QuadPart ) / ( double )Frequency.QuadPart;
+}
+
+//--------------------------------------------------------------------------------------
+static UINT GetNumCores()
+{
+    SYSTEM_INFO SystemInfo;
+    GetSystemInfo( &SystemInfo );
+    return max( 1u, ( UINT )SystemInfo.dwNumberOfProcessors );
+}
+
+//--------------------------------------------------------------------------------------
+static void FillStats( UINT64 NumVertices, UINT NumThreads, double fSeconds, SDKSKINNING_STATS* pStats )
+{
+    pStats->NumVertices = NumVertices;
+    pStats->NumThreads = NumThreads;
+    pStats->fSeconds = fSeconds;
+    pStats->fVerticesPerSecond = fSeconds > 0.0 ? NumVertices / fSeconds : 0.0;
+    pStats->fVerticesPerSecondPerCore = pStats->fVerticesPerSecond / NumThreads;
+}
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMeshSkinner::CDXUTSDKMeshSkinner() : m_pMesh( NULL ),
+                                             m_iMesh( 0 ),
+                                             m_pSrcVertices( NULL ),
+                                             m_NumVertices( 0 ),
+                                             m_NumBones( 0 ),
+                                             m_pPalette( NULL ),
+                                             m_pSkinnedVB( NULL ),
+                                             m_pPaletteBuffer( NULL ),
+                                             m_pPaletteSRV( NULL )
+{
+    ZeroMemory( &m_Format, sizeof( m_Format ) );
+    ZeroMemory( &m_LastCPUStats, sizeof( m_LastCPUStats ) );
+}
+
+//--------------------------------------------------------------------------------------
+CDXUTSDKMeshSkinner::~CDXUTSDKMeshSkinner()
+{
+    Destroy();
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshSkinner::Destroy()
+{
+    if( m_pPalette )
+    {
+        _aligned_free( m_pPalette );
+        m_pPalette = NULL;
+    }
+    SAFE_RELEASE( m_pSkinnedVB );
+    SAFE_RELEASE( m_pPaletteSRV );
+    SAFE_RELEASE( m_pPaletteBuffer );
+
+    m_pMesh = NULL;
+    m_pSrcVertices = NULL;
+    m_NumVertices = 0;
+    m_NumBones = 0;
+}
+
+//--------------------------------------------------------------------------------------
+// Locate the elements skinning reads and writes in an SDKMESH vertex declaration
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshSkinner::GetVertexFormat( const SDKMESH_VERTEX_BUFFER_HEADER* pVBHeader,
+                                              SDKSKINNING_VERTEX_FORMAT* pFormat )
+{
+    pFormat->Stride = ( UINT )pVBHeader->StrideBytes;
+    pFormat->PositionOffset = -1;
+    pFormat->NormalOffset = -1;
+    pFormat->TangentOffset = -1;
+    pFormat->WeightsOffset = -1;
+    pFormat->IndicesOffset = -1;
+    pFormat->WeightsType = D3DDECLTYPE_UNUSED;
+
+    for( UINT i = 0; i < MAX_VERTEX_ELEMENTS && pVBHeader->Decl[i].Stream != 0xFF; i++ )
+    {
+        const D3DVERTEXELEMENT9& Element = pVBHeader->Decl[i];
+        if( Element.UsageIndex != 0 )
+            continue;
+
+        switch( Element.Usage )
+        {
+            case D3DDECLUSAGE_POSITION:
+                if( Element.Type == D3DDECLTYPE_FLOAT3 )
+                    pFormat->PositionOffset = Element.Offset;
+                break;
+            case D3DDECLUSAGE_NORMAL:
+                if( Element.Type == D3DDECLTYPE_FLOAT3 )
+                    pFormat->NormalOffset = Element.Offset;
+                break;
+            case D3DDECLUSAGE_TANGENT:
+                if( Element.Type == D3DDECLTYPE_FLOAT3 || Element.Type == D3DDECLTYPE_FLOAT4 )
+                    pFormat->TangentOffset = Element.Offset;
+                break;
+            case D3DDECLUSAGE_BLENDWEIGHT:
+                if( Element.Type == D3DDECLTYPE_UBYTE4N || Element.Type == D3DDECLTYPE_FLOAT4 )
+                {
+                    pFormat->WeightsOffset = Element.Offset;
+                    pFormat->WeightsType = Element.Type;
+                }
+                break;
+            case D3DDECLUSAGE_BLENDINDICES:
+                if( Element.Type == D3DDECLTYPE_UBYTE4 )
+                    pFormat->IndicesOffset = Element.Offset;
+                break;
+        }
+    }
+
+    if( pFormat->PositionOffset < 0 || pFormat->WeightsOffset < 0 || pFormat->IndicesOffset < 0 )
+        return E_FAIL;
+
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshSkinner::Create( ID3D11Device* pd3dDevice, CDXUTSDKMesh* pMesh, UINT iMesh )
+{
+    HRESULT hr;
+
+    Destroy();
+
+    SDKMESH_MESH* pMeshData = pMesh->GetMesh( iMesh );
+    if( pMeshData->NumFrameInfluences == 0 )
+        return E_INVALIDARG;
+
+    UINT iVB = pMeshData->VertexBuffers[0];
+    V_RETURN( GetVertexFormat( pMesh->GetVBHeaderAt( iVB ), &m_Format ) );
+
+    m_pMesh = pMesh;
+    m_iMesh = iMesh;
+    m_pSrcVertices = pMesh->GetRawVerticesAt( iVB );
+    m_NumVertices = ( UINT )pMesh->GetNumVertices( iMesh, 0 );
+    m_NumBones = pMeshData->NumFrameInfluences;
+
+    m_pPalette = ( XMMATRIX* )_aligned_malloc( m_NumBones * sizeof( XMMATRIX ), 16 );
+    if( !m_pPalette )
+    {
+        Destroy();
+        return E_OUTOFMEMORY;
+    }
+    for( UINT i = 0; i < m_NumBones; i++ )
+        m_pPalette[i] = XMMatrixIdentity();
+
+    // Same layout as the source, so the input layout of the static mesh can be reused
+    D3D11_BUFFER_DESC BufferDesc;
+    BufferDesc.ByteWidth = m_NumVertices * m_Format.Stride;
+    BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    BufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+    BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    BufferDesc.MiscFlags = 0;
+    BufferDesc.StructureByteStride = 0;
+    D3D11_SUBRESOURCE_DATA InitData;
+    InitData.pSysMem = m_pSrcVertices;
+    InitData.SysMemPitch = 0;
+    InitData.SysMemSlicePitch = 0;
+    hr = pd3dDevice->CreateBuffer( &BufferDesc, &InitData, &m_pSkinnedVB );
+    if( FAILED( hr ) )
+        goto Error;
+    DXUT_SetDebugName( m_pSkinnedVB, "CDXUTSDKMeshSkinner" );
+
+    // Bone palette for VS_Skinned
+    BufferDesc.ByteWidth = m_NumBones * sizeof( XMFLOAT4X4 );
+    BufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+    BufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+    BufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+    BufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+    BufferDesc.StructureByteStride = sizeof( XMFLOAT4X4 );
+    hr = pd3dDevice->CreateBuffer( &BufferDesc, NULL, &m_pPaletteBuffer );
+    if( FAILED( hr ) )
+        goto Error;
+    DXUT_SetDebugName( m_pPaletteBuffer, "CDXUTSDKMeshSkinner" );
+
+    D3D11_SHADER_RESOURCE_VIEW_DESC SRVDesc;
+    ZeroMemory( &SRVDesc, sizeof( SRVDesc ) );
+    SRVDesc.Format = DXGI_FORMAT_UNKNOWN;
+    SRVDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+    SRVDesc.Buffer.FirstElement = 0;
+    SRVDesc.Buffer.NumElements = m_NumBones;
+    hr = pd3dDevice->CreateShaderResourceView( m_pPaletteBuffer, &SRVDesc, &m_pPaletteSRV );
+    if( FAILED( hr ) )
+        goto Error;
+    DXUT_SetDebugName( m_pPaletteSRV, "CDXUTSDKMeshSkinner" );
+
+    return S_OK;
+
+Error:
+    Destroy();
+    return hr;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshSkinner::UpdatePalette()
+{
+    for( UINT i = 0; i < m_NumBones; i++ )
+        m_pPalette[i] = XMLoadFloat4x4( ( const XMFLOAT4X4* )m_pMesh->GetMeshInfluenceMatrix( m_iMesh, i ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Skin a range of vertices.  Each vertex blends up to four palette matrices; the blended
+// matrix transforms the position, normal and tangent, every other element is copied.
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshSkinner::SkinVertices( const SDKSKINNING_VERTEX_FORMAT& Format, const XMMATRIX* pPalette,
+                                        UINT NumBones, const BYTE* pSrcVertices, BYTE* pDstVertices,
+                                        UINT FirstVertex, UINT NumVertices )
+{
+    const BYTE* pSrc = pSrcVertices + FirstVertex * Format.Stride;
+    BYTE* pDst = pDstVertices + FirstVertex * Format.Stride;
+    memcpy( pDst, pSrc, NumVertices * Format.Stride );
+
+    const UINT MaxBone = NumBones - 1;
+    for( UINT v = 0; v < NumVertices; v++, pSrc += Format.Stride, pDst += Format.Stride )
+    {
+        XMVECTOR vWeights;
+        if( Format.WeightsType == D3DDECLTYPE_UBYTE4N )
+            vWeights = PackedVector::XMLoadUByteN4( ( const PackedVector::XMUBYTEN4* )( pSrc + Format.WeightsOffset ) );
+        else
+            vWeights = XMLoadFloat4( ( const XMFLOAT4* )( pSrc + Format.WeightsOffset ) );
+        const BYTE* pIndices = pSrc + Format.IndicesOffset;
+
+        // Blend the four bone matrices row by row
+        XMMATRIX mSkin;
+        for( UINT b = 0; b < 4; b++ )
+        {
+            XMVECTOR vWeight;
+            switch( b )
+            {
+                case 0: vWeight = XMVectorSplatX( vWeights ); break;
+                case 1: vWeight = XMVectorSplatY( vWeights ); break;
+                case 2: vWeight = XMVectorSplatZ( vWeights ); break;
+                default: vWeight = XMVectorSplatW( vWeights ); break;
+            }
+            const XMMATRIX& mBone = pPalette[ min( ( UINT )pIndices[b], MaxBone ) ];
+            if( b == 0 )
+            {
+                mSkin.r[0] = XMVectorMultiply( vWeight, mBone.r[0] );
+                mSkin.r[1] = XMVectorMultiply( vWeight, mBone.r[1] );
+                mSkin.r[2] = XMVectorMultiply( vWeight, mBone.r[2] );
+                mSkin.r[3] = XMVectorMultiply( vWeight, mBone.r[3] );
+            }
+            else
+            {
+                mSkin.r[0] = XMVectorMultiplyAdd( vWeight, mBone.r[0], mSkin.r[0] );
+                mSkin.r[1] = XMVectorMultiplyAdd( vWeight, mBone.r[1], mSkin.r[1] );
+                mSkin.r[2] = XMVectorMultiplyAdd( vWeight, mBone.r[2], mSkin.r[2] );
+                mSkin.r[3] = XMVectorMultiplyAdd( vWeight, mBone.r[3], mSkin.r[3] );
+            }
+        }
+
+        XMVECTOR vPosition = XMLoadFloat3( ( const XMFLOAT3* )( pSrc + Format.PositionOffset ) );
+        XMStoreFloat3( ( XMFLOAT3* )( pDst + Format.PositionOffset ), XMVector3Transform( vPosition, mSkin ) );
+
+        if( Format.NormalOffset >= 0 )
+        {
+            XMVECTOR vNormal = XMLoadFloat3( ( const XMFLOAT3* )( pSrc + Format.NormalOffset ) );
+            vNormal = XMVector3Normalize( XMVector3TransformNormal( vNormal, mSkin ) );
+            XMStoreFloat3( ( XMFLOAT3* )( pDst + Format.NormalOffset ), vNormal );
+        }
+
+        if( Format.TangentOffset >= 0 )
+        {
+            XMVECTOR vTangent = XMLoadFloat3( ( const XMFLOAT3* )( pSrc + Format.TangentOffset ) );
+            vTangent = XMVector3Normalize( XMVector3TransformNormal( vTangent, mSkin ) );
+            XMStoreFloat3( ( XMFLOAT3* )( pDst + Format.TangentOffset ), vTangent );
+        }
+    }
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshSkinner::SkinAllVertices( BYTE* pDstVertices, bool bParallel )
+{
+    if( !bParallel || m_NumVertices <= SKINNING_BATCH_SIZE )
+    {
+        SkinVertices( m_Format, m_pPalette, m_NumBones, m_pSrcVertices, pDstVertices, 0, m_NumVertices );
+        return;
+    }
+
+    UINT NumBatches = ( m_NumVertices + SKINNING_BATCH_SIZE - 1 ) / SKINNING_BATCH_SIZE;
+    concurrency::parallel_for( 0u, NumBatches, [&]( UINT iBatch )
+    {
+        UINT FirstVertex = iBatch * SKINNING_BATCH_SIZE;
+        UINT NumVertices = min( ( UINT )SKINNING_BATCH_SIZE, m_NumVertices - FirstVertex );
+        SkinVertices( m_Format, m_pPalette, m_NumBones, m_pSrcVertices, pDstVertices, FirstVertex, NumVertices );
+    } );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshSkinner::SkinCPU( ID3D11DeviceContext* pd3dImmediateContext )
+{
+    HRESULT hr;
+
+    D3D11_MAPPED_SUBRESOURCE MappedResource;
+    V_RETURN( pd3dImmediateContext->Map( m_pSkinnedVB, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) );
+
+    LARGE_INTEGER Start, End;
+    QueryPerformanceCounter( &Start );
+    SkinAllVertices( ( BYTE* )MappedResource.pData, true );
+    QueryPerformanceCounter( &End );
+
+    pd3dImmediateContext->Unmap( m_pSkinnedVB, 0 );
+
+    UINT NumThreads = m_NumVertices > SKINNING_BATCH_SIZE ? GetNumCores() : 1;
+    FillStats( m_NumVertices, NumThreads, GetSeconds( Start, End ), &m_LastCPUStats );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// The palette is stored transposed, matching the matrices in the constant buffers
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshSkinner::UpdateGPUPalette( ID3D11DeviceContext* pd3dImmediateContext )
+{
+    HRESULT hr;
+
+    D3D11_MAPPED_SUBRESOURCE MappedResource;
+    V_RETURN( pd3dImmediateContext->Map( m_pPaletteBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &MappedResource ) );
+
+    XMFLOAT4X4* pBones = ( XMFLOAT4X4* )MappedResource.pData;
+    for( UINT i = 0; i < m_NumBones; i++ )
+        XMStoreFloat4x4( &pBones[i], XMMatrixTranspose( m_pPalette[i] ) );
+
+    pd3dImmediateContext->Unmap( m_pPaletteBuffer, 0 );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+void CDXUTSDKMeshSkinner::SetGPUPalette( ID3D11DeviceContext* pd3dImmediateContext )
+{
+    pd3dImmediateContext->VSSetShaderResources( SDKSKINNING_PALETTE_SLOT, 1, &m_pPaletteSRV );
+}
+
+//--------------------------------------------------------------------------------------
+HRESULT CDXUTSDKMeshSkinner::BenchmarkCPU( UINT NumIterations, SDKSKINNING_STATS* pSingleThreaded,
+                                           SDKSKINNING_STATS* pMultiThreaded )
+{
+    if( !m_pSrcVertices || NumIterations == 0 )
+        return E_FAIL;
+
+    BYTE* pScratch = new BYTE[ m_NumVertices * m_Format.Stride ];
+    if( !pScratch )
+        return E_OUTOFMEMORY;
+
+    LARGE_INTEGER Start, End;
+
+    // Warm the caches once before timing
+    SkinAllVertices( pScratch, false );
+
+    if( pSingleThreaded )
+    {
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 0; i < NumIterations; i++ )
+            SkinAllVertices( pScratch, false );
+        QueryPerformanceCounter( &End );
+        FillStats( ( UINT64 )m_NumVertices * NumIterations, 1, GetSeconds( Start, End ), pSingleThreaded );
+    }
+
+    if( pMultiThreaded )
+    {
+        QueryPerformanceCounter( &Start );
+        for( UINT i = 0; i < NumIterations; i++ )
+            SkinAllVertices( pScratch, true );
+        QueryPerformanceCounter( &End );
+        FillStats( ( UINT64 )m_NumVertices * NumIterations, GetNumCores(), GetSeconds( Start, End ), pMultiThreaded );
+    }
+
+    SAFE_DELETE_ARRAY( pScratch );
+    return S_OK;
+}
+
+//--------------------------------------------------------------------------------------
+// The strip is a mesh in memory with the vertex layout of VS_Skinned.  Bone i is frame i
+// of a chain one unit apart along y; a vertex at height y blends the two bones around it.
+//--------------------------------------------------------------------------------------
+static HRESULT CreateBenchmarkStrip( ID3D11Device* pd3dDevice, CDXUTSDKMesh* pMesh, UINT NumVertices, UINT NumBones )
+{
+    const UINT Width = 64;
+    const UINT Height = max( ( NumVertices + Width - 1 ) / Width, 2u );
+    const UINT Stride = 60;
+    const UINT NumIndices = ( Width - 1 ) * ( Height - 1 ) * 6;
+
+    UINT StaticBytes = sizeof( SDKMESH_HEADER ) + sizeof( SDKMESH_VERTEX_BUFFER_HEADER ) +
+                       sizeof( SDKMESH_INDEX_BUFFER_HEADER ) + sizeof( SDKMESH_MESH ) + sizeof( SDKMESH_SUBSET ) +
+                       sizeof( UINT ) + NumBones * sizeof( UINT ) + NumBones * sizeof( SDKMESH_FRAME );
+    UINT DataBytes = StaticBytes + Width * Height * Stride + NumIndices * sizeof( UINT );
+    BYTE* pData = new BYTE[ DataBytes ];
+    if( !pData )
+        return E_OUTOFMEMORY;
+    ZeroMemory( pData, DataBytes );
+
+    SDKMESH_HEADER* pHeader = ( SDKMESH_HEADER* )pData;
+    pHeader->Version = SDKMESH_FILE_VERSION;
+    pHeader->HeaderSize = sizeof( SDKMESH_HEADER );
+    pHeader->NonBufferDataSize = StaticBytes - sizeof( SDKMESH_HEADER );
+    pHeader->BufferDataSize = DataBytes - StaticBytes;
+    pHeader->NumVertexBuffers = 1;
+    pHeader->NumIndexBuffers = 1;
+    pHeader->NumMeshes = 1;
+    pHeader->NumTotalSubsets = 1;
+    pHeader->NumFrames = NumBones;
+    pHeader->NumMaterials = 0;
+    pHeader->VertexStreamHeadersOffset = sizeof( SDKMESH_HEADER );
+    pHeader->IndexStreamHeadersOffset = pHeader->VertexStreamHeadersOffset + sizeof( SDKMESH_VERTEX_BUFFER_HEADER );
+    pHeader->MeshDataOffset = pHeader->IndexStreamHeadersOffset + sizeof( SDKMESH_INDEX_BUFFER_HEADER );
+    pHeader->SubsetDataOffset = pHeader->MeshDataOffset + sizeof( SDKMESH_MESH );
+    UINT64 SubsetIndexOffset = pHeader->SubsetDataOffset + sizeof( SDKMESH_SUBSET );
+    UINT64 FrameInfluenceOffset = SubsetIndexOffset + sizeof( UINT );
+    pHeader->FrameDataOffset = FrameInfluenceOffset + NumBones * sizeof( UINT );
+    pHeader->MaterialDataOffset = StaticBytes;
+
+    SDKMESH_VERTEX_BUFFER_HEADER* pVBHeader = ( SDKMESH_VERTEX_BUFFER_HEADER* )( pData + pHeader->VertexStreamHeadersOffset );
+    pVBHeader->NumVertices = Width * Height;
+    pVBHeader->SizeBytes = pVBHeader->NumVertices * Stride;
+    pVBHeader->StrideBytes = Stride;
+    D3DVERTEXELEMENT9 Decl[] =
+    {
+        { 0, 0,  D3DDECLTYPE_FLOAT3,   D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_POSITION,     0 },
+        { 0, 12, D3DDECLTYPE_FLOAT3,   D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_NORMAL,       0 },
+        { 0, 24, D3DDECLTYPE_FLOAT4,   D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TANGENT,      0 },
+        { 0, 40, D3DDECLTYPE_D3DCOLOR, D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_COLOR,        0 },
+        { 0, 44, D3DDECLTYPE_FLOAT2,   D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_TEXCOORD,     0 },
+        { 0, 52, D3DDECLTYPE_UBYTE4,   D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDINDICES, 0 },
+        { 0, 56, D3DDECLTYPE_UBYTE4N,  D3DDECLMETHOD_DEFAULT, D3DDECLUSAGE_BLENDWEIGHT,  0 },
+        D3DDECL_END()
+    };
+    CopyMemory( pVBHeader->Decl, Decl, sizeof( Decl ) );
+    pVBHeader->DataOffset = StaticBytes;
+
+    SDKMESH_INDEX_BUFFER_HEADER* pIBHeader = ( SDKMESH_INDEX_BUFFER_HEADER* )( pData + pHeader->IndexStreamHeadersOffset );
+    pIBHeader->NumIndices = NumIndices;
+    pIBHeader->SizeBytes = NumIndices * sizeof( UINT );
+    pIBHeader->IndexType = IT_32BIT;
+    pIBHeader->DataOffset = StaticBytes + pVBHeader->SizeBytes;
+
+    SDKMESH_MESH* pMeshData = ( SDKMESH_MESH* )( pData + pHeader->MeshDataOffset );
+    strcpy_s( pMeshData->Name, MAX_MESH_NAME, "strip" );
+    pMeshData->NumVertexBuffers = 1;
+    pMeshData->NumSubsets = 1;
+    pMeshData->NumFrameInfluences = NumBones;
+    pMeshData->SubsetOffset = SubsetIndexOffset;
+    pMeshData->FrameInfluenceOffset = FrameInfluenceOffset;
+
+    SDKMESH_SUBSET* pSubset = ( SDKMESH_SUBSET* )( pData + pHeader->SubsetDataOffset );
+    strcpy_s( pSubset->Name, MAX_SUBSET_NAME, "strip" );
+    pSubset->PrimitiveType = PT_TRIANGLE_LIST;
+    pSubset->IndexCount = NumIndices;
+    pSubset->VertexCount = pVBHeader->NumVertices;
+
+    UINT* pInfluences = ( UINT* )( pData + FrameInfluenceOffset );
+    SDKMESH_FRAME* pFrames = ( SDKMESH_FRAME* )( pData + pHeader->FrameDataOffset );
+    for( UINT i = 0; i < NumBones; i++ )
+    {
+        pInfluences[i] = i;
+        sprintf_s( pFrames[i].Name, MAX_FRAME_NAME, "bone%u", i );
+        pFrames[i].Mesh = i == 0 ? 0 : INVALID_MESH;
+        pFrames[i].ParentFrame = i > 0 ? i - 1 : INVALID_FRAME;
+        pFrames[i].ChildFrame = i + 1 < NumBones ? i + 1 : INVALID_FRAME;
+        pFrames[i].SiblingFrame = INVALID_FRAME;
+        D3DXMatrixTranslation( &pFrames[i].Matrix, 0.0f, i > 0 ? 1.0f : 0.0f, 0.0f );
+        pFrames[i].AnimationDataIndex = INVALID_ANIMATION_DATA;
+    }
+
+    BYTE* pVertex = pData + StaticBytes;
+    for( UINT y = 0; y < Height; y++ )
+    {
+        FLOAT fHeight = ( FLOAT )y / ( Height - 1 ) * ( NumBones - 1 );
+        UINT iBone = min( ( UINT )fHeight, NumBones - 1 );
+        UINT iNext = min( iBone + 1, NumBones - 1 );
+        BYTE Weight = ( BYTE )( ( fHeight - iBone ) * 255.0f + 0.5f );
+
+        for( UINT x = 0; x < Width; x++, pVertex += Stride )
+        {
+            FLOAT* pFloats = ( FLOAT* )pVertex;
+            pFloats[0] = ( FLOAT )x / ( Width - 1 ) - 0.5f;     // Position
+            pFloats[1] = fHeight;
+            pFloats[2] = 0.0f;
+            pFloats[5] = -1.0f;                                 // Normal
+            pFloats[6] = 1.0f;                                  // Tangent
+            pFloats[9] = 1.0f;
+            *( DWORD* )( pVertex + 40 ) = 0xffffffff;
+            pFloats[11] = ( FLOAT )x / ( Width - 1 );           // Texture coordinates
+            pFloats[12] = ( FLOAT )y / ( Height - 1 );
+            pVertex[52] = ( BYTE )iBone;
+            pVertex[53] = ( BYTE )iNext;
+            pVertex[56] = ( BYTE )( 255 - Weight );
+            pVertex[57] = Weight;
+        }
+    }
+
+    UINT* pIndex = ( UINT* )( pData + pIBHeader->DataOffset );
+    for( UINT y = 0; y + 1 < Height; y++ )
+    {
+        for( UINT x = 0; x + 1 < Width; x++, pIndex += 6 )
+        {
+            UINT i = y * Width + x;
+            pIndex[0] = i;
+            pIndex[1] = i + Width;
+            pIndex[2] = i + 1;
+            pIndex[3] = i + 1;
+            pIndex[4] = i + Width;
+            pIndex[5] = i + Width + 1;
+        }
+    }
+
+    // Without a copy of the static data the mesh owns pData from here on
+    return pMesh->Create( pd3dDevice, pData, DataBytes, false, false );
+}
+
+//--------------------------------------------------------------------------------------
+// The bones are bent away from the bind pose, so the palette is not the identity
+//--------------------------------------------------------------------------------------
+HRESULT DXUTBenchmarkSDKMeshSkinning( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext,
+                                      UINT NumVertices, UINT NumBones, UINT NumIterations,
+                                      SDKSKINNING_BENCHMARK* pResult )
+{
+    HRESULT hr;
+
+    if( pd3dDevice == NULL || pd3dImmediateContext == NULL || pResult == NULL || NumVertices == 0 ||
+        NumBones < 2 || NumBones > 256 || NumIterations == 0 )
+        return E_INVALIDARG;
+
+    ZeroMemory( pResult, sizeof( SDKSKINNING_BENCHMARK ) );
+
+    // The skinner reads the mesh, so it is destroyed first
+    CDXUTSDKMesh Mesh;
+    CDXUTSDKMeshSkinner Skinner;
+    V_RETURN( CreateBenchmarkStrip( pd3dDevice, &Mesh, NumVertices, NumBones ) );
+
+    D3DXMATRIX mIdentity;
+    D3DXMatrixIdentity( &mIdentity );
+    Mesh.TransformBindPose( &mIdentity );
+    for( UINT i = 1; i < NumBones; i++ )
+    {
+        D3DXMATRIX mRotation, mTranslation;
+        D3DXMatrixRotationZ( &mRotation, 0.3f * sinf( 0.7f * i ) );
+        D3DXMatrixTranslation( &mTranslation, 0.0f, 1.0f, 0.0f );
+        Mesh.GetFrame( i )->Matrix = mRotation * mTranslation;
+    }
+    Mesh.TransformMesh( &mIdentity, 0.0 );
+
+    V_RETURN( Skinner.Create( pd3dDevice, &Mesh, 0 ) );
+    Skinner.UpdatePalette();
+
+    V_RETURN( Skinner.BenchmarkCPU( NumIterations, &pResult->SingleThreaded, &pResult->MultiThreaded ) );
+
+    LARGE_INTEGER Frequency, Start, End;
+    LONGLONG llUpload = 0;
+    QueryPerformanceFrequency( &Frequency );
+    for( UINT i = 0; i < NumIterations; i++ )
+    {
+        QueryPerformanceCounter( &Start );
+        V_RETURN( Skinner.SkinCPU( pd3dImmediateContext ) );
+        QueryPerformanceCounter( &End );
+        llUpload += End.QuadPart - Start.QuadPart;
+    }
+    FillStats( ( UINT64 )Skinner.GetNumVertices() * NumIterations, Skinner.GetLastCPUStats().NumThreads,
+               ( double )llUpload / ( double )Frequency.QuadPart, &pResult->Upload );
+
+    QueryPerformanceCounter( &Start );
+    for( UINT i = 0; i < NumIterations; i++ )
+    {
+        V_RETURN( Skinner.UpdateGPUPalette( pd3dImmediateContext ) );
+        Skinner.SetGPUPalette( pd3dImmediateContext );
+    }
+    QueryPerformanceCounter( &End );
+
+    ID3D11ShaderResourceView* pNullSRV = NULL;
+    pd3dImmediateContext->VSSetShaderResources( SDKSKINNING_PALETTE_SLOT, 1, &pNullSRV );
+
+    pResult->NumVertices = Skinner.GetNumVertices();
+    pResult->NumBones = NumBones;
+    pResult->NumIterations = NumIterations;
+    pResult->fPaletteSeconds = GetSeconds( Start, End ) / NumIterations;
+
+    return S_OK;
+}
@@ -0,0 +1,125 @@
+//--------------------------------------------------------------------------------------
+// File: SDKSkinning.h
+//
+// Skinning for CDXUTSDKMesh meshes.  The bone palette of a mesh is built from its frame
+// influence matrices (see CDXUTSDKMesh::TransformMesh) and is consumed either by
+//   - the CPU path: vertices are skinned on all cores with DirectXMath and written to a
+//     dynamic vertex buffer that has the layout of the source vertex buffer, or
+//   - the GPU path: the palette is uploaded to a structured buffer that is read by the
+//     first pass vertex shader (VS_Skinned in shader\src\VS\DeferredRenderBump.hlsl).
+//--------------------------------------------------------------------------------------
+#pragma once
+#ifndef _SDKSKINNING_
+#define _SDKSKINNING_
+
+#include <DirectXMath.h>
+
+// Register of the bone palette in VS_Skinned
+#define SDKSKINNING_PALETTE_SLOT 8
+
+//--------------------------------------------------------------------------------------
+// Structures
+//--------------------------------------------------------------------------------------
+
+// Byte offsets of the vertex elements used by skinning, -1 if absent
+struct SDKSKINNING_VERTEX_FORMAT
+{
+    UINT Stride;
+    INT  PositionOffset;            // FLOAT3
+    INT  NormalOffset;              // FLOAT3
+    INT  TangentOffset;             // FLOAT3 or FLOAT4 (w is the bitangent sign and left untouched)
+    INT  WeightsOffset;
+    INT  IndicesOffset;             // UBYTE4
+    BYTE WeightsType;               // D3DDECLTYPE_UBYTE4N or D3DDECLTYPE_FLOAT4
+};
+
+struct SDKSKINNING_STATS
+{
+    UINT64 NumVertices;
+    UINT   NumThreads;
+    double fSeconds;
+    double fVerticesPerSecond;
+    double fVerticesPerSecondPerCore;
+};
+
+//--------------------------------------------------------------------------------------
+// CDXUTSDKMeshSkinner class.  Skins one mesh of a CDXUTSDKMesh; the mesh must outlive it
+//--------------------------------------------------------------------------------------
+class CDXUTSDKMeshSkinner
+{
+public:
+                                    CDXUTSDKMeshSkinner();
+                                    ~CDXUTSDKMeshSkinner();
+
+    // Skins vertex buffer 0 of pMesh's mesh iMesh
+    HRESULT                         Create( ID3D11Device* pd3dDevice, CDXUTSDKMesh* pMesh, UINT iMesh );
+    void                            Destroy();
+
+    // Copy the mesh influence matrices into the palette; call after CDXUTSDKMesh::TransformMesh
+    void                            UpdatePalette();
+
+    // CPU path: skin into the dynamic vertex buffer returned by GetSkinnedVB
+    HRESULT                         SkinCPU( ID3D11DeviceContext* pd3dImmediateContext );
+
+    // GPU path: upload the palette and bind it to the vertex shader
+    HRESULT                         UpdateGPUPalette( ID3D11DeviceContext* pd3dImmediateContext );
+    void                            SetGPUPalette( ID3D11DeviceContext* pd3dImmediateContext );
+
+    // Skin NumIterations times into a scratch buffer, once on a single thread and once on
+    // all cores; CPU skinning throughput without the cost of the vertex buffer upload
+    HRESULT                         BenchmarkCPU( UINT NumIterations, SDKSKINNING_STATS* pSingleThreaded,
+                                                  SDKSKINNING_STATS* pMultiThreaded );
+
+    ID3D11Buffer*                   GetSkinnedVB() { return m_pSkinnedVB; }
+    ID3D11ShaderResourceView*       GetPaletteSRV() { return m_pPaletteSRV; }
+    UINT                            GetNumBones() const { return m_NumBones; }
+    UINT                            GetNumVertices() const { return m_NumVertices; }
+    const SDKSKINNING_VERTEX_FORMAT& GetVertexFormat() const { return m_Format; }
+    const SDKSKINNING_STATS&        GetLastCPUStats() const { return m_LastCPUStats; }
+
+    static HRESULT                  GetVertexFormat( const SDKMESH_VERTEX_BUFFER_HEADER* pVBHeader,
+                                                     SDKSKINNING_VERTEX_FORMAT* pFormat );
+    static void                     SkinVertices( const SDKSKINNING_VERTEX_FORMAT& Format,
+                                                  const DirectX::XMMATRIX* pPalette, UINT NumBones,
+                                                  const BYTE* pSrcVertices, BYTE* pDstVertices,
+                                                  UINT FirstVertex, UINT NumVertices );
+
+protected:
+    void                            SkinAllVertices( BYTE* pDstVertices, bool bParallel );
+
+    CDXUTSDKMesh* m_pMesh;
+    UINT m_iMesh;
+    SDKSKINNING_VERTEX_FORMAT m_Format;
+    const BYTE* m_pSrcVertices;
+    UINT m_NumVertices;
+    UINT m_NumBones;
+
+    DirectX::XMMATRIX* m_pPalette;              // 16 byte aligned, row vectors like D3DXMATRIX
+    ID3D11Buffer* m_pSkinnedVB;
+    ID3D11Buffer* m_pPaletteBuffer;
+    ID3D11ShaderResourceView* m_pPaletteSRV;
+
+    SDKSKINNING_STATS m_LastCPUStats;
+};
+
+//--------------------------------------------------------------------------------------
+// Benchmark
+//--------------------------------------------------------------------------------------
+struct SDKSKINNING_BENCHMARK
+{
+    UINT   NumVertices;
+    UINT   NumBones;
+    UINT   NumIterations;
+    SDKSKINNING_STATS SingleThreaded;   // BenchmarkCPU, into a scratch buffer
+    SDKSKINNING_STATS MultiThreaded;
+    SDKSKINNING_STATS Upload;           // SkinCPU, into the mapped dynamic vertex buffer
+    double fPaletteSeconds;             // GPU path: UpdateGPUPalette and SetGPUPalette, per update
+};
+
+// Skins a synthetic strip of NumVertices vertices, bent by a chain of NumBones bones (at
+// most 256) with two bones per vertex, NumIterations times on each path
+HRESULT DXUTBenchmarkSDKMeshSkinning( ID3D11Device* pd3dDevice, ID3D11DeviceContext* pd3dImmediateContext,
+                                      UINT NumVertices, UINT NumBones, UINT NumIterations,
+                                      SDKSKINNING_BENCHMARK* pResult );
+
+#endif
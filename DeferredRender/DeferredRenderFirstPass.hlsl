@@ -1,14 +1,33 @@
 #include "shader\\inc\\shader_include.hlsl"
 
+//--------------------------------------------------------------------------------------
+// External defines, the axes of the G-buffer variants in Main.cpp
+//--------------------------------------------------------------------------------------
+#ifndef NORMAL_MAPPING
+#define NORMAL_MAPPING 1        // Normals from normalTexture, else the interpolated normal
+#endif
+#ifndef LIGHTING_ONLY
+#define LIGHTING_ONLY 0         // White albedo, to look at the lighting alone
+#endif
+#ifndef RELAXED_CONE_STEP_MAPPING
+#define RELAXED_CONE_STEP_MAPPING 0 // Parallax of the normalTexture heights, searched through coneStepTexture
+#endif
+#define CONE_STEPS 12           // CONE_STEP_MAP_CONE_STEPS
+#define BINARY_SEARCH_STEPS 6   // CONE_STEP_MAP_BINARY_STEPS
+
 cbuffer cbCustom : register( b1 )
 {
 	float4 textureScale; 
+	float4 parallaxScale;       // x: depth of the height field in texture coordinates
 }
 
 #include "shader\\src\\vs\\DeferredRenderBump.hlsl"
 
 Texture2D colorTexture : register( t0 );
 Texture2D normalTexture : register( t1 );
+#if RELAXED_CONE_STEP_MAPPING==1
+Texture2D coneStepTexture : register( t2 );     // Depth and square root of the cone ratio, from ConeStepMap.cpp
+#endif
 SamplerState linearSampler : register( s0 );
 
 #include "shader\\src\\ps\\DeferredRenderBump.hlsl"
\ No newline at end of file
@@ -2,10 +2,21 @@
 
 #include "shader\\src\\vs\\FullScreenQuad.hlsl"
 
-Texture2D positionTexture : register( t0 );
+#define SHADOW_ATLAS_FACES 6     // SHADOW_ATLAS_FACES in ShadowAtlas.h
+
+cbuffer cbPointShadow : register( b1 )
+{
+	matrix g_mPointShadow[SHADOW_ATLAS_FACES];      // View space to atlas uv and depth, per face: +x, -x, +y, -y, +z, -z
+	float4 g_vPointShadowTile[SHADOW_ATLAS_FACES];  // Atlas uv of the face's tile, min and max, half a texel inside
+	float4 g_vPointShadowParams;                    // Normal offset per unit of distance to the light, depth bias; 1 if shadowed
+};
+
+Texture2D depthTexture : register( t0 );
 Texture2D normalTexture : register( t1 );
 Texture2D colorTexture : register( t2 );
+Texture2DArray pointShadowAtlas : register( t3 );
 
 SamplerState linearSampler : register( s0 );
+SamplerComparisonState shadowSampler : register( s1 );
 
 #include "shader\\src\\ps\\Lambert.hlsl"
\ No newline at end of file
@@ -0,0 +1,163 @@
+#include "DXUT.h"
+#include "strsafe.h"
+#include "DepthBuffer.h"
+#include <math.h>
+
+using namespace DirectX;
+
+namespace
+{
+	const double D24_MAX = 16777215.0;
+
+	// What the rasterizer writes: clip z over w, in float
+	float ProjectDepth(const XMFLOAT4X4& projection, float z)
+	{
+		return (z * projection._33 + projection._43) / z;
+	}
+
+	double ViewDepth(const XMFLOAT4X4& projection, double depth)
+	{
+		return (double)projection._43 / (depth - (double)projection._33);
+	}
+
+	// The depth the buffer holds for depth, and the next one towards the far plane (the
+	// one before it at the far plane itself)
+	void StoreDepth(DepthMode mode, float depth, double* stored, double* next)
+	{
+		if (mode == DEPTH_MODE_STANDARD)
+		{
+			double q = floor(min(max(depth, 0.0f), 1.0f) * D24_MAX + 0.5);
+			*stored = q / D24_MAX;
+			*next = (q < D24_MAX ? q + 1.0 : q - 1.0) / D24_MAX;
+		}
+		else
+		{
+			*stored = depth;
+			*next = nextafterf(depth, 0.0f);
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------
+DXGI_FORMAT GetDepthBufferFormat(DepthMode mode)
+{
+	return mode == DEPTH_MODE_REVERSED_Z ? DXGI_FORMAT_D32_FLOAT_S8X24_UINT : DXGI_FORMAT_D24_UNORM_S8_UINT;
+}
+
+float GetDepthClearValue(DepthMode mode)
+{
+	return mode == DEPTH_MODE_REVERSED_Z ? 0.0f : 1.0f;
+}
+
+D3D11_COMPARISON_FUNC GetDepthComparison(D3D11_COMPARISON_FUNC standard, DepthMode mode)
+{
+	if (mode != DEPTH_MODE_REVERSED_Z)
+		return standard;
+
+	switch (standard)
+	{
+	case D3D11_COMPARISON_LESS:             return D3D11_COMPARISON_GREATER;
+	case D3D11_COMPARISON_LESS_EQUAL:       return D3D11_COMPARISON_GREATER_EQUAL;
+	case D3D11_COMPARISON_GREATER:          return D3D11_COMPARISON_LESS;
+	case D3D11_COMPARISON_GREATER_EQUAL:    return D3D11_COMPARISON_LESS_EQUAL;
+	default:                                return standard;
+	}
+}
+
+XMMATRIX GetDepthProjection(float fovY, float aspect, float zNear, float zFar, DepthMode mode)
+{
+	if (mode != DEPTH_MODE_REVERSED_Z)
+		return XMMatrixPerspectiveFovLH(fovY, aspect, zNear, zFar);
+
+	// Clip z is the constant zNear, so depth = zNear / z: 1 at the near plane, 0 at infinity
+	float yScale = 1.0f / tanf(fovY * 0.5f);
+	return XMMatrixSet(
+		yScale / aspect, 0.0f, 0.0f, 0.0f,
+		0.0f, yScale, 0.0f, 0.0f,
+		0.0f, 0.0f, 0.0f, 1.0f,
+		0.0f, 0.0f, zNear, 0.0f);
+}
+
+//---------------------------------------------------------------------------------
+// Every sample goes the way of a pixel: projected in float, stored in the buffer's
+// format and turned back into view space z like the lighting pass does.  The
+// resolution is the gap to the next value the buffer can hold, the smallest distance
+// between two surfaces that still sort.
+//---------------------------------------------------------------------------------
+DepthPrecisionReport AnalyzeDepthPrecision(DepthMode mode, float zNear, float zFar, UINT samplesPerDecade)
+{
+	DepthPrecisionReport report;
+	report.mode = mode;
+	report.worstRelativeResolution = 0.0;
+	report.worstRelativeError = 0.0;
+
+	XMFLOAT4X4 projection;
+	XMStoreFloat4x4(&projection, GetDepthProjection(XM_PIDIV4, 1.0f, zNear, zFar, mode));
+
+	samplesPerDecade = max(samplesPerDecade, 1u);
+	UINT count = (UINT)ceil(log10((double)zFar / zNear) * samplesPerDecade - 1e-6) + 1;
+	for (UINT i = 0; i < count; ++i)
+	{
+		DepthPrecisionSample sample;
+		sample.distance = min((float)(zNear * pow(10.0, (double)i / samplesPerDecade)), zFar);
+
+		double stored, next;
+		StoreDepth(mode, ProjectDepth(projection, sample.distance), &stored, &next);
+		double z = ViewDepth(projection, stored);
+		sample.resolution = fabs(ViewDepth(projection, next) - z);
+		sample.roundTripError = fabs(z - sample.distance);
+
+		report.worstRelativeResolution = max(report.worstRelativeResolution, sample.resolution / sample.distance);
+		report.worstRelativeError = max(report.worstRelativeError, sample.roundTripError / sample.distance);
+		report.samples.push_back(sample);
+	}
+	return report;
+}
+
+HRESULT TestDepthPrecision(float zNear, float zFar)
+{
+	DepthPrecisionReport standard = AnalyzeDepthPrecision(DEPTH_MODE_STANDARD, zNear, zFar, 1);
+	DepthPrecisionReport reversed = AnalyzeDepthPrecision(DEPTH_MODE_REVERSED_Z, zNear, zFar, 1);
+
+	WCHAR szMsg[256];
+	StringCchPrintf(szMsg, 256, L"Depth precision, near %g, far %g: resolution (round trip error) with D24 | reversed-Z D32F\n",
+		zNear, zFar);
+	OutputDebugString(szMsg);
+	for (size_t i = 0; i < standard.samples.size(); ++i)
+	{
+		const DepthPrecisionSample& a = standard.samples[i];
+		const DepthPrecisionSample& b = reversed.samples[i];
+		StringCchPrintf(szMsg, 256, L"  z %9g: %10.3g (%9.3g) | %10.3g (%9.3g)\n", a.distance,
+			a.resolution, a.roundTripError, b.resolution, b.roundTripError);
+		OutputDebugString(szMsg);
+	}
+	StringCchPrintf(szMsg, 256, L"  Worst relative resolution %.3g | %.3g, worst relative error %.3g | %.3g\n",
+		standard.worstRelativeResolution, reversed.worstRelativeResolution, standard.worstRelativeError, reversed.worstRelativeError);
+	OutputDebugString(szMsg);
+
+	HRESULT hr = S_OK;
+	for (size_t i = 0; i < standard.samples.size(); ++i)
+	{
+		if (standard.samples[i].resolution > 0.0 && reversed.samples[i].resolution > 0.0)
+			continue;
+		StringCchPrintf(szMsg, 256, L"  FAILED: no depth step at z %g\n", standard.samples[i].distance);
+		OutputDebugString(szMsg);
+		hr = E_FAIL;
+	}
+	if (reversed.worstRelativeResolution > DEPTH_PRECISION_MAX_REVERSED_RELATIVE ||
+		reversed.worstRelativeError > DEPTH_PRECISION_MAX_REVERSED_RELATIVE)
+	{
+		StringCchPrintf(szMsg, 256, L"  FAILED: reversed-Z relative resolution %.3g, error %.3g, expected at most %.3g\n",
+			reversed.worstRelativeResolution, reversed.worstRelativeError, DEPTH_PRECISION_MAX_REVERSED_RELATIVE);
+		OutputDebugString(szMsg);
+		hr = E_FAIL;
+	}
+	if (standard.worstRelativeResolution < DEPTH_PRECISION_MIN_GAIN * reversed.worstRelativeResolution)
+	{
+		StringCchPrintf(szMsg, 256, L"  FAILED: reversed-Z is only %.3gx finer than D24, expected %gx\n",
+			standard.worstRelativeResolution / reversed.worstRelativeResolution, DEPTH_PRECISION_MIN_GAIN);
+		OutputDebugString(szMsg);
+		hr = E_FAIL;
+	}
+	return hr;
+}
@@ -0,0 +1,61 @@
+//--------------------------------------------------------------------------------------
+// File: DepthBuffer.h
+//
+// The two depth pipelines of the renderer.  The standard one maps near..far to 0..1 into
+// a D24 buffer, which spends almost all its precision next to the near plane: with a
+// 0.1 near plane, depth 0.99 is reached at 10 units.  Reversed-Z maps the near plane to
+// 1 and an infinitely far plane to 0 into a float buffer.  The float's exponent follows
+// the 1/z falloff of the projected depth, so the relative resolution is nearly constant
+// from the near plane out.  The comparisons and the clear value flip with the mode;
+// AnalyzeDepthPrecision measures both pipelines on the CPU.
+//--------------------------------------------------------------------------------------
+#ifndef DEPTH_BUFFER_H
+#define DEPTH_BUFFER_H
+
+#include <vector>
+#include <DirectXMath.h>
+
+enum DepthMode
+{
+	DEPTH_MODE_STANDARD,                // D24_UNORM_S8_UINT, near at 0, far at 1, LESS
+	DEPTH_MODE_REVERSED_Z,              // D32_FLOAT_S8X24_UINT, near at 1, infinity at 0, GREATER
+	DEPTH_MODE_COUNT
+};
+
+DXGI_FORMAT GetDepthBufferFormat(DepthMode mode);
+float GetDepthClearValue(DepthMode mode);
+
+// The comparison of the mode for a standard one: LESS becomes GREATER and so on
+D3D11_COMPARISON_FUNC GetDepthComparison(D3D11_COMPARISON_FUNC standard, DepthMode mode);
+
+// Left handed perspective projection, zFar is ignored by reversed-Z, which has none.
+// View space z is _43 / (depth - _33) with either matrix.
+DirectX::XMMATRIX GetDepthProjection(float fovY, float aspect, float zNear, float zFar, DepthMode mode);
+
+struct DepthPrecisionSample
+{
+	float distance;                     // View space z
+	double resolution;                  // Distance to the neighbouring depth value the buffer holds
+	double roundTripError;              // Of z through the float projection, the buffer and back
+};
+
+struct DepthPrecisionReport
+{
+	DepthMode mode;
+	std::vector<DepthPrecisionSample> samples;
+	double worstRelativeResolution;     // Largest resolution / distance over the samples
+	double worstRelativeError;          // Largest round trip error / distance
+};
+
+// Samples distances from zNear to zFar, samplesPerDecade to each power of 10
+DepthPrecisionReport AnalyzeDepthPrecision(DepthMode mode, float zNear, float zFar, UINT samplesPerDecade);
+
+// Analyzes both modes and writes the tables to the debug output.  Fails if a depth step
+// doesn't separate two distances, if reversed-Z resolves or returns a distance worse than
+// DEPTH_PRECISION_MAX_REVERSED_RELATIVE of it, or if it isn't DEPTH_PRECISION_MIN_GAIN
+// times finer than D24 at the worst distance.
+#define DEPTH_PRECISION_MAX_REVERSED_RELATIVE (2.0 / (1 << 23))    // Two float ulps
+#define DEPTH_PRECISION_MIN_GAIN 1000.0
+HRESULT TestDepthPrecision(float zNear, float zFar);
+
+#endif
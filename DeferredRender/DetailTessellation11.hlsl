@@ -14,6 +14,7 @@
 //#define DENSITY_BASED_TESSELLATION 0
 //#define DISTANCE_ADAPTIVE_TESSELLATION 0
 //#define SCREEN_SPACE_ADAPTIVE_TESSELLATION 0
+//#define PRECOMPUTED_TESSELLATION_FACTORS 0    // Factors computed and patches culled by PatchTessellator
 
 //--------------------------------------------------------------------------------------
 // Internal defines
@@ -30,6 +31,7 @@ Texture2D g_DensityTexture : register( t2 );      // Height map density (only us
 // Buffer
 //--------------------------------------------------------------------------------------
 Buffer<float4> g_DensityBuffer : register( t0 );  // Density vertex buffer
+Buffer<float4> g_PatchTessellationFactors : register( t3 );  // Edges and inside factor per visible patch
 
 //--------------------------------------------------------------------------------------
 // Structures
@@ -282,7 +284,13 @@ HS_CONSTANT_DATA_OUTPUT ConstantsHS( InputPatch<VS_OUTPUT_HS_INPUT, 3> p, uint P
     HS_CONSTANT_DATA_OUTPUT output  = (HS_CONSTANT_DATA_OUTPUT)0;
     float4 vEdgeTessellationFactors = g_vTessellationFactor.xxxy;
     
-#if DISTANCE_ADAPTIVE_TESSELLATION==1
+#if PRECOMPUTED_TESSELLATION_FACTORS==1
+
+    // The index buffer only holds the visible patches, in the order of the factors buffer.
+    // Distance, screen space, density and culling are already applied.
+    vEdgeTessellationFactors = g_PatchTessellationFactors.Load( PatchID );
+    
+#elif DISTANCE_ADAPTIVE_TESSELLATION==1
 
     // Calculate edge scale factor from vertex scale factor: simply compute 
     // average tess factor between the two vertices making up an edge
@@ -312,7 +320,7 @@ HS_CONSTANT_DATA_OUTPUT ConstantsHS( InputPatch<VS_OUTPUT_HS_INPUT, 3> p, uint P
     
 #endif
 
-#if DENSITY_BASED_TESSELLATION==1
+#if DENSITY_BASED_TESSELLATION==1 && PRECOMPUTED_TESSELLATION_FACTORS!=1
 
     // Retrieve edge density from edge density buffer (swizzle required to match vertex ordering)
     vEdgeTessellationFactors *= g_DensityBuffer.Load( PatchID ).yzxw;
@@ -325,7 +333,7 @@ HS_CONSTANT_DATA_OUTPUT ConstantsHS( InputPatch<VS_OUTPUT_HS_INPUT, 3> p, uint P
     output.Edges[2] = vEdgeTessellationFactors.z;
     output.Inside   = vEdgeTessellationFactors.w;
     
-#if FRUSTUM_CULLING_OPTIMIZATION==1
+#if FRUSTUM_CULLING_OPTIMIZATION==1 && PRECOMPUTED_TESSELLATION_FACTORS!=1
     // View frustum culling
     bool bViewFrustumCull = ViewFrustumCull( p[0].vWorldPos, p[1].vWorldPos, p[2].vWorldPos, g_vFrustumPlaneEquation,
                                              g_vDetailTessellationHeightScale.x );
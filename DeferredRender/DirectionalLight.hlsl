@@ -0,0 +1,23 @@
+#include "shader\\inc\\shader_include.hlsl"
+
+#include "shader\\src\\vs\\FullScreenQuad.hlsl"
+
+#define SHADOW_MAX_CASCADES 4   // SHADOW_MAX_CASCADES in ShadowCascades.h
+
+cbuffer cbShadow : register( b1 )
+{
+	matrix g_mShadow[SHADOW_MAX_CASCADES];      // View space to shadow map uv and depth, per cascade
+	float4 g_vCascade[SHADOW_MAX_CASCADES];     // View space z where the cascade ends, normal offset, depth bias
+	float4 g_vLightDirection;                   // View space, towards the light; cascade count
+	float4 g_vLightColor;                       // Color; 1/shadow map resolution
+};
+
+Texture2D depthTexture : register( t0 );
+Texture2D normalTexture : register( t1 );
+Texture2D colorTexture : register( t2 );
+Texture2DArray shadowMap : register( t3 );
+
+SamplerState linearSampler : register( s0 );
+SamplerComparisonState shadowSampler : register( s1 );
+
+#include "shader\\src\\ps\\DirectionalLight.hlsl"
@@ -0,0 +1,152 @@
+#include "DXUT.h"
+#include "DynamicResolution.h"
+
+//---------------------------------------------------------------------------------
+DynamicResolutionSettings DynamicResolutionSettings::Default()
+{
+	DynamicResolutionSettings settings;
+	settings.targetMilliseconds = 12.0f;
+	settings.minScale = 0.5f;
+	settings.maxScale = 1.0f;
+	settings.kp = 0.5f;
+	settings.ki = 0.15f;
+	settings.kd = 0.05f;
+	settings.deadband = 0.05f;
+	settings.maxIncrease = 0.04f;
+	settings.maxDecrease = 0.2f;
+	settings.scaleStep = 0.025f;
+	return settings;
+}
+
+DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings)
+	: settings(settings)
+{
+	Reset();
+}
+
+void DynamicResolutionController::Reset()
+{
+	area = settings.maxScale * settings.maxScale;
+	scale = settings.maxScale;
+	previousError[0] = previousError[1] = 0.0f;
+	filteredMilliseconds = 0.0f;
+	frames = 0;
+}
+
+//---------------------------------------------------------------------------------
+// Velocity form: the PID output is the relative change of the area, so the
+// integral is the area itself and cannot wind up past the clamps.  Growing is
+// limited harder than shrinking, a missed frame costs more than a soft one.
+//---------------------------------------------------------------------------------
+float DynamicResolutionController::Update(float milliseconds)
+{
+	if (!(milliseconds > 0.0f))
+		return scale;
+
+	// One slow frame should not drop the resolution on its own
+	filteredMilliseconds = frames == 0 ? milliseconds : filteredMilliseconds + 0.25f * (milliseconds - filteredMilliseconds);
+	frames++;
+
+	float error = (settings.targetMilliseconds - filteredMilliseconds) / settings.targetMilliseconds;
+	if (fabsf(error) < settings.deadband)
+		error = 0.0f;
+
+	float delta = settings.ki * error
+		+ settings.kp * (error - previousError[0])
+		+ settings.kd * (error - 2.0f * previousError[0] + previousError[1]);
+	previousError[1] = previousError[0];
+	previousError[0] = error;
+
+	delta = min(max(delta, -settings.maxDecrease), settings.maxIncrease);
+	area = min(max(area * (1.0f + delta), settings.minScale * settings.minScale), settings.maxScale * settings.maxScale);
+
+	scale = floorf(sqrtf(area) / settings.scaleStep + 0.5f) * settings.scaleStep;
+	scale = min(max(scale, settings.minScale), settings.maxScale);
+	return scale;
+}
+
+//---------------------------------------------------------------------------------
+GpuTimer::GpuTimer() : current(0), measuring(false)
+{
+	for (unsigned i = 0; i < GPU_TIMER_LATENCY; ++i)
+		frames[i].issued = false;
+}
+
+HRESULT GpuTimer::Create(ID3D11Device* device)
+{
+	HRESULT hr;
+
+	CD3D11_QUERY_DESC disjointDesc(D3D11_QUERY_TIMESTAMP_DISJOINT);
+	CD3D11_QUERY_DESC timestampDesc(D3D11_QUERY_TIMESTAMP);
+	for (unsigned i = 0; i < GPU_TIMER_LATENCY; ++i)
+	{
+		V_RETURN(device->CreateQuery(&disjointDesc, frames[i].disjoint.ReleaseAndGetAddressOf()));
+		V_RETURN(device->CreateQuery(&timestampDesc, frames[i].begin.ReleaseAndGetAddressOf()));
+		V_RETURN(device->CreateQuery(&timestampDesc, frames[i].end.ReleaseAndGetAddressOf()));
+		frames[i].issued = false;
+	}
+	current = 0;
+	measuring = false;
+	return S_OK;
+}
+
+void GpuTimer::Destroy()
+{
+	for (unsigned i = 0; i < GPU_TIMER_LATENCY; ++i)
+	{
+		frames[i].disjoint.Reset();
+		frames[i].begin.Reset();
+		frames[i].end.Reset();
+		frames[i].issued = false;
+	}
+	measuring = false;
+}
+
+//---------------------------------------------------------------------------------
+// Issuing the queries again before Read got their data would drop that data, and a
+// GPU that is always more than GPU_TIMER_LATENCY frames behind would never be
+// measured.  Such a frame is skipped and the pending queries are kept.
+//---------------------------------------------------------------------------------
+void GpuTimer::Begin(ID3D11DeviceContext* context)
+{
+	Frame& frame = frames[current];
+	measuring = frame.disjoint && !frame.issued;
+	if (!measuring)
+		return;
+	context->Begin(frame.disjoint.Get());
+	context->End(frame.begin.Get());
+}
+
+void GpuTimer::End(ID3D11DeviceContext* context)
+{
+	Frame& frame = frames[current];
+	if (!measuring)
+		return;
+	measuring = false;
+	context->End(frame.end.Get());
+	context->End(frame.disjoint.Get());
+	frame.issued = true;
+	current = (current + 1) % GPU_TIMER_LATENCY;
+}
+
+//---------------------------------------------------------------------------------
+// Reads the queries that the next Begin reuses, without flushing
+//---------------------------------------------------------------------------------
+float GpuTimer::Read(ID3D11DeviceContext* context)
+{
+	Frame& frame = frames[current];
+	if (!frame.issued)
+		return -1.0f;
+
+	D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint;
+	UINT64 begin, end;
+	if (context->GetData(frame.disjoint.Get(), &disjoint, sizeof(disjoint), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		context->GetData(frame.begin.Get(), &begin, sizeof(begin), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK ||
+		context->GetData(frame.end.Get(), &end, sizeof(end), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK)
+		return -1.0f;
+
+	frame.issued = false;
+	if (disjoint.Disjoint || disjoint.Frequency == 0)
+		return -1.0f;
+	return (float)((double)(end - begin) * 1000.0 / (double)disjoint.Frequency);
+}
@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------------------
+// File: DynamicResolution.h
+//
+// Picks the render scale of the G-buffer and lighting passes from their measured GPU
+// time.  The controller works on the rendered area (scale squared), which the GPU time
+// of these passes is roughly proportional to, with an incremental PID on the relative
+// error from the budget.  It reads no clocks: the same frame time trace always gives
+// the same scales.
+//
+// GpuTimer measures the passes with timestamp queries, a few frames late.
+//--------------------------------------------------------------------------------------
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include <wrl.h>
+
+#define GPU_TIMER_LATENCY 4             // Frames in flight before a query is read back
+
+struct DynamicResolutionSettings
+{
+	float targetMilliseconds;           // Budget of the scaled passes
+	float minScale;
+	float maxScale;
+	float kp, ki, kd;                   // Gains on the relative error (target - time) / target
+	float deadband;                     // Relative errors below this are ignored
+	float maxIncrease;                  // Largest relative area change per frame, up
+	float maxDecrease;                  // and down
+	float scaleStep;                    // Scales are rounded to multiples of this
+
+	static DynamicResolutionSettings Default();
+};
+
+class DynamicResolutionController
+{
+public:
+	explicit DynamicResolutionController(const DynamicResolutionSettings& settings = DynamicResolutionSettings::Default());
+
+	// Feeds the time of one frame and returns the scale to render the next frame at
+	float Update(float milliseconds);
+	// Back to maxScale with no history, e.g. when the device or the budget changes
+	void Reset();
+
+	float GetScale() const { return scale; }
+	float GetFilteredMilliseconds() const { return filteredMilliseconds; }
+	const DynamicResolutionSettings& GetSettings() const { return settings; }
+	void SetSettings(const DynamicResolutionSettings& settings) { this->settings = settings; Reset(); }
+
+private:
+	DynamicResolutionSettings settings;
+	float area;                         // Unrounded scale squared
+	float scale;
+	float previousError[2];             // e(k-1), e(k-2)
+	float filteredMilliseconds;
+	unsigned frames;
+};
+
+//--------------------------------------------------------------------------------------
+// Time between Begin and End on the GPU.  Read returns the time of the frame issued
+// GPU_TIMER_LATENCY frames earlier, or a negative value while it is not known.  If the
+// GPU is further behind, the frames whose queries are still pending are not measured.
+//--------------------------------------------------------------------------------------
+class GpuTimer
+{
+public:
+	GpuTimer();
+
+	HRESULT Create(ID3D11Device* device);
+	void Destroy();
+
+	void Begin(ID3D11DeviceContext* context);
+	void End(ID3D11DeviceContext* context);
+	float Read(ID3D11DeviceContext* context);
+
+private:
+	struct Frame
+	{
+		Microsoft::WRL::ComPtr<ID3D11Query> disjoint;
+		Microsoft::WRL::ComPtr<ID3D11Query> begin;
+		Microsoft::WRL::ComPtr<ID3D11Query> end;
+		bool issued;
+	};
+
+	Frame frames[GPU_TIMER_LATENCY];
+	unsigned current;
+	bool measuring;                     // Between a Begin that issued its queries and End
+};
+
+#endif
@@ -18,6 +18,8 @@
 #include "Grid_Creation11.h"
 #include <wrl.h>
 #include "ConstantBuffer.h"
+#include "ShaderReload.h"
+#include "ShaderBindings.h"
 #include <map>
 #include <algorithm>
 
@@ -46,19 +48,13 @@ HRESULT CreateShaderFromFile(ID3D11Device* pd3dDevice, LPCWSTR pSrcFile, CONST D
 	ID3DX11ThreadPump* pPump, ID3D11DeviceChild** ppShader, ID3DBlob** ppShaderBlob,
 	BOOL bDumpShader);
 
-template<class T> inline ID3D11Buffer** constantBuffersToArray(DirectX::ConstantBuffer<T> &cb){
-	static ID3D11Buffer* cbs[10];
-	cbs[0] = cb.GetBuffer();
-	return cbs;
-};
-
 struct EffectShaderFileDef{
 	WCHAR * name;
 	WCHAR * entry_point;
 	WCHAR * profile;
 };
 
-class HlslEffect : public DirectX::IEffect
+class HlslEffect : public DirectX::IEffect, public IShaderReloadTarget, public IShaderBindingSource
 {
 protected:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> vs;
@@ -73,15 +69,23 @@ protected:
 
 	Microsoft::WRL::ComPtr<ID3D11PixelShader>  ps;
 
+	ShaderBindingLayout bindings;
+
+	ShaderReloadService* reload;
+
+	UINT reloadId;
+
 public:
 	//Constructor
-	HlslEffect(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef){
+	HlslEffect(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef, ShaderReloadService* reload) : reload(reload), reloadId(0){
 		std::map<const WCHAR*, ID3D11DeviceChild*> shaders;
+		std::vector<ShaderStageSource> sources;
 
-		std::for_each(fileDef.begin(), fileDef.end(), [this, device, &shaders](std::pair<const WCHAR*, EffectShaderFileDef> p) {
+		std::for_each(fileDef.begin(), fileDef.end(), [this, device, &shaders, &sources](std::pair<const WCHAR*, EffectShaderFileDef> p) {
 			std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
 
 			ID3D11DeviceChild* pShader;
+			Microsoft::WRL::ComPtr<ID3DBlob> blob;
 
 			if (FAILED(CreateShaderFromFile(
 				device,
@@ -94,12 +98,21 @@ public:
 				0,
 				NULL,
 				&pShader,
-				(std::wstring(p.first) == std::wstring(L"VS") ? this->blob_vs.ReleaseAndGetAddressOf() : NULL),
+				blob.GetAddressOf(),
 				false
 			)))
 			   throw std::exception("HlslEffect");
 
+			if (std::wstring(p.first) == std::wstring(L"VS"))
+				this->blob_vs = blob;
+
+			if (FAILED(this->bindings.SetStage(p.first, blob.Get())))
+				throw std::exception("HlslEffect");
+
 			shaders.insert(std::pair<const WCHAR*, ID3D11DeviceChild*>(p.first, pShader));
+
+			ShaderStageSource source = { p.first, p.second.name, converter.to_bytes(p.second.entry_point), converter.to_bytes(p.second.profile) };
+			sources.push_back(source);
 		});
 
 		vs.Attach((ID3D11VertexShader*)shaders[L"VS"]);
@@ -107,11 +120,51 @@ public:
 		ds.Attach((ID3D11DomainShader*)shaders[L"DS"]);
 		gs.Attach((ID3D11GeometryShader*)shaders[L"GS"]);
 		ps.Attach((ID3D11PixelShader*)shaders[L"PS"]);
+
+		if (reload)
+			reloadId = reload->Register(this, sources, blob_vs.Get());
+	}
+
+	//Constructor, from the bytecode of each stage
+	HlslEffect(ID3D11Device* device, const std::vector<ShaderStageSource>& sources, const std::vector<Microsoft::WRL::ComPtr<ID3DBlob> >& bytecode, ShaderReloadService* reload) : reload(reload), reloadId(0){
+		std::vector<ReloadedShader> shaders(sources.size());
+
+		for (size_t i = 0; i < sources.size(); ++i){
+			shaders[i].stage = sources[i].stage;
+			shaders[i].blob = bytecode[i];
+
+			if (FAILED(CreateShaderFromBytecode(device, sources[i].profile, bytecode[i].Get(), shaders[i].shader.GetAddressOf())))
+				throw std::exception("HlslEffect");
+		}
+
+		ReplaceShaders(shaders);
+
+		if (reload)
+			reloadId = reload->Register(this, sources, blob_vs.Get());
 	}
 
 	//Destructor
 	virtual ~HlslEffect(){
+		if (reload)
+			reload->Unregister(reloadId);
+	}
 
+	//IShaderReloadTarget
+	virtual void __cdecl ReplaceShaders(const std::vector<ReloadedShader>& shaders) {
+		std::for_each(shaders.begin(), shaders.end(), [this](const ReloadedShader& s) {
+			if (s.stage == L"VS") { s.shader.As(&vs); blob_vs = s.blob; }
+			else if (s.stage == L"HS") s.shader.As(&hs);
+			else if (s.stage == L"DS") s.shader.As(&ds);
+			else if (s.stage == L"GS") s.shader.As(&gs);
+			else if (s.stage == L"PS") s.shader.As(&ps);
+
+			bindings.SetStage(s.stage, s.blob.Get());
+		});
+	}
+
+	//IShaderBindingSource
+	virtual const ShaderBindingLayout& __cdecl GetBindingLayout() const {
+		return bindings;
 	}
 
 	//IEffect
@@ -129,6 +182,10 @@ public:
 	}
 };
 
-std::unique_ptr<DirectX::IEffect> createHlslEffect(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef){
-	return std::unique_ptr<DirectX::IEffect>(new HlslEffect(device, fileDef));
+std::unique_ptr<DirectX::IEffect> createHlslEffect(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef, ShaderReloadService* reload){
+	return std::unique_ptr<DirectX::IEffect>(new HlslEffect(device, fileDef, reload));
+}
+
+std::unique_ptr<DirectX::IEffect> createHlslEffectFromBytecode(ID3D11Device* device, const std::vector<ShaderStageSource>& sources, const std::vector<Microsoft::WRL::ComPtr<ID3DBlob> >& bytecode, ShaderReloadService* reload){
+	return std::unique_ptr<DirectX::IEffect>(new HlslEffect(device, sources, bytecode, reload));
 }
\ No newline at end of file
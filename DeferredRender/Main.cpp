@@ -23,10 +23,26 @@
 #include "DXUTsettingsDlg.h"
 #include "SDKmisc.h"
 #include "SDKMesh.h"
+#include "SDKAnimation.h"
+#include "SDKSkinning.h"
 
 #include "strsafe.h"
 #include "resource.h"
 #include "Grid_Creation11.h"
+#include "Meshlets.h"
+#include "RenderTargetPool.h"
+#include "DynamicResolution.h"
+#include "Terrain.h"
+#include "ConeStepMap.h"
+#include "ShaderReload.h"
+#include "ShaderPermutations.h"
+#include "ShaderBindings.h"
+#include "DepthBuffer.h"
+#include "SoftwareOcclusion.h"
+#include "PatchTessellation.h"
+#include "ShadowCascades.h"
+#include "ShadowMap.h"
+#include "ShadowAtlas.h"
 #include <wrl.h>
 #include "PlatformHelpers.h"
 #include "ConstantBuffer.h"
@@ -60,6 +76,7 @@ public:
 struct cbCustom
 {
 	D3DXVECTOR4     textureScale;
+	D3DXVECTOR4     parallaxScale;  // x: depth of the height field, read by RELAXED_CONE_STEP_MAPPING
 };
 
 struct EffectShaderFileDef{
@@ -72,18 +89,23 @@ struct EffectShaderFileDef{
 // Structures
 //--------------------------------------------------------------------------------------
 DirectX::XMFLOAT3 decal_box_size = XMFLOAT3(1, 2, 2);
-std::unique_ptr<DirectX::IEffect> createHlslEffect(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef);
-std::unique_ptr<IPostProcess> createPostProcess(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef);
+std::unique_ptr<DirectX::IEffect> createHlslEffect(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef, ShaderReloadService* reload = nullptr);
+std::unique_ptr<IPostProcess> createPostProcess(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef, ShaderReloadService* reload = nullptr);
 DirectX::XMFLOAT3 stone_box_size = XMFLOAT3(10, 10, 3);
 
 std::unique_ptr<DirectX::ModelMeshPart> decal_box;
 std::unique_ptr<DirectX::ModelMeshPart> stone_box;
 std::unique_ptr<DirectX::ModelMeshPart> teapot;
 
+std::vector<Meshlet> teapot_meshlets;
+std::vector<MeshletIndexRange> teapot_visible_ranges;
+MeshletBuildStats teapot_meshlet_build_stats;
+MeshletCullStats teapot_meshlet_cull_stats;
+
 std::unique_ptr<GeometricPrimitive> light;
 
-std::unique_ptr<DirectX::IEffect> effect, effectTBN, effectLight;
-std::unique_ptr<IPostProcess> postProcess, ambientPostProcess;
+std::unique_ptr<DirectX::IEffect> effectTBN, effectLight, terrainEffect, shadowEffect;
+std::unique_ptr<IPostProcess> postProcess, ambientPostProcess, upsamplePostProcess, directionalLightPostProcess, pointShadowClearPostProcess;
 
 std::unique_ptr<CommonStates> states;
 
@@ -91,28 +113,151 @@ Microsoft::WRL::ComPtr<ID3D11InputLayout> box_inputLayout;
 Microsoft::WRL::ComPtr<ID3D11InputLayout> teapot_inputLayout;
 Microsoft::WRL::ComPtr<ID3D11InputLayout> teapot_tbn_inputLayout;
 Microsoft::WRL::ComPtr<ID3D11InputLayout> light_inputLayout;
-
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv1;
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv2;
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv3;
-
-Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv1;
-Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv2;
-Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv3;
-
-Microsoft::WRL::ComPtr<ID3D11DepthStencilView> ds_v;
-Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> ds_srv;
+Microsoft::WRL::ComPtr<ID3D11InputLayout> terrain_inputLayout;
+Microsoft::WRL::ComPtr<ID3D11InputLayout> shadow_inputLayout;
+
+// G-buffer, depth and light buffer; they outlive swap chain resizes and are rendered in the
+// top-left frame_targets.GetViewport() of an allocation rounded up by the pool
+enum FrameTarget { FRAME_TARGET_NORMAL, FRAME_TARGET_COLOR, FRAME_TARGET_DEPTH, FRAME_TARGET_LIGHT };
+RenderTargetPool render_target_pool;
+RenderTargetSet frame_targets;
+
+// Dynamic resolution (D key): the G-buffer and lighting passes render at the scale the
+// controller picks from their GPU time, and the light buffer is stretched over the back buffer
+DynamicResolutionController resolution_controller;
+GpuTimer scene_gpu_timer;
+bool dynamic_resolution_enabled = true;
+float scene_gpu_milliseconds = 0.0f;
+
+// Quadtree terrain under the scene (T key); B times its node selection along a flight over it
+#define TERRAIN_SIZE 2049
+#define TERRAIN_BENCHMARK_FRAMES 1000
+Terrain terrain;
+TerrainSelectionStats terrain_selection_stats;
+bool terrain_enabled = false;
+
+// C builds (or loads from the cache) the relaxed cone step maps of the POM textures and
+// compares the two searches of POM.hlsl on them.  F draws the stone box with one of them,
+// in the RELAXED_CONE_STEP_MAPPING G-buffer variant.
+#define CONE_STEP_STONE_BOX_TEXTURE 1       // Stones, of DetailTessellationTextures
+#define CONE_STEP_HEIGHT_SCALE 0.1f
+#define CONE_STEP_MIN_SAMPLES 8
+#define CONE_STEP_MAX_SAMPLES 50
+#define CONE_STEP_BENCHMARK_RAYS 20000
+
+// Effects and post processes recompile when their HLSL or one of its includes is saved
+ShaderReloadService shader_reload;
+
+// The G-buffer pass is compiled per mode instead of branching on it.  N toggles normal
+// mapping, V the lighting only debug view; -prebuildshaders fills the shader cache with
+// every variant and quits.  Only the stone box has a cone step map, so its draw adds
+// GBUFFER_CONE_STEP_MAPPING when F turned it on.
+enum GBufferPermutation { GBUFFER_NORMAL_MAPPING = 1, GBUFFER_LIGHTING_ONLY = 2, GBUFFER_CONE_STEP_MAPPING = 4 };
+ShaderPermutations gbuffer_permutations;
+UINT gbuffer_permutation = GBUFFER_NORMAL_MAPPING;
+bool cone_step_mapping_enabled = false;
+bool prebuild_shaders = false;
+
+// -selftest runs the checks that need no device instead of the sample, and exits with 1
+// if any of them failed.  The results go to the debug output.
+bool run_self_tests = false;
+
+// What the draws bind, by the names in the HLSL.  Checked against the reflected shaders
+// when the device is created.
+ShaderBindingTable gbuffer_bindings, terrain_bindings, light_bindings, lighting_bindings, upsample_bindings;
+ShaderBindingTable shadow_bindings, directional_light_bindings;
+
+// Reversed-Z (Z key) puts the near plane at depth 1 and the far plane at infinity, in a
+// float depth buffer; the lighting pass reads the view space position back from it.  P
+// writes the precision of both modes over the camera's range to the debug output.
+#define CAMERA_FOV (D3DX_PI/3)
+#define CAMERA_NEAR 0.1f
+#define CAMERA_FAR 100000.0f
+DepthMode depth_mode = DEPTH_MODE_REVERSED_Z;
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> depth_default_state[DEPTH_MODE_COUNT];
+
+// Occlusion culling (O key): the room and the decal box are rasterized on the CPU each
+// frame and the teapot is skipped while its bounds are hidden behind them.  M benchmarks
+// the rasterizer and the box tests, and the CPU patch culling and tessellation factors
+// of the detail tessellation grid.
+#define OCCLUSION_BENCHMARK_FRAMES 100
+#define PATCH_TESSELLATION_BENCHMARK_GRID 255       // Quads per side, the most 16 bit indices allow
+#define PATCH_TESSELLATION_BENCHMARK_FRAMES 100
+SoftwareOcclusion software_occlusion;
+OcclusionMesh stone_box_occluder;
+OcclusionMesh decal_box_occluder;
+DirectX::XMFLOAT3 teapot_bounds_min, teapot_bounds_max;
+bool occlusion_culling_enabled = true;
+bool teapot_occluded = false;
+
+// Cascaded shadow maps of g_LightControl's directional light.  The decal box and the
+// teapot cast, the room only receives.  K cycles the cascade count, J the resolution and
+// U benchmarks the cascade fitting and culling.
+#define SHADOW_BENCHMARK_CASTERS 10000
+#define SHADOW_BENCHMARK_FRAMES 1000
+enum ShadowCasterId { SHADOW_CASTER_DECAL_BOX, SHADOW_CASTER_TEAPOT, SHADOW_CASTER_COUNT };
+ShadowCascades shadow_cascades;
+ShadowMap shadow_map;
+std::vector<ShadowCaster> shadow_casters(SHADOW_CASTER_COUNT);
+size_t teapot_index_count = 0;          // The whole teapot, its G-buffer draws are the visible clusters
+
+// Shadows of the point light: its cube faces are tiles of a depth atlas, sized by how
+// much of the screen the light covers and kept while the light and the casters over
+// them stay put.  L replays the recorded atlas scenes.
+#define SHADOW_ATLAS_REPLAY_FRAMES 120
+#define POINT_LIGHT_RANGE 2.25f                 // Where Lambert.hlsl cuts the light off
+#define POINT_SHADOW_NORMAL_OFFSET 1.5f         // Atlas texels
+#define POINT_SHADOW_DEPTH_BIAS 0.0005f         // Face clip space depth
+const DirectX::XMFLOAT3 point_light_position( 2.0f, 3.0f, 0.5f );   // World space, as Lambert.hlsl
+ShadowAtlas point_shadow_atlas;
+ShadowMap point_shadow_map;             // A single slice, the atlas
+std::vector<PointShadowLight> point_shadow_lights( 1 );
+
+// X times loading a large synthetic .sdkmesh from the heap and mapped, without a device
+#define SDKMESH_BENCHMARK_VERTICES ( 4 * 1024 * 1024 )
+#define SDKMESH_BENCHMARK_LOADS 4
+
+// I times queuing and flushing the UI batch of a frame
+#define UI_BENCHMARK_QUADS 2000
+#define UI_BENCHMARK_FRAMES 1000
+
+// G times mouse moves over a dialog with the linear control search and the hit grid
+#define HITTEST_BENCHMARK_CONTROLS 1000
+#define HITTEST_BENCHMARK_MOVES 100000
+
+// Y times animating skeletons of 50 to 5000 frames, 1 to 1000 instances of each
+const UINT sdkmesh_benchmark_skeleton_frames[] = { 50, 500, 5000 };
+const UINT sdkmesh_benchmark_instances[] = { 1, 10, 100, 1000 };
+#define SDKMESH_BENCHMARK_FRAME_TRANSFORMS 5000000        // Per measurement, split into iterations
+
+// Y then compresses the animation of a 500 frame skeleton, which -selftest checks against
+// the tolerances.  The slack covers the quantization and the float error of the angle.
+#define ANIMATION_COMPRESSION_FRAMES 500
+#define ANIMATION_COMPRESSION_KEYS 120
+#define ANIMATION_TRANSLATION_TOLERANCE 0.001f
+#define ANIMATION_ORIENTATION_TOLERANCE 0.01f             // Radians
+#define ANIMATION_SCALING_TOLERANCE 0.001f
+#define ANIMATION_COMPRESSION_SLACK 0.002f
+
+// Y last skins a strip of 64K vertices on 64 bones on one core, on all of them and into
+// the vertex buffer, and uploads the palette of the GPU path
+#define SKINNING_BENCHMARK_VERTICES 65536
+#define SKINNING_BENCHMARK_BONES 64
+#define SKINNING_BENCHMARK_ITERATIONS 200
 
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> decal_srv;
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> decal_nm_srv;
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> stone_srv;
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> stone_nm_srv;
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> stone_pom_srv;
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> stone_pom_nmh_srv;
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> stone_cone_srv;
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> teapot_srv;
 Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> teapot_nm_srv;
 
 DirectX::ConstantBuffer<cbCustom> *scene_state_cb;
 
-Microsoft::WRL::ComPtr<ID3D11DepthStencilState> light_depth_stencil_first_pass_state;
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> light_depth_stencil_first_pass_state[DEPTH_MODE_COUNT];
 Microsoft::WRL::ComPtr<ID3D11DepthStencilState> light_depth_stencil_second_pass_state;
 Microsoft::WRL::ComPtr<ID3D11DepthStencilState> light_depth_stencil_ambient_pass_state;
 struct SceneState
@@ -135,10 +280,30 @@ struct SceneState
 	DirectX::XMFLOAT4    vDebugColorAdd;                 // Debug colors
 
 	DirectX::XMFLOAT4    vFrustumPlaneEquation[4];       // View frustum plane equations
+
+	DirectX::XMFLOAT4    vGBufferUVScale;                // Viewport size / G-buffer allocation size, largest UV inside the viewport
 };
 SceneState main_scene_state;
 DirectX::ConstantBuffer<SceneState> *main_scene_state_cb;
 
+struct ShadowState
+{
+	DirectX::XMFLOAT4X4    mShadow[SHADOW_MAX_CASCADES];   // View space to shadow map uv and depth, per cascade
+	DirectX::XMFLOAT4      vCascade[SHADOW_MAX_CASCADES];  // View space z where the cascade ends, normal offset, depth bias
+	DirectX::XMFLOAT4      vLightDirection;                // View space, towards the light; cascade count
+	DirectX::XMFLOAT4      vLightColor;                    // Color; 1/shadow map resolution
+};
+DirectX::ConstantBuffer<ShadowState> *shadow_state_cb;
+
+struct PointShadowState
+{
+	DirectX::XMFLOAT4X4    mPointShadow[SHADOW_ATLAS_FACES];     // View space to atlas uv and depth, per face
+	DirectX::XMFLOAT4      vPointShadowTile[SHADOW_ATLAS_FACES]; // Atlas uv of the face's tile, min and max, half a texel inside
+	DirectX::XMFLOAT4      vPointShadowParams;                   // Normal offset per unit of distance to the light, depth bias; 1 if shadowed
+};
+DirectX::ConstantBuffer<PointShadowState> *point_shadow_state_cb;
+Microsoft::WRL::ComPtr<ID3D11DepthStencilState> point_shadow_clear_state;
+
 struct MATERIAL_CB_STRUCT
 {
     D3DXVECTOR4     g_materialAmbientColor;  // Material's ambient color
@@ -280,6 +445,15 @@ float                               g_fDesiredTriangleSize = 10.0f;
 // Frame buffer readback ( 0 means never dump to disk (frame counter starts at 1) )
 DWORD                               g_dwFrameNumberToDump = 0; 
 
+// Scripted resize storm (R key): the window is resized every frame along a drag-like path and
+// the render target allocations are logged at the end
+#define RESIZE_STORM_FRAMES 300
+int                                 g_nResizeStormFrame = -1;
+RECT                                g_rcResizeStormWindow;
+UINT                                g_nSwapChainResizes = 0;
+size_t                              g_nUnpooledTargetAllocations = 0;    // Targets that recreating the set on every resize would have created
+size_t                              g_nResizeStormFirstReallocation = 0;
+
 //--------------------------------------------------------------------------------------
 // UI control IDs
 //--------------------------------------------------------------------------------------
@@ -332,6 +506,19 @@ void ExtractPlanesFromFrustum( D3DXVECTOR4* pPlaneEquation, const D3DXMATRIX* pM
 
 void InitApp();
 void RenderText();
+void StepResizeStorm();
+void CompareConeStepMaps();
+bool ReportAnimationCompression();
+bool RunSelfTests();
+DirectX::XMMATRIX GetTerrainWorldMatrix();
+DirectX::XMMATRIX GetDecalBoxWorldMatrix();
+DirectX::XMMATRIX GetStoneBoxWorldMatrix();
+DirectX::XMMATRIX GetTeapotWorldMatrix();
+void RenderOcclusion();
+void RenderShadowMaps( ID3D11DeviceContext* pd3dImmediateContext );
+void RenderPointShadows( ID3D11DeviceContext* pd3dImmediateContext );
+TerrainView GetTerrainView();
+void SetSceneProjection();
 bool IsNextArg( WCHAR*& strCmdLine, WCHAR* strArg );
 bool GetCmdParam( WCHAR*& strCmdLine, WCHAR* strFlag );
 void CreateDensityMapFromHeightMap( ID3D11Device* pd3dDevice, ID3D11DeviceContext *pDeviceContext, ID3D11Texture2D* pHeightMap, 
@@ -402,7 +589,11 @@ int WINAPI wWinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPWSTR lpCmdL
     DXUTSetCallbackKeyboard( OnKeyboard );
 
     InitApp();
+    if( run_self_tests )
+        return RunSelfTests() ? 0 : 1;
     DXUTInit( true, true );
+    // Index the media tree once so that texture lookups don't probe the file system
+    DXUTBuildMediaManifest( L"Media" );
     DXUTSetCursorSettings( true, true ); // Show the cursor and clip it when in full screen
     DXUTCreateWindow( L"DeferredRender" );
     DXUTCreateDevice( D3D_FEATURE_LEVEL_11_0, true, 1024, 768);
@@ -439,6 +630,90 @@ void InitApp()
 
     g_HUD.SetCallback( OnGUIEvent );
 
+	CreateOcclusionBox(stone_box_size, stone_box_occluder);
+	CreateOcclusionBox(decal_box_size, decal_box_occluder);
+
+	frame_targets.AddTarget(DXGI_FORMAT_R32G32B32A32_FLOAT, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+	frame_targets.AddTarget(DXGI_FORMAT_R32G32B32A32_FLOAT, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);
+	frame_targets.AddTarget(GetDepthBufferFormat(depth_mode), D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE);
+	frame_targets.AddTarget(DXGI_FORMAT_R8G8B8A8_UNORM, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);   // Back buffer format, set on resize
+
+	gbuffer_permutations.Init(L"GBuffer", {
+		{ L"VS", L"DeferredRenderFirstPass.hlsl", "VS", "vs_5_0" },
+		{ L"PS", L"DeferredRenderFirstPass.hlsl", "PS", "ps_5_0" } },
+		{ "NORMAL_MAPPING", "LIGHTING_ONLY", "RELAXED_CONE_STEP_MAPPING" });
+
+	gbuffer_bindings.Init("G-buffer", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)),
+		ShaderBinding::ConstantBuffer("cbCustom", sizeof(cbCustom)),
+		ShaderBinding::ShaderResource("colorTexture"),
+		ShaderBinding::ShaderResource("normalTexture"),
+		ShaderBinding::ShaderResource("coneStepTexture"),
+		ShaderBinding::Sampler("linearSampler") });
+	terrain_bindings.Init("Terrain", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)),
+		ShaderBinding::ConstantBuffer("cbCustom", sizeof(cbCustom)),
+		ShaderBinding::ShaderResource("colorTexture"),
+		ShaderBinding::Sampler("linearSampler"),
+		ShaderBinding::External("cbTerrain"),           // Bound by Terrain::Draw
+		ShaderBinding::External("heightMap"),
+		ShaderBinding::External("heightSampler") });
+	light_bindings.Init("Light", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)) });
+	lighting_bindings.Init("Lighting", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)),
+		ShaderBinding::ConstantBuffer("cbPointShadow", sizeof(PointShadowState)),
+		ShaderBinding::ShaderResource("depthTexture"),
+		ShaderBinding::ShaderResource("normalTexture"),
+		ShaderBinding::ShaderResource("colorTexture"),
+		ShaderBinding::ShaderResource("pointShadowAtlas"),
+		ShaderBinding::Sampler("linearSampler"),
+		ShaderBinding::Sampler("shadowSampler") });
+	upsample_bindings.Init("Upsample", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)),
+		ShaderBinding::ShaderResource("lightTexture"),
+		ShaderBinding::Sampler("linearSampler") });
+	shadow_bindings.Init("Shadow", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)) });
+	directional_light_bindings.Init("Directional light", {
+		ShaderBinding::ConstantBuffer("cbMain", sizeof(SceneState)),
+		ShaderBinding::ConstantBuffer("cbShadow", sizeof(ShadowState)),
+		ShaderBinding::ShaderResource("depthTexture"),
+		ShaderBinding::ShaderResource("normalTexture"),
+		ShaderBinding::ShaderResource("colorTexture"),
+		ShaderBinding::ShaderResource("shadowMap"),
+		ShaderBinding::Sampler("linearSampler"),
+		ShaderBinding::Sampler("shadowSampler") });
+
+	for (WCHAR* strCmdLine = GetCommandLine(); *strCmdLine; )
+	{
+		if (*strCmdLine == L'-' || *strCmdLine == L'/')
+		{
+			strCmdLine++;
+			if (IsNextArg(strCmdLine, L"prebuildshaders"))
+			{
+				prebuild_shaders = true;
+				continue;
+			}
+			if (IsNextArg(strCmdLine, L"selftest"))
+			{
+				run_self_tests = true;
+				continue;
+			}
+		}
+		strCmdLine++;
+	}
+
+	{
+		std::vector<float> heights;
+		GenerateTerrainHeightMap(TERRAIN_SIZE, 200.0f, 0.55f, 1, heights);
+		TerrainSettings settings = TerrainSettings::Default();
+		settings.sampleSpacing = 2.0f;
+		float extent = (TERRAIN_SIZE - 1) * settings.sampleSpacing;
+		settings.origin = XMFLOAT3(-0.5f * extent, -210.0f, -0.5f * extent);
+		ThrowIfFailed(terrain.Build(heights.data(), TERRAIN_SIZE, settings));
+	}
+
     // Setup the camera's view parameters
     g_Camera.SetRotateButtons( true, false, false );
     g_Camera.SetEnablePositionMovement( true );
@@ -505,6 +780,387 @@ void CALLBACK OnFrameMove( double fTime, float fElapsedTime, void* pUserContext
 	// dynamic_cast<IEffectMatrices*>(effect.get())->SetView(assign(DirectX::XMMATRIX(), *g_Camera.GetViewMatrix()));
 
 	DirectX::XMStoreFloat4x4(&main_scene_state.mView, DirectX::XMMatrixTranspose(DirectX::XMMATRIX(assign(DirectX::XMMATRIX(), *g_Camera.GetViewMatrix()))));
+
+    if( g_nResizeStormFrame >= 0 )
+        StepResizeStorm();
+
+    // Between two frames, so that no draw mixes old and new stages of an effect
+    shader_reload.ApplyPendingReloads();
+}
+
+
+//--------------------------------------------------------------------------------------
+// Resize the window for the next frame of the resize storm, or restore it and log the
+// render target allocations once the storm is over
+//--------------------------------------------------------------------------------------
+void StepResizeStorm()
+{
+    HWND hWnd = DXUTGetHWND();
+    UINT nFlags = SWP_NOMOVE | SWP_NOZORDER | SWP_NOACTIVATE;
+
+    if( g_nResizeStormFrame == RESIZE_STORM_FRAMES || !DXUTIsWindowed() )
+    {
+        if( DXUTIsWindowed() )
+            SetWindowPos( hWnd, NULL, 0, 0, g_rcResizeStormWindow.right - g_rcResizeStormWindow.left,
+                          g_rcResizeStormWindow.bottom - g_rcResizeStormWindow.top, nFlags );
+        g_nResizeStormFrame = -1;
+
+        const RenderTargetPoolStats& stats = render_target_pool.GetStats();
+        WCHAR szMsg[256];
+        StringCchPrintf( szMsg, 256, L"Resize storm: %u swap chain resizes, %Iu render target allocations "
+                         L"(%Iu without pooling), %Iu reused, %Iu evicted, %Iu reallocations\n",
+                         g_nSwapChainResizes, stats.allocations, g_nUnpooledTargetAllocations, stats.reuses,
+                         stats.evictions, frame_targets.GetReallocationCount() - g_nResizeStormFirstReallocation );
+        OutputDebugString( szMsg );
+        return;
+    }
+
+    // Two drags of the width for every drag of the height, with the few pixels of jitter
+    // of a hand on the mouse
+    float t = g_nResizeStormFrame / ( float )RESIZE_STORM_FRAMES;
+    int nWidth = 640 + ( int )( 640.0f * ( 0.5f - 0.5f * cosf( t * 4.0f * D3DX_PI ) ) ) + g_nResizeStormFrame * 7 % 13;
+    int nHeight = 480 + ( int )( 360.0f * ( 0.5f - 0.5f * cosf( t * 2.0f * D3DX_PI ) ) ) + g_nResizeStormFrame * 5 % 11;
+    SetWindowPos( hWnd, NULL, 0, 0, nWidth, nHeight, nFlags );
+
+    g_nResizeStormFrame++;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Cone step maps of the detail tessellation textures, with the CPU reference searches
+//--------------------------------------------------------------------------------------
+void CompareConeStepMaps()
+{
+    ConeStepMapSettings settings = ConeStepMapSettings::Default();
+    for( UINT i = 0; i < NUM_TEXTURES; i++ )
+    {
+        WCHAR szMsg[512];
+        ConeStepMap map;
+        ConeStepMapStats stats;
+        HRESULT hr = LoadOrBuildConeStepMap( DXUTGetD3D11Device(), DXUTGetD3D11DeviceContext(),
+                                             DetailTessellationTextures[i].NormalHeightMap, settings, map, &stats );
+        if( FAILED( hr ) )
+        {
+            StringCchPrintf( szMsg, 512, L"Cone step map of %s failed (0x%08x)\n", DetailTessellationTextures[i].NormalHeightMap, hr );
+            OutputDebugString( szMsg );
+            continue;
+        }
+
+        ParallaxMarchComparison result = CompareParallaxMarching( map, CONE_STEP_HEIGHT_SCALE, CONE_STEP_MIN_SAMPLES,
+                                                                  CONE_STEP_MAX_SAMPLES, CONE_STEP_MAP_CONE_STEPS,
+                                                                  CONE_STEP_MAP_BINARY_STEPS, CONE_STEP_BENCHMARK_RAYS, 1 );
+        StringCchPrintf( szMsg, 512, L"%s: %ux%u cone map %s in %.0f ms, mean ratio %.2f; fetches per ray linear %.1f (max %u), "
+                         L"cone %.1f (max %u); error in texels linear %.2f (max %.1f), cone %.2f (max %.1f)\n",
+                         DetailTessellationTextures[i].DisplayName, map.width, map.height,
+                         stats.fromCache ? L"loaded" : L"built", stats.seconds * 1000.0, stats.averageConeRatio,
+                         result.linearAverageFetches, result.linearMaxFetches, result.coneAverageFetches, result.coneMaxFetches,
+                         result.linearMeanError, result.linearMaxError, result.coneMeanError, result.coneMaxError );
+        OutputDebugString( szMsg );
+    }
+}
+
+
+//--------------------------------------------------------------------------------------
+// Compresses the skeleton animation and logs the sizes and errors.  Fails when the tracks
+// are not smaller than the raw data or a channel is off by more than its tolerance.
+//--------------------------------------------------------------------------------------
+bool ReportAnimationCompression()
+{
+    const SDKANIMATION_COMPRESSION_SETTINGS settings =
+        { ANIMATION_TRANSLATION_TOLERANCE, ANIMATION_ORIENTATION_TOLERANCE, ANIMATION_SCALING_TOLERANCE };
+
+    WCHAR szMsg[512];
+    SDKMESH_COMPRESSION_BENCHMARK result;
+    HRESULT hr = DXUTBenchmarkSDKMeshAnimationCompression( ANIMATION_COMPRESSION_FRAMES, ANIMATION_COMPRESSION_KEYS,
+                                                           &settings, &result );
+    if( FAILED( hr ) )
+    {
+        StringCchPrintf( szMsg, 512, L"Animation compression failed (0x%08x)\n", hr );
+        OutputDebugString( szMsg );
+        return false;
+    }
+
+    const SDKANIMATION_COMPRESSION_REPORT& report = result.Report;
+    StringCchPrintf( szMsg, 512, L"Animation compression: %u frames x %u keys, %.1f KB raw, %.1f KB compressed (%.1fx), "
+                     L"%u of %u keys kept in %.1f ms; max error %.5f translation, %.5f rad orientation, %.5f scaling, "
+                     L"%.5f world position\n",
+                     result.NumFrames, result.NumKeys, report.RawBytes / 1024.0, report.CompressedBytes / 1024.0,
+                     ( double )report.RawBytes / ( double )max( report.CompressedBytes, 1ull ), report.NumKeptKeys,
+                     report.NumRawKeys, result.fCompressSeconds * 1000.0, report.MaxTranslationError,
+                     report.MaxOrientationError, report.MaxScalingError, result.fMaxPositionError );
+    OutputDebugString( szMsg );
+
+    return report.CompressedBytes < report.RawBytes &&
+           report.MaxTranslationError <= settings.MaxTranslationError + ANIMATION_COMPRESSION_SLACK &&
+           report.MaxOrientationError <= settings.MaxOrientationError + ANIMATION_COMPRESSION_SLACK &&
+           report.MaxScalingError <= settings.MaxScalingError + ANIMATION_COMPRESSION_SLACK;
+}
+
+
+//--------------------------------------------------------------------------------------
+// Checks that run without a device (-selftest)
+//--------------------------------------------------------------------------------------
+bool RunSelfTests()
+{
+    struct SelfTest
+    {
+        const WCHAR* name;
+        std::function<bool()> run;
+    };
+    const SelfTest tests[] =
+    {
+        { L"UI batch draw calls", [] { return SUCCEEDED( DXUTTestUIBatch() ); } },
+        { L"Depth precision", [] { return SUCCEEDED( TestDepthPrecision( CAMERA_NEAR, CAMERA_FAR ) ); } },
+        { L"Shadow atlas replays", [] { return SUCCEEDED( TestShadowAtlasReplays( SHADOW_ATLAS_REPLAY_FRAMES ) ); } },
+        { L"Animation compression", [] { return ReportAnimationCompression(); } },
+    };
+
+    bool passed = true;
+    for( const SelfTest& test : tests )
+    {
+        bool testPassed = test.run();
+        WCHAR szMsg[256];
+        StringCchPrintf( szMsg, 256, L"Self test %s: %s\n", test.name, testPassed ? L"passed" : L"FAILED" );
+        OutputDebugString( szMsg );
+        passed = passed && testPassed;
+    }
+    return passed;
+}
+
+
+//--------------------------------------------------------------------------------------
+// The terrain is built with y up, the scene has z up
+//--------------------------------------------------------------------------------------
+DirectX::XMMATRIX GetTerrainWorldMatrix()
+{
+    return DirectX::XMMatrixRotationX( DirectX::XM_PIDIV2 );
+}
+
+DirectX::XMMATRIX GetDecalBoxWorldMatrix()
+{
+    return DirectX::XMMatrixTranslationFromVector( XMLoadFloat3( &XMFLOAT3( 3, 2, 0.5 ) ) + 1 / 2.0 * XMVECTOR( XMLoadFloat3( &decal_box_size ) ) );
+}
+
+DirectX::XMMATRIX GetStoneBoxWorldMatrix()
+{
+    return DirectX::XMMatrixTranslationFromVector( XMLoadFloat3( &XMFLOAT3( -5, -5, 0 ) ) + 1 / 2.0 * XMVECTOR( XMLoadFloat3( &stone_box_size ) ) );
+}
+
+DirectX::XMMATRIX GetTeapotWorldMatrix()
+{
+    return DirectX::XMMatrixRotationY( 1 * 57.2 ) * DirectX::XMMatrixRotationX( 1 * 45.3 ) * DirectX::XMMatrixTranslationFromVector( XMLoadFloat3( &XMFLOAT3( 1.0, 2.3, 1.5 ) ) );
+}
+
+//--------------------------------------------------------------------------------------
+// Rasterizes the occluders from the camera and tests the teapot against them
+//--------------------------------------------------------------------------------------
+void RenderOcclusion()
+{
+    D3DXMATRIX mViewProjection = *g_Camera.GetViewMatrix() * *g_Camera.GetProjMatrix();
+    software_occlusion.BeginFrame( *( const DirectX::XMFLOAT4X4* )&mViewProjection, CAMERA_NEAR );
+
+    DirectX::XMFLOAT4X4 world;
+    DirectX::XMStoreFloat4x4( &world, GetStoneBoxWorldMatrix() );
+    software_occlusion.AddOccluder( &stone_box_occluder, world );
+    DirectX::XMStoreFloat4x4( &world, GetDecalBoxWorldMatrix() );
+    software_occlusion.AddOccluder( &decal_box_occluder, world );
+    software_occlusion.Render();
+
+    DirectX::XMStoreFloat4x4( &world, GetTeapotWorldMatrix() );
+    teapot_occluded = !software_occlusion.TestBox( teapot_bounds_min, teapot_bounds_max, world );
+}
+
+//--------------------------------------------------------------------------------------
+// Fits the cascades to the camera and draws each one's casters into its slice of the
+// shadow map, then fills cbShadow for the directional light pass
+//--------------------------------------------------------------------------------------
+void RenderShadowMaps( ID3D11DeviceContext* pd3dImmediateContext )
+{
+    DirectX::XMMATRIX mWorld[SHADOW_CASTER_COUNT] = { GetDecalBoxWorldMatrix(), GetTeapotWorldMatrix() };
+    DirectX::XMStoreFloat3( &shadow_casters[SHADOW_CASTER_DECAL_BOX].center, mWorld[SHADOW_CASTER_DECAL_BOX].r[3] );
+    shadow_casters[SHADOW_CASTER_DECAL_BOX].radius = 0.5f * DirectX::XMVectorGetX( DirectX::XMVector3Length( DirectX::XMLoadFloat3( &decal_box_size ) ) );
+    DirectX::XMVECTOR vTeapotMin = DirectX::XMLoadFloat3( &teapot_bounds_min );
+    DirectX::XMVECTOR vTeapotMax = DirectX::XMLoadFloat3( &teapot_bounds_max );
+    DirectX::XMStoreFloat3( &shadow_casters[SHADOW_CASTER_TEAPOT].center,
+                            DirectX::XMVector3TransformCoord( 0.5f * ( vTeapotMin + vTeapotMax ), mWorld[SHADOW_CASTER_TEAPOT] ) );
+    shadow_casters[SHADOW_CASTER_TEAPOT].radius = 0.5f * DirectX::XMVectorGetX( DirectX::XMVector3Length( vTeapotMax - vTeapotMin ) );
+
+    const D3DXMATRIX* pProj = g_Camera.GetProjMatrix();
+    D3DXVECTOR3 vLightDirection = g_LightControl.GetLightDirection();
+    shadow_cascades.Update( *( const DirectX::XMFLOAT4X4* )g_Camera.GetViewMatrix(), CAMERA_FOV, pProj->_22 / pProj->_11, CAMERA_NEAR,
+                            *( const DirectX::XMFLOAT3* )&vLightDirection, shadow_casters );
+
+    D3D11_VIEWPORT viewport = shadow_map.GetViewport();
+    pd3dImmediateContext->RSSetViewports( 1, &viewport );
+    for( UINT i = 0; i < shadow_cascades.GetCascadeCount(); ++i )
+    {
+        const ShadowCascade& cascade = shadow_cascades.GetCascade( i );
+        ID3D11DepthStencilView* shadow_dsv = shadow_map.GetDsv( i );
+        pd3dImmediateContext->ClearDepthStencilView( shadow_dsv, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+        pd3dImmediateContext->OMSetRenderTargets( 0, nullptr, shadow_dsv );
+
+        const std::vector<UINT>& drawList = shadow_cascades.GetDrawList( i );
+        for( size_t j = 0; j < drawList.size(); ++j )
+        {
+            DirectX::XMMATRIX wvp = mWorld[drawList[j]] * DirectX::XMLoadFloat4x4( &cascade.viewProjection );
+            DirectX::XMStoreFloat4x4( &main_scene_state.mWorldViewProjection, DirectX::XMMatrixTranspose( wvp ) );
+            main_scene_state_cb->SetData( pd3dImmediateContext, main_scene_state );
+
+            DirectX::ModelMeshPart* part = drawList[j] == SHADOW_CASTER_TEAPOT ? teapot.get() : decal_box.get();
+            part->primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+            if( part == teapot.get() )
+            {
+                teapot->startIndex = 0;
+                teapot->indexCount = ( uint32_t )teapot_index_count;
+            }
+            part->Draw( pd3dImmediateContext, shadowEffect.get(), shadow_inputLayout.Get(), [=]
+            {
+                shadow_bindings.Apply( pd3dImmediateContext, GetShaderBindingLayout( shadowEffect.get() ), { main_scene_state_cb->GetBuffer() } );
+
+                pd3dImmediateContext->OMSetBlendState( states->Opaque(), Colors::Black, 0xFFFFFFFF );
+                pd3dImmediateContext->RSSetState( shadow_map.GetRasterizerState() );
+                pd3dImmediateContext->OMSetDepthStencilState( depth_default_state[DEPTH_MODE_STANDARD].Get(), 0 );
+            } );
+        }
+    }
+    pd3dImmediateContext->OMSetRenderTargets( 0, nullptr, nullptr );
+
+    // From the camera's view space: back to world, into the cascade and onto the texture
+    DirectX::XMMATRIX mInvView = DirectX::XMMatrixInverse( nullptr, assign( DirectX::XMMATRIX(), *g_Camera.GetViewMatrix() ) );
+    DirectX::XMMATRIX mTexture = DirectX::XMMatrixScaling( 0.5f, -0.5f, 1.0f ) * DirectX::XMMatrixTranslation( 0.5f, 0.5f, 0.0f );
+    ShadowState shadow_state;
+    ZeroMemory( &shadow_state, sizeof( shadow_state ) );
+    for( UINT i = 0; i < shadow_cascades.GetCascadeCount(); ++i )
+    {
+        const ShadowCascade& cascade = shadow_cascades.GetCascade( i );
+        DirectX::XMStoreFloat4x4( &shadow_state.mShadow[i], DirectX::XMMatrixTranspose( mInvView * DirectX::XMLoadFloat4x4( &cascade.viewProjection ) * mTexture ) );
+        shadow_state.vCascade[i] = DirectX::XMFLOAT4( cascade.splitFar, cascade.normalOffset, cascade.depthBias, 0.0f );
+    }
+    DirectX::XMVECTOR vLight = DirectX::XMVector3Normalize( DirectX::XMLoadFloat3( ( const DirectX::XMFLOAT3* )&vLightDirection ) );
+    DirectX::XMStoreFloat4( &shadow_state.vLightDirection, DirectX::XMVectorSetW(
+        DirectX::XMVector3TransformNormal( vLight, assign( DirectX::XMMATRIX(), *g_Camera.GetViewMatrix() ) ), ( float )shadow_cascades.GetCascadeCount() ) );
+    shadow_state.vLightColor = DirectX::XMFLOAT4( 1.0f, 0.95f, 0.85f, 1.0f / shadow_map.GetResolution() );
+    shadow_state_cb->SetData( pd3dImmediateContext, shadow_state );
+}
+
+//--------------------------------------------------------------------------------------
+// Gives the point light its atlas tiles by the part of the screen it covers and draws
+// the faces that changed, each into its tile, then fills cbPointShadow for the lighting
+// pass.  The casters are those RenderShadowMaps placed.
+//--------------------------------------------------------------------------------------
+void RenderPointShadows( ID3D11DeviceContext* pd3dImmediateContext )
+{
+    DirectX::XMMATRIX mWorld[SHADOW_CASTER_COUNT] = { GetDecalBoxWorldMatrix(), GetTeapotWorldMatrix() };
+    DirectX::XMMATRIX mView = assign( DirectX::XMMATRIX(), *g_Camera.GetViewMatrix() );
+    DirectX::XMVECTOR vLight = DirectX::XMVector3TransformCoord( DirectX::XMLoadFloat3( &point_light_position ), mView );
+    float z = DirectX::XMVectorGetZ( vLight );
+
+    // Diameter over the screen height: all of it from inside the sphere, none behind
+    PointShadowLight& light = point_shadow_lights[0];
+    light.id = 0;
+    light.position = point_light_position;
+    light.range = POINT_LIGHT_RANGE;
+    if( DirectX::XMVectorGetX( DirectX::XMVector3Length( vLight ) ) <= POINT_LIGHT_RANGE )
+        light.screenCoverage = 1.0f;
+    else if( z <= -POINT_LIGHT_RANGE )
+        light.screenCoverage = 0.0f;
+    else
+        light.screenCoverage = min( POINT_LIGHT_RANGE * g_Camera.GetProjMatrix()->_22 / max( z, POINT_LIGHT_RANGE ), 1.0f );
+
+    point_shadow_atlas.Update( point_shadow_lights, shadow_casters );
+
+    const std::vector<PointShadowFace>& faces = point_shadow_atlas.GetRenderFaces();
+    if( !faces.empty() )
+        pd3dImmediateContext->OMSetRenderTargets( 0, nullptr, point_shadow_map.GetDsv( 0 ) );
+    for( size_t i = 0; i < faces.size(); ++i )
+    {
+        const PointShadowFace& face = faces[i];
+        D3D11_VIEWPORT viewport = { ( float )face.tile.x, ( float )face.tile.y, ( float )face.tile.size, ( float )face.tile.size, 0.0f, 1.0f };
+        pd3dImmediateContext->RSSetViewports( 1, &viewport );
+
+        // The rest of the atlas holds the cached faces, so the tile is cleared by drawing
+        pointShadowClearPostProcess->Process( pd3dImmediateContext, [=]
+        {
+            pd3dImmediateContext->OMSetBlendState( states->Opaque(), Colors::Black, 0xFFFFFFFF );
+            pd3dImmediateContext->RSSetState( states->CullNone() );
+            pd3dImmediateContext->OMSetDepthStencilState( point_shadow_clear_state.Get(), 0 );
+        } );
+
+        for( size_t j = 0; j < face.casters.size(); ++j )
+        {
+            DirectX::XMMATRIX wvp = mWorld[face.casters[j]] * DirectX::XMLoadFloat4x4( &face.viewProjection );
+            DirectX::XMStoreFloat4x4( &main_scene_state.mWorldViewProjection, DirectX::XMMatrixTranspose( wvp ) );
+            main_scene_state_cb->SetData( pd3dImmediateContext, main_scene_state );
+
+            DirectX::ModelMeshPart* part = face.casters[j] == SHADOW_CASTER_TEAPOT ? teapot.get() : decal_box.get();
+            part->primitiveType = D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST;
+            if( part == teapot.get() )
+            {
+                teapot->startIndex = 0;
+                teapot->indexCount = ( uint32_t )teapot_index_count;
+            }
+            part->Draw( pd3dImmediateContext, shadowEffect.get(), shadow_inputLayout.Get(), [=]
+            {
+                shadow_bindings.Apply( pd3dImmediateContext, GetShaderBindingLayout( shadowEffect.get() ), { main_scene_state_cb->GetBuffer() } );
+
+                pd3dImmediateContext->OMSetBlendState( states->Opaque(), Colors::Black, 0xFFFFFFFF );
+                pd3dImmediateContext->RSSetState( point_shadow_map.GetRasterizerState() );
+                pd3dImmediateContext->OMSetDepthStencilState( depth_default_state[DEPTH_MODE_STANDARD].Get(), 0 );
+            } );
+        }
+    }
+    pd3dImmediateContext->OMSetRenderTargets( 0, nullptr, nullptr );
+
+    // From the camera's view space: back to world, into the face and onto its tile
+    PointShadowState point_shadow_state;
+    ZeroMemory( &point_shadow_state, sizeof( point_shadow_state ) );
+    const PointShadowFaces& lightFaces = point_shadow_atlas.GetLightFaces( 0 );
+    if( lightFaces.shadowed )
+    {
+        DirectX::XMMATRIX mInvView = DirectX::XMMatrixInverse( nullptr, mView );
+        DirectX::XMMATRIX mTexture = DirectX::XMMatrixScaling( 0.5f, -0.5f, 1.0f ) * DirectX::XMMatrixTranslation( 0.5f, 0.5f, 0.0f );
+        float atlasSize = ( float )point_shadow_atlas.GetAtlasSize();
+        for( UINT i = 0; i < SHADOW_ATLAS_FACES; ++i )
+        {
+            const ShadowAtlasTile& tile = lightFaces.tiles[i];
+            DirectX::XMMATRIX mTile = DirectX::XMMatrixScaling( tile.size / atlasSize, tile.size / atlasSize, 1.0f ) *
+                                      DirectX::XMMatrixTranslation( tile.x / atlasSize, tile.y / atlasSize, 0.0f );
+            DirectX::XMStoreFloat4x4( &point_shadow_state.mPointShadow[i], DirectX::XMMatrixTranspose(
+                mInvView * DirectX::XMLoadFloat4x4( &lightFaces.viewProjection[i] ) * mTexture * mTile ) );
+            point_shadow_state.vPointShadowTile[i] = DirectX::XMFLOAT4( ( tile.x + 0.5f ) / atlasSize, ( tile.y + 0.5f ) / atlasSize,
+                                                                        ( tile.x + tile.size - 0.5f ) / atlasSize, ( tile.y + tile.size - 0.5f ) / atlasSize );
+        }
+        // The faces are 90 degrees wide: a texel at unit distance is 2 / tile size across
+        point_shadow_state.vPointShadowParams = DirectX::XMFLOAT4( POINT_SHADOW_NORMAL_OFFSET * 2.0f / lightFaces.tiles[0].size,
+                                                                   POINT_SHADOW_DEPTH_BIAS, 1.0f, 0.0f );
+    }
+    point_shadow_state_cb->SetData( pd3dImmediateContext, point_shadow_state );
+}
+
+// The camera in the terrain's space, with the G-buffer height for the pixel error
+TerrainView GetTerrainView()
+{
+    DirectX::XMMATRIX mView, mProj;
+    assign( mView, *g_Camera.GetViewMatrix() );
+    assign( mProj, *g_Camera.GetProjMatrix() );
+    DirectX::XMMATRIX mWorld = GetTerrainWorldMatrix();
+
+    TerrainView view;
+    DirectX::XMStoreFloat3( &view.eye, DirectX::XMVector3TransformCoord( DirectX::XMLoadFloat3( ( const DirectX::XMFLOAT3* )g_Camera.GetEyePt() ),
+                                                                           DirectX::XMMatrixInverse( nullptr, mWorld ) ) );
+    DirectX::XMStoreFloat4x4( &view.viewProjection, mWorld * mView * mProj );
+    view.screenHeight = ( float )frame_targets.GetHeight();
+    view.projectionScale = g_Camera.GetProjMatrix()->_22;
+    return view;
+}
+
+// The projection of the draws for the depth mode.  The camera keeps its finite one, for
+// culling and the terrain.
+void SetSceneProjection()
+{
+    const D3DXMATRIX* pProj = g_Camera.GetProjMatrix();
+    DirectX::XMStoreFloat4x4( &main_scene_state.mProjection, DirectX::XMMatrixTranspose(
+        GetDepthProjection( CAMERA_FOV, pProj->_22 / pProj->_11, CAMERA_NEAR, CAMERA_FAR, depth_mode ) ) );
 }
 
 
@@ -518,6 +1174,87 @@ void RenderText()
     g_pTxtHelper->SetForegroundColor( D3DXCOLOR( 1.0f, 1.0f, 0.0f, 1.0f ) );
     g_pTxtHelper->DrawTextLine( DXUTGetFrameStats( g_bShowFPS && DXUTIsVsyncEnabled() ) );
     g_pTxtHelper->DrawTextLine( DXUTGetDeviceStats() );
+    g_pTxtHelper->DrawFormattedTextLine( L"Teapot clusters: %Iu/%Iu visible in %Iu draws, triangles culled: %Iu frustum, %Iu backface",
+                                         teapot_meshlet_cull_stats.visibleMeshletCount, teapot_meshlet_cull_stats.meshletCount,
+                                         teapot_meshlet_cull_stats.rangeCount, teapot_meshlet_cull_stats.frustumCulledTriangles,
+                                         teapot_meshlet_cull_stats.backfaceCulledTriangles );
+    g_pTxtHelper->DrawFormattedTextLine( L"Teapot cluster build: %Iu triangles in %.3f ms (%.1f ms per million triangles)",
+                                         teapot_meshlet_build_stats.triangleCount, teapot_meshlet_build_stats.seconds * 1000.0,
+                                         teapot_meshlet_build_stats.secondsPerMillionTriangles * 1000.0 );
+    const DXUTTextStats11* pTextStats = DXUTGetTextStats11();
+    const DXUTUIBatchStats& uiStats = g_DialogResourceManager.m_UIBatch11.GetStats();
+    g_pTxtHelper->DrawFormattedTextLine( L"UI: %u quads in %u draws, %u map, %u levels; text: %u/%u strings cached",
+                                         uiStats.nQuads, uiStats.nDraws, uiStats.nMaps, uiStats.nLevels,
+                                         pTextStats->nCacheHits, pTextStats->nCachedStrings );
+    const DXUTGUIRenderStats11& guiStats = g_DialogResourceManager.GetGUIRenderStats11();
+    g_pTxtHelper->DrawFormattedTextLine( L"Dialogs: %u replayed, %u regenerated (%u/%u vertices) in %.3f ms",
+                                         guiStats.nDialogsReplayed, guiStats.nDialogsRegenerated,
+                                         guiStats.nVerticesReplayed, guiStats.nVerticesRegenerated,
+                                         guiStats.fCPUMilliseconds );
+    DXUT_MEDIA_SEARCH_STATS mediaStats;
+    DXUTGetMediaSearchStats( &mediaStats );
+    g_pTxtHelper->DrawFormattedTextLine( L"Media: %u lookups, %u cached, %u from manifest (%u files), %u file system calls",
+                                         mediaStats.nLookups, mediaStats.nCacheHits, mediaStats.nManifestHits,
+                                         mediaStats.nManifestFiles, mediaStats.nFileSystemCalls );
+    const RenderTargetPoolStats& targetStats = render_target_pool.GetStats();
+    g_pTxtHelper->DrawFormattedTextLine( L"Render targets: %ux%u in %ux%u, %Iu allocated, %Iu reused, %.1f MB free",
+                                         frame_targets.GetWidth(), frame_targets.GetHeight(),
+                                         frame_targets.GetAllocatedWidth(), frame_targets.GetAllocatedHeight(),
+                                         targetStats.allocations, targetStats.reuses,
+                                         targetStats.freeBytes / ( 1024.0 * 1024.0 ) );
+    g_pTxtHelper->DrawFormattedTextLine( L"Render scale: %.3f (%ux%u)%s, scene GPU time %.2f ms, budget %.1f ms",
+                                         frame_targets.GetRenderScale(), frame_targets.GetWidth(), frame_targets.GetHeight(),
+                                         dynamic_resolution_enabled ? L"" : L" fixed", scene_gpu_milliseconds,
+                                         resolution_controller.GetSettings().targetMilliseconds );
+    if( terrain_enabled )
+        g_pTxtHelper->DrawFormattedTextLine( L"Terrain: %Iu nodes, %Iu quadrants, %Iu culled; %Iu vertices (%.0fx fewer than the full grid), selection %.3f ms",
+                                             terrain_selection_stats.selectedNodes, terrain_selection_stats.selectedQuadrants,
+                                             terrain_selection_stats.frustumCulledNodes, terrain_selection_stats.vertexCount,
+                                             ( double )TERRAIN_SIZE * TERRAIN_SIZE / max( terrain_selection_stats.vertexCount, ( size_t )1 ),
+                                             terrain_selection_stats.seconds * 1000.0 );
+    const ShaderReloadStats& reloadStats = shader_reload.GetStats();
+    g_pTxtHelper->DrawFormattedTextLine( L"Shaders: %Iu files watched, %Iu reloads, %Iu failed; last %u stages in %.0f ms%s",
+                                         reloadStats.watchedFiles, reloadStats.reloads, reloadStats.failures,
+                                         reloadStats.lastStageCount, reloadStats.lastSeconds * 1000.0,
+                                         reloadStats.lastFailed ? L", old shaders kept" : L"" );
+    const ShaderPermutationStats& permutationStats = gbuffer_permutations.GetStats();
+    g_pTxtHelper->DrawFormattedTextLine( L"G-buffer variant 0x%02x: %u of %u created, %Iu stages compiled, %Iu cached, %Iu failed, %.0f ms",
+                                         gbuffer_permutation, permutationStats.variants, gbuffer_permutations.GetVariantCount(),
+                                         permutationStats.compiledStages, permutationStats.cachedStages,
+                                         permutationStats.failedStages, permutationStats.seconds * 1000.0 );
+    if( occlusion_culling_enabled )
+    {
+        const OcclusionStats& occlusionStats = software_occlusion.GetStats();
+        g_pTxtHelper->DrawFormattedTextLine( L"Occlusion: %Iu of %Iu occluder triangles rasterized in %.3f ms, teapot %s",
+                                             occlusionStats.rasterizedTriangles, occlusionStats.occluderTriangles,
+                                             occlusionStats.rasterSeconds * 1000.0, teapot_occluded ? L"occluded" : L"visible" );
+    }
+    const ShadowStats& shadowStats = shadow_cascades.GetStats();
+    g_pTxtHelper->DrawFormattedTextLine( L"Shadows: %u cascades at %u, %u draws of %u casters, fitted in %.3f ms",
+                                         shadowStats.cascadeCount, shadow_map.GetResolution(), shadowStats.drawCount,
+                                         shadowStats.casterCount, shadowStats.seconds * 1000.0 );
+    const ShadowAtlasStats& atlasStats = point_shadow_atlas.GetStats();
+    g_pTxtHelper->DrawFormattedTextLine( L"Point shadows: %Iu of %Iu lights, %Iu cached, %Iu faces rendered, atlas %.0f%% used, %.3f ms",
+                                         atlasStats.shadowedLights, atlasStats.requestedLights, atlasStats.cachedLights,
+                                         atlasStats.renderedFaces, atlasStats.usedArea * 100.0f, atlasStats.seconds * 1000.0 );
+    g_pTxtHelper->DrawFormattedTextLine( L"Depth: %s, near %g, far %s",
+                                         depth_mode == DEPTH_MODE_REVERSED_Z ? L"reversed-Z D32F" : L"standard D24",
+                                         CAMERA_NEAR, depth_mode == DEPTH_MODE_REVERSED_Z ? L"infinite" : L"100000" );
+    DXUT_FRAME_PACING_STATS pacingStats;
+    DXUTGetFramePacer()->GetStats( &pacingStats );
+    g_pTxtHelper->DrawFormattedTextLine( L"Frame time: %.2f ms mean, %.2f ms std dev, %u missed (limit %.0f FPS)",
+                                         pacingStats.fMeanFrameTime * 1000.0, pacingStats.fFrameTimeStdDev * 1000.0,
+                                         pacingStats.nMissedDeadlines, DXUTGetFramePacer()->GetTargetFPS() );
+    DXUT_FRAME_STATS_SUMMARY frameStats;
+    DXUTFrameStatsGetSummary( &frameStats );
+    g_pTxtHelper->DrawFormattedTextLine( L"CPU ms p50/p95/p99/max: %.2f/%.2f/%.2f/%.2f, present interval: %.2f/%.2f/%.2f/%.2f",
+                                         frameStats.CPUTime.fP50, frameStats.CPUTime.fP95, frameStats.CPUTime.fP99,
+                                         frameStats.CPUTime.fMax, frameStats.PresentInterval.fP50,
+                                         frameStats.PresentInterval.fP95, frameStats.PresentInterval.fP99,
+                                         frameStats.PresentInterval.fMax );
+    for( UINT nPass = 0; nPass < frameStats.nPasses; nPass++ )
+        g_pTxtHelper->DrawFormattedTextLine( L"  %s ms p50/p99: %.2f/%.2f", DXUTFrameStatsGetPassName( nPass ),
+                                             frameStats.PassTime[nPass].fP50, frameStats.PassTime[nPass].fP99 );
     
     g_pTxtHelper->End();
 }
@@ -625,11 +1362,215 @@ void CALLBACK OnKeyboard( UINT nChar, bool bKeyDown, bool bAltDown, void* pUserC
                                     g_vDebugColorAdd.y=0.0;
                                     g_vDebugColorAdd.z=0.0;
                                 }
+                                if( gbuffer_permutations.Get( gbuffer_permutation ^ GBUFFER_LIGHTING_ONLY ) )
+                                    gbuffer_permutation ^= GBUFFER_LIGHTING_ONLY;
+                                break;
+
+            case 'N':           // Normal mapping, switches the G-buffer variant
+                                if( gbuffer_permutations.Get( gbuffer_permutation ^ GBUFFER_NORMAL_MAPPING ) )
+                                    gbuffer_permutation ^= GBUFFER_NORMAL_MAPPING;
+                                break;
+
+            case 'F':           // Relaxed cone step mapping of the stone box
+                                if( cone_step_mapping_enabled ||
+                                    ( stone_cone_srv && gbuffer_permutations.Get( gbuffer_permutation | GBUFFER_CONE_STEP_MAPPING ) ) )
+                                    cone_step_mapping_enabled = !cone_step_mapping_enabled;
                                 break;
 
             case 'H':
             case VK_F1:         g_nRenderHUD = ( g_nRenderHUD + 1 ) % 3; break;
 
+            case 'D':           // Dynamic resolution
+                                dynamic_resolution_enabled = !dynamic_resolution_enabled;
+                                resolution_controller.Reset();
+                                break;
+
+            case 'R':           // Resize storm
+                                if( g_nResizeStormFrame < 0 && DXUTIsWindowed() )
+                                {
+                                    GetWindowRect( DXUTGetHWND(), &g_rcResizeStormWindow );
+                                    render_target_pool.ResetCounters();
+                                    g_nSwapChainResizes = 0;
+                                    g_nUnpooledTargetAllocations = 0;
+                                    g_nResizeStormFirstReallocation = frame_targets.GetReallocationCount();
+                                    g_nResizeStormFrame = 0;
+                                }
+                                break;
+
+            case 'T':           // Terrain
+                                terrain_enabled = !terrain_enabled;
+                                break;
+
+            case 'Z':           // Reversed-Z
+                                depth_mode = depth_mode == DEPTH_MODE_REVERSED_Z ? DEPTH_MODE_STANDARD : DEPTH_MODE_REVERSED_Z;
+                                frame_targets.SetFormat( FRAME_TARGET_DEPTH, GetDepthBufferFormat( depth_mode ) );
+                                frame_targets.Resize( render_target_pool, frame_targets.GetNativeWidth(), frame_targets.GetNativeHeight() );
+                                SetSceneProjection();
+                                break;
+
+            case 'P':           // Depth precision of both modes
+                                TestDepthPrecision( CAMERA_NEAR, CAMERA_FAR );
+                                break;
+
+            case 'O':           // Occlusion culling
+                                occlusion_culling_enabled = !occlusion_culling_enabled;
+                                break;
+
+            case 'M':           // Occlusion culling and patch tessellation benchmarks
+                                {
+                                    OcclusionBenchmarkResult result = BenchmarkOcclusion( OCCLUSION_BENCHMARK_FRAMES );
+                                    WCHAR szMsg[256];
+                                    StringCchPrintf( szMsg, 256, L"Occlusion: %u frames, %Iu occluder triangles in %.3f ms (%.0f per ms), "
+                                                     L"%Iu tests in %.3f ms (%.0f per ms), %.0f%% occluded\n",
+                                                     result.frames, result.occluderTriangles, result.rasterMilliseconds,
+                                                     result.trianglesPerMillisecond, result.occludeeTests, result.testMilliseconds,
+                                                     result.testsPerMillisecond, result.occludedFraction * 100.0f );
+                                    OutputDebugString( szMsg );
+
+                                    PatchTessellationBenchmarkResult patches = BenchmarkPatchTessellation( PATCH_TESSELLATION_BENCHMARK_GRID,
+                                                                                                           PATCH_TESSELLATION_BENCHMARK_FRAMES );
+                                    StringCchPrintf( szMsg, 256, L"Patch tessellation: %u frames, %Iu patches in %.3f ms (%.3f to %.3f ms, "
+                                                     L"%.0f per ms), %.0f%% visible\n",
+                                                     patches.frames, patches.patchCount, patches.averageMilliseconds, patches.minMilliseconds,
+                                                     patches.maxMilliseconds, patches.patchesPerMillisecond, patches.visibleFraction * 100.0f );
+                                    OutputDebugString( szMsg );
+                                }
+                                break;
+
+            case 'K':           // Shadow cascade count
+            case 'J':           // Shadow map resolution
+                                {
+                                    ShadowSettings settings = shadow_cascades.GetSettings();
+                                    if( nChar == 'K' )
+                                        settings.cascadeCount = settings.cascadeCount % SHADOW_MAX_CASCADES + 1;
+                                    else
+                                        settings.resolution = settings.resolution >= 2048 ? 512 : settings.resolution * 2;
+                                    shadow_cascades.SetSettings( settings );
+                                    shadow_map.Create( DXUTGetD3D11Device(), shadow_cascades.GetSettings() );
+                                }
+                                break;
+
+            case 'U':           // Shadow cascade fitting and culling benchmark
+                                {
+                                    ShadowBenchmarkResult result = BenchmarkShadowCascades( shadow_cascades.GetSettings(),
+                                                                                            SHADOW_BENCHMARK_CASTERS, SHADOW_BENCHMARK_FRAMES );
+                                    WCHAR szMsg[256];
+                                    StringCchPrintf( szMsg, 256, L"Shadow cascades: %u frames, %u cascades, %u casters, %.4f ms mean, "
+                                                     L"%.4f ms min, %.4f ms max, %.0f draws per frame\n",
+                                                     result.frames, result.cascadeCount, result.casterCount, result.averageMilliseconds,
+                                                     result.minMilliseconds, result.maxMilliseconds, result.averageDrawCount );
+                                    OutputDebugString( szMsg );
+                                }
+                                break;
+
+            case 'L':           // Point shadow atlas replays
+                                TestShadowAtlasReplays( SHADOW_ATLAS_REPLAY_FRAMES );
+                                break;
+
+            case 'C':           // Cone step maps
+                                CompareConeStepMaps();
+                                break;
+
+            case 'X':           // SDK mesh load benchmark
+                                {
+                                    SDKMESH_LOAD_BENCHMARK result;
+                                    if( SUCCEEDED( DXUTBenchmarkSDKMeshLoad( SDKMESH_BENCHMARK_VERTICES, SDKMESH_BENCHMARK_LOADS, &result ) ) )
+                                    {
+                                        WCHAR szMsg[256];
+                                        StringCchPrintf( szMsg, 256, L"SDK mesh load: %.0f MB, heap %.1f ms, %.0f MB resident, %.0f MB committed; "
+                                                         L"mapped %.1f ms, %.0f MB resident, %.0f MB committed\n",
+                                                         result.FileBytes / 1048576.0, result.fHeapSeconds * 1000.0,
+                                                         result.HeapWorkingSetBytes / 1048576.0, result.HeapPrivateBytes / 1048576.0,
+                                                         result.fMappedSeconds * 1000.0, result.MappedWorkingSetBytes / 1048576.0,
+                                                         result.MappedPrivateBytes / 1048576.0 );
+                                        OutputDebugString( szMsg );
+                                    }
+                                }
+                                break;
+
+            case 'Y':           // Skeleton animation, animation compression and skinning benchmarks
+                                for( UINT nFrames : sdkmesh_benchmark_skeleton_frames )
+                                {
+                                    for( UINT nInstances : sdkmesh_benchmark_instances )
+                                    {
+                                        UINT nIterations = max( 1u, SDKMESH_BENCHMARK_FRAME_TRANSFORMS / ( nFrames * nInstances ) );
+                                        SDKMESH_TRANSFORM_BENCHMARK result;
+                                        if( FAILED( DXUTBenchmarkSDKMeshTransform( nFrames, nInstances, nIterations, &result ) ) )
+                                            break;
+                                        WCHAR szMsg[256];
+                                        StringCchPrintf( szMsg, 256, L"Skeleton: %u frames x %u instances, %.3f ms per update, %.1f ns per frame\n",
+                                                         result.NumFrames, result.NumInstances, result.fSecondsPerIteration * 1000.0,
+                                                         result.fNanosecondsPerFrame );
+                                        OutputDebugString( szMsg );
+                                    }
+                                }
+                                ReportAnimationCompression();
+                                {
+                                    SDKSKINNING_BENCHMARK result;
+                                    if( SUCCEEDED( DXUTBenchmarkSDKMeshSkinning( DXUTGetD3D11Device(), DXUTGetD3D11DeviceContext(),
+                                                                                 SKINNING_BENCHMARK_VERTICES, SKINNING_BENCHMARK_BONES,
+                                                                                 SKINNING_BENCHMARK_ITERATIONS, &result ) ) )
+                                    {
+                                        WCHAR szMsg[256];
+                                        StringCchPrintf( szMsg, 256, L"Skinning: %u vertices, %u bones, %.1f M vertices/s on 1 core, "
+                                                         L"%.1f M/s on %u (%.1f M/s per core), %.1f M/s into the vertex buffer, "
+                                                         L"palette upload %.4f ms\n",
+                                                         result.NumVertices, result.NumBones, result.SingleThreaded.fVerticesPerSecond / 1e6,
+                                                         result.MultiThreaded.fVerticesPerSecond / 1e6, result.MultiThreaded.NumThreads,
+                                                         result.MultiThreaded.fVerticesPerSecondPerCore / 1e6,
+                                                         result.Upload.fVerticesPerSecond / 1e6, result.fPaletteSeconds * 1000.0 );
+                                        OutputDebugString( szMsg );
+                                    }
+                                }
+                                break;
+
+            case 'I':           // UI batch benchmark
+                                {
+                                    DXUTUIBATCH_BENCHMARK result;
+                                    if( SUCCEEDED( DXUTBenchmarkUIBatch( UI_BENCHMARK_QUADS, UI_BENCHMARK_FRAMES, &result ) ) )
+                                    {
+                                        WCHAR szMsg[256];
+                                        StringCchPrintf( szMsg, 256, L"UI batch: %u quads, append %.4f ms, flush %.4f ms, %.1f ns per quad, "
+                                                         L"%u maps and %u draws per frame\n",
+                                                         result.nQuadsPerFrame, result.fAppendSecondsPerFrame * 1000.0,
+                                                         result.fFlushSecondsPerFrame * 1000.0, result.fNanosecondsPerQuad,
+                                                         result.nMapsPerFrame, result.nDrawsPerFrame );
+                                        OutputDebugString( szMsg );
+                                    }
+                                }
+                                break;
+
+            case 'G':           // Dialog hit-test benchmark
+                                {
+                                    DXUTHITTEST_BENCHMARK result;
+                                    if( SUCCEEDED( DXUTBenchmarkDialogHitTest( &g_DialogResourceManager, HITTEST_BENCHMARK_CONTROLS,
+                                                                               HITTEST_BENCHMARK_MOVES, &result ) ) )
+                                    {
+                                        WCHAR szMsg[256];
+                                        StringCchPrintf( szMsg, 256, L"Dialog hit test: %u controls, linear %.1f ns, grid %.1f ns per move, "
+                                                         L"grid build %.3f ms, %.2f candidates per lookup, %u mismatches\n",
+                                                         result.nControls, result.fLinearNanosecondsPerMove, result.fGridNanosecondsPerMove,
+                                                         result.fGridBuildMilliseconds, result.fCandidatesPerHitTest, result.nMismatches );
+                                        OutputDebugString( szMsg );
+                                    }
+                                }
+                                break;
+
+            case 'B':           // Terrain node selection benchmark
+                                {
+                                    DirectX::XMFLOAT4X4 mProj;
+                                    DirectX::XMStoreFloat4x4( &mProj, assign( DirectX::XMMATRIX(), *g_Camera.GetProjMatrix() ) );
+                                    TerrainBenchmarkResult result = BenchmarkTerrainSelection( terrain, GetTerrainView(), mProj,
+                                                                                               TERRAIN_BENCHMARK_FRAMES );
+                                    WCHAR szMsg[256];
+                                    StringCchPrintf( szMsg, 256, L"Terrain selection: %u frames, %.4f ms mean, %.4f ms min, %.4f ms max, "
+                                                     L"%.0f vertices submitted (%Iu in the full grid)\n",
+                                                     result.frames, result.averageMilliseconds, result.minMilliseconds,
+                                                     result.maxMilliseconds, result.averageVertices, result.fullGridVertices );
+                                    OutputDebugString( szMsg );
+                                }
+                                break;
+
         }
     }
 }
@@ -684,7 +1625,7 @@ template<class T> inline void assignMember(char &to, T& from){
 HRESULT ComputeTangentFrame(const uint16_t* indices, size_t nFaces, const XMFLOAT3* positions, const XMFLOAT3* normals, const XMFLOAT2* texcoords, size_t nVerts, XMFLOAT4* tangents);
 void CreateBuffer(_In_ ID3D11Device* device, std::vector<VertexPositionNormalTangentColorTexture> const& data, D3D11_BIND_FLAG bindFlags, _Outptr_ ID3D11Buffer** pBuffer);
 void CreateBuffer(_In_ ID3D11Device* device, std::vector<uint16_t> const& data, D3D11_BIND_FLAG bindFlags, _Outptr_ ID3D11Buffer** pBuffer);
-std::unique_ptr<DirectX::ModelMeshPart> CreateModelMeshPart(ID3D11Device* device, std::function<void(std::vector<VertexPositionNormalTexture> & _vertices, std::vector<uint16_t> & _indices)> createGeometry){
+std::unique_ptr<DirectX::ModelMeshPart> CreateModelMeshPart(ID3D11Device* device, std::function<void(std::vector<VertexPositionNormalTexture> & _vertices, std::vector<uint16_t> & _indices)> createGeometry, std::vector<Meshlet>* meshlets = nullptr, MeshletBuildStats* meshletStats = nullptr){
 	std::vector<VertexPositionNormalTexture> vertices;
 	std::vector<uint16_t> indices;
 
@@ -707,6 +1648,10 @@ std::unique_ptr<DirectX::ModelMeshPart> CreateModelMeshPart(ID3D11Device* device
 
 	ComputeTangentFrame(indices.data(), indices.size() / 3, positions.get(), normals.get(), texcoords.get(), nVerts, tangents.get());
 
+	// Reorder the triangles into clusters so that each one is a contiguous index range
+	if (meshlets)
+		BuildMeshlets(positions.get(), nVerts, indices, *meshlets, meshletStats);
+
 	p = positions.get();
 	n = normals.get();
 	tex = texcoords.get();
@@ -751,13 +1696,23 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
                                       void* pUserContext )
 {
 	HRESULT hr;
+	V_RETURN(shader_reload.Start(pd3dDevice));
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	{
-		std::map<const WCHAR*, EffectShaderFileDef> shaderDef;
-		shaderDef[L"VS"] = { L"DeferredRenderFirstPass.hlsl", L"VS", L"vs_5_0" };
-		shaderDef[L"PS"] = { L"DeferredRenderFirstPass.hlsl", L"PS", L"ps_5_0" };
-
-		effect = createHlslEffect(pd3dDevice, shaderDef);
+		gbuffer_permutations.SetDevice(pd3dDevice, &shader_reload);
+		if (prebuild_shaders)
+		{
+			hr = gbuffer_permutations.Prebuild();
+			const ShaderPermutationStats& permutationStats = gbuffer_permutations.GetStats();
+			WCHAR szMsg[256];
+			StringCchPrintf(szMsg, 256, L"Shader prebuild: %u of %u G-buffer variants, %Iu stages compiled, %Iu cached, %Iu failed in %.0f ms\n",
+				permutationStats.variants, gbuffer_permutations.GetVariantCount(), permutationStats.compiledStages,
+				permutationStats.cachedStages, permutationStats.failedStages, permutationStats.seconds * 1000.0);
+			OutputDebugString(szMsg);
+			PostQuitMessage(FAILED(hr) ? 1 : 0);
+		}
+		if (!gbuffer_permutations.Get(gbuffer_permutation))
+			return E_FAIL;
 	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	{
@@ -766,7 +1721,7 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 		shaderDef[L"GS"] = { L"RenderTBN.hlsl", L"GS", L"gs_5_0" };
 		shaderDef[L"PS"] = { L"RenderTBN.hlsl", L"PS", L"ps_5_0" };
 
-		effectTBN = createHlslEffect(pd3dDevice, shaderDef);
+		effectTBN = createHlslEffect(pd3dDevice, shaderDef, &shader_reload);
 	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	{
@@ -774,7 +1729,7 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 		shaderDef[L"VS"] = { L"DeferredRenderSecondPass.hlsl", L"VS", L"vs_5_0" };
 		shaderDef[L"PS"] = { L"DeferredRenderSecondPass.hlsl", L"PS", L"ps_5_0" };
 
-		postProcess = createPostProcess(pd3dDevice, shaderDef);
+		postProcess = createPostProcess(pd3dDevice, shaderDef, &shader_reload);
 	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	{
@@ -782,7 +1737,7 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 		shaderDef[L"VS"] = { L"SimplePosThenConstColor.hlsl", L"SIMPLE_MODEL", L"vs_5_0" };
 		shaderDef[L"PS"] = { L"SimplePosThenConstColor.hlsl", L"CONST_COLOR", L"ps_5_0" };
 
-		effectLight = createHlslEffect(pd3dDevice, shaderDef);
+		effectLight = createHlslEffect(pd3dDevice, shaderDef, &shader_reload);
 	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -791,15 +1746,87 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 		shaderDef[L"VS"] = { L"DeferredRenderSecondPass.hlsl", L"VS", L"vs_5_0" };
 		shaderDef[L"PS"] = { L"DeferredRenderSecondPass.hlsl", L"AMBIENT_PS", L"ps_5_0" };
 
-		ambientPostProcess = createPostProcess(pd3dDevice, shaderDef);
+		ambientPostProcess = createPostProcess(pd3dDevice, shaderDef, &shader_reload);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	{
+		std::map<const WCHAR*, EffectShaderFileDef> shaderDef;
+		shaderDef[L"VS"] = { L"Upsample.hlsl", L"VS", L"vs_5_0" };
+		shaderDef[L"PS"] = { L"Upsample.hlsl", L"UPSAMPLE_PS", L"ps_5_0" };
+
+		upsamplePostProcess = createPostProcess(pd3dDevice, shaderDef, &shader_reload);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	{
+		std::map<const WCHAR*, EffectShaderFileDef> shaderDef;
+		shaderDef[L"VS"] = { L"Terrain.hlsl", L"TERRAIN_VS", L"vs_5_0" };
+		shaderDef[L"PS"] = { L"Terrain.hlsl", L"TERRAIN_PS", L"ps_5_0" };
+
+		terrainEffect = createHlslEffect(pd3dDevice, shaderDef, &shader_reload);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	{
+		std::map<const WCHAR*, EffectShaderFileDef> shaderDef;
+		shaderDef[L"VS"] = { L"ShadowMap.hlsl", L"SHADOW_VS", L"vs_5_0" };
+
+		shadowEffect = createHlslEffect(pd3dDevice, shaderDef, &shader_reload);
 	}
 	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	{
+		std::map<const WCHAR*, EffectShaderFileDef> shaderDef;
+		shaderDef[L"VS"] = { L"DirectionalLight.hlsl", L"VS", L"vs_5_0" };
+		shaderDef[L"PS"] = { L"DirectionalLight.hlsl", L"DIRECTIONAL_PS", L"ps_5_0" };
+
+		directionalLightPostProcess = createPostProcess(pd3dDevice, shaderDef, &shader_reload);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	{
+		std::map<const WCHAR*, EffectShaderFileDef> shaderDef;
+		shaderDef[L"VS"] = { L"ShadowMap.hlsl", L"SHADOW_CLEAR_VS", L"vs_5_0" };
+
+		pointShadowClearPostProcess = createPostProcess(pd3dDevice, shaderDef, &shader_reload);
+	}
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+	V_RETURN(gbuffer_bindings.Validate(GetShaderBindingLayout(gbuffer_permutations.Get(gbuffer_permutation))));
+	V_RETURN(gbuffer_bindings.Validate(GetShaderBindingLayout(effectTBN.get())));
+	V_RETURN(terrain_bindings.Validate(GetShaderBindingLayout(terrainEffect.get())));
+	V_RETURN(light_bindings.Validate(GetShaderBindingLayout(effectLight.get())));
+	V_RETURN(lighting_bindings.Validate(GetShaderBindingLayout(ambientPostProcess.get())));
+	V_RETURN(lighting_bindings.Validate(GetShaderBindingLayout(postProcess.get())));
+	V_RETURN(upsample_bindings.Validate(GetShaderBindingLayout(upsamplePostProcess.get())));
+	V_RETURN(shadow_bindings.Validate(GetShaderBindingLayout(shadowEffect.get())));
+	V_RETURN(directional_light_bindings.Validate(GetShaderBindingLayout(directionalLightPostProcess.get())));
+	V_RETURN(shadow_bindings.Validate(GetShaderBindingLayout(pointShadowClearPostProcess.get())));
+	/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 	states = std::make_unique<CommonStates>(pd3dDevice);
 
 	scene_state_cb = new DirectX::ConstantBuffer<cbCustom>(pd3dDevice);
 
 	main_scene_state_cb = new DirectX::ConstantBuffer<SceneState>(pd3dDevice);
 
+	shadow_state_cb = new DirectX::ConstantBuffer<ShadowState>(pd3dDevice);
+
+	V_RETURN(shadow_map.Create(pd3dDevice, shadow_cascades.GetSettings()));
+
+	point_shadow_state_cb = new DirectX::ConstantBuffer<PointShadowState>(pd3dDevice);
+
+	ShadowSettings point_shadow_settings = ShadowSettings::Default();
+	point_shadow_settings.cascadeCount = 1;
+	point_shadow_settings.resolution = SHADOW_ATLAS_SIZE;
+	V_RETURN(point_shadow_map.Create(pd3dDevice, point_shadow_settings));
+	point_shadow_atlas.Init();      // The cached faces were in the old texture
+	{
+		// Writes whatever is there
+		CD3D11_DEPTH_STENCIL_DESC clearDesc(D3D11_DEFAULT);
+		clearDesc.DepthFunc = D3D11_COMPARISON_ALWAYS;
+		V_RETURN(pd3dDevice->CreateDepthStencilState(&clearDesc, point_shadow_clear_state.ReleaseAndGetAddressOf()));
+	}
+
+	render_target_pool.SetDevice(pd3dDevice);
+
+	ThrowIfFailed(scene_gpu_timer.Create(pd3dDevice));
+	resolution_controller.Reset();
+
 	// Get device context
 	ID3D11DeviceContext* pd3dImmediateContext = DXUTGetD3D11DeviceContext();
 
@@ -813,18 +1840,36 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 
 	teapot = CreateModelMeshPart(pd3dDevice, [=](std::vector<VertexPositionNormalTexture> & _vertices, std::vector<uint16_t> & _indices){
 		GeometricPrimitive::CreateTeapot(_vertices, _indices, 0.5, 4U, false);
-	});
+	}, &teapot_meshlets, &teapot_meshlet_build_stats);
+	teapot_index_count = teapot->indexCount;
+
+	// Occludee bounds of the teapot, around the spheres of its clusters
+	teapot_bounds_min = XMFLOAT3(FLT_MAX, FLT_MAX, FLT_MAX);
+	teapot_bounds_max = XMFLOAT3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	for (size_t i = 0; i < teapot_meshlets.size(); ++i)
+	{
+		const Meshlet& m = teapot_meshlets[i];
+		XMStoreFloat3(&teapot_bounds_min, XMVectorMin(XMLoadFloat3(&teapot_bounds_min), XMLoadFloat3(&m.center) - XMVectorReplicate(m.radius)));
+		XMStoreFloat3(&teapot_bounds_max, XMVectorMax(XMLoadFloat3(&teapot_bounds_max), XMLoadFloat3(&m.center) + XMVectorReplicate(m.radius)));
+	}
 
 	light = GeometricPrimitive::CreateSphere(pd3dImmediateContext, 0.5, 32, false);
 
-	decal_box->CreateInputLayout(pd3dDevice, effect.get(), &box_inputLayout);
+	// The variants share the vertex input, so the layouts fit all of them
+	decal_box->CreateInputLayout(pd3dDevice, gbuffer_permutations.Get(gbuffer_permutation), &box_inputLayout);
 
-	teapot->CreateInputLayout(pd3dDevice, effect.get(), &teapot_inputLayout);
+	teapot->CreateInputLayout(pd3dDevice, gbuffer_permutations.Get(gbuffer_permutation), &teapot_inputLayout);
 
 	teapot->CreateInputLayout(pd3dDevice, effectTBN.get(), &teapot_tbn_inputLayout);
+
+	// The casters share the vertex format
+	decal_box->CreateInputLayout(pd3dDevice, shadowEffect.get(), &shadow_inputLayout);
 	
 	light->CreateInputLayout(effectLight.get(), &light_inputLayout);
 
+	ThrowIfFailed(terrain.CreateDeviceResources(pd3dDevice));
+	ThrowIfFailed(terrain.CreateInputLayout(pd3dDevice, terrainEffect.get(), terrain_inputLayout.ReleaseAndGetAddressOf()));
+
 	// GUI creation
     V_RETURN( g_DialogResourceManager.OnD3D11CreateDevice( pd3dDevice, pd3dImmediateContext ) );
     V_RETURN( g_D3DSettingsDlg.OnD3D11CreateDevice( pd3dDevice ) );
@@ -847,6 +1892,29 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 	DXUTFindDXSDKMediaFileCch(wcPath2, 256, L"Textures\\brick_nm.bmp");
 	hr = D3DX11CreateShaderResourceViewFromFile(pd3dDevice, wcPath2, NULL, NULL, stone_nm_srv.ReleaseAndGetAddressOf(), NULL);
 
+	// The height map of the cone step mapped stone box, with its cone map built or loaded
+	// from the cache; F stays off if it can't be
+	{
+		const DETAIL_TESSELLATION_TEXTURE_STRUCT& texture = DetailTessellationTextures[CONE_STEP_STONE_BOX_TEXTURE];
+		ConeStepMap map;
+		ConeStepMapStats stats;
+		DXUTFindDXSDKMediaFileCch(wcPath2, 256, texture.DiffuseMap);
+		hr = D3DX11CreateShaderResourceViewFromFile(pd3dDevice, wcPath2, NULL, NULL, stone_pom_srv.ReleaseAndGetAddressOf(), NULL);
+		DXUTFindDXSDKMediaFileCch(wcPath2, 256, texture.NormalHeightMap);
+		hr = D3DX11CreateShaderResourceViewFromFile(pd3dDevice, wcPath2, NULL, NULL, stone_pom_nmh_srv.ReleaseAndGetAddressOf(), NULL);
+		if (SUCCEEDED(hr))
+			hr = LoadOrBuildConeStepMap(pd3dDevice, pd3dImmediateContext, texture.NormalHeightMap, ConeStepMapSettings::Default(), map, &stats);
+		if (SUCCEEDED(hr))
+			hr = CreateConeStepTexture(pd3dDevice, map, stone_cone_srv.ReleaseAndGetAddressOf());
+		WCHAR szMsg[256];
+		if (SUCCEEDED(hr))
+			StringCchPrintf(szMsg, 256, L"Stone box cone step map: %s %ux%u %s in %.0f ms\n", texture.DisplayName,
+				map.width, map.height, stats.fromCache ? L"loaded" : L"built", stats.seconds * 1000.0);
+		else
+			StringCchPrintf(szMsg, 256, L"Stone box cone step map of %s failed (0x%08x)\n", texture.NormalHeightMap, hr);
+		OutputDebugString(szMsg);
+	}
+
 	Microsoft::WRL::ComPtr<ID3D11Texture2D> t3;
 	WCHAR wcPath3[256];
 	DXUTFindDXSDKMediaFileCch(wcPath3, 256, L"Textures\\Oxidated.jpg");
@@ -854,26 +1922,34 @@ HRESULT CALLBACK OnD3D11CreateDevice( ID3D11Device* pd3dDevice, const DXGI_SURFA
 	DXUTFindDXSDKMediaFileCch(wcPath3, 256, L"Textures\\wall_bump.dds");
 	hr = D3DX11CreateShaderResourceViewFromFile(pd3dDevice, wcPath3, NULL, NULL, teapot_nm_srv.ReleaseAndGetAddressOf(), NULL);
 
-	CreateDepthStencilState(pd3dDevice,
-		/*BOOL DepthEnable*/true,
-		/*D3D11_DEPTH_WRITE_MASK DepthWriteMask*/D3D11_DEPTH_WRITE_MASK_ZERO,
-		/*D3D11_COMPARISON_FUNC DepthFunc*/D3D11_COMPARISON_LESS,
-
-		/*BOOL StencilEnable*/true,
-		/*UINT8 StencilReadMask*/D3D11_DEFAULT_STENCIL_READ_MASK,
-		/*UINT8 StencilWriteMask*/D3D11_DEFAULT_STENCIL_READ_MASK,
-
-		/*D3D11_COMPARISON_FUNC FrontFaceStencilFunc*/D3D11_COMPARISON_ALWAYS,
-		/*D3D11_STENCIL_OP FrontFaceStencilPassOp*/D3D11_STENCIL_OP_KEEP,
-		/*D3D11_STENCIL_OP FrontFaceStencilFailOp*/D3D11_STENCIL_OP_KEEP,
-		/*D3D11_STENCIL_OP FrontFaceStencilDepthFailOp*/D3D11_STENCIL_OP_INCR_SAT,
-
-		/*D3D11_COMPARISON_FUNC BackFaceStencilFunc*/D3D11_COMPARISON_ALWAYS,
-		/*D3D11_STENCIL_OP BackFaceStencilPassOp*/D3D11_STENCIL_OP_KEEP,
-		/*D3D11_STENCIL_OP BackFaceStencilFailOp*/D3D11_STENCIL_OP_KEEP,
-		/*D3D11_STENCIL_OP BackFaceStencilDepthFailOp*/D3D11_STENCIL_OP_INCR_SAT,
-
-		light_depth_stencil_first_pass_state.ReleaseAndGetAddressOf());
+	for (int mode = 0; mode < DEPTH_MODE_COUNT; ++mode)
+	{
+		// CommonStates::DepthDefault() with the comparison of the mode
+		CD3D11_DEPTH_STENCIL_DESC depthDefault(D3D11_DEFAULT);
+		depthDefault.DepthFunc = GetDepthComparison(D3D11_COMPARISON_LESS_EQUAL, (DepthMode)mode);
+		V_RETURN(pd3dDevice->CreateDepthStencilState(&depthDefault, depth_default_state[mode].ReleaseAndGetAddressOf()));
+
+		CreateDepthStencilState(pd3dDevice,
+			/*BOOL DepthEnable*/true,
+			/*D3D11_DEPTH_WRITE_MASK DepthWriteMask*/D3D11_DEPTH_WRITE_MASK_ZERO,
+			/*D3D11_COMPARISON_FUNC DepthFunc*/GetDepthComparison(D3D11_COMPARISON_LESS, (DepthMode)mode),
+
+			/*BOOL StencilEnable*/true,
+			/*UINT8 StencilReadMask*/D3D11_DEFAULT_STENCIL_READ_MASK,
+			/*UINT8 StencilWriteMask*/D3D11_DEFAULT_STENCIL_READ_MASK,
+
+			/*D3D11_COMPARISON_FUNC FrontFaceStencilFunc*/D3D11_COMPARISON_ALWAYS,
+			/*D3D11_STENCIL_OP FrontFaceStencilPassOp*/D3D11_STENCIL_OP_KEEP,
+			/*D3D11_STENCIL_OP FrontFaceStencilFailOp*/D3D11_STENCIL_OP_KEEP,
+			/*D3D11_STENCIL_OP FrontFaceStencilDepthFailOp*/D3D11_STENCIL_OP_INCR_SAT,
+
+			/*D3D11_COMPARISON_FUNC BackFaceStencilFunc*/D3D11_COMPARISON_ALWAYS,
+			/*D3D11_STENCIL_OP BackFaceStencilPassOp*/D3D11_STENCIL_OP_KEEP,
+			/*D3D11_STENCIL_OP BackFaceStencilFailOp*/D3D11_STENCIL_OP_KEEP,
+			/*D3D11_STENCIL_OP BackFaceStencilDepthFailOp*/D3D11_STENCIL_OP_INCR_SAT,
+
+			light_depth_stencil_first_pass_state[mode].ReleaseAndGetAddressOf());
+	}
 
 	CreateDepthStencilState(pd3dDevice,
 		/*BOOL DepthEnable*/false,
@@ -934,10 +2010,10 @@ HRESULT CALLBACK OnD3D11ResizedSwapChain( ID3D11Device* pd3dDevice, IDXGISwapCha
 
     // Setup the camera's projection parameters
     float fAspectRatio = pBackBufferSurfaceDesc->Width / (FLOAT)pBackBufferSurfaceDesc->Height;
-    g_Camera.SetProjParams( D3DX_PI/3, fAspectRatio, 0.1f, 100000.0f );
+    g_Camera.SetProjParams( CAMERA_FOV, fAspectRatio, CAMERA_NEAR, CAMERA_FAR );
 
 	//dynamic_cast<IEffectMatrices*>(effect.get())->SetProjection(assign(DirectX::XMMATRIX(), *g_Camera.GetProjMatrix()));
-	DirectX::XMStoreFloat4x4(&main_scene_state.mProjection, DirectX::XMMatrixTranspose(assign(DirectX::XMMATRIX(), *g_Camera.GetProjMatrix())));
+	SetSceneProjection();
 	DirectX::XMStoreFloat4(&main_scene_state.vScreenResolution, XMLoadFloat4(&XMFLOAT4(0, 0, (*g_Camera.GetProjMatrix())(1,1), fAspectRatio)));
     // Set GUI size and locations
     g_HUD.SetLocation( pBackBufferSurfaceDesc->Width - 170, 0 );
@@ -946,79 +2022,15 @@ HRESULT CALLBACK OnD3D11ResizedSwapChain( ID3D11Device* pd3dDevice, IDXGISwapCha
     g_SampleUI.SetSize( 245, 660 );
 
 
-	Microsoft::WRL::ComPtr<ID3D11Texture2D> t1, t2, t3, t4;
-	/// /// 
-	CD3D11_TEXTURE2D_DESC fragmentDesc(DXGI_FORMAT_R32G32B32A32_FLOAT, pBackBufferSurfaceDesc->Width, pBackBufferSurfaceDesc->Height, 1, 1, D3D11_BIND_RENDER_TARGET | D3D11_BIND_SHADER_RESOURCE);// , D3D11_USAGE_DEFAULT, 0, 1, 0, 0);
-
-	ThrowIfFailed(pd3dDevice->CreateTexture2D(&fragmentDesc, nullptr, t1.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateTexture2D(&fragmentDesc, nullptr, t2.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateTexture2D(&fragmentDesc, nullptr, t3.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateShaderResourceView(t1.Get(), nullptr, srv1.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateShaderResourceView(t2.Get(), nullptr, srv2.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateShaderResourceView(t3.Get(), nullptr, srv3.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateRenderTargetView(t1.Get(), nullptr, rtv1.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateRenderTargetView(t2.Get(), nullptr, rtv2.ReleaseAndGetAddressOf()));
-
-	ThrowIfFailed(pd3dDevice->CreateRenderTargetView(t3.Get(), nullptr, rtv3.ReleaseAndGetAddressOf()));
-
-	/// ///
-	
-	CD3D11_TEXTURE2D_DESC depthDesc(DXGI_FORMAT_D24_UNORM_S8_UINT, pBackBufferSurfaceDesc->Width, pBackBufferSurfaceDesc->Height, 1, 1, D3D11_BIND_DEPTH_STENCIL);// , D3D11_USAGE_DEFAULT, 0, 1, 0, 0);
-
-	ThrowIfFailed(pd3dDevice->CreateTexture2D(&depthDesc, nullptr, t4.ReleaseAndGetAddressOf()));
-
-	// ThrowIfFailed(pd3dDevice->CreateShaderResourceView(t3.Get(), nullptr, ds_srv.ReleaseAndGetAddressOf())); not support
-
-	ThrowIfFailed(pd3dDevice->CreateDepthStencilView(t4.Get(), nullptr, ds_v.ReleaseAndGetAddressOf()));
+	// Targets of the previous size come back from the pool unless the window left the allocation
+	frame_targets.SetFormat(FRAME_TARGET_LIGHT, pBackBufferSurfaceDesc->Format);
+	V_RETURN(frame_targets.Resize(render_target_pool, pBackBufferSurfaceDesc->Width, pBackBufferSurfaceDesc->Height));
+	g_nSwapChainResizes++;
+	g_nUnpooledTargetAllocations += frame_targets.GetTargetCount();
 
     return S_OK;
 }
 
-inline ID3D11RenderTargetView** renderTargetViewToArray(ID3D11RenderTargetView* rtv1, ID3D11RenderTargetView* rtv2 = 0, ID3D11RenderTargetView* rtv3 = 0){
-	static ID3D11RenderTargetView* rtvs[10];
-	rtvs[0] = rtv1;
-	rtvs[1] = rtv2;
-	rtvs[2] = rtv3;
-	return rtvs;
-};
-
-inline ID3D11ShaderResourceView** shaderResourceViewToArray(ID3D11ShaderResourceView* rtv1, ID3D11ShaderResourceView* rtv2 = 0, ID3D11ShaderResourceView* rtv3 = 0){
-	static ID3D11ShaderResourceView* srvs[10];
-	srvs[0] = rtv1;
-	srvs[1] = rtv2;
-	srvs[2] = rtv3;
-	return srvs;
-};
-
-
-inline ID3D11SamplerState** samplerStateToArray(ID3D11SamplerState* ss1, ID3D11SamplerState* ss2 = 0){
-	static ID3D11SamplerState* sss[10];
-	sss[0] = ss1;
-	sss[1] = ss2;
-	return sss;
-};
-
-template<class T> inline ID3D11Buffer** constantBuffersToArray(DirectX::ConstantBuffer<T> &cb){
-	static ID3D11Buffer* cbs[10];
-	cbs[0] = cb.GetBuffer();
-	return cbs;
-};
-
-
-template<class T1, class T2 > inline ID3D11Buffer** constantBuffersToArray(DirectX::ConstantBuffer<T1> &cb1, DirectX::ConstantBuffer<T2> &cb2){
-	static ID3D11Buffer* cbs[10];
-	cbs[0] = cb1.GetBuffer();
-	cbs[1] = cb2.GetBuffer();
-	return cbs;
-};
-
 //--------------------------------------------------------------------------------------
 // Render the scene using the D3D11 device
 //--------------------------------------------------------------------------------------
@@ -1027,36 +2039,77 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 {
     HRESULT                     hr;
     static DWORD                s_dwFrameNumber = 1;
+    static UINT                 s_nShadowPass = DXUTFrameStatsRegisterPass( L"Shadows" );
+    static UINT                 s_nGBufferPass = DXUTFrameStatsRegisterPass( L"G-buffer" );
+    static UINT                 s_nLightingPass = DXUTFrameStatsRegisterPass( L"Lighting" );
+    static UINT                 s_nPostProcessPass = DXUTFrameStatsRegisterPass( L"Post process" );
+    static UINT                 s_nHUDPass = DXUTFrameStatsRegisterPass( L"HUD" );
     ID3D11Buffer*               pBuffers[2];
     ID3D11ShaderResourceView*   pSRV[4];
     ID3D11SamplerState*         pSS[1];
     D3DXVECTOR3                 vFrom;
+    IEffect*                    gbuffer_effect = gbuffer_permutations.Get(gbuffer_permutation);
 
 	struct Et {
 		IEffect* e;
 		D3D_PRIMITIVE_TOPOLOGY t;
 		ID3D11RasterizerState* s;
 	} et[2] = {
-		{ effect.get(), D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, states->CullCounterClockwise() },
+		{ gbuffer_effect, D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST, states->CullCounterClockwise() },
 		{ effectTBN.get(), D3D_PRIMITIVE_TOPOLOGY_POINTLIST, states->Wireframe() }
 	};
 
 	// Clear the render target and depth stencil
 	float ClearColor[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
 
-	ID3D11DepthStencilView* dsv = ds_v.Get();// // DXUTGetD3D11DepthStencilView();// ds_v.Get();//
-
-	pd3dImmediateContext->ClearRenderTargetView(rtv1.Get(), ClearColor);
-	pd3dImmediateContext->ClearRenderTargetView(rtv2.Get(), ClearColor);
-	pd3dImmediateContext->ClearRenderTargetView(rtv3.Get(), ClearColor);
-
-	pd3dImmediateContext->ClearRenderTargetView(DXUTGetD3D11RenderTargetView(), ClearColor);
-
-	pd3dImmediateContext->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, 1.0f, 0);
-
-	pd3dImmediateContext->OMSetRenderTargets(3, renderTargetViewToArray(rtv1.Get(), rtv2.Get(), rtv3.Get()), dsv);
+	ID3D11DepthStencilView* dsv = frame_targets[FRAME_TARGET_DEPTH].dsv.Get();
+	// Read by the lighting pass while it is bound for the stencil test
+	ID3D11DepthStencilView* read_only_dsv = frame_targets[FRAME_TARGET_DEPTH].readOnlyDsv.Get();
+	ID3D11RenderTargetView* rtv2 = frame_targets[FRAME_TARGET_NORMAL].rtv.Get();
+	ID3D11RenderTargetView* rtv3 = frame_targets[FRAME_TARGET_COLOR].rtv.Get();
+	ID3D11ShaderResourceView* srv1 = frame_targets[FRAME_TARGET_DEPTH].srv.Get();
+	ID3D11ShaderResourceView* srv2 = frame_targets[FRAME_TARGET_NORMAL].srv.Get();
+	ID3D11ShaderResourceView* srv3 = frame_targets[FRAME_TARGET_COLOR].srv.Get();
+	// Lighting goes to the light buffer instead of the back buffer, whose size differs from
+	// the depth buffer's while the window is smaller than the allocation
+	ID3D11RenderTargetView* light_rtv = frame_targets[FRAME_TARGET_LIGHT].rtv.Get();
+	ID3D11RenderTargetView* gbuffer_rtvs[] = { rtv2, rtv3 };
+	ID3D11RenderTargetView* null_rtvs[] = { nullptr, nullptr };
+
+	// Pick the render scale from the GPU time of an earlier frame
+	float scene_milliseconds = scene_gpu_timer.Read(pd3dImmediateContext);
+	if (scene_milliseconds >= 0.0f)
+		scene_gpu_milliseconds = scene_milliseconds;
+	frame_targets.SetRenderScale(dynamic_resolution_enabled ? resolution_controller.Update(scene_milliseconds) : 1.0f);
+	DirectX::XMStoreFloat4(&main_scene_state.vGBufferUVScale, XMVectorSet(frame_targets.GetUScale(), frame_targets.GetVScale(),
+		frame_targets.GetUMax(), frame_targets.GetVMax()));
+
+	// At the shadow map's resolution, outside of the dynamic resolution's time
+	DXUTFrameStatsBeginPass(s_nShadowPass);
+	RenderShadowMaps(pd3dImmediateContext);
+	RenderPointShadows(pd3dImmediateContext);
+	DXUTFrameStatsEndPass(s_nShadowPass);
+
+	D3D11_VIEWPORT viewport = frame_targets.GetViewport();
+	pd3dImmediateContext->RSSetViewports(1, &viewport);
+
+	scene_gpu_timer.Begin(pd3dImmediateContext);
+
+	pd3dImmediateContext->ClearRenderTargetView(rtv2, ClearColor);
+	pd3dImmediateContext->ClearRenderTargetView(rtv3, ClearColor);
+
+	pd3dImmediateContext->ClearRenderTargetView(light_rtv, ClearColor);
+
+	pd3dImmediateContext->ClearDepthStencilView(dsv, D3D11_CLEAR_DEPTH, GetDepthClearValue(depth_mode), 0);
+
+	teapot_occluded = false;
+	if (occlusion_culling_enabled)
+		RenderOcclusion();
+
+	DXUTFrameStatsBeginPass(s_nGBufferPass);
+	pd3dImmediateContext->OMSetRenderTargets(2, gbuffer_rtvs, dsv);
 	if(true){
-		DirectX::XMMATRIX wvp = DirectX::XMMatrixTranslationFromVector(XMLoadFloat3(&XMFLOAT3(3, 2, 0.5)) + 1 / 2.0 * XMVECTOR(XMLoadFloat3(&decal_box_size)));
+		DirectX::XMMATRIX wvp = GetDecalBoxWorldMatrix();
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorld, DirectX::XMMatrixTranspose(wvp));
 		wvp = wvp * XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mView));
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorldView, DirectX::XMMatrixTranspose(wvp));
@@ -1071,20 +2124,23 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 			decal_box->primitiveType = et.t;
 			decal_box->Draw(pd3dImmediateContext, et.e, box_inputLayout.Get(), [=]
 			{
-				pd3dImmediateContext->VSSetConstantBuffers(0, 2, constantBuffersToArray(*main_scene_state_cb, *scene_state_cb));
-				pd3dImmediateContext->GSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
-
-				pd3dImmediateContext->PSSetShaderResources(0, 2, shaderResourceViewToArray(decal_srv.Get(), decal_nm_srv.Get()));
-				pd3dImmediateContext->PSSetSamplers(0, 1, samplerStateToArray(states->LinearWrap()));
+				gbuffer_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(et.e), { main_scene_state_cb->GetBuffer(),
+					scene_state_cb->GetBuffer(), decal_srv.Get(), decal_nm_srv.Get(), nullptr, states->LinearWrap() });
 
 				pd3dImmediateContext->OMSetBlendState(states->Opaque(), Colors::Black, 0xFFFFFFFF);
 				pd3dImmediateContext->RSSetState(et.s);
-				pd3dImmediateContext->OMSetDepthStencilState(states->DepthDefault(), 0);
+				pd3dImmediateContext->OMSetDepthStencilState(depth_default_state[depth_mode].Get(), 0);
 			});
 		});
 	}
 	if (true){
-		DirectX::XMMATRIX wvp = DirectX::XMMatrixTranslationFromVector(XMLoadFloat3(&XMFLOAT3(-5, -5, 0)) + 1 / 2.0 * XMVECTOR(XMLoadFloat3(&stone_box_size)));
+		// The stones height map and its cone map, or the brick textures if the variant failed to compile
+		IEffect* stone_effect = cone_step_mapping_enabled ? gbuffer_permutations.Get(gbuffer_permutation | GBUFFER_CONE_STEP_MAPPING) : nullptr;
+		ID3D11ShaderResourceView* stone_color_srv = stone_effect ? stone_pom_srv.Get() : stone_srv.Get();
+		ID3D11ShaderResourceView* stone_normal_srv = stone_effect ? stone_pom_nmh_srv.Get() : stone_nm_srv.Get();
+		if (!stone_effect)
+			stone_effect = gbuffer_effect;
+		DirectX::XMMATRIX wvp = GetStoneBoxWorldMatrix();
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorld, DirectX::XMMatrixTranspose(wvp));
 		wvp = wvp * XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mView));
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorldView, DirectX::XMMatrixTranspose(wvp));
@@ -1092,24 +2148,32 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorldViewProjection, DirectX::XMMatrixTranspose(wvp));
 		cbCustom cb;
 		cb.textureScale = D3DXVECTOR4(stone_box_size.x, stone_box_size.y, stone_box_size.z, 0);
+		cb.parallaxScale = D3DXVECTOR4(CONE_STEP_HEIGHT_SCALE, 0, 0, 0);
 		scene_state_cb->SetData(pd3dImmediateContext, cb);
 		main_scene_state_cb->SetData(pd3dImmediateContext, main_scene_state);
 
-		stone_box->Draw(pd3dImmediateContext, effect.get(), box_inputLayout.Get(), [=]
+		stone_box->Draw(pd3dImmediateContext, stone_effect, box_inputLayout.Get(), [=]
 		{
-			pd3dImmediateContext->VSSetConstantBuffers(0, 2, constantBuffersToArray(*main_scene_state_cb, *scene_state_cb));
-
-			pd3dImmediateContext->PSSetShaderResources(0, 2, shaderResourceViewToArray(stone_srv.Get(), stone_nm_srv.Get()));
-			pd3dImmediateContext->PSSetSamplers(0, 1, samplerStateToArray(states->LinearWrap()));
+			gbuffer_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(stone_effect), { main_scene_state_cb->GetBuffer(),
+				scene_state_cb->GetBuffer(), stone_color_srv, stone_normal_srv, stone_cone_srv.Get(), states->LinearWrap() });
 
 			pd3dImmediateContext->OMSetBlendState(states->Opaque(), Colors::Black, 0xFFFFFFFF);
 			pd3dImmediateContext->RSSetState(states->CullClockwise());
-			pd3dImmediateContext->OMSetDepthStencilState(states->DepthDefault(), 0);
+			pd3dImmediateContext->OMSetDepthStencilState(depth_default_state[depth_mode].Get(), 0);
 		});
 	}
-	if (true){//
-		DirectX::XMMATRIX wvp = DirectX::XMMatrixRotationY(1 * 57.2) * DirectX::XMMatrixRotationX(1 * 45.3) * DirectX::XMMatrixTranslationFromVector(XMLoadFloat3(&XMFLOAT3(1.0, 2.3, 1.5)));
+	if (!teapot_occluded){//
+		DirectX::XMMATRIX wvp = GetTeapotWorldMatrix();
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorld, DirectX::XMMatrixTranspose(wvp));
+		{
+			D3DXMATRIX mViewProjection = *g_Camera.GetViewMatrix() * *g_Camera.GetProjMatrix();
+			D3DXVECTOR4 vFrustumPlanes[6];
+			ExtractPlanesFromFrustum(vFrustumPlanes, &mViewProjection);
+
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, wvp);
+			CullMeshlets(teapot_meshlets, world, (const XMFLOAT4*)vFrustumPlanes, *(const XMFLOAT3*)g_Camera.GetEyePt(), teapot_visible_ranges, &teapot_meshlet_cull_stats);
+		}
 		wvp = wvp * XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mView));
 		DirectX::XMStoreFloat4x4(&main_scene_state.mWorldView, DirectX::XMMatrixTranspose(wvp));
 		wvp = wvp * XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mProjection));
@@ -1120,24 +2184,56 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 		main_scene_state_cb->SetData(pd3dImmediateContext, main_scene_state);
 
 		std::for_each(&et[0], &et[1], [=](Et et) {
+			if (teapot_visible_ranges.empty())
+				return;
+
+			// The first range sets up the pipeline, the others only need their own draw
 			teapot->primitiveType = et.t;
+			teapot->startIndex = teapot_visible_ranges[0].startIndex;
+			teapot->indexCount = teapot_visible_ranges[0].indexCount;
 			teapot->Draw(pd3dImmediateContext, et.e, teapot_inputLayout.Get(), [=]
 			{
-				pd3dImmediateContext->VSSetConstantBuffers(0, 2, constantBuffersToArray(*main_scene_state_cb, *scene_state_cb));
-				pd3dImmediateContext->GSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
-
-				pd3dImmediateContext->PSSetShaderResources(0, 2, shaderResourceViewToArray(teapot_srv.Get(), teapot_nm_srv.Get()));
-				pd3dImmediateContext->PSSetSamplers(0, 1, samplerStateToArray(states->LinearWrap()));
+				gbuffer_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(et.e), { main_scene_state_cb->GetBuffer(),
+					scene_state_cb->GetBuffer(), teapot_srv.Get(), teapot_nm_srv.Get(), nullptr, states->LinearWrap() });
 
 				pd3dImmediateContext->OMSetBlendState(states->Opaque(), Colors::Black, 0xFFFFFFFF);
 				pd3dImmediateContext->RSSetState(et.s);
-				pd3dImmediateContext->OMSetDepthStencilState(states->DepthDefault(), 0);
+				pd3dImmediateContext->OMSetDepthStencilState(depth_default_state[depth_mode].Get(), 0);
 			});
+			std::for_each(teapot_visible_ranges.begin() + 1, teapot_visible_ranges.end(), [=](const MeshletIndexRange& range) {
+				pd3dImmediateContext->DrawIndexed(range.indexCount, range.startIndex, teapot->vertexOffset);
+			});
+		});
+	}
+	if (terrain_enabled){
+		terrain.Select(GetTerrainView(), &terrain_selection_stats);
+
+		DirectX::XMMATRIX wvp = GetTerrainWorldMatrix();
+		DirectX::XMStoreFloat4x4(&main_scene_state.mWorld, DirectX::XMMatrixTranspose(wvp));
+		wvp = wvp * XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mView));
+		DirectX::XMStoreFloat4x4(&main_scene_state.mWorldView, DirectX::XMMatrixTranspose(wvp));
+		wvp = wvp * XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mProjection));
+		DirectX::XMStoreFloat4x4(&main_scene_state.mWorldViewProjection, DirectX::XMMatrixTranspose(wvp));
+		cbCustom cb;
+		cb.textureScale = D3DXVECTOR4(1 / 16.0f, 1 / 16.0f, 0, 0);
+		scene_state_cb->SetData(pd3dImmediateContext, cb);
+		main_scene_state_cb->SetData(pd3dImmediateContext, main_scene_state);
+
+		terrain.Draw(pd3dImmediateContext, terrainEffect.get(), terrain_inputLayout.Get(), [=]
+		{
+			terrain_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(terrainEffect.get()), { main_scene_state_cb->GetBuffer(),
+				scene_state_cb->GetBuffer(), stone_srv.Get(), states->LinearWrap() });
+
+			pd3dImmediateContext->OMSetBlendState(states->Opaque(), Colors::Black, 0xFFFFFFFF);
+			pd3dImmediateContext->RSSetState(states->CullCounterClockwise());
+			pd3dImmediateContext->OMSetDepthStencilState(depth_default_state[depth_mode].Get(), 0);
 		});
 	}
-	pd3dImmediateContext->OMSetRenderTargets(3, renderTargetViewToArray(nullptr, nullptr, nullptr), dsv);
+	pd3dImmediateContext->OMSetRenderTargets(2, null_rtvs, dsv);
+	DXUTFrameStatsEndPass(s_nGBufferPass);
 
-	pd3dImmediateContext->OMSetRenderTargets(1, renderTargetViewToArray(DXUTGetD3D11RenderTargetView()), dsv);
+	DXUTFrameStatsBeginPass(s_nLightingPass);
+	pd3dImmediateContext->OMSetRenderTargets(1, &light_rtv, dsv);
 	if (true){
 		auto L = XMVector3TransformCoord(XMLoadFloat3(&XMFLOAT3(2, 3, 0.5)), XMMatrixTranspose(XMLoadFloat4x4(&main_scene_state.mView)));
 
@@ -1151,12 +2247,11 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 		main_scene_state_cb->SetData(pd3dImmediateContext, main_scene_state);
 
 		light->Draw(effectLight.get(), light_inputLayout.Get(), false, false, [=]{
-			pd3dImmediateContext->VSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
-			pd3dImmediateContext->PSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
+			light_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(effectLight.get()), { main_scene_state_cb->GetBuffer() });
 
 			pd3dImmediateContext->OMSetBlendState(states->Additive(), Colors::Black, 0xFFFFFFFF);
 			pd3dImmediateContext->RSSetState(states->CullClockwise());
-			pd3dImmediateContext->OMSetDepthStencilState(light_depth_stencil_first_pass_state.Get(), 0);
+			pd3dImmediateContext->OMSetDepthStencilState(light_depth_stencil_first_pass_state[depth_mode].Get(), 0);
 		});
 	}
 	if (true){
@@ -1170,24 +2265,24 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 		main_scene_state_cb->SetData(pd3dImmediateContext, main_scene_state);
 
 		light->Draw(effectLight.get(), light_inputLayout.Get(), false, false, [=]{
-			pd3dImmediateContext->VSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
-			pd3dImmediateContext->PSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
+			light_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(effectLight.get()), { main_scene_state_cb->GetBuffer() });
 
 			pd3dImmediateContext->OMSetBlendState(states->Opaque(), Colors::Black, 0xFFFFFFFF);
 			pd3dImmediateContext->RSSetState(states->CullCounterClockwise());
-			pd3dImmediateContext->OMSetDepthStencilState(states->DepthDefault(), 0);
+			pd3dImmediateContext->OMSetDepthStencilState(depth_default_state[depth_mode].Get(), 0);
 		});
 	}
-	pd3dImmediateContext->OMSetRenderTargets(3, renderTargetViewToArray(nullptr, nullptr, nullptr), dsv);
+	pd3dImmediateContext->OMSetRenderTargets(2, null_rtvs, dsv);
+	DXUTFrameStatsEndPass(s_nLightingPass);
 
-	pd3dImmediateContext->OMSetRenderTargets(1, renderTargetViewToArray(DXUTGetD3D11RenderTargetView()), dsv);
+	DXUTFrameStatsBeginPass(s_nPostProcessPass);
+	pd3dImmediateContext->OMSetRenderTargets(1, &light_rtv, read_only_dsv);
 	if (true){
 		ambientPostProcess->Process(pd3dImmediateContext, [=]
 		{
-			pd3dImmediateContext->PSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
-
-			pd3dImmediateContext->PSSetShaderResources(0, 3, shaderResourceViewToArray(srv1.Get(), srv2.Get(), srv3.Get()));
-			pd3dImmediateContext->PSSetSamplers(0, 1, samplerStateToArray(states->LinearWrap()));
+			lighting_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(ambientPostProcess.get()), { main_scene_state_cb->GetBuffer(),
+				point_shadow_state_cb->GetBuffer(), srv1, srv2, srv3, point_shadow_map.GetSrv(), states->LinearWrap(),
+				point_shadow_map.GetComparisonSampler() });
 
 			pd3dImmediateContext->OMSetBlendState(states->Additive(), nullptr, 0xffffffff);
 			pd3dImmediateContext->RSSetState(states->CullNone());
@@ -1198,30 +2293,77 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
 	if (true){
 		postProcess->Process(pd3dImmediateContext, [=]
 		{
-			pd3dImmediateContext->PSSetConstantBuffers(0, 1, constantBuffersToArray(*main_scene_state_cb));
-
-			pd3dImmediateContext->PSSetShaderResources(0, 3, shaderResourceViewToArray(srv1.Get(), srv2.Get(), srv3.Get()));
-			pd3dImmediateContext->PSSetSamplers(0, 1, samplerStateToArray(states->LinearWrap()));
+			lighting_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(postProcess.get()), { main_scene_state_cb->GetBuffer(),
+				point_shadow_state_cb->GetBuffer(), srv1, srv2, srv3, point_shadow_map.GetSrv(), states->LinearWrap(),
+				point_shadow_map.GetComparisonSampler() });
 
 			pd3dImmediateContext->OMSetBlendState(states->Additive(), nullptr, 0xffffffff);
 			pd3dImmediateContext->RSSetState(states->CullNone());
 			pd3dImmediateContext->OMSetDepthStencilState(light_depth_stencil_second_pass_state.Get(), 0);
 		});
 
+	}
+	if (true){
+		directionalLightPostProcess->Process(pd3dImmediateContext, [=]
+		{
+			directional_light_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(directionalLightPostProcess.get()), { main_scene_state_cb->GetBuffer(),
+				shadow_state_cb->GetBuffer(), srv1, srv2, srv3, shadow_map.GetSrv(), states->LinearWrap(), shadow_map.GetComparisonSampler() });
+
+			pd3dImmediateContext->OMSetBlendState(states->Additive(), nullptr, 0xffffffff);
+			pd3dImmediateContext->RSSetState(states->CullNone());
+			pd3dImmediateContext->OMSetDepthStencilState(states->DepthNone(), 0);
+		});
+
 	}
 	{
 		// You can't have the same texture bound as both an input and an output at the same time. The solution is to explicitly clear one binding before applying the new binding.
 
-		ID3D11ShaderResourceView* null[] = { nullptr, nullptr, nullptr };
-		pd3dImmediateContext->PSSetShaderResources(0, 3, null);
+		ID3D11ShaderResourceView* null[] = { nullptr, nullptr, nullptr, nullptr };
+		pd3dImmediateContext->PSSetShaderResources(0, 4, null);
 	}
+	scene_gpu_timer.End(pd3dImmediateContext);
+	{
+		// The frame covers the top-left of the light buffer: copied as is at native resolution,
+		// stretched over the back buffer otherwise
+		ID3D11RenderTargetView* back_buffer_rtv = DXUTGetD3D11RenderTargetView();
+		pd3dImmediateContext->OMSetRenderTargets(1, &back_buffer_rtv, nullptr);
+
+		D3D11_VIEWPORT native_viewport = { 0.0f, 0.0f, (float)frame_targets.GetNativeWidth(), (float)frame_targets.GetNativeHeight(), 0.0f, 1.0f };
+		pd3dImmediateContext->RSSetViewports(1, &native_viewport);
+
+		if (frame_targets.GetWidth() == frame_targets.GetNativeWidth() && frame_targets.GetHeight() == frame_targets.GetNativeHeight())
+		{
+			Microsoft::WRL::ComPtr<ID3D11Resource> back_buffer;
+			DXUTGetD3D11RenderTargetView()->GetResource(back_buffer.GetAddressOf());
+			D3D11_BOX box = { 0, 0, 0, frame_targets.GetWidth(), frame_targets.GetHeight(), 1 };
+			pd3dImmediateContext->CopySubresourceRegion(back_buffer.Get(), 0, 0, 0, 0, frame_targets[FRAME_TARGET_LIGHT].texture.Get(), 0, &box);
+		}
+		else
+		{
+			upsamplePostProcess->Process(pd3dImmediateContext, [=]
+			{
+				upsample_bindings.Apply(pd3dImmediateContext, GetShaderBindingLayout(upsamplePostProcess.get()), { main_scene_state_cb->GetBuffer(),
+					frame_targets[FRAME_TARGET_LIGHT].srv.Get(), states->LinearClamp() });
+
+				pd3dImmediateContext->OMSetBlendState(states->Opaque(), nullptr, 0xffffffff);
+				pd3dImmediateContext->RSSetState(states->CullNone());
+				pd3dImmediateContext->OMSetDepthStencilState(states->DepthNone(), 0);
+			});
+
+			ID3D11ShaderResourceView* null[] = { nullptr };
+			pd3dImmediateContext->PSSetShaderResources(0, 1, null);
+		}
+	}
+	DXUTFrameStatsEndPass(s_nPostProcessPass);
     // If the settings dialog is being shown, then render it instead of rendering the app's scene
     if( g_D3DSettingsDlg.IsActive() )
     {
         g_D3DSettingsDlg.OnRender( fElapsedTime );
+        g_DialogResourceManager.EndFrame11();
         return;
     }
     // Render the HUD
+    DXUTFrameStatsBeginPass( s_nHUDPass );
     if ( g_nRenderHUD > 0 )
     {
         DXUT_BeginPerfEvent( DXUT_PERFEVENTCOLOR, L"HUD / Stats" );
@@ -1233,6 +2375,9 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
         RenderText();
         DXUT_EndPerfEvent();
     }
+    // Draw the UI of all dialogs and text helpers in one batch
+    g_DialogResourceManager.EndFrame11();
+    DXUTFrameStatsEndPass( s_nHUDPass );
 
     // Check if current frame needs to be dumped to disk
     if ( s_dwFrameNumber == g_dwFrameNumberToDump )
@@ -1299,21 +2444,8 @@ void CALLBACK OnD3D11ReleasingSwapChain( void* pUserContext )
 {
     g_DialogResourceManager.OnD3D11ReleasingSwapChain();
 
-	srv1.ReleaseAndGetAddressOf();
-
-	srv2.ReleaseAndGetAddressOf();
-
-	srv3.ReleaseAndGetAddressOf();
-
-	rtv1.ReleaseAndGetAddressOf();
-
-	rtv2.ReleaseAndGetAddressOf();
-
-	rtv3.ReleaseAndGetAddressOf();
-
-	ds_v.ReleaseAndGetAddressOf();
-
-	ds_srv.ReleaseAndGetAddressOf();
+	// Kept by the pool for the next OnD3D11ResizedSwapChain
+	frame_targets.Release(render_target_pool);
 }
 
 
@@ -1325,13 +2457,28 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
 	decal_box = 0;
 	stone_box = 0;
 	teapot = 0;
+	teapot_meshlets.clear();
+	teapot_visible_ranges.clear();
 	light = 0;
 
-	effect = 0;
+	shader_reload.Stop();
+	gbuffer_permutations.DestroyDeviceResources();
+	gbuffer_bindings.Reset();
+	terrain_bindings.Reset();
+	light_bindings.Reset();
+	lighting_bindings.Reset();
+	upsample_bindings.Reset();
+	shadow_bindings.Reset();
+	directional_light_bindings.Reset();
 	effectTBN = 0;
 	postProcess = 0;
 	ambientPostProcess = 0;
+	upsamplePostProcess = 0;
 	effectLight = 0;
+	terrainEffect = 0;
+	shadowEffect = 0;
+	directionalLightPostProcess = 0;
+	pointShadowClearPostProcess = 0;
 
 	states = 0;
 
@@ -1339,20 +2486,39 @@ void CALLBACK OnD3D11DestroyDevice( void* pUserContext )
 	teapot_inputLayout.Reset();
 	teapot_tbn_inputLayout.Reset();
 	light_inputLayout.Reset();
+	terrain_inputLayout.Reset();
+	shadow_inputLayout.Reset();
 
 	decal_srv.ReleaseAndGetAddressOf();
 	decal_nm_srv.ReleaseAndGetAddressOf();
 	stone_srv.ReleaseAndGetAddressOf();
 	stone_nm_srv.ReleaseAndGetAddressOf();
+	stone_pom_srv.ReleaseAndGetAddressOf();
+	stone_pom_nmh_srv.ReleaseAndGetAddressOf();
+	stone_cone_srv.ReleaseAndGetAddressOf();
 	teapot_srv.ReleaseAndGetAddressOf();
 	teapot_nm_srv.ReleaseAndGetAddressOf();
 
 	delete scene_state_cb;
 	delete main_scene_state_cb;
+	delete shadow_state_cb;
+	delete point_shadow_state_cb;
 
-	light_depth_stencil_first_pass_state.ReleaseAndGetAddressOf();
+	for (int mode = 0; mode < DEPTH_MODE_COUNT; ++mode)
+	{
+		depth_default_state[mode].ReleaseAndGetAddressOf();
+		light_depth_stencil_first_pass_state[mode].ReleaseAndGetAddressOf();
+	}
 	light_depth_stencil_second_pass_state.ReleaseAndGetAddressOf();
 	light_depth_stencil_ambient_pass_state.ReleaseAndGetAddressOf();
+	point_shadow_clear_state.ReleaseAndGetAddressOf();
+
+	render_target_pool.Clear();
+	render_target_pool.SetDevice(nullptr);
+	scene_gpu_timer.Destroy();
+	terrain.DestroyDeviceResources();
+	shadow_map.Destroy();
+	point_shadow_map.Destroy();
 	///////////////////////////////////////////////////////////////
     g_DialogResourceManager.OnD3D11DestroyDevice();
     g_D3DSettingsDlg.OnD3D11DestroyDevice();
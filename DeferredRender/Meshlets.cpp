@@ -0,0 +1,215 @@
+#include "DXUT.h"
+#include "Meshlets.h"
+
+using namespace DirectX;
+
+namespace
+{
+	//---------------------------------------------------------------------------------
+	// Bounding sphere and normal cone of one cluster
+	//---------------------------------------------------------------------------------
+	void ComputeMeshletBounds(Meshlet& meshlet, const XMFLOAT3* positions, const uint16_t* indices,
+		const std::vector<uint16_t>& vertices)
+	{
+		XMVECTOR vMin = g_XMFltMax;
+		XMVECTOR vMax = XMVectorNegate(g_XMFltMax);
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			XMVECTOR p = XMLoadFloat3(&positions[vertices[i]]);
+			vMin = XMVectorMin(vMin, p);
+			vMax = XMVectorMax(vMax, p);
+		}
+
+		XMVECTOR center = 0.5f * (vMin + vMax);
+		XMVECTOR radius = XMVectorZero();
+		for (size_t i = 0; i < vertices.size(); ++i)
+			radius = XMVectorMax(radius, XMVector3Length(XMLoadFloat3(&positions[vertices[i]]) - center));
+
+		XMStoreFloat3(&meshlet.center, center);
+		meshlet.radius = XMVectorGetX(radius);
+
+		// Cone axis is the average triangle normal; the cone is unusable if it opens past ~84 degrees
+		const uint16_t* tri = indices + meshlet.startIndex;
+		std::vector<XMFLOAT3> normals(meshlet.triangleCount);
+		XMVECTOR axis = XMVectorZero();
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&positions[tri[t * 3]]);
+			XMVECTOR p1 = XMLoadFloat3(&positions[tri[t * 3 + 1]]);
+			XMVECTOR p2 = XMLoadFloat3(&positions[tri[t * 3 + 2]]);
+			XMVECTOR n = XMVector3Cross(p1 - p0, p2 - p0);
+			n = XMVectorGetX(XMVector3LengthSq(n)) > 0.0f ? XMVector3Normalize(n) : XMVectorZero();
+			XMStoreFloat3(&normals[t], n);
+			axis += n;
+		}
+
+		XMStoreFloat3(&meshlet.coneApex, center);
+		XMStoreFloat3(&meshlet.coneAxis, XMVectorZero());
+		meshlet.coneCutoff = 1.0f;
+
+		if (XMVectorGetX(XMVector3LengthSq(axis)) <= 0.0f)
+			return;
+		axis = XMVector3Normalize(axis);
+
+		float minDot = 1.0f;
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+			minDot = min(minDot, XMVectorGetX(XMVector3Dot(axis, XMLoadFloat3(&normals[t]))));
+
+		if (minDot <= 0.1f)
+			return;
+
+		// Move the apex back along the axis until it lies behind every triangle plane
+		float maxT = 0.0f;
+		for (uint32_t t = 0; t < meshlet.triangleCount; ++t)
+		{
+			XMVECTOR n = XMLoadFloat3(&normals[t]);
+			float dn = XMVectorGetX(XMVector3Dot(axis, n));
+			if (dn <= 0.0f)
+				continue;
+			float dc = XMVectorGetX(XMVector3Dot(center - XMLoadFloat3(&positions[tri[t * 3]]), n));
+			maxT = max(maxT, dc / dn);
+		}
+
+		XMStoreFloat3(&meshlet.coneApex, center - axis * maxT);
+		XMStoreFloat3(&meshlet.coneAxis, axis);
+		meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+	}
+}
+
+//---------------------------------------------------------------------------------
+// Greedy clustering in index order: triangles are appended to the current cluster
+// until the vertex or triangle limit would be exceeded
+//---------------------------------------------------------------------------------
+void BuildMeshlets(const XMFLOAT3* positions, size_t nVerts, std::vector<uint16_t>& indices,
+	std::vector<Meshlet>& meshlets, MeshletBuildStats* stats)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	std::vector<uint16_t> out;
+	out.reserve(indices.size());
+
+	std::vector<int8_t> localIndex(nVerts, -1);
+	std::vector<uint16_t> vertices;
+	vertices.reserve(MESHLET_MAX_VERTICES);
+
+	meshlets.clear();
+
+	Meshlet current = {};
+	size_t totalVertices = 0;
+
+	auto flush = [&]()
+	{
+		if (current.triangleCount == 0)
+			return;
+
+		current.vertexCount = (uint32_t)vertices.size();
+		ComputeMeshletBounds(current, positions, out.data(), vertices);
+		meshlets.push_back(current);
+		totalVertices += vertices.size();
+
+		for (size_t i = 0; i < vertices.size(); ++i)
+			localIndex[vertices[i]] = -1;
+		vertices.clear();
+
+		current = Meshlet();
+		current.startIndex = (uint32_t)out.size();
+	};
+
+	for (size_t t = 0; t + 2 < indices.size(); t += 3)
+	{
+		const uint16_t* tri = &indices[t];
+
+		size_t newVertices = (localIndex[tri[0]] < 0) + (localIndex[tri[1]] < 0) + (localIndex[tri[2]] < 0);
+		if (vertices.size() + newVertices > MESHLET_MAX_VERTICES || current.triangleCount + 1 > MESHLET_MAX_TRIANGLES)
+			flush();
+
+		for (int k = 0; k < 3; ++k)
+		{
+			if (localIndex[tri[k]] < 0)
+			{
+				localIndex[tri[k]] = (int8_t)vertices.size();
+				vertices.push_back(tri[k]);
+			}
+			out.push_back(tri[k]);
+		}
+		++current.triangleCount;
+	}
+	flush();
+
+	indices.swap(out);
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	if (stats)
+	{
+		stats->triangleCount = indices.size() / 3;
+		stats->meshletCount = meshlets.size();
+		stats->averageVertices = meshlets.empty() ? 0.0f : (float)totalVertices / meshlets.size();
+		stats->averageTriangles = meshlets.empty() ? 0.0f : (float)stats->triangleCount / meshlets.size();
+		stats->seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+		stats->secondsPerMillionTriangles = stats->triangleCount ? stats->seconds * 1e6 / stats->triangleCount : 0.0;
+	}
+}
+
+//---------------------------------------------------------------------------------
+void CullMeshlets(const std::vector<Meshlet>& meshlets, const XMFLOAT4X4& world, const XMFLOAT4* frustumPlanes,
+	const XMFLOAT3& eye, std::vector<MeshletIndexRange>& ranges, MeshletCullStats* stats)
+{
+	XMMATRIX mWorld = XMLoadFloat4x4(&world);
+	// Cone axes are normals: they go through the inverse transpose, which keeps them
+	// perpendicular to the surface under non-uniform scale
+	XMMATRIX mNormal = XMMatrixTranspose(XMMatrixInverse(nullptr, mWorld));
+	XMVECTOR vEye = XMLoadFloat3(&eye);
+
+	// Largest axis scale of the instance, for the sphere radius
+	float scale = sqrtf(max(XMVectorGetX(XMVector3LengthSq(mWorld.r[0])),
+		max(XMVectorGetX(XMVector3LengthSq(mWorld.r[1])), XMVectorGetX(XMVector3LengthSq(mWorld.r[2])))));
+
+	ranges.clear();
+
+	MeshletCullStats s = {};
+	s.meshletCount = meshlets.size();
+
+	for (size_t i = 0; i < meshlets.size(); ++i)
+	{
+		const Meshlet& m = meshlets[i];
+		s.triangleCount += m.triangleCount;
+
+		XMVECTOR center = XMVector3TransformCoord(XMLoadFloat3(&m.center), mWorld);
+		float radius = m.radius * scale;
+
+		bool outside = false;
+		for (int p = 0; p < 6 && !outside; ++p)
+			outside = XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&frustumPlanes[p]), center)) < -radius;
+		if (outside)
+		{
+			s.frustumCulledTriangles += m.triangleCount;
+			continue;
+		}
+
+		if (m.coneCutoff < 1.0f)
+		{
+			XMVECTOR apex = XMVector3TransformCoord(XMLoadFloat3(&m.coneApex), mWorld);
+			XMVECTOR axis = XMVector3Normalize(XMVector3TransformNormal(XMLoadFloat3(&m.coneAxis), mNormal));
+			if (XMVectorGetX(XMVector3Dot(XMVector3Normalize(apex - vEye), axis)) >= m.coneCutoff)
+			{
+				s.backfaceCulledTriangles += m.triangleCount;
+				continue;
+			}
+		}
+
+		++s.visibleMeshletCount;
+
+		// Clusters are contiguous in the index buffer, so neighbours merge into one draw
+		if (!ranges.empty() && ranges.back().startIndex + ranges.back().indexCount == m.startIndex)
+			ranges.back().indexCount += m.triangleCount * 3;
+		else
+			ranges.push_back({ m.startIndex, m.triangleCount * 3 });
+	}
+
+	s.rangeCount = ranges.size();
+	if (stats)
+		*stats = s;
+}
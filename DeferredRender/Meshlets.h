@@ -0,0 +1,68 @@
+//--------------------------------------------------------------------------------------
+// File: Meshlets.h
+//
+// Splits an indexed triangle list into clusters (meshlets) of at most
+// MESHLET_MAX_VERTICES vertices and MESHLET_MAX_TRIANGLES triangles, each with a
+// bounding sphere and a normal cone, and culls the clusters on the CPU per view.
+//--------------------------------------------------------------------------------------
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+#include <stdint.h>
+#include <DirectXMath.h>
+
+#define MESHLET_MAX_VERTICES  64
+#define MESHLET_MAX_TRIANGLES 124
+
+struct Meshlet
+{
+	uint32_t startIndex;                // First index of the cluster in the reordered index buffer
+	uint32_t triangleCount;
+	uint32_t vertexCount;               // Unique vertices referenced by the cluster
+
+	DirectX::XMFLOAT3 center;           // Bounding sphere (object space)
+	float radius;
+
+	DirectX::XMFLOAT3 coneApex;         // Normal cone (object space); the cluster faces away from
+	DirectX::XMFLOAT3 coneAxis;         // the eye if dot(normalize(apex - eye), axis) >= cutoff
+	float coneCutoff;
+};
+
+struct MeshletIndexRange
+{
+	uint32_t startIndex;
+	uint32_t indexCount;
+};
+
+struct MeshletBuildStats
+{
+	size_t triangleCount;
+	size_t meshletCount;
+	float averageVertices;              // Per meshlet
+	float averageTriangles;             // Per meshlet
+	double seconds;
+	double secondsPerMillionTriangles;
+};
+
+struct MeshletCullStats
+{
+	size_t meshletCount;
+	size_t visibleMeshletCount;
+	size_t triangleCount;
+	size_t frustumCulledTriangles;
+	size_t backfaceCulledTriangles;
+	size_t rangeCount;                  // Draw calls after merging adjacent visible clusters
+};
+
+// Builds the clusters of a triangle list. indices is reordered so that every cluster is a contiguous range.
+void BuildMeshlets(const DirectX::XMFLOAT3* positions, size_t nVerts, std::vector<uint16_t>& indices,
+	std::vector<Meshlet>& meshlets, MeshletBuildStats* stats = nullptr);
+
+// Culls the clusters of one instance against six world space frustum planes (inside is positive)
+// and the eye position, and emits the index ranges of the surviving clusters.
+void CullMeshlets(const std::vector<Meshlet>& meshlets, const DirectX::XMFLOAT4X4& world,
+	const DirectX::XMFLOAT4* frustumPlanes, const DirectX::XMFLOAT3& eye,
+	std::vector<MeshletIndexRange>& ranges, MeshletCullStats* stats = nullptr);
+
+#endif
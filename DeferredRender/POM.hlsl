@@ -6,6 +6,16 @@
 // Copyright (c) Microsoft Corporation. All rights reserved.
 //--------------------------------------------------------------------------------------
 #include "Shader_include.hlsl"
+
+#ifdef RELAXED_CONE_STEP_MAPPING
+#ifndef CONE_STEPS
+#define CONE_STEPS 12
+#endif
+#ifndef BINARY_SEARCH_STEPS
+#define BINARY_SEARCH_STEPS 6
+#endif
+Texture2D g_coneStepTexture : register( t3 );   // Depth and square root of the cone ratio (CONE_STEP_MAP_SLOT)
+#endif
            
 //--------------------------------------------------------------------------------------
 // Structures
@@ -107,6 +117,50 @@ VS_OUTPUT RenderSceneVS( VS_INPUT i )
    return Out;
 }   
 
+#ifdef RELAXED_CONE_STEP_MAPPING
+//--------------------------------------------------------------------------------------
+// Relaxed cone stepping. From the top of the height field the ray jumps to the edge of
+// the cone of the texel it is over, which it can leave at most once through the surface,
+// then a binary search finds the crossing. Returns the depth of the displaced point along
+// the parallax offset. ConeStepMap.cpp builds the cones and has a CPU reference of this.
+//--------------------------------------------------------------------------------------
+float RelaxedConeStepDepth( float2 texCoord, float2 vParallaxOffsetTS, float2 dx, float2 dy )
+{
+   float2 vConeMapSize;
+   g_coneStepTexture.GetDimensions( vConeMapSize.x, vConeMapSize.y );
+
+   float fDistanceFactor = length( vParallaxOffsetTS );
+   float fDepth = 0.0;
+
+   for ( int nStepIndex = 0; nStepIndex < CONE_STEPS; nStepIndex++ )
+   {
+      // Depth and cone of the texel, unfiltered and wrapped
+      float2 vCone = g_coneStepTexture.Load( int3( frac( texCoord - vParallaxOffsetTS * fDepth ) * vConeMapSize, 0 ) ).xy;
+      float fConeRatio = vCone.y * vCone.y;
+      float fAbove = saturate( vCone.x - fDepth );
+      if ( fAbove <= 0.0 )
+         break;
+
+      fDepth += fConeRatio * fAbove / ( fDistanceFactor + fConeRatio );
+   }
+
+   // The ray crossed the surface at most once on [0, fDepth]. The range reaches two texels
+   // further, for rays that stalled just short of a steep wall.
+   fDepth = min( fDepth + 2.0 / ( fDistanceFactor * max( vConeMapSize.x, vConeMapSize.y ) + 1e-6 ), 1.0 );
+   float fRange = 0.5 * fDepth;
+   float fPosition = fRange;
+
+   for ( int nSearchIndex = 0; nSearchIndex < BINARY_SEARCH_STEPS; nSearchIndex++ )
+   {
+      float fSurface = 1.0 - g_nmhTexture.SampleGrad( g_samLinear, texCoord - vParallaxOffsetTS * fPosition, dx, dy ).a;
+      fRange *= 0.5;
+      fPosition += ( fPosition < fSurface ) ? fRange : -fRange;
+   }
+
+   return fPosition;
+}
+#endif
+
 //--------------------------------------------------------------------------------------
 // Parallax occlusion mapping pixel shader
 //--------------------------------------------------------------------------------------
@@ -128,6 +182,9 @@ float4 RenderScenePS( PS_INPUT i ) : SV_TARGET
    // Parallax occlusion mapping offset computation //
    //===============================================//
 
+#ifdef RELAXED_CONE_STEP_MAPPING
+   float2 vParallaxOffset = i.vParallaxOffsetTS * RelaxedConeStepDepth( i.texCoord, i.vParallaxOffsetTS, dx, dy );
+#else
    // Utilize dynamic flow control to change the number of samples per ray 
    // depending on the viewing angle for the surface. Oblique angles require 
    // smaller step sizes to achieve more accurate precision for computing displacement.
@@ -206,6 +263,7 @@ float4 RenderScenePS( PS_INPUT i ) : SV_TARGET
    }
    
    float2 vParallaxOffset = i.vParallaxOffsetTS * ( 1.0 - fParallaxAmount );
+#endif
 
    // The computed texture offset for the displaced point on the pseudo-extruded surface:
    float2 texSample = i.texCoord - vParallaxOffset;
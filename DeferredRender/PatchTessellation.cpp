@@ -0,0 +1,359 @@
+#include "DXUT.h"
+#include "PatchTessellation.h"
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// DISTANCE_ADAPTIVE_TESSELLATION range in the VS
+	const float MIN_DISTANCE = 20.0f;
+	const float MAX_DISTANCE = 250.0f;
+
+	size_t BatchCount(size_t count)
+	{
+		return (count + PATCH_TESSELLATION_BATCH_SIZE - 1) / PATCH_TESSELLATION_BATCH_SIZE;
+	}
+
+	// The tessellator discards a patch if an edge factor is zero, negative or NaN
+	bool HasZeroEdgeFactor(const XMFLOAT4& factors)
+	{
+		return !(factors.x > 0.0f && factors.y > 0.0f && factors.z > 0.0f);
+	}
+}
+
+//---------------------------------------------------------------------------------
+PatchTessellator::PatchTessellator()
+{
+}
+
+void PatchTessellator::SetPatches(const void* positions, UINT stride, size_t vertexCount, const uint16_t* indices,
+	size_t patchCount, const XMFLOAT4* edgeDensities)
+{
+	this->positions.resize(vertexCount);
+	for (size_t i = 0; i < vertexCount; ++i)
+		this->positions[i] = *(const XMFLOAT3*)((const BYTE*)positions + i * stride);
+
+	this->indices.assign(indices, indices + patchCount * 3);
+
+	if (edgeDensities)
+		this->edgeDensities.assign(edgeDensities, edgeDensities + patchCount);
+	else
+		this->edgeDensities.assign(patchCount, XMFLOAT4(1.0f, 1.0f, 1.0f, 1.0f));
+
+	vertexData.resize(vertexCount);
+	patchFactors.resize(patchCount);
+	patchVisible.resize(patchCount);
+	batches.resize(BatchCount(patchCount));
+	visibleIndices.reserve(patchCount * 3);
+	factors.reserve(patchCount);
+}
+
+//---------------------------------------------------------------------------------
+// Three parallel passes: per vertex (world position, distance factor, screen
+// position, frustum plane mask), per patch (factors and visibility, counted per
+// batch) and, after a prefix sum over the batches, the compaction.  The plane
+// mask makes the frustum test of a patch an OR of three masks: every plane has to
+// be passed by at least one vertex.
+//---------------------------------------------------------------------------------
+void PatchTessellator::Update(const PatchTessellationSettings& settings, PatchTessellationStats* stats)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	const XMMATRIX world = XMLoadFloat4x4(&settings.world);
+	const XMMATRIX viewProjection = XMLoadFloat4x4(&settings.viewProjection);
+	const XMVECTOR eye = XMLoadFloat3(&settings.eye);
+	const XMVECTOR tessellationFactor = XMLoadFloat4(&settings.tessellationFactor);
+	const XMVECTOR edgeFactorScale = XMVectorSwizzle<0, 0, 0, 1>(tessellationFactor);
+	const XMVECTOR screenScale = XMVectorSet(0.5f * settings.screenWidth, -0.5f * settings.screenHeight, 0.0f, 0.0f);
+	const XMVECTOR cullEpsilon = XMVectorReplicate(-settings.cullEpsilon);
+	const XMVECTORU32 planeBits = { { { 1, 2, 4, 8 } } };
+	const float maxReduction = 1.0f - settings.tessellationFactor.z / settings.tessellationFactor.x;
+
+	// Planes as columns so that one multiply-add chain gives the distance to all four
+	XMMATRIX planes(XMLoadFloat4(&settings.frustumPlanes[0]), XMLoadFloat4(&settings.frustumPlanes[1]),
+		XMLoadFloat4(&settings.frustumPlanes[2]), XMLoadFloat4(&settings.frustumPlanes[3]));
+	planes = XMMatrixTranspose(planes);
+
+	const size_t vertexCount = positions.size();
+	concurrency::parallel_for((size_t)0, BatchCount(vertexCount), [&](size_t batch)
+	{
+		size_t first = batch * PATCH_TESSELLATION_BATCH_SIZE;
+		size_t last = min(first + PATCH_TESSELLATION_BATCH_SIZE, vertexCount);
+		for (size_t i = first; i < last; ++i)
+		{
+			VertexData& data = vertexData[i];
+			XMVECTOR p = XMVector3TransformNormal(XMLoadFloat3(&positions[i]), world);
+
+			data.distanceFactor = 1.0f;
+			if (settings.mode == PATCH_TESSELLATION_DISTANCE_ADAPTIVE)
+			{
+				float distance = XMVectorGetX(XMVector3Length(p - eye));
+				data.distanceFactor = 1.0f - min(max((distance - MIN_DISTANCE) / (MAX_DISTANCE - MIN_DISTANCE), 0.0f), maxReduction);
+			}
+
+			if (settings.mode == PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE)
+			{
+				XMVECTOR clip = XMVector3Transform(p, viewProjection);
+				XMVECTOR screen = (clip / XMVectorSplatW(clip) + g_XMOne) * screenScale;
+				XMStoreFloat2(&data.screen, screen);
+			}
+
+			data.planeMask = 0xF;
+			if (settings.frustumCulling)
+			{
+				XMVECTOR distances = XMVectorMultiplyAdd(XMVectorSplatX(p), planes.r[0],
+					XMVectorMultiplyAdd(XMVectorSplatY(p), planes.r[1],
+					XMVectorMultiplyAdd(XMVectorSplatZ(p), planes.r[2], planes.r[3])));
+				XMUINT4 bits;
+				XMStoreUInt4(&bits, XMVectorAndInt(XMVectorGreater(distances, cullEpsilon), planeBits));
+				data.planeMask = bits.x | bits.y | bits.z | bits.w;
+			}
+		}
+	});
+
+	const size_t patchCount = patchFactors.size();
+	concurrency::parallel_for((size_t)0, batches.size(), [&](size_t batch)
+	{
+		BatchData& counts = batches[batch];
+		counts.visible = counts.frustumCulled = counts.zeroFactor = 0;
+
+		size_t first = batch * PATCH_TESSELLATION_BATCH_SIZE;
+		size_t last = min(first + PATCH_TESSELLATION_BATCH_SIZE, patchCount);
+		for (size_t i = first; i < last; ++i)
+		{
+			const VertexData& v0 = vertexData[indices[i * 3]];
+			const VertexData& v1 = vertexData[indices[i * 3 + 1]];
+			const VertexData& v2 = vertexData[indices[i * 3 + 2]];
+
+			patchVisible[i] = 0;
+			if ((v0.planeMask | v1.planeMask | v2.planeMask) != 0xF)
+			{
+				patchFactors[i] = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+				counts.frustumCulled++;
+				continue;
+			}
+
+			XMVECTOR edgeFactors = edgeFactorScale;
+			if (settings.mode == PATCH_TESSELLATION_DISTANCE_ADAPTIVE)
+			{
+				// Edges are opposite to the vertices: x = 1-2, y = 2-0, z = 0-1, inside = x
+				XMVECTOR a = XMVectorSet(v1.distanceFactor, v2.distanceFactor, v0.distanceFactor, v1.distanceFactor);
+				XMVECTOR b = XMVectorSet(v2.distanceFactor, v0.distanceFactor, v1.distanceFactor, v2.distanceFactor);
+				edgeFactors = (a + b) * g_XMOneHalf * edgeFactorScale;
+			}
+			else if (settings.mode == PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE)
+			{
+				XMVECTOR dx = XMVectorSet(v2.screen.x - v1.screen.x, v2.screen.x - v0.screen.x, v0.screen.x - v1.screen.x, 0.0f);
+				XMVECTOR dy = XMVectorSet(v2.screen.y - v1.screen.y, v2.screen.y - v0.screen.y, v0.screen.y - v1.screen.y, 0.0f);
+				edgeFactors = XMVectorSqrt(dx * dx + dy * dy) * XMVectorSplatW(tessellationFactor);
+				XMVECTOR sum = XMVectorSplatX(edgeFactors) + XMVectorSplatY(edgeFactors) + XMVectorSplatZ(edgeFactors);
+				edgeFactors = XMVectorSelect(edgeFactors, sum * 0.33f, g_XMSelect0001);
+			}
+
+			if (settings.densityBased)
+				edgeFactors *= XMVectorSwizzle<1, 2, 0, 3>(XMLoadFloat4(&edgeDensities[i]));
+
+			XMStoreFloat4(&patchFactors[i], edgeFactors);
+			if (HasZeroEdgeFactor(patchFactors[i]))
+			{
+				counts.zeroFactor++;
+				continue;
+			}
+
+			patchVisible[i] = 1;
+			counts.visible++;
+		}
+	});
+
+	uint32_t visibleCount = 0;
+	size_t frustumCulled = 0, zeroFactor = 0;
+	for (size_t batch = 0; batch < batches.size(); ++batch)
+	{
+		batches[batch].offset = visibleCount;
+		visibleCount += batches[batch].visible;
+		frustumCulled += batches[batch].frustumCulled;
+		zeroFactor += batches[batch].zeroFactor;
+	}
+
+	visibleIndices.resize(visibleCount * 3);
+	factors.resize(visibleCount);
+	concurrency::parallel_for((size_t)0, batches.size(), [&](size_t batch)
+	{
+		size_t out = batches[batch].offset;
+		size_t first = batch * PATCH_TESSELLATION_BATCH_SIZE;
+		size_t last = min(first + PATCH_TESSELLATION_BATCH_SIZE, patchCount);
+		for (size_t i = first; i < last; ++i)
+		{
+			if (!patchVisible[i])
+				continue;
+			visibleIndices[out * 3] = indices[i * 3];
+			visibleIndices[out * 3 + 1] = indices[i * 3 + 1];
+			visibleIndices[out * 3 + 2] = indices[i * 3 + 2];
+			factors[out] = patchFactors[i];
+			out++;
+		}
+	});
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	if (stats)
+	{
+		stats->patchCount = patchCount;
+		stats->visiblePatchCount = visibleCount;
+		stats->frustumCulledPatches = frustumCulled;
+		stats->zeroFactorPatches = zeroFactor;
+		stats->seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+	}
+}
+
+//---------------------------------------------------------------------------------
+HRESULT PatchTessellator::CreateBuffers(ID3D11Device* device)
+{
+	HRESULT hr;
+
+	UINT patchCount = max((UINT)patchFactors.size(), 1u);
+
+	CD3D11_BUFFER_DESC indexDesc(patchCount * 3 * sizeof(uint16_t), D3D11_BIND_INDEX_BUFFER, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	V_RETURN(device->CreateBuffer(&indexDesc, nullptr, indexBuffer.ReleaseAndGetAddressOf()));
+	DXUT_SetDebugName(indexBuffer.Get(), "Visible patch IB");
+
+	CD3D11_BUFFER_DESC factorsDesc(patchCount * sizeof(XMFLOAT4), D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	V_RETURN(device->CreateBuffer(&factorsDesc, nullptr, factorsBuffer.ReleaseAndGetAddressOf()));
+	DXUT_SetDebugName(factorsBuffer.Get(), "Patch tessellation factors");
+
+	CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc(D3D11_SRV_DIMENSION_BUFFER, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, patchCount);
+	V_RETURN(device->CreateShaderResourceView(factorsBuffer.Get(), &srvDesc, factorsSRV.ReleaseAndGetAddressOf()));
+
+	return S_OK;
+}
+
+void PatchTessellator::DestroyBuffers()
+{
+	factorsSRV.Reset();
+	factorsBuffer.Reset();
+	indexBuffer.Reset();
+}
+
+HRESULT PatchTessellator::Upload(ID3D11DeviceContext* context)
+{
+	HRESULT hr;
+
+	if (!indexBuffer || factors.empty())
+		return S_OK;
+
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	V_RETURN(context->Map(indexBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, visibleIndices.data(), visibleIndices.size() * sizeof(uint16_t));
+	context->Unmap(indexBuffer.Get(), 0);
+
+	V_RETURN(context->Map(factorsBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped));
+	memcpy(mapped.pData, factors.data(), factors.size() * sizeof(XMFLOAT4));
+	context->Unmap(factorsBuffer.Get(), 0);
+
+	return S_OK;
+}
+
+
+//---------------------------------------------------------------------------------
+void CreatePatchTessellationGrid(UINT size, float spacing, std::vector<XMFLOAT3>& positions, std::vector<uint16_t>& indices)
+{
+	size = min(size, 255u);
+	UINT vertexCount = size + 1;
+	float origin = -0.5f * size * spacing;
+
+	positions.resize(vertexCount * vertexCount);
+	for (UINT z = 0; z < vertexCount; ++z)
+		for (UINT x = 0; x < vertexCount; ++x)
+			positions[z * vertexCount + x] = XMFLOAT3(origin + x * spacing, 0.0f, origin + z * spacing);
+
+	indices.resize(size * size * 6);
+	uint16_t* index = indices.data();
+	for (UINT z = 0; z < size; ++z)
+	{
+		for (UINT x = 0; x < size; ++x)
+		{
+			uint16_t i0 = (uint16_t)(z * vertexCount + x);
+			uint16_t i1 = (uint16_t)(i0 + 1);
+			uint16_t i2 = (uint16_t)(i0 + vertexCount);
+			uint16_t i3 = (uint16_t)(i2 + 1);
+			*index++ = i0; *index++ = i2; *index++ = i1;
+			*index++ = i1; *index++ = i2; *index++ = i3;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------
+// The planes are those of g_vFrustumPlaneEquation: left, right, top and bottom of
+// the row vector view-projection, inside is positive
+//---------------------------------------------------------------------------------
+void SetPatchTessellationView(PatchTessellationSettings& settings, const XMFLOAT3& eye, const XMFLOAT3& focus,
+	float fovY, float screenWidth, float screenHeight)
+{
+	XMMATRIX view = XMMatrixLookAtLH(XMLoadFloat3(&eye), XMLoadFloat3(&focus), XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f));
+	XMMATRIX projection = XMMatrixPerspectiveFovLH(fovY, screenWidth / screenHeight, 0.1f, 1000.0f);
+	XMStoreFloat4x4(&settings.viewProjection, view * projection);
+	settings.eye = eye;
+	settings.screenWidth = screenWidth;
+	settings.screenHeight = screenHeight;
+
+	const XMFLOAT4X4& m = settings.viewProjection;
+	settings.frustumPlanes[0] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+	settings.frustumPlanes[1] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+	settings.frustumPlanes[2] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+	settings.frustumPlanes[3] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+}
+
+//---------------------------------------------------------------------------------
+PatchTessellationBenchmarkResult BenchmarkPatchTessellation(UINT gridSize, UINT frames)
+{
+	PatchTessellationBenchmarkResult result;
+	ZeroMemory(&result, sizeof(result));
+	result.frames = frames;
+	if (frames == 0)
+		return result;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<uint16_t> indices;
+	CreatePatchTessellationGrid(gridSize, 1.0f, positions, indices);
+
+	PatchTessellator tessellator;
+	tessellator.SetPatches(positions.data(), sizeof(XMFLOAT3), positions.size(), indices.data(), indices.size() / 3, nullptr);
+
+	PatchTessellationSettings settings;
+	ZeroMemory(&settings, sizeof(settings));
+	XMStoreFloat4x4(&settings.world, XMMatrixIdentity());
+	settings.tessellationFactor = XMFLOAT4(7.0f, 7.0f, 1.0f, 1.0f / 8.0f);     // 8 pixel edges
+	settings.mode = PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE;
+	settings.frustumCulling = true;
+
+	double totalMilliseconds = 0.0;
+	double visible = 0.0;
+	result.minMilliseconds = DBL_MAX;
+	float radius = 0.25f * gridSize;
+	for (UINT frame = 0; frame < frames; ++frame)
+	{
+		// Circling at a fixed height, looking along the circle and a little down
+		float angle = XM_2PI * frame / frames;
+		XMFLOAT3 eye(radius * cosf(angle), 15.0f, radius * sinf(angle));
+		XMFLOAT3 focus(eye.x - sinf(angle), eye.y - 0.3f, eye.z + cosf(angle));
+		SetPatchTessellationView(settings, eye, focus, XM_PIDIV4, 1920.0f, 1080.0f);
+
+		PatchTessellationStats stats;
+		tessellator.Update(settings, &stats);
+
+		double milliseconds = stats.seconds * 1000.0;
+		totalMilliseconds += milliseconds;
+		result.minMilliseconds = min(result.minMilliseconds, milliseconds);
+		result.maxMilliseconds = max(result.maxMilliseconds, milliseconds);
+		visible += (double)stats.visiblePatchCount / max(stats.patchCount, (size_t)1);
+		result.patchCount = stats.patchCount;
+	}
+
+	result.averageMilliseconds = totalMilliseconds / frames;
+	result.visibleFraction = (float)(visible / frames);
+	result.patchesPerMillisecond = result.averageMilliseconds > 0.0 ? result.patchCount / result.averageMilliseconds : 0.0;
+	return result;
+}
@@ -0,0 +1,143 @@
+//--------------------------------------------------------------------------------------
+// File: PatchTessellation.h
+//
+// CPU pre-pass for the detail tessellation grid.  Computes the tessellation factors of
+// every patch the way ConstantsHS in DetailTessellation11.hlsl does (distance adaptive,
+// screen space adaptive, density based, frustum culling), drops the patches that the
+// tessellator would discard and compacts the rest into an index list.  The hull shader
+// compiled with PRECOMPUTED_TESSELLATION_FACTORS loads the factors of patch
+// SV_PrimitiveID from the factors buffer instead of computing them.
+//
+// Tests/TestPatchTessellation.cpp checks the factors against a scalar port of the HLSL.
+//--------------------------------------------------------------------------------------
+#ifndef PATCH_TESSELLATION_H
+#define PATCH_TESSELLATION_H
+
+#include <vector>
+#include <stdint.h>
+#include <wrl.h>
+#include <DirectXMath.h>
+
+#define PATCH_TESSELLATION_BATCH_SIZE 1024      // Vertices or patches per parallel task
+
+enum PatchTessellationMode
+{
+	PATCH_TESSELLATION_UNIFORM,
+	PATCH_TESSELLATION_DISTANCE_ADAPTIVE,       // DISTANCE_ADAPTIVE_TESSELLATION
+	PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE,   // SCREEN_SPACE_ADAPTIVE_TESSELLATION
+};
+
+// The constants ConstantsHS reads, matrices in row vector form (before the transpose into cbMain)
+struct PatchTessellationSettings
+{
+	DirectX::XMFLOAT4X4 world;                  // g_mWorld; like the VS, only its 3x3 part moves the vertices
+	DirectX::XMFLOAT4X4 viewProjection;         // g_mViewProjection
+	DirectX::XMFLOAT3 eye;                      // g_vEye
+	DirectX::XMFLOAT4 frustumPlanes[4];         // g_vFrustumPlaneEquation: left, right, top, bottom
+	DirectX::XMFLOAT4 tessellationFactor;       // g_vTessellationFactor
+	float cullEpsilon;                          // g_vDetailTessellationHeightScale.x
+	float screenWidth, screenHeight;            // g_vScreenResolution
+	PatchTessellationMode mode;
+	bool densityBased;                          // DENSITY_BASED_TESSELLATION
+	bool frustumCulling;                        // FRUSTUM_CULLING_OPTIMIZATION
+};
+
+struct PatchTessellationStats
+{
+	size_t patchCount;
+	size_t visiblePatchCount;
+	size_t frustumCulledPatches;
+	size_t zeroFactorPatches;                   // Culled by the tessellator for a factor <= 0
+	double seconds;
+};
+
+class PatchTessellator
+{
+public:
+	PatchTessellator();
+
+	// Copies the object space positions of the grid (stride in bytes, position first) and its
+	// triangle list.  edgeDensities holds one float4 per patch as CreateEdgeDensityVertexStream
+	// writes them, it can be null if the tessellation is never density based.
+	void SetPatches(const void* positions, UINT stride, size_t vertexCount, const uint16_t* indices, size_t patchCount,
+		const DirectX::XMFLOAT4* edgeDensities);
+
+	// Recomputes the visible patches and their factors for one view
+	void Update(const PatchTessellationSettings& settings, PatchTessellationStats* stats = nullptr);
+
+	// Dynamic index buffer and factors buffer sized for every patch of the grid
+	HRESULT CreateBuffers(ID3D11Device* device);
+	void DestroyBuffers();
+	HRESULT Upload(ID3D11DeviceContext* context);
+
+	ID3D11Buffer* GetIndexBuffer() const { return indexBuffer.Get(); }
+	ID3D11ShaderResourceView* GetFactorsSRV() const { return factorsSRV.Get(); }
+	UINT GetVisibleIndexCount() const { return (UINT)visibleIndices.size(); }
+
+	// Three indices and one factor (edges in xyz, inside in w) per visible patch, in the same order
+	const std::vector<uint16_t>& GetVisibleIndices() const { return visibleIndices; }
+	const std::vector<DirectX::XMFLOAT4>& GetFactors() const { return factors; }
+
+	const std::vector<DirectX::XMFLOAT3>& GetPositions() const { return positions; }
+	const std::vector<uint16_t>& GetIndices() const { return indices; }
+	const std::vector<DirectX::XMFLOAT4>& GetEdgeDensities() const { return edgeDensities; }
+
+private:
+	struct VertexData
+	{
+		DirectX::XMFLOAT2 screen;
+		float distanceFactor;
+		uint32_t planeMask;                     // Bit i is set if the vertex passes plane i
+	};
+
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<uint16_t> indices;
+	std::vector<DirectX::XMFLOAT4> edgeDensities;
+
+	struct BatchData
+	{
+		uint32_t visible;
+		uint32_t frustumCulled;
+		uint32_t zeroFactor;
+		uint32_t offset;                        // First compacted patch of the batch
+	};
+
+	std::vector<VertexData> vertexData;
+	std::vector<DirectX::XMFLOAT4> patchFactors;    // Per patch of the grid
+	std::vector<uint8_t> patchVisible;
+	std::vector<BatchData> batches;
+
+	std::vector<uint16_t> visibleIndices;
+	std::vector<DirectX::XMFLOAT4> factors;
+
+	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> factorsBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> factorsSRV;
+};
+
+// Flat grid of size x size quads in the xz plane, two patches each, centered on the origin.
+// size is at most 255 to keep the indices 16 bit.
+void CreatePatchTessellationGrid(UINT size, float spacing, std::vector<DirectX::XMFLOAT3>& positions,
+	std::vector<uint16_t>& indices);
+
+// Sets the view dependent members of settings for a camera at eye looking at focus: the
+// view-projection, the eye and the four side planes of the frustum
+void SetPatchTessellationView(PatchTessellationSettings& settings, const DirectX::XMFLOAT3& eye,
+	const DirectX::XMFLOAT3& focus, float fovY, float screenWidth, float screenHeight);
+
+struct PatchTessellationBenchmarkResult
+{
+	UINT frames;
+	size_t patchCount;
+	float visibleFraction;              // Mean over the frames
+	double averageMilliseconds;         // Update time per frame
+	double minMilliseconds;
+	double maxMilliseconds;
+	double patchesPerMillisecond;
+};
+
+// Updates a gridSize x gridSize grid with screen space adaptive factors and frustum culling
+// for a camera circling low over it, frames times
+PatchTessellationBenchmarkResult BenchmarkPatchTessellation(UINT gridSize, UINT frames);
+
+#endif
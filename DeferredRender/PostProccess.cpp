@@ -18,6 +18,8 @@
 #include "Grid_Creation11.h"
 #include <wrl.h>
 #include "ConstantBuffer.h"
+#include "ShaderReload.h"
+#include "ShaderBindings.h"
 #include <map>
 #include <algorithm>
 
@@ -56,20 +58,28 @@ struct EffectShaderFileDef{
 	WCHAR * shader_ver;
 };
 
-class PostProcess : public IPostProcess{
+class PostProcess : public IPostProcess, public IShaderReloadTarget, public IShaderBindingSource{
 protected:
 	Microsoft::WRL::ComPtr<ID3D11VertexShader> vs;
 
 	Microsoft::WRL::ComPtr<ID3D11PixelShader>  ps;
+
+	ShaderBindingLayout bindings;
+
+	ShaderReloadService* reload;
+
+	UINT reloadId;
 public:
 	//Constructor
-	PostProcess(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef){
+	PostProcess(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef, ShaderReloadService* reload) : reload(reload), reloadId(0){
 		std::map<const WCHAR*, ID3D11DeviceChild*> shaders;
+		std::vector<ShaderStageSource> sources;
 
-		std::for_each(fileDef.begin(), fileDef.end(), [device, &shaders](std::pair<const WCHAR*, EffectShaderFileDef> p) {
+		std::for_each(fileDef.begin(), fileDef.end(), [this, device, &shaders, &sources](std::pair<const WCHAR*, EffectShaderFileDef> p) {
 			std::wstring_convert<std::codecvt_utf8_utf16<wchar_t>> converter;
 
 			ID3D11DeviceChild* pShader;
+			Microsoft::WRL::ComPtr<ID3DBlob> blob;
 
 			if (FAILED(CreateShaderFromFile(
 				device,
@@ -82,21 +92,47 @@ public:
 				0,
 				NULL,
 				&pShader,
-				NULL,
+				blob.GetAddressOf(),
 				false
 			)))
 			   throw std::exception("HlslEffect");
 
+			if (FAILED(this->bindings.SetStage(p.first, blob.Get())))
+				throw std::exception("HlslEffect");
+
 			shaders.insert(std::pair<const WCHAR*, ID3D11DeviceChild*>(p.first, pShader));
+
+			ShaderStageSource source = { p.first, p.second.name, converter.to_bytes(p.second.entry_point), converter.to_bytes(p.second.shader_ver) };
+			sources.push_back(source);
 		});
 
 		vs.Attach((ID3D11VertexShader*)shaders[L"VS"]);
 		ps.Attach((ID3D11PixelShader*)shaders[L"PS"]);
+
+		// The full screen quad has no input layout, so its vertex shader may change freely
+		if (reload)
+			reloadId = reload->Register(this, sources);
 	}
 
 	//Destructor
 	virtual ~PostProcess() {
-	
+		if (reload)
+			reload->Unregister(reloadId);
+	}
+
+	//IShaderReloadTarget
+	virtual void __cdecl ReplaceShaders(const std::vector<ReloadedShader>& shaders) {
+		std::for_each(shaders.begin(), shaders.end(), [this](const ReloadedShader& s) {
+			if (s.stage == L"VS") s.shader.As(&vs);
+			else if (s.stage == L"PS") s.shader.As(&ps);
+
+			bindings.SetStage(s.stage, s.blob.Get());
+		});
+	}
+
+	//IShaderBindingSource
+	virtual const ShaderBindingLayout& __cdecl GetBindingLayout() const {
+		return bindings;
 	}
 
 	//IPostProcess
@@ -121,6 +157,6 @@ public:
 	};
 };
 
-std::unique_ptr<IPostProcess> createPostProcess(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef){
-	return std::unique_ptr<IPostProcess>(new PostProcess(device, fileDef));
+std::unique_ptr<IPostProcess> createPostProcess(ID3D11Device* device, std::map<const WCHAR*, EffectShaderFileDef>& fileDef, ShaderReloadService* reload){
+	return std::unique_ptr<IPostProcess>(new PostProcess(device, fileDef, reload));
 }
@@ -0,0 +1,251 @@
+#include "DXUT.h"
+#include "RenderTargetPool.h"
+
+namespace
+{
+	UINT BytesPerPixel(DXGI_FORMAT format)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_R32G32B32A32_FLOAT:
+		case DXGI_FORMAT_R32G32B32A32_UINT:
+			return 16;
+		case DXGI_FORMAT_R16G16B16A16_FLOAT:
+		case DXGI_FORMAT_R16G16B16A16_UNORM:
+		case DXGI_FORMAT_R32G32_FLOAT:
+		case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+			return 8;
+		case DXGI_FORMAT_R16_FLOAT:
+			return 2;
+		default:
+			return 4;               // 8 bit RGBA back buffers, R10G10B10A2, D24S8, D32
+		}
+	}
+
+	// A depth target that is also read is created typeless, the views pick the depth plane
+	bool GetDepthViewFormats(DXGI_FORMAT format, DXGI_FORMAT* textureFormat, DXGI_FORMAT* srvFormat)
+	{
+		switch (format)
+		{
+		case DXGI_FORMAT_D32_FLOAT_S8X24_UINT:
+			*textureFormat = DXGI_FORMAT_R32G8X24_TYPELESS;
+			*srvFormat = DXGI_FORMAT_R32_FLOAT_X8X24_TYPELESS;
+			return true;
+		case DXGI_FORMAT_D24_UNORM_S8_UINT:
+			*textureFormat = DXGI_FORMAT_R24G8_TYPELESS;
+			*srvFormat = DXGI_FORMAT_R24_UNORM_X8_TYPELESS;
+			return true;
+		case DXGI_FORMAT_D32_FLOAT:
+			*textureFormat = DXGI_FORMAT_R32_TYPELESS;
+			*srvFormat = DXGI_FORMAT_R32_FLOAT;
+			return true;
+		case DXGI_FORMAT_D16_UNORM:
+			*textureFormat = DXGI_FORMAT_R16_TYPELESS;
+			*srvFormat = DXGI_FORMAT_R16_UNORM;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	bool SameDesc(const RenderTargetDesc& a, const RenderTargetDesc& b)
+	{
+		return a.format == b.format && a.width == b.width && a.height == b.height && a.bindFlags == b.bindFlags;
+	}
+
+	HRESULT CreateTarget(ID3D11Device* device, const RenderTargetDesc& desc, RenderTarget* target)
+	{
+		HRESULT hr;
+
+		DXGI_FORMAT textureFormat = desc.format, srvFormat = desc.format;
+		bool readDepth = (desc.bindFlags & D3D11_BIND_DEPTH_STENCIL) && (desc.bindFlags & D3D11_BIND_SHADER_RESOURCE) &&
+			GetDepthViewFormats(desc.format, &textureFormat, &srvFormat);
+
+		CD3D11_TEXTURE2D_DESC textureDesc(textureFormat, desc.width, desc.height, 1, 1, desc.bindFlags);
+		V_RETURN(device->CreateTexture2D(&textureDesc, nullptr, target->texture.ReleaseAndGetAddressOf()));
+		if (desc.bindFlags & D3D11_BIND_RENDER_TARGET)
+			V_RETURN(device->CreateRenderTargetView(target->texture.Get(), nullptr, target->rtv.ReleaseAndGetAddressOf()));
+		if (desc.bindFlags & D3D11_BIND_SHADER_RESOURCE)
+		{
+			CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc(D3D11_SRV_DIMENSION_TEXTURE2D, srvFormat);
+			V_RETURN(device->CreateShaderResourceView(target->texture.Get(), &srvDesc, target->srv.ReleaseAndGetAddressOf()));
+		}
+		if (desc.bindFlags & D3D11_BIND_DEPTH_STENCIL)
+		{
+			CD3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc(D3D11_DSV_DIMENSION_TEXTURE2D, desc.format);
+			V_RETURN(device->CreateDepthStencilView(target->texture.Get(), &dsvDesc, target->dsv.ReleaseAndGetAddressOf()));
+		}
+		if (readDepth)
+		{
+			// The stencil stays writable, only the depth plane is read through the SRV
+			CD3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc(D3D11_DSV_DIMENSION_TEXTURE2D, desc.format, 0, 0, 1, D3D11_DSV_READ_ONLY_DEPTH);
+			V_RETURN(device->CreateDepthStencilView(target->texture.Get(), &dsvDesc, target->readOnlyDsv.ReleaseAndGetAddressOf()));
+		}
+
+		return S_OK;
+	}
+}
+
+//---------------------------------------------------------------------------------
+RenderTargetPool::RenderTargetPool() : device(nullptr)
+{
+	ZeroMemory(&stats, sizeof(stats));
+}
+
+UINT64 RenderTargetPool::GetSizeInBytes(const RenderTargetDesc& desc)
+{
+	return (UINT64)desc.width * desc.height * BytesPerPixel(desc.format);
+}
+
+//---------------------------------------------------------------------------------
+// The most recently freed match is taken, it is the one most likely to still be
+// resident
+//---------------------------------------------------------------------------------
+HRESULT RenderTargetPool::Acquire(const RenderTargetDesc& desc, RenderTarget* target)
+{
+	for (size_t i = freeTargets.size(); i-- > 0;)
+	{
+		if (!SameDesc(freeTargets[i].desc, desc))
+			continue;
+
+		*target = freeTargets[i];
+		freeTargets.erase(freeTargets.begin() + i);
+		stats.reuses++;
+		stats.freeTargets--;
+		stats.freeBytes -= GetSizeInBytes(desc);
+		stats.liveTargets++;
+		stats.liveBytes += GetSizeInBytes(desc);
+		return S_OK;
+	}
+
+	RenderTarget created;
+	created.desc = desc;
+	if (device)
+	{
+		HRESULT hr = CreateTarget(device, desc, &created);
+		if (FAILED(hr))
+			return hr;
+	}
+	*target = created;
+	stats.allocations++;
+	stats.liveTargets++;
+	stats.liveBytes += GetSizeInBytes(desc);
+	return S_OK;
+}
+
+void RenderTargetPool::Release(RenderTarget* target)
+{
+	if (target->desc.width == 0)
+		return;
+
+	freeTargets.push_back(*target);
+	stats.liveTargets--;
+	stats.liveBytes -= GetSizeInBytes(target->desc);
+	stats.freeTargets++;
+	stats.freeBytes += GetSizeInBytes(target->desc);
+
+	*target = RenderTarget();
+}
+
+void RenderTargetPool::Trim(UINT64 budget)
+{
+	size_t evicted = 0;
+	while (evicted < freeTargets.size() && stats.freeBytes > budget)
+	{
+		stats.freeBytes -= GetSizeInBytes(freeTargets[evicted].desc);
+		stats.freeTargets--;
+		stats.evictions++;
+		evicted++;
+	}
+	freeTargets.erase(freeTargets.begin(), freeTargets.begin() + evicted);
+}
+
+//---------------------------------------------------------------------------------
+RenderTargetSet::RenderTargetSet()
+	: width(0), height(0), nativeWidth(0), nativeHeight(0), renderScale(1.0f), allocatedWidth(0), allocatedHeight(0),
+	reallocations(0)
+{
+}
+
+size_t RenderTargetSet::AddTarget(DXGI_FORMAT format, UINT bindFlags)
+{
+	RenderTargetDesc desc = { format, 0, 0, bindFlags };
+	descs.push_back(desc);
+
+	RenderTarget empty;
+	ZeroMemory(&empty.desc, sizeof(empty.desc));
+	targets.push_back(empty);
+	return descs.size() - 1;
+}
+
+void RenderTargetSet::SetFormat(size_t index, DXGI_FORMAT format)
+{
+	descs[index].format = format;
+}
+
+UINT RenderTargetSet::RoundUp(UINT size)
+{
+	size = max(size, 1u);
+	return (size + RENDER_TARGET_GRANULARITY - 1) / RENDER_TARGET_GRANULARITY * RENDER_TARGET_GRANULARITY;
+}
+
+//---------------------------------------------------------------------------------
+// Growing reallocates at the rounded-up window size.  Shrinking waits until the
+// rounded-up window size covers less than RENDER_TARGET_SHRINK_AREA of the
+// allocation, so that a drag back and forth across a granularity step doesn't
+// reallocate at every step.
+//---------------------------------------------------------------------------------
+HRESULT RenderTargetSet::Resize(RenderTargetPool& pool, UINT width, UINT height)
+{
+	nativeWidth = width;
+	nativeHeight = height;
+	SetRenderScale(renderScale);
+
+	UINT newWidth = RoundUp(width);
+	UINT newHeight = RoundUp(height);
+	bool grow = width > allocatedWidth || height > allocatedHeight;
+	bool shrink = (float)newWidth * newHeight < RENDER_TARGET_SHRINK_AREA * (float)allocatedWidth * allocatedHeight;
+	if (grow || shrink)
+	{
+		if (allocatedWidth != 0)
+			reallocations++;
+		allocatedWidth = newWidth;
+		allocatedHeight = newHeight;
+	}
+
+	for (size_t i = 0; i < targets.size(); ++i)
+	{
+		RenderTargetDesc desc = descs[i];
+		desc.width = allocatedWidth;
+		desc.height = allocatedHeight;
+		if (SameDesc(targets[i].desc, desc))
+			continue;
+
+		pool.Release(&targets[i]);
+		HRESULT hr = pool.Acquire(desc, &targets[i]);
+		if (FAILED(hr))
+			return hr;
+	}
+
+	pool.Trim();
+	return S_OK;
+}
+
+void RenderTargetSet::SetRenderScale(float scale)
+{
+	renderScale = min(max(scale, 0.0f), 1.0f);
+	width = max((UINT)(nativeWidth * renderScale + 0.5f), 1u);
+	height = max((UINT)(nativeHeight * renderScale + 0.5f), 1u);
+}
+
+void RenderTargetSet::Release(RenderTargetPool& pool)
+{
+	for (size_t i = 0; i < targets.size(); ++i)
+		pool.Release(&targets[i]);
+}
+
+D3D11_VIEWPORT RenderTargetSet::GetViewport() const
+{
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (float)width, (float)height, 0.0f, 1.0f };
+	return viewport;
+}
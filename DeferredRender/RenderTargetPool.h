@@ -0,0 +1,130 @@
+//--------------------------------------------------------------------------------------
+// File: RenderTargetPool.h
+//
+// Render targets that survive window resizes.  A RenderTargetSet allocates its targets
+// at the window size rounded up to RENDER_TARGET_GRANULARITY and renders into the
+// top-left viewport while the window fits, scaled down by the render scale for dynamic
+// resolution.  It reallocates only when the window outgrows the allocation or the
+// rounded window size drops below RENDER_TARGET_SHRINK_AREA of it.
+// Targets that are given back go to a RenderTargetPool, which hands them out again to
+// requests with the same format, size and bind flags.
+//--------------------------------------------------------------------------------------
+#ifndef RENDER_TARGET_POOL_H
+#define RENDER_TARGET_POOL_H
+
+#include <vector>
+#include <wrl.h>
+
+#define RENDER_TARGET_GRANULARITY       256
+#define RENDER_TARGET_SHRINK_AREA       0.5f
+#define RENDER_TARGET_FREE_BUDGET       ( 256 * 1024 * 1024 )   // Bytes of free targets kept for reuse
+
+struct RenderTargetDesc
+{
+	DXGI_FORMAT format;
+	UINT width;
+	UINT height;
+	UINT bindFlags;                     // D3D11_BIND_RENDER_TARGET, _SHADER_RESOURCE and _DEPTH_STENCIL
+};
+
+struct RenderTarget
+{
+	RenderTargetDesc desc;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11RenderTargetView> rtv;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> readOnlyDsv;    // Of a depth target with an SRV, to test against the depth while sampling it
+};
+
+struct RenderTargetPoolStats
+{
+	size_t allocations;                 // Textures created
+	size_t reuses;                      // Requests served from the free list
+	size_t evictions;                   // Free textures destroyed to stay within the budget
+	size_t liveTargets;
+	size_t freeTargets;
+	UINT64 liveBytes;
+	UINT64 freeBytes;
+};
+
+class RenderTargetPool
+{
+public:
+	RenderTargetPool();
+
+	// Without a device the pool only does the bookkeeping and the targets have no texture
+	// or views, which is how the resize storm counts allocations without a GPU.
+	void SetDevice(ID3D11Device* device) { this->device = device; }
+
+	HRESULT Acquire(const RenderTargetDesc& desc, RenderTarget* target);
+	// Moves the target to the free list and empties *target
+	void Release(RenderTarget* target);
+	// Destroys the oldest free targets until they fit in the budget
+	void Trim(UINT64 budget = RENDER_TARGET_FREE_BUDGET);
+	void Clear() { Trim(0); }
+
+	const RenderTargetPoolStats& GetStats() const { return stats; }
+	void ResetCounters() { stats.allocations = stats.reuses = stats.evictions = 0; }
+
+	static UINT64 GetSizeInBytes(const RenderTargetDesc& desc);
+
+private:
+	ID3D11Device* device;
+	std::vector<RenderTarget> freeTargets;      // Oldest first
+	RenderTargetPoolStats stats;
+};
+
+//--------------------------------------------------------------------------------------
+// Targets of the same size that are rendered together (G-buffer, depth, light buffer)
+//--------------------------------------------------------------------------------------
+class RenderTargetSet
+{
+public:
+	RenderTargetSet();
+
+	// Returns the index of the target
+	size_t AddTarget(DXGI_FORMAT format, UINT bindFlags);
+	void SetFormat(size_t index, DXGI_FORMAT format);
+
+	// Sets the native size to width x height and acquires the targets if they are missing or
+	// the allocation size changes.  The trim of the pool happens here, after the acquires.
+	HRESULT Resize(RenderTargetPool& pool, UINT width, UINT height);
+	// The viewport is the native size times scale (at most 1), the allocation doesn't change
+	void SetRenderScale(float scale);
+	// Gives the targets back to the pool; the allocation size is kept for the next Resize
+	void Release(RenderTargetPool& pool);
+
+	const RenderTarget& operator[](size_t index) const { return targets[index]; }
+	size_t GetTargetCount() const { return targets.size(); }
+
+	// Viewport size
+	UINT GetWidth() const { return width; }
+	UINT GetHeight() const { return height; }
+	UINT GetNativeWidth() const { return nativeWidth; }
+	UINT GetNativeHeight() const { return nativeHeight; }
+	float GetRenderScale() const { return renderScale; }
+	UINT GetAllocatedWidth() const { return allocatedWidth; }
+	UINT GetAllocatedHeight() const { return allocatedHeight; }
+	D3D11_VIEWPORT GetViewport() const;
+	// Scale from [0,1] viewport coordinates to texture coordinates of the allocation
+	float GetUScale() const { return allocatedWidth ? (float)width / allocatedWidth : 1.0f; }
+	float GetVScale() const { return allocatedHeight ? (float)height / allocatedHeight : 1.0f; }
+	// Largest texture coordinates that bilinear filtering keeps inside the viewport
+	float GetUMax() const { return allocatedWidth ? (width - 0.5f) / allocatedWidth : 1.0f; }
+	float GetVMax() const { return allocatedHeight ? (height - 0.5f) / allocatedHeight : 1.0f; }
+	size_t GetReallocationCount() const { return reallocations; }
+
+	static UINT RoundUp(UINT size);
+
+private:
+	std::vector<RenderTargetDesc> descs;
+	std::vector<RenderTarget> targets;
+	UINT width, height;
+	UINT nativeWidth, nativeHeight;
+	float renderScale;
+	UINT allocatedWidth, allocatedHeight;
+	size_t reallocations;
+};
+
+#endif
@@ -0,0 +1,314 @@
+#include "DXUT.h"
+#include "strsafe.h"
+#include "ShaderBindings.h"
+#include <algorithm>
+#include <wrl.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	const WCHAR* STAGE_NAMES[SHADER_BINDING_STAGE_COUNT] = { L"VS", L"HS", L"DS", L"GS", L"PS" };
+	const WCHAR* KIND_NAMES[] = { L"constant buffer", L"shader resource", L"sampler", L"unordered access view", L"external" };
+
+	volatile LONG lastLayoutId = 0;
+
+	UINT NewLayoutId()
+	{
+		return (UINT)InterlockedIncrement(&lastLayoutId);
+	}
+
+	ShaderBindingKind KindOf(D3D_SHADER_INPUT_TYPE type)
+	{
+		switch (type)
+		{
+		case D3D_SIT_CBUFFER:
+			return SHADER_BINDING_CONSTANT_BUFFER;
+		case D3D_SIT_SAMPLER:
+			return SHADER_BINDING_SAMPLER;
+		case D3D_SIT_UAV_RWTYPED:
+		case D3D_SIT_UAV_RWSTRUCTURED:
+		case D3D_SIT_UAV_RWBYTEADDRESS:
+		case D3D_SIT_UAV_APPEND_STRUCTURED:
+		case D3D_SIT_UAV_CONSUME_STRUCTURED:
+		case D3D_SIT_UAV_RWSTRUCTURED_WITH_COUNTER:
+			return SHADER_BINDING_UNORDERED_ACCESS;
+		default:                            // Textures, tbuffers and structured and raw buffers
+			return SHADER_BINDING_SHADER_RESOURCE;
+		}
+	}
+
+	void ReportBindingError(const std::string& table, const ShaderBindingSlot& slot, const WCHAR* problem)
+	{
+		WCHAR szMsg[512];
+		StringCchPrintf(szMsg, 512, L"Bindings %S: %s %s %S (slot %u) %s\n", table.c_str(), STAGE_NAMES[slot.stage],
+			KIND_NAMES[slot.kind], slot.name.c_str(), slot.slot, problem);
+		OutputDebugString(szMsg);
+	}
+
+	//---------------------------------------------------------------------------------
+	// One ranged call of a stage
+	//---------------------------------------------------------------------------------
+	void SetConstantBuffers(ID3D11DeviceContext* context, ShaderBindingStage stage, UINT start, UINT count, ID3D11Buffer* const* buffers)
+	{
+		switch (stage)
+		{
+		case SHADER_BINDING_VS: context->VSSetConstantBuffers(start, count, buffers); break;
+		case SHADER_BINDING_HS: context->HSSetConstantBuffers(start, count, buffers); break;
+		case SHADER_BINDING_DS: context->DSSetConstantBuffers(start, count, buffers); break;
+		case SHADER_BINDING_GS: context->GSSetConstantBuffers(start, count, buffers); break;
+		case SHADER_BINDING_PS: context->PSSetConstantBuffers(start, count, buffers); break;
+		}
+	}
+
+	void SetShaderResources(ID3D11DeviceContext* context, ShaderBindingStage stage, UINT start, UINT count, ID3D11ShaderResourceView* const* views)
+	{
+		switch (stage)
+		{
+		case SHADER_BINDING_VS: context->VSSetShaderResources(start, count, views); break;
+		case SHADER_BINDING_HS: context->HSSetShaderResources(start, count, views); break;
+		case SHADER_BINDING_DS: context->DSSetShaderResources(start, count, views); break;
+		case SHADER_BINDING_GS: context->GSSetShaderResources(start, count, views); break;
+		case SHADER_BINDING_PS: context->PSSetShaderResources(start, count, views); break;
+		}
+	}
+
+	void SetSamplers(ID3D11DeviceContext* context, ShaderBindingStage stage, UINT start, UINT count, ID3D11SamplerState* const* samplers)
+	{
+		switch (stage)
+		{
+		case SHADER_BINDING_VS: context->VSSetSamplers(start, count, samplers); break;
+		case SHADER_BINDING_HS: context->HSSetSamplers(start, count, samplers); break;
+		case SHADER_BINDING_DS: context->DSSetSamplers(start, count, samplers); break;
+		case SHADER_BINDING_GS: context->GSSetSamplers(start, count, samplers); break;
+		case SHADER_BINDING_PS: context->PSSetSamplers(start, count, samplers); break;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------
+ShaderBindingLayout::ShaderBindingLayout()
+	: id(NewLayoutId())
+{
+}
+
+HRESULT ShaderBindingLayout::SetStage(const std::wstring& stage, ID3DBlob* bytecode)
+{
+	UINT index = 0;
+	while (index < SHADER_BINDING_STAGE_COUNT && stage != STAGE_NAMES[index])
+		++index;
+	if (index == SHADER_BINDING_STAGE_COUNT)
+		return E_INVALIDARG;
+
+	slots.erase(std::remove_if(slots.begin(), slots.end(), [index](const ShaderBindingSlot& s) { return s.stage == index; }), slots.end());
+	id = NewLayoutId();
+	if (!bytecode)
+		return S_OK;
+
+	HRESULT hr;
+	ComPtr<ID3D11ShaderReflection> reflection;
+	V_RETURN(D3DReflect(bytecode->GetBufferPointer(), bytecode->GetBufferSize(), IID_ID3D11ShaderReflection,
+		(void**)reflection.GetAddressOf()));
+
+	D3D11_SHADER_DESC desc;
+	V_RETURN(reflection->GetDesc(&desc));
+
+	// Only what the stage reads is listed, the compiler strips the resources it doesn't
+	for (UINT i = 0; i < desc.BoundResources; ++i)
+	{
+		D3D11_SHADER_INPUT_BIND_DESC bind;
+		V_RETURN(reflection->GetResourceBindingDesc(i, &bind));
+
+		ShaderBindingSlot slot;
+		slot.name = bind.Name;
+		slot.stage = (ShaderBindingStage)index;
+		slot.kind = KindOf(bind.Type);
+		slot.slot = bind.BindPoint;
+		slot.count = bind.BindCount;
+		slot.size = 0;
+		if (slot.kind == SHADER_BINDING_CONSTANT_BUFFER)
+		{
+			D3D11_SHADER_BUFFER_DESC buffer;
+			if (SUCCEEDED(reflection->GetConstantBufferByName(bind.Name)->GetDesc(&buffer)))
+				slot.size = buffer.Size;
+		}
+		slots.push_back(slot);
+	}
+	return S_OK;
+}
+
+void ShaderBindingLayout::Clear()
+{
+	slots.clear();
+	id = NewLayoutId();
+}
+
+//---------------------------------------------------------------------------------
+ShaderBinding ShaderBinding::ConstantBuffer(const char* name, UINT size)
+{
+	ShaderBinding binding = { name, SHADER_BINDING_CONSTANT_BUFFER, size };
+	return binding;
+}
+
+ShaderBinding ShaderBinding::ShaderResource(const char* name)
+{
+	ShaderBinding binding = { name, SHADER_BINDING_SHADER_RESOURCE, 0 };
+	return binding;
+}
+
+ShaderBinding ShaderBinding::Sampler(const char* name)
+{
+	ShaderBinding binding = { name, SHADER_BINDING_SAMPLER, 0 };
+	return binding;
+}
+
+ShaderBinding ShaderBinding::External(const char* name)
+{
+	ShaderBinding binding = { name, SHADER_BINDING_EXTERNAL, 0 };
+	return binding;
+}
+
+//---------------------------------------------------------------------------------
+void ShaderBindingTable::Init(const char* name, const std::vector<ShaderBinding>& bindings)
+{
+	this->name = name;
+	this->bindings = bindings;
+	resolved.clear();
+
+	valueIndices.resize(bindings.size());
+	valueCount = 0;
+	for (size_t i = 0; i < bindings.size(); ++i)
+		valueIndices[i] = bindings[i].kind == SHADER_BINDING_EXTERNAL ? ~0u : valueCount++;
+}
+
+HRESULT ShaderBindingTable::Validate(const ShaderBindingLayout& layout)
+{
+	return Resolve(layout).hr;
+}
+
+const ShaderBindingTable::Resolved& ShaderBindingTable::Resolve(const ShaderBindingLayout& layout)
+{
+	for (size_t i = 0; i < resolved.size(); ++i)
+	{
+		if (resolved[i].layoutId == layout.GetId())
+			return resolved[i];
+	}
+	if (resolved.size() >= SHADER_BINDING_MAX_RESOLVED_LAYOUTS)
+		resolved.erase(resolved.begin());
+
+	Resolved r;
+	r.layoutId = layout.GetId();
+	r.hr = S_OK;
+
+	// The slots the table fills, sorted so that the neighbours of a stage and kind merge
+	struct Bound { UINT stage, kind, slot, value; };
+	std::vector<Bound> bound;
+	const std::vector<ShaderBindingSlot>& slots = layout.GetSlots();
+	for (size_t i = 0; i < slots.size(); ++i)
+	{
+		const ShaderBindingSlot& slot = slots[i];
+		size_t b = 0;
+		while (b < bindings.size() && bindings[b].name != slot.name)
+			++b;
+
+		if (b == bindings.size())
+		{
+			ReportBindingError(name, slot, L"isn't bound by the table");
+			r.hr = E_FAIL;
+			continue;
+		}
+		if (bindings[b].kind == SHADER_BINDING_EXTERNAL)
+			continue;
+		if (bindings[b].kind != slot.kind)
+		{
+			ReportBindingError(name, slot, bindings[b].kind == SHADER_BINDING_CONSTANT_BUFFER ? L"is bound as a constant buffer" :
+				bindings[b].kind == SHADER_BINDING_SAMPLER ? L"is bound as a sampler" : L"is bound as a shader resource");
+			r.hr = E_FAIL;
+			continue;
+		}
+		if (slot.count != 1)
+		{
+			ReportBindingError(name, slot, L"is an array, which only external bindings cover");
+			r.hr = E_FAIL;
+			continue;
+		}
+		if (slot.kind == SHADER_BINDING_CONSTANT_BUFFER && bindings[b].size < slot.size)
+		{
+			WCHAR problem[128];
+			StringCchPrintf(problem, 128, L"is %u bytes, the buffer bound is %u", slot.size, bindings[b].size);
+			ReportBindingError(name, slot, problem);
+			r.hr = E_FAIL;
+			continue;
+		}
+
+		Bound entry = { (UINT)slot.stage, (UINT)slot.kind, slot.slot, valueIndices[b] };
+		bound.push_back(entry);
+	}
+	std::sort(bound.begin(), bound.end(), [](const Bound& a, const Bound& b)
+	{
+		return a.stage != b.stage ? a.stage < b.stage : a.kind != b.kind ? a.kind < b.kind : a.slot < b.slot;
+	});
+
+	for (size_t i = 0; i < bound.size(); ++i)
+	{
+		Range* last = r.ranges.empty() ? nullptr : &r.ranges.back();
+		if (!last || last->stage != bound[i].stage || last->kind != bound[i].kind || last->startSlot + last->count != bound[i].slot)
+		{
+			Range range = { (ShaderBindingStage)bound[i].stage, (ShaderBindingKind)bound[i].kind, bound[i].slot, 0, (UINT)r.values.size() };
+			r.ranges.push_back(range);
+		}
+		r.ranges.back().count++;
+		r.values.push_back(bound[i].value);
+	}
+
+	resolved.push_back(r);
+	return resolved.back();
+}
+
+void ShaderBindingTable::Apply(ID3D11DeviceContext* context, const ShaderBindingLayout& layout,
+	std::initializer_list<ID3D11DeviceChild*> values)
+{
+	if (values.size() != valueCount)
+	{
+		WCHAR szMsg[256];
+		StringCchPrintf(szMsg, 256, L"Bindings %S: %Iu values for %u bindings\n", name.c_str(), values.size(), valueCount);
+		OutputDebugString(szMsg);
+		return;
+	}
+
+	// The bindings that resolved are applied even if others didn't, which was reported
+	const Resolved& r = Resolve(layout);
+	ID3D11DeviceChild* const* v = values.begin();
+	for (size_t i = 0; i < r.ranges.size(); ++i)
+	{
+		const Range& range = r.ranges[i];
+		const UINT* indices = &r.values[range.firstValue];
+		switch (range.kind)
+		{
+		case SHADER_BINDING_CONSTANT_BUFFER:
+			{
+				ID3D11Buffer* buffers[D3D11_COMMONSHADER_CONSTANT_BUFFER_API_SLOT_COUNT];
+				for (UINT j = 0; j < range.count; ++j)
+					buffers[j] = static_cast<ID3D11Buffer*>(v[indices[j]]);
+				SetConstantBuffers(context, range.stage, range.startSlot, range.count, buffers);
+			}
+			break;
+		case SHADER_BINDING_SHADER_RESOURCE:
+			{
+				ID3D11ShaderResourceView* views[D3D11_COMMONSHADER_INPUT_RESOURCE_SLOT_COUNT];
+				for (UINT j = 0; j < range.count; ++j)
+					views[j] = static_cast<ID3D11ShaderResourceView*>(v[indices[j]]);
+				SetShaderResources(context, range.stage, range.startSlot, range.count, views);
+			}
+			break;
+		case SHADER_BINDING_SAMPLER:
+			{
+				ID3D11SamplerState* samplers[D3D11_COMMONSHADER_SAMPLER_SLOT_COUNT];
+				for (UINT j = 0; j < range.count; ++j)
+					samplers[j] = static_cast<ID3D11SamplerState*>(v[indices[j]]);
+				SetSamplers(context, range.stage, range.startSlot, range.count, samplers);
+			}
+			break;
+		}
+	}
+}
@@ -0,0 +1,144 @@
+//--------------------------------------------------------------------------------------
+// File: ShaderBindings.h
+//
+// Resource binding driven by shader reflection.  An effect reflects the bytecode of each
+// stage into a ShaderBindingLayout: the name, slot and, for constant buffers, the size
+// of every constant buffer, shader resource and sampler the stage reads.  The draw code
+// describes what it binds by name in a ShaderBindingTable.  The table is resolved against
+// a layout once, into runs of consecutive slots of one stage, so applying it costs a
+// ranged Set* call per run.  Resolving fails if the shader reads a resource the table
+// doesn't bind, if a name is bound as the wrong kind of resource, or if a constant
+// buffer is smaller than the shader's cbuffer; the names the shader doesn't read (a
+// texture a variant compiled out) are skipped.
+//--------------------------------------------------------------------------------------
+#ifndef SHADER_BINDINGS_H
+#define SHADER_BINDINGS_H
+
+#include <vector>
+#include <string>
+#include <initializer_list>
+
+#define SHADER_BINDING_MAX_RESOLVED_LAYOUTS 8       // Per table; the oldest is dropped, e.g. after reloads
+
+enum ShaderBindingStage
+{
+	SHADER_BINDING_VS,
+	SHADER_BINDING_HS,
+	SHADER_BINDING_DS,
+	SHADER_BINDING_GS,
+	SHADER_BINDING_PS,
+	SHADER_BINDING_STAGE_COUNT
+};
+
+enum ShaderBindingKind
+{
+	SHADER_BINDING_CONSTANT_BUFFER,
+	SHADER_BINDING_SHADER_RESOURCE,
+	SHADER_BINDING_SAMPLER,
+	SHADER_BINDING_UNORDERED_ACCESS,    // Reflected to be reported, tables don't bind them
+	SHADER_BINDING_EXTERNAL             // Bound by other code, such as Terrain::Draw
+};
+
+struct ShaderBindingSlot
+{
+	std::string name;
+	ShaderBindingStage stage;
+	ShaderBindingKind kind;
+	UINT slot;
+	UINT count;                         // Array size
+	UINT size;                          // Bytes, of a constant buffer
+};
+
+class ShaderBindingLayout
+{
+public:
+	ShaderBindingLayout();
+
+	// Replaces the slots of the stage (L"VS" ... L"PS") with those reflected from its bytecode
+	HRESULT SetStage(const std::wstring& stage, ID3DBlob* bytecode);
+	void Clear();
+
+	const std::vector<ShaderBindingSlot>& GetSlots() const { return slots; }
+
+	// Changes whenever the slots do; unique over all the layouts, so a table never mistakes
+	// a new layout for one it resolved before
+	UINT GetId() const { return id; }
+
+private:
+	std::vector<ShaderBindingSlot> slots;
+	UINT id;
+};
+
+// Implemented by the effects and post processes next to IEffect and IPostProcess
+class IShaderBindingSource
+{
+public:
+	virtual ~IShaderBindingSource() { }
+
+	virtual const ShaderBindingLayout& __cdecl GetBindingLayout() const = 0;
+};
+
+template<class T> inline const ShaderBindingLayout& GetShaderBindingLayout(T* object)
+{
+	return dynamic_cast<const IShaderBindingSource&>(*object).GetBindingLayout();
+}
+
+struct ShaderBinding
+{
+	std::string name;
+	ShaderBindingKind kind;
+	UINT size;                          // Bytes of the buffer given for a constant buffer
+
+	static ShaderBinding ConstantBuffer(const char* name, UINT size);
+	static ShaderBinding ShaderResource(const char* name);
+	static ShaderBinding Sampler(const char* name);
+	static ShaderBinding External(const char* name);
+};
+
+class ShaderBindingTable
+{
+public:
+	ShaderBindingTable() : valueCount(0) { }
+
+	// Apply takes a value for each binding that isn't external, in the order given here
+	void Init(const char* name, const std::vector<ShaderBinding>& bindings);
+
+	// Resolves the table against a layout.  Called at load time for the errors; Apply
+	// resolves the layouts it hasn't seen, such as a reloaded shader's.
+	HRESULT Validate(const ShaderBindingLayout& layout);
+
+	// Binds the values to the slots the layout's stages read them from
+	void Apply(ID3D11DeviceContext* context, const ShaderBindingLayout& layout,
+		std::initializer_list<ID3D11DeviceChild*> values);
+
+	// Forgets the resolved layouts, with the effects they belong to
+	void Reset() { resolved.clear(); }
+
+private:
+	struct Range
+	{
+		ShaderBindingStage stage;
+		ShaderBindingKind kind;
+		UINT startSlot;
+		UINT count;
+		UINT firstValue;                // Into Resolved::values
+	};
+
+	struct Resolved
+	{
+		UINT layoutId;
+		HRESULT hr;
+		std::vector<Range> ranges;
+		std::vector<UINT> values;       // Value index of each slot of the ranges
+	};
+
+	const Resolved& Resolve(const ShaderBindingLayout& layout);
+
+	std::string name;
+	std::vector<ShaderBinding> bindings;
+	std::vector<UINT> valueIndices;     // Of each binding, ~0 if external
+	UINT valueCount;
+	std::vector<Resolved> resolved;     // A few layouts: the variants and stages sharing the table
+};
+
+#endif
@@ -0,0 +1,294 @@
+#include "DXUT.h"
+#include "SDKmisc.h"
+#include "strsafe.h"
+#include "Effects.h"
+#include "ShaderPermutations.h"
+#include <ppl.h>
+#include <locale>
+#include <codecvt>
+
+using Microsoft::WRL::ComPtr;
+
+std::unique_ptr<DirectX::IEffect> createHlslEffectFromBytecode(ID3D11Device* device, const std::vector<ShaderStageSource>& sources,
+	const std::vector<ComPtr<ID3DBlob> >& bytecode, ShaderReloadService* reload);
+
+namespace
+{
+	const UINT CACHE_MAGIC = 0x52505348;        // "HSPR"
+
+	struct CacheHeader
+	{
+		UINT magic;
+		UINT version;
+		UINT64 key;                             // Of the file, entry point, profile and defines
+		UINT64 sourceWriteTime;
+		UINT size;
+	};
+
+	// FNV-1a, stable between runs unlike std::hash
+	UINT64 HashString(UINT64 hash, const std::string& s)
+	{
+		for (size_t i = 0; i < s.size(); ++i)
+			hash = (hash ^ (BYTE)s[i]) * 0x100000001B3ull;
+		return (hash ^ 0xFF) * 0x100000001B3ull;
+	}
+
+	UINT64 StageKey(const ShaderStageSource& source)
+	{
+		UINT64 hash = 0xCBF29CE484222325ull;
+		std::wstring_convert<std::codecvt_utf8_utf16<wchar_t> > converter;
+		hash = HashString(hash, converter.to_bytes(source.fileName));
+		hash = HashString(hash, source.entryPoint);
+		hash = HashString(hash, source.profile);
+		for (size_t i = 0; i < source.defines.size(); ++i)
+		{
+			hash = HashString(hash, source.defines[i].first);
+			hash = HashString(hash, source.defines[i].second);
+		}
+		return hash;
+	}
+
+	HRESULT ReadCache(const WCHAR* path, const CacheHeader& expected, ID3DBlob** bytecode)
+	{
+		HANDLE file = CreateFile(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return E_FAIL;
+
+		HRESULT hr = E_FAIL;
+		CacheHeader header;
+		DWORD read = 0;
+		if (ReadFile(file, &header, sizeof(header), &read, nullptr) && read == sizeof(header) &&
+			header.magic == expected.magic && header.version == expected.version && header.key == expected.key &&
+			header.sourceWriteTime == expected.sourceWriteTime && header.size > 0 && header.size <= 16 * 1024 * 1024)
+		{
+			ComPtr<ID3DBlob> blob;
+			if (SUCCEEDED(D3DCreateBlob(header.size, blob.GetAddressOf())) &&
+				ReadFile(file, blob->GetBufferPointer(), header.size, &read, nullptr) && read == header.size)
+			{
+				*bytecode = blob.Detach();
+				hr = S_OK;
+			}
+		}
+		CloseHandle(file);
+		return hr;
+	}
+
+	HRESULT WriteCache(const WCHAR* path, const CacheHeader& header, ID3DBlob* bytecode)
+	{
+		HANDLE file = CreateFile(path, GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return E_FAIL;
+
+		DWORD written = 0;
+		bool ok = WriteFile(file, &header, sizeof(header), &written, nullptr) && written == sizeof(header) &&
+			WriteFile(file, bytecode->GetBufferPointer(), header.size, &written, nullptr) && written == header.size;
+		CloseHandle(file);
+
+		if (!ok)
+		{
+			DeleteFile(path);
+			return E_FAIL;
+		}
+		return S_OK;
+	}
+
+	double Seconds(const LARGE_INTEGER& start)
+	{
+		LARGE_INTEGER end, frequency;
+		QueryPerformanceCounter(&end);
+		QueryPerformanceFrequency(&frequency);
+		return (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+	}
+}
+
+//---------------------------------------------------------------------------------
+ShaderPermutations::ShaderPermutations()
+	: device(nullptr), reload(nullptr)
+{
+	ZeroMemory(&stats, sizeof(stats));
+}
+
+void ShaderPermutations::Init(const WCHAR* name, const std::vector<ShaderStageSource>& stages, const std::vector<std::string>& axes)
+{
+	this->name = name;
+	this->stages = stages;
+	this->axes = axes;
+	if (this->axes.size() > SHADER_PERMUTATION_MAX_AXES)
+		this->axes.resize(SHADER_PERMUTATION_MAX_AXES);
+}
+
+void ShaderPermutations::SetDevice(ID3D11Device* device, ShaderReloadService* reload)
+{
+	DestroyDeviceResources();
+	this->device = device;
+	this->reload = reload;
+
+	// Media lookups stay on this thread, Prebuild compiles on others
+	mediaPaths.resize(stages.size());
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		WCHAR path[MAX_PATH];
+		if (FAILED(DXUTFindDXSDKMediaFileCch(path, MAX_PATH, stages[i].fileName.c_str())))
+			path[0] = 0;
+		mediaPaths[i] = path;
+	}
+	variants.resize(GetVariantCount());
+	failed.assign(GetVariantCount(), false);
+	CreateDirectory(SHADER_PERMUTATION_CACHE_DIRECTORY, nullptr);
+}
+
+void ShaderPermutations::DestroyDeviceResources()
+{
+	variants.clear();
+	failed.clear();
+	device = nullptr;
+	reload = nullptr;
+	stats.variants = 0;
+}
+
+//---------------------------------------------------------------------------------
+DirectX::IEffect* ShaderPermutations::Get(UINT mask)
+{
+	if (mask >= variants.size() || failed[mask])
+		return nullptr;
+	if (variants[mask])
+		return variants[mask].get();
+
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	std::vector<StageResult> results(stages.size());
+	for (UINT i = 0; i < (UINT)stages.size(); ++i)
+		LoadOrCompileStage(i, mask, results[i]);
+	CreateVariant(mask, results.data());
+
+	stats.seconds += Seconds(start);
+	return variants[mask].get();
+}
+
+HRESULT ShaderPermutations::Prebuild()
+{
+	if (!device)
+		return E_FAIL;
+
+	LARGE_INTEGER start;
+	QueryPerformanceCounter(&start);
+
+	std::vector<UINT> masks;
+	for (UINT mask = 0; mask < GetVariantCount(); ++mask)
+	{
+		if (!variants[mask] && !failed[mask])
+			masks.push_back(mask);
+	}
+
+	// One task per stage of every missing variant; the effects are made on this thread
+	UINT stageCount = (UINT)stages.size();
+	std::vector<StageResult> results(masks.size() * stageCount);
+	concurrency::parallel_for(size_t(0), results.size(), [&](size_t i)
+	{
+		LoadOrCompileStage((UINT)(i % stageCount), masks[i / stageCount], results[i]);
+	});
+
+	HRESULT hr = S_OK;
+	for (size_t i = 0; i < masks.size(); ++i)
+	{
+		CreateVariant(masks[i], &results[i * stageCount]);
+		if (!variants[masks[i]])
+			hr = E_FAIL;
+	}
+
+	stats.seconds += Seconds(start);
+	return hr;
+}
+
+//---------------------------------------------------------------------------------
+ShaderStageSource ShaderPermutations::GetVariantStage(UINT stage, UINT mask) const
+{
+	ShaderStageSource source = stages[stage];
+	for (UINT i = 0; i < (UINT)axes.size(); ++i)
+		source.defines.push_back(std::make_pair(axes[i], std::string(mask & (1u << i) ? "1" : "0")));
+	return source;
+}
+
+std::wstring ShaderPermutations::GetCachePath(UINT stage, UINT mask) const
+{
+	std::wstring_convert<std::codecvt_utf8_utf16<wchar_t> > converter;
+	WCHAR path[MAX_PATH];
+	StringCchPrintf(path, MAX_PATH, L"%s\\%s_%02x_%s_%s.cso", SHADER_PERMUTATION_CACHE_DIRECTORY, name.c_str(), mask,
+		stages[stage].stage.c_str(), converter.from_bytes(stages[stage].entryPoint).c_str());
+	return path;
+}
+
+void ShaderPermutations::LoadOrCompileStage(UINT stage, UINT mask, StageResult& result) const
+{
+	ShaderStageSource source = GetVariantStage(stage, mask);
+	result.fromCache = false;
+	if (mediaPaths[stage].empty())
+	{
+		result.hr = HRESULT_FROM_WIN32(ERROR_FILE_NOT_FOUND);
+		return;
+	}
+
+	CacheHeader header;
+	ZeroMemory(&header, sizeof(header));
+	header.magic = CACHE_MAGIC;
+	header.version = SHADER_PERMUTATION_CACHE_VERSION;
+	header.key = StageKey(source);
+	header.sourceWriteTime = GetShaderSourceWriteTime(mediaPaths[stage].c_str());
+
+	std::wstring cachePath = GetCachePath(stage, mask);
+	if (header.sourceWriteTime != 0 && SUCCEEDED(ReadCache(cachePath.c_str(), header, result.bytecode.ReleaseAndGetAddressOf())))
+	{
+		result.hr = S_OK;
+		result.fromCache = true;
+		return;
+	}
+
+	result.hr = CompileShaderStage(mediaPaths[stage].c_str(), source, result.bytecode.ReleaseAndGetAddressOf(), &result.errors);
+	if (FAILED(result.hr))
+		return;
+
+	// A read-only working directory only costs the cache
+	header.size = (UINT)result.bytecode->GetBufferSize();
+	WriteCache(cachePath.c_str(), header, result.bytecode.Get());
+}
+
+void ShaderPermutations::CreateVariant(UINT mask, const StageResult* results)
+{
+	std::vector<ShaderStageSource> sources;
+	std::vector<ComPtr<ID3DBlob> > bytecode;
+	bool compiled = true;
+	for (UINT i = 0; i < (UINT)stages.size(); ++i)
+	{
+		sources.push_back(GetVariantStage(i, mask));
+		bytecode.push_back(results[i].bytecode);
+		if (SUCCEEDED(results[i].hr))
+		{
+			++(results[i].fromCache ? stats.cachedStages : stats.compiledStages);
+			continue;
+		}
+
+		WCHAR szMsg[512];
+		StringCchPrintf(szMsg, 512, L"%s variant 0x%02x: %s %S (%s) failed (0x%08x)\n", name.c_str(), mask,
+			stages[i].fileName.c_str(), stages[i].entryPoint.c_str(), stages[i].stage.c_str(), results[i].hr);
+		OutputDebugString(szMsg);
+		OutputDebugStringA(results[i].errors.c_str());
+		++stats.failedStages;
+		compiled = false;
+	}
+	if (!compiled)
+	{
+		failed[mask] = true;
+		return;
+	}
+
+	try
+	{
+		variants[mask] = createHlslEffectFromBytecode(device, sources, bytecode, reload);
+		++stats.variants;
+	}
+	catch (const std::exception&)
+	{
+		failed[mask] = true;
+	}
+}
@@ -0,0 +1,88 @@
+//--------------------------------------------------------------------------------------
+// File: ShaderPermutations.h
+//
+// Variants of an effect that are keyed by preprocessor defines.  An effect declares its
+// define axes, and bit i of a variant mask compiles every stage with axes[i] defined as
+// 1, a clear bit as 0.  A mode that the shader used to branch on at run time becomes a
+// compile-time constant, and the renderer picks the variant by mask at draw time.
+// Variants are compiled on first use, or all at once by Prebuild, and kept in a shader
+// cache on disk.  A cached stage is valid while it is newer than its source file and
+// includes, so a prebuild run ahead of time (-prebuildshaders) spares the first frames
+// the compiles.
+//--------------------------------------------------------------------------------------
+#ifndef SHADER_PERMUTATIONS_H
+#define SHADER_PERMUTATIONS_H
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <wrl.h>
+#include "ShaderReload.h"
+
+namespace DirectX { class IEffect; }
+
+#define SHADER_PERMUTATION_MAX_AXES         8
+#define SHADER_PERMUTATION_CACHE_DIRECTORY  L"ShaderCache"
+#define SHADER_PERMUTATION_CACHE_VERSION    1
+
+struct ShaderPermutationStats
+{
+	UINT variants;                      // Variants created so far
+	size_t compiledStages;
+	size_t cachedStages;                // Stages loaded from the shader cache
+	size_t failedStages;
+	double seconds;                     // Spent compiling, loading and creating variants
+};
+
+class ShaderPermutations
+{
+public:
+	ShaderPermutations();
+
+	// name keys the variants in the shader cache; stages hold no defines of their own axes
+	void Init(const WCHAR* name, const std::vector<ShaderStageSource>& stages, const std::vector<std::string>& axes);
+
+	// The reload service, if any, recompiles the variants created so far when their source changes
+	void SetDevice(ID3D11Device* device, ShaderReloadService* reload);
+	void DestroyDeviceResources();
+
+	// The variant's effect, compiled or loaded from the cache on first use.  nullptr if a
+	// stage doesn't compile.
+	DirectX::IEffect* Get(UINT mask);
+
+	// Creates all the variants, compiling the stages side by side
+	HRESULT Prebuild();
+
+	UINT GetVariantCount() const { return 1u << (UINT)axes.size(); }
+	const ShaderPermutationStats& GetStats() const { return stats; }
+
+private:
+	struct StageResult
+	{
+		Microsoft::WRL::ComPtr<ID3DBlob> bytecode;
+		HRESULT hr;
+		bool fromCache;
+		std::string errors;
+	};
+
+	ShaderStageSource GetVariantStage(UINT stage, UINT mask) const;
+	std::wstring GetCachePath(UINT stage, UINT mask) const;
+	// Reads the stage from the cache if it is current, else compiles it and writes the cache
+	void LoadOrCompileStage(UINT stage, UINT mask, StageResult& result) const;
+	// Makes the effect of a variant from the results of its stages
+	void CreateVariant(UINT mask, const StageResult* results);
+
+	std::wstring name;
+	std::vector<ShaderStageSource> stages;
+	std::vector<std::string> axes;
+	std::vector<std::wstring> mediaPaths;       // Of the stages, found when the device is set
+
+	ID3D11Device* device;
+	ShaderReloadService* reload;
+	std::vector<std::unique_ptr<DirectX::IEffect> > variants;   // Indexed by mask
+	std::vector<bool> failed;                   // Variants that didn't compile, retried after SetDevice
+
+	ShaderPermutationStats stats;
+};
+
+#endif
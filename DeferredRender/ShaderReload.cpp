@@ -0,0 +1,545 @@
+#include "DXUT.h"
+#include "SDKmisc.h"
+#include "strsafe.h"
+#include "ShaderReload.h"
+#include <fstream>
+#include <algorithm>
+#include <ppl.h>
+
+using Microsoft::WRL::ComPtr;
+
+namespace
+{
+	//---------------------------------------------------------------------------------
+	// Paths
+	//---------------------------------------------------------------------------------
+
+	// Full, lower case path with single backslashes; the #include strings of the shaders
+	// are written with escaped ones
+	std::wstring NormalizePath(const std::wstring& path)
+	{
+		std::wstring collapsed;
+		for (size_t i = 0; i < path.size(); ++i)
+		{
+			WCHAR c = path[i] == L'/' ? L'\\' : path[i];
+			if (c == L'\\' && collapsed.size() > 1 && collapsed.back() == L'\\')
+				continue;
+			collapsed.push_back(c);
+		}
+
+		WCHAR full[MAX_PATH];
+		DWORD length = GetFullPathNameW(collapsed.c_str(), MAX_PATH, full, NULL);
+		std::wstring result = length > 0 && length < MAX_PATH ? std::wstring(full, length) : collapsed;
+		if (!result.empty())
+			CharLowerBuffW(&result[0], (DWORD)result.size());
+		return result;
+	}
+
+	std::wstring DirectoryOf(const std::wstring& path)
+	{
+		size_t slash = path.find_last_of(L'\\');
+		return slash == std::wstring::npos ? std::wstring(L".") : path.substr(0, slash);
+	}
+
+	bool FileExists(const std::wstring& path)
+	{
+		DWORD attributes = GetFileAttributesW(path.c_str());
+		return attributes != INVALID_FILE_ATTRIBUTES && !(attributes & FILE_ATTRIBUTE_DIRECTORY);
+	}
+
+	// 0 for a missing file
+	UINT64 GetWriteTime(const std::wstring& path)
+	{
+		WIN32_FILE_ATTRIBUTE_DATA data;
+		if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &data))
+			return 0;
+		return ((UINT64)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	}
+
+	//---------------------------------------------------------------------------------
+	// Include sets
+	//---------------------------------------------------------------------------------
+
+	// Like the compiler, an include is looked up next to the file that includes it, then
+	// next to the source file the compiler was given
+	bool ResolveInclude(const std::string& name, const std::wstring& includerDirectory, const std::wstring& rootDirectory,
+		std::wstring& resolved)
+	{
+		std::wstring wideName(name.begin(), name.end());
+		const std::wstring* directories[] = { &includerDirectory, &rootDirectory };
+		for (int i = 0; i < 2; ++i)
+		{
+			std::wstring candidate = NormalizePath(*directories[i] + L"\\" + wideName);
+			if (FileExists(candidate))
+			{
+				resolved = candidate;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// Appends the files path includes, and the files those include, that aren't in files
+	// yet.  Includes in comments or disabled #if blocks are followed too, which only costs
+	// a file to watch.
+	void CollectIncludes(const std::wstring& path, const std::wstring& rootDirectory, std::vector<std::wstring>& files,
+		UINT depth)
+	{
+		if (depth >= SHADER_RELOAD_MAX_INCLUDE_DEPTH)
+			return;
+
+		std::ifstream file(path.c_str());
+		std::string line;
+		while (std::getline(file, line))
+		{
+			size_t directive = line.find_first_not_of(" \t");
+			if (directive == std::string::npos || line.compare(directive, 8, "#include") != 0)
+				continue;
+
+			size_t open = line.find_first_of("\"<", directive + 8);
+			if (open == std::string::npos)
+				continue;
+			size_t close = line.find(line[open] == '"' ? '"' : '>', open + 1);
+			if (close == std::string::npos)
+				continue;
+
+			std::wstring resolved;
+			if (!ResolveInclude(line.substr(open + 1, close - open - 1), DirectoryOf(path), rootDirectory, resolved))
+				continue;
+			if (std::find(files.begin(), files.end(), resolved) != files.end())
+				continue;
+
+			files.push_back(resolved);
+			CollectIncludes(resolved, rootDirectory, files, depth + 1);
+		}
+	}
+
+	// The source file of a stage followed by its transitive include set
+	std::vector<std::wstring> StageFiles(const std::wstring& path)
+	{
+		std::vector<std::wstring> files(1, path);
+		CollectIncludes(path, DirectoryOf(path), files, 0);
+		return files;
+	}
+
+	//---------------------------------------------------------------------------------
+	// Compilation
+	//---------------------------------------------------------------------------------
+
+	// The input layouts made for the old shader still fit if the elements match; the
+	// components a shader reads may change
+	bool SameInputSignature(ID3DBlob* a, ID3DBlob* b)
+	{
+		ComPtr<ID3D11ShaderReflection> reflections[2];
+		D3D11_SHADER_DESC descs[2];
+		ID3DBlob* blobs[] = { a, b };
+		for (int i = 0; i < 2; ++i)
+		{
+			if (FAILED(D3DReflect(blobs[i]->GetBufferPointer(), blobs[i]->GetBufferSize(), IID_ID3D11ShaderReflection,
+				(void**)reflections[i].GetAddressOf())) || FAILED(reflections[i]->GetDesc(&descs[i])))
+				return false;
+		}
+		if (descs[0].InputParameters != descs[1].InputParameters)
+			return false;
+
+		for (UINT i = 0; i < descs[0].InputParameters; ++i)
+		{
+			D3D11_SIGNATURE_PARAMETER_DESC pa, pb;
+			reflections[0]->GetInputParameterDesc(i, &pa);
+			reflections[1]->GetInputParameterDesc(i, &pb);
+			if (_stricmp(pa.SemanticName, pb.SemanticName) != 0 || pa.SemanticIndex != pb.SemanticIndex ||
+				pa.Register != pb.Register || pa.SystemValueType != pb.SystemValueType ||
+				pa.ComponentType != pb.ComponentType || pa.Mask != pb.Mask)
+				return false;
+		}
+		return true;
+	}
+}
+
+//---------------------------------------------------------------------------------
+HRESULT CompileShaderStage(const WCHAR* mediaPath, const ShaderStageSource& source, ID3DBlob** blob, std::string* errors)
+{
+	std::vector<D3D_SHADER_MACRO> macros;
+	for (size_t i = 0; i < source.defines.size(); ++i)
+	{
+		D3D_SHADER_MACRO macro = { source.defines[i].first.c_str(), source.defines[i].second.c_str() };
+		macros.push_back(macro);
+	}
+	D3D_SHADER_MACRO end = { NULL, NULL };
+	macros.push_back(end);
+
+	ComPtr<ID3DBlob> errorBlob;
+	HRESULT hr = D3DX11CompileFromFile(mediaPath, &macros[0], NULL, source.entryPoint.c_str(), source.profile.c_str(),
+		D3DCOMPILE_ENABLE_STRICTNESS, 0, NULL, blob, errorBlob.GetAddressOf(), NULL);
+	if (errors)
+		*errors = errorBlob ? (const char*)errorBlob->GetBufferPointer() : "";
+	return hr;
+}
+
+HRESULT CreateShaderFromBytecode(ID3D11Device* device, const std::string& profile, ID3DBlob* bytecode,
+	ID3D11DeviceChild** shader)
+{
+	const void* code = bytecode->GetBufferPointer();
+	SIZE_T size = bytecode->GetBufferSize();
+	std::string type = profile.substr(0, 2);
+
+	if (type == "vs")
+		return device->CreateVertexShader(code, size, NULL, (ID3D11VertexShader**)shader);
+	if (type == "hs")
+		return device->CreateHullShader(code, size, NULL, (ID3D11HullShader**)shader);
+	if (type == "ds")
+		return device->CreateDomainShader(code, size, NULL, (ID3D11DomainShader**)shader);
+	if (type == "gs")
+		return device->CreateGeometryShader(code, size, NULL, (ID3D11GeometryShader**)shader);
+	if (type == "ps")
+		return device->CreatePixelShader(code, size, NULL, (ID3D11PixelShader**)shader);
+	return E_INVALIDARG;
+}
+
+UINT64 GetShaderSourceWriteTime(const WCHAR* mediaPath)
+{
+	std::vector<std::wstring> files = StageFiles(NormalizePath(mediaPath));
+	UINT64 newest = 0;
+	for (size_t i = 0; i < files.size(); ++i)
+	{
+		UINT64 writeTime = GetWriteTime(files[i]);
+		if (writeTime == 0)
+			return 0;
+		newest = max(newest, writeTime);
+	}
+	return newest;
+}
+
+//---------------------------------------------------------------------------------
+ShaderReloadService::ShaderReloadService()
+	: device(nullptr), stopEvent(NULL), nextId(1), generation(0)
+{
+	ZeroMemory(&threadStats, sizeof(threadStats));
+	ZeroMemory(&stats, sizeof(stats));
+}
+
+ShaderReloadService::~ShaderReloadService()
+{
+	Stop();
+}
+
+//---------------------------------------------------------------------------------
+HRESULT ShaderReloadService::Start(ID3D11Device* device)
+{
+	if (thread.joinable())
+		return S_OK;
+
+	stopEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+	if (!stopEvent)
+		return HRESULT_FROM_WIN32(GetLastError());
+
+	this->device = device;
+	thread = std::thread(&ShaderReloadService::WatchThread, this);
+	return S_OK;
+}
+
+void ShaderReloadService::Stop()
+{
+	if (!thread.joinable())
+		return;
+
+	SetEvent(stopEvent);
+	thread.join();
+	CloseHandle(stopEvent);
+	stopEvent = NULL;
+	device = nullptr;
+
+	std::lock_guard<std::mutex> guard(lock);
+	pending.clear();
+}
+
+//---------------------------------------------------------------------------------
+UINT ShaderReloadService::Register(IShaderReloadTarget* target, const std::vector<ShaderStageSource>& stages,
+	ID3DBlob* vertexShaderBlob)
+{
+	Registration registration;
+	registration.target = target;
+	registration.vertexShaderBlob = vertexShaderBlob;
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		WCHAR mediaPath[MAX_PATH];
+		if (FAILED(DXUTFindDXSDKMediaFileCch(mediaPath, MAX_PATH, stages[i].fileName.c_str())))
+			continue;
+
+		Stage stage;
+		stage.source = stages[i];
+		stage.mediaPath = mediaPath;
+		stage.path = NormalizePath(mediaPath);
+		registration.stages.push_back(stage);
+	}
+
+	std::lock_guard<std::mutex> guard(lock);
+	UINT id = nextId++;
+	registrations[id] = registration;
+	++generation;
+	return id;
+}
+
+void ShaderReloadService::Unregister(UINT id)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	registrations.erase(id);
+	++generation;
+}
+
+//---------------------------------------------------------------------------------
+UINT ShaderReloadService::ApplyPendingReloads()
+{
+	std::vector<PendingReload> reloads;
+	{
+		std::lock_guard<std::mutex> guard(lock);
+		reloads.swap(pending);
+		stats.watchedFiles = threadStats.watchedFiles;
+		stats.lastStageCount = threadStats.lastStageCount;
+		stats.lastSeconds = threadStats.lastSeconds;
+		stats.lastFailed = threadStats.lastFailed;
+	}
+
+	// Registrations only change on this thread, the watch thread just reads them
+	UINT applied = 0;
+	for (size_t i = 0; i < reloads.size(); ++i)
+	{
+		if (reloads[i].failed)
+		{
+			++stats.failures;
+			continue;
+		}
+
+		std::map<UINT, Registration>::iterator it = registrations.find(reloads[i].id);
+		if (it == registrations.end())
+			continue;
+
+		it->second.target->ReplaceShaders(reloads[i].shaders);
+		++stats.reloads;
+		++applied;
+	}
+	return applied;
+}
+
+//---------------------------------------------------------------------------------
+// Waits on the directories of the watched files and checks their write times
+//---------------------------------------------------------------------------------
+void ShaderReloadService::WatchThread()
+{
+	std::map<UINT, Registration> snapshot;
+	std::map<std::wstring, UINT64> writeTimes;
+	std::vector<HANDLE> handles(1, stopEvent);
+	UINT watchedGeneration = 0;
+	bool rebuild = true;
+
+	for (;;)
+	{
+		{
+			std::lock_guard<std::mutex> guard(lock);
+			if (watchedGeneration != generation)
+			{
+				snapshot = registrations;
+				watchedGeneration = generation;
+				rebuild = true;
+			}
+		}
+
+		// Include sets change with the files, so they are collected again after every change
+		if (rebuild)
+		{
+			rebuild = false;
+
+			std::map<std::wstring, UINT64> files;
+			for (std::map<UINT, Registration>::const_iterator r = snapshot.begin(); r != snapshot.end(); ++r)
+			{
+				for (size_t i = 0; i < r->second.stages.size(); ++i)
+				{
+					std::vector<std::wstring> stageFiles = StageFiles(r->second.stages[i].path);
+					for (size_t j = 0; j < stageFiles.size(); ++j)
+					{
+						std::map<std::wstring, UINT64>::const_iterator known = writeTimes.find(stageFiles[j]);
+						files[stageFiles[j]] = known != writeTimes.end() ? known->second : GetWriteTime(stageFiles[j]);
+					}
+				}
+			}
+			writeTimes.swap(files);
+
+			std::vector<std::wstring> directories;
+			for (std::map<std::wstring, UINT64>::const_iterator f = writeTimes.begin(); f != writeTimes.end(); ++f)
+			{
+				std::wstring directory = DirectoryOf(f->first);
+				if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+					directories.push_back(directory);
+			}
+
+			for (size_t i = 1; i < handles.size(); ++i)
+				FindCloseChangeNotification(handles[i]);
+			handles.resize(1);
+			for (size_t i = 0; i < directories.size() && handles.size() < MAXIMUM_WAIT_OBJECTS; ++i)
+			{
+				// Editors that save to a temporary file and rename it only change names
+				HANDLE handle = FindFirstChangeNotificationW(directories[i].c_str(), FALSE,
+					FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME);
+				if (handle != INVALID_HANDLE_VALUE)
+					handles.push_back(handle);
+			}
+
+			std::lock_guard<std::mutex> guard(lock);
+			threadStats.watchedFiles = writeTimes.size();
+		}
+
+		DWORD result = WaitForMultipleObjects((DWORD)handles.size(), &handles[0], FALSE, SHADER_RELOAD_POLL_MILLISECONDS);
+		if (result == WAIT_OBJECT_0)
+			break;
+		if (result > WAIT_OBJECT_0 && result < WAIT_OBJECT_0 + handles.size())
+			FindNextChangeNotification(handles[result - WAIT_OBJECT_0]);
+
+		// Wait for the writes to settle before compiling
+		std::vector<std::wstring> changedFiles;
+		bool settled = false, stopping = false;
+		while (!settled && !stopping)
+		{
+			settled = true;
+			for (std::map<std::wstring, UINT64>::iterator f = writeTimes.begin(); f != writeTimes.end(); ++f)
+			{
+				UINT64 writeTime = GetWriteTime(f->first);
+				if (writeTime == f->second)
+					continue;
+
+				f->second = writeTime;
+				settled = false;
+				if (std::find(changedFiles.begin(), changedFiles.end(), f->first) == changedFiles.end())
+					changedFiles.push_back(f->first);
+			}
+			if (changedFiles.empty())
+				break;
+			if (!settled)
+				stopping = WaitForSingleObject(stopEvent, SHADER_RELOAD_SETTLE_MILLISECONDS) == WAIT_OBJECT_0;
+		}
+		if (stopping)
+			break;
+		if (changedFiles.empty())
+			continue;
+
+		RecompileChanged(snapshot, changedFiles);
+		rebuild = true;
+	}
+
+	for (size_t i = 1; i < handles.size(); ++i)
+		FindCloseChangeNotification(handles[i]);
+}
+
+//---------------------------------------------------------------------------------
+void ShaderReloadService::RecompileChanged(const std::map<UINT, Registration>& snapshot,
+	const std::vector<std::wstring>& changedFiles)
+{
+	struct Job
+	{
+		UINT id;
+		const Registration* registration;
+		const Stage* stage;
+		ReloadedShader result;
+		HRESULT hr;
+		std::string errors;
+	};
+
+	LARGE_INTEGER frequency, start, end;
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&start);
+
+	std::vector<Job> jobs;
+	for (std::map<UINT, Registration>::const_iterator r = snapshot.begin(); r != snapshot.end(); ++r)
+	{
+		for (size_t i = 0; i < r->second.stages.size(); ++i)
+		{
+			std::vector<std::wstring> stageFiles = StageFiles(r->second.stages[i].path);
+			bool affected = false;
+			for (size_t j = 0; j < changedFiles.size() && !affected; ++j)
+				affected = std::find(stageFiles.begin(), stageFiles.end(), changedFiles[j]) != stageFiles.end();
+			if (!affected)
+				continue;
+
+			Job job;
+			job.id = r->first;
+			job.registration = &r->second;
+			job.stage = &r->second.stages[i];
+			job.hr = E_FAIL;
+			jobs.push_back(job);
+		}
+	}
+	if (jobs.empty())
+		return;
+
+	// A change to shader_include.hlsl recompiles most of the stages, so they are compiled
+	// side by side
+	ID3D11Device* device = this->device;
+	concurrency::parallel_for(size_t(0), jobs.size(), [&jobs, device](size_t i)
+	{
+		Job& job = jobs[i];
+		const ShaderStageSource& source = job.stage->source;
+
+		job.result.stage = source.stage;
+		job.hr = CompileShaderStage(job.stage->mediaPath.c_str(), source, job.result.blob.GetAddressOf(), &job.errors);
+		if (FAILED(job.hr))
+			return;
+
+		if (source.stage == L"VS" && job.registration->vertexShaderBlob &&
+			!SameInputSignature(job.registration->vertexShaderBlob.Get(), job.result.blob.Get()))
+		{
+			job.hr = E_INVALIDARG;
+			job.errors = "The input signature changed, the input layouts need a restart\n";
+			return;
+		}
+
+		job.hr = CreateShaderFromBytecode(device, source.profile, job.result.blob.Get(), job.result.shader.GetAddressOf());
+	});
+
+	QueryPerformanceCounter(&end);
+	double seconds = double(end.QuadPart - start.QuadPart) / double(frequency.QuadPart);
+
+	// The jobs of a registration are next to each other
+	std::vector<PendingReload> reloads;
+	bool failed = false;
+	for (size_t i = 0; i < jobs.size(); ++i)
+	{
+		if (reloads.empty() || reloads.back().id != jobs[i].id)
+		{
+			PendingReload reload;
+			reload.id = jobs[i].id;
+			reload.failed = false;
+			reloads.push_back(reload);
+		}
+
+		PendingReload& reload = reloads.back();
+		if (SUCCEEDED(jobs[i].hr))
+		{
+			reload.shaders.push_back(jobs[i].result);
+			continue;
+		}
+
+		WCHAR szMsg[512];
+		StringCchPrintf(szMsg, 512, L"Shader reload: %s %S (%s) failed (0x%08x), keeping the old shaders\n",
+			jobs[i].stage->source.fileName.c_str(), jobs[i].stage->source.entryPoint.c_str(),
+			jobs[i].stage->source.stage.c_str(), jobs[i].hr);
+		OutputDebugString(szMsg);
+		OutputDebugStringA(jobs[i].errors.c_str());
+		reload.failed = true;
+		failed = true;
+	}
+	for (size_t i = 0; i < reloads.size(); ++i)
+	{
+		if (reloads[i].failed)
+			reloads[i].shaders.clear();
+	}
+
+	WCHAR szMsg[256];
+	StringCchPrintf(szMsg, 256, L"Shader reload: %Iu stages of %Iu effects compiled in %.0f ms%s\n",
+		jobs.size(), reloads.size(), seconds * 1000.0, failed ? L" with errors" : L"");
+	OutputDebugString(szMsg);
+
+	std::lock_guard<std::mutex> guard(lock);
+	pending.insert(pending.end(), reloads.begin(), reloads.end());
+	threadStats.lastStageCount = (UINT)jobs.size();
+	threadStats.lastSeconds = seconds;
+	threadStats.lastFailed = failed;
+}
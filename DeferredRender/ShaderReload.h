@@ -0,0 +1,134 @@
+//--------------------------------------------------------------------------------------
+// File: ShaderReload.h
+//
+// Hot reload of the HLSL effects and post processes while the app runs.  Every effect
+// registers the source file, entry point and profile of its stages.  The service follows
+// the #include directives of the sources for their transitive include sets and watches
+// the directories of all those files.  When one of them is written, a background thread
+// recompiles the stages that depend on it and creates their shaders on the (free
+// threaded) device.  ApplyPendingReloads then swaps them into the effects between frames.
+// A change is applied to all the stages of an effect at once, or to none of them if one
+// fails to compile, in which case the old shaders keep running.
+//--------------------------------------------------------------------------------------
+#ifndef SHADER_RELOAD_H
+#define SHADER_RELOAD_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <wrl.h>
+
+#define SHADER_RELOAD_SETTLE_MILLISECONDS   50      // Quiet time after a write, editors save in several writes
+#define SHADER_RELOAD_POLL_MILLISECONDS     500     // Write times are also checked this often
+#define SHADER_RELOAD_MAX_INCLUDE_DEPTH     16
+
+struct ShaderStageSource
+{
+	std::wstring stage;                 // L"VS", L"HS", L"DS", L"GS" or L"PS"
+	std::wstring fileName;              // Media file name, as given to CreateShaderFromFile
+	std::string entryPoint;
+	std::string profile;
+	std::vector<std::pair<std::string, std::string> > defines;     // Name and value
+};
+
+struct ReloadedShader
+{
+	std::wstring stage;
+	Microsoft::WRL::ComPtr<ID3D11DeviceChild> shader;
+	Microsoft::WRL::ComPtr<ID3DBlob> blob;
+};
+
+class IShaderReloadTarget
+{
+public:
+	virtual ~IShaderReloadTarget() { }
+
+	// The recompiled stages of one change; the stages that aren't listed keep their shaders
+	virtual void __cdecl ReplaceShaders(const std::vector<ReloadedShader>& shaders) = 0;
+};
+
+struct ShaderReloadStats
+{
+	size_t watchedFiles;
+	size_t reloads;                     // Changes swapped into an effect
+	size_t failures;                    // Changes that left an effect with its old shaders
+	UINT lastStageCount;                // Stages recompiled for the last change
+	double lastSeconds;                 // From noticing the write to the shaders being ready
+	bool lastFailed;
+};
+
+class ShaderReloadService
+{
+public:
+	ShaderReloadService();
+	~ShaderReloadService();
+
+	// Starts the watch thread, which creates the new shaders on the device
+	HRESULT Start(ID3D11Device* device);
+	void Stop();
+
+	// Returns the id to unregister with.  vertexShaderBlob is the bytecode the effect's input
+	// layouts were created from; a new vertex shader with another input signature is rejected.
+	UINT Register(IShaderReloadTarget* target, const std::vector<ShaderStageSource>& stages,
+		ID3DBlob* vertexShaderBlob = nullptr);
+	void Unregister(UINT id);
+
+	// Swaps in the shaders compiled since the last call, between two frames.  Returns the
+	// number of effects that changed.
+	UINT ApplyPendingReloads();
+
+	const ShaderReloadStats& GetStats() const { return stats; }
+
+private:
+	struct Stage
+	{
+		ShaderStageSource source;
+		std::wstring mediaPath;         // Where DXUT found the file, what the compiler is given
+		std::wstring path;              // Full lower case path, to compare with the watched files
+	};
+
+	struct Registration
+	{
+		IShaderReloadTarget* target;
+		std::vector<Stage> stages;
+		Microsoft::WRL::ComPtr<ID3DBlob> vertexShaderBlob;
+	};
+
+	struct PendingReload
+	{
+		UINT id;
+		std::vector<ReloadedShader> shaders;
+		bool failed;
+	};
+
+	void WatchThread();
+	// Compiles the stages of the registrations that use one of the changed files
+	void RecompileChanged(const std::map<UINT, Registration>& snapshot, const std::vector<std::wstring>& changedFiles);
+
+	ID3D11Device* device;
+	std::thread thread;
+	HANDLE stopEvent;
+
+	std::mutex lock;                    // Guards the members below
+	std::map<UINT, Registration> registrations;
+	UINT nextId;
+	UINT generation;                    // Bumped by Register to have the thread watch new files
+	std::vector<PendingReload> pending;
+	ShaderReloadStats threadStats;      // Watched files and the last change, copied to stats between frames
+
+	ShaderReloadStats stats;
+};
+
+// Compiles a stage from the file DXUT found at mediaPath, with the stage's defines
+HRESULT CompileShaderStage(const WCHAR* mediaPath, const ShaderStageSource& source, ID3DBlob** blob, std::string* errors);
+
+// The vertex, hull, domain, geometry or pixel shader of bytecode compiled for profile
+HRESULT CreateShaderFromBytecode(ID3D11Device* device, const std::string& profile, ID3DBlob* bytecode,
+	ID3D11DeviceChild** shader);
+
+// Newest write time of a source file and its transitive include set, 0 if the file is missing
+UINT64 GetShaderSourceWriteTime(const WCHAR* mediaPath);
+
+#endif
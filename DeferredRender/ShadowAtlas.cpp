@@ -0,0 +1,669 @@
+#include "DXUT.h"
+#include "strsafe.h"
+#include "ShadowAtlas.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+namespace
+{
+	const float SQRT2 = 1.41421356f;
+
+	// Looking down +x, -x, +y, -y, +z, -z
+	const XMFLOAT3 FACE_DIRECTIONS[SHADOW_ATLAS_FACES] =
+	{
+		XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(-1.0f, 0.0f, 0.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, -1.0f, 0.0f),
+		XMFLOAT3(0.0f, 0.0f, 1.0f), XMFLOAT3(0.0f, 0.0f, -1.0f)
+	};
+	const XMFLOAT3 FACE_UPS[SHADOW_ATLAS_FACES] =
+	{
+		XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f),
+		XMFLOAT3(0.0f, 0.0f, -1.0f), XMFLOAT3(0.0f, 0.0f, 1.0f),
+		XMFLOAT3(0.0f, 1.0f, 0.0f), XMFLOAT3(0.0f, 1.0f, 0.0f)
+	};
+
+	XMMATRIX GetFaceViewProjection(const XMFLOAT3& position, float range, UINT face)
+	{
+		XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&position), XMLoadFloat3(&FACE_DIRECTIONS[face]), XMLoadFloat3(&FACE_UPS[face]));
+		return view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 1.0f, range * SHADOW_ATLAS_NEAR, range);
+	}
+
+	bool SameSphere(const ShadowCaster& a, const ShadowCaster& b)
+	{
+		return a.center.x == b.center.x && a.center.y == b.center.y && a.center.z == b.center.z && a.radius == b.radius;
+	}
+
+	bool SameTile(const ShadowAtlasTile& a, const ShadowAtlasTile& b)
+	{
+		return a.x == b.x && a.y == b.y && a.size == b.size;
+	}
+}
+
+//---------------------------------------------------------------------------------
+// A face covers the directions where its axis is the largest component.  The sphere
+// is tested against the four planes through the light between the face and its
+// neighbours, and against the range.
+//---------------------------------------------------------------------------------
+bool IsSphereInShadowFace(const XMFLOAT3& position, float range, UINT face, const XMFLOAT3& center, float radius)
+{
+	float d[3] = { center.x - position.x, center.y - position.y, center.z - position.z };
+	if (d[0] * d[0] + d[1] * d[1] + d[2] * d[2] > (range + radius) * (range + radius))
+		return false;
+
+	UINT axis = face / 2;
+	float along = (face & 1) ? -d[axis] : d[axis];
+	return along + radius * SQRT2 >= fabsf(d[(axis + 1) % 3]) && along + radius * SQRT2 >= fabsf(d[(axis + 2) % 3]);
+}
+
+//---------------------------------------------------------------------------------
+ShadowAtlas::ShadowAtlas() : atlasSize(0), minTile(0), maxTile(0), frame(0)
+{
+	ZeroMemory(&stats, sizeof(stats));
+	Init();
+}
+
+void ShadowAtlas::Init(UINT atlasSize, UINT minTile, UINT maxTile)
+{
+	this->atlasSize = 1;
+	while (this->atlasSize * 2 <= atlasSize)
+		this->atlasSize *= 2;
+	this->maxTile = 1;
+	while (this->maxTile * 2 <= min(maxTile, this->atlasSize))
+		this->maxTile *= 2;
+	this->minTile = 1;
+	while (this->minTile * 2 <= min(minTile, this->maxTile))
+		this->minTile *= 2;
+
+	freeTiles.assign(GetLevel(this->minTile) + 1, std::vector<ShadowAtlasTile>());
+	ShadowAtlasTile whole = { 0, 0, this->atlasSize };
+	freeTiles[0].push_back(whole);
+	entries.clear();
+	previousCasters.clear();
+	lightFaces.clear();
+	renderFaces.clear();
+	frame = 0;
+}
+
+UINT ShadowAtlas::GetLevel(UINT size) const
+{
+	UINT level = 0;
+	while ((atlasSize >> level) > size)
+		++level;
+	return level;
+}
+
+UINT ShadowAtlas::GetTileSize(float screenCoverage) const
+{
+	float texels = screenCoverage * maxTile;
+	UINT size = minTile;
+	while (size * 2 <= maxTile && size * 2 <= texels)
+		size *= 2;
+	return size;
+}
+
+//---------------------------------------------------------------------------------
+// Quadtree buddies: a free tile is split into four, and a freed tile merges with its
+// three siblings when they are all free
+//---------------------------------------------------------------------------------
+bool ShadowAtlas::AllocateTile(UINT size, ShadowAtlasTile* tile)
+{
+	UINT level = GetLevel(size);
+	UINT from = level + 1;
+	while (from-- > 0 && freeTiles[from].empty())
+		;
+	if (from > level)
+		return false;
+
+	ShadowAtlasTile t = freeTiles[from].back();
+	freeTiles[from].pop_back();
+	for (; from < level; ++from)
+	{
+		t.size /= 2;
+		ShadowAtlasTile right = { t.x + t.size, t.y, t.size };
+		ShadowAtlasTile bottom = { t.x, t.y + t.size, t.size };
+		ShadowAtlasTile corner = { t.x + t.size, t.y + t.size, t.size };
+		freeTiles[from + 1].push_back(corner);
+		freeTiles[from + 1].push_back(bottom);
+		freeTiles[from + 1].push_back(right);
+	}
+	*tile = t;
+	return true;
+}
+
+void ShadowAtlas::FreeTile(const ShadowAtlasTile& tile)
+{
+	ShadowAtlasTile t = tile;
+	for (UINT level = GetLevel(t.size); level > 0; --level)
+	{
+		std::vector<ShadowAtlasTile>& list = freeTiles[level];
+		UINT parentX = t.x & ~(2 * t.size - 1);
+		UINT parentY = t.y & ~(2 * t.size - 1);
+		size_t siblings[3];
+		UINT found = 0;
+		for (size_t i = 0; i < list.size() && found < 3; ++i)
+		{
+			if ((list[i].x & ~(2 * t.size - 1)) == parentX && (list[i].y & ~(2 * t.size - 1)) == parentY)
+				siblings[found++] = i;
+		}
+		if (found < 3)
+		{
+			list.push_back(t);
+			return;
+		}
+
+		// Highest index first, the others stay valid
+		std::sort(siblings, siblings + 3);
+		for (int i = 2; i >= 0; --i)
+		{
+			list[siblings[i]] = list.back();
+			list.pop_back();
+		}
+		ShadowAtlasTile parent = { parentX, parentY, t.size * 2 };
+		t = parent;
+	}
+	freeTiles[0].push_back(t);
+}
+
+bool ShadowAtlas::AllocateEntry(Entry& entry, UINT size)
+{
+	for (UINT face = 0; face < SHADOW_ATLAS_FACES; ++face)
+	{
+		if (AllocateTile(size, &entry.tiles[face]))
+			continue;
+
+		while (face-- > 0)
+			FreeTile(entry.tiles[face]);
+		return false;
+	}
+	entry.tileSize = size;
+	entry.rendered = 0;
+	return true;
+}
+
+void ShadowAtlas::FreeEntry(Entry& entry)
+{
+	for (UINT face = 0; face < SHADOW_ATLAS_FACES; ++face)
+		FreeTile(entry.tiles[face]);
+	entry.tileSize = 0;
+}
+
+bool ShadowAtlas::EvictEntry()
+{
+	size_t oldest = entries.size();
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		if (entries[i].lastFrame != frame && (oldest == entries.size() || entries[i].lastFrame < entries[oldest].lastFrame))
+			oldest = i;
+	}
+	if (oldest == entries.size())
+		return false;
+
+	FreeEntry(entries[oldest]);
+	entries.erase(entries.begin() + oldest);
+	stats.evictedLights++;
+	return true;
+}
+
+//---------------------------------------------------------------------------------
+// The lights keep their tile size while their coverage stays within the hysteresis
+// of it.  Shrinking tiles are given back first, then the new and growing lights are
+// served by coverage, largest first.  A growing light that doesn't fit keeps its tiles.
+//---------------------------------------------------------------------------------
+void ShadowAtlas::Update(const std::vector<PointShadowLight>& lights, const std::vector<ShadowCaster>& casters)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	ZeroMemory(&stats, sizeof(stats));
+	frame++;
+
+	// Where the changed casters were and are
+	std::vector<ShadowCaster> changed;
+	for (size_t i = 0; i < max(casters.size(), previousCasters.size()); ++i)
+	{
+		if (i < casters.size() && i < previousCasters.size() && SameSphere(casters[i], previousCasters[i]))
+			continue;
+
+		if (i < previousCasters.size())
+			changed.push_back(previousCasters[i]);
+		if (i < casters.size())
+			changed.push_back(casters[i]);
+		stats.changedCasters++;
+	}
+	previousCasters = casters;
+
+	std::vector<UINT> order;
+	for (UINT i = 0; i < (UINT)lights.size(); ++i)
+	{
+		if (lights[i].screenCoverage > 0.0f && lights[i].range > 0.0f)
+			order.push_back(i);
+	}
+	std::stable_sort(order.begin(), order.end(), [&](UINT a, UINT b)
+	{
+		return lights[a].screenCoverage > lights[b].screenCoverage;
+	});
+	stats.requestedLights = order.size();
+
+	auto find = [this](UINT id) -> Entry*
+	{
+		for (size_t i = 0; i < entries.size(); ++i)
+		{
+			if (entries[i].id == id)
+				return &entries[i];
+		}
+		return nullptr;
+	};
+
+	std::vector<UINT> sizes(lights.size(), 0);
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const PointShadowLight& light = lights[order[i]];
+		UINT size = GetTileSize(light.screenCoverage);
+		Entry* entry = find(light.id);
+		if (entry)
+		{
+			entry->lastFrame = frame;
+			float texels = light.screenCoverage * maxTile;
+			bool above = entry->tileSize == minTile || texels >= entry->tileSize * (1.0f - SHADOW_ATLAS_HYSTERESIS);
+			bool below = entry->tileSize == maxTile || texels < entry->tileSize * 2.0f * (1.0f + SHADOW_ATLAS_HYSTERESIS);
+			if (above && below)
+				size = entry->tileSize;
+			else if (size < entry->tileSize)
+			{
+				// Always fits in the space just freed
+				FreeEntry(*entry);
+				if (!AllocateEntry(*entry, size))
+					entries.erase(entries.begin() + (entry - entries.data()));
+				stats.resizedLights++;
+			}
+		}
+		sizes[order[i]] = size;
+	}
+
+	for (size_t i = 0; i < order.size(); ++i)
+	{
+		const PointShadowLight& light = lights[order[i]];
+		UINT size = sizes[order[i]];
+		Entry* entry = find(light.id);
+		if (entry && entry->tileSize >= size)
+			continue;
+
+		Entry created;
+		ZeroMemory(&created, sizeof(created));
+		created.id = light.id;
+		created.lastFrame = frame;
+		for (;;)
+		{
+			if (AllocateEntry(created, size))
+				break;
+			if (EvictEntry())
+				continue;
+			if (entry || size / 2 < minTile)
+			{
+				created.tileSize = 0;
+				break;
+			}
+			size /= 2;
+		}
+		if (created.tileSize == 0)
+			continue;
+
+		// Evictions move the entries
+		entry = find(light.id);
+		if (entry)
+		{
+			FreeEntry(*entry);
+			*entry = created;
+			stats.resizedLights++;
+		}
+		else
+			entries.push_back(created);
+	}
+
+	// The faces of the lights not asked for are invalidated too, they may come back
+	for (size_t i = 0; i < entries.size(); ++i)
+	{
+		Entry& entry = entries[i];
+		if (entry.lastFrame == frame)
+			continue;
+		for (UINT face = 0; face < SHADOW_ATLAS_FACES; ++face)
+		{
+			for (size_t c = 0; c < changed.size() && (entry.rendered & (1 << face)); ++c)
+			{
+				if (IsSphereInShadowFace(entry.position, entry.range, face, changed[c].center, changed[c].radius))
+					entry.rendered &= ~(1 << face);
+			}
+		}
+	}
+
+	lightFaces.resize(lights.size());
+	renderFaces.clear();
+	float usedTexels = 0.0f;
+	for (UINT i = 0; i < (UINT)lights.size(); ++i)
+	{
+		PointShadowFaces& faces = lightFaces[i];
+		const PointShadowLight& light = lights[i];
+		Entry* entry = sizes[i] ? find(light.id) : nullptr;
+		faces.shadowed = entry != nullptr;
+		if (!entry)
+			continue;
+
+		bool moved = entry->position.x != light.position.x || entry->position.y != light.position.y ||
+			entry->position.z != light.position.z || entry->range != light.range;
+		entry->position = light.position;
+		entry->range = light.range;
+
+		stats.shadowedLights++;
+		if (entry->tileSize < GetTileSize(light.screenCoverage))
+			stats.downsizedLights++;
+
+		size_t rendered = renderFaces.size();
+		for (UINT face = 0; face < SHADOW_ATLAS_FACES; ++face)
+		{
+			faces.tiles[face] = entry->tiles[face];
+			XMStoreFloat4x4(&faces.viewProjection[face], GetFaceViewProjection(light.position, light.range, face));
+
+			bool dirty = moved || !(entry->rendered & (1 << face));
+			for (size_t c = 0; c < changed.size() && !dirty; ++c)
+				dirty = IsSphereInShadowFace(light.position, light.range, face, changed[c].center, changed[c].radius);
+			if (!dirty)
+				continue;
+
+			PointShadowFace render;
+			render.light = i;
+			render.face = face;
+			render.tile = faces.tiles[face];
+			render.viewProjection = faces.viewProjection[face];
+			for (UINT c = 0; c < (UINT)casters.size(); ++c)
+			{
+				if (IsSphereInShadowFace(light.position, light.range, face, casters[c].center, casters[c].radius))
+					render.casters.push_back(c);
+			}
+			renderFaces.push_back(render);
+			entry->rendered |= 1 << face;
+		}
+		if (renderFaces.size() == rendered)
+			stats.cachedLights++;
+	}
+	for (size_t i = 0; i < entries.size(); ++i)
+		usedTexels += SHADOW_ATLAS_FACES * (float)entries[i].tileSize * entries[i].tileSize;
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	stats.renderedFaces = renderFaces.size();
+	stats.usedArea = usedTexels / ((float)atlasSize * atlasSize);
+	stats.seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+}
+
+//---------------------------------------------------------------------------------
+// The scenes share a row of lights over a field of casters; the camera's distance
+// sets the coverages
+//---------------------------------------------------------------------------------
+void RecordShadowAtlasScene(ShadowAtlasScene scene, UINT frames, std::vector<ShadowAtlasFrame>& recording)
+{
+	UINT lightCount = scene == SHADOW_ATLAS_SCENE_OVERCOMMIT ? 48 : 8;
+	const float spacing = 6.0f;
+	const float range = 4.0f;
+
+	ShadowAtlasFrame base;
+	UINT seed = 12345;
+	auto random = [&seed]()
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return (seed >> 8) / 16777216.0f;
+	};
+	for (UINT i = 0; i < lightCount; ++i)
+	{
+		PointShadowLight light = { i, XMFLOAT3(spacing * i, 0.0f, 2.0f), range, 0.3f };
+		base.lights.push_back(light);
+	}
+	for (UINT i = 0; i < lightCount * 5; ++i)
+	{
+		ShadowCaster caster = { XMFLOAT3(spacing * lightCount * random() - 0.5f * spacing, 8.0f * random() - 4.0f, 2.0f * random()),
+			0.3f + 0.7f * random() };
+		base.casters.push_back(caster);
+	}
+
+	recording.assign(frames, base);
+	for (UINT f = 0; f < frames; ++f)
+	{
+		ShadowAtlasFrame& frame = recording[f];
+		float t = (float)f / max(frames, 1u);
+		switch (scene)
+		{
+		case SHADOW_ATLAS_SCENE_MOVING_CASTER:
+			frame.casters[0].center = XMFLOAT3(spacing * 1.5f + 5.0f * cosf(XM_2PI * t), 5.0f * sinf(XM_2PI * t), 1.0f);
+			frame.casters[0].radius = 0.8f;
+			break;
+		case SHADOW_ATLAS_SCENE_MOVING_LIGHT:
+			frame.lights[3].position = XMFLOAT3(spacing * 3 + 2.0f * cosf(XM_2PI * t), 2.0f * sinf(XM_2PI * t), 2.0f);
+			break;
+		case SHADOW_ATLAS_SCENE_CAMERA_DOLLY:
+			for (size_t i = 0; i < frame.lights.size(); ++i)
+				frame.lights[i].screenCoverage = 0.3f + 0.28f * sinf(XM_2PI * 2.0f * t + 0.3f * i);
+			break;
+		case SHADOW_ATLAS_SCENE_OVERCOMMIT:
+			// Out and back, the lights come back to cached tiles unless they were evicted
+			for (size_t i = 0; i < frame.lights.size(); ++i)
+			{
+				float distance = fabsf((float)i - (0.5f - 0.5f * cosf(XM_2PI * t)) * lightCount);
+				frame.lights[i].screenCoverage = distance < 8.0f ? (distance < 3.0f ? 0.7f : 0.3f) : 0.0f;
+			}
+			// Moved between lights that are cached but not asked for at the time
+			frame.casters[0].center = XMFLOAT3(spacing * (30.0f + 20.0f * min(max(t - 0.45f, 0.0f), 0.05f)), 1.0f, 1.0f);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+//---------------------------------------------------------------------------------
+// The model remembers what each face showed when it was rendered, and which face was
+// rendered last over every minimum size cell of the atlas.  A face kept from an earlier
+// frame has to show the same thing and still own its cells.
+//---------------------------------------------------------------------------------
+ShadowAtlasReplayResult ReplayShadowAtlas(const std::vector<ShadowAtlasFrame>& recording)
+{
+	ShadowAtlasReplayResult result;
+	result.frames = (UINT)recording.size();
+	result.totalRenderedFaces = 0;
+	result.maxRenderedFaces = 0;
+	result.shadowedLightFrames = 0;
+	result.resizes = 0;
+	result.evictions = 0;
+	result.staleFaces = 0;
+	result.redundantFaces = 0;
+	result.overlappingTiles = 0;
+	result.averageMilliseconds = 0.0;
+
+	ShadowAtlas atlas;
+	const UINT cellCount = SHADOW_ATLAS_SIZE / SHADOW_ATLAS_MIN_TILE;
+	std::vector<UINT> owners(cellCount * cellCount, 0);
+
+	struct FaceContent
+	{
+		UINT key;                       // Light id * SHADOW_ATLAS_FACES + face + 1
+		ShadowAtlasTile tile;
+		XMFLOAT3 position;
+		float range;
+		std::vector<ShadowCaster> casters;
+	};
+	std::vector<FaceContent> contents;
+	auto content = [&contents](UINT key) -> FaceContent*
+	{
+		for (size_t i = 0; i < contents.size(); ++i)
+		{
+			if (contents[i].key == key)
+				return &contents[i];
+		}
+		return nullptr;
+	};
+	auto owns = [&](UINT key, const ShadowAtlasTile& tile)
+	{
+		for (UINT y = tile.y / SHADOW_ATLAS_MIN_TILE; y < (tile.y + tile.size) / SHADOW_ATLAS_MIN_TILE; ++y)
+			for (UINT x = tile.x / SHADOW_ATLAS_MIN_TILE; x < (tile.x + tile.size) / SHADOW_ATLAS_MIN_TILE; ++x)
+				if (owners[y * cellCount + x] != key)
+					return false;
+		return true;
+	};
+
+	double totalSeconds = 0.0;
+	for (UINT f = 0; f < result.frames; ++f)
+	{
+		const ShadowAtlasFrame& frame = recording[f];
+		atlas.Update(frame.lights, frame.casters);
+		const ShadowAtlasStats& stats = atlas.GetStats();
+		totalSeconds += stats.seconds;
+		result.shadowedLightFrames += stats.shadowedLights;
+		result.resizes += stats.resizedLights;
+		result.evictions += stats.evictedLights;
+
+		UINT rendered = (UINT)stats.renderedFaces;
+		result.renderedFaces.push_back(rendered);
+		result.totalRenderedFaces += rendered;
+		if (f > 0)
+			result.maxRenderedFaces = max(result.maxRenderedFaces, rendered);
+
+		std::vector<ShadowAtlasTile> tiles;
+		std::vector<bool> renderedFaces(frame.lights.size() * SHADOW_ATLAS_FACES, false);
+		const std::vector<PointShadowFace>& faces = atlas.GetRenderFaces();
+		for (size_t i = 0; i < faces.size(); ++i)
+			renderedFaces[faces[i].light * SHADOW_ATLAS_FACES + faces[i].face] = true;
+
+		for (UINT l = 0; l < (UINT)frame.lights.size(); ++l)
+		{
+			const PointShadowLight& light = frame.lights[l];
+			const PointShadowFaces& lightFaces = atlas.GetLightFaces(l);
+			if (!lightFaces.shadowed)
+				continue;
+
+			for (UINT face = 0; face < SHADOW_ATLAS_FACES; ++face)
+			{
+				FaceContent now;
+				now.key = light.id * SHADOW_ATLAS_FACES + face + 1;
+				now.tile = lightFaces.tiles[face];
+				now.position = light.position;
+				now.range = light.range;
+				for (size_t c = 0; c < frame.casters.size(); ++c)
+				{
+					if (IsSphereInShadowFace(light.position, light.range, face, frame.casters[c].center, frame.casters[c].radius))
+						now.casters.push_back(frame.casters[c]);
+				}
+				tiles.push_back(now.tile);
+
+				FaceContent* before = content(now.key);
+				bool same = before && SameTile(before->tile, now.tile) && owns(now.key, now.tile) &&
+					before->position.x == now.position.x && before->position.y == now.position.y &&
+					before->position.z == now.position.z && before->range == now.range &&
+					before->casters.size() == now.casters.size() &&
+					std::equal(now.casters.begin(), now.casters.end(), before->casters.begin(), SameSphere);
+
+				if (!renderedFaces[l * SHADOW_ATLAS_FACES + face])
+				{
+					if (!same)
+						result.staleFaces++;
+					continue;
+				}
+				if (same)
+					result.redundantFaces++;
+
+				for (UINT y = now.tile.y / SHADOW_ATLAS_MIN_TILE; y < (now.tile.y + now.tile.size) / SHADOW_ATLAS_MIN_TILE; ++y)
+					for (UINT x = now.tile.x / SHADOW_ATLAS_MIN_TILE; x < (now.tile.x + now.tile.size) / SHADOW_ATLAS_MIN_TILE; ++x)
+						owners[y * cellCount + x] = now.key;
+				if (before)
+					*before = now;
+				else
+					contents.push_back(now);
+			}
+		}
+
+		for (size_t a = 0; a < tiles.size(); ++a)
+		{
+			const ShadowAtlasTile& t = tiles[a];
+			if (t.x + t.size > SHADOW_ATLAS_SIZE || t.y + t.size > SHADOW_ATLAS_SIZE)
+				result.overlappingTiles++;
+			for (size_t b = a + 1; b < tiles.size(); ++b)
+			{
+				const ShadowAtlasTile& u = tiles[b];
+				if (t.x < u.x + u.size && u.x < t.x + t.size && t.y < u.y + u.size && u.y < t.y + t.size)
+					result.overlappingTiles++;
+			}
+		}
+	}
+
+	result.averageMilliseconds = result.frames ? totalSeconds * 1000.0 / result.frames : 0.0;
+	return result;
+}
+
+HRESULT TestShadowAtlasReplays(UINT frames)
+{
+	// Besides keeping the model's contents, what each scene is recorded to do
+	struct SceneExpectation
+	{
+		const WCHAR* name;
+		int facesPerFrame;              // After the first frame, -1 for any number
+		bool resizes;
+		bool evictions;
+	};
+	const SceneExpectation expectations[SHADOW_ATLAS_SCENE_COUNT] =
+	{
+		{ L"static", 0, false, false },
+		{ L"moving caster", -1, false, false },
+		{ L"moving light", SHADOW_ATLAS_FACES, false, false },
+		{ L"camera dolly", -1, true, false },
+		{ L"overcommit", -1, true, true },
+	};
+
+	HRESULT hr = S_OK;
+	WCHAR szMsg[512];
+	for (int scene = 0; scene < SHADOW_ATLAS_SCENE_COUNT; ++scene)
+	{
+		const SceneExpectation& expected = expectations[scene];
+		std::vector<ShadowAtlasFrame> recording;
+		RecordShadowAtlasScene((ShadowAtlasScene)scene, frames, recording);
+		ShadowAtlasReplayResult result = ReplayShadowAtlas(recording);
+
+		StringCchPrintf(szMsg, 512, L"Shadow atlas, %s: %u frames, %u faces on the first, then at most %u (%.2f mean), "
+			L"%Iu resizes, %Iu evictions; %Iu stale, %Iu redundant, %Iu overlapping tiles; %.4f ms per update\n",
+			expected.name, result.frames, result.frames ? result.renderedFaces[0] : 0, result.maxRenderedFaces,
+			result.frames > 1 ? (double)(result.totalRenderedFaces - result.renderedFaces[0]) / (result.frames - 1) : 0.0,
+			result.resizes, result.evictions, result.staleFaces, result.redundantFaces, result.overlappingTiles,
+			result.averageMilliseconds);
+		OutputDebugString(szMsg);
+
+		// Rendered faces per frame, 32 to a line
+		for (UINT f = 0; f < result.frames; f += 32)
+		{
+			size_t length = 0;
+			StringCchPrintf(szMsg, 512, L"  %4u:", f);
+			for (UINT i = f; i < min(f + 32, result.frames); ++i)
+			{
+				StringCchLength(szMsg, 512, &length);
+				StringCchPrintf(szMsg + length, 512 - length, L" %u", result.renderedFaces[i]);
+			}
+			StringCchCat(szMsg, 512, L"\n");
+			OutputDebugString(szMsg);
+		}
+
+		UINT wrongFrames = 0;
+		for (UINT f = 1; f < result.frames; ++f)
+		{
+			if (expected.facesPerFrame >= 0 && result.renderedFaces[f] != (UINT)expected.facesPerFrame)
+				wrongFrames++;
+		}
+		if (result.staleFaces || result.redundantFaces || result.overlappingTiles || wrongFrames ||
+			(result.resizes > 0) != expected.resizes || (result.evictions > 0) != expected.evictions)
+		{
+			StringCchPrintf(szMsg, 512, L"  FAILED: %Iu stale, %Iu redundant, %Iu overlapping faces, %u frames off the "
+				L"expected face count; %Iu resizes and %Iu evictions where %s and %s were expected\n",
+				result.staleFaces, result.redundantFaces, result.overlappingTiles, wrongFrames, result.resizes,
+				result.evictions, expected.resizes ? L"some" : L"none", expected.evictions ? L"some" : L"none");
+			OutputDebugString(szMsg);
+			hr = E_FAIL;
+		}
+	}
+	return hr;
+}
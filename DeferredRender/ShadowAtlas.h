@@ -0,0 +1,175 @@
+//--------------------------------------------------------------------------------------
+// File: ShadowAtlas.h
+//
+// Shadows of the point lights, the CPU side.  Every shadowed light gets six square tiles
+// of one depth atlas, one per cube face, sized by how much of the screen its sphere
+// covers and handed out by a buddy allocator.  The tiles are kept from frame to frame:
+// a face is rendered again only when its tile is new, its light moved or a caster that
+// overlaps it, before or after, was moved, added or removed.  A static light over static
+// casters costs no draws after its first frame.  When the atlas is full the lights that
+// weren't asked for longest lose their tiles first, then the new lights are given
+// smaller ones.  Nothing here touches the device.
+//--------------------------------------------------------------------------------------
+#ifndef SHADOW_ATLAS_H
+#define SHADOW_ATLAS_H
+
+#include <vector>
+#include <DirectXMath.h>
+#include "ShadowCascades.h"
+
+#define SHADOW_ATLAS_SIZE           4096
+#define SHADOW_ATLAS_MIN_TILE       64
+#define SHADOW_ATLAS_MAX_TILE       1024
+#define SHADOW_ATLAS_FACES          6           // +x, -x, +y, -y, +z, -z
+#define SHADOW_ATLAS_HYSTERESIS     0.25f       // Fraction past a power of two the coverage has to go to resize a tile
+#define SHADOW_ATLAS_NEAR           0.02f       // Near plane of the faces, a fraction of the light's range
+
+// Texels of the atlas
+struct ShadowAtlasTile
+{
+	UINT x;
+	UINT y;
+	UINT size;
+};
+
+struct PointShadowLight
+{
+	UINT id;                            // Keys the cached tiles, stable over the frames
+	DirectX::XMFLOAT3 position;         // World space
+	float range;                        // Far plane of the faces
+	float screenCoverage;               // Diameter over the screen height, 0 to leave the light unshadowed
+};
+
+// Where a light's faces are in the atlas and how to look them up
+struct PointShadowFaces
+{
+	bool shadowed;
+	ShadowAtlasTile tiles[SHADOW_ATLAS_FACES];
+	DirectX::XMFLOAT4X4 viewProjection[SHADOW_ATLAS_FACES];    // World to face clip space, row-vector
+};
+
+// A face to render this frame
+struct PointShadowFace
+{
+	UINT light;                         // Index into the lights given to Update
+	UINT face;
+	ShadowAtlasTile tile;
+	DirectX::XMFLOAT4X4 viewProjection;
+	std::vector<UINT> casters;          // Indices into the casters given to Update, those over the face
+};
+
+struct ShadowAtlasStats
+{
+	size_t requestedLights;             // Of non-zero coverage
+	size_t shadowedLights;
+	size_t cachedLights;                // Shadowed without a face rendered
+	size_t renderedFaces;
+	size_t resizedLights;               // Tiles given back for another size
+	size_t downsizedLights;             // Given tiles smaller than their coverage asks for
+	size_t evictedLights;               // Tiles taken from lights not asked for this frame
+	size_t changedCasters;
+	float usedArea;                     // Fraction of the atlas in tiles
+	double seconds;
+};
+
+class ShadowAtlas
+{
+public:
+	ShadowAtlas();
+
+	// Drops every tile; the sizes are rounded down to powers of two
+	void Init(UINT atlasSize = SHADOW_ATLAS_SIZE, UINT minTile = SHADOW_ATLAS_MIN_TILE, UINT maxTile = SHADOW_ATLAS_MAX_TILE);
+
+	// Allocates the tiles of the lights and lists the faces to render.  The casters are
+	// compared by index with the previous call's, so keep their order.
+	void Update(const std::vector<PointShadowLight>& lights, const std::vector<ShadowCaster>& casters);
+
+	UINT GetAtlasSize() const { return atlasSize; }
+	// Of the lights given to Update
+	const PointShadowFaces& GetLightFaces(UINT light) const { return lightFaces[light]; }
+	const std::vector<PointShadowFace>& GetRenderFaces() const { return renderFaces; }
+	const ShadowAtlasStats& GetStats() const { return stats; }
+
+	// The tile size a coverage asks for, before hysteresis
+	UINT GetTileSize(float screenCoverage) const;
+
+private:
+	struct Entry
+	{
+		UINT id;
+		UINT tileSize;
+		ShadowAtlasTile tiles[SHADOW_ATLAS_FACES];
+		DirectX::XMFLOAT3 position;
+		float range;
+		UINT rendered;                  // Bit per face whose tile holds it
+		UINT lastFrame;                 // Asked for
+	};
+
+	bool AllocateTile(UINT size, ShadowAtlasTile* tile);
+	void FreeTile(const ShadowAtlasTile& tile);
+	bool AllocateEntry(Entry& entry, UINT size);
+	void FreeEntry(Entry& entry);
+	// Drops the entry asked for longest ago, except in the current frame
+	bool EvictEntry();
+	UINT GetLevel(UINT size) const;
+
+	UINT atlasSize;
+	UINT minTile;
+	UINT maxTile;
+	UINT frame;
+	std::vector<std::vector<ShadowAtlasTile> > freeTiles;  // Per level, the whole atlas at level 0
+	std::vector<Entry> entries;
+	std::vector<ShadowCaster> previousCasters;
+	std::vector<PointShadowFaces> lightFaces;
+	std::vector<PointShadowFace> renderFaces;
+	ShadowAtlasStats stats;
+};
+
+// Whether the sphere may overlap the face of a light at position, out to range
+bool IsSphereInShadowFace(const DirectX::XMFLOAT3& position, float range, UINT face, const DirectX::XMFLOAT3& center, float radius);
+
+//--------------------------------------------------------------------------------------
+// Recorded scenes replayed through the atlas, with the results checked against a model
+// of its contents
+//--------------------------------------------------------------------------------------
+enum ShadowAtlasScene
+{
+	SHADOW_ATLAS_SCENE_STATIC,          // Nothing moves: only the first frame renders
+	SHADOW_ATLAS_SCENE_MOVING_CASTER,   // A caster circles between the lights
+	SHADOW_ATLAS_SCENE_MOVING_LIGHT,    // One light orbits
+	SHADOW_ATLAS_SCENE_CAMERA_DOLLY,    // The coverages swing, the tiles resize
+	SHADOW_ATLAS_SCENE_OVERCOMMIT,      // A pan back and forth over more lights than fit, with a caster crossing them
+	SHADOW_ATLAS_SCENE_COUNT
+};
+
+struct ShadowAtlasFrame
+{
+	std::vector<PointShadowLight> lights;
+	std::vector<ShadowCaster> casters;
+};
+
+void RecordShadowAtlasScene(ShadowAtlasScene scene, UINT frames, std::vector<ShadowAtlasFrame>& recording);
+
+struct ShadowAtlasReplayResult
+{
+	UINT frames;
+	std::vector<UINT> renderedFaces;    // Per frame
+	size_t totalRenderedFaces;
+	UINT maxRenderedFaces;              // After the first frame
+	size_t shadowedLightFrames;         // Sum over the frames
+	size_t resizes;
+	size_t evictions;
+	size_t staleFaces;                  // Kept although their contents changed or were overwritten
+	size_t redundantFaces;              // Rendered although nothing they show changed
+	size_t overlappingTiles;            // Pairs of tiles of one frame that overlap or leave the atlas
+	double averageMilliseconds;
+};
+
+ShadowAtlasReplayResult ReplayShadowAtlas(const std::vector<ShadowAtlasFrame>& recording);
+
+// Replays every scene and writes the rendered faces per frame to the debug output.  Fails
+// if a face was stale, redundant or overlapping, or a scene rendered, resized or evicted
+// other than it was recorded to.
+HRESULT TestShadowAtlasReplays(UINT frames);
+
+#endif
@@ -0,0 +1,206 @@
+#include "DXUT.h"
+#include "ShadowCascades.h"
+#include <ppl.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Looks along the light, from the world origin: translating the camera moves the
+	// cascades in light space by whole texels after the snap, it never rotates them
+	XMMATRIX GetLightView(const XMFLOAT3& lightDirection)
+	{
+		XMVECTOR forward = -XMVector3Normalize(XMLoadFloat3(&lightDirection));
+		XMVECTOR up = fabsf(XMVectorGetZ(forward)) < 0.99f ? XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f) : XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f);
+		return XMMatrixLookToLH(XMVectorZero(), forward, up);
+	}
+}
+
+//---------------------------------------------------------------------------------
+ShadowSettings ShadowSettings::Default()
+{
+	ShadowSettings settings;
+	settings.cascadeCount = 3;
+	settings.resolution = 1024;
+	settings.maxDistance = 60.0f;
+	settings.splitLambda = 0.75f;
+	settings.depthBias = 1.0f;
+	settings.slopeScaledDepthBias = 2.0f;
+	settings.normalOffset = 1.5f;
+	return settings;
+}
+
+//---------------------------------------------------------------------------------
+ShadowCascades::ShadowCascades()
+{
+	SetSettings(ShadowSettings::Default());
+	ZeroMemory(cascades, sizeof(cascades));
+	ZeroMemory(&stats, sizeof(stats));
+}
+
+void ShadowCascades::SetSettings(const ShadowSettings& newSettings)
+{
+	settings = newSettings;
+	settings.cascadeCount = min(max(settings.cascadeCount, 1u), (UINT)SHADOW_MAX_CASCADES);
+	settings.resolution = min(max(settings.resolution, (UINT)SHADOW_MIN_RESOLUTION), (UINT)SHADOW_MAX_RESOLUTION);
+	settings.splitLambda = min(max(settings.splitLambda, 0.0f), 1.0f);
+	settings.depthBias = max(settings.depthBias, 0.0f);
+	settings.normalOffset = max(settings.normalOffset, 0.0f);
+}
+
+//---------------------------------------------------------------------------------
+// The splits blend uniform and logarithmic spacing: logarithmic keeps the texel to
+// pixel ratio even over the range, uniform spends less on the first few units
+//---------------------------------------------------------------------------------
+void ShadowCascades::Update(const XMFLOAT4X4& view, float fovY, float aspect, float zNear,
+	const XMFLOAT3& lightDirection, const std::vector<ShadowCaster>& casters)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	float zFar = max(settings.maxDistance, zNear * 2.0f);
+	float splitNear = zNear;
+	for (UINT i = 0; i < settings.cascadeCount; ++i)
+	{
+		float t = (float)(i + 1) / settings.cascadeCount;
+		float uniform = zNear + (zFar - zNear) * t;
+		float logarithmic = zNear * powf(zFar / zNear, t);
+		cascades[i].splitNear = splitNear;
+		cascades[i].splitFar = uniform + settings.splitLambda * (logarithmic - uniform);
+		splitNear = cascades[i].splitFar;
+	}
+
+	XMFLOAT4X4 invView, lightView;
+	XMStoreFloat4x4(&invView, XMMatrixInverse(nullptr, XMLoadFloat4x4(&view)));
+	XMStoreFloat4x4(&lightView, GetLightView(lightDirection));
+	float tanY = tanf(fovY * 0.5f);
+	float tanX = tanY * aspect;
+
+	// The cascades share the light's view
+	XMMATRIX lightViewMatrix = XMLoadFloat4x4(&lightView);
+	lightSpaceCenters.resize(casters.size());
+	for (size_t i = 0; i < casters.size(); ++i)
+		XMStoreFloat3(&lightSpaceCenters[i], XMVector3TransformCoord(XMLoadFloat3(&casters[i].center), lightViewMatrix));
+
+	concurrency::parallel_for(0u, settings.cascadeCount, [&](UINT cascade)
+	{
+		FitCascade(cascade, invView, tanX, tanY, lightView, casters);
+	});
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	stats.cascadeCount = settings.cascadeCount;
+	stats.casterCount = (UINT)casters.size();
+	stats.drawCount = 0;
+	for (UINT i = 0; i < settings.cascadeCount; ++i)
+		stats.drawCount += (UINT)drawLists[i].size();
+	stats.seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+}
+
+//---------------------------------------------------------------------------------
+// The smallest sphere around the slice is centered on the view axis, where the near
+// and far corners are equally distant, or at the far plane if that is beyond it.  It
+// depends only on the split distances and the field of view.
+//---------------------------------------------------------------------------------
+void ShadowCascades::FitCascade(UINT index, const XMFLOAT4X4& invView, float tanX, float tanY,
+	const XMFLOAT4X4& lightViewMatrix, const std::vector<ShadowCaster>& casters)
+{
+	ShadowCascade& cascade = cascades[index];
+	float n = cascade.splitNear;
+	float f = cascade.splitFar;
+	float k2 = tanX * tanX + tanY * tanY;
+	float z = min(0.5f * (n + f) * (1.0f + k2), f);
+	cascade.radius = sqrtf(f * f * k2 + (f - z) * (f - z));
+	cascade.texelSize = 2.0f * cascade.radius / settings.resolution;
+
+	XMMATRIX lightView = XMLoadFloat4x4(&lightViewMatrix);
+	XMVECTOR center = XMVector3TransformCoord(XMVectorSet(0.0f, 0.0f, z, 1.0f), XMLoadFloat4x4(&invView));
+	XMFLOAT3 lightCenter;
+	XMStoreFloat3(&lightCenter, XMVector3TransformCoord(center, lightView));
+	lightCenter.x = floorf(lightCenter.x / cascade.texelSize + 0.5f) * cascade.texelSize;
+	lightCenter.y = floorf(lightCenter.y / cascade.texelSize + 0.5f) * cascade.texelSize;
+	XMStoreFloat3(&cascade.center, XMVector3TransformCoord(XMLoadFloat3(&lightCenter), XMMatrixTranspose(lightView)));
+
+	// The casters over the light's view of the sphere, up to its far side, and the depth
+	// range from the nearest of them
+	std::vector<UINT>& drawList = drawLists[index];
+	drawList.clear();
+	float r = cascade.radius;
+	float zFar = lightCenter.z + r;
+	float zNear = lightCenter.z - r;
+	for (size_t i = 0; i < casters.size(); ++i)
+	{
+		const ShadowCaster& caster = casters[i];
+		const XMFLOAT3& c = lightSpaceCenters[i];
+		if (fabsf(c.x - lightCenter.x) > r + caster.radius || fabsf(c.y - lightCenter.y) > r + caster.radius ||
+			c.z - caster.radius > zFar)
+			continue;
+
+		zNear = min(zNear, c.z - caster.radius);
+		drawList.push_back((UINT)i);
+	}
+
+	XMMATRIX projection = XMMatrixOrthographicOffCenterLH(lightCenter.x - r, lightCenter.x + r,
+		lightCenter.y - r, lightCenter.y + r, zNear, zFar);
+	XMStoreFloat4x4(&cascade.viewProjection, lightView * projection);
+	cascade.depthBias = settings.depthBias * cascade.texelSize / (zFar - zNear);
+	cascade.normalOffset = settings.normalOffset * cascade.texelSize;
+}
+
+//---------------------------------------------------------------------------------
+// Casters scattered over a square around the origin, z up as the scene, and a camera
+// circling above them looking outwards
+//---------------------------------------------------------------------------------
+ShadowBenchmarkResult BenchmarkShadowCascades(const ShadowSettings& settings, UINT casterCount, UINT frames)
+{
+	ShadowBenchmarkResult result;
+	ZeroMemory(&result, sizeof(result));
+	result.frames = frames;
+	result.casterCount = casterCount;
+	result.minMilliseconds = DBL_MAX;
+	if (frames == 0)
+		return result;
+
+	const float extent = 200.0f;
+	std::vector<ShadowCaster> casters(casterCount);
+	UINT seed = 12345;
+	for (UINT i = 0; i < casterCount; ++i)
+	{
+		float r[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			r[j] = (seed >> 8) / 16777216.0f;
+		}
+		casters[i].center = XMFLOAT3(extent * (r[0] - 0.5f), extent * (r[1] - 0.5f), 1.0f);
+		casters[i].radius = 0.5f + 2.0f * r[2];
+	}
+
+	ShadowCascades shadows;
+	shadows.SetSettings(settings);
+	result.cascadeCount = shadows.GetCascadeCount();
+	XMFLOAT3 lightDirection(-0.85f, -0.25f, 0.45f);
+
+	double totalSeconds = 0.0, totalDraws = 0.0;
+	for (UINT frame = 0; frame < frames; ++frame)
+	{
+		float angle = XM_2PI * frame / frames;
+		XMVECTOR eye = XMVectorSet(20.0f * cosf(angle), 20.0f * sinf(angle), 10.0f, 1.0f);
+		XMVECTOR target = eye + XMVectorSet(cosf(angle), sinf(angle), -0.3f, 0.0f);
+		XMFLOAT4X4 view;
+		XMStoreFloat4x4(&view, XMMatrixLookAtLH(eye, target, XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)));
+
+		shadows.Update(view, XM_PI / 3, 16.0f / 9.0f, 0.1f, lightDirection, casters);
+
+		double milliseconds = shadows.GetStats().seconds * 1000.0;
+		totalSeconds += shadows.GetStats().seconds;
+		totalDraws += (double)shadows.GetStats().drawCount;
+		result.minMilliseconds = min(result.minMilliseconds, milliseconds);
+		result.maxMilliseconds = max(result.maxMilliseconds, milliseconds);
+	}
+
+	result.averageMilliseconds = totalSeconds * 1000.0 / frames;
+	result.averageDrawCount = totalDraws / frames;
+	return result;
+}
@@ -0,0 +1,112 @@
+//--------------------------------------------------------------------------------------
+// File: ShadowCascades.h
+//
+// Cascaded shadow maps for the directional light, the CPU side.  The camera range up to
+// maxDistance is split between uniform and logarithmic spacing, and every slice gets an
+// orthographic light projection around the bounding sphere of its frustum.  The sphere
+// doesn't change with the camera's rotation and its center is snapped to whole shadow
+// map texels in light space, so the texels stay fixed on the world as the camera moves
+// and the shadow edges don't shimmer.  The casters, as world space spheres, are culled
+// against each cascade's light volume, open towards the light, into a draw list per
+// cascade; the cascades are fitted and culled side by side.
+//
+// Depth bias policy: the shadow pass applies the rasterizer's slope scaled bias, and the
+// lighting pass moves the receiver along its normal by normalOffset shadow map texels
+// and compares against depth less a constant depthBias texels' worth of depth.  Both
+// scale with the texel size of the cascade, so the coarse far cascades get more.
+//--------------------------------------------------------------------------------------
+#ifndef SHADOW_CASCADES_H
+#define SHADOW_CASCADES_H
+
+#include <vector>
+#include <DirectXMath.h>
+
+#define SHADOW_MAX_CASCADES         4       // SHADOW_MAX_CASCADES in DirectionalLight.hlsl
+#define SHADOW_MIN_RESOLUTION       256
+#define SHADOW_MAX_RESOLUTION       4096
+
+struct ShadowSettings
+{
+	UINT cascadeCount;                  // 1 to SHADOW_MAX_CASCADES
+	UINT resolution;                    // Texels along each side of every cascade
+	float maxDistance;                  // View space z where the last cascade ends
+	float splitLambda;                  // 0 splits the range uniformly, 1 logarithmically
+	float depthBias;                    // Shadow map texels
+	float slopeScaledDepthBias;         // Of the shadow pass rasterizer state
+	float normalOffset;                 // Shadow map texels
+
+	static ShadowSettings Default();
+};
+
+struct ShadowCaster
+{
+	DirectX::XMFLOAT3 center;           // World space bounding sphere
+	float radius;
+};
+
+struct ShadowCascade
+{
+	float splitNear;                    // View space z range of the camera it covers
+	float splitFar;
+	DirectX::XMFLOAT4X4 viewProjection; // World to light clip space, row-vector
+	DirectX::XMFLOAT3 center;           // Snapped bounding sphere of the slice, world space
+	float radius;
+	float texelSize;                    // World units
+	float depthBias;                    // Light clip space depth
+	float normalOffset;                 // World units
+};
+
+struct ShadowStats
+{
+	UINT cascadeCount;
+	UINT casterCount;
+	UINT drawCount;                     // Casters over all the draw lists
+	double seconds;                     // Fitting and culling
+};
+
+class ShadowCascades
+{
+public:
+	ShadowCascades();
+
+	// Clamps the settings to the supported range
+	void SetSettings(const ShadowSettings& settings);
+	const ShadowSettings& GetSettings() const { return settings; }
+
+	// view is row-vector, world to view.  lightDirection points towards the light, as
+	// CDXUTDirectionWidget::GetLightDirection.
+	void Update(const DirectX::XMFLOAT4X4& view, float fovY, float aspect, float zNear,
+		const DirectX::XMFLOAT3& lightDirection, const std::vector<ShadowCaster>& casters);
+
+	UINT GetCascadeCount() const { return settings.cascadeCount; }
+	const ShadowCascade& GetCascade(UINT cascade) const { return cascades[cascade]; }
+	// Indices into the casters given to Update
+	const std::vector<UINT>& GetDrawList(UINT cascade) const { return drawLists[cascade]; }
+	const ShadowStats& GetStats() const { return stats; }
+
+private:
+	void FitCascade(UINT cascade, const DirectX::XMFLOAT4X4& invView, float tanX, float tanY,
+		const DirectX::XMFLOAT4X4& lightView, const std::vector<ShadowCaster>& casters);
+
+	ShadowSettings settings;
+	ShadowCascade cascades[SHADOW_MAX_CASCADES];
+	std::vector<UINT> drawLists[SHADOW_MAX_CASCADES];
+	std::vector<DirectX::XMFLOAT3> lightSpaceCenters;   // Of the casters
+	ShadowStats stats;
+};
+
+struct ShadowBenchmarkResult
+{
+	UINT frames;
+	UINT cascadeCount;
+	UINT casterCount;
+	double averageDrawCount;            // Per frame, over all the cascades
+	double averageMilliseconds;
+	double minMilliseconds;
+	double maxMilliseconds;
+};
+
+// Updates the cascades frames times for a camera turning above a field of casterCount casters
+ShadowBenchmarkResult BenchmarkShadowCascades(const ShadowSettings& settings, UINT casterCount, UINT frames);
+
+#endif
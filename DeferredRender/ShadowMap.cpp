@@ -0,0 +1,72 @@
+#include "DXUT.h"
+#include "ShadowMap.h"
+
+//---------------------------------------------------------------------------------
+ShadowMap::ShadowMap() : resolution(0), sliceCount(0), slopeScaledDepthBias(0.0f)
+{
+}
+
+HRESULT ShadowMap::Create(ID3D11Device* device, const ShadowSettings& settings)
+{
+	HRESULT hr;
+
+	if (!texture || resolution != settings.resolution || sliceCount != settings.cascadeCount)
+	{
+		resolution = settings.resolution;
+		sliceCount = settings.cascadeCount;
+		for (UINT i = 0; i < SHADOW_MAX_CASCADES; ++i)
+			dsv[i].Reset();
+
+		CD3D11_TEXTURE2D_DESC textureDesc(DXGI_FORMAT_R32_TYPELESS, resolution, resolution, sliceCount, 1,
+			D3D11_BIND_DEPTH_STENCIL | D3D11_BIND_SHADER_RESOURCE);
+		V_RETURN(device->CreateTexture2D(&textureDesc, nullptr, texture.ReleaseAndGetAddressOf()));
+		for (UINT i = 0; i < sliceCount; ++i)
+		{
+			CD3D11_DEPTH_STENCIL_VIEW_DESC dsvDesc(D3D11_DSV_DIMENSION_TEXTURE2DARRAY, DXGI_FORMAT_D32_FLOAT, 0, i, 1);
+			V_RETURN(device->CreateDepthStencilView(texture.Get(), &dsvDesc, dsv[i].ReleaseAndGetAddressOf()));
+		}
+		CD3D11_SHADER_RESOURCE_VIEW_DESC srvDesc(D3D11_SRV_DIMENSION_TEXTURE2DARRAY, DXGI_FORMAT_R32_FLOAT, 0, 1, 0, sliceCount);
+		V_RETURN(device->CreateShaderResourceView(texture.Get(), &srvDesc, srv.ReleaseAndGetAddressOf()));
+	}
+
+	if (!comparisonSampler)
+	{
+		// Outside the map is lit
+		CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+		samplerDesc.Filter = D3D11_FILTER_COMPARISON_MIN_MAG_LINEAR_MIP_POINT;
+		samplerDesc.AddressU = samplerDesc.AddressV = samplerDesc.AddressW = D3D11_TEXTURE_ADDRESS_BORDER;
+		samplerDesc.BorderColor[0] = samplerDesc.BorderColor[1] = samplerDesc.BorderColor[2] = samplerDesc.BorderColor[3] = 1.0f;
+		samplerDesc.ComparisonFunc = D3D11_COMPARISON_LESS_EQUAL;
+		V_RETURN(device->CreateSamplerState(&samplerDesc, comparisonSampler.ReleaseAndGetAddressOf()));
+	}
+
+	if (!rasterizerState || slopeScaledDepthBias != settings.slopeScaledDepthBias)
+	{
+		slopeScaledDepthBias = settings.slopeScaledDepthBias;
+		CD3D11_RASTERIZER_DESC rasterizerDesc(D3D11_DEFAULT);
+		rasterizerDesc.CullMode = D3D11_CULL_NONE;
+		rasterizerDesc.DepthClipEnable = FALSE;
+		rasterizerDesc.SlopeScaledDepthBias = slopeScaledDepthBias;
+		rasterizerDesc.DepthBiasClamp = 0.0f;
+		V_RETURN(device->CreateRasterizerState(&rasterizerDesc, rasterizerState.ReleaseAndGetAddressOf()));
+	}
+
+	return S_OK;
+}
+
+void ShadowMap::Destroy()
+{
+	for (UINT i = 0; i < SHADOW_MAX_CASCADES; ++i)
+		dsv[i].Reset();
+	srv.Reset();
+	texture.Reset();
+	comparisonSampler.Reset();
+	rasterizerState.Reset();
+	resolution = sliceCount = 0;
+}
+
+D3D11_VIEWPORT ShadowMap::GetViewport() const
+{
+	D3D11_VIEWPORT viewport = { 0.0f, 0.0f, (float)resolution, (float)resolution, 0.0f, 1.0f };
+	return viewport;
+}
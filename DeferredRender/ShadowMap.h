@@ -0,0 +1,46 @@
+//--------------------------------------------------------------------------------------
+// File: ShadowMap.h
+//
+// The device side of the cascaded shadow maps: a D32 texture array with a slice per
+// cascade, a depth view per slice for the shadow pass and an array view for the
+// lighting pass, with the comparison sampler and the biased rasterizer state that go
+// with it.  ShadowCascades decides what goes in the slices.
+//--------------------------------------------------------------------------------------
+#ifndef SHADOW_MAP_H
+#define SHADOW_MAP_H
+
+#include <wrl.h>
+#include "ShadowCascades.h"
+
+class ShadowMap
+{
+public:
+	ShadowMap();
+
+	// Recreates the texture if the resolution or the slice count changes, and the states
+	// if the slope scaled bias does
+	HRESULT Create(ID3D11Device* device, const ShadowSettings& settings);
+	void Destroy();
+
+	UINT GetResolution() const { return resolution; }
+	UINT GetSliceCount() const { return sliceCount; }
+	ID3D11DepthStencilView* GetDsv(UINT slice) const { return dsv[slice].Get(); }
+	ID3D11ShaderResourceView* GetSrv() const { return srv.Get(); }
+	ID3D11SamplerState* GetComparisonSampler() const { return comparisonSampler.Get(); }
+	// Slope scaled bias and no depth clip, casters behind the light's near plane are
+	// flattened onto it instead of lost
+	ID3D11RasterizerState* GetRasterizerState() const { return rasterizerState.Get(); }
+	D3D11_VIEWPORT GetViewport() const;
+
+private:
+	UINT resolution;
+	UINT sliceCount;
+	float slopeScaledDepthBias;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	Microsoft::WRL::ComPtr<ID3D11DepthStencilView> dsv[SHADOW_MAX_CASCADES];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> comparisonSampler;
+	Microsoft::WRL::ComPtr<ID3D11RasterizerState> rasterizerState;
+};
+
+#endif
@@ -0,0 +1,3 @@
+#include "shader\\inc\\shader_include.hlsl"
+
+#include "shader\\src\\vs\\ShadowMap.hlsl"
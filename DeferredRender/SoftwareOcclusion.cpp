@@ -0,0 +1,473 @@
+#include "DXUT.h"
+#include "SoftwareOcclusion.h"
+#include <ppl.h>
+#include <xmmintrin.h>
+
+using namespace DirectX;
+
+namespace
+{
+	// Rows of a * b, both row-vector
+	void MultiplyRows(const XMFLOAT4X4& a, const XMFLOAT4X4& b, __m128* rows)
+	{
+		__m128 b0 = _mm_loadu_ps(b.m[0]);
+		__m128 b1 = _mm_loadu_ps(b.m[1]);
+		__m128 b2 = _mm_loadu_ps(b.m[2]);
+		__m128 b3 = _mm_loadu_ps(b.m[3]);
+		for (int r = 0; r < 4; ++r)
+		{
+			rows[r] = _mm_add_ps(
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m[r][0]), b0), _mm_mul_ps(_mm_set1_ps(a.m[r][1]), b1)),
+				_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a.m[r][2]), b2), _mm_mul_ps(_mm_set1_ps(a.m[r][3]), b3)));
+		}
+	}
+
+	inline __m128 TransformPoint(const __m128* rows, const XMFLOAT3& p)
+	{
+		return _mm_add_ps(
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.x), rows[0]), _mm_mul_ps(_mm_set1_ps(p.y), rows[1])),
+			_mm_add_ps(_mm_mul_ps(_mm_set1_ps(p.z), rows[2]), rows[3]));
+	}
+
+	// Far outside the screen a float no longer converts to int
+	inline float ClampToScreen(float v, UINT size)
+	{
+		return min(max(v, -1.0f), (float)size + 1.0f);
+	}
+
+	inline double Seconds(const LARGE_INTEGER& start, const LARGE_INTEGER& end)
+	{
+		LARGE_INTEGER frequency;
+		QueryPerformanceFrequency(&frequency);
+		return (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+	}
+}
+
+//---------------------------------------------------------------------------------
+void CreateOcclusionBox(const XMFLOAT3& size, OcclusionMesh& mesh)
+{
+	static const uint16_t faces[36] =
+	{
+		0, 2, 1, 1, 2, 3,       // -z
+		4, 5, 6, 5, 7, 6,       // +z
+		0, 1, 4, 1, 5, 4,       // -y
+		2, 6, 3, 3, 6, 7,       // +y
+		0, 4, 2, 2, 4, 6,       // -x
+		1, 3, 5, 3, 7, 5,       // +x
+	};
+
+	mesh.positions.resize(8);
+	for (int i = 0; i < 8; ++i)
+	{
+		mesh.positions[i] = XMFLOAT3((i & 1) ? 0.5f * size.x : -0.5f * size.x,
+			(i & 2) ? 0.5f * size.y : -0.5f * size.y, (i & 4) ? 0.5f * size.z : -0.5f * size.z);
+	}
+	mesh.indices.assign(faces, faces + 36);
+}
+
+//---------------------------------------------------------------------------------
+SoftwareOcclusion::SoftwareOcclusion()
+	: width(0)
+	, height(0)
+	, zNear(0.0f)
+{
+	ZeroMemory(&stats, sizeof(stats));
+	Init(OCCLUSION_WIDTH, OCCLUSION_HEIGHT);
+}
+
+void SoftwareOcclusion::Init(UINT w, UINT h)
+{
+	width = (max(w, 4u) + 3) & ~3u;
+	height = (max(h, 1u) + OCCLUSION_BAND_ROWS - 1) / OCCLUSION_BAND_ROWS * OCCLUSION_BAND_ROWS;
+
+	levels.clear();
+	for (UINT levelWidth = width, levelHeight = height; ; levelWidth = (levelWidth + 1) / 2, levelHeight = (levelHeight + 1) / 2)
+	{
+		Level level;
+		level.width = levelWidth;
+		level.height = levelHeight;
+		level.minDepth.assign((size_t)levelWidth * levelHeight, 0.0f);
+		if (!levels.empty())
+			level.maxDepth.assign((size_t)levelWidth * levelHeight, 0.0f);
+		levels.push_back(level);
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+	}
+}
+
+void SoftwareOcclusion::BeginFrame(const XMFLOAT4X4& vp, float nearZ)
+{
+	viewProjection = vp;
+	zNear = nearZ;
+	occluders.clear();
+	ZeroMemory(&stats, sizeof(stats));
+}
+
+void SoftwareOcclusion::AddOccluder(const OcclusionMesh* mesh, const XMFLOAT4X4& world)
+{
+	Occluder occluder;
+	occluder.mesh = mesh;
+	occluder.world = world;
+	occluders.push_back(occluder);
+	stats.occluderTriangles += mesh->indices.size() / 3;
+}
+
+//---------------------------------------------------------------------------------
+// Clips every triangle at w = zNear, giving one or two triangles where it crosses the
+// near plane, and rejects the ones entirely to one side of the screen
+//---------------------------------------------------------------------------------
+void SoftwareOcclusion::SetupOccluder(const Occluder& occluder, std::vector<ScreenTriangle>& result) const
+{
+	__m128 rows[4];
+	MultiplyRows(occluder.world, viewProjection, rows);
+
+	const OcclusionMesh& mesh = *occluder.mesh;
+	std::vector<ClipVertex> vertices(mesh.positions.size());
+	for (size_t i = 0; i < vertices.size(); ++i)
+		_mm_storeu_ps(&vertices[i].x, TransformPoint(rows, mesh.positions[i]));
+
+	result.clear();
+	for (size_t i = 0; i + 2 < mesh.indices.size(); i += 3)
+	{
+		ClipVertex v[3] = { vertices[mesh.indices[i]], vertices[mesh.indices[i + 1]], vertices[mesh.indices[i + 2]] };
+		if ((v[0].x > v[0].w && v[1].x > v[1].w && v[2].x > v[2].w) ||
+			(v[0].x < -v[0].w && v[1].x < -v[1].w && v[2].x < -v[2].w) ||
+			(v[0].y > v[0].w && v[1].y > v[1].w && v[2].y > v[2].w) ||
+			(v[0].y < -v[0].w && v[1].y < -v[1].w && v[2].y < -v[2].w))
+			continue;
+
+		if (v[0].w >= zNear && v[1].w >= zNear && v[2].w >= zNear)
+		{
+			SetupTriangle(v, result);
+			continue;
+		}
+
+		ClipVertex clipped[4];
+		int count = 0;
+		for (int j = 0; j < 3; ++j)
+		{
+			const ClipVertex& a = v[j];
+			const ClipVertex& b = v[(j + 1) % 3];
+			if (a.w >= zNear)
+				clipped[count++] = a;
+			if ((a.w >= zNear) != (b.w >= zNear))
+			{
+				float t = (zNear - a.w) / (b.w - a.w);
+				ClipVertex& c = clipped[count++];
+				c.x = a.x + t * (b.x - a.x);
+				c.y = a.y + t * (b.y - a.y);
+				c.z = a.z + t * (b.z - a.z);
+				c.w = zNear;
+			}
+		}
+		for (int j = 1; j + 1 < count; ++j)
+		{
+			ClipVertex fan[3] = { clipped[0], clipped[j], clipped[j + 1] };
+			SetupTriangle(fan, result);
+		}
+	}
+}
+
+void SoftwareOcclusion::SetupTriangle(const ClipVertex* v, std::vector<ScreenTriangle>& result) const
+{
+	float x[3], y[3], z[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		z[i] = 1.0f / v[i].w;
+		x[i] = (v[i].x * z[i] * 0.5f + 0.5f) * width;
+		y[i] = (0.5f - v[i].y * z[i] * 0.5f) * height;
+	}
+
+	// The pixels whose centers are inside the bounds
+	float minX = min(min(x[0], x[1]), x[2]), maxX = max(max(x[0], x[1]), x[2]);
+	float minY = min(min(y[0], y[1]), y[2]), maxY = max(max(y[0], y[1]), y[2]);
+	ScreenTriangle t;
+	t.minX = max((int)ceilf(ClampToScreen(minX, width) - 0.5f), 0);
+	t.maxX = min((int)floorf(ClampToScreen(maxX, width) - 0.5f), (int)width - 1);
+	t.minY = max((int)ceilf(ClampToScreen(minY, height) - 0.5f), 0);
+	t.maxY = min((int)floorf(ClampToScreen(maxY, height) - 0.5f), (int)height - 1);
+	if (t.minX > t.maxX || t.minY > t.maxY)
+		return;
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (x[2] - x[0]) * (y[1] - y[0]);
+	if (fabsf(area) < 1e-6f)
+		return;
+
+	// Either winding, the edges face inwards
+	float sign = area > 0.0f ? 1.0f : -1.0f;
+	for (int i = 0; i < 3; ++i)
+	{
+		int j = (i + 1) % 3;
+		t.edgeX[i] = sign * (y[i] - y[j]);
+		t.edgeY[i] = sign * (x[j] - x[i]);
+		t.edgeC[i] = sign * (x[i] * y[j] - x[j] * y[i]);
+	}
+
+	// 1/w is linear in screen space
+	t.depthX = ((z[1] - z[0]) * (y[2] - y[0]) - (z[2] - z[0]) * (y[1] - y[0])) / area;
+	t.depthY = ((z[2] - z[0]) * (x[1] - x[0]) - (z[1] - z[0]) * (x[2] - x[0])) / area;
+	t.depthC = z[0] - t.depthX * x[0] - t.depthY * y[0];
+	t.maxDepth = max(max(z[0], z[1]), z[2]);
+	result.push_back(t);
+}
+
+//---------------------------------------------------------------------------------
+// Four pixels of a row at a time: the edge functions and the depth plane are evaluated
+// at their centers, and the nearest depth is kept where all three edges pass
+//---------------------------------------------------------------------------------
+void SoftwareOcclusion::RasterizeBand(UINT band)
+{
+	int firstRow = (int)(band * OCCLUSION_BAND_ROWS);
+	int lastRow = firstRow + OCCLUSION_BAND_ROWS - 1;
+	float* depths = levels[0].minDepth.data();
+	memset(depths + (size_t)firstRow * width, 0, sizeof(float) * width * OCCLUSION_BAND_ROWS);
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+	const __m128 step = _mm_set1_ps(4.0f);
+	for (size_t o = 0; o < triangles.size(); ++o)
+	{
+		for (size_t i = 0; i < triangles[o].size(); ++i)
+		{
+			const ScreenTriangle& t = triangles[o][i];
+			if (t.maxY < firstRow || t.minY > lastRow)
+				continue;
+
+			__m128 edgeX0 = _mm_set1_ps(t.edgeX[0]), edgeX1 = _mm_set1_ps(t.edgeX[1]), edgeX2 = _mm_set1_ps(t.edgeX[2]);
+			__m128 depthX = _mm_set1_ps(t.depthX);
+			__m128 maxDepth = _mm_set1_ps(t.maxDepth);
+			int startX = t.minX & ~3;
+			int endY = min(t.maxY, lastRow);
+			for (int y = max(t.minY, firstRow); y <= endY; ++y)
+			{
+				float py = y + 0.5f;
+				__m128 row0 = _mm_set1_ps(t.edgeY[0] * py + t.edgeC[0]);
+				__m128 row1 = _mm_set1_ps(t.edgeY[1] * py + t.edgeC[1]);
+				__m128 row2 = _mm_set1_ps(t.edgeY[2] * py + t.edgeC[2]);
+				__m128 rowDepth = _mm_set1_ps(t.depthY * py + t.depthC);
+				__m128 px = _mm_add_ps(_mm_set1_ps((float)startX), offsets);
+				float* pixels = depths + (size_t)y * width;
+				for (int x = startX; x <= t.maxX; x += 4, px = _mm_add_ps(px, step))
+				{
+					__m128 inside = _mm_and_ps(
+						_mm_and_ps(_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX0, px), row0), zero),
+							_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX1, px), row1), zero)),
+						_mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeX2, px), row2), zero));
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+
+					__m128 depth = _mm_min_ps(_mm_add_ps(_mm_mul_ps(depthX, px), rowDepth), maxDepth);
+					__m128 old = _mm_loadu_ps(pixels + x);
+					_mm_storeu_ps(pixels + x, _mm_or_ps(_mm_and_ps(inside, _mm_max_ps(old, depth)), _mm_andnot_ps(inside, old)));
+				}
+			}
+		}
+	}
+
+	for (UINT level = 1; level <= OCCLUSION_BAND_LEVELS && level < levels.size(); ++level)
+		ReduceLevel(level, (UINT)firstRow >> level, ((UINT)lastRow >> level) + 1);
+}
+
+void SoftwareOcclusion::ReduceLevel(UINT level, UINT firstRow, UINT lastRow)
+{
+	const Level& source = levels[level - 1];
+	Level& target = levels[level];
+	const float* sourceMin = source.minDepth.data();
+	const float* sourceMax = level == 1 ? sourceMin : source.maxDepth.data();
+	lastRow = min(lastRow, target.height);
+	for (UINT y = firstRow; y < lastRow; ++y)
+	{
+		size_t row0 = (size_t)(2 * y) * source.width;
+		size_t row1 = (size_t)min(2 * y + 1, source.height - 1) * source.width;
+		for (UINT x = 0; x < target.width; ++x)
+		{
+			UINT x0 = 2 * x, x1 = min(2 * x + 1, source.width - 1);
+			size_t t = (size_t)y * target.width + x;
+			target.minDepth[t] = min(min(sourceMin[row0 + x0], sourceMin[row0 + x1]), min(sourceMin[row1 + x0], sourceMin[row1 + x1]));
+			target.maxDepth[t] = max(max(sourceMax[row0 + x0], sourceMax[row0 + x1]), max(sourceMax[row1 + x0], sourceMax[row1 + x1]));
+		}
+	}
+}
+
+void SoftwareOcclusion::Render()
+{
+	LARGE_INTEGER start, end;
+	QueryPerformanceCounter(&start);
+
+	triangles.resize(occluders.size());
+	concurrency::parallel_for((size_t)0, occluders.size(), [&](size_t o)
+	{
+		SetupOccluder(occluders[o], triangles[o]);
+	});
+	for (size_t o = 0; o < occluders.size(); ++o)
+		stats.rasterizedTriangles += triangles[o].size();
+
+	concurrency::parallel_for(0u, height / OCCLUSION_BAND_ROWS, [&](UINT band)
+	{
+		RasterizeBand(band);
+	});
+	for (UINT level = OCCLUSION_BAND_LEVELS + 1; level < levels.size(); ++level)
+		ReduceLevel(level, 0, levels[level].height);
+
+	QueryPerformanceCounter(&end);
+	stats.rasterSeconds += Seconds(start, end);
+}
+
+//---------------------------------------------------------------------------------
+// A texel whose farthest occluder is nearer than the box hides it, one whose nearest
+// occluder is farther doesn't; in between the children the box covers decide
+//---------------------------------------------------------------------------------
+bool SoftwareOcclusion::IsTexelOccluded(UINT level, UINT x, UINT y, float depth, int x0, int y0, int x1, int y1) const
+{
+	const Level& l = levels[level];
+	size_t t = (size_t)y * l.width + x;
+	if (depth < l.minDepth[t])
+		return true;
+	if (level == 0 || depth >= l.maxDepth[t])
+		return false;
+
+	const Level& children = levels[level - 1];
+	UINT shift = level - 1;
+	UINT firstX = max(2 * x, (UINT)x0 >> shift), lastX = min(min(2 * x + 1, children.width - 1), (UINT)x1 >> shift);
+	UINT firstY = max(2 * y, (UINT)y0 >> shift), lastY = min(min(2 * y + 1, children.height - 1), (UINT)y1 >> shift);
+	for (UINT cy = firstY; cy <= lastY; ++cy)
+	{
+		for (UINT cx = firstX; cx <= lastX; ++cx)
+		{
+			if (!IsTexelOccluded(level - 1, cx, cy, depth, x0, y0, x1, y1))
+				return false;
+		}
+	}
+	return true;
+}
+
+bool SoftwareOcclusion::TestBox(const XMFLOAT3& boxMin, const XMFLOAT3& boxMax, const XMFLOAT4X4& world)
+{
+	stats.occludeeTests++;
+
+	__m128 rows[4];
+	MultiplyRows(world, viewProjection, rows);
+
+	// Screen bounds and nearest depth of the corners; a box crossing the near plane is visible
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX, depth = 0.0f;
+	for (int i = 0; i < 8; ++i)
+	{
+		XMFLOAT3 corner((i & 1) ? boxMax.x : boxMin.x, (i & 2) ? boxMax.y : boxMin.y, (i & 4) ? boxMax.z : boxMin.z);
+		ClipVertex v;
+		_mm_storeu_ps(&v.x, TransformPoint(rows, corner));
+		if (v.w < zNear)
+			return true;
+
+		float z = 1.0f / v.w;
+		float x = (v.x * z * 0.5f + 0.5f) * width;
+		float y = (0.5f - v.y * z * 0.5f) * height;
+		minX = min(minX, x);
+		maxX = max(maxX, x);
+		minY = min(minY, y);
+		maxY = max(maxY, y);
+		depth = max(depth, z);
+	}
+
+	// Every pixel the bounds touch
+	int x0 = max((int)floorf(ClampToScreen(minX, width)), 0), x1 = min((int)floorf(ClampToScreen(maxX, width)), (int)width - 1);
+	int y0 = max((int)floorf(ClampToScreen(minY, height)), 0), y1 = min((int)floorf(ClampToScreen(maxY, height)), (int)height - 1);
+	if (x0 > x1 || y0 > y1)
+	{
+		stats.offscreenCount++;
+		return false;
+	}
+
+	// Start at the finest level where the bounds cover a few texels
+	UINT level = 0;
+	while (level + 1 < levels.size() &&
+		(((UINT)x1 >> level) - ((UINT)x0 >> level) >= OCCLUSION_TEST_TEXELS ||
+		((UINT)y1 >> level) - ((UINT)y0 >> level) >= OCCLUSION_TEST_TEXELS))
+		level++;
+
+	for (UINT y = (UINT)y0 >> level; y <= ((UINT)y1 >> level); ++y)
+	{
+		for (UINT x = (UINT)x0 >> level; x <= ((UINT)x1 >> level); ++x)
+		{
+			if (!IsTexelOccluded(level, x, y, depth, x0, y0, x1, y1))
+				return true;
+		}
+	}
+	stats.occludedCount++;
+	return false;
+}
+
+//---------------------------------------------------------------------------------
+// The camera looks down +z at a wall of 16 x 8 boxes; 1024 small boxes are scattered
+// behind it and around it, so some pass on the coarse levels and some need the pixels
+//---------------------------------------------------------------------------------
+OcclusionBenchmarkResult BenchmarkOcclusion(UINT frames)
+{
+	OcclusionBenchmarkResult result;
+	ZeroMemory(&result, sizeof(result));
+	result.frames = frames;
+	if (frames == 0)
+		return result;
+
+	OcclusionMesh wallBox;
+	CreateOcclusionBox(XMFLOAT3(1.0f, 1.0f, 1.0f), wallBox);
+	std::vector<XMFLOAT4X4> wall;
+	for (int y = 0; y < 8; ++y)
+	{
+		for (int x = 0; x < 16; ++x)
+		{
+			XMFLOAT4X4 world;
+			XMStoreFloat4x4(&world, XMMatrixTranslation(-8.0f + x * 1.05f, -4.0f + y * 1.05f, 20.0f));
+			wall.push_back(world);
+		}
+	}
+
+	std::vector<XMFLOAT4X4> boxes;
+	uint32_t seed = 12345;
+	for (int i = 0; i < 1024; ++i)
+	{
+		float r[3];
+		for (int j = 0; j < 3; ++j)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			r[j] = (seed >> 8) / 16777216.0f;
+		}
+		XMFLOAT4X4 world;
+		XMStoreFloat4x4(&world, XMMatrixTranslation(-24.0f + 48.0f * r[0], -12.0f + 24.0f * r[1], 25.0f + 75.0f * r[2]));
+		boxes.push_back(world);
+	}
+	XMFLOAT3 boxMin(-0.5f, -0.5f, -0.5f), boxMax(0.5f, 0.5f, 0.5f);
+
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, XMMatrixLookAtLH(XMVectorSet(0.0f, 0.0f, 0.0f, 1.0f), XMVectorSet(0.0f, 0.0f, 1.0f, 1.0f),
+		XMVectorSet(0.0f, 1.0f, 0.0f, 0.0f)) * XMMatrixPerspectiveFovLH(XM_PI / 3, 16.0f / 9.0f, 0.1f, 1000.0f));
+
+	SoftwareOcclusion occlusion;
+	LARGE_INTEGER start, end;
+	double rasterSeconds = 0.0, testSeconds = 0.0;
+	size_t occluded = 0;
+	for (UINT frame = 0; frame < frames; ++frame)
+	{
+		occlusion.BeginFrame(viewProjection, 0.1f);
+		for (size_t i = 0; i < wall.size(); ++i)
+			occlusion.AddOccluder(&wallBox, wall[i]);
+		occlusion.Render();
+
+		QueryPerformanceCounter(&start);
+		for (size_t i = 0; i < boxes.size(); ++i)
+			occlusion.TestBox(boxMin, boxMax, boxes[i]);
+		QueryPerformanceCounter(&end);
+
+		rasterSeconds += occlusion.GetStats().rasterSeconds;
+		testSeconds += Seconds(start, end);
+		occluded += occlusion.GetStats().occludedCount;
+	}
+
+	result.occluderTriangles = wall.size() * (wallBox.indices.size() / 3);
+	result.occludeeTests = boxes.size();
+	result.occludedFraction = (float)((double)occluded / ((double)boxes.size() * frames));
+	result.rasterMilliseconds = rasterSeconds * 1000.0 / frames;
+	result.testMilliseconds = testSeconds * 1000.0 / frames;
+	result.trianglesPerMillisecond = result.occluderTriangles / max(result.rasterMilliseconds, 1e-9);
+	result.testsPerMillisecond = result.occludeeTests / max(result.testMilliseconds, 1e-9);
+	return result;
+}
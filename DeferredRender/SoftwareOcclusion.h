@@ -0,0 +1,137 @@
+//--------------------------------------------------------------------------------------
+// File: SoftwareOcclusion.h
+//
+// Occlusion culling against a small depth buffer rasterized on the CPU.  A few large
+// meshes are designated occluders; each frame their triangles are transformed, clipped
+// at the near plane and rasterized four pixels at a time with SSE into an
+// OCCLUSION_WIDTH x OCCLUSION_HEIGHT buffer of 1/w, split into bands of rows that the
+// worker threads fill side by side.  Each band also reduces its rows into the first
+// levels of a min/max hierarchy (Hi-Z), the rest is reduced after.  An object's bounding
+// box is then tested against the hierarchy before it is drawn: it is hidden if it lies
+// behind the farthest occluder everywhere it covers.  Nothing here touches the device.
+//--------------------------------------------------------------------------------------
+#ifndef SOFTWARE_OCCLUSION_H
+#define SOFTWARE_OCCLUSION_H
+
+#include <vector>
+#include <stdint.h>
+#include <DirectXMath.h>
+
+#define OCCLUSION_WIDTH         320
+#define OCCLUSION_HEIGHT        192
+#define OCCLUSION_BAND_LEVELS   4                               // Hierarchy levels reduced by the band tasks
+#define OCCLUSION_BAND_ROWS     (1 << OCCLUSION_BAND_LEVELS)    // Rows of the buffer per parallel task
+#define OCCLUSION_TEST_TEXELS   4                               // Widest box, in texels of the level its test starts at
+
+// Object space triangle list of an occluder, closed or not; both windings are rasterized
+struct OcclusionMesh
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<uint16_t> indices;
+};
+
+// The 12 triangles of a box of the given size centered on the origin, as GeometricPrimitive::CreateBox
+void CreateOcclusionBox(const DirectX::XMFLOAT3& size, OcclusionMesh& mesh);
+
+struct OcclusionStats
+{
+	size_t occluderTriangles;           // Submitted
+	size_t rasterizedTriangles;         // After near plane clipping and the screen rejects
+	size_t occludeeTests;
+	size_t occludedCount;
+	size_t offscreenCount;              // Boxes outside the screen, reported hidden too
+	double rasterSeconds;               // Transform, rasterization and hierarchy
+};
+
+class SoftwareOcclusion
+{
+public:
+	SoftwareOcclusion();
+
+	// Rounds the width up to 4 pixels and the height up to OCCLUSION_BAND_ROWS
+	void Init(UINT width, UINT height);
+
+	// viewProjection is row-vector, as g_Camera's; triangles and boxes closer than zNear
+	// are clipped and always visible.  The occluders of the previous frame are dropped.
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection, float zNear);
+	// The mesh is referenced until Render
+	void AddOccluder(const OcclusionMesh* mesh, const DirectX::XMFLOAT4X4& world);
+	// Rasterizes the occluders and builds the hierarchy
+	void Render();
+
+	// False if the object space box is hidden behind the occluders or outside the screen
+	bool TestBox(const DirectX::XMFLOAT3& boxMin, const DirectX::XMFLOAT3& boxMax, const DirectX::XMFLOAT4X4& world);
+
+	UINT GetWidth() const { return width; }
+	UINT GetHeight() const { return height; }
+	UINT GetLevelCount() const { return (UINT)levels.size(); }
+	// 1/w of the nearest occluder per pixel, 0 where there is none
+	const float* GetDepths() const { return levels[0].minDepth.data(); }
+	// Counted since BeginFrame
+	const OcclusionStats& GetStats() const { return stats; }
+
+private:
+	struct ClipVertex
+	{
+		float x, y, z, w;
+	};
+
+	// Edge functions, inside where all are >= 0, and the plane of 1/w in pixels
+	struct ScreenTriangle
+	{
+		float edgeX[3], edgeY[3], edgeC[3];
+		float depthX, depthY, depthC;
+		float maxDepth;
+		int minX, maxX, minY, maxY;
+	};
+
+	struct Occluder
+	{
+		const OcclusionMesh* mesh;
+		DirectX::XMFLOAT4X4 world;
+	};
+
+	struct Level
+	{
+		UINT width;
+		UINT height;
+		std::vector<float> minDepth;    // Farthest occluder of the texel; the depth buffer at level 0
+		std::vector<float> maxDepth;    // Nearest occluder of the texel; empty at level 0
+	};
+
+	void SetupOccluder(const Occluder& occluder, std::vector<ScreenTriangle>& triangles) const;
+	void SetupTriangle(const ClipVertex* v, std::vector<ScreenTriangle>& triangles) const;
+	void RasterizeBand(UINT band);
+	void ReduceLevel(UINT level, UINT firstRow, UINT lastRow);
+	// Whether the box, of nearest depth, is hidden within the texel of level, or the part
+	// of it the box covers, given in level 0 pixels
+	bool IsTexelOccluded(UINT level, UINT x, UINT y, float depth, int x0, int y0, int x1, int y1) const;
+
+	UINT width;
+	UINT height;
+	DirectX::XMFLOAT4X4 viewProjection;
+	float zNear;
+
+	std::vector<Occluder> occluders;
+	std::vector<std::vector<ScreenTriangle> > triangles;    // Of each occluder, set up side by side
+	std::vector<Level> levels;
+
+	OcclusionStats stats;
+};
+
+struct OcclusionBenchmarkResult
+{
+	UINT frames;
+	size_t occluderTriangles;           // Per frame
+	size_t occludeeTests;               // Per frame
+	float occludedFraction;
+	double rasterMilliseconds;          // Mean per frame
+	double testMilliseconds;
+	double trianglesPerMillisecond;
+	double testsPerMillisecond;
+};
+
+// Renders a wall of box occluders and tests a field of boxes behind and around it, frames times
+OcclusionBenchmarkResult BenchmarkOcclusion(UINT frames);
+
+#endif
@@ -0,0 +1,553 @@
+#include "DXUT.h"
+#include "Effects.h"
+#include "Grid_Creation11.h"
+#include "Terrain.h"
+#include <random>
+
+using namespace DirectX;
+
+namespace
+{
+	struct TerrainConstants
+	{
+		XMFLOAT4 origin;                // Sample (0, 0) at height 0, sample spacing
+		XMFLOAT4 heightMap;             // Size, 1 / size
+		XMFLOAT4 eye;
+	};
+
+	// Six planes of a row vector view-projection matrix, inside is positive
+	void ExtractFrustumPlanes(const XMFLOAT4X4& m, XMFLOAT4* planes)
+	{
+		planes[0] = XMFLOAT4(m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41);
+		planes[1] = XMFLOAT4(m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41);
+		planes[2] = XMFLOAT4(m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42);
+		planes[3] = XMFLOAT4(m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42);
+		planes[4] = XMFLOAT4(m._13, m._23, m._33, m._43);
+		planes[5] = XMFLOAT4(m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43);
+	}
+
+	// Outside if the corner furthest along a plane's normal is behind it
+	bool BoxOutsideFrustum(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const XMFLOAT4* planes)
+	{
+		for (int i = 0; i < 6; ++i)
+		{
+			const XMFLOAT4& p = planes[i];
+			float x = p.x > 0.0f ? boundsMax.x : boundsMin.x;
+			float y = p.y > 0.0f ? boundsMax.y : boundsMin.y;
+			float z = p.z > 0.0f ? boundsMax.z : boundsMin.z;
+			if (p.x * x + p.y * y + p.z * z + p.w < 0.0f)
+				return true;
+		}
+		return false;
+	}
+
+	bool BoxInRange(const XMFLOAT3& boundsMin, const XMFLOAT3& boundsMax, const XMFLOAT3& eye, float range)
+	{
+		float dx = max(max(boundsMin.x - eye.x, eye.x - boundsMax.x), 0.0f);
+		float dy = max(max(boundsMin.y - eye.y, eye.y - boundsMax.y), 0.0f);
+		float dz = max(max(boundsMin.z - eye.z, eye.z - boundsMax.z), 0.0f);
+		return dx * dx + dy * dy + dz * dz <= range * range;
+	}
+
+	UINT TileVertexCount(UINT resolution)
+	{
+		return (resolution + 1) * (resolution + 1);
+	}
+}
+
+//---------------------------------------------------------------------------------
+TerrainSettings TerrainSettings::Default()
+{
+	TerrainSettings settings;
+	settings.tileResolution = 32;
+	settings.sampleSpacing = 4.0f;
+	settings.origin = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	settings.pixelErrorBudget = 2.0f;
+	settings.morphStartRatio = 0.66f;
+	return settings;
+}
+
+struct Terrain::SelectContext
+{
+	XMFLOAT3 eye;
+	XMFLOAT4 planes[6];
+	float ranges[TERRAIN_MAX_LEVELS];
+	XMFLOAT4 morph[TERRAIN_MAX_LEVELS];
+	TerrainSelectionStats stats;
+};
+
+Terrain::Terrain() : size(0), levelCount(0), fullTileCount(0), instanceCapacity(0)
+{
+	settings = TerrainSettings::Default();
+	selectedEye = XMFLOAT3(0.0f, 0.0f, 0.0f);
+	for (UINT i = 0; i < TERRAIN_MAX_LEVELS; ++i)
+		levelError[i] = 0.0f;
+	tiles[0].indexCount = tiles[1].indexCount = 0;
+}
+
+//---------------------------------------------------------------------------------
+// The nodes are created breadth first, so the four children of a node are
+// consecutive and come after it: the bounds are then filled in one backwards pass.
+// The error of a level is the largest distance of a height map sample from the
+// bilinear surface through the samples of the level's grid.
+//---------------------------------------------------------------------------------
+HRESULT Terrain::Build(const float* heights, UINT size, const TerrainSettings& settings)
+{
+	UINT tile = settings.tileResolution;
+	if (tile < 2 || tile % 2 != 0 || TileVertexCount(tile) > 65536 || size <= tile || (size - 1) % tile != 0)
+		return E_INVALIDARG;
+
+	UINT leaves = (size - 1) / tile;
+	if ((leaves & (leaves - 1)) != 0)
+		return E_INVALIDARG;
+
+	UINT levels = 1;
+	while ((1u << (levels - 1)) < leaves)
+		levels++;
+	if (levels > TERRAIN_MAX_LEVELS)
+		return E_INVALIDARG;
+
+	this->settings = settings;
+	this->size = size;
+	this->levelCount = levels;
+	this->heights.assign(heights, heights + (size_t)size * size);
+
+	nodes.clear();
+	Node root = {};
+	root.level = levels - 1;
+	nodes.push_back(root);
+	for (size_t i = 0; i < nodes.size(); ++i)
+	{
+		Node node = nodes[i];
+		if (node.level == 0)
+			continue;
+
+		nodes[i].firstChild = (UINT)nodes.size();
+		UINT half = (tile << node.level) / 2;
+		for (UINT quadrant = 0; quadrant < 4; ++quadrant)
+		{
+			Node child = {};
+			child.x = node.x + (quadrant & 1) * half;
+			child.z = node.z + (quadrant >> 1) * half;
+			child.level = node.level - 1;
+			nodes.push_back(child);
+		}
+	}
+
+	for (size_t i = nodes.size(); i-- > 0;)
+	{
+		Node& node = nodes[i];
+		float minHeight = FLT_MAX, maxHeight = -FLT_MAX;
+		if (node.firstChild == 0)
+		{
+			for (UINT z = node.z; z <= node.z + tile; ++z)
+			{
+				for (UINT x = node.x; x <= node.x + tile; ++x)
+				{
+					minHeight = min(minHeight, heights[(size_t)z * size + x]);
+					maxHeight = max(maxHeight, heights[(size_t)z * size + x]);
+				}
+			}
+		}
+		else
+		{
+			for (UINT quadrant = 0; quadrant < 4; ++quadrant)
+			{
+				minHeight = min(minHeight, nodes[node.firstChild + quadrant].boundsMin.y);
+				maxHeight = max(maxHeight, nodes[node.firstChild + quadrant].boundsMax.y);
+			}
+		}
+
+		float nodeSize = (float)(tile << node.level) * settings.sampleSpacing;
+		node.boundsMin = XMFLOAT3(settings.origin.x + node.x * settings.sampleSpacing, settings.origin.y + minHeight,
+			settings.origin.z + node.z * settings.sampleSpacing);
+		node.boundsMax = XMFLOAT3(node.boundsMin.x + nodeSize, settings.origin.y + maxHeight, node.boundsMin.z + nodeSize);
+	}
+
+	levelError[0] = 0.0f;
+	for (UINT level = 1; level < levels; ++level)
+	{
+		UINT step = 1u << level;
+		float error = 0.0f;
+		for (UINT z = 0; z < size; ++z)
+		{
+			UINT z0 = min(z / step * step, size - 1 - step);
+			float fz = (float)(z - z0) / step;
+			for (UINT x = 0; x < size; ++x)
+			{
+				UINT x0 = min(x / step * step, size - 1 - step);
+				float fx = (float)(x - x0) / step;
+				const float* row0 = &heights[(size_t)z0 * size];
+				const float* row1 = &heights[(size_t)(z0 + step) * size];
+				float h0 = row0[x0] + (row0[x0 + step] - row0[x0]) * fx;
+				float h1 = row1[x0] + (row1[x0 + step] - row1[x0]) * fx;
+				error = max(error, fabsf(heights[(size_t)z * size + x] - (h0 + (h1 - h0) * fz)));
+			}
+		}
+		levelError[level] = max(error, levelError[level - 1]);
+	}
+
+	instances.reserve(nodes.size());
+	quadrants.reserve(nodes.size());
+	return S_OK;
+}
+
+//---------------------------------------------------------------------------------
+// A level is used from the end of the previous level's range to the distance at
+// which the next level's error projects to the budget.  Ranges at least double
+// from level to level so that the children of a node always reach the morph
+// area of their level.
+//---------------------------------------------------------------------------------
+void Terrain::Select(const TerrainView& view, TerrainSelectionStats* stats)
+{
+	LARGE_INTEGER start, end, frequency;
+	QueryPerformanceCounter(&start);
+
+	SelectContext context;
+	ZeroMemory(&context.stats, sizeof(context.stats));
+	context.eye = view.eye;
+	ExtractFrustumPlanes(view.viewProjection, context.planes);
+
+	float pixelsPerUnit = 0.5f * view.screenHeight * view.projectionScale / settings.pixelErrorBudget;
+	float leafSize = settings.tileResolution * settings.sampleSpacing;
+	for (UINT level = 0; level < levelCount; ++level)
+	{
+		float previous = level > 0 ? context.ranges[level - 1] : 0.0f;
+		if (level + 1 == levelCount)
+		{
+			// Nothing to morph to
+			context.ranges[level] = FLT_MAX;
+			context.morph[level] = XMFLOAT4(FLT_MAX, 0.0f, (float)level, 0.0f);
+			continue;
+		}
+
+		float range = max(levelError[level + 1] * pixelsPerUnit, level > 0 ? previous * 2.0f : leafSize * 2.0f);
+		float morphStart = previous + (range - previous) * settings.morphStartRatio;
+		context.ranges[level] = range;
+		context.morph[level] = XMFLOAT4(morphStart, 1.0f / (range - morphStart), (float)level, 0.0f);
+	}
+
+	instances.clear();
+	quadrants.clear();
+	if (!nodes.empty() && !SelectNode(context, 0))
+		AddInstance(context, nodes[0], 4);
+
+	fullTileCount = (UINT)instances.size();
+	instances.insert(instances.end(), quadrants.begin(), quadrants.end());
+	selectedEye = view.eye;
+
+	QueryPerformanceCounter(&end);
+	QueryPerformanceFrequency(&frequency);
+
+	if (stats)
+	{
+		*stats = context.stats;
+		stats->seconds = (double)(end.QuadPart - start.QuadPart) / (double)frequency.QuadPart;
+	}
+}
+
+bool Terrain::SelectNode(SelectContext& context, UINT index)
+{
+	const Node& node = nodes[index];
+	context.stats.visitedNodes++;
+
+	if (!BoxInRange(node.boundsMin, node.boundsMax, context.eye, context.ranges[node.level]))
+		return false;
+
+	if (BoxOutsideFrustum(node.boundsMin, node.boundsMax, context.planes))
+	{
+		context.stats.frustumCulledNodes++;
+		return true;
+	}
+
+	if (node.level == 0 || !BoxInRange(node.boundsMin, node.boundsMax, context.eye, context.ranges[node.level - 1]))
+	{
+		AddInstance(context, node, 4);
+		return true;
+	}
+
+	for (UINT quadrant = 0; quadrant < 4; ++quadrant)
+	{
+		if (SelectNode(context, node.firstChild + quadrant))
+			continue;
+
+		const Node& child = nodes[node.firstChild + quadrant];
+		if (BoxOutsideFrustum(child.boundsMin, child.boundsMax, context.planes))
+			context.stats.frustumCulledNodes++;
+		else
+			AddInstance(context, node, quadrant);
+	}
+	return true;
+}
+
+// Quadrant 4 is the whole node
+void Terrain::AddInstance(SelectContext& context, const Node& node, UINT quadrant)
+{
+	UINT resolution = settings.tileResolution;
+	float nodeSize = node.boundsMax.x - node.boundsMin.x;
+
+	TerrainInstance instance;
+	instance.morph = context.morph[node.level];
+	if (quadrant == 4)
+	{
+		instance.node = XMFLOAT4(node.boundsMin.x, node.boundsMin.z, nodeSize, (float)resolution);
+		instances.push_back(instance);
+		context.stats.selectedNodes++;
+	}
+	else
+	{
+		resolution /= 2;
+		float half = 0.5f * nodeSize;
+		instance.node = XMFLOAT4(node.boundsMin.x + (quadrant & 1) * half, node.boundsMin.z + (quadrant >> 1) * half,
+			half, (float)resolution);
+		quadrants.push_back(instance);
+		context.stats.selectedQuadrants++;
+	}
+
+	context.stats.vertexCount += TileVertexCount(resolution);
+	context.stats.triangleCount += 2 * resolution * resolution;
+}
+
+XMFLOAT3 Terrain::GetCenter() const
+{
+	float half = 0.5f * GetExtent();
+	float height = nodes.empty() ? settings.origin.y : 0.5f * (nodes[0].boundsMin.y + nodes[0].boundsMax.y);
+	return XMFLOAT3(settings.origin.x + half, height, settings.origin.z + half);
+}
+
+// Bilinear height map lookup in world units, clamped to the terrain
+float Terrain::GetHeight(float x, float z) const
+{
+	if (size < 2)
+		return settings.origin.y;
+
+	float sx = min(max((x - settings.origin.x) / settings.sampleSpacing, 0.0f), (float)(size - 1));
+	float sz = min(max((z - settings.origin.z) / settings.sampleSpacing, 0.0f), (float)(size - 1));
+	UINT x0 = min((UINT)sx, size - 2);
+	UINT z0 = min((UINT)sz, size - 2);
+	float fx = sx - x0, fz = sz - z0;
+	const float* row0 = &heights[(size_t)z0 * size];
+	const float* row1 = &heights[(size_t)(z0 + 1) * size];
+	float h0 = row0[x0] + (row0[x0 + 1] - row0[x0]) * fx;
+	float h1 = row1[x0] + (row1[x0 + 1] - row1[x0]) * fx;
+	return settings.origin.y + h0 + (h1 - h0) * fz;
+}
+
+//---------------------------------------------------------------------------------
+// Tiles are unit grids from FillGrid_Indexed_WithTangentSpace, the vertex shader
+// maps x and z of [-0.5, 0.5] onto the node
+//---------------------------------------------------------------------------------
+HRESULT Terrain::CreateDeviceResources(ID3D11Device* device)
+{
+	HRESULT hr;
+
+	for (UINT i = 0; i < 2; ++i)
+	{
+		UINT resolution = settings.tileResolution >> i;
+		FillGrid_Indexed_WithTangentSpace(device, resolution, resolution, 1.0f, 1.0f,
+			tiles[i].vertexBuffer.ReleaseAndGetAddressOf(), tiles[i].indexBuffer.ReleaseAndGetAddressOf());
+		if (!tiles[i].vertexBuffer || !tiles[i].indexBuffer)
+			return E_FAIL;
+		tiles[i].indexCount = 6 * resolution * resolution;
+	}
+
+	instanceCapacity = max((UINT)nodes.size() * 4, 1u);
+	CD3D11_BUFFER_DESC instanceDesc(instanceCapacity * sizeof(TerrainInstance), D3D11_BIND_VERTEX_BUFFER,
+		D3D11_USAGE_DYNAMIC, D3D11_CPU_ACCESS_WRITE);
+	V_RETURN(device->CreateBuffer(&instanceDesc, nullptr, instanceBuffer.ReleaseAndGetAddressOf()));
+	DXUT_SetDebugName(instanceBuffer.Get(), "Terrain instances");
+
+	CD3D11_BUFFER_DESC constantDesc(sizeof(TerrainConstants), D3D11_BIND_CONSTANT_BUFFER);
+	V_RETURN(device->CreateBuffer(&constantDesc, nullptr, constantBuffer.ReleaseAndGetAddressOf()));
+
+	CD3D11_TEXTURE2D_DESC textureDesc(DXGI_FORMAT_R32_FLOAT, size, size, 1, 1, D3D11_BIND_SHADER_RESOURCE, D3D11_USAGE_IMMUTABLE);
+	D3D11_SUBRESOURCE_DATA initData = { heights.data(), size * sizeof(float), 0 };
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> heightMap;
+	V_RETURN(device->CreateTexture2D(&textureDesc, &initData, heightMap.GetAddressOf()));
+	DXUT_SetDebugName(heightMap.Get(), "Terrain height map");
+	V_RETURN(device->CreateShaderResourceView(heightMap.Get(), nullptr, heightMapSRV.ReleaseAndGetAddressOf()));
+
+	CD3D11_SAMPLER_DESC samplerDesc(D3D11_DEFAULT);
+	samplerDesc.AddressU = samplerDesc.AddressV = D3D11_TEXTURE_ADDRESS_CLAMP;
+	V_RETURN(device->CreateSamplerState(&samplerDesc, heightMapSampler.ReleaseAndGetAddressOf()));
+
+	return S_OK;
+}
+
+void Terrain::DestroyDeviceResources()
+{
+	for (UINT i = 0; i < 2; ++i)
+	{
+		tiles[i].vertexBuffer.Reset();
+		tiles[i].indexBuffer.Reset();
+	}
+	instanceBuffer.Reset();
+	constantBuffer.Reset();
+	heightMapSRV.Reset();
+	heightMapSampler.Reset();
+}
+
+HRESULT Terrain::CreateInputLayout(ID3D11Device* device, IEffect* effect, ID3D11InputLayout** inputLayout)
+{
+	const D3D11_INPUT_ELEMENT_DESC elements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NODE", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+		{ "NODE", 1, DXGI_FORMAT_R32G32B32A32_FLOAT, 1, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1 },
+	};
+
+	void const* shaderByteCode;
+	size_t byteCodeLength;
+	effect->GetVertexShaderBytecode(&shaderByteCode, &byteCodeLength);
+	return device->CreateInputLayout(elements, _countof(elements), shaderByteCode, byteCodeLength, inputLayout);
+}
+
+void Terrain::Draw(ID3D11DeviceContext* context, IEffect* effect, ID3D11InputLayout* inputLayout,
+	std::function<void()> setCustomState)
+{
+	if (instances.empty() || !instanceBuffer)
+		return;
+
+	UINT instanceCount = min((UINT)instances.size(), instanceCapacity);
+	D3D11_MAPPED_SUBRESOURCE mapped;
+	if (FAILED(context->Map(instanceBuffer.Get(), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		return;
+	memcpy(mapped.pData, instances.data(), instanceCount * sizeof(TerrainInstance));
+	context->Unmap(instanceBuffer.Get(), 0);
+
+	TerrainConstants constants;
+	constants.origin = XMFLOAT4(settings.origin.x, settings.origin.y, settings.origin.z, settings.sampleSpacing);
+	constants.heightMap = XMFLOAT4((float)size, 1.0f / size, 0.0f, 0.0f);
+	constants.eye = XMFLOAT4(selectedEye.x, selectedEye.y, selectedEye.z, 1.0f);
+	context->UpdateSubresource(constantBuffer.Get(), 0, nullptr, &constants, 0, 0);
+
+	effect->Apply(context);
+	context->IASetInputLayout(inputLayout);
+	context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	if (setCustomState)
+		setCustomState();
+
+	ID3D11Buffer* constantBuffers[] = { constantBuffer.Get() };
+	ID3D11ShaderResourceView* shaderResources[] = { heightMapSRV.Get() };
+	ID3D11SamplerState* samplers[] = { heightMapSampler.Get() };
+	context->VSSetConstantBuffers(TERRAIN_CONSTANTS_SLOT, 1, constantBuffers);
+	context->VSSetShaderResources(TERRAIN_HEIGHT_MAP_SLOT, 1, shaderResources);
+	context->VSSetSamplers(TERRAIN_SAMPLER_SLOT, 1, samplers);
+
+	UINT counts[2] = { min(fullTileCount, instanceCount), instanceCount - min(fullTileCount, instanceCount) };
+	UINT firstInstance[2] = { 0, counts[0] };
+	for (UINT i = 0; i < 2; ++i)
+	{
+		if (counts[i] == 0)
+			continue;
+
+		ID3D11Buffer* vertexBuffers[] = { tiles[i].vertexBuffer.Get(), instanceBuffer.Get() };
+		UINT strides[] = { sizeof(TANGENTSPACEVERTEX), sizeof(TerrainInstance) };
+		UINT offsets[] = { 0, 0 };
+		context->IASetVertexBuffers(0, 2, vertexBuffers, strides, offsets);
+		context->IASetIndexBuffer(tiles[i].indexBuffer.Get(), DXGI_FORMAT_R16_UINT, 0);
+		context->DrawIndexedInstanced(tiles[i].indexCount, counts[i], 0, 0, firstInstance[i]);
+	}
+
+	ID3D11ShaderResourceView* nullResources[] = { nullptr };
+	context->VSSetShaderResources(TERRAIN_HEIGHT_MAP_SLOT, 1, nullResources);
+}
+
+//---------------------------------------------------------------------------------
+// Diamond-square
+//---------------------------------------------------------------------------------
+void GenerateTerrainHeightMap(UINT size, float heightScale, float roughness, UINT seed, std::vector<float>& heights)
+{
+	heights.assign((size_t)size * size, 0.0f);
+	if (size < 2)
+		return;
+
+	std::mt19937 generator(seed);
+	std::uniform_real_distribution<float> random(-1.0f, 1.0f);
+	UINT last = size - 1;
+	heights[0] = random(generator);
+	heights[last] = random(generator);
+	heights[(size_t)last * size] = random(generator);
+	heights[(size_t)last * size + last] = random(generator);
+
+	float amplitude = 1.0f;
+	for (UINT step = last; step > 1; step /= 2, amplitude *= roughness)
+	{
+		UINT half = step / 2;
+		for (UINT z = half; z < size; z += step)
+		{
+			for (UINT x = half; x < size; x += step)
+			{
+				float sum = heights[(size_t)(z - half) * size + x - half] + heights[(size_t)(z - half) * size + x + half] +
+					heights[(size_t)(z + half) * size + x - half] + heights[(size_t)(z + half) * size + x + half];
+				heights[(size_t)z * size + x] = 0.25f * sum + amplitude * random(generator);
+			}
+		}
+		for (UINT z = 0; z < size; z += half)
+		{
+			for (UINT x = (z / half) % 2 == 0 ? half : 0; x < size; x += step)
+			{
+				float sum = 0.0f;
+				UINT count = 0;
+				if (x >= half) { sum += heights[(size_t)z * size + x - half]; count++; }
+				if (x + half < size) { sum += heights[(size_t)z * size + x + half]; count++; }
+				if (z >= half) { sum += heights[(size_t)(z - half) * size + x]; count++; }
+				if (z + half < size) { sum += heights[(size_t)(z + half) * size + x]; count++; }
+				heights[(size_t)z * size + x] = sum / count + amplitude * random(generator);
+			}
+		}
+	}
+
+	float minHeight = *std::min_element(heights.begin(), heights.end());
+	float maxHeight = *std::max_element(heights.begin(), heights.end());
+	float scale = maxHeight > minHeight ? heightScale / (maxHeight - minHeight) : 0.0f;
+	for (size_t i = 0; i < heights.size(); ++i)
+		heights[i] = (heights[i] - minHeight) * scale;
+}
+
+//---------------------------------------------------------------------------------
+// One lap of a circle around the center, looking along the path and a little down
+//---------------------------------------------------------------------------------
+TerrainBenchmarkResult BenchmarkTerrainSelection(Terrain& terrain, const TerrainView& view,
+	const XMFLOAT4X4& projection, UINT frames)
+{
+	TerrainBenchmarkResult result;
+	ZeroMemory(&result, sizeof(result));
+	result.frames = frames;
+	result.fullGridVertices = (size_t)terrain.GetHeightMapSize() * terrain.GetHeightMapSize();
+	result.minMilliseconds = DBL_MAX;
+	if (frames == 0)
+		return result;
+
+	XMFLOAT3 center = terrain.GetCenter();
+	float radius = 0.35f * terrain.GetExtent();
+	float altitude = max(view.eye.y - terrain.GetHeight(view.eye.x, view.eye.z), 2.0f);
+	XMMATRIX proj = XMLoadFloat4x4(&projection);
+
+	TerrainView frameView = view;
+	double totalSeconds = 0.0, totalVertices = 0.0;
+	for (UINT frame = 0; frame < frames; ++frame)
+	{
+		float angle = XM_2PI * frame / frames;
+		float x = center.x + radius * cosf(angle);
+		float z = center.z + radius * sinf(angle);
+		XMVECTOR eye = XMVectorSet(x, terrain.GetHeight(x, z) + altitude, z, 1.0f);
+		XMVECTOR target = eye + XMVectorSet(-sinf(angle), -0.2f, cosf(angle), 0.0f);
+
+		XMStoreFloat3(&frameView.eye, eye);
+		XMStoreFloat4x4(&frameView.viewProjection, XMMatrixLookAtLH(eye, target, g_XMIdentityR1) * proj);
+
+		TerrainSelectionStats stats;
+		terrain.Select(frameView, &stats);
+
+		double milliseconds = stats.seconds * 1000.0;
+		totalSeconds += stats.seconds;
+		totalVertices += (double)stats.vertexCount;
+		result.minMilliseconds = min(result.minMilliseconds, milliseconds);
+		result.maxMilliseconds = max(result.maxMilliseconds, milliseconds);
+	}
+
+	result.averageMilliseconds = totalSeconds * 1000.0 / frames;
+	result.averageVertices = totalVertices / frames;
+	return result;
+}
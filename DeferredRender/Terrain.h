@@ -0,0 +1,154 @@
+//--------------------------------------------------------------------------------------
+// File: Terrain.h
+//
+// Quadtree terrain in the style of CDLOD.  Every node of the tree is drawn with the same
+// grid tile (FillGrid_Indexed_WithTangentSpace, TerrainSettings::tileResolution quads a
+// side) stretched over the node, or with the half resolution tile over one quadrant of
+// it, and displaced by the height map in the vertex shader.  The LOD of a node follows
+// from its distance to the eye: each level is used up to the distance at which the next
+// coarser level's geometric error, measured on the height map, projects to less than
+// the pixel error budget.  Towards the end of its range a node morphs its vertices onto
+// the grid of the coarser level, so the levels meet without cracks or pops.
+//--------------------------------------------------------------------------------------
+#ifndef TERRAIN_H
+#define TERRAIN_H
+
+#include <vector>
+#include <functional>
+#include <stdint.h>
+#include <wrl.h>
+#include <DirectXMath.h>
+
+namespace DirectX { class IEffect; }
+
+#define TERRAIN_MAX_LEVELS 16
+
+// Vertex shader bindings of Terrain.hlsl
+#define TERRAIN_CONSTANTS_SLOT  2
+#define TERRAIN_HEIGHT_MAP_SLOT 2
+#define TERRAIN_SAMPLER_SLOT    1
+
+struct TerrainSettings
+{
+	UINT tileResolution;                // Quads per side of a leaf node and of the tile, even
+	float sampleSpacing;                // World units between height map samples
+	DirectX::XMFLOAT3 origin;           // World position of height map sample (0, 0) at height 0
+	float pixelErrorBudget;             // Largest projected geometric error of the selected levels
+	float morphStartRatio;              // Where in its range a level starts morphing to the next one
+
+	static TerrainSettings Default();
+};
+
+struct TerrainView
+{
+	DirectX::XMFLOAT3 eye;
+	DirectX::XMFLOAT4X4 viewProjection; // Row vectors, as the camera returns it
+	float screenHeight;                 // Pixels
+	float projectionScale;              // Projection _22, 1 / tan(fovY / 2)
+};
+
+// Per-instance vertex data of Terrain.hlsl
+struct TerrainInstance
+{
+	DirectX::XMFLOAT4 node;             // World x and z of the node's minimum corner, size, tile resolution
+	DirectX::XMFLOAT4 morph;            // Morph start distance, 1 / morph length, level
+};
+
+struct TerrainSelectionStats
+{
+	size_t visitedNodes;
+	size_t selectedNodes;               // Drawn with the full tile
+	size_t selectedQuadrants;           // Drawn with the half tile
+	size_t frustumCulledNodes;
+	size_t vertexCount;                 // Vertices submitted
+	size_t triangleCount;
+	double seconds;
+};
+
+struct TerrainBenchmarkResult
+{
+	UINT frames;
+	double averageMilliseconds;         // Selection time per frame
+	double minMilliseconds;
+	double maxMilliseconds;
+	double averageVertices;             // Vertices submitted per frame
+	size_t fullGridVertices;            // One vertex per height map sample
+};
+
+class Terrain
+{
+public:
+	Terrain();
+
+	// heights holds size x size samples in world units, row z = 0 first.  size - 1 has to be
+	// tileResolution times a power of two.
+	HRESULT Build(const float* heights, UINT size, const TerrainSettings& settings);
+
+	// Picks the nodes to draw and their level for one view
+	void Select(const TerrainView& view, TerrainSelectionStats* stats = nullptr);
+
+	// After Build, the instance buffer is sized for the tree
+	HRESULT CreateDeviceResources(ID3D11Device* device);
+	void DestroyDeviceResources();
+	HRESULT CreateInputLayout(ID3D11Device* device, DirectX::IEffect* effect, ID3D11InputLayout** inputLayout);
+	// Draws the nodes of the last Select; setCustomState runs after the effect is applied
+	void Draw(ID3D11DeviceContext* context, DirectX::IEffect* effect, ID3D11InputLayout* inputLayout,
+		std::function<void()> setCustomState = nullptr);
+
+	const std::vector<TerrainInstance>& GetInstances() const { return instances; }
+	UINT GetLevelCount() const { return levelCount; }
+	float GetLevelError(UINT level) const { return levelError[level]; }
+	UINT GetHeightMapSize() const { return size; }
+	DirectX::XMFLOAT3 GetCenter() const;
+	float GetExtent() const { return (size - 1) * settings.sampleSpacing; }
+	float GetHeight(float x, float z) const;
+
+private:
+	struct Node
+	{
+		DirectX::XMFLOAT3 boundsMin;
+		DirectX::XMFLOAT3 boundsMax;
+		UINT x, z;                      // First height map sample
+		UINT level;                     // 0 is the finest
+		UINT firstChild;                // Four consecutive nodes, 0 for a leaf
+	};
+
+	struct SelectContext;
+	// Returns false if the node is out of the range of its level, the parent then draws its area
+	bool SelectNode(SelectContext& context, UINT index);
+	void AddInstance(SelectContext& context, const Node& node, UINT quadrant);
+
+	TerrainSettings settings;
+	UINT size;
+	UINT levelCount;
+	std::vector<float> heights;
+	std::vector<Node> nodes;
+	float levelError[TERRAIN_MAX_LEVELS];       // Largest height map error of the level's grid
+
+	std::vector<TerrainInstance> instances;     // Full tiles first, then half tiles
+	std::vector<TerrainInstance> quadrants;
+	UINT fullTileCount;
+	DirectX::XMFLOAT3 selectedEye;
+
+	struct Tile
+	{
+		Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+		UINT indexCount;
+	};
+	Tile tiles[2];                              // Full and half resolution
+	Microsoft::WRL::ComPtr<ID3D11Buffer> instanceBuffer;
+	UINT instanceCapacity;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> constantBuffer;
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> heightMapSRV;
+	Microsoft::WRL::ComPtr<ID3D11SamplerState> heightMapSampler;
+};
+
+// Fractal height map of size x size samples (size - 1 a power of two) in [0, heightScale]
+void GenerateTerrainHeightMap(UINT size, float heightScale, float roughness, UINT seed, std::vector<float>& heights);
+
+// Times Select over a flight around the terrain at the view's height above the ground
+TerrainBenchmarkResult BenchmarkTerrainSelection(Terrain& terrain, const TerrainView& view,
+	const DirectX::XMFLOAT4X4& projection, UINT frames);
+
+#endif
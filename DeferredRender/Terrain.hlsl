@@ -0,0 +1,23 @@
+#include "shader\\inc\\shader_include.hlsl"
+
+cbuffer cbCustom : register( b1 )
+{
+	float4 textureScale; 
+}
+
+cbuffer cbTerrain : register( b2 )                  // TERRAIN_CONSTANTS_SLOT
+{
+    float4 g_vTerrainOrigin;                        // Height map sample (0, 0) at height 0, sample spacing
+    float4 g_vTerrainHeightMap;                     // Size, 1 / size
+    float4 g_vTerrainEye;
+}
+
+Texture2D heightMap : register( t2 );               // TERRAIN_HEIGHT_MAP_SLOT
+SamplerState heightSampler : register( s1 );        // TERRAIN_SAMPLER_SLOT
+
+#include "shader\\src\\vs\\Terrain.hlsl"
+
+Texture2D colorTexture : register( t0 );
+SamplerState linearSampler : register( s0 );
+
+#include "shader\\src\\ps\\Terrain.hlsl"
@@ -0,0 +1,45 @@
+//--------------------------------------------------------------------------------------
+// File: Check.h
+//
+// Assertions of the host-side tests.  A failed CHECK prints its file, line and
+// expression and the test's main returns CheckResult() to fail the run.
+//--------------------------------------------------------------------------------------
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <cmath>
+#include <cstdio>
+
+inline int& CheckFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+inline bool CheckFailed(const char* file, int line, const char* expression)
+{
+	printf("%s(%d): check failed: %s\n", file, line, expression);
+	CheckFailures()++;
+	return false;
+}
+
+inline bool CheckNearFailed(const char* file, int line, const char* expression, double actual, double expected)
+{
+	printf("%s(%d): check failed: %s is %g, expected %g\n", file, line, expression, actual, expected);
+	CheckFailures()++;
+	return false;
+}
+
+// Prints the result of the test and returns the exit code for main
+inline int CheckResult(const char* test)
+{
+	printf("%s: %s\n", test, CheckFailures() ? "FAILED" : "passed");
+	return CheckFailures() ? 1 : 0;
+}
+
+#define CHECK(condition) ((condition) ? true : CheckFailed(__FILE__, __LINE__, #condition))
+#define CHECK_NEAR(actual, expected, tolerance) \
+	(fabs((double)(actual) - (double)(expected)) <= (tolerance) ? true : \
+	CheckNearFailed(__FILE__, __LINE__, #actual, (double)(actual), (double)(expected)))
+
+#endif
@@ -0,0 +1,224 @@
+//--------------------------------------------------------------------------------------
+// File: TestDynamicResolution.cpp
+//
+// Replays GPU time traces through DynamicResolutionController, and drives GpuTimer with
+// a fake device context whose GPU runs a given number of frames behind.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DynamicResolution.h"
+#include "Check.h"
+#include <deque>
+#include <vector>
+
+namespace
+{
+	//----------------------------------------------------------------------------------
+	// Controller
+	//----------------------------------------------------------------------------------
+
+	// Frames whose scaled passes cost nativeMilliseconds at scale 1
+	struct TraceSegment
+	{
+		int frames;
+		float nativeMilliseconds;
+	};
+
+	// The time of a frame is the native cost times the area the controller picked
+	// GPU_TIMER_LATENCY frames earlier, with +-3% of noise from a fixed seed
+	std::vector<float> ReplayTrace(DynamicResolutionController& controller, const TraceSegment* trace, size_t segments)
+	{
+		std::vector<float> scales;
+		float areas[GPU_TIMER_LATENCY];
+		for (int i = 0; i < GPU_TIMER_LATENCY; ++i)
+			areas[i] = controller.GetScale() * controller.GetScale();
+
+		unsigned seed = 1;
+		int frame = 0;
+		for (size_t s = 0; s < segments; ++s)
+		{
+			for (int i = 0; i < trace[s].frames; ++i, ++frame)
+			{
+				seed = seed * 1664525u + 1013904223u;
+				float noise = (seed >> 8) / (float)(1 << 24) * 2.0f - 1.0f;
+				float milliseconds = trace[s].nativeMilliseconds * areas[frame % GPU_TIMER_LATENCY] * (1.0f + 0.03f * noise);
+
+				float scale = controller.Update(milliseconds);
+				areas[frame % GPU_TIMER_LATENCY] = scale * scale;
+				scales.push_back(scale);
+			}
+		}
+		return scales;
+	}
+
+	void TestController()
+	{
+		const DynamicResolutionSettings settings = DynamicResolutionSettings::Default();
+		const TraceSegment trace[] = { { 200, 8.0f }, { 400, 20.0f }, { 400, 30.0f }, { 200, 60.0f }, { 300, 8.0f } };
+		const size_t segments = sizeof(trace) / sizeof(trace[0]);
+
+		// The controller reads no clock: the same trace gives the same scales
+		DynamicResolutionController controller, replay;
+		std::vector<float> scales = ReplayTrace(controller, trace, segments);
+		CHECK(scales == ReplayTrace(replay, trace, segments));
+
+		// The last 100 frames of each segment have settled to the scale whose area fits
+		// the cost in the budget, rounded to a step and clamped to [minScale, maxScale]
+		int start = 0;
+		for (size_t s = 0; s < segments; ++s)
+		{
+			float ideal = sqrtf(settings.targetMilliseconds / trace[s].nativeMilliseconds);
+			ideal = min(max(ideal, settings.minScale), settings.maxScale);
+			for (int i = start + trace[s].frames - 100; i < start + trace[s].frames; ++i)
+				CHECK_NEAR(scales[i], ideal, settings.scaleStep);
+			start += trace[s].frames;
+		}
+
+		// Per frame the area grows by at most maxIncrease and shrinks by at most
+		// maxDecrease, give or take the rounding of this scale and the previous one
+		float previous = settings.maxScale;
+		for (size_t i = 0; i < scales.size(); ++i)
+		{
+			CHECK(scales[i] <= sqrtf(previous * previous * (1.0f + settings.maxIncrease)) + settings.scaleStep + 1e-4f);
+			CHECK(scales[i] >= sqrtf(previous * previous * (1.0f - settings.maxDecrease)) - settings.scaleStep - 1e-4f);
+			previous = scales[i];
+		}
+
+		// One slow frame costs at most one limited step down, and the scale is back to
+		// native within a few frames
+		DynamicResolutionController spiked;
+		const TraceSegment spike[] = { { 50, 8.0f }, { 1, 100.0f }, { 49, 8.0f } };
+		std::vector<float> spikeScales = ReplayTrace(spiked, spike, 3);
+		float lowest = settings.maxScale;
+		for (size_t i = 50; i < spikeScales.size(); ++i)
+			lowest = min(lowest, spikeScales[i]);
+		CHECK(lowest >= sqrtf(1.0f - settings.maxDecrease) - settings.scaleStep);
+		CHECK(spikeScales.back() == settings.maxScale);
+
+		// A time that is not known yet (GpuTimer::Read returns a negative value) leaves the
+		// scale and the filter alone
+		float filtered = controller.GetFilteredMilliseconds();
+		CHECK(controller.Update(-1.0f) == scales.back());
+		CHECK(controller.GetFilteredMilliseconds() == filtered);
+
+		controller.Reset();
+		CHECK(controller.GetScale() == settings.maxScale);
+	}
+
+	//----------------------------------------------------------------------------------
+	// GpuTimer
+	//----------------------------------------------------------------------------------
+	struct FakeQuery : ID3D11Query
+	{
+		D3D11_QUERY type;
+		int issuedFrame;
+		UINT64 timestamp;
+	};
+
+	struct FakeDevice : ID3D11Device
+	{
+		HRESULT CreateQuery(const D3D11_QUERY_DESC* desc, ID3D11Query** query)
+		{
+			FakeQuery* fake = new FakeQuery;
+			fake->type = desc->Query;
+			fake->issuedFrame = -1;
+			fake->timestamp = 0;
+			*query = fake;
+			return S_OK;
+		}
+	};
+
+	// Queries complete gpuLatency frames after they are issued.  The GPU time of every
+	// measured Begin/End pair is queued so the reads can be matched against it.
+	struct FakeContext : ID3D11DeviceContext
+	{
+		FakeContext(int gpuLatency) : gpuLatency(gpuLatency), frame(0), now(0), begin(0), timing(false) {}
+
+		void Begin(ID3D11Asynchronous*) {}
+		void End(ID3D11Asynchronous* async)
+		{
+			FakeQuery* query = static_cast<FakeQuery*>(async);
+			query->issuedFrame = frame;
+			query->timestamp = now;
+			if (query->type != D3D11_QUERY_TIMESTAMP)
+				return;
+			if (!timing)
+				begin = now;
+			else
+				measured.push_back(now - begin);
+			timing = !timing;
+		}
+		HRESULT GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT)
+		{
+			FakeQuery* query = static_cast<FakeQuery*>(async);
+			if (query->issuedFrame < 0 || frame < query->issuedFrame + gpuLatency)
+				return S_FALSE;
+			if (query->type == D3D11_QUERY_TIMESTAMP_DISJOINT)
+			{
+				D3D11_QUERY_DATA_TIMESTAMP_DISJOINT disjoint = { 1000000, 0 };
+				memcpy(data, &disjoint, min(dataSize, (UINT)sizeof(disjoint)));
+			}
+			else
+				memcpy(data, &query->timestamp, min(dataSize, (UINT)sizeof(query->timestamp)));
+			return S_OK;
+		}
+
+		int gpuLatency;
+		int frame;
+		UINT64 now;                     // Microseconds
+		UINT64 begin;
+		bool timing;                    // Between the begin and end timestamps
+		std::deque<UINT64> measured;
+	};
+
+	// Runs the frames as OnD3D11FrameRender does: Read, then Begin and End around the
+	// passes.  Returns the number of times read.
+	int RunTimedFrames(int gpuLatency, int frames)
+	{
+		FakeDevice device;
+		FakeContext context(gpuLatency);
+		GpuTimer timer;
+		CHECK(SUCCEEDED(timer.Create(&device)));
+
+		int reads = 0;
+		for (context.frame = 0; context.frame < frames; ++context.frame)
+		{
+			float milliseconds = timer.Read(&context);
+			if (milliseconds >= 0.0f)
+			{
+				// Every time read is the oldest measured one that was not read yet
+				if (CHECK(!context.measured.empty()))
+				{
+					CHECK_NEAR(milliseconds, context.measured.front() / 1000.0, 1e-3);
+					context.measured.pop_front();
+				}
+				reads++;
+			}
+
+			timer.Begin(&context);
+			context.now += 1000 + 250 * (context.frame % 8);
+			timer.End(&context);
+			context.now += 500;
+		}
+		timer.Destroy();
+		return reads;
+	}
+
+	void TestGpuTimer()
+	{
+		// Within the latency every frame is measured and read GPU_TIMER_LATENCY frames later
+		for (int gpuLatency = 1; gpuLatency <= GPU_TIMER_LATENCY; ++gpuLatency)
+			CHECK(RunTimedFrames(gpuLatency, 100) == 100 - GPU_TIMER_LATENCY);
+
+		// A GPU further behind is still measured: the frames that would reuse pending
+		// queries are skipped instead
+		CHECK(RunTimedFrames(GPU_TIMER_LATENCY + 2, 100) > 0);
+		CHECK(RunTimedFrames(3 * GPU_TIMER_LATENCY, 100) > 0);
+	}
+}
+
+int main()
+{
+	TestController();
+	TestGpuTimer();
+	return CheckResult("TestDynamicResolution");
+}
@@ -0,0 +1,99 @@
+//--------------------------------------------------------------------------------------
+// File: TestFramePacer.cpp
+//
+// Drives CDXUTFramePacer with a CDXUTFakeFrameClock and checks its schedule, missed
+// deadlines and statistics.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DXUT/Core/DXUTframepacer.h"
+#include "Check.h"
+
+namespace
+{
+	// A microsecond clock: 100 FPS is 10000 ticks per frame, frames take 2000 ticks of work
+	const LONGLONG TICKS_PER_SECOND = 1000000;
+	const LONGLONG WORK = 2000;
+	const double PERIOD = 0.01;
+	const double TICK = 1.0 / TICKS_PER_SECOND;
+
+	// Runs frameCount frames that each take work ticks of simulated work
+	void RunPacedFrames(CDXUTFramePacer& pacer, CDXUTFakeFrameClock& clock, UINT frameCount, LONGLONG work)
+	{
+		for (UINT i = 0; i < frameCount; i++)
+		{
+			pacer.WaitForNextFrame();
+			clock.Advance(work);
+			pacer.EndFrame();
+		}
+	}
+
+	// Exact sleeps, then a late frame, a pause and uncapped frames
+	void TestExactClock()
+	{
+		CDXUTFakeFrameClock clock(TICKS_PER_SECOND);
+		CDXUTFramePacer pacer(&clock);
+		DXUT_FRAME_PACING_STATS stats;
+
+		// Every frame is one period apart and nothing is missed
+		pacer.SetTargetFPS(100.0f);
+		RunPacedFrames(pacer, clock, 200, WORK);
+		pacer.GetStats(&stats);
+		CHECK(stats.nFrames == DXUT_FRAME_PACING_HISTORY);
+		CHECK_NEAR(stats.fMinFrameTime, PERIOD, TICK);
+		CHECK_NEAR(stats.fMaxFrameTime, PERIOD, TICK);
+		CHECK(stats.nMissedDeadlines == 0);
+
+		// A frame that runs 2.5 periods late restarts the schedule once instead of
+		// rendering the frames it missed back to back
+		RunPacedFrames(pacer, clock, 1, 25000);
+		RunPacedFrames(pacer, clock, 1, WORK);
+		LONGLONG start = clock.GetTicks();
+		RunPacedFrames(pacer, clock, 10, WORK);
+		pacer.GetStats(&stats);
+		CHECK(stats.nMissedDeadlines == 1);
+		CHECK_NEAR((double)(clock.GetTicks() - start) / TICKS_PER_SECOND, 10 * PERIOD, TICK);
+
+		// After a pause DXUT resets the pacer, so the pause is neither a missed deadline
+		// nor a frame time
+		clock.Advance(TICKS_PER_SECOND);
+		pacer.Reset();
+		RunPacedFrames(pacer, clock, 20, WORK);
+		pacer.GetStats(&stats);
+		CHECK(stats.nFrames == 19);
+		CHECK_NEAR(stats.fMaxFrameTime, PERIOD, TICK);
+		CHECK_NEAR(stats.fSmoothedFrameTime, PERIOD, TICK);
+		CHECK(stats.nMissedDeadlines == 0);
+
+		// Uncapped frames never wait
+		pacer.SetTargetFPS(0.0f);
+		pacer.Reset();
+		RunPacedFrames(pacer, clock, 20, WORK);
+		pacer.GetStats(&stats);
+		CHECK(stats.fLastWaitTime == 0.0);
+		CHECK_NEAR(stats.fMeanFrameTime, WORK * TICK, TICK);
+	}
+
+	// Sleeps that overshoot by 3ms: the spin threshold grows past the oversleep within a
+	// few frames, after which every deadline is met by spinning
+	void TestOversleepingClock()
+	{
+		CDXUTFakeFrameClock clock(TICKS_PER_SECOND, 3000);
+		CDXUTFramePacer pacer(&clock);
+		DXUT_FRAME_PACING_STATS stats;
+
+		pacer.SetTargetFPS(100.0f);
+		RunPacedFrames(pacer, clock, 200, WORK);
+		pacer.GetStats(&stats);
+		CHECK_NEAR(stats.fMinFrameTime, PERIOD, TICK);
+		CHECK_NEAR(stats.fMaxFrameTime, PERIOD, TICK);
+		CHECK(stats.nMissedDeadlines == 0);
+		CHECK(stats.fSpinThreshold >= 0.003);
+	}
+}
+
+int main()
+{
+	TestExactClock();
+	TestOversleepingClock();
+	return CheckResult("TestFramePacer");
+}
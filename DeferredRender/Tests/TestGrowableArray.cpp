@@ -0,0 +1,183 @@
+//--------------------------------------------------------------------------------------
+// File: TestGrowableArray.cpp
+//
+// Fills, copies, moves and swaps CGrowableArrays with inline storage across the point
+// where the elements leave the inline buffer for the heap, with a trivially copyable
+// element and with one that counts its live instances.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "DXUT/Core/DXUTarray.h"
+#include "Check.h"
+
+#define INLINE_SIZE 4
+
+namespace
+{
+	// Counts the constructed and not yet destroyed instances; a moved-from instance
+	// keeps counting until it's destroyed
+	struct Tracked
+	{
+		static int live;
+
+		Tracked() : value(-1) { ++live; }
+		Tracked(int value) : value(value) { ++live; }
+		Tracked(const Tracked& other) : value(other.value) { ++live; }
+		Tracked(Tracked&& other) : value(other.value) { other.value = -2; ++live; }
+		~Tracked() { --live; }
+		Tracked& operator=(const Tracked& other) { value = other.value; return *this; }
+		Tracked& operator=(Tracked&& other) { value = other.value; other.value = -2; return *this; }
+		bool operator==(const Tracked& other) const { return value == other.value; }
+
+		int value;
+	};
+
+	int Tracked::live = 0;
+
+	struct alignas(16) Aligned
+	{
+		float v[4];
+	};
+
+	int ValueOf(int element) { return element; }
+	int ValueOf(const Tracked& element) { return element.value; }
+
+	template<typename ARRAY> bool IsInline(const ARRAY& a)
+	{
+		const char* pData = (const char*)a.GetData();
+		return pData >= (const char*)&a && pData < (const char*)(&a + 1);
+	}
+
+	// Holds base, base + 1, ... base + nCount - 1
+	template<typename ARRAY> bool Holds(const ARRAY& a, int nCount, int base)
+	{
+		if (a.GetSize() != nCount)
+			return false;
+		for (int i = 0; i < nCount; ++i)
+		{
+			if (ValueOf(a[i]) != base + i)
+				return false;
+		}
+		return true;
+	}
+
+	template<typename ARRAY> void Fill(ARRAY& a, int nCount, int base)
+	{
+		a.RemoveAll();
+		for (int i = 0; i < nCount; ++i)
+			a.Add(base + i);
+	}
+
+	template<typename TYPE> void TestGrowth()
+	{
+		CGrowableArray<TYPE, INLINE_SIZE> a;
+		CHECK(IsInline(a) && a.GetCapacity() == INLINE_SIZE);
+
+		for (int i = 0; i < INLINE_SIZE; ++i)
+			a.Add(i);
+		CHECK(IsInline(a) && Holds(a, INLINE_SIZE, 0));
+
+		// One past the inline buffer moves everything to the heap
+		a.Add(INLINE_SIZE);
+		CHECK(!IsInline(a) && Holds(a, INLINE_SIZE + 1, 0));
+
+		a.Insert(0, -1);
+		a.Remove(0);
+		CHECK(Holds(a, INLINE_SIZE + 1, 0));
+
+		// Reset keeps the heap buffer, RemoveAll goes back to the inline one
+		a.Reset();
+		CHECK(!IsInline(a) && a.GetSize() == 0 && a.GetCapacity() > INLINE_SIZE);
+		a.RemoveAll();
+		CHECK(IsInline(a) && a.GetCapacity() == INLINE_SIZE);
+
+		Fill(a, INLINE_SIZE - 1, 10);
+		CHECK(IsInline(a) && Holds(a, INLINE_SIZE - 1, 10));
+	}
+
+	template<typename TYPE> void TestCopyAndMove()
+	{
+		for (int nCount = 0; nCount <= 2 * INLINE_SIZE; ++nCount)
+		{
+			CGrowableArray<TYPE, INLINE_SIZE> source;
+			Fill(source, nCount, 100);
+			bool bInline = IsInline(source);
+
+			CGrowableArray<TYPE, INLINE_SIZE> copy(source);
+			CHECK(Holds(copy, nCount, 100) && Holds(source, nCount, 100));
+			CHECK(IsInline(copy) == bInline);
+
+			// Assigning over elements of either kind
+			CGrowableArray<TYPE, INLINE_SIZE> assigned;
+			Fill(assigned, 2 * INLINE_SIZE - nCount, 0);
+			assigned = source;
+			CHECK(Holds(assigned, nCount, 100));
+
+			// A heap buffer changes owner, inline elements are relocated
+			const TYPE* pData = source.GetData();
+			CGrowableArray<TYPE, INLINE_SIZE> moved(std::move(source));
+			CHECK(Holds(moved, nCount, 100) && IsInline(moved) == bInline);
+			CHECK(bInline || moved.GetData() == pData);
+			CHECK(source.GetSize() == 0 && IsInline(source));
+
+			CGrowableArray<TYPE, INLINE_SIZE> moveAssigned;
+			Fill(moveAssigned, 2 * INLINE_SIZE - nCount, 0);
+			moveAssigned = std::move(moved);
+			CHECK(Holds(moveAssigned, nCount, 100) && IsInline(moveAssigned) == bInline);
+			CHECK(moved.GetSize() == 0 && IsInline(moved));
+
+			// The moved-from arrays are still usable
+			Fill(source, INLINE_SIZE + 1, 7);
+			CHECK(Holds(source, INLINE_SIZE + 1, 7));
+		}
+	}
+
+	template<typename TYPE> void TestSwap()
+	{
+		// Every pair of inline and heap sizes, including empty arrays
+		const int counts[] = { 0, 1, INLINE_SIZE, INLINE_SIZE + 1, 3 * INLINE_SIZE };
+		for (int nA : counts)
+		{
+			for (int nB : counts)
+			{
+				CGrowableArray<TYPE, INLINE_SIZE> a, b;
+				Fill(a, nA, 0);
+				Fill(b, nB, 1000);
+
+				a.Swap(b);
+				CHECK(Holds(a, nB, 1000) && Holds(b, nA, 0));
+
+				b.Swap(a);
+				CHECK(Holds(a, nA, 0) && Holds(b, nB, 1000));
+
+				a.Swap(a);
+				CHECK(Holds(a, nA, 0));
+			}
+		}
+	}
+
+	void TestAlignment()
+	{
+		struct Holder
+		{
+			char c;
+			CGrowableArray<Aligned, INLINE_SIZE> a;
+		} holder;
+
+		CHECK(IsInline(holder.a) && (uintptr_t)holder.a.GetData() % 16 == 0);
+	}
+}
+
+int main()
+{
+	TestGrowth<int>();
+	TestCopyAndMove<int>();
+	TestSwap<int>();
+
+	TestGrowth<Tracked>();
+	TestCopyAndMove<Tracked>();
+	TestSwap<Tracked>();
+	CHECK(Tracked::live == 0);
+
+	TestAlignment();
+	return CheckResult("TestGrowableArray");
+}
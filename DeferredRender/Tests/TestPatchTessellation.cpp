@@ -0,0 +1,443 @@
+//--------------------------------------------------------------------------------------
+// File: TestPatchTessellation.cpp
+//
+// Compares PatchTessellator with a scalar port of ConstantsHS in every tessellation mode,
+// with and without density and frustum culling, checks what Upload writes to the
+// buffers, and times BenchmarkPatchTessellation against the port.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "PatchTessellation.h"
+#include "Check.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// DISTANCE_ADAPTIVE_TESSELLATION range in the VS
+	const float MIN_DISTANCE = 20.0f;
+	const float MAX_DISTANCE = 250.0f;
+
+	const float SCREEN_WIDTH = 1280.0f;
+	const float SCREEN_HEIGHT = 720.0f;
+
+	// The tessellator discards a patch if an edge factor is zero, negative or NaN
+	bool HasZeroEdgeFactor(const XMFLOAT4& factors)
+	{
+		return !(factors.x > 0.0f && factors.y > 0.0f && factors.z > 0.0f);
+	}
+
+	//----------------------------------------------------------------------------------
+	// Scalar port of ConstantsHS and of the VS and AdaptiveTessellation.hlsl functions
+	// it uses, mul(v, M) with row vectors
+	//----------------------------------------------------------------------------------
+	XMFLOAT3 ReferenceWorldPosition(const XMFLOAT4X4& m, const XMFLOAT3& p)
+	{
+		// mul(float3, float4x4) in the VS drops the translation row
+		return XMFLOAT3(
+			p.x * m._11 + p.y * m._21 + p.z * m._31,
+			p.x * m._12 + p.y * m._22 + p.z * m._32,
+			p.x * m._13 + p.y * m._23 + p.z * m._33);
+	}
+
+	float ReferenceDistanceFactor(const PatchTessellationSettings& settings, const XMFLOAT3& p)
+	{
+		float dx = p.x - settings.eye.x, dy = p.y - settings.eye.y, dz = p.z - settings.eye.z;
+		float distance = sqrtf(dx * dx + dy * dy + dz * dz);
+		float maxReduction = 1.0f - settings.tessellationFactor.z / settings.tessellationFactor.x;
+		return 1.0f - min(max((distance - MIN_DISTANCE) / (MAX_DISTANCE - MIN_DISTANCE), 0.0f), maxReduction);
+	}
+
+	// GetScreenSpacePosition
+	XMFLOAT2 ReferenceScreenPosition(const PatchTessellationSettings& settings, const XMFLOAT3& p)
+	{
+		const XMFLOAT4X4& m = settings.viewProjection;
+		float x = p.x * m._11 + p.y * m._21 + p.z * m._31 + m._41;
+		float y = p.x * m._12 + p.y * m._22 + p.z * m._32 + m._42;
+		float w = p.x * m._14 + p.y * m._24 + p.z * m._34 + m._44;
+		return XMFLOAT2((x / w + 1.0f) * 0.5f * settings.screenWidth, (y / w + 1.0f) * 0.5f * -settings.screenHeight);
+	}
+
+	float ScreenDistance(const XMFLOAT2& a, const XMFLOAT2& b)
+	{
+		return sqrtf((a.x - b.x) * (a.x - b.x) + (a.y - b.y) * (a.y - b.y));
+	}
+
+	// ViewFrustumCull: the patch is culled if all three vertices are behind one of the planes
+	bool ReferenceFrustumCull(const PatchTessellationSettings& settings, const XMFLOAT3* p)
+	{
+		for (int plane = 0; plane < 4; ++plane)
+		{
+			const XMFLOAT4& e = settings.frustumPlanes[plane];
+			int inside = 0;
+			for (int v = 0; v < 3; ++v)
+				inside += (p[v].x * e.x + p[v].y * e.y + p[v].z * e.z + e.w) > -settings.cullEpsilon ? 1 : 0;
+			if (inside == 0)
+				return true;
+		}
+		return false;
+	}
+
+	// ConstantsHS for one patch, all zero if the frustum test culls it
+	XMFLOAT4 ReferenceFactors(const PatchTessellationSettings& settings,
+		const XMFLOAT3& p0, const XMFLOAT3& p1, const XMFLOAT3& p2, const XMFLOAT4& edgeDensity)
+	{
+		const XMFLOAT4& tf = settings.tessellationFactor;
+		XMFLOAT3 p[3] = {
+			ReferenceWorldPosition(settings.world, p0),
+			ReferenceWorldPosition(settings.world, p1),
+			ReferenceWorldPosition(settings.world, p2) };
+
+		XMFLOAT4 edges(tf.x, tf.x, tf.x, tf.y);
+		if (settings.mode == PATCH_TESSELLATION_DISTANCE_ADAPTIVE)
+		{
+			float f0 = ReferenceDistanceFactor(settings, p[0]);
+			float f1 = ReferenceDistanceFactor(settings, p[1]);
+			float f2 = ReferenceDistanceFactor(settings, p[2]);
+			edges.x = 0.5f * (f1 + f2);
+			edges.y = 0.5f * (f2 + f0);
+			edges.z = 0.5f * (f0 + f1);
+			edges.w = edges.x;
+			edges = XMFLOAT4(edges.x * tf.x, edges.y * tf.x, edges.z * tf.x, edges.w * tf.y);
+		}
+		else if (settings.mode == PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE)
+		{
+			XMFLOAT2 s0 = ReferenceScreenPosition(settings, p[0]);
+			XMFLOAT2 s1 = ReferenceScreenPosition(settings, p[1]);
+			XMFLOAT2 s2 = ReferenceScreenPosition(settings, p[2]);
+			edges.x = tf.w * ScreenDistance(s2, s1);
+			edges.y = tf.w * ScreenDistance(s2, s0);
+			edges.z = tf.w * ScreenDistance(s0, s1);
+			edges.w = 0.33f * (edges.x + edges.y + edges.z);
+		}
+
+		if (settings.densityBased)
+			edges = XMFLOAT4(edges.x * edgeDensity.y, edges.y * edgeDensity.z, edges.z * edgeDensity.x, edges.w * edgeDensity.w);
+
+		if (settings.frustumCulling && ReferenceFrustumCull(settings, p))
+			edges = XMFLOAT4(0.0f, 0.0f, 0.0f, 0.0f);
+
+		return edges;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Runs the reference on every patch of the grid and checks the compacted output of
+	// the last Update against it.  The compacted patches keep the order of the grid, so
+	// one walk over the grid pairs every patch with its compacted entry, if any.
+	// Returns the largest relative factor error; patches kept or dropped differently
+	// from the reference are counted in mismatches.
+	//----------------------------------------------------------------------------------
+	float ComparePatchTessellation(const PatchTessellator& tessellator, const PatchTessellationSettings& settings,
+		size_t& mismatches, size_t& referenceVisible)
+	{
+		const std::vector<XMFLOAT3>& positions = tessellator.GetPositions();
+		const std::vector<uint16_t>& indices = tessellator.GetIndices();
+		const std::vector<XMFLOAT4>& densities = tessellator.GetEdgeDensities();
+		const std::vector<uint16_t>& visibleIndices = tessellator.GetVisibleIndices();
+		const std::vector<XMFLOAT4>& factors = tessellator.GetFactors();
+
+		float maxError = 0.0f;
+		size_t compacted = 0;
+		mismatches = 0;
+		referenceVisible = 0;
+		for (size_t i = 0; i < densities.size(); ++i)
+		{
+			const uint16_t* tri = &indices[i * 3];
+			XMFLOAT4 reference = ReferenceFactors(settings, positions[tri[0]], positions[tri[1]], positions[tri[2]], densities[i]);
+			bool visible = !HasZeroEdgeFactor(reference);
+			referenceVisible += visible;
+
+			bool kept = compacted < factors.size() && visibleIndices[compacted * 3] == tri[0] &&
+				visibleIndices[compacted * 3 + 1] == tri[1] && visibleIndices[compacted * 3 + 2] == tri[2];
+			if (kept != visible)
+				mismatches++;
+			if (!kept)
+				continue;
+
+			if (visible)
+			{
+				const float* a = &factors[compacted].x;
+				const float* b = &reference.x;
+				for (int c = 0; c < 4; ++c)
+					maxError = max(maxError, fabsf(a[c] - b[c]) / max(fabsf(b[c]), 1.0f));
+			}
+			compacted++;
+		}
+
+		// Compacted patches left over did not match any patch of the grid
+		mismatches += factors.size() - compacted;
+		return maxError;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Scenes
+	//----------------------------------------------------------------------------------
+	struct Camera
+	{
+		XMFLOAT3 eye;
+		XMFLOAT3 focus;
+	};
+
+	// Over the grid, at its edge looking across, far above it, and looking away from it
+	const Camera CAMERAS[] =
+	{
+		{ XMFLOAT3(10.0f, 12.0f, -20.0f), XMFLOAT3(30.0f, 0.0f, 40.0f) },
+		{ XMFLOAT3(-140.0f, 30.0f, -140.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+		{ XMFLOAT3(0.0f, 400.0f, -50.0f), XMFLOAT3(0.0f, 0.0f, 0.0f) },
+		{ XMFLOAT3(0.0f, 20.0f, 0.0f), XMFLOAT3(0.0f, 60.0f, 10.0f) },
+	};
+
+	uint32_t Random(uint32_t& seed)
+	{
+		seed = seed * 1664525u + 1013904223u;
+		return seed >> 8;
+	}
+
+	// Densities between 0.5 and 2, and zero on some patches as a degenerate density map
+	// gives them; the tessellator drops those
+	std::vector<XMFLOAT4> CreateEdgeDensities(size_t patchCount)
+	{
+		std::vector<XMFLOAT4> densities(patchCount);
+		uint32_t seed = 7;
+		for (size_t i = 0; i < patchCount; ++i)
+		{
+			float d[4];
+			for (int c = 0; c < 4; ++c)
+				d[c] = 0.5f + 1.5f * Random(seed) / 16777216.0f;
+			if (Random(seed) % 16 == 0)
+				d[Random(seed) % 3] = 0.0f;
+			densities[i] = XMFLOAT4(d[0], d[1], d[2], d[3]);
+		}
+		return densities;
+	}
+
+	// 64 x 64 quads of 4 units, 256 units across
+	void CreateGrid(PatchTessellator& tessellator)
+	{
+		std::vector<XMFLOAT3> positions;
+		std::vector<uint16_t> indices;
+		CreatePatchTessellationGrid(64, 4.0f, positions, indices);
+		std::vector<XMFLOAT4> densities = CreateEdgeDensities(indices.size() / 3);
+		tessellator.SetPatches(positions.data(), sizeof(XMFLOAT3), positions.size(), indices.data(), indices.size() / 3,
+			densities.data());
+	}
+
+	// The world matrix rotates about y and scales, its translation is ignored by the VS
+	PatchTessellationSettings CreateSettings()
+	{
+		PatchTessellationSettings settings;
+		ZeroMemory(&settings, sizeof(settings));
+		const float c = cosf(0.3f) * 1.25f, s = sinf(0.3f) * 1.25f;
+		XMStoreFloat4x4(&settings.world, XMMatrixSet(
+			c, 0.0f, -s, 0.0f,
+			0.0f, 1.25f, 0.0f, 0.0f,
+			s, 0.0f, c, 0.0f,
+			100.0f, -5.0f, 30.0f, 1.0f));
+		settings.tessellationFactor = XMFLOAT4(9.0f, 7.0f, 2.0f, 1.0f / 8.0f);
+		settings.cullEpsilon = 0.5f;
+		return settings;
+	}
+
+	void TestFactors()
+	{
+		PatchTessellator tessellator;
+		CreateGrid(tessellator);
+		const size_t patchCount = tessellator.GetEdgeDensities().size();
+		const PatchTessellationMode modes[] =
+			{ PATCH_TESSELLATION_UNIFORM, PATCH_TESSELLATION_DISTANCE_ADAPTIVE, PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE };
+		const char* modeNames[] = { "uniform", "distance adaptive", "screen space adaptive" };
+
+		for (int mode = 0; mode < 3; ++mode)
+		{
+			for (int options = 0; options < 4; ++options)
+			{
+				size_t worstMismatches = 0, fewestVisible = patchCount, mostVisible = 0;
+				float worstError = 0.0f;
+				for (const Camera& camera : CAMERAS)
+				{
+					PatchTessellationSettings settings = CreateSettings();
+					settings.mode = modes[mode];
+					settings.densityBased = (options & 1) != 0;
+					settings.frustumCulling = (options & 2) != 0;
+					SetPatchTessellationView(settings, camera.eye, camera.focus, XM_PIDIV4, SCREEN_WIDTH, SCREEN_HEIGHT);
+
+					PatchTessellationStats stats;
+					tessellator.Update(settings, &stats);
+					CHECK(stats.patchCount == patchCount);
+					CHECK(stats.visiblePatchCount + stats.frustumCulledPatches + stats.zeroFactorPatches == patchCount);
+					CHECK(tessellator.GetVisibleIndexCount() == stats.visiblePatchCount * 3);
+					CHECK(settings.frustumCulling || stats.frustumCulledPatches == 0);
+
+					size_t mismatches, visible;
+					float error = ComparePatchTessellation(tessellator, settings, mismatches, visible);
+					CHECK(visible == stats.visiblePatchCount);
+					worstMismatches = max(worstMismatches, mismatches);
+					worstError = max(worstError, error);
+					fewestVisible = min(fewestVisible, visible);
+					mostVisible = max(mostVisible, visible);
+				}
+
+				printf("Patches, %s%s%s: %zu to %zu of %zu visible, %zu mismatches, worst relative error %.2g\n",
+					modeNames[mode], (options & 1) ? ", density" : "", (options & 2) ? ", culled" : "",
+					fewestVisible, mostVisible, patchCount, worstMismatches, worstError);
+				CHECK(worstMismatches == 0);
+				CHECK(worstError < 1e-4f);
+
+				// Culling drops the patches behind the camera that looks away
+				if (options & 2)
+					CHECK(fewestVisible < patchCount / 2);
+			}
+		}
+	}
+
+	//----------------------------------------------------------------------------------
+	// Upload
+	//----------------------------------------------------------------------------------
+	struct FakeBuffer : ID3D11Buffer
+	{
+		D3D11_BUFFER_DESC desc;
+		std::vector<BYTE> data;
+	};
+
+	struct FakeShaderResourceView : ID3D11ShaderResourceView
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC desc;
+	};
+
+	struct FakeDevice : ID3D11Device
+	{
+		FakeDevice() : bufferCount(0) {}
+
+		HRESULT CreateQuery(const D3D11_QUERY_DESC*, ID3D11Query**) { return E_NOTIMPL; }
+		HRESULT CreateBuffer(const D3D11_BUFFER_DESC* desc, const D3D11_SUBRESOURCE_DATA*, ID3D11Buffer** buffer)
+		{
+			FakeBuffer* fake = new FakeBuffer;
+			fake->desc = *desc;
+			fake->data.assign(desc->ByteWidth, 0xCD);
+			*buffer = fake;
+			if (bufferCount < 2)
+				buffers[bufferCount++] = fake;
+			return S_OK;
+		}
+		HRESULT CreateShaderResourceView(ID3D11Resource*, const D3D11_SHADER_RESOURCE_VIEW_DESC* desc,
+			ID3D11ShaderResourceView** view)
+		{
+			FakeShaderResourceView* fake = new FakeShaderResourceView;
+			fake->desc = *desc;
+			*view = fake;
+			return S_OK;
+		}
+
+		const FakeBuffer* buffers[2];       // The index buffer, then the factors buffer
+		int bufferCount;
+	};
+
+	struct FakeContext : ID3D11DeviceContext
+	{
+		FakeContext() : mapped(0) {}
+
+		void Begin(ID3D11Asynchronous*) {}
+		void End(ID3D11Asynchronous*) {}
+		HRESULT GetData(ID3D11Asynchronous*, void*, UINT, UINT) { return E_NOTIMPL; }
+		HRESULT Map(ID3D11Resource* resource, UINT, D3D11_MAP type, UINT, D3D11_MAPPED_SUBRESOURCE* mappedResource)
+		{
+			CHECK(type == D3D11_MAP_WRITE_DISCARD);
+			mappedResource->pData = static_cast<FakeBuffer*>(resource)->data.data();
+			mapped++;
+			return S_OK;
+		}
+		void Unmap(ID3D11Resource*, UINT) { mapped--; }
+
+		int mapped;
+	};
+
+	void TestUpload()
+	{
+		PatchTessellator tessellator;
+		CreateGrid(tessellator);
+		const size_t patchCount = tessellator.GetEdgeDensities().size();
+
+		FakeDevice device;
+		FakeContext context;
+		CHECK(SUCCEEDED(tessellator.CreateBuffers(&device)));
+		CHECK(device.bufferCount == 2 && device.buffers[0] == tessellator.GetIndexBuffer());
+		const FakeBuffer* indexBuffer = device.buffers[0];
+		const FakeBuffer* factorsBuffer = device.buffers[1];
+		const FakeShaderResourceView* factorsView = static_cast<const FakeShaderResourceView*>(tessellator.GetFactorsSRV());
+		CHECK(indexBuffer->desc.ByteWidth == patchCount * 3 * sizeof(uint16_t));
+		CHECK(factorsBuffer->desc.ByteWidth == patchCount * sizeof(XMFLOAT4));
+		CHECK(factorsView->desc.Format == DXGI_FORMAT_R32G32B32A32_FLOAT && factorsView->desc.Buffer.NumElements == patchCount);
+
+		PatchTessellationSettings settings = CreateSettings();
+		settings.mode = PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE;
+		settings.frustumCulling = true;
+		SetPatchTessellationView(settings, CAMERAS[0].eye, CAMERAS[0].focus, XM_PIDIV4, SCREEN_WIDTH, SCREEN_HEIGHT);
+		tessellator.Update(settings);
+		CHECK(SUCCEEDED(tessellator.Upload(&context)));
+		CHECK(context.mapped == 0);
+
+		// The hull shader reads the factors of SV_PrimitiveID, the position in the index buffer
+		const std::vector<uint16_t>& visibleIndices = tessellator.GetVisibleIndices();
+		CHECK(!visibleIndices.empty());
+		const std::vector<XMFLOAT4>& factors = tessellator.GetFactors();
+		CHECK(memcmp(indexBuffer->data.data(), visibleIndices.data(), visibleIndices.size() * sizeof(uint16_t)) == 0);
+		CHECK(memcmp(factorsBuffer->data.data(), factors.data(), factors.size() * sizeof(XMFLOAT4)) == 0);
+
+		tessellator.DestroyBuffers();
+	}
+
+	//----------------------------------------------------------------------------------
+	// Benchmarks
+	//----------------------------------------------------------------------------------
+	void Benchmark()
+	{
+		const UINT gridSize = 255;
+		const UINT frames = 100;
+		PatchTessellationBenchmarkResult result = BenchmarkPatchTessellation(gridSize, frames);
+		printf("BenchmarkPatchTessellation: %zu patches in %.3f ms (%.3f to %.3f, %.0f per ms), %.0f%% visible\n",
+			result.patchCount, result.averageMilliseconds, result.minMilliseconds, result.maxMilliseconds,
+			result.patchesPerMillisecond, result.visibleFraction * 100.0f);
+		CHECK(result.frames == frames);
+		CHECK(result.patchCount == gridSize * gridSize * 2);
+		CHECK(result.visibleFraction > 0.0f && result.visibleFraction < 1.0f);
+
+		// The same grid and settings through the scalar port, as the hull shader runs it
+		std::vector<XMFLOAT3> positions;
+		std::vector<uint16_t> indices;
+		CreatePatchTessellationGrid(gridSize, 1.0f, positions, indices);
+		PatchTessellationSettings settings;
+		ZeroMemory(&settings, sizeof(settings));
+		XMStoreFloat4x4(&settings.world, XMMatrixIdentity());
+		settings.tessellationFactor = XMFLOAT4(7.0f, 7.0f, 1.0f, 1.0f / 8.0f);
+		settings.mode = PATCH_TESSELLATION_SCREEN_SPACE_ADAPTIVE;
+		settings.frustumCulling = true;
+		SetPatchTessellationView(settings, XMFLOAT3(0.25f * gridSize, 15.0f, 0.0f), XMFLOAT3(0.25f * gridSize, 14.7f, 1.0f),
+			XM_PIDIV4, 1920.0f, 1080.0f);
+
+		const int repeats = 5;
+		const XMFLOAT4 density(1.0f, 1.0f, 1.0f, 1.0f);
+		size_t visible = 0;
+		LARGE_INTEGER frequency, start, end;
+		QueryPerformanceFrequency(&frequency);
+		QueryPerformanceCounter(&start);
+		for (int r = 0; r < repeats; ++r)
+		{
+			for (size_t i = 0; i < indices.size(); i += 3)
+				visible += !HasZeroEdgeFactor(ReferenceFactors(settings,
+					positions[indices[i]], positions[indices[i + 1]], positions[indices[i + 2]], density));
+		}
+		QueryPerformanceCounter(&end);
+
+		double reference = (double)(end.QuadPart - start.QuadPart) / frequency.QuadPart / repeats * 1000.0;
+		printf("Patch factors: the scalar port %.0f patches per ms on one thread (%.1fx slower)\n",
+			result.patchCount / reference, reference / result.averageMilliseconds);
+		CHECK(visible > 0);
+	}
+}
+
+int main()
+{
+	TestFactors();
+	TestUpload();
+	Benchmark();
+	return CheckResult("TestPatchTessellation");
+}
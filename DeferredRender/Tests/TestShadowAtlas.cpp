@@ -0,0 +1,20 @@
+//--------------------------------------------------------------------------------------
+// File: TestShadowAtlas.cpp
+//
+// Replays the recorded shadow atlas scenes, as L does in the sample, and fails with
+// TestShadowAtlasReplays.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "ShadowAtlas.h"
+#include "Check.h"
+
+#define REPLAY_FRAMES 120               // SHADOW_ATLAS_REPLAY_FRAMES of Main.cpp
+
+int main()
+{
+	CHECK(SUCCEEDED(TestShadowAtlasReplays(REPLAY_FRAMES)));
+
+	// The same motion in smaller steps
+	CHECK(SUCCEEDED(TestShadowAtlasReplays(4 * REPLAY_FRAMES)));
+	return CheckResult("TestShadowAtlas");
+}
@@ -0,0 +1,272 @@
+//--------------------------------------------------------------------------------------
+// File: TestShadowCascades.cpp
+//
+// Moves a camera over a field of casters and checks ShadowCascades through each
+// cascade's viewProjection: the snapped centers move by whole shadow map texels, the
+// slices of the camera's frustum fit in their cascades, and every caster overlapping a
+// cascade's light volume is in its draw list.  Then times BenchmarkShadowCascades.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "ShadowCascades.h"
+#include "Check.h"
+
+using namespace DirectX;
+
+#define BENCHMARK_CASTERS 10000         // SHADOW_BENCHMARK_CASTERS of Main.cpp
+#define BENCHMARK_FRAMES 1000           // SHADOW_BENCHMARK_FRAMES of Main.cpp
+
+namespace
+{
+	const float FOV = XM_PI / 3;
+	const float ASPECT = 16.0f / 9.0f;
+	const float NEAR_Z = 0.1f;
+	const XMFLOAT3 LIGHT_DIRECTION(-0.85f, -0.25f, 0.45f);
+
+	// Light clip space x and y are within [-1, 1] over a cascade, depth within [0, 1]
+	const float CLIP_TOLERANCE = 1e-3f;
+	const double TEXEL_TOLERANCE = 1e-2;
+
+	struct Random
+	{
+		uint32_t seed;
+		float operator()(float low, float high)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return low + (high - low) * ((seed >> 8) / 16777216.0f);
+		}
+	};
+
+	struct Camera
+	{
+		XMFLOAT3 eye;
+		XMFLOAT3 forward;
+
+		// Row-vector, world to view, z up as the scene
+		XMFLOAT4X4 GetView() const
+		{
+			XMFLOAT4X4 view;
+			XMStoreFloat4x4(&view, XMMatrixLookToLH(XMVectorSet(eye.x, eye.y, eye.z, 1.0f),
+				XMLoadFloat3(&forward), XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f)));
+			return view;
+		}
+
+		// The corner of the view frustum at view space z, sx and sy are -1 or 1
+		XMFLOAT3 GetCorner(float z, float sx, float sy) const
+		{
+			XMVECTOR f = XMVector3Normalize(XMLoadFloat3(&forward));
+			XMVECTOR up = XMVectorSet(0.0f, 0.0f, 1.0f, 0.0f);
+			XMVECTOR right = XMVector3Normalize(XMVectorSet(
+				XMVectorGetY(up) * XMVectorGetZ(f) - XMVectorGetZ(up) * XMVectorGetY(f),
+				XMVectorGetZ(up) * XMVectorGetX(f) - XMVectorGetX(up) * XMVectorGetZ(f),
+				XMVectorGetX(up) * XMVectorGetY(f) - XMVectorGetY(up) * XMVectorGetX(f), 0.0f));
+			XMVECTOR cameraUp = XMVectorSet(
+				XMVectorGetY(f) * XMVectorGetZ(right) - XMVectorGetZ(f) * XMVectorGetY(right),
+				XMVectorGetZ(f) * XMVectorGetX(right) - XMVectorGetX(f) * XMVectorGetZ(right),
+				XMVectorGetX(f) * XMVectorGetY(right) - XMVectorGetY(f) * XMVectorGetX(right), 0.0f);
+
+			float tanY = tanf(FOV * 0.5f);
+			float tanX = tanY * ASPECT;
+			XMFLOAT3 corner;
+			XMStoreFloat3(&corner, XMLoadFloat3(&eye) + (f + right * (sx * tanX) + cameraUp * (sy * tanY)) * z);
+			return corner;
+		}
+	};
+
+	XMFLOAT3 ToLightClip(const ShadowCascade& cascade, const XMFLOAT3& position)
+	{
+		XMFLOAT3 clip;
+		XMStoreFloat3(&clip, XMVector3Transform(XMLoadFloat3(&position), XMLoadFloat4x4(&cascade.viewProjection)));
+		return clip;
+	}
+
+	// Light clip space units per world unit along x, y and z of the light
+	XMFLOAT3 GetClipScale(const ShadowCascade& cascade)
+	{
+		const XMFLOAT4X4& m = cascade.viewProjection;
+		return XMFLOAT3(sqrtf(m._11 * m._11 + m._21 * m._21 + m._31 * m._31),
+			sqrtf(m._12 * m._12 + m._22 * m._22 + m._32 * m._32),
+			sqrtf(m._13 * m._13 + m._23 * m._23 + m._33 * m._33));
+	}
+
+	double DistanceToWhole(double value)
+	{
+		return fabs(value - floor(value + 0.5));
+	}
+
+	// Casters scattered over the ground and above it, around the camera's path
+	std::vector<ShadowCaster> CreateCasters(UINT count, uint32_t seed)
+	{
+		Random random = { seed };
+		std::vector<ShadowCaster> casters(count);
+		for (UINT i = 0; i < count; ++i)
+		{
+			casters[i].center = XMFLOAT3(random(-100.0f, 100.0f), random(-100.0f, 100.0f), random(0.0f, 20.0f));
+			casters[i].radius = random(0.25f, 4.0f);
+		}
+		return casters;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Snapping: translating the camera keeps every cascade's size, and its light clip
+	// space slides over the world by whole shadow map texels
+	//----------------------------------------------------------------------------------
+	void TestSnapping()
+	{
+		ShadowCascades shadows;
+		std::vector<ShadowCaster> casters = CreateCasters(100, 7);
+		const ShadowSettings& settings = shadows.GetSettings();
+		double halfResolution = 0.5 * settings.resolution;
+
+		Camera camera = { XMFLOAT3(-20.0f, -5.0f, 10.0f), XMFLOAT3(1.0f, 0.3f, -0.3f) };
+		shadows.Update(camera.GetView(), FOV, ASPECT, NEAR_Z, LIGHT_DIRECTION, casters);
+		ShadowCascade first[SHADOW_MAX_CASCADES];
+		for (UINT i = 0; i < shadows.GetCascadeCount(); ++i)
+			first[i] = shadows.GetCascade(i);
+
+		const UINT steps = 100;
+		UINT misses = 0;
+		for (UINT step = 1; step <= steps; ++step)
+		{
+			// Steps that aren't a multiple of any texel size
+			camera.eye.x += 0.377f;
+			camera.eye.y += 0.0911f;
+			camera.eye.z += 0.013f;
+			shadows.Update(camera.GetView(), FOV, ASPECT, NEAR_Z, LIGHT_DIRECTION, casters);
+
+			for (UINT i = 0; i < shadows.GetCascadeCount(); ++i)
+			{
+				const ShadowCascade& cascade = shadows.GetCascade(i);
+				CHECK(cascade.radius == first[i].radius && cascade.texelSize == first[i].texelSize);
+
+				// The world origin is on the light's view axis, so it sits on a texel
+				// corner; any other point keeps where it is within its texel
+				XMFLOAT3 origin = ToLightClip(cascade, XMFLOAT3(0.0f, 0.0f, 0.0f));
+				XMFLOAT3 now = ToLightClip(cascade, first[i].center);
+				XMFLOAT3 then = ToLightClip(first[i], first[i].center);
+				double errors[] =
+				{
+					DistanceToWhole(origin.x * halfResolution), DistanceToWhole(origin.y * halfResolution),
+					DistanceToWhole((now.x - then.x) * halfResolution), DistanceToWhole((now.y - then.y) * halfResolution),
+				};
+				for (double error : errors)
+					misses += error > TEXEL_TOLERANCE;
+			}
+		}
+
+		// The camera moved by some 40 units, over a texel of every cascade
+		for (UINT i = 0; i < shadows.GetCascadeCount(); ++i)
+		{
+			XMFLOAT3 now = ToLightClip(shadows.GetCascade(i), first[i].center);
+			CHECK(fabs(now.x * halfResolution) > 1.0 || fabs(now.y * halfResolution) > 1.0);
+		}
+		printf("Snapping: %u cascades over %u camera steps, %u centers off the texel grid\n",
+			shadows.GetCascadeCount(), steps, misses);
+		CHECK(misses == 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	// Fitting and culling, with the camera turning over the field as the benchmark does
+	//----------------------------------------------------------------------------------
+	void TestCulling()
+	{
+		std::vector<ShadowCaster> casters = CreateCasters(3000, 12345);
+		ShadowCascades shadows;
+		ShadowSettings settings = ShadowSettings::Default();
+		settings.cascadeCount = SHADOW_MAX_CASCADES;
+		shadows.SetSettings(settings);
+		settings = shadows.GetSettings();
+
+		const UINT frames = 24;
+		UINT outside = 0, missing = 0, extra = 0, draws = 0, overlapping = 0;
+		for (UINT frame = 0; frame < frames; ++frame)
+		{
+			float angle = XM_2PI * frame / frames;
+			Camera camera = { XMFLOAT3(20.0f * cosf(angle), 20.0f * sinf(angle), 10.0f),
+				XMFLOAT3(cosf(angle), sinf(angle), -0.3f) };
+			shadows.Update(camera.GetView(), FOV, ASPECT, NEAR_Z, LIGHT_DIRECTION, casters);
+			CHECK(shadows.GetCascade(0).splitNear == NEAR_Z);
+			CHECK_NEAR(shadows.GetCascade(settings.cascadeCount - 1).splitFar, settings.maxDistance, 1e-3);
+
+			UINT drawCount = 0;
+			for (UINT i = 0; i < settings.cascadeCount; ++i)
+			{
+				const ShadowCascade& cascade = shadows.GetCascade(i);
+				CHECK(i == 0 || cascade.splitNear == shadows.GetCascade(i - 1).splitFar);
+				CHECK(cascade.splitNear < cascade.splitFar);
+
+				// The corners of the slice are in the cascade, give or take the half
+				// texel of the snap
+				float texel = 2.0f / settings.resolution;
+				for (int corner = 0; corner < 8; ++corner)
+				{
+					XMFLOAT3 clip = ToLightClip(cascade, camera.GetCorner(corner & 4 ? cascade.splitFar : cascade.splitNear,
+						corner & 1 ? 1.0f : -1.0f, corner & 2 ? 1.0f : -1.0f));
+					outside += fabsf(clip.x) > 1.0f + 0.5f * texel + CLIP_TOLERANCE ||
+						fabsf(clip.y) > 1.0f + 0.5f * texel + CLIP_TOLERANCE ||
+						clip.z < -CLIP_TOLERANCE || clip.z > 1.0f + CLIP_TOLERANCE;
+				}
+
+				// A caster overlaps the cascade's box, open towards the light, when its
+				// sphere reaches into the box's x and y and in front of its far side
+				const std::vector<UINT>& drawList = shadows.GetDrawList(i);
+				std::vector<bool> drawn(casters.size(), false);
+				for (UINT index : drawList)
+					drawn[index] = true;
+				XMFLOAT3 scale = GetClipScale(cascade);
+				for (size_t c = 0; c < casters.size(); ++c)
+				{
+					XMFLOAT3 clip = ToLightClip(cascade, casters[c].center);
+					XMFLOAT3 reach(casters[c].radius * scale.x, casters[c].radius * scale.y, casters[c].radius * scale.z);
+					float x = fabsf(clip.x) - 1.0f - reach.x;
+					float y = fabsf(clip.y) - 1.0f - reach.y;
+					float z = clip.z - reach.z - 1.0f;
+					if (x < -CLIP_TOLERANCE && y < -CLIP_TOLERANCE && z < -CLIP_TOLERANCE)
+					{
+						++overlapping;
+						missing += !drawn[c];
+					}
+
+					// The drawn casters overlap, and their near sides are in the depth range
+					if (drawn[c])
+						extra += x > CLIP_TOLERANCE || y > CLIP_TOLERANCE || z > CLIP_TOLERANCE ||
+							clip.z - reach.z < -CLIP_TOLERANCE;
+				}
+				drawCount += (UINT)drawList.size();
+			}
+			CHECK(shadows.GetStats().drawCount == drawCount);
+			CHECK(shadows.GetStats().casterCount == casters.size());
+			draws += drawCount;
+		}
+
+		printf("Culling: %u frames, %u cascades, %u draws of %u overlapping casters, %u missing, %u extra, %u corners outside\n",
+			frames, settings.cascadeCount, draws, overlapping, missing, extra, outside);
+		CHECK(overlapping > 0 && draws < frames * settings.cascadeCount * casters.size());
+		CHECK(missing == 0);
+		CHECK(extra == 0);
+		CHECK(outside == 0);
+	}
+
+	//----------------------------------------------------------------------------------
+	// Benchmarks
+	//----------------------------------------------------------------------------------
+	void Benchmark()
+	{
+		ShadowBenchmarkResult result = BenchmarkShadowCascades(ShadowSettings::Default(), BENCHMARK_CASTERS, BENCHMARK_FRAMES);
+		printf("BenchmarkShadowCascades: %u frames, %u cascades, %u casters, %.4f ms mean, %.4f ms min, %.4f ms max, "
+			"%.0f draws per frame\n", result.frames, result.cascadeCount, result.casterCount, result.averageMilliseconds,
+			result.minMilliseconds, result.maxMilliseconds, result.averageDrawCount);
+		CHECK(result.frames == BENCHMARK_FRAMES);
+		CHECK(result.cascadeCount == ShadowSettings::Default().cascadeCount);
+		CHECK(result.casterCount == BENCHMARK_CASTERS);
+		CHECK(result.averageDrawCount > 0.0 && result.averageDrawCount < (double)result.cascadeCount * BENCHMARK_CASTERS);
+		CHECK(result.minMilliseconds <= result.averageMilliseconds && result.averageMilliseconds <= result.maxMilliseconds);
+	}
+}
+
+int main()
+{
+	TestSnapping();
+	TestCulling();
+	Benchmark();
+	return CheckResult("TestShadowCascades");
+}
@@ -0,0 +1,391 @@
+//--------------------------------------------------------------------------------------
+// File: TestSoftwareOcclusion.cpp
+//
+// Compares SoftwareOcclusion with brute force on random scenes: the depth buffer with
+// rays cast through every pixel center, and TestBox with a scan of every pixel of the
+// box's bounds.  Then times BenchmarkOcclusion and the scan it replaces.
+//--------------------------------------------------------------------------------------
+#include "DXUT.h"
+#include "SoftwareOcclusion.h"
+#include "Check.h"
+
+using namespace DirectX;
+
+namespace
+{
+	// The camera sits at the origin looking down +z, so the view is the identity and
+	// clip w is view space z
+	const float FOV = XM_PI / 3;
+	const float ASPECT = 16.0f / 9.0f;
+	const float NEAR_Z = 0.1f;
+	const float FAR_Z = 1000.0f;
+
+	struct Box
+	{
+		XMFLOAT3 size;
+		XMFLOAT4X4 world;               // Rotation about y, then translation
+	};
+
+	struct Scene
+	{
+		std::vector<Box> occluders;
+		std::vector<OcclusionMesh> meshes;
+		std::vector<Box> occludees;
+	};
+
+	struct Random
+	{
+		uint32_t seed;
+		float operator()(float low, float high)
+		{
+			seed = seed * 1664525u + 1013904223u;
+			return low + (high - low) * ((seed >> 8) / 16777216.0f);
+		}
+	};
+
+	Box RandomBox(Random& random, float minSize, float maxSize, float minZ, float maxZ)
+	{
+		Box box;
+		box.size = XMFLOAT3(random(minSize, maxSize), random(minSize, maxSize), random(minSize, maxSize));
+		float yaw = random(0.0f, XM_2PI), c = cosf(yaw), s = sinf(yaw);
+		float z = random(minZ, maxZ);
+		XMStoreFloat4x4(&box.world, XMMatrixSet(
+			c, 0.0f, -s, 0.0f,
+			0.0f, 1.0f, 0.0f, 0.0f,
+			s, 0.0f, c, 0.0f,
+			random(-1.3f, 1.3f) * z, random(-0.8f, 0.8f) * z, z, 1.0f));
+		return box;
+	}
+
+	// Occluders in front, some of them through the near plane or off the sides of the
+	// screen, and smaller boxes behind and among them
+	void CreateScene(uint32_t seed, Scene& scene)
+	{
+		Random random = { seed };
+		for (int i = 0; i < 24; ++i)
+			scene.occluders.push_back(RandomBox(random, 0.5f, 4.0f, 4.0f, 30.0f));
+		for (int i = 0; i < 3; ++i)
+		{
+			// Below the eye and to the sides of it
+			Box box = RandomBox(random, 1.0f, 2.0f, -0.5f, 0.5f);
+			box.world._41 = 2.5f * (i - 1);
+			box.world._42 = -2.0f;
+			scene.occluders.push_back(box);
+		}
+		for (int i = 0; i < 400; ++i)
+			scene.occludees.push_back(RandomBox(random, 0.2f, 2.0f, 1.0f, 80.0f));
+
+		scene.meshes.resize(scene.occluders.size());
+		for (size_t i = 0; i < scene.occluders.size(); ++i)
+			CreateOcclusionBox(scene.occluders[i].size, scene.meshes[i]);
+	}
+
+	XMFLOAT4X4 GetViewProjection()
+	{
+		XMFLOAT4X4 viewProjection;
+		XMStoreFloat4x4(&viewProjection, XMMatrixPerspectiveFovLH(FOV, ASPECT, NEAR_Z, FAR_Z));
+		return viewProjection;
+	}
+
+	void RenderScene(SoftwareOcclusion& occlusion, const Scene& scene)
+	{
+		occlusion.BeginFrame(GetViewProjection(), NEAR_Z);
+		for (size_t i = 0; i < scene.occluders.size(); ++i)
+			occlusion.AddOccluder(&scene.meshes[i], scene.occluders[i].world);
+		occlusion.Render();
+	}
+
+	//----------------------------------------------------------------------------------
+	// Ray casting, in double
+	//----------------------------------------------------------------------------------
+	struct Vector
+	{
+		double x, y, z;
+	};
+
+	Vector Subtract(const Vector& a, const Vector& b) { Vector v = { a.x - b.x, a.y - b.y, a.z - b.z }; return v; }
+	Vector Cross(const Vector& a, const Vector& b) { Vector v = { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; return v; }
+	double Dot(const Vector& a, const Vector& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+	Vector ToWorld(const XMFLOAT3& p, const XMFLOAT4X4& world)
+	{
+		Vector v = {
+			(double)p.x * world._11 + (double)p.y * world._21 + (double)p.z * world._31 + world._41,
+			(double)p.x * world._12 + (double)p.y * world._22 + (double)p.z * world._32 + world._42,
+			(double)p.x * world._13 + (double)p.y * world._23 + (double)p.z * world._33 + world._43 };
+		return v;
+	}
+
+	// World space triangles of the box
+	void GetTriangles(const Box& box, std::vector<Vector>& vertices)
+	{
+		OcclusionMesh mesh;
+		CreateOcclusionBox(box.size, mesh);
+		for (size_t i = 0; i < mesh.indices.size(); ++i)
+			vertices.push_back(ToWorld(mesh.positions[mesh.indices[i]], box.world));
+	}
+
+	// The ray from the eye through the pixel center; its z is 1, so a hit's distance
+	// along it is its view space z
+	Vector GetPixelRay(UINT x, UINT y, UINT width, UINT height)
+	{
+		double yScale = 1.0 / tan(0.5 * FOV);
+		Vector ray = {
+			((x + 0.5) / width * 2.0 - 1.0) * ASPECT / yScale,
+			(1.0 - (y + 0.5) / height * 2.0) / yScale,
+			1.0 };
+		return ray;
+	}
+
+	// 1/z of the nearest hit past the near plane, 0 if none
+	double CastRay(const Vector& ray, const std::vector<Vector>& triangles)
+	{
+		double nearest = 0.0;
+		for (size_t i = 0; i + 2 < triangles.size(); i += 3)
+		{
+			Vector e1 = Subtract(triangles[i + 1], triangles[i]);
+			Vector e2 = Subtract(triangles[i + 2], triangles[i]);
+			Vector p = Cross(ray, e2);
+			double determinant = Dot(e1, p);
+			if (fabs(determinant) < 1e-12)
+				continue;
+			Vector o = { -triangles[i].x, -triangles[i].y, -triangles[i].z };
+			double u = Dot(o, p) / determinant;
+			Vector q = Cross(o, e1);
+			double v = Dot(ray, q) / determinant;
+			double z = Dot(e2, q) / determinant;
+			if (u < 0.0 || v < 0.0 || u + v > 1.0 || z < NEAR_Z)
+				continue;
+			nearest = max(nearest, 1.0 / z);
+		}
+		return nearest;
+	}
+
+	//----------------------------------------------------------------------------------
+	// The depth buffer against the rays
+	//----------------------------------------------------------------------------------
+	void TestDepthBuffer(uint32_t seed)
+	{
+		Scene scene;
+		CreateScene(seed, scene);
+		SoftwareOcclusion occlusion;
+		RenderScene(occlusion, scene);
+
+		std::vector<Vector> triangles;
+		for (size_t i = 0; i < scene.occluders.size(); ++i)
+			GetTriangles(scene.occluders[i], triangles);
+
+		// Pixel centers within a rounding error of an edge may go either way, and take
+		// the depth of either triangle
+		UINT width = occlusion.GetWidth(), height = occlusion.GetHeight();
+		const float* depths = occlusion.GetDepths();
+		UINT covered = 0, coverageMismatches = 0, depthMismatches = 0;
+		double worstError = 0.0;
+		for (UINT y = 0; y < height; ++y)
+		{
+			for (UINT x = 0; x < width; ++x)
+			{
+				double expected = CastRay(GetPixelRay(x, y, width, height), triangles);
+				double actual = depths[y * width + x];
+				covered += expected > 0.0;
+				if ((expected > 0.0) != (actual > 0.0))
+					coverageMismatches++;
+				else if (expected > 0.0)
+				{
+					double error = fabs(actual - expected) / expected;
+					worstError = max(worstError, error);
+					depthMismatches += error > 1e-3;
+				}
+			}
+		}
+
+		printf("Depth buffer, scene %u: %u of %u pixels covered, %u coverage and %u depth mismatches, worst relative error of the rest %.2g\n",
+			seed, covered, width * height, coverageMismatches, depthMismatches, worstError);
+		CHECK(covered > width * height / 10);
+		CHECK(coverageMismatches + depthMismatches <= width * height / 2000);
+	}
+
+	//----------------------------------------------------------------------------------
+	// TestBox against a scan of the level 0 pixels
+	//----------------------------------------------------------------------------------
+
+	// What TestBox does before the hierarchy, in the same float operations: the pixels
+	// the box's bounds touch and its nearest 1/w.  False if the box crosses the near plane.
+	bool GetBoxBounds(const SoftwareOcclusion& occlusion, const Box& box, int* x0, int* y0, int* x1, int* y1, float* depth)
+	{
+		XMFLOAT4X4 viewProjection = GetViewProjection();
+		float rows[4][4];
+		for (int r = 0; r < 4; ++r)
+			for (int c = 0; c < 4; ++c)
+				rows[r][c] = (box.world.m[r][0] * viewProjection.m[0][c] + box.world.m[r][1] * viewProjection.m[1][c]) +
+					(box.world.m[r][2] * viewProjection.m[2][c] + box.world.m[r][3] * viewProjection.m[3][c]);
+
+		float width = (float)occlusion.GetWidth(), height = (float)occlusion.GetHeight();
+		float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+		*depth = 0.0f;
+		for (int i = 0; i < 8; ++i)
+		{
+			float p[3] = { 0.5f * ((i & 1) ? box.size.x : -box.size.x), 0.5f * ((i & 2) ? box.size.y : -box.size.y),
+				0.5f * ((i & 4) ? box.size.z : -box.size.z) };
+			float v[4];
+			for (int c = 0; c < 4; ++c)
+				v[c] = (p[0] * rows[0][c] + p[1] * rows[1][c]) + (p[2] * rows[2][c] + rows[3][c]);
+			if (v[3] < NEAR_Z)
+				return false;
+
+			float z = 1.0f / v[3];
+			float x = (v[0] * z * 0.5f + 0.5f) * width;
+			float y = (0.5f - v[1] * z * 0.5f) * height;
+			minX = min(minX, x);
+			maxX = max(maxX, x);
+			minY = min(minY, y);
+			maxY = max(maxY, y);
+			*depth = max(*depth, z);
+		}
+
+		*x0 = max((int)floorf(min(max(minX, -1.0f), width + 1.0f)), 0);
+		*x1 = min((int)floorf(min(max(maxX, -1.0f), width + 1.0f)), (int)width - 1);
+		*y0 = max((int)floorf(min(max(minY, -1.0f), height + 1.0f)), 0);
+		*y1 = min((int)floorf(min(max(maxY, -1.0f), height + 1.0f)), (int)height - 1);
+		return true;
+	}
+
+	// Hidden if every pixel of the bounds has an occluder nearer than the box
+	bool ScanBox(const SoftwareOcclusion& occlusion, const Box& box)
+	{
+		int x0, y0, x1, y1;
+		float depth;
+		if (!GetBoxBounds(occlusion, box, &x0, &y0, &x1, &y1, &depth))
+			return true;
+
+		const float* depths = occlusion.GetDepths();
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				if (!(depth < depths[y * occlusion.GetWidth() + x]))
+					return true;
+			}
+		}
+		return false;
+	}
+
+	// Whether a ray through the bounds hits the box in front of the depth buffer
+	bool IsBoxSeen(const SoftwareOcclusion& occlusion, const Box& box)
+	{
+		int x0, y0, x1, y1;
+		float depth;
+		if (!GetBoxBounds(occlusion, box, &x0, &y0, &x1, &y1, &depth))
+			return true;
+
+		std::vector<Vector> triangles;
+		GetTriangles(box, triangles);
+		const float* depths = occlusion.GetDepths();
+		for (int y = y0; y <= y1; ++y)
+		{
+			for (int x = x0; x <= x1; ++x)
+			{
+				double hit = CastRay(GetPixelRay(x, y, occlusion.GetWidth(), occlusion.GetHeight()), triangles);
+				if (hit > 0.0 && hit >= depths[y * occlusion.GetWidth() + x])
+					return true;
+			}
+		}
+		return false;
+	}
+
+	void TestBoxes(uint32_t seed)
+	{
+		Scene scene;
+		CreateScene(seed, scene);
+		SoftwareOcclusion occlusion;
+		RenderScene(occlusion, scene);
+
+		// The hierarchy only skips pixels: it agrees with the scan on every box.  Neither
+		// hides a box that a ray sees.
+		UINT hidden = 0, unseen = 0, scanMismatches = 0, hiddenSeen = 0;
+		for (size_t i = 0; i < scene.occludees.size(); ++i)
+		{
+			const Box& box = scene.occludees[i];
+			XMFLOAT3 boxMin(-0.5f * box.size.x, -0.5f * box.size.y, -0.5f * box.size.z);
+			XMFLOAT3 boxMax(0.5f * box.size.x, 0.5f * box.size.y, 0.5f * box.size.z);
+			bool visible = occlusion.TestBox(boxMin, boxMax, box.world);
+			bool seen = IsBoxSeen(occlusion, box);
+			hidden += !visible;
+			unseen += !seen;
+			scanMismatches += visible != ScanBox(occlusion, box);
+			hiddenSeen += !visible && seen;
+		}
+
+		const OcclusionStats& stats = occlusion.GetStats();
+		printf("Boxes, scene %u: %u of %zu hidden (%zu off the screen), %u not seen by the rays; %u scan mismatches, %u hidden but seen\n",
+			seed, hidden, scene.occludees.size(), stats.offscreenCount, unseen, scanMismatches, hiddenSeen);
+		CHECK(stats.occludeeTests == scene.occludees.size());
+		CHECK(stats.occludedCount + stats.offscreenCount == hidden);
+		CHECK(scanMismatches == 0);
+		CHECK(hiddenSeen == 0);
+		// The bounds and the nearest corner are conservative, but not by much
+		CHECK(hidden > stats.offscreenCount);
+		CHECK(hidden * 2 >= unseen);
+	}
+
+	//----------------------------------------------------------------------------------
+	// Benchmarks
+	//----------------------------------------------------------------------------------
+	void Benchmark()
+	{
+		OcclusionBenchmarkResult result = BenchmarkOcclusion(200);
+		printf("BenchmarkOcclusion: %zu triangles in %.3f ms (%.0f per ms), %zu boxes in %.3f ms (%.0f per ms), %.0f%% hidden\n",
+			result.occluderTriangles, result.rasterMilliseconds, result.trianglesPerMillisecond, result.occludeeTests,
+			result.testMilliseconds, result.testsPerMillisecond, result.occludedFraction * 100.0f);
+		CHECK(result.frames == 200);
+		CHECK(result.occluderTriangles == 16 * 8 * 12);
+		CHECK(result.occludeeTests == 1024);
+		CHECK(result.occludedFraction > 0.0f && result.occludedFraction < 1.0f);
+
+		// The hierarchy against the scan it replaces, on the random scenes
+		Scene scene;
+		CreateScene(1, scene);
+		SoftwareOcclusion occlusion;
+		RenderScene(occlusion, scene);
+		const int repeats = 50;
+		LARGE_INTEGER frequency, start, middle, end;
+		QueryPerformanceFrequency(&frequency);
+		size_t hidden = 0;
+		QueryPerformanceCounter(&start);
+		for (int r = 0; r < repeats; ++r)
+		{
+			for (size_t i = 0; i < scene.occludees.size(); ++i)
+			{
+				const Box& box = scene.occludees[i];
+				XMFLOAT3 boxMin(-0.5f * box.size.x, -0.5f * box.size.y, -0.5f * box.size.z);
+				XMFLOAT3 boxMax(0.5f * box.size.x, 0.5f * box.size.y, 0.5f * box.size.z);
+				hidden += !occlusion.TestBox(boxMin, boxMax, box.world);
+			}
+		}
+		QueryPerformanceCounter(&middle);
+		for (int r = 0; r < repeats; ++r)
+		{
+			for (size_t i = 0; i < scene.occludees.size(); ++i)
+				hidden -= !ScanBox(occlusion, scene.occludees[i]);
+		}
+		QueryPerformanceCounter(&end);
+
+		double tests = (double)repeats * scene.occludees.size();
+		double hierarchy = (double)(middle.QuadPart - start.QuadPart) / frequency.QuadPart;
+		double scan = (double)(end.QuadPart - middle.QuadPart) / frequency.QuadPart;
+		printf("TestBox: %.0f boxes per ms, the pixel scan %.0f per ms (%.1fx)\n",
+			tests / (hierarchy * 1000.0), tests / (scan * 1000.0), scan / hierarchy);
+		CHECK(hidden == 0);
+	}
+}
+
+int main()
+{
+	for (uint32_t seed = 1; seed <= 8; ++seed)
+	{
+		TestDepthBuffer(seed);
+		TestBoxes(seed);
+	}
+	Benchmark();
+	return CheckResult("TestSoftwareOcclusion");
+}
@@ -0,0 +1,257 @@
+//--------------------------------------------------------------------------------------
+// File: DXUT.h
+//
+// Host-side stand-in for DXUT.h: the Windows types and macros, and the few Direct3D 11
+// declarations that the tested modules use.  The Direct3D interfaces are abstract so the
+// tests can fake them; the methods that only some tests fake fail by default.
+//--------------------------------------------------------------------------------------
+#ifndef DXUT_H
+#define DXUT_H
+
+#include <cassert>
+#include <cfloat>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+
+// As with windows.h, min and max are macros; the standard headers that declare
+// std::min and std::max have to come before them
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <functional>
+#include <new>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+typedef int32_t HRESULT;
+typedef uint32_t UINT;
+typedef uint32_t ULONG;
+typedef uint8_t BYTE;
+typedef uint64_t UINT64;
+typedef int64_t LONGLONG;
+typedef wchar_t WCHAR;
+
+#define S_OK            ((HRESULT)0)
+#define S_FALSE         ((HRESULT)1)
+#define E_FAIL          ((HRESULT)0x80004005)
+#define E_INVALIDARG    ((HRESULT)0x80070057)
+#define E_NOTIMPL       ((HRESULT)0x80004001)
+#define E_OUTOFMEMORY   ((HRESULT)0x8007000E)
+#define SUCCEEDED(hr)   (((HRESULT)(hr)) >= 0)
+#define FAILED(hr)      (((HRESULT)(hr)) < 0)
+#define V_RETURN(x)     { hr = (x); if (FAILED(hr)) { return hr; } }
+
+#ifndef min
+#define min(a,b)        (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a,b)        (((a) > (b)) ? (a) : (b))
+#endif
+
+#define ZeroMemory(p, n) memset((void*)(p), 0, (n))
+#define MoveMemory(d, s, n) memmove((d), (s), (n))
+#define __max(a,b)      (((a) > (b)) ? (a) : (b))
+
+union LARGE_INTEGER
+{
+	LONGLONG QuadPart;
+};
+
+inline int QueryPerformanceFrequency(LARGE_INTEGER* frequency)
+{
+	frequency->QuadPart = 1000000000;
+	return 1;
+}
+
+inline int QueryPerformanceCounter(LARGE_INTEGER* counter)
+{
+	counter->QuadPart = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+	return 1;
+}
+
+// The debug output goes to stdout; the tested modules only write ASCII to it
+inline void OutputDebugString(const WCHAR* text)
+{
+	for (; *text; ++text)
+		putchar(*text < 128 ? (char)*text : '?');
+}
+
+//--------------------------------------------------------------------------------------
+// Direct3D 11
+//--------------------------------------------------------------------------------------
+enum D3D11_QUERY
+{
+	D3D11_QUERY_TIMESTAMP = 2,
+	D3D11_QUERY_TIMESTAMP_DISJOINT = 3,
+};
+
+enum D3D11_ASYNC_GETDATA_FLAG
+{
+	D3D11_ASYNC_GETDATA_DONOTFLUSH = 0x1,
+};
+
+struct D3D11_QUERY_DESC
+{
+	D3D11_QUERY Query;
+	UINT MiscFlags;
+};
+
+struct CD3D11_QUERY_DESC : D3D11_QUERY_DESC
+{
+	explicit CD3D11_QUERY_DESC(D3D11_QUERY query, UINT miscFlags = 0)
+	{
+		Query = query;
+		MiscFlags = miscFlags;
+	}
+};
+
+struct D3D11_QUERY_DATA_TIMESTAMP_DISJOINT
+{
+	UINT64 Frequency;
+	int Disjoint;
+};
+
+enum DXGI_FORMAT
+{
+	DXGI_FORMAT_UNKNOWN = 0,
+	DXGI_FORMAT_R32G32B32A32_FLOAT = 2,
+};
+
+enum D3D11_USAGE
+{
+	D3D11_USAGE_DEFAULT = 0,
+	D3D11_USAGE_DYNAMIC = 2,
+};
+
+enum D3D11_BIND_FLAG
+{
+	D3D11_BIND_INDEX_BUFFER = 0x2,
+	D3D11_BIND_SHADER_RESOURCE = 0x8,
+};
+
+enum D3D11_CPU_ACCESS_FLAG
+{
+	D3D11_CPU_ACCESS_WRITE = 0x10000,
+};
+
+enum D3D11_MAP
+{
+	D3D11_MAP_WRITE_DISCARD = 4,
+};
+
+enum D3D11_SRV_DIMENSION
+{
+	D3D11_SRV_DIMENSION_BUFFER = 1,
+};
+
+struct D3D11_BUFFER_DESC
+{
+	UINT ByteWidth;
+	D3D11_USAGE Usage;
+	UINT BindFlags;
+	UINT CPUAccessFlags;
+	UINT MiscFlags;
+	UINT StructureByteStride;
+};
+
+struct CD3D11_BUFFER_DESC : D3D11_BUFFER_DESC
+{
+	CD3D11_BUFFER_DESC(UINT byteWidth, UINT bindFlags, D3D11_USAGE usage = D3D11_USAGE_DEFAULT,
+		UINT cpuAccessFlags = 0, UINT miscFlags = 0, UINT structureByteStride = 0)
+	{
+		ByteWidth = byteWidth;
+		Usage = usage;
+		BindFlags = bindFlags;
+		CPUAccessFlags = cpuAccessFlags;
+		MiscFlags = miscFlags;
+		StructureByteStride = structureByteStride;
+	}
+};
+
+struct D3D11_SUBRESOURCE_DATA
+{
+	const void* pSysMem;
+	UINT SysMemPitch;
+	UINT SysMemSlicePitch;
+};
+
+struct D3D11_MAPPED_SUBRESOURCE
+{
+	void* pData;
+	UINT RowPitch;
+	UINT DepthPitch;
+};
+
+// Only the buffer views
+struct D3D11_SHADER_RESOURCE_VIEW_DESC
+{
+	DXGI_FORMAT Format;
+	D3D11_SRV_DIMENSION ViewDimension;
+	struct
+	{
+		UINT FirstElement;
+		UINT NumElements;
+	} Buffer;
+};
+
+struct CD3D11_SHADER_RESOURCE_VIEW_DESC : D3D11_SHADER_RESOURCE_VIEW_DESC
+{
+	CD3D11_SHADER_RESOURCE_VIEW_DESC(D3D11_SRV_DIMENSION viewDimension, DXGI_FORMAT format = DXGI_FORMAT_UNKNOWN,
+		UINT firstElement = 0, UINT numElements = 0)
+	{
+		Format = format;
+		ViewDimension = viewDimension;
+		Buffer.FirstElement = firstElement;
+		Buffer.NumElements = numElements;
+	}
+};
+
+struct IUnknown
+{
+	IUnknown() : references(1) {}
+	virtual ~IUnknown() {}
+	ULONG AddRef() { return ++references; }
+	ULONG Release() { ULONG count = --references; if (count == 0) delete this; return count; }
+
+private:
+	ULONG references;
+};
+
+struct ID3D11Asynchronous : IUnknown {};
+struct ID3D11Query : ID3D11Asynchronous {};
+struct ID3D11Resource : IUnknown {};
+struct ID3D11Buffer : ID3D11Resource {};
+struct ID3D11View : IUnknown {};
+struct ID3D11ShaderResourceView : ID3D11View {};
+
+struct ID3D11Device : IUnknown
+{
+	virtual HRESULT CreateQuery(const D3D11_QUERY_DESC* desc, ID3D11Query** query) = 0;
+	virtual HRESULT CreateBuffer(const D3D11_BUFFER_DESC*, const D3D11_SUBRESOURCE_DATA*, ID3D11Buffer**) { return E_NOTIMPL; }
+	virtual HRESULT CreateShaderResourceView(ID3D11Resource*, const D3D11_SHADER_RESOURCE_VIEW_DESC*, ID3D11ShaderResourceView**)
+	{
+		return E_NOTIMPL;
+	}
+};
+
+struct ID3D11DeviceContext : IUnknown
+{
+	virtual void Begin(ID3D11Asynchronous* async) = 0;
+	virtual void End(ID3D11Asynchronous* async) = 0;
+	virtual HRESULT GetData(ID3D11Asynchronous* async, void* data, UINT dataSize, UINT flags) = 0;
+	virtual HRESULT Map(ID3D11Resource*, UINT, D3D11_MAP, UINT, D3D11_MAPPED_SUBRESOURCE*) { return E_NOTIMPL; }
+	virtual void Unmap(ID3D11Resource*, UINT) {}
+};
+
+inline void DXUT_SetDebugName(IUnknown*, const char*) {}
+
+#endif
@@ -0,0 +1,408 @@
+//--------------------------------------------------------------------------------------
+// File: DirectXMath.h
+//
+// Host-side stand-in for DirectXMath: the storage types, and in plain scalar code the
+// vector and matrix functions that the tested modules call.  The matrices are
+// row-vector, left handed, as in the library.
+//--------------------------------------------------------------------------------------
+#ifndef DIRECTX_MATH_H
+#define DIRECTX_MATH_H
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+
+namespace DirectX
+{
+	const float XM_PI = 3.141592654f;
+	const float XM_2PI = 6.283185307f;
+	const float XM_PIDIV2 = 1.570796327f;
+	const float XM_PIDIV4 = 0.785398163f;
+
+	struct XMFLOAT2
+	{
+		float x, y;
+		XMFLOAT2() {}
+		XMFLOAT2(float x, float y) : x(x), y(y) {}
+	};
+
+	struct XMFLOAT3
+	{
+		float x, y, z;
+		XMFLOAT3() {}
+		XMFLOAT3(float x, float y, float z) : x(x), y(y), z(z) {}
+	};
+
+	struct XMFLOAT4
+	{
+		float x, y, z, w;
+		XMFLOAT4() {}
+		XMFLOAT4(float x, float y, float z, float w) : x(x), y(y), z(z), w(w) {}
+	};
+
+	struct XMFLOAT4X4
+	{
+		union
+		{
+			struct
+			{
+				float _11, _12, _13, _14;
+				float _21, _22, _23, _24;
+				float _31, _32, _33, _34;
+				float _41, _42, _43, _44;
+			};
+			float m[4][4];
+		};
+	};
+
+	struct XMUINT4
+	{
+		uint32_t x, y, z, w;
+	};
+
+	struct XMVECTOR
+	{
+		float v[4];
+	};
+
+	struct XMMATRIX
+	{
+		XMVECTOR r[4];
+		XMMATRIX() {}
+		XMMATRIX(const XMVECTOR& r0, const XMVECTOR& r1, const XMVECTOR& r2, const XMVECTOR& r3)
+		{
+			r[0] = r0; r[1] = r1; r[2] = r2; r[3] = r3;
+		}
+	};
+
+	struct XMVECTORF32
+	{
+		union
+		{
+			float f[4];
+			XMVECTOR v;
+		};
+		operator XMVECTOR() const { return v; }
+	};
+
+	struct XMVECTORU32
+	{
+		union
+		{
+			uint32_t u[4];
+			XMVECTOR v;
+		};
+		operator XMVECTOR() const { return v; }
+	};
+
+	const XMVECTORF32 g_XMOne = { { 1.0f, 1.0f, 1.0f, 1.0f } };
+	const XMVECTORF32 g_XMOneHalf = { { 0.5f, 0.5f, 0.5f, 0.5f } };
+	const XMVECTORU32 g_XMSelect0001 = { { 0, 0, 0, 0xFFFFFFFF } };
+
+	//----------------------------------------------------------------------------------
+	// Vectors
+	//----------------------------------------------------------------------------------
+	inline XMVECTOR XMVectorSet(float x, float y, float z, float w)
+	{
+		XMVECTOR result = { { x, y, z, w } };
+		return result;
+	}
+
+	inline XMVECTOR XMVectorReplicate(float value)
+	{
+		return XMVectorSet(value, value, value, value);
+	}
+
+	inline XMVECTOR XMVectorZero() { return XMVectorReplicate(0.0f); }
+
+	inline float XMVectorGetX(const XMVECTOR& v) { return v.v[0]; }
+	inline float XMVectorGetY(const XMVECTOR& v) { return v.v[1]; }
+	inline float XMVectorGetZ(const XMVECTOR& v) { return v.v[2]; }
+	inline XMVECTOR XMVectorSplatX(const XMVECTOR& v) { return XMVectorReplicate(v.v[0]); }
+	inline XMVECTOR XMVectorSplatY(const XMVECTOR& v) { return XMVectorReplicate(v.v[1]); }
+	inline XMVECTOR XMVectorSplatZ(const XMVECTOR& v) { return XMVectorReplicate(v.v[2]); }
+	inline XMVECTOR XMVectorSplatW(const XMVECTOR& v) { return XMVectorReplicate(v.v[3]); }
+
+	template<uint32_t X, uint32_t Y, uint32_t Z, uint32_t W> XMVECTOR XMVectorSwizzle(const XMVECTOR& v)
+	{
+		return XMVectorSet(v.v[X], v.v[Y], v.v[Z], v.v[W]);
+	}
+
+	inline XMVECTOR XMLoadFloat3(const XMFLOAT3* source)
+	{
+		return XMVectorSet(source->x, source->y, source->z, 0.0f);
+	}
+
+	inline XMVECTOR XMLoadFloat4(const XMFLOAT4* source)
+	{
+		return XMVectorSet(source->x, source->y, source->z, source->w);
+	}
+
+	inline void XMStoreFloat2(XMFLOAT2* destination, const XMVECTOR& v)
+	{
+		destination->x = v.v[0];
+		destination->y = v.v[1];
+	}
+
+	inline void XMStoreFloat3(XMFLOAT3* destination, const XMVECTOR& v)
+	{
+		*destination = XMFLOAT3(v.v[0], v.v[1], v.v[2]);
+	}
+
+	inline void XMStoreFloat4(XMFLOAT4* destination, const XMVECTOR& v)
+	{
+		*destination = XMFLOAT4(v.v[0], v.v[1], v.v[2], v.v[3]);
+	}
+
+	inline void XMStoreUInt4(XMUINT4* destination, const XMVECTOR& v)
+	{
+		memcpy(destination, v.v, sizeof(v.v));
+	}
+
+	inline XMVECTOR operator+(const XMVECTOR& a, const XMVECTOR& b)
+	{
+		return XMVectorSet(a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3]);
+	}
+
+	inline XMVECTOR operator-(const XMVECTOR& a, const XMVECTOR& b)
+	{
+		return XMVectorSet(a.v[0] - b.v[0], a.v[1] - b.v[1], a.v[2] - b.v[2], a.v[3] - b.v[3]);
+	}
+
+	inline XMVECTOR operator*(const XMVECTOR& a, const XMVECTOR& b)
+	{
+		return XMVectorSet(a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3]);
+	}
+
+	inline XMVECTOR operator/(const XMVECTOR& a, const XMVECTOR& b)
+	{
+		return XMVectorSet(a.v[0] / b.v[0], a.v[1] / b.v[1], a.v[2] / b.v[2], a.v[3] / b.v[3]);
+	}
+
+	inline XMVECTOR operator*(const XMVECTOR& a, float s) { return a * XMVectorReplicate(s); }
+	inline XMVECTOR operator-(const XMVECTOR& v) { return XMVectorSet(-v.v[0], -v.v[1], -v.v[2], -v.v[3]); }
+	inline XMVECTOR& operator*=(XMVECTOR& a, const XMVECTOR& b) { a = a * b; return a; }
+
+	inline XMVECTOR XMVectorMultiplyAdd(const XMVECTOR& a, const XMVECTOR& b, const XMVECTOR& c)
+	{
+		return a * b + c;
+	}
+
+	inline XMVECTOR XMVectorSqrt(const XMVECTOR& v)
+	{
+		return XMVectorSet(sqrtf(v.v[0]), sqrtf(v.v[1]), sqrtf(v.v[2]), sqrtf(v.v[3]));
+	}
+
+	// Comparisons give all bits set or clear per component, as in the library
+	inline XMVECTOR XMVectorGreater(const XMVECTOR& a, const XMVECTOR& b)
+	{
+		XMVECTORU32 result = { { a.v[0] > b.v[0] ? 0xFFFFFFFFu : 0u, a.v[1] > b.v[1] ? 0xFFFFFFFFu : 0u,
+			a.v[2] > b.v[2] ? 0xFFFFFFFFu : 0u, a.v[3] > b.v[3] ? 0xFFFFFFFFu : 0u } };
+		return result;
+	}
+
+	inline XMVECTOR XMVectorAndInt(const XMVECTOR& a, const XMVECTOR& b)
+	{
+		uint32_t ua[4], ub[4];
+		memcpy(ua, a.v, sizeof(ua));
+		memcpy(ub, b.v, sizeof(ub));
+		XMVECTORU32 result = { { ua[0] & ub[0], ua[1] & ub[1], ua[2] & ub[2], ua[3] & ub[3] } };
+		return result;
+	}
+
+	// The bits of b where control is set, of a elsewhere
+	inline XMVECTOR XMVectorSelect(const XMVECTOR& a, const XMVECTOR& b, const XMVECTOR& control)
+	{
+		uint32_t ua[4], ub[4], uc[4];
+		memcpy(ua, a.v, sizeof(ua));
+		memcpy(ub, b.v, sizeof(ub));
+		memcpy(uc, control.v, sizeof(uc));
+		XMVECTORU32 result;
+		for (int i = 0; i < 4; ++i)
+			result.u[i] = (ua[i] & ~uc[i]) | (ub[i] & uc[i]);
+		return result;
+	}
+
+	inline XMVECTOR XMVector3Length(const XMVECTOR& v)
+	{
+		return XMVectorReplicate(sqrtf(v.v[0] * v.v[0] + v.v[1] * v.v[1] + v.v[2] * v.v[2]));
+	}
+
+	// Row vector times matrix, w = 1
+	inline XMVECTOR XMVector3Transform(const XMVECTOR& v, const XMMATRIX& m)
+	{
+		XMVECTOR result;
+		for (int j = 0; j < 4; ++j)
+			result.v[j] = v.v[0] * m.r[0].v[j] + v.v[1] * m.r[1].v[j] + v.v[2] * m.r[2].v[j] + m.r[3].v[j];
+		return result;
+	}
+
+	inline XMVECTOR XMVector3Normalize(const XMVECTOR& v)
+	{
+		float length = XMVectorGetX(XMVector3Length(v));
+		return length > 0.0f ? v * (1.0f / length) : v;
+	}
+
+	// Row vector times matrix, w = 1, divided by the resulting w
+	inline XMVECTOR XMVector3TransformCoord(const XMVECTOR& v, const XMMATRIX& m)
+	{
+		XMVECTOR result = XMVector3Transform(v, m);
+		return result * (1.0f / result.v[3]);
+	}
+
+	// Row vector times matrix, w = 0
+	inline XMVECTOR XMVector3TransformNormal(const XMVECTOR& v, const XMMATRIX& m)
+	{
+		XMVECTOR result;
+		for (int j = 0; j < 4; ++j)
+			result.v[j] = v.v[0] * m.r[0].v[j] + v.v[1] * m.r[1].v[j] + v.v[2] * m.r[2].v[j];
+		return result;
+	}
+
+	//----------------------------------------------------------------------------------
+	// Matrices
+	//----------------------------------------------------------------------------------
+	inline XMMATRIX XMLoadFloat4x4(const XMFLOAT4X4* source)
+	{
+		XMMATRIX result;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				result.r[i].v[j] = source->m[i][j];
+		return result;
+	}
+
+	inline void XMStoreFloat4x4(XMFLOAT4X4* destination, const XMMATRIX& m)
+	{
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				destination->m[i][j] = m.r[i].v[j];
+	}
+
+	inline XMMATRIX operator*(const XMMATRIX& a, const XMMATRIX& b)
+	{
+		XMMATRIX result;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				result.r[i].v[j] = a.r[i].v[0] * b.r[0].v[j] + a.r[i].v[1] * b.r[1].v[j] +
+					a.r[i].v[2] * b.r[2].v[j] + a.r[i].v[3] * b.r[3].v[j];
+		return result;
+	}
+
+	inline XMMATRIX XMMatrixSet(float m00, float m01, float m02, float m03, float m10, float m11, float m12, float m13,
+		float m20, float m21, float m22, float m23, float m30, float m31, float m32, float m33)
+	{
+		return XMMATRIX(XMVectorSet(m00, m01, m02, m03), XMVectorSet(m10, m11, m12, m13),
+			XMVectorSet(m20, m21, m22, m23), XMVectorSet(m30, m31, m32, m33));
+	}
+
+	inline XMMATRIX XMMatrixIdentity()
+	{
+		return XMMatrixSet(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixTranspose(const XMMATRIX& m)
+	{
+		XMMATRIX result;
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+				result.r[i].v[j] = m.r[j].v[i];
+		return result;
+	}
+
+	// Gauss-Jordan elimination with partial pivoting; the determinant isn't computed
+	inline XMMATRIX XMMatrixInverse(XMVECTOR* determinant, const XMMATRIX& m)
+	{
+		float a[4][8];
+		for (int i = 0; i < 4; ++i)
+			for (int j = 0; j < 4; ++j)
+			{
+				a[i][j] = m.r[i].v[j];
+				a[i][j + 4] = i == j ? 1.0f : 0.0f;
+			}
+
+		for (int column = 0; column < 4; ++column)
+		{
+			int pivot = column;
+			for (int i = column + 1; i < 4; ++i)
+				if (fabsf(a[i][column]) > fabsf(a[pivot][column]))
+					pivot = i;
+			for (int j = 0; j < 8; ++j)
+				std::swap(a[column][j], a[pivot][j]);
+
+			float scale = 1.0f / a[column][column];
+			for (int j = 0; j < 8; ++j)
+				a[column][j] *= scale;
+			for (int i = 0; i < 4; ++i)
+			{
+				if (i == column)
+					continue;
+				float factor = a[i][column];
+				for (int j = 0; j < 8; ++j)
+					a[i][j] -= factor * a[column][j];
+			}
+		}
+
+		if (determinant)
+			*determinant = XMVectorZero();
+		return XMMatrixSet(a[0][4], a[0][5], a[0][6], a[0][7], a[1][4], a[1][5], a[1][6], a[1][7],
+			a[2][4], a[2][5], a[2][6], a[2][7], a[3][4], a[3][5], a[3][6], a[3][7]);
+	}
+
+	inline XMMATRIX XMMatrixTranslation(float x, float y, float z)
+	{
+		return XMMatrixSet(1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f, 0.0f, x, y, z, 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixLookToLH(XMVECTOR eye, XMVECTOR direction, XMVECTOR up)
+	{
+		// The rows of the rotation are the camera's axes: z along direction, x = up x z
+		float z[3] = { direction.v[0], direction.v[1], direction.v[2] };
+		float length = sqrtf(z[0] * z[0] + z[1] * z[1] + z[2] * z[2]);
+		for (int i = 0; i < 3; ++i)
+			z[i] /= length;
+		float x[3] = { up.v[1] * z[2] - up.v[2] * z[1], up.v[2] * z[0] - up.v[0] * z[2], up.v[0] * z[1] - up.v[1] * z[0] };
+		length = sqrtf(x[0] * x[0] + x[1] * x[1] + x[2] * x[2]);
+		for (int i = 0; i < 3; ++i)
+			x[i] /= length;
+		float y[3] = { z[1] * x[2] - z[2] * x[1], z[2] * x[0] - z[0] * x[2], z[0] * x[1] - z[1] * x[0] };
+
+		const float* e = eye.v;
+		return XMMatrixSet(
+			x[0], y[0], z[0], 0.0f,
+			x[1], y[1], z[1], 0.0f,
+			x[2], y[2], z[2], 0.0f,
+			-(x[0] * e[0] + x[1] * e[1] + x[2] * e[2]), -(y[0] * e[0] + y[1] * e[1] + y[2] * e[2]),
+			-(z[0] * e[0] + z[1] * e[1] + z[2] * e[2]), 1.0f);
+	}
+
+	inline XMMATRIX XMMatrixLookAtLH(XMVECTOR eye, XMVECTOR focus, XMVECTOR up)
+	{
+		return XMMatrixLookToLH(eye, XMVectorSet(focus.v[0] - eye.v[0], focus.v[1] - eye.v[1], focus.v[2] - eye.v[2], 0.0f), up);
+	}
+
+	inline XMMATRIX XMMatrixPerspectiveFovLH(float fovY, float aspect, float zNear, float zFar)
+	{
+		float yScale = 1.0f / tanf(0.5f * fovY);
+		float range = zFar / (zFar - zNear);
+		return XMMatrixSet(
+			yScale / aspect, 0.0f, 0.0f, 0.0f,
+			0.0f, yScale, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 1.0f,
+			0.0f, 0.0f, -range * zNear, 0.0f);
+	}
+
+	inline XMMATRIX XMMatrixOrthographicOffCenterLH(float left, float right, float bottom, float top, float zNear, float zFar)
+	{
+		float width = 1.0f / (right - left);
+		float height = 1.0f / (top - bottom);
+		float range = 1.0f / (zFar - zNear);
+		return XMMatrixSet(
+			2.0f * width, 0.0f, 0.0f, 0.0f,
+			0.0f, 2.0f * height, 0.0f, 0.0f,
+			0.0f, 0.0f, range, 0.0f,
+			-(left + right) * width, -(top + bottom) * height, -range * zNear, 1.0f);
+	}
+}
+
+#endif
@@ -0,0 +1,37 @@
+//--------------------------------------------------------------------------------------
+// File: ppl.h
+//
+// Host-side stand-in for concurrency::parallel_for: the indices are handed out one at
+// a time to a thread per core.
+//--------------------------------------------------------------------------------------
+#ifndef PPL_H
+#define PPL_H
+
+namespace concurrency
+{
+	template<typename Index, typename Function>
+	void parallel_for(Index first, Index last, const Function& function)
+	{
+		if (first >= last)
+			return;
+
+		std::atomic<Index> next(first);
+		auto work = [&]()
+		{
+			for (Index i = next++; i < last; i = next++)
+				function(i);
+		};
+
+		unsigned threadCount = std::thread::hardware_concurrency();
+		if ((Index)(last - first) < (Index)threadCount)
+			threadCount = (unsigned)(last - first);
+		std::vector<std::thread> threads;
+		for (unsigned t = 1; t < threadCount; ++t)
+			threads.push_back(std::thread(work));
+		work();
+		for (size_t t = 0; t < threads.size(); ++t)
+			threads[t].join();
+	}
+}
+
+#endif
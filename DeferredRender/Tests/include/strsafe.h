@@ -0,0 +1,94 @@
+//--------------------------------------------------------------------------------------
+// File: strsafe.h
+//
+// Host-side stand-in for the wide StringCch functions.  The formats are the Windows
+// ones, where %s and %c in a wide format are wide and %Iu is a size_t; they are turned
+// into the standard %ls, %lc and %zu before vswprintf sees them.
+//--------------------------------------------------------------------------------------
+#ifndef STRSAFE_H
+#define STRSAFE_H
+
+#include <cstdarg>
+#include <cwchar>
+#include <string>
+
+#define STRSAFE_E_INSUFFICIENT_BUFFER   ((HRESULT)0x8007007A)
+
+inline std::wstring StringCchStandardFormat(const WCHAR* format)
+{
+	std::wstring result;
+	while (*format)
+	{
+		result += *format;
+		if (*format++ != L'%')
+			continue;
+		if (*format == L'%')
+		{
+			result += *format++;
+			continue;
+		}
+		while (*format && wcschr(L"-+ #0123456789.*", *format))
+			result += *format++;
+		if (*format == L'I')
+		{
+			result += L'z';
+			format++;
+		}
+		else if (*format == L's' || *format == L'c')
+			result += L'l';
+	}
+	return result;
+}
+
+inline HRESULT StringCchVPrintf(WCHAR* destination, size_t size, const WCHAR* format, va_list args)
+{
+	if (size == 0)
+		return E_INVALIDARG;
+	if (vswprintf(destination, size, StringCchStandardFormat(format).c_str(), args) < 0)
+	{
+		destination[size - 1] = L'\0';
+		return STRSAFE_E_INSUFFICIENT_BUFFER;
+	}
+	return S_OK;
+}
+
+inline HRESULT StringCchPrintf(WCHAR* destination, size_t size, const WCHAR* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	HRESULT hr = StringCchVPrintf(destination, size, format, args);
+	va_end(args);
+	return hr;
+}
+
+inline HRESULT StringCchLength(const WCHAR* text, size_t size, size_t* length)
+{
+	size_t count = 0;
+	while (count < size && text[count])
+		count++;
+	if (length)
+		*length = count < size ? count : 0;
+	return count < size ? S_OK : E_INVALIDARG;
+}
+
+inline HRESULT StringCchCopy(WCHAR* destination, size_t size, const WCHAR* source)
+{
+	if (size == 0)
+		return E_INVALIDARG;
+	size_t i = 0;
+	for (; i + 1 < size && source[i]; ++i)
+		destination[i] = source[i];
+	destination[i] = L'\0';
+	return source[i] ? STRSAFE_E_INSUFFICIENT_BUFFER : S_OK;
+}
+
+inline HRESULT StringCchCat(WCHAR* destination, size_t size, const WCHAR* source)
+{
+	size_t length;
+	HRESULT hr = StringCchLength(destination, size, &length);
+	if (FAILED(hr))
+		return hr;
+	return StringCchCopy(destination + length, size - length, source);
+}
+
+#endif
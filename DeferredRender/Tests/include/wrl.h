@@ -0,0 +1,40 @@
+//--------------------------------------------------------------------------------------
+// File: wrl.h
+//
+// Host-side stand-in for the part of Microsoft::WRL::ComPtr that the tested modules use
+//--------------------------------------------------------------------------------------
+#ifndef WRL_H
+#define WRL_H
+
+namespace Microsoft
+{
+	namespace WRL
+	{
+		template<typename T> class ComPtr
+		{
+		public:
+			ComPtr() : pointer(nullptr) {}
+			ComPtr(const ComPtr& other) : pointer(other.pointer) { if (pointer) pointer->AddRef(); }
+			~ComPtr() { Reset(); }
+			ComPtr& operator=(const ComPtr& other)
+			{
+				if (other.pointer)
+					other.pointer->AddRef();
+				Reset();
+				pointer = other.pointer;
+				return *this;
+			}
+
+			T* Get() const { return pointer; }
+			T* operator->() const { return pointer; }
+			explicit operator bool() const { return pointer != nullptr; }
+			T** ReleaseAndGetAddressOf() { Reset(); return &pointer; }
+			void Reset() { if (pointer) pointer->Release(); pointer = nullptr; }
+
+		private:
+			T* pointer;
+		};
+	}
+}
+
+#endif
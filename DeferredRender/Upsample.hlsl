@@ -0,0 +1,9 @@
+#include "shader\\inc\\shader_include.hlsl"
+
+#include "shader\\src\\vs\\FullScreenQuad.hlsl"
+
+Texture2D lightTexture : register( t0 );
+
+SamplerState linearSampler : register( s0 );
+
+#include "shader\\src\\ps\\Upsample.hlsl"
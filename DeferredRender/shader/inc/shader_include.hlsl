@@ -23,6 +23,17 @@ struct PosNormalTangetColorTex2d
     float2 tex      : TEXCOORD0;
 };
 
+struct PosNormalTangetColorTex2dSkinned
+{
+    float3 pos      : SV_Position;
+    float3 normal   : NORMAL;
+    float4 tangent  : TANGENT; 
+    float4 color    : COLOR0;
+    float2 tex      : TEXCOORD0;
+    uint4  bones    : BLENDINDICES;
+    float4 weights  : BLENDWEIGHT;
+};
+
 struct ExpandPosNormalTangetColorTex2d
 {
     float3 normal   : NORMAL;
@@ -62,13 +73,12 @@ struct ClipPosColor
     float4 clip_pos       : SV_POSITION; // Output position
 };
 
-struct ThreeTargets
+// The lighting pass takes the position from the depth buffer
+struct GBufferTargets
 {
-    float4 target0: SV_Target0;
+    float4 normal: SV_Target0;                  // View space
 
-    float4 target1: SV_Target1;
-
-    float4 target2: SV_Target2;
+    float4 color: SV_Target1;
 };
 
 //--------------------------------------------------------------------------------------
@@ -94,4 +104,21 @@ cbuffer cbMain : register( b0 )
     float4 g_vDebugColorAdd;                    // Debug colors
     
     float4 g_vFrustumPlaneEquation[4];          // View frustum plane equations
-};
\ No newline at end of file
+
+    float4 g_vGBufferUVScale;                   // Viewport size / G-buffer allocation size, largest UV inside the viewport
+};
+
+// View space z of a depth buffer value, for the standard and the reversed-Z projection
+float ViewDepth( float depth )
+{
+    return g_mProjection._43 / ( depth - g_mProjection._33 );
+}
+
+// Depth buffer value of the texel under uv.  Depth is loaded, not filtered: blending the
+// depths across a silhouette would put the position between the two surfaces.
+float LoadDepth( Texture2D depthTexture, float2 uv )
+{
+    uint width, height;
+    depthTexture.GetDimensions( width, height );
+    return depthTexture.Load( int3( uv * float2( width, height ), 0 ) ).x;
+}
\ No newline at end of file
@@ -1,22 +1,74 @@
-ThreeTargets PS( in float3 pos: TEXCOORD0, in float3 normal: TEXCOORD1, in float3 tangent: TEXCOORD2, in float3 bitangent: TEXCOORD3, in float2 tex: TEXCOORD4  )
+#if RELAXED_CONE_STEP_MAPPING==1
+//--------------------------------------------------------------------------------------
+// Relaxed cone stepping, as in POM.hlsl: the ray jumps from cone to cone of
+// coneStepTexture, then a binary search on the heights in the alpha of normalTexture
+// finds where it crosses the surface.  Returns the depth along the parallax offset.
+//--------------------------------------------------------------------------------------
+float RelaxedConeStepDepth( float2 texCoord, float2 parallaxOffset, float2 dx, float2 dy )
+{
+   float2 coneMapSize;
+   coneStepTexture.GetDimensions( coneMapSize.x, coneMapSize.y );
+
+   float distanceFactor = length( parallaxOffset );
+   float depth = 0.0;
+
+   for ( int stepIndex = 0; stepIndex < CONE_STEPS; stepIndex++ )
+   {
+      float2 cone = coneStepTexture.Load( int3( frac( texCoord - parallaxOffset * depth ) * coneMapSize, 0 ) ).xy;
+      float coneRatio = cone.y * cone.y;
+      float above = saturate( cone.x - depth );
+      if ( above <= 0.0 )
+         break;
+
+      depth += coneRatio * above / ( distanceFactor + coneRatio );
+   }
+
+   depth = min( depth + 2.0 / ( distanceFactor * max( coneMapSize.x, coneMapSize.y ) + 1e-6 ), 1.0 );
+   float range = 0.5 * depth;
+   float position = range;
+
+   for ( int searchIndex = 0; searchIndex < BINARY_SEARCH_STEPS; searchIndex++ )
+   {
+      float surface = 1.0 - normalTexture.SampleGrad( linearSampler, texCoord - parallaxOffset * position, dx, dy ).a;
+      range *= 0.5;
+      position += ( position < surface ) ? range : -range;
+   }
+
+   return position;
+}
+#endif
+
+GBufferTargets PS( in float3 pos: TEXCOORD0, in float3 normal: TEXCOORD1, in float3 tangent: TEXCOORD2, in float3 bitangent: TEXCOORD3, in float2 tex: TEXCOORD4  )
 { 
-   ThreeTargets output;
+   GBufferTargets output;
 
+   float3 n = normalize(normal);
    float3 t = normalize(tangent);
    float3 b = normalize(bitangent);
-   float3 n = normalize(normal);
 
-   output.target0 = float4( pos.xyz, 1.0 );
+#if RELAXED_CONE_STEP_MAPPING==1
+   // pos is in view space, so the ray to the eye is -pos; in tangent space its slope
+   // gives the texture offset of the bottom of the height field
+   float3 view = float3( dot(-pos, t), dot(-pos, b), dot(-pos, n) );
+   float2 parallaxOffset = view.xy / max(view.z, 1e-3 * length(view)) * parallaxScale.x;
+   tex -= parallaxOffset * RelaxedConeStepDepth( tex, parallaxOffset, ddx(tex), ddy(tex) );
+#endif
 
+#if NORMAL_MAPPING==1
    float3 N = 2*normalTexture.Sample( linearSampler, tex.xy) - float3(1, 1, 1);
    
-   // output.target1 = float4( 0.5*n + float3(0.5, 0.5, 0.5), 1.0 );
-
-   // output.target1 = float4( n, 1.0 );
+   // output.normal = float4( 0.5*n + float3(0.5, 0.5, 0.5), 1.0 );
 
-   output.target1 = float4( N.x*t + N.y*b + N.z*n, 1.0 );
+   output.normal = float4( N.x*t + N.y*b + N.z*n, 1.0 );
+#else
+   output.normal = float4( n, 1.0 );
+#endif
 
-   output.target2 = colorTexture.Sample( linearSampler, tex.xy);
+#if LIGHTING_ONLY==1
+   output.color = float4( 1.0, 1.0, 1.0, 1.0 );
+#else
+   output.color = colorTexture.Sample( linearSampler, tex.xy);
+#endif
 
    return output;
 }
\ No newline at end of file
@@ -0,0 +1,49 @@
+// Lit fraction of the view space position p, of normal n: 3x3 filtered compares in the
+// first cascade that reaches z, lit beyond the last one
+float Shadow( float3 p, float3 n, float z )
+{
+   uint count = (uint)g_vLightDirection.w;
+   uint cascade = 0;
+   [unroll]
+   for( uint i = 0; i < SHADOW_MAX_CASCADES - 1; ++i )
+      cascade += ( i + 1 < count && z > g_vCascade[i].x ) ? 1 : 0;
+
+   if( z > g_vCascade[cascade].x )
+      return 1.0;
+
+   float4 s = mul( float4( p + n * g_vCascade[cascade].y, 1.0 ), g_mShadow[cascade] );
+   float  d = s.z - g_vCascade[cascade].z;
+   float  texel = g_vLightColor.w;
+
+   float lit = 0.0;
+   [unroll]
+   for( int y = -1; y <= 1; ++y )
+      [unroll]
+      for( int x = -1; x <= 1; ++x )
+         lit += shadowMap.SampleCmpLevelZero( shadowSampler, float3( s.xy + float2( x, y ) * texel, cascade ), d );
+
+   return lit / 9.0;
+}
+
+float4 DIRECTIONAL_PS(in float2 tex : TEXCOORD0):SV_TARGET
+{ 
+   float2  ndc = float2(2*tex.x,-2*tex.y) + float2(-1,1);
+   float2  uv  = tex * g_vGBufferUVScale.xy;
+
+   float     z = ViewDepth( LoadDepth( depthTexture, uv ) );
+   float     e = g_vScreenResolution.z;
+   float     a = g_vScreenResolution.w;
+
+   float3    p  = z * float3(ndc.x*(a/e), ndc.y*(1/e), 1);
+   float3    n  = normalTexture.Sample( linearSampler, uv).xyz;
+   float3    c  = colorTexture.Sample( linearSampler, uv).xyz;
+
+   if(length(n)==.0)
+     discard;
+
+   float  ndotl = dot( n, g_vLightDirection.xyz );
+   if( ndotl <= 0.0 )
+     discard;
+
+   return float4( g_vLightColor.rgb * c * ndotl * Shadow( p, n, z ), 1.0 );
+}
@@ -7,21 +7,42 @@ float	atten ( float d )								// compute distance attenuation factor, 0 -> 1, M
 	return scale * ( 1.0 / (1.0 + d) - offs1 );
 }
 
+// Lit fraction of the view space position p, of normal n: one filtered compare in the
+// atlas tile of the cube face around lightPos that it falls in
+float PointShadow ( float3 p, float3 n, float3 lightPos )
+{
+   if ( g_vPointShadowParams.z == 0.0 )
+     return 1.0;
+
+   float3  q = p + n * ( g_vPointShadowParams.x * length( p - lightPos ) );
+   float3  w = mul( (float3x3)g_mView, q - lightPos );   // From the light, world space: the view's rotation transposed
+   float3  a = abs( w );
+   uint face = ( a.x >= a.y && a.x >= a.z ) ? ( w.x < 0 ? 1 : 0 ) :
+               ( a.y >= a.z )               ? ( w.y < 0 ? 3 : 2 ) :
+                                              ( w.z < 0 ? 5 : 4 );
+
+   float4  s = mul( float4( q, 1.0 ), g_mPointShadow[face] );
+   float2 uv = clamp( s.xy / s.w, g_vPointShadowTile[face].xy, g_vPointShadowTile[face].zw );
+
+   return pointShadowAtlas.SampleCmpLevelZero( shadowSampler, float3( uv, 0 ), s.z / s.w - g_vPointShadowParams.y );
+}
+
 float4 PS(in float2 tex : TEXCOORD0):SV_TARGET
 { 
    float3 lightPos = mul( float4( 2, 3, 0.5, 1.0 ), g_mView ).xyz;
    //float3    lightPos = float3(0.707106829, -1.00000000, 4.24264050); //0.0, 0.0, 0.0);//0.707106829, -1.00000000, 4.24264050
 
    float2  ndc = float2(2*tex.x,-2*tex.y) + float2(-1,1);
+   float2  uv  = tex * g_vGBufferUVScale.xy;
 
-   float     z = positionTexture.Sample( linearSampler, tex.xy).z;
+   float     z = ViewDepth( LoadDepth( depthTexture, uv ) );
    float     e = g_vScreenResolution.z;
    float     a = g_vScreenResolution.w;
 
    float3    p  = z * float3(ndc.x*(a/e), ndc.y*(1/e), 1);
-   float3    n  = normalTexture.Sample( linearSampler, tex.xy).xyz;//float3(0,-1,0);//
+   float3    n  = normalTexture.Sample( linearSampler, uv).xyz;//float3(0,-1,0);//
    //n = mul( float4( n, 0.0 ), g_mView ).xyz;
-   float3    c  = colorTexture.Sample( linearSampler, tex.xy).xyz;
+   float3    c  = colorTexture.Sample( linearSampler, uv).xyz;
 
    if(length(n)==.0)
      return float4(c, 0.0);
@@ -40,15 +61,18 @@ float4 PS(in float2 tex : TEXCOORD0):SV_TARGET
    float   diff = max           ( 0.09, dot ( l, n ) );
    float   spec = pow         ( max ( 0.0, dot ( h, n ) ), 40.0 );
     
-   return 5 * k * float4( float3 ( diff*c + spec*float3(1,1,1) ), 1.0 );    
+   float   lit  = PointShadow ( p, n, lightPos );
+
+   return 5 * k * lit * float4( float3 ( diff*c + spec*float3(1,1,1) ), 1.0 );    
 
    //return normalTexture.Sample( linearSampler, tex.xy);
 }
 
 float4 AMBIENT_PS(in float2 tex : TEXCOORD0):SV_TARGET
 { 
-   float3    n  = normalTexture.Sample( linearSampler, tex.xy).xyz;
-   float3    c  = colorTexture.Sample( linearSampler, tex.xy).xyz;
+   float2    uv = tex * g_vGBufferUVScale.xy;
+   float3    n  = normalTexture.Sample( linearSampler, uv).xyz;
+   float3    c  = colorTexture.Sample( linearSampler, uv).xyz;
 
    if(length(n)==.0)
      return float4(c, 1.0);
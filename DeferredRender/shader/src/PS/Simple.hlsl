@@ -1,12 +1,10 @@
-ThreeTargets PS(in float4 color : TEXCOORD0)
+GBufferTargets PS(in float4 color : TEXCOORD0)
 { 
-   ThreeTargets output;
+   GBufferTargets output;
 
-   output.target0 = float4( 0, 0, 0, 1.0 );
+   output.normal = float4( 0, 0, 0, 1.0 );
 
-   output.target1 = float4( 0, 0, 0, 1.0 );
-
-   output.target2 = color;
+   output.color = color;
 
    return  output;
 }
@@ -0,0 +1,9 @@
+GBufferTargets TERRAIN_PS( in ClipPosPosNormalTex2d i )
+{ 
+   GBufferTargets output;
+
+   output.normal = float4( normalize( i.normal ), 1.0 );
+   output.color = colorTexture.Sample( linearSampler, i.tex.xy );
+
+   return output;
+}
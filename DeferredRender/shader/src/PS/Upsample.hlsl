@@ -0,0 +1,7 @@
+// Stretches the rendered part of the light buffer over the back buffer
+float4 UPSAMPLE_PS(in float2 tex : TEXCOORD0):SV_TARGET
+{ 
+   float2  uv = min( tex * g_vGBufferUVScale.xy, g_vGBufferUVScale.zw );
+
+   return lightTexture.Sample( linearSampler, uv );
+}
@@ -23,4 +23,24 @@ ClipPosPosNormalTangentBitangentTex2d VS( in PosNormalTangetColorTex2d i )
     Out.pos = mul( float4( i.pos, 1.0 ), mWorldView ).xyz;
 
     return Out;
-}   
+}
+
+StructuredBuffer<float4x4> g_BonePalette : register( t8 );     // Transposed bone matrices (SDKSKINNING_PALETTE_SLOT)
+
+ClipPosPosNormalTangentBitangentTex2d VS_Skinned( in PosNormalTangetColorTex2dSkinned i )
+{
+    // Blend the bone matrices and skin into object space, then run the static path
+    float4x4 mSkin = g_BonePalette[ i.bones.x ] * i.weights.x +
+                     g_BonePalette[ i.bones.y ] * i.weights.y +
+                     g_BonePalette[ i.bones.z ] * i.weights.z +
+                     g_BonePalette[ i.bones.w ] * i.weights.w;
+
+    PosNormalTangetColorTex2d skinned;
+    skinned.pos = mul( float4( i.pos, 1.0 ), mSkin ).xyz;
+    skinned.normal = normalize( mul( i.normal, (float3x3)mSkin ) );
+    skinned.tangent = float4( normalize( mul( i.tangent.xyz, (float3x3)mSkin ) ), i.tangent.w );
+    skinned.color = i.color;
+    skinned.tex = i.tex;
+
+    return VS( skinned );
+}
@@ -0,0 +1,14 @@
+// Depth only, g_mWorldViewProjection holds the cascade's light projection
+float4 SHADOW_VS( in PosNormalTangetColorTex2d i ) : SV_POSITION
+{
+  return mul( float4( i.pos, 1.0 ), g_mWorldViewProjection );
+}
+
+// Depth only, at the far plane over the whole viewport: clears the atlas tile the viewport
+// is set to, ClearDepthStencilView can only clear all of it
+float4 SHADOW_CLEAR_VS( uint VertexID : SV_VERTEXID ) : SV_POSITION
+{
+  float2 tmp = float2( (VertexID << 1) & 2, VertexID & 2 );
+
+  return float4( tmp * float2( 2.0f, -2.0f ) + float2( -1.0f, 1.0f ), 1.0f, 1.0f );
+}
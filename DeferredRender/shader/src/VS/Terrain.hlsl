@@ -0,0 +1,39 @@
+struct TerrainVertex
+{
+    float3 pos   : POSITION;                        // Tile vertex, x and z in [-0.5, 0.5]
+    float4 node  : NODE0;                           // Minimum corner x and z, size, tile resolution
+    float4 morph : NODE1;                           // Morph start, 1 / morph length, level
+};
+
+float TerrainHeight( float2 xz )
+{
+    float2 uv = ( ( xz - g_vTerrainOrigin.xz ) / g_vTerrainOrigin.w + 0.5 ) * g_vTerrainHeightMap.y;
+    return g_vTerrainOrigin.y + heightMap.SampleLevel( heightSampler, uv, 0 ).r;
+}
+
+ClipPosPosNormalTex2d TERRAIN_VS( in TerrainVertex i )
+{
+    ClipPosPosNormalTex2d Out;
+
+    float2 gridPos = i.pos.xz + 0.5;
+    float2 xz = i.node.xy + gridPos * i.node.z;
+    float3 pos = float3( xz.x, TerrainHeight( xz ), xz.y );
+
+    // Towards the end of the level's range the odd vertices slide onto their even
+    // neighbours, which leaves the grid of the next coarser level
+    float morphK = saturate( ( distance( pos, g_vTerrainEye.xyz ) - i.morph.x ) * i.morph.y );
+    float2 oddOffset = frac( gridPos * i.node.w * 0.5 ) * 2.0 / i.node.w;
+    xz = i.node.xy + ( gridPos - oddOffset * morphK ) * i.node.z;
+    pos = float3( xz.x, TerrainHeight( xz ), xz.y );
+
+    float d = g_vTerrainOrigin.w;
+    float3 normal = normalize( float3( TerrainHeight( xz - float2( d, 0 ) ) - TerrainHeight( xz + float2( d, 0 ) ), 2.0 * d,
+                                       TerrainHeight( xz - float2( 0, d ) ) - TerrainHeight( xz + float2( 0, d ) ) ) );
+
+    Out.clip_pos = mul( float4( pos, 1.0 ), g_mWorldViewProjection );
+    Out.pos = mul( float4( pos, 1.0 ), g_mWorldView ).xyz;
+    Out.normal = mul( float4( normal, 0.0 ), g_mWorldView ).xyz;
+    Out.tex = xz * textureScale.xy;
+
+    return Out;
+}